@@ -0,0 +1,153 @@
+/*
+ * Cryptographic API.
+ * Glue code for the SHA1 Secure Hash Algorithm using the ARMv8 Crypto
+ * Extensions
+ *
+ * This file is based on sha1_generic.c and sha1_ssse3_glue.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <crypto/internal/hash.h>
+#include <crypto/sha.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/hardirq.h>
+#include <asm/byteorder.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+
+asmlinkage void sha1_ce_transform(int blocks, const u8 *src, u32 *state);
+
+static int sha1_ce_init(struct shash_desc *desc)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	*sctx = (struct sha1_state){
+		.state = { SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4 },
+	};
+	return 0;
+}
+
+static int sha1_ce_update(struct shash_desc *desc, const u8 *data,
+			  unsigned int len)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA1_BLOCK_SIZE;
+	unsigned int blocks;
+
+	/* the NEON unit cannot be taken in interrupt context */
+	if (partial + len < SHA1_BLOCK_SIZE || in_interrupt())
+		return crypto_sha1_update(desc, data, len);
+
+	sctx->count += len;
+	kernel_neon_begin();
+	if (partial) {
+		unsigned int done = SHA1_BLOCK_SIZE - partial;
+
+		memcpy(sctx->buffer + partial, data, done);
+		sha1_ce_transform(1, sctx->buffer, sctx->state);
+		data += done;
+		len -= done;
+	}
+	blocks = len / SHA1_BLOCK_SIZE;
+	if (blocks) {
+		sha1_ce_transform(blocks, data, sctx->state);
+		data += blocks * SHA1_BLOCK_SIZE;
+		len -= blocks * SHA1_BLOCK_SIZE;
+	}
+	kernel_neon_end();
+
+	memcpy(sctx->buffer, data, len);
+	return 0;
+}
+
+/* Add padding and return the message digest. */
+static int sha1_ce_final(struct shash_desc *desc, u8 *out)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+	__be32 *dst = (__be32 *)out;
+	static const u8 padding[64] = { 0x80, };
+	__be64 bits = cpu_to_be64(sctx->count << 3);
+	unsigned int i, index, padlen;
+
+	/* Pad out to 56 mod 64 */
+	index = sctx->count % SHA1_BLOCK_SIZE;
+	padlen = (index < 56) ? (56 - index) : ((SHA1_BLOCK_SIZE + 56) - index);
+	sha1_ce_update(desc, padding, padlen);
+
+	/* Append length */
+	sha1_ce_update(desc, (const u8 *)&bits, sizeof(bits));
+
+	/* Store state in digest */
+	for (i = 0; i < SHA1_DIGEST_SIZE / sizeof(__be32); i++)
+		dst[i] = cpu_to_be32(sctx->state[i]);
+
+	/* Wipe context */
+	memset(sctx, 0, sizeof(*sctx));
+	return 0;
+}
+
+static int sha1_ce_export(struct shash_desc *desc, void *out)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+	return 0;
+}
+
+static int sha1_ce_import(struct shash_desc *desc, const void *in)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize	= SHA1_DIGEST_SIZE,
+	.init		= sha1_ce_init,
+	.update		= sha1_ce_update,
+	.final		= sha1_ce_final,
+	.export		= sha1_ce_export,
+	.import		= sha1_ce_import,
+	.descsize	= sizeof(struct sha1_state),
+	.statesize	= sizeof(struct sha1_state),
+	.base		= {
+		.cra_name		= "sha1",
+		.cra_driver_name	= "sha1-ce",
+		.cra_priority		= 200,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= SHA1_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	}
+};
+
+/* ID_AA64ISAR0_EL1.SHA1, bits [11:8], is nonzero with the instructions */
+static bool __init sha1_ce_usable(void)
+{
+	return (read_cpuid(ID_AA64ISAR0_EL1) >> 8) & 0xf;
+}
+
+static int __init sha1_ce_mod_init(void)
+{
+	if (!sha1_ce_usable())
+		return -ENODEV;
+	return crypto_register_shash(&alg);
+}
+
+static void __exit sha1_ce_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(sha1_ce_mod_init);
+module_exit(sha1_ce_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA1 Secure Hash Algorithm (ARMv8 Crypto Extensions)");
+MODULE_ALIAS("sha1");
@@ -0,0 +1,197 @@
+/*
+ * Cryptographic API.
+ * Glue code for the SHA-224/SHA-256 Secure Hash Algorithms using the
+ * ARMv8 Crypto Extensions
+ *
+ * This file is based on sha256_generic.c and sha1-ce-glue.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <crypto/internal/hash.h>
+#include <crypto/sha.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/hardirq.h>
+#include <asm/byteorder.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+
+asmlinkage void sha2_ce_transform(int blocks, const u8 *src, u32 *state);
+
+static int sha224_ce_init(struct shash_desc *desc)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	*sctx = (struct sha256_state){
+		.state = {
+			SHA224_H0, SHA224_H1, SHA224_H2, SHA224_H3,
+			SHA224_H4, SHA224_H5, SHA224_H6, SHA224_H7,
+		}
+	};
+	return 0;
+}
+
+static int sha256_ce_init(struct shash_desc *desc)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	*sctx = (struct sha256_state){
+		.state = {
+			SHA256_H0, SHA256_H1, SHA256_H2, SHA256_H3,
+			SHA256_H4, SHA256_H5, SHA256_H6, SHA256_H7,
+		}
+	};
+	return 0;
+}
+
+static int sha2_ce_update(struct shash_desc *desc, const u8 *data,
+			  unsigned int len)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+	unsigned int blocks;
+
+	/* the NEON unit cannot be taken in interrupt context */
+	if (partial + len < SHA256_BLOCK_SIZE || in_interrupt())
+		return crypto_sha256_update(desc, data, len);
+
+	sctx->count += len;
+	kernel_neon_begin();
+	if (partial) {
+		unsigned int done = SHA256_BLOCK_SIZE - partial;
+
+		memcpy(sctx->buf + partial, data, done);
+		sha2_ce_transform(1, sctx->buf, sctx->state);
+		data += done;
+		len -= done;
+	}
+	blocks = len / SHA256_BLOCK_SIZE;
+	if (blocks) {
+		sha2_ce_transform(blocks, data, sctx->state);
+		data += blocks * SHA256_BLOCK_SIZE;
+		len -= blocks * SHA256_BLOCK_SIZE;
+	}
+	kernel_neon_end();
+
+	memcpy(sctx->buf, data, len);
+	return 0;
+}
+
+/* Add padding and store the first words of the state in the digest. */
+static void sha2_ce_pad(struct shash_desc *desc, u8 *out, unsigned int words)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	__be32 *dst = (__be32 *)out;
+	static const u8 padding[64] = { 0x80, };
+	__be64 bits = cpu_to_be64(sctx->count << 3);
+	unsigned int i, index, padlen;
+
+	/* Pad out to 56 mod 64 */
+	index = sctx->count % SHA256_BLOCK_SIZE;
+	padlen = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE + 56) - index);
+	sha2_ce_update(desc, padding, padlen);
+
+	/* Append length */
+	sha2_ce_update(desc, (const u8 *)&bits, sizeof(bits));
+
+	for (i = 0; i < words; i++)
+		dst[i] = cpu_to_be32(sctx->state[i]);
+
+	/* Wipe context */
+	memset(sctx, 0, sizeof(*sctx));
+}
+
+static int sha224_ce_final(struct shash_desc *desc, u8 *out)
+{
+	sha2_ce_pad(desc, out, SHA224_DIGEST_SIZE / sizeof(__be32));
+	return 0;
+}
+
+static int sha256_ce_final(struct shash_desc *desc, u8 *out)
+{
+	sha2_ce_pad(desc, out, SHA256_DIGEST_SIZE / sizeof(__be32));
+	return 0;
+}
+
+static int sha2_ce_export(struct shash_desc *desc, void *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+	return 0;
+}
+
+static int sha2_ce_import(struct shash_desc *desc, const void *in)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+	return 0;
+}
+
+static struct shash_alg algs[] = { {
+	.digestsize	= SHA224_DIGEST_SIZE,
+	.init		= sha224_ce_init,
+	.update		= sha2_ce_update,
+	.final		= sha224_ce_final,
+	.export		= sha2_ce_export,
+	.import		= sha2_ce_import,
+	.descsize	= sizeof(struct sha256_state),
+	.statesize	= sizeof(struct sha256_state),
+	.base		= {
+		.cra_name		= "sha224",
+		.cra_driver_name	= "sha224-ce",
+		.cra_priority		= 200,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	}
+}, {
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.init		= sha256_ce_init,
+	.update		= sha2_ce_update,
+	.final		= sha256_ce_final,
+	.export		= sha2_ce_export,
+	.import		= sha2_ce_import,
+	.descsize	= sizeof(struct sha256_state),
+	.statesize	= sizeof(struct sha256_state),
+	.base		= {
+		.cra_name		= "sha256",
+		.cra_driver_name	= "sha256-ce",
+		.cra_priority		= 200,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	}
+} };
+
+/* ID_AA64ISAR0_EL1.SHA2, bits [15:12], is nonzero with the instructions */
+static bool __init sha2_ce_usable(void)
+{
+	return (read_cpuid(ID_AA64ISAR0_EL1) >> 12) & 0xf;
+}
+
+static int __init sha2_ce_mod_init(void)
+{
+	if (!sha2_ce_usable())
+		return -ENODEV;
+	return crypto_register_shashes(algs, ARRAY_SIZE(algs));
+}
+
+static void __exit sha2_ce_mod_fini(void)
+{
+	crypto_unregister_shashes(algs, ARRAY_SIZE(algs));
+}
+
+module_init(sha2_ce_mod_init);
+module_exit(sha2_ce_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA-224/SHA-256 Secure Hash Algorithms (ARMv8 Crypto Extensions)");
+MODULE_ALIAS("sha224");
+MODULE_ALIAS("sha256");
@@ -39,6 +39,10 @@ asmlinkage void sha1_transform_ssse3(u32 *digest, const char *data,
 asmlinkage void sha1_transform_avx(u32 *digest, const char *data,
 				   unsigned int rounds);
 #endif
+#ifdef CONFIG_AS_SHA1_NI
+asmlinkage void sha1_ni_transform(u32 *digest, const char *data,
+				  unsigned int rounds);
+#endif
 
 static asmlinkage void (*sha1_transform_asm)(u32 *, const char *, unsigned int);
 
@@ -215,10 +219,21 @@ static int __init sha1_ssse3_mod_init(void)
 		sha1_transform_asm = sha1_transform_avx;
 #endif
 
+#ifdef CONFIG_AS_SHA1_NI
+	/* the SHA extensions beat both, and need SSSE3 for the byte swap */
+	if (cpu_has_ssse3 && boot_cpu_has(X86_FEATURE_SHA_NI))
+		sha1_transform_asm = sha1_ni_transform;
+#endif
+
 	if (sha1_transform_asm) {
-		pr_info("Using %s optimized SHA-1 implementation\n",
-		        sha1_transform_asm == sha1_transform_ssse3 ? "SSSE3"
-		                                                   : "AVX");
+#ifdef CONFIG_AS_SHA1_NI
+		if (sha1_transform_asm == sha1_ni_transform)
+			pr_info("Using SHA-NI optimized SHA-1 implementation\n");
+		else
+#endif
+			pr_info("Using %s optimized SHA-1 implementation\n",
+				sha1_transform_asm == sha1_transform_ssse3 ?
+				"SSSE3" : "AVX");
 		return crypto_register_shash(&alg);
 	}
 	pr_info("Neither AVX nor SSSE3 is available/usable.\n");
@@ -52,6 +52,10 @@ asmlinkage void sha256_transform_avx(const char *data, u32 *digest,
 asmlinkage void sha256_transform_rorx(const char *data, u32 *digest,
 				     u64 rounds);
 #endif
+#ifdef CONFIG_AS_SHA256_NI
+asmlinkage void sha256_ni_transform(const char *data, u32 *digest,
+				    u64 rounds);
+#endif
 
 static asmlinkage void (*sha256_transform_asm)(const char *, u32 *, u64);
 
@@ -289,7 +293,18 @@ static int __init sha256_ssse3_mod_init(void)
 	}
 #endif
 
+#ifdef CONFIG_AS_SHA256_NI
+	/* the SHA extensions beat them all, and need SSSE3 for the byte swap */
+	if (cpu_has_ssse3 && boot_cpu_has(X86_FEATURE_SHA_NI))
+		sha256_transform_asm = sha256_ni_transform;
+#endif
+
 	if (sha256_transform_asm) {
+#ifdef CONFIG_AS_SHA256_NI
+		if (sha256_transform_asm == sha256_ni_transform)
+			pr_info("Using SHA-NI optimized SHA-256 implementation\n");
+		else
+#endif
 #ifdef CONFIG_AS_AVX
 		if (sha256_transform_asm == sha256_transform_avx)
 			pr_info("Using AVX optimized SHA-256 implementation\n");
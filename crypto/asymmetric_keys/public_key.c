@@ -70,6 +70,7 @@ void public_key_destroy(void *payload)
 	if (key) {
 		for (i = 0; i < ARRAY_SIZE(key->mpi); i++)
 			mpi_free(key->mpi[i]);
+		mpi_mont_free(key->rsa_mont);
 		kfree(key);
 	}
 }
@@ -105,8 +105,12 @@ static int RSAVP1(const struct public_key *key, MPI s, MPI *_m)
 	if (!m)
 		return -ENOMEM;
 
-	/* (2) m = s^e mod n */
-	ret = mpi_powm(m, s, key->rsa.e, key->rsa.n);
+	/* (2) m = s^e mod n, without division if the key was prepared */
+	ret = -EINVAL;
+	if (key->rsa_mont)
+		ret = mpi_powm_mont(m, s, key->rsa.e, key->rsa_mont);
+	if (ret == -EINVAL)
+		ret = mpi_powm(m, s, key->rsa.e, key->rsa.n);
 	if (ret < 0) {
 		mpi_free(m);
 		return ret;
@@ -0,0 +1,216 @@
+/*
+ * Cryptographic API.
+ *
+ * BLAKE2b digest algorithm (RFC 7693), unkeyed, with 256 and 512 bit
+ * digests.
+ *
+ * The block function is written as the compiler best turns it into
+ * 64-bit rotates and adds on its own; arch-optimized drivers register
+ * the same names with a higher priority.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ */
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/types.h>
+#include <linux/bitops.h>
+#include <crypto/blake2b.h>
+#include <asm/unaligned.h>
+
+static const u8 blake2b_sigma[12][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+};
+
+static const u64 blake2b_iv[8] = {
+	BLAKE2B_IV0, BLAKE2B_IV1, BLAKE2B_IV2, BLAKE2B_IV3,
+	BLAKE2B_IV4, BLAKE2B_IV5, BLAKE2B_IV6, BLAKE2B_IV7,
+};
+
+#define G(r, i, a, b, c, d)					\
+	do {							\
+		a = a + b + m[blake2b_sigma[r][2 * i]];		\
+		d = ror64(d ^ a, 32);				\
+		c = c + d;					\
+		b = ror64(b ^ c, 24);				\
+		a = a + b + m[blake2b_sigma[r][2 * i + 1]];	\
+		d = ror64(d ^ a, 16);				\
+		c = c + d;					\
+		b = ror64(b ^ c, 63);				\
+	} while (0)
+
+#define ROUND(r)						\
+	do {							\
+		G(r, 0, v[0], v[4], v[8], v[12]);		\
+		G(r, 1, v[1], v[5], v[9], v[13]);		\
+		G(r, 2, v[2], v[6], v[10], v[14]);		\
+		G(r, 3, v[3], v[7], v[11], v[15]);		\
+		G(r, 4, v[0], v[5], v[10], v[15]);		\
+		G(r, 5, v[1], v[6], v[11], v[12]);		\
+		G(r, 6, v[2], v[7], v[8], v[13]);		\
+		G(r, 7, v[3], v[4], v[9], v[14]);		\
+	} while (0)
+
+static void blake2b_compress(struct blake2b_state *sctx, const u8 *block,
+			     unsigned int inc, bool last)
+{
+	u64 m[16], v[16];
+	int i;
+
+	sctx->t[0] += inc;
+	if (sctx->t[0] < inc)
+		sctx->t[1]++;
+
+	for (i = 0; i < 16; i++)
+		m[i] = get_unaligned_le64(block + i * sizeof(u64));
+	for (i = 0; i < 8; i++) {
+		v[i] = sctx->h[i];
+		v[i + 8] = blake2b_iv[i];
+	}
+	v[12] ^= sctx->t[0];
+	v[13] ^= sctx->t[1];
+	if (last)
+		v[14] = ~v[14];
+
+	ROUND(0);
+	ROUND(1);
+	ROUND(2);
+	ROUND(3);
+	ROUND(4);
+	ROUND(5);
+	ROUND(6);
+	ROUND(7);
+	ROUND(8);
+	ROUND(9);
+	ROUND(10);
+	ROUND(11);
+
+	for (i = 0; i < 8; i++)
+		sctx->h[i] ^= v[i] ^ v[i + 8];
+
+	memset(m, 0, sizeof(m));
+	memset(v, 0, sizeof(v));
+}
+
+#undef G
+#undef ROUND
+
+static int blake2b_init(struct shash_desc *desc)
+{
+	struct blake2b_state *sctx = shash_desc_ctx(desc);
+	unsigned int outlen = crypto_shash_digestsize(desc->tfm);
+
+	memcpy(sctx->h, blake2b_iv, sizeof(sctx->h));
+	/* parameter block: digest length, no key, fanout and depth 1 */
+	sctx->h[0] ^= 0x01010000 ^ outlen;
+	sctx->t[0] = sctx->t[1] = 0;
+	sctx->buflen = 0;
+	return 0;
+}
+
+static int blake2b_update(struct shash_desc *desc, const u8 *data,
+			  unsigned int len)
+{
+	struct blake2b_state *sctx = shash_desc_ctx(desc);
+	unsigned int fill = BLAKE2B_BLOCK_SIZE - sctx->buflen;
+
+	/* the last block is compressed differently, so one is always kept */
+	if (len > fill) {
+		memcpy(sctx->buf + sctx->buflen, data, fill);
+		blake2b_compress(sctx, sctx->buf, BLAKE2B_BLOCK_SIZE, false);
+		sctx->buflen = 0;
+		data += fill;
+		len -= fill;
+
+		while (len > BLAKE2B_BLOCK_SIZE) {
+			blake2b_compress(sctx, data, BLAKE2B_BLOCK_SIZE, false);
+			data += BLAKE2B_BLOCK_SIZE;
+			len -= BLAKE2B_BLOCK_SIZE;
+		}
+	}
+	memcpy(sctx->buf + sctx->buflen, data, len);
+	sctx->buflen += len;
+	return 0;
+}
+
+static int blake2b_final(struct shash_desc *desc, u8 *out)
+{
+	struct blake2b_state *sctx = shash_desc_ctx(desc);
+	unsigned int outlen = crypto_shash_digestsize(desc->tfm);
+	__le64 digest[8];
+	int i;
+
+	memset(sctx->buf + sctx->buflen, 0, BLAKE2B_BLOCK_SIZE - sctx->buflen);
+	blake2b_compress(sctx, sctx->buf, sctx->buflen, true);
+
+	for (i = 0; i < 8; i++)
+		digest[i] = cpu_to_le64(sctx->h[i]);
+	memcpy(out, digest, outlen);
+
+	memset(digest, 0, sizeof(digest));
+	memset(sctx, 0, sizeof(*sctx));
+	return 0;
+}
+
+static struct shash_alg blake2b_algs[2] = { {
+	.digestsize	=	BLAKE2B_512_DIGEST_SIZE,
+	.init		=	blake2b_init,
+	.update		=	blake2b_update,
+	.final		=	blake2b_final,
+	.descsize	=	sizeof(struct blake2b_state),
+	.base		=	{
+		.cra_name	=	"blake2b-512",
+		.cra_driver_name =	"blake2b-512-generic",
+		.cra_flags	=	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	=	BLAKE2B_BLOCK_SIZE,
+		.cra_module	=	THIS_MODULE,
+	}
+}, {
+	.digestsize	=	BLAKE2B_256_DIGEST_SIZE,
+	.init		=	blake2b_init,
+	.update		=	blake2b_update,
+	.final		=	blake2b_final,
+	.descsize	=	sizeof(struct blake2b_state),
+	.base		=	{
+		.cra_name	=	"blake2b-256",
+		.cra_driver_name =	"blake2b-256-generic",
+		.cra_flags	=	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	=	BLAKE2B_BLOCK_SIZE,
+		.cra_module	=	THIS_MODULE,
+	}
+} };
+
+static int __init blake2b_generic_mod_init(void)
+{
+	return crypto_register_shashes(blake2b_algs, ARRAY_SIZE(blake2b_algs));
+}
+
+static void __exit blake2b_generic_mod_fini(void)
+{
+	crypto_unregister_shashes(blake2b_algs, ARRAY_SIZE(blake2b_algs));
+}
+
+module_init(blake2b_generic_mod_init);
+module_exit(blake2b_generic_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("BLAKE2b digest algorithm");
+
+MODULE_ALIAS("blake2b-256");
+MODULE_ALIAS("blake2b-512");
@@ -181,6 +181,7 @@ struct mapped_device {
 	 */
 	atomic_t event_nr;
 	wait_queue_head_t eventq;
+	atomic_t table_nr;	/* tables bound, see dm_get_table_nr() */
 	atomic_t uevent_seq;
 	struct list_head uevent_list;
 	spinlock_t uevent_lock; /* Protect access to uevent_list */
@@ -1986,6 +1987,7 @@ static struct mapped_device *alloc_dev(int minor)
 	atomic_set(&md->holders, 1);
 	atomic_set(&md->open_count, 0);
 	atomic_set(&md->event_nr, 0);
+	atomic_set(&md->table_nr, 0);
 	atomic_set(&md->uevent_seq, 0);
 	INIT_LIST_HEAD(&md->uevent_list);
 	spin_lock_init(&md->uevent_lock);
@@ -2253,6 +2255,7 @@ static struct dm_table *__bind(struct mapped_device *md, struct dm_table *t,
 	else
 		clear_bit(DMF_MERGE_IS_OPTIONAL, &md->flags);
 	dm_sync_table(md);
+	atomic_inc(&md->table_nr);
 
 	return old_map;
 }
@@ -2840,6 +2843,16 @@ uint32_t dm_get_event_nr(struct mapped_device *md)
 	return atomic_read(&md->event_nr);
 }
 
+/*
+ * The number of tables bound to the device so far.  It is bumped once
+ * the new table is live, so one read before the table was looked at
+ * tells whether the table changed since.
+ */
+uint32_t dm_get_table_nr(struct mapped_device *md)
+{
+	return atomic_read(&md->table_nr);
+}
+
 int dm_wait_event(struct mapped_device *md, int event_nr)
 {
 	return wait_event_interruptible(md->eventq,
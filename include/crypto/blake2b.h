@@ -0,0 +1,30 @@
+/*
+ * Common values for the BLAKE2b algorithm (RFC 7693)
+ */
+
+#ifndef _CRYPTO_BLAKE2B_H
+#define _CRYPTO_BLAKE2B_H
+
+#include <linux/types.h>
+
+#define BLAKE2B_BLOCK_SIZE	128
+#define BLAKE2B_256_DIGEST_SIZE	32
+#define BLAKE2B_512_DIGEST_SIZE	64
+
+#define BLAKE2B_IV0	0x6a09e667f3bcc908ULL
+#define BLAKE2B_IV1	0xbb67ae8584caa73bULL
+#define BLAKE2B_IV2	0x3c6ef372fe94f82bULL
+#define BLAKE2B_IV3	0xa54ff53a5f1d36f1ULL
+#define BLAKE2B_IV4	0x510e527fade682d1ULL
+#define BLAKE2B_IV5	0x9b05688c2b3e6c1fULL
+#define BLAKE2B_IV6	0x1f83d9abfb41bd6bULL
+#define BLAKE2B_IV7	0x5be0cd19137e2179ULL
+
+struct blake2b_state {
+	u64 h[8];
+	u64 t[2];
+	unsigned int buflen;
+	u8 buf[BLAKE2B_BLOCK_SIZE];
+};
+
+#endif
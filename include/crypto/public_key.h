@@ -77,6 +77,8 @@ struct public_key {
 			MPI	q;	/* RSA secret prime (if present) */
 		} rsa;
 	};
+	/* RSA: the Montgomery constants of n, NULL to use mpi_powm() */
+	struct mpi_mont_ctx *rsa_mont;
 };
 
 extern void public_key_destroy(void *payload);
@@ -24,6 +24,7 @@ struct keyring_list {
 	unsigned short	maxkeys;	/* max keys this list can hold */
 	unsigned short	nkeys;		/* number of keys currently held */
 	unsigned short	delkey;		/* key to be unlinked by RCU */
+	struct keyring_index __rcu *index; /* keys by type and description */
 	struct key __rcu *keys[0];
 };
 
@@ -41,6 +41,8 @@ extern int __delayacct_add_tsk(struct taskstats *, struct task_struct *);
 extern __u64 __delayacct_blkio_ticks(struct task_struct *);
 extern void __delayacct_freepages_start(void);
 extern void __delayacct_freepages_end(void);
+extern void __delayacct_integrity_start(void);
+extern void __delayacct_integrity_end(void);
 
 static inline int delayacct_is_task_waiting_on_io(struct task_struct *p)
 {
@@ -121,6 +123,18 @@ static inline void delayacct_freepages_end(void)
 		__delayacct_freepages_end();
 }
 
+static inline void delayacct_integrity_start(void)
+{
+	if (current->delays)
+		__delayacct_integrity_start();
+}
+
+static inline void delayacct_integrity_end(void)
+{
+	if (current->delays)
+		__delayacct_integrity_end();
+}
+
 #else
 static inline void delayacct_set_flag(int flag)
 {}
@@ -147,6 +161,10 @@ static inline void delayacct_freepages_start(void)
 {}
 static inline void delayacct_freepages_end(void)
 {}
+static inline void delayacct_integrity_start(void)
+{}
+static inline void delayacct_integrity_end(void)
+{}
 
 #endif /* CONFIG_TASK_DELAY_ACCT */
 
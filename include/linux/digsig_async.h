@@ -0,0 +1,63 @@
+/*
+ * Asynchronous verification of files by DigSig
+ *
+ * A file is submitted to be verified as mapping it for exec would; the
+ * request carries a callback, run in process context once the verdict
+ * is made, and can be waited for or cancelled.  The verdict is cached
+ * as usual, so that the mapping that follows finds it.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _LINUX_DIGSIG_ASYNC_H
+#define _LINUX_DIGSIG_ASYNC_H
+
+#include <linux/err.h>
+
+struct file;
+struct digsig_async;
+
+/* the flags of a request */
+#define DIGSIG_ASYNC_STREAM	0x1	/* not used soon: do not keep it cached */
+#define DIGSIG_ASYNC_URGENT	0x2	/* about to be mapped: ahead of the rest */
+#define DIGSIG_ASYNC_IDLE	0x4	/* no hurry: behind everything else */
+
+/*
+ * Called once per request, in process context, with 0 if the file may
+ * be executed, -ECANCELED if the request was cancelled first, or the
+ * error mapping it would get.
+ */
+typedef void (*digsig_async_done_t)(struct digsig_async *req, int result,
+				    void *data);
+
+#ifdef CONFIG_SECURITY_DIGSIG
+struct digsig_async *digsig_verify_submit(struct file *file,
+					  unsigned int flags,
+					  digsig_async_done_t done,
+					  void *data);
+int digsig_verify_wait(struct digsig_async *req);
+int digsig_verify_cancel(struct digsig_async *req);
+void digsig_verify_put(struct digsig_async *req);
+#else
+static inline struct digsig_async *
+digsig_verify_submit(struct file *file, unsigned int flags,
+		     digsig_async_done_t done, void *data)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+static inline int digsig_verify_wait(struct digsig_async *req)
+{
+	return -EOPNOTSUPP;
+}
+static inline int digsig_verify_cancel(struct digsig_async *req)
+{
+	return -EOPNOTSUPP;
+}
+static inline void digsig_verify_put(struct digsig_async *req) { }
+#endif
+
+#endif /* _LINUX_DIGSIG_ASYNC_H */
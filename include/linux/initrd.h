@@ -18,3 +18,20 @@ extern unsigned long initrd_start, initrd_end;
 extern void free_initrd_mem(unsigned long, unsigned long);
 
 extern unsigned int real_root_dev;
+
+#ifdef CONFIG_SECURITY_DIGSIG_INITRAMFS
+/* in security/digsig: the files of a signed initramfs are trusted as a whole */
+extern int digsig_initramfs_signed(char *buf, unsigned long *len);
+extern void digsig_initramfs_note(const char *name);
+extern int digsig_initramfs_unpacked(int ok);
+#else
+static inline int digsig_initramfs_signed(char *buf, unsigned long *len)
+{
+	return 0;
+}
+static inline void digsig_initramfs_note(const char *name) { }
+static inline int digsig_initramfs_unpacked(int ok)
+{
+	return 0;
+}
+#endif
@@ -20,10 +20,25 @@ enum integrity_status {
 	INTEGRITY_UNKNOWN,
 };
 
+struct crypto_shash;
+
+/*
+ * Computes the digest of the whole content of a file with the transform,
+ * from what another integrity module hashed of the file already; 0 if it
+ * did, negative otherwise.
+ */
+typedef int (*integrity_digest_fn)(struct file *file, struct crypto_shash *tfm,
+				   u8 *digest);
+
 /* List of EVM protected security xattrs */
 #ifdef CONFIG_INTEGRITY
 extern struct integrity_iint_cache *integrity_inode_get(struct inode *inode);
 extern void integrity_inode_free(struct inode *inode);
+extern void integrity_want_digest(struct crypto_shash *tfm);
+extern struct crypto_shash *integrity_wanted_digest(void);
+extern void integrity_set_digest_source(integrity_digest_fn fn);
+extern int integrity_shared_digest(struct file *file, struct crypto_shash *tfm,
+				   u8 *digest);
 
 #else
 static inline struct integrity_iint_cache *
@@ -36,5 +51,24 @@ static inline void integrity_inode_free(struct inode *inode)
 {
 	return;
 }
+
+static inline void integrity_want_digest(struct crypto_shash *tfm)
+{
+}
+
+static inline struct crypto_shash *integrity_wanted_digest(void)
+{
+	return NULL;
+}
+
+static inline void integrity_set_digest_source(integrity_digest_fn fn)
+{
+}
+
+static inline int integrity_shared_digest(struct file *file,
+					  struct crypto_shash *tfm, u8 *digest)
+{
+	return -ENOENT;
+}
 #endif /* CONFIG_INTEGRITY */
 #endif /* _LINUX_INTEGRITY_H */
@@ -120,6 +120,18 @@ int mpi_powm(MPI res, MPI base, MPI exp, MPI mod);
 /*-- mpi-mpow.c --*/
 int mpi_mulpowm(MPI res, MPI *basearray, MPI *exparray, MPI mod);
 
+/*-- mpi-mont.c --*/
+struct mpi_mont_ctx {
+	int nlimbs;		/* size of the modulus */
+	mpi_limb_t *n;		/* the modulus */
+	mpi_limb_t *rr;		/* R^2 mod n, R = 2^(nlimbs * BITS_PER_MPI_LIMB) */
+	mpi_limb_t ninv;	/* -1/n mod 2^BITS_PER_MPI_LIMB */
+};
+
+struct mpi_mont_ctx *mpi_mont_alloc(MPI mod);
+void mpi_mont_free(struct mpi_mont_ctx *ctx);
+int mpi_powm_mont(MPI res, MPI base, MPI exp, struct mpi_mont_ctx *ctx);
+
 /*-- mpi-cmp.c --*/
 int mpi_cmp_ui(MPI u, ulong v);
 int mpi_cmp(MPI u, MPI v);
@@ -724,6 +724,10 @@ struct task_delay_info {
 	struct timespec freepages_start, freepages_end;
 	u64 freepages_delay;	/* wait for memory reclaim */
 	u32 freepages_count;	/* total count of memory reclaim */
+
+	struct timespec integrity_start, integrity_end;
+	u64 integrity_delay;	/* wait for integrity verification */
+	u32 integrity_count;	/* total count of integrity verification */
 };
 #endif	/* CONFIG_TASK_DELAY_ACCT */
 
@@ -781,6 +785,9 @@ struct sched_domain_attr {
 
 extern int sched_domain_level_max;
 
+/* cpus with isolated domains, from isolcpus= */
+extern cpumask_var_t cpu_isolated_map;
+
 struct sched_group;
 
 struct sched_domain {
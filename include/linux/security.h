@@ -612,6 +612,22 @@ static inline void security_free_mnt_opts(struct security_mnt_opts *opts)
  *	@prot contains the protection that will be applied by the kernel.
  *	@flags contains the operational flags.
  *	Return 0 if permission is granted.
+ * @mmap_populate :
+ *	Decide how much of a new file mapping, still to be faulted in, is
+ *	to be faulted in at once, as with MAP_POPULATE.  Called once the
+ *	mapping is made, without mmap_sem held.
+ *	@file contains the file structure for the file mapped.
+ *	@prot contains the protection requested by the application.
+ *	@flags contains the operational flags.
+ *	@len contains the length of the mapping.
+ *	Return the number of bytes from its start to fault in, 0 for none.
+ * @file_mmapped :
+ *	Check a new file mapping once it is made, with mmap_sem held for
+ *	writing: the protection of part of it may be lowered.
+ *	@file contains the file structure for the file mapped.
+ *	@addr contains the start of the mapping.
+ *	@len contains the length of the mapping.
+ *	Return 0 if the mapping may stay, an error to have it unmapped.
  * @file_mprotect:
  *	Check permissions before changing memory access permissions.
  *	@vma contains the memory region to modify.
@@ -1535,6 +1551,11 @@ struct security_operations {
 	int (*mmap_file) (struct file *file,
 			  unsigned long reqprot, unsigned long prot,
 			  unsigned long flags);
+	unsigned long (*mmap_populate) (struct file *file, unsigned long prot,
+					unsigned long flags,
+					unsigned long len);
+	int (*file_mmapped) (struct file *file, unsigned long addr,
+			     unsigned long len);
 	int (*file_mprotect) (struct vm_area_struct *vma,
 			      unsigned long reqprot,
 			      unsigned long prot);
@@ -1807,6 +1828,10 @@ void security_file_free(struct file *file);
 int security_file_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 int security_mmap_file(struct file *file, unsigned long prot,
 			unsigned long flags);
+unsigned long security_mmap_populate(struct file *file, unsigned long prot,
+				     unsigned long flags, unsigned long len);
+int security_file_mmapped(struct file *file, unsigned long addr,
+			  unsigned long len);
 int security_mmap_addr(unsigned long addr);
 int security_file_mprotect(struct vm_area_struct *vma, unsigned long reqprot,
 			   unsigned long prot);
@@ -2265,6 +2290,20 @@ static inline int security_mmap_file(struct file *file, unsigned long prot,
 	return 0;
 }
 
+static inline unsigned long security_mmap_populate(struct file *file,
+						   unsigned long prot,
+						   unsigned long flags,
+						   unsigned long len)
+{
+	return 0;
+}
+
+static inline int security_file_mmapped(struct file *file, unsigned long addr,
+					unsigned long len)
+{
+	return 0;
+}
+
 static inline int security_mmap_addr(unsigned long addr)
 {
 	return cap_mmap_addr(addr);
@@ -0,0 +1,206 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM digsig
+
+#if !defined(_TRACE_DIGSIG_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DIGSIG_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+
+DECLARE_EVENT_CLASS(digsig_inode_class,
+
+	TP_PROTO(struct inode *inode),
+
+	TP_ARGS(inode),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = inode->i_sb->s_dev;
+		__entry->i_ino = inode->i_ino;
+	),
+
+	TP_printk("dev %d:%d ino %lx",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino)
+);
+
+/* the verdict on a file mapped for execution was cached */
+DEFINE_EVENT(digsig_inode_class, digsig_cache_hit,
+	TP_PROTO(struct inode *inode),
+	TP_ARGS(inode)
+	);
+
+/* it was not, the file is about to be read */
+DEFINE_EVENT(digsig_inode_class, digsig_cache_miss,
+	TP_PROTO(struct inode *inode),
+	TP_ARGS(inode)
+	);
+
+/* a verdict is about to be stored in the table */
+DEFINE_EVENT(digsig_inode_class, digsig_cache_insert,
+	TP_PROTO(struct inode *inode),
+	TP_ARGS(inode)
+	);
+
+/* the file changed or went away, its verdict is dropped */
+DEFINE_EVENT(digsig_inode_class, digsig_cache_remove,
+	TP_PROTO(struct inode *inode),
+	TP_ARGS(inode)
+	);
+
+DECLARE_EVENT_CLASS(digsig_file_class,
+
+	TP_PROTO(struct file *file, int result),
+
+	TP_ARGS(file, result),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+		__field(int, result)
+		__string(name, file->f_dentry->d_name.name)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = file_inode(file)->i_sb->s_dev;
+		__entry->i_ino = file_inode(file)->i_ino;
+		__entry->result = result;
+		__assign_str(name, file->f_dentry->d_name.name);
+	),
+
+	TP_printk("dev %d:%d ino %lx name %s result %d",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, __get_str(name), __entry->result)
+);
+
+/* its signature is on the revocation list */
+DEFINE_EVENT(digsig_file_class, digsig_revoked,
+	TP_PROTO(struct file *file, int result),
+	TP_ARGS(file, result)
+	);
+
+/* the file may not be mapped for execution */
+DEFINE_EVENT(digsig_file_class, digsig_deny,
+	TP_PROTO(struct file *file, int result),
+	TP_ARGS(file, result)
+	);
+
+/* in audit mode, the file would not have been let through */
+DEFINE_EVENT(digsig_file_class, digsig_audit,
+	TP_PROTO(struct file *file, int result),
+	TP_ARGS(file, result)
+	);
+
+/* the signature of the file is about to be verified */
+TRACE_EVENT(digsig_verify_start,
+
+	TP_PROTO(struct file *file),
+
+	TP_ARGS(file),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+		__field(loff_t, size)
+		__string(name, file->f_dentry->d_name.name)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = file_inode(file)->i_sb->s_dev;
+		__entry->i_ino = file_inode(file)->i_ino;
+		__entry->size = i_size_read(file_inode(file));
+		__assign_str(name, file->f_dentry->d_name.name);
+	),
+
+	TP_printk("dev %d:%d ino %lx name %s size %lld",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, __get_str(name), __entry->size)
+);
+
+/* the hashing of a large file got to @pos, of its @size bytes */
+TRACE_EVENT(digsig_verify_progress,
+
+	TP_PROTO(struct file *file, loff_t pos, loff_t size),
+
+	TP_ARGS(file, pos, size),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+		__field(loff_t, pos)
+		__field(loff_t, size)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = file_inode(file)->i_sb->s_dev;
+		__entry->i_ino = file_inode(file)->i_ino;
+		__entry->pos = pos;
+		__entry->size = size;
+	),
+
+	TP_printk("dev %d:%d ino %lx pos %lld size %lld",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, __entry->pos, __entry->size)
+);
+
+/* and was, with @bytes of the file hashed */
+TRACE_EVENT(digsig_verify_end,
+
+	TP_PROTO(struct file *file, loff_t bytes, u64 ns, int result),
+
+	TP_ARGS(file, bytes, ns, result),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+		__field(loff_t, bytes)
+		__field(u64, ns)
+		__field(int, result)
+		__string(name, file->f_dentry->d_name.name)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = file_inode(file)->i_sb->s_dev;
+		__entry->i_ino = file_inode(file)->i_ino;
+		__entry->bytes = bytes;
+		__entry->ns = ns;
+		__entry->result = result;
+		__assign_str(name, file->f_dentry->d_name.name);
+	),
+
+	TP_printk("dev %d:%d ino %lx name %s bytes %lld ns %llu result %d",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, __get_str(name), __entry->bytes,
+		__entry->ns, __entry->result)
+);
+
+/* a DigSig lock was found taken, and waited for @ns (0 if given up) */
+TRACE_EVENT(digsig_lock_contended,
+
+	TP_PROTO(const char *site, u64 ns),
+
+	TP_ARGS(site, ns),
+
+	TP_STRUCT__entry(
+		__field(const char *, site)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->site = site;
+		__entry->ns = ns;
+	),
+
+	TP_printk("site %s ns %llu", __entry->site, __entry->ns)
+);
+
+#endif /* _TRACE_DIGSIG_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -39,6 +39,11 @@
 #define XATTR_IMA_SUFFIX "ima"
 #define XATTR_NAME_IMA XATTR_SECURITY_PREFIX XATTR_IMA_SUFFIX
 
+#define XATTR_DIGSIG_SUFFIX "digsig"
+#define XATTR_NAME_DIGSIG XATTR_SECURITY_PREFIX XATTR_DIGSIG_SUFFIX
+#define XATTR_DIGSIG_SIG_SUFFIX "digsig.sig"
+#define XATTR_NAME_DIGSIG_SIG XATTR_SECURITY_PREFIX XATTR_DIGSIG_SIG_SUFFIX
+
 #define XATTR_SELINUX_SUFFIX "selinux"
 #define XATTR_NAME_SELINUX XATTR_SECURITY_PREFIX XATTR_SELINUX_SUFFIX
 
@@ -18,6 +18,7 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/initrd.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -349,6 +350,7 @@ static int __init do_copy(void)
 		sys_write(wfd, victim, body_len);
 		sys_close(wfd);
 		do_utime(vcollected, mtime);
+		digsig_initramfs_note(vcollected);
 		kfree(vcollected);
 		eat(body_len);
 		state = SkipIt;
@@ -495,7 +497,6 @@ __setup("retain_initrd", retain_initrd_param);
 
 extern char __initramfs_start[];
 extern unsigned long __initramfs_size;
-#include <linux/initrd.h>
 #include <linux/kexec.h>
 
 static void __init free_initrd(void)
@@ -530,6 +531,52 @@ skip:
 	initrd_end = 0;
 }
 
+#ifdef CONFIG_SECURITY_DIGSIG_INITRAMFS
+static unsigned long __initdata kept_initrd_start, kept_initrd_end;
+
+/* a signed initramfs is only freed once DigSig hashed it, at late_initcall */
+static void __init keep_initrd(void)
+{
+	kept_initrd_start = initrd_start;
+	kept_initrd_end = initrd_end;
+	initrd_start = 0;
+	initrd_end = 0;
+}
+
+static int __init free_kept_initrd(void)
+{
+	if (kept_initrd_start) {
+		initrd_start = kept_initrd_start;
+		initrd_end = kept_initrd_end;
+		free_initrd();
+	}
+	return 0;
+}
+late_initcall_sync(free_kept_initrd);
+#else
+#define keep_initrd() do { } while (0)
+#endif
+
+static int __initdata initrd_signed;
+
+static char * __init unpack_initrd(void)
+{
+	unsigned long len = initrd_end - initrd_start;
+	int sig = digsig_initramfs_signed((char *)initrd_start, &len);
+	char *err = unpack_to_rootfs((char *)initrd_start, len);
+
+	initrd_signed = digsig_initramfs_unpacked(sig && !err);
+	return err;
+}
+
+static void __init release_initrd(void)
+{
+	if (initrd_signed)
+		keep_initrd();
+	else
+		free_initrd();
+}
+
 #ifdef CONFIG_BLK_DEV_RAM
 #define BUF_SIZE 1024
 static void __init clean_rootfs(void)
@@ -588,10 +635,9 @@ static int __init populate_rootfs(void)
 #ifdef CONFIG_BLK_DEV_RAM
 		int fd;
 		printk(KERN_INFO "Trying to unpack rootfs image as initramfs...\n");
-		err = unpack_to_rootfs((char *)initrd_start,
-			initrd_end - initrd_start);
+		err = unpack_initrd();
 		if (!err) {
-			free_initrd();
+			release_initrd();
 			goto done;
 		} else {
 			clean_rootfs();
@@ -610,11 +656,10 @@ static int __init populate_rootfs(void)
 	done:
 #else
 		printk(KERN_INFO "Unpacking initramfs...\n");
-		err = unpack_to_rootfs((char *)initrd_start,
-			initrd_end - initrd_start);
+		err = unpack_initrd();
 		if (err)
 			printk(KERN_EMERG "Initramfs unpacking failed: %s\n", err);
-		free_initrd();
+		release_initrd();
 #endif
 		/*
 		 * Try loading default modules from initramfs.  This gives
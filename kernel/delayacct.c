@@ -153,9 +153,12 @@ int __delayacct_add_tsk(struct taskstats *d, struct task_struct *tsk)
 	d->swapin_delay_total = (tmp < d->swapin_delay_total) ? 0 : tmp;
 	tmp = d->freepages_delay_total + tsk->delays->freepages_delay;
 	d->freepages_delay_total = (tmp < d->freepages_delay_total) ? 0 : tmp;
+	tmp = d->integrity_delay_total + tsk->delays->integrity_delay;
+	d->integrity_delay_total = (tmp < d->integrity_delay_total) ? 0 : tmp;
 	d->blkio_count += tsk->delays->blkio_count;
 	d->swapin_count += tsk->delays->swapin_count;
 	d->freepages_count += tsk->delays->freepages_count;
+	d->integrity_count += tsk->delays->integrity_count;
 	spin_unlock_irqrestore(&tsk->delays->lock, flags);
 
 done:
@@ -187,3 +190,15 @@ void __delayacct_freepages_end(void)
 			&current->delays->freepages_count);
 }
 
+void __delayacct_integrity_start(void)
+{
+	delayacct_start(&current->delays->integrity_start);
+}
+
+void __delayacct_integrity_end(void)
+{
+	delayacct_end(&current->delays->integrity_start,
+			&current->delays->integrity_end,
+			&current->delays->integrity_delay,
+			&current->delays->integrity_count);
+}
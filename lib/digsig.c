@@ -20,6 +20,7 @@
 #include <linux/err.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/key.h>
 #include <linux/crypto.h>
 #include <crypto/hash.h>
@@ -30,6 +31,132 @@
 
 static struct crypto_shash *shash;
 
+/*
+ * Public keys parsed from their user key payload, so that appraising a
+ * file does not decode the MPIs of its key again.  An entry is found by
+ * the key serial and is used only while the payload is still the one
+ * it was parsed from: updating a key replaces its payload.  The
+ * Montgomery constants of the modulus are computed with it, as
+ * x509_key_preparse() does for the keys of module signing and v2
+ * signatures, so that both verify through the same exponentiation.
+ */
+#define DIGSIG_PKEY_CACHE 8
+
+struct digsig_pkey {
+	atomic_t refs;
+	key_serial_t serial;
+	MPI mpi[2];		/* n and e */
+	struct mpi_mont_ctx *mont;	/* of n, NULL if it could not be had */
+	unsigned long mblen;	/* bits of the modulus */
+	unsigned short datalen;
+	u8 data[];		/* the payload it was parsed from */
+};
+
+static struct digsig_pkey *pkey_cache[DIGSIG_PKEY_CACHE];
+static unsigned int pkey_cache_next;
+static DEFINE_SPINLOCK(pkey_cache_lock);
+
+static void digsig_put_pkey(struct digsig_pkey *pk)
+{
+	if (pk && atomic_dec_and_test(&pk->refs)) {
+		mpi_mont_free(pk->mont);
+		mpi_free(pk->mpi[0]);
+		mpi_free(pk->mpi[1]);
+		kfree(pk);
+	}
+}
+
+static struct digsig_pkey *digsig_parse_pkey(struct key *key,
+					     struct user_key_payload *ukp)
+{
+	struct digsig_pkey *pk;
+	struct pubkey_hdr *pkh;
+	uint8_t *datap, *endp;
+	int i;
+
+	if (ukp->datalen < sizeof(*pkh))
+		return ERR_PTR(-EINVAL);
+
+	pkh = (struct pubkey_hdr *)ukp->data;
+
+	if (pkh->version != 1)
+		return ERR_PTR(-EINVAL);
+
+	if (pkh->algo != PUBKEY_ALGO_RSA)
+		return ERR_PTR(-EINVAL);
+
+	if (pkh->nmpi != 2)
+		return ERR_PTR(-EINVAL);
+
+	pk = kzalloc(sizeof(*pk) + ukp->datalen, GFP_KERNEL);
+	if (!pk)
+		return ERR_PTR(-ENOMEM);
+	atomic_set(&pk->refs, 1);
+	pk->serial = key->serial;
+	pk->datalen = ukp->datalen;
+	memcpy(pk->data, ukp->data, ukp->datalen);
+
+	datap = pkh->mpi;
+	endp = ukp->data + ukp->datalen;
+
+	for (i = 0; i < pkh->nmpi; i++) {
+		unsigned int remaining = endp - datap;
+		pk->mpi[i] = mpi_read_from_buffer(datap, &remaining);
+		if (!pk->mpi[i]) {
+			digsig_put_pkey(pk);
+			return ERR_PTR(-ENOMEM);
+		}
+		datap += remaining;
+	}
+
+	pk->mblen = mpi_get_nbits(pk->mpi[0]);
+	pk->mont = mpi_mont_alloc(pk->mpi[0]);
+	return pk;
+}
+
+/*
+ * The parsed public key of a user key, with a reference, or an ERR_PTR.
+ */
+static struct digsig_pkey *digsig_get_pkey(struct key *key)
+{
+	struct user_key_payload *ukp;
+	struct digsig_pkey *pk = NULL, *old;
+	int i;
+
+	down_read(&key->sem);
+	ukp = key->payload.data;
+
+	spin_lock(&pkey_cache_lock);
+	for (i = 0; i < DIGSIG_PKEY_CACHE; i++) {
+		old = pkey_cache[i];
+		if (old && old->serial == key->serial &&
+		    old->datalen == ukp->datalen &&
+		    !memcmp(old->data, ukp->data, ukp->datalen)) {
+			atomic_inc(&old->refs);
+			pk = old;
+			break;
+		}
+	}
+	spin_unlock(&pkey_cache_lock);
+	if (pk)
+		goto out;
+
+	pk = digsig_parse_pkey(key, ukp);
+	if (IS_ERR(pk))
+		goto out;
+
+	atomic_inc(&pk->refs);
+	spin_lock(&pkey_cache_lock);
+	old = pkey_cache[pkey_cache_next];
+	pkey_cache[pkey_cache_next] = pk;
+	pkey_cache_next = (pkey_cache_next + 1) % DIGSIG_PKEY_CACHE;
+	spin_unlock(&pkey_cache_lock);
+	digsig_put_pkey(old);
+out:
+	up_read(&key->sem);
+	return pk;
+}
+
 static const char *pkcs_1_v1_5_decode_emsa(const unsigned char *msg,
 						unsigned long  msglen,
 						unsigned long  modulus_bitlen,
@@ -71,49 +198,24 @@ static int digsig_verify_rsa(struct key *key,
 		    const char *sig, int siglen,
 		       const char *h, int hlen)
 {
-	int err = -EINVAL;
+	int err;
 	unsigned long len;
 	unsigned long mlen, mblen;
 	unsigned nret, l;
-	int head, i;
+	int head;
 	unsigned char *out1 = NULL;
 	const char *m;
-	MPI in = NULL, res = NULL, pkey[2];
-	uint8_t *p, *datap, *endp;
-	struct user_key_payload *ukp;
-	struct pubkey_hdr *pkh;
-
-	down_read(&key->sem);
-	ukp = key->payload.data;
-
-	if (ukp->datalen < sizeof(*pkh))
-		goto err1;
+	MPI in = NULL, res = NULL;
+	uint8_t *p;
+	struct digsig_pkey *pk;
 
-	pkh = (struct pubkey_hdr *)ukp->data;
-
-	if (pkh->version != 1)
-		goto err1;
-
-	if (pkh->algo != PUBKEY_ALGO_RSA)
-		goto err1;
-
-	if (pkh->nmpi != 2)
-		goto err1;
-
-	datap = pkh->mpi;
-	endp = ukp->data + ukp->datalen;
+	pk = digsig_get_pkey(key);
+	if (IS_ERR(pk))
+		return PTR_ERR(pk);
 
 	err = -ENOMEM;
 
-	for (i = 0; i < pkh->nmpi; i++) {
-		unsigned int remaining = endp - datap;
-		pkey[i] = mpi_read_from_buffer(datap, &remaining);
-		if (!pkey[i])
-			goto err;
-		datap += remaining;
-	}
-
-	mblen = mpi_get_nbits(pkey[0]);
+	mblen = pk->mblen;
 	mlen = DIV_ROUND_UP(mblen, 8);
 
 	if (mlen == 0)
@@ -132,7 +234,12 @@ static int digsig_verify_rsa(struct key *key,
 	if (!res)
 		goto err;
 
-	err = mpi_powm(res, in, pkey[1], pkey[0]);
+	/* without division if the constants are there and the MPIs fit */
+	err = -EINVAL;
+	if (pk->mont)
+		err = mpi_powm_mont(res, in, pk->mpi[1], pk->mont);
+	if (err == -EINVAL)
+		err = mpi_powm(res, in, pk->mpi[1], pk->mpi[0]);
 	if (err)
 		goto err;
 
@@ -163,10 +270,7 @@ err:
 	mpi_free(in);
 	mpi_free(res);
 	kfree(out1);
-	while (--i >= 0)
-		mpi_free(pkey[i]);
-err1:
-	up_read(&key->sem);
+	digsig_put_pkey(pk);
 
 	return err;
 }
@@ -260,6 +364,10 @@ static int __init digsig_init(void)
 
 static void __exit digsig_cleanup(void)
 {
+	int i;
+
+	for (i = 0; i < DIGSIG_PKEY_CACHE; i++)
+		digsig_put_pkey(pkey_cache[i]);
 	crypto_free_shash(shash);
 }
 
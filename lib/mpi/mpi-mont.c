@@ -0,0 +1,214 @@
+/* mpi-mont.c  -  Montgomery exponentiation for small exponents
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Note: RSA verification raises the signature to the public exponent,
+ *	 which is small (usually 65537).  mpi_powm() reduces by long
+ *	 division after every step; here the products are reduced with
+ *	 Montgomery's method instead, using constants computed once per
+ *	 modulus by mpi_mont_alloc(), when the key is parsed.
+ */
+
+#include <linux/export.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include "mpi-internal.h"
+#include "longlong.h"
+
+/* limbs of workspace mpi_powm_mont() needs */
+#define MONT_WS_LIMBS(k) (7 * (k) + 1)
+
+/*
+ * Return -1/N0 mod 2^BITS_PER_MPI_LIMB for an odd N0.  Each Newton step
+ * doubles the number of correct low bits, starting with 3.
+ */
+static mpi_limb_t mont_ninv(mpi_limb_t n0)
+{
+	mpi_limb_t inv = n0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		inv *= 2 - n0 * inv;
+	return -inv;
+}
+
+/* R^2 mod n, with R = 2^(nlimbs * BITS_PER_MPI_LIMB), into ctx->rr */
+static int mont_rr(struct mpi_mont_ctx *ctx, MPI mod)
+{
+	MPI two, exp, rr;
+	int rc = -ENOMEM;
+
+	two = mpi_alloc(1);
+	exp = mpi_alloc(1);
+	rr = mpi_alloc(ctx->nlimbs);
+	if (!two || !exp || !rr)
+		goto out;
+	two->d[0] = 2;
+	two->nlimbs = 1;
+	exp->d[0] = 2 * ctx->nlimbs * BITS_PER_MPI_LIMB;
+	exp->nlimbs = 1;
+	rc = mpi_powm(rr, two, exp, mod);
+	if (rc)
+		goto out;
+	MPN_ZERO(ctx->rr, ctx->nlimbs);
+	MPN_COPY(ctx->rr, rr->d, rr->nlimbs);
+out:
+	mpi_free(rr);
+	mpi_free(exp);
+	mpi_free(two);
+	return rc;
+}
+
+/**
+ * mpi_mont_alloc - set up the Montgomery constants of a modulus
+ * @mod: an odd, positive modulus
+ *
+ * Returns the constants, to be freed with mpi_mont_free(), or NULL if
+ * @mod is not odd or there is no memory.
+ */
+struct mpi_mont_ctx *mpi_mont_alloc(MPI mod)
+{
+	struct mpi_mont_ctx *ctx;
+	mpi_size_t k;
+
+	mpi_normalize(mod);
+	k = mod->nlimbs;
+	if (!k || mod->sign || !(mod->d[0] & 1))
+		return NULL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return NULL;
+	ctx->nlimbs = k;
+	ctx->n = mpi_alloc_limb_space(2 * k);
+	if (!ctx->n)
+		goto fail;
+	ctx->rr = ctx->n + k;
+	MPN_COPY(ctx->n, mod->d, k);
+	ctx->ninv = mont_ninv(mod->d[0]);
+	if (mont_rr(ctx, mod))
+		goto fail;
+	return ctx;
+
+fail:
+	mpi_mont_free(ctx);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(mpi_mont_alloc);
+
+void mpi_mont_free(struct mpi_mont_ctx *ctx)
+{
+	if (!ctx)
+		return;
+	if (ctx->n)
+		mpi_free_limb_space(ctx->n);
+	kfree(ctx);
+}
+EXPORT_SYMBOL_GPL(mpi_mont_free);
+
+/*
+ * Montgomery reduction: RP = TP / R mod n, for TP < n * R.  TP has
+ * 2 * nlimbs + 1 limbs, the top one zero, and is destroyed.
+ */
+static void mont_redc(mpi_ptr_t rp, mpi_ptr_t tp, struct mpi_mont_ctx *ctx)
+{
+	mpi_size_t k = ctx->nlimbs, i;
+	mpi_limb_t m, cy;
+
+	for (i = 0; i < k; i++) {
+		m = tp[i] * ctx->ninv;
+		cy = mpihelp_addmul_1(tp + i, ctx->n, k, m);
+		mpihelp_add_1(tp + i + k, tp + i + k, k + 1 - i, cy);
+	}
+
+	/* the result is below 2n, one subtraction brings it below n */
+	if (tp[2 * k] || mpihelp_cmp(tp + k, ctx->n, k) >= 0)
+		mpihelp_sub_n(rp, tp + k, ctx->n, k);
+	else
+		MPN_COPY(rp, tp + k, k);
+}
+
+/* RP = AP * BP / R mod n; TP and TSPACE are work areas */
+static void mont_mul(mpi_ptr_t rp, mpi_ptr_t ap, mpi_ptr_t bp,
+		     struct mpi_mont_ctx *ctx, mpi_ptr_t tp, mpi_ptr_t tspace)
+{
+	mpi_size_t k = ctx->nlimbs;
+
+	mpihelp_mul_n_ws(tp, ap, bp, k, tspace);
+	tp[2 * k] = 0;
+	mont_redc(rp, tp, ctx);
+}
+
+/**
+ * mpi_powm_mont - RES = BASE ^ EXP mod n, for a one-limb exponent
+ * @res: the result
+ * @base: the base, below n
+ * @exp: the exponent
+ * @ctx: the constants of n, from mpi_mont_alloc()
+ *
+ * Returns 0 on success, -ENOMEM if there is no memory, or -EINVAL,
+ * leaving @res alone, if @base is not below n or @exp is zero or more
+ * than one limb: the caller then uses mpi_powm().
+ */
+int mpi_powm_mont(MPI res, MPI base, MPI exp, struct mpi_mont_ctx *ctx)
+{
+	mpi_size_t k = ctx->nlimbs, rsize;
+	mpi_ptr_t ws, ap, am, xp, tp, tspace;
+	mpi_limb_t e;
+	int i;
+
+	mpi_normalize(exp);
+	mpi_normalize(base);
+	if (exp->nlimbs != 1 || exp->sign || base->sign || base->nlimbs > k)
+		return -EINVAL;
+	e = exp->d[0];
+
+	ws = mpi_alloc_limb_space(MONT_WS_LIMBS(k));
+	if (!ws)
+		return -ENOMEM;
+	/* a, a*R, x, the product and the multiplication scratch */
+	ap = ws;
+	am = ap + k;
+	xp = am + k;
+	tp = xp + k;
+	tspace = tp + 2 * k + 1;
+
+	MPN_ZERO(ap, k);
+	MPN_COPY(ap, base->d, base->nlimbs);
+	if (mpihelp_cmp(ap, ctx->n, k) >= 0) {
+		mpi_free_limb_space(ws);
+		return -EINVAL;
+	}
+
+	/* into the Montgomery domain, then left to right square and multiply */
+	mont_mul(am, ap, ctx->rr, ctx, tp, tspace);
+	MPN_COPY(xp, am, k);
+	for (i = BITS_PER_MPI_LIMB - 2; i >= 0 && !(e >> (i + 1)); i--)
+		;
+	for (; i >= 0; i--) {
+		mont_mul(xp, xp, xp, ctx, tp, tspace);
+		if (e & ((mpi_limb_t)1 << i))
+			mont_mul(xp, xp, am, ctx, tp, tspace);
+	}
+
+	/* and back out of it */
+	MPN_ZERO(tp, 2 * k + 1);
+	MPN_COPY(tp, xp, k);
+	mont_redc(xp, tp, ctx);
+
+	if (RESIZE_IF_NEEDED(res, k) < 0) {
+		mpi_free_limb_space(ws);
+		return -ENOMEM;
+	}
+	MPN_COPY(res->d, xp, k);
+	rsize = k;
+	MPN_NORMALIZE(res->d, rsize);
+	res->nlimbs = rsize;
+	res->sign = 0;
+	mpi_free_limb_space(ws);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mpi_powm_mont);
@@ -330,6 +330,18 @@ mpih_sqr_n(mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t size, mpi_ptr_t tspace)
 	}
 }
 
+/* Multiply two SIZE limb numbers, with TSPACE of 2 * SIZE limbs to work in. */
+void
+mpihelp_mul_n_ws(mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp,
+		 mpi_size_t size, mpi_ptr_t tspace)
+{
+	if (up == vp) {
+		MPN_SQR_N_RECURSE(prodp, up, size, tspace);
+	} else {
+		MPN_MUL_N_RECURSE(prodp, up, vp, size, tspace);
+	}
+}
+
 int
 mpihelp_mul_karatsuba_case(mpi_ptr_t prodp,
 			   mpi_ptr_t up, mpi_size_t usize,
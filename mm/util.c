@@ -363,7 +363,19 @@ unsigned long vm_mmap_pgoff(struct file *file, unsigned long addr,
 		down_write(&mm->mmap_sem);
 		ret = do_mmap_pgoff(file, addr, len, prot, flag, pgoff,
 				    &populate);
+		if (file && !IS_ERR_VALUE(ret)) {
+			int err = security_file_mmapped(file, ret, len);
+
+			if (err) {
+				do_munmap(mm, ret, len);
+				ret = err;
+				populate = 0;
+			}
+		}
 		up_write(&mm->mmap_sem);
+		if (!populate && file && !IS_ERR_VALUE(ret))
+			populate = security_mmap_populate(file, prot, flag,
+							  len);
 		if (populate)
 			mm_populate(ret, populate);
 	}
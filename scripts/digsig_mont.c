@@ -0,0 +1,170 @@
+/*
+ * digsig_mont: generate the Montgomery constants of the DigSig built-in key
+ *
+ * Reads the public key as "digsig-sign -P" writes it, n then e as two
+ * OpenPGP MPIs back to back, and writes a C header to stdout for
+ * security/digsig/digsig_builtin_mont.c: the modulus, R^2 mod n and
+ * -1/n mod 2^BITS_PER_MPI_LIMB for both 32 and 64 bit limbs, and the
+ * square and multiply ladder of the exponent, unrolled.  A key this
+ * can not do, Ed25519, an even modulus or an exponent of more than 32
+ * bits, gives a header that only says so; the key is then verified
+ * with the constants computed at boot, as any other.
+ *
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* n of up to 4096 bits, in 32 bit words, least significant first */
+#define MAX_WORDS 128
+
+static unsigned char key[2 * (2 + MAX_WORDS * 4) + 1];
+static uint32_t n[MAX_WORDS + 1];
+static int nwords, nbits;
+static uint32_t e;
+
+/* the OpenPGP MPI at p into w, least significant word first */
+static int read_mpi(const unsigned char *p, size_t len, uint32_t *w,
+		    int max, int *bits)
+{
+	size_t bytes, i;
+
+	if (len < 2)
+		return -1;
+	*bits = p[0] << 8 | p[1];
+	bytes = (*bits + 7) / 8;
+	if (2 + bytes > len || bytes > (size_t)max * 4)
+		return -1;
+	memset(w, 0, max * sizeof(*w));
+	for (i = 0; i < bytes; i++)
+		w[i / 4] |= (uint32_t)p[2 + bytes - 1 - i] << (8 * (i % 4));
+	return 2 + bytes;
+}
+
+/* x = 2x mod n, for x < n */
+static void double_mod(uint32_t *x)
+{
+	uint32_t top = 0, t;
+	uint64_t d;
+	int i, ge;
+
+	for (i = 0; i < nwords; i++) {
+		t = x[i] >> 31;
+		x[i] = x[i] << 1 | top;
+		top = t;
+	}
+	ge = top;
+	if (!ge) {
+		for (i = nwords - 1; i >= 0 && x[i] == n[i]; i--)
+			;
+		ge = i < 0 || x[i] > n[i];
+	}
+	if (!ge)
+		return;
+	for (i = 0, d = 0; i < nwords; i++) {
+		d = (uint64_t)x[i] - n[i] - d;
+		x[i] = (uint32_t)d;
+		d = d >> 63;
+	}
+}
+
+/* the words of x as limbs of the given size */
+static void print_limbs(const char *name, const uint32_t *x, int limbs,
+			int limb_bits)
+{
+	int i;
+
+	printf("#define DIGSIG_BUILTIN_MONT_%s { \\\n", name);
+	for (i = 0; i < limbs; i++) {
+		if (limb_bits == 64)
+			printf("\t0x%08x%08xUL,", x[2 * i + 1], x[2 * i]);
+		else
+			printf("\t0x%08xUL,", x[i]);
+		printf(i % 2 || i == limbs - 1 ? " \\\n" : "");
+	}
+	printf("}\n");
+}
+
+static void print_limb_size(int limb_bits)
+{
+	int limbs = (nbits + limb_bits - 1) / limb_bits;
+	int i;
+	uint32_t rr[MAX_WORDS + 1] = { 1 };
+	uint64_t inv = n[0] | (uint64_t)n[1] << 32;
+	uint64_t n0 = inv;
+
+	/* R^2 mod n, R = 2^(limbs * limb_bits), by doubling 1 */
+	for (i = 0; i < 2 * limbs * limb_bits; i++)
+		double_mod(rr);
+
+	/* each Newton step doubles the correct low bits, from 3 */
+	for (i = 0; i < 6; i++)
+		inv *= 2 - n0 * inv;
+	inv = -inv;
+	if (limb_bits == 32)
+		inv &= 0xffffffff;
+
+	printf("#define DIGSIG_BUILTIN_MONT_K %d\n", limbs);
+	printf("#define DIGSIG_BUILTIN_MONT_NINV 0x%llxUL\n",
+	       (unsigned long long)inv);
+	print_limbs("N", n, limbs, limb_bits);
+	print_limbs("RR", rr, limbs, limb_bits);
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *f;
+	size_t len;
+	uint32_t ew[1];
+	int nlen, elen, ebits, i;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s pubkey\n", argv[0]);
+		return 1;
+	}
+	f = fopen(argv[1], "rb");
+	if (!f) {
+		perror(argv[1]);
+		return 1;
+	}
+	len = fread(key, 1, sizeof(key), f);
+	fclose(f);
+
+	printf("/* generated by scripts/digsig_mont from %s, do not edit */\n\n",
+	       argv[1]);
+
+	nlen = read_mpi(key, len, n, MAX_WORDS, &nbits);
+	elen = nlen < 0 ? -1 : read_mpi(key + nlen, len - nlen, ew, 1, &ebits);
+	if (len == sizeof(key) || nlen < 0 || elen < 0 ||
+	    nlen + elen != (int)len ||
+	    nbits < 64 || !(n[0] & 1) || !ew[0]) {
+		printf("/* not an RSA key the constants can be generated for */\n");
+		return 0;
+	}
+	e = ew[0];
+	nwords = (nbits + 31) / 32;
+	/* the words up to the next 64 bit limb are zero */
+	n[nwords] = 0;
+
+	printf("#define DIGSIG_BUILTIN_MONT_BITS %d\n", nbits);
+	printf("#define DIGSIG_BUILTIN_MONT_E %uU\n\n", e);
+
+	/* from the bit under the top one down, square, then multiply if set */
+	printf("#define DIGSIG_BUILTIN_MONT_LADDER(S, M) \\\n");
+	for (i = 31; !(e >> i); i--)
+		;
+	while (--i >= 0)
+		printf("\tS%s \\\n", e >> i & 1 ? " M" : "");
+	printf("\n");
+
+	printf("#if BITS_PER_MPI_LIMB == 64\n");
+	print_limb_size(64);
+	printf("#else\n");
+	print_limb_size(32);
+	printf("#endif\n");
+	return 0;
+}
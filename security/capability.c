@@ -326,6 +326,18 @@ static int cap_file_ioctl(struct file *file, unsigned int command,
 	return 0;
 }
 
+static unsigned long cap_mmap_populate(struct file *file, unsigned long prot,
+				       unsigned long flags, unsigned long len)
+{
+	return 0;
+}
+
+static int cap_file_mmapped(struct file *file, unsigned long addr,
+			    unsigned long len)
+{
+	return 0;
+}
+
 static int cap_file_mprotect(struct vm_area_struct *vma, unsigned long reqprot,
 			     unsigned long prot)
 {
@@ -993,6 +1005,8 @@ void __init security_fixup_ops(struct security_operations *ops)
 	set_to_cap_if_null(ops, file_ioctl);
 	set_to_cap_if_null(ops, mmap_addr);
 	set_to_cap_if_null(ops, mmap_file);
+	set_to_cap_if_null(ops, mmap_populate);
+	set_to_cap_if_null(ops, file_mmapped);
 	set_to_cap_if_null(ops, file_mprotect);
 	set_to_cap_if_null(ops, file_lock);
 	set_to_cap_if_null(ops, file_fcntl);
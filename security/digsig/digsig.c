@@ -20,7 +20,6 @@
 
 
 #include <linux/init.h>
-#include <linux/genhd.h> /* for accessing bus name in is_unprotected_file() */
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/kernel.h>
@@ -30,23 +29,79 @@
 #include <linux/sched.h>
 #include <linux/personality.h>
 #include <linux/elf.h>
+#include <linux/binfmts.h>
 #include <linux/fs.h>
 #include <linux/dcache.h>
 #include <linux/kobject.h>
 #include <linux/mman.h>
 #include <linux/version.h>
-#include <linux/semaphore.h>
 #include <linux/uaccess.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/file.h>
+#include <linux/delayacct.h>
+#include <linux/prefetch.h>
 
 #include "digsig_verify.h"
 #include "digsig_common.h"
 #include "digsig_sysfs.h"
 #include "digsig_cache.h"
+#include "digsig_ghost.h"
 #include "digsig_revocation.h"
+#include "digsig_inflight.h"
+#include "digsig_xattr.h"
+#include "digsig_verity.h"
+#include "digsig_sb.h"
+#include "digsig_sb_bitmap.h"
+#include "digsig_bundle.h"
+#include "digsig_replay.h"
+#include "digsig_loop.h"
+#include "digsig_stats.h"
+#include "digsig_inode.h"
+#include "digsig_keyring.h"
+#include "digsig_chunk.h"
+#include "digsig_ahash.h"
+#include "digsig_preload.h"
+#include "digsig_profile.h"
+#include "digsig_handover.h"
+#include "digsig_query.h"
+#include "digsig_tree.h"
+#include "digsig_top.h"
+#include "digsig_boot.h"
+#include "digsig_hashsel.h"
+#include "digsig_engine.h"
+#include "digsig_sbstats.h"
+#include "digsig_lockstat.h"
+#include "digsig_views.h"
+#include "digsig_segments.h"
+#include "digsig_manifest.h"
+#include "digsig_nfs4.h"
+#include "digsig_builtin.h"
+#include "digsig_detached.h"
+#include "digsig_recent.h"
+#include "digsig_resume.h"
+#include "digsig_digest.h"
+#include "digsig_memo.h"
+#include "digsig_reflink.h"
+#include "digsig_sched.h"
+#include "digsig_offload.h"
+#include "digsig_revoke_rules.h"
+#include "digsig_revoke_db.h"
+#include "digsig_bulk.h"
+#include "digsig_async.h"
+#include "digsig_installer.h"
+#include "digsig_ioprio.h"
+#include "digsig_screen.h"
 
 #include "gnupg/mpi/mpi.h"
 #include "gnupg/cipher/rsa-verify.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/digsig.h>
+
 #ifdef CONFIG_SECURITY_DIGSIG_DEBUG
 #define DIGSIG_MODE 0		/*permissive  mode */
 #define DIGSIG_BENCH 1
@@ -55,20 +110,13 @@
 #define DIGSIG_BENCH 0
 #endif
 
-#define get_inode_security(ino) ((unsigned long)(ino->i_security))
-#define set_inode_security(ino, val) (ino->i_security = (void *)val)
-
 #define get_file_security(file) ((unsigned long)(file->f_security))
 #define set_file_security(file, val) (file->f_security = (void *)val)
 
-unsigned long int total_jiffies = 0;
-
-/* Allocate and free functions for each kind of security blob. */
-static DEFINE_SEMAPHORE(digsig_sem);
-
 /* Status code indicating whether the module has been provided with a key.
  * 0 is the default state and the hooks will be disabled. */
 int g_init = 0;
+struct static_key digsig_active_key = STATIC_KEY_INIT_FALSE;
 
 #ifdef CONFIG_SECURITY_DIGSIG_LOG
 int DigsigDebugLevel = DEBUG_INIT | DEBUG_SIGN;
@@ -80,41 +128,159 @@ int dsi_cache_buckets = 128;
 module_param(dsi_cache_buckets, int, 0);
 MODULE_PARM_DESC(dsi_cache_buckets, "Number of cache buckets for signatures validations.\n");
 
+/*
+ * May be turned off at runtime, to roll DigSig out, but turned on only
+ * until the key is loaded: once enforcing, root may not let everything
+ * through with one write.
+ */
+static int dsi_audit = 0;
+
+static int digsig_audit_set(const char *val, const struct kernel_param *kp)
+{
+	int audit, rc;
+
+	rc = kstrtoint(val, 0, &audit);
+	if (rc)
+		return rc;
+	if (audit && g_init)
+		return -EPERM;
+	*(int *)kp->arg = audit;
+	return 0;
+}
+
+static struct kernel_param_ops digsig_audit_ops = {
+	.set = digsig_audit_set,
+	.get = param_get_int,
+};
+module_param_cb(dsi_audit, &digsig_audit_ops, &dsi_audit, 0644);
+MODULE_PARM_DESC(dsi_audit, "Let every file through, verify it in the background and report those that would be denied.\n");
+
+int dsi_charge = 0;
+module_param(dsi_charge, int, 0);
+MODULE_PARM_DESC(dsi_charge, "Verify files in the task that maps them only, so that its cgroups are charged.\n");
+
+static int dsi_nontemporal_mb = 64;
+module_param(dsi_nontemporal_mb, int, 0644);
+MODULE_PARM_DESC(dsi_nontemporal_mb, "MiB from which a file is hashed without filling the CPU caches, 0 never to.\n");
+
+static int dsi_prefault_kb = 0;
+module_param(dsi_prefault_kb, int, 0644);
+MODULE_PARM_DESC(dsi_prefault_kb, "KiB of a verified executable mapping to fault in as it is made, 0 not to.\n");
+
 
 /******************************************************************************
 Description :
- * For a file being opened for write, check:
- * 1. whether it is a library currently being dlopen'ed.  If it is, then
- *    inode->i_security > 0.
- * 2. whether the file being opened is an executable or library with a
- *    cached signature validation.  If it is, remove the signature validation
- *    entry so that on the next load, the signature will be recomputed.
+ * For a file being opened for write, check whether it is a library
+ * currently being dlopen'ed.  If it is, then its writer count in the
+ * inode security blob is > 0.
  *
  * We the write to happen and check the signature when loading to
  * decide about the validity of the action.  Not because the hacker
  * can modify the file that he could compromise the system.  Because,
  * the new library needs to have a valid signature (i.e. the admin
  * must use the right private key to sign his library) to get loaded.
+ * The cached validation is dropped where the contents change, below.
 Parameters  :
 Return value:
 ******************************************************************************/
 static int
 digsig_inode_permission(struct inode *inode, int mask)
 {
-	if (!g_init)
+	if (!digsig_active())
 		return 0;
 
 	if (inode && mask & MAY_WRITE) {
-		unsigned long isec = get_inode_security(inode);
-		if (isec > 0)
+		struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+		if (!isec)
+			return 0;
+		if (atomic_read(&isec->writers) > 0)
+			return -EPERM;
+		/* its filesystem was remounted, or it made mutable, since */
+		if (test_bit(DIGSIG_INODE_UNCOUNTED, &isec->flags) &&
+		    mapping_mapped(inode->i_mapping))
 			return -EPERM;
-		if (is_cached_signature(inode))
-			remove_signature(inode);
 	}
 
 	return 0;
 }
 
+/*
+ * The contents of the inode may be changing: forget its verdict, so that
+ * the signature is checked again on the next load.  Inodes that were
+ * never mapped for execution have no blob and stop at the first test.
+ */
+static void digsig_inode_changed(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (!isec)
+		return;
+	if (test_bit(DIGSIG_INODE_VERIFIED, &isec->flags) ||
+	    test_bit(DIGSIG_INODE_BAD, &isec->flags) ||
+	    test_bit(DIGSIG_INODE_DENIED, &isec->flags))
+		digsig_inode_invalidate(inode);
+	if (test_bit(DIGSIG_INODE_CACHED, &isec->flags))
+		remove_signature(inode);
+	digsig_resume_forget(inode);
+	digsig_digest_forget(inode);
+	digsig_reflink_forget(inode);
+	digsig_segments_forget(inode);
+}
+
+/*
+ * Opened for writing, truncated on open included.  Opened for reading,
+ * it may be a library about to be mapped: its verification may start.
+ */
+static int digsig_file_open(struct file *file, const struct cred *cred)
+{
+	if (!digsig_active())
+		return 0;
+	if (file->f_mode & FMODE_WRITE) {
+		digsig_xattr_forget(file->f_dentry, 0);
+		digsig_inode_changed(file_inode(file));
+	} else
+		digsig_preload_open_file(file, cred);
+	return 0;
+}
+
+/* each write, through a file that may have been opened before the blob */
+static int digsig_file_permission(struct file *file, int mask)
+{
+	if (digsig_active() && (mask & MAY_WRITE))
+		digsig_inode_changed(file_inode(file));
+	return 0;
+}
+
+/*
+ * truncate(2) and ftruncate(2) do not open the file.  The stamp goes
+ * with any change of attributes, the times set back by utimensat(2)
+ * included; notify_change() holds i_mutex.
+ */
+static int digsig_inode_setattr(struct dentry *dentry, struct iattr *attr)
+{
+	if (!digsig_active() || !dentry->d_inode)
+		return 0;
+	digsig_xattr_forget(dentry, 1);
+	if (attr->ia_valid & ATTR_SIZE)
+		digsig_inode_changed(dentry->d_inode);
+	return 0;
+}
+
+/*
+ * A shared writable mapping changes the file without write().  Only the
+ * signed pages of a file signed by segment may be made executable.
+ */
+static int digsig_file_mprotect(struct vm_area_struct *vma,
+				unsigned long reqprot, unsigned long prot)
+{
+	if (!digsig_active() || !vma->vm_file)
+		return 0;
+	if ((vma->vm_flags & VM_SHARED) && (prot & PROT_WRITE))
+		digsig_inode_changed(file_inode(vma->vm_file));
+	return digsig_segments_mprotect(vma, prot);
+}
+
 /******************************************************************************
 Description :
  * If an inode is unlinked, we don't want to hang onto it's
@@ -125,146 +291,117 @@ Return value:
 static int
 digsig_inode_unlink(struct inode *dir, struct dentry *dentry)
 {
-	if (!g_init)
-		return 0;
-
-	if (!is_cached_signature(dentry->d_inode))
+	if (!digsig_active())
 		return 0;
 
-	remove_signature(dentry->d_inode);
+	digsig_inode_invalidate(dentry->d_inode);
+	digsig_recent_forget(dentry->d_inode);
+	if (digsig_inode_cached(dentry->d_inode))
+		remove_signature(dentry->d_inode);
 	return 0;
 }
 
-static char *digsig_read_signature(struct file *file, unsigned long offset)
+/*
+ * Copy len bytes of the file at pos into buf, short at the end of the
+ * file.  Page cache files are copied straight from their pages, and the
+ * last page copied from is kept in the context: the ELF header, section
+ * table and signature of a small binary, or the table after the
+ * signature appended to a large one, then share a page lookup.
+ */
+static int digsig_read_file(SIGCTX *ctx, struct file *file, loff_t pos,
+			    char *buf, unsigned long len)
 {
-	int retval;
-	char *buffer = kmalloc(DIGSIG_ELF_SIG_SIZE, DIGSIG_SAFE_ALLOC);
+	struct address_space *mapping = file->f_mapping;
+	loff_t i_size = i_size_read(file->f_dentry->d_inode);
+	unsigned long done = 0, off, n;
+	struct page *page;
+	pgoff_t index;
 
-	if (!buffer) {
-		DSM_ERROR("kmalloc failed in %s for buffer.\n", __func__);
-		return NULL;
-	}
-	retval = kernel_read(file, offset, (char *) buffer,
-					 DIGSIG_ELF_SIG_SIZE);
-	if (retval != DIGSIG_ELF_SIG_SIZE) {
-		DSM_PRINT(DEBUG_SIGN, "%s: Unable to read signature: %d\n",
-			  __func__, retval);
-		kfree(buffer);
-		buffer = NULL;
-	}
+	if (!mapping || !mapping->a_ops->readpage)
+		return kernel_read(file, pos, buf, len);
 
-	return buffer;
+	if (pos >= i_size)
+		return 0;
+	len = min_t(loff_t, len, i_size - pos);
+	while (done < len) {
+		index = (pos + done) >> PAGE_CACHE_SHIFT;
+		page = ctx->meta_page;
+		if (!page || ctx->meta_index != index) {
+			page = read_mapping_page(mapping, index, file);
+			if (IS_ERR(page))
+				return PTR_ERR(page);
+			if (ctx->meta_page)
+				page_cache_release(ctx->meta_page);
+			ctx->meta_page = page;
+			ctx->meta_index = index;
+		}
+
+		off = (pos + done) & ~PAGE_MASK;
+		n = min_t(unsigned long, len - done, PAGE_CACHE_SIZE - off);
+		memcpy(buf + done, kmap(page) + off, n);
+		kunmap(page);
+		done += n;
+	}
+	return done;
 }
 
-/******************************************************************************
-Description : find signature section in elf binary
-              caller is responsible for deallocating memory of buffer returned
-Parameters  :
-   elf_ex  is elf header
-   elf_shdata is all entries in section header table of elf
-   file contains file handle of binary
-   sh_offset is offset of signature section in elf. sh_offset is set to offset
-      of signature section in elf
-Return value: Upon suscess: buffer containing signature (size of signature is fixed
-              depending on algorithm used)
-              Failure: null pointer
-******************************************************************************/
-static char *digsig_find_signature32(struct elf32_hdr *elf_ex,
-				Elf32_Shdr *elf_shdata, struct file *file,
-				unsigned long *sh_offset)
+static char *digsig_read_signature(SIGCTX *ctx, struct file *file,
+				   loff_t offset, unsigned long size)
 {
-	int i = 0;
-	char *buffer;
+	int retval;
 
-	while (i < elf_ex->e_shnum
-	       && elf_shdata[i].sh_type != DIGSIG_ELF_SIG_SECTION) {
-		i++;
+	retval = digsig_read_file(ctx, file, offset, ctx->sig, size);
+	if (retval != size) {
+		DSM_PRINT(DEBUG_SIGN, "%s: Unable to read signature: %d\n",
+			  __func__, retval);
+		return NULL;
 	}
 
-	if (i == elf_ex->e_shnum)
-		return NULL;
-	if (elf_shdata[i].sh_type != DIGSIG_ELF_SIG_SECTION)
-		return NULL;
-	if (elf_shdata[i].sh_size != DIGSIG_ELF_SIG_SIZE)
-		return NULL;
+	return ctx->sig;
+}
 
-	buffer = digsig_read_signature(file, elf_shdata[i].sh_offset);
-	if (!buffer)
-		return NULL;
+/* where the lookups of digsig_format.c read the file from */
+struct digsig_read_src {
+	SIGCTX *ctx;
+	struct file *file;
+};
 
-	*sh_offset = elf_shdata[i].sh_offset;
+static int digsig_read_src(void *src, loff_t pos, char *buf,
+			   unsigned long len)
+{
+	struct digsig_read_src *s = src;
 
-	return buffer;
+	return digsig_read_file(s->ctx, s->file, pos, buf, len);
 }
 
-static char *digsig_find_signature64(struct elf64_hdr *elf_ex,
-				Elf64_Shdr *elf_shdata, struct file *file,
-				unsigned long *sh_offset)
+/* Feed the bytes, as they are in the file, to the digest shared with IMA. */
+static inline void digsig_share_update(SIGCTX *ctx, const char *buf,
+				       unsigned int len)
 {
-	int i = 0;
-	char *buffer;
-
-	while (i < elf_ex->e_shnum
-	       && elf_shdata[i].sh_type != DIGSIG_ELF_SIG_SECTION) {
-		i++;
-	}
-
-	if (i == elf_ex->e_shnum)
-		return NULL;
-	if (elf_shdata[i].sh_type != DIGSIG_ELF_SIG_SECTION)
-		return NULL;
-	if (elf_shdata[i].sh_size != DIGSIG_ELF_SIG_SIZE)
-		return NULL;
-
-	buffer = digsig_read_signature(file, elf_shdata[i].sh_offset);
-	if (!buffer)
-		return NULL;
-
-	*sh_offset = elf_shdata[i].sh_offset;
+	if (ctx->share && crypto_shash_update(ctx->share_desc, buf, len))
+		ctx->share = 0;
+}
 
-	return buffer;
+/* Report the progress of the hashing, from the position from to to. */
+static inline void digsig_hash_progress(struct file *file, loff_t from,
+					loff_t to, loff_t i_size)
+{
+	if ((from ^ to) & ~(DIGSIG_PROGRESS_STEP - 1))
+		trace_digsig_verify_progress(file, to, i_size);
 }
 
-/******************************************************************************
-Description : verify if signature matches binary's signature
-Parameters  :
-   filename of elf executable
-   elf_shdata is the data of the signature section
-   sig_orig is the original signature of the binary
-   file is the file handle of the binary
-   sh_offset is offset of signature section in elf
-Return value: 0 for false or 1 for true or -1 for error
-******************************************************************************/
-static int
-digsig_verify_signature(char *sig_orig, struct file *file,
-		 unsigned long sh_offset)
+/*
+ * Hash the file through kernel_read(), one block at a time.  Used for
+ * files whose mapping can not hand out its pages.  Like the page cache
+ * walk below, this gives up if the task is killed.
+ */
+static int digsig_hash_file_read(SIGCTX *ctx, struct file *file,
+				 loff_t sh_offset, unsigned long sig_size)
 {
-	char *read_blocks = NULL;
-	int retval = -EPERM;
-	unsigned int lower, upper, offset;
+	char *read_blocks = ctx->read_block;
+	int retval = 0;
+	loff_t lower, upper, offset;
 	loff_t i_size;
-	SIGCTX *ctx = NULL;
-
-	down(&digsig_sem);
-	if (digsig_is_revoked_sig(sig_orig)) {
-		DSM_ERROR("%s: Refusing attempt to load an ELF file with"
-			  " a revoked signature.\n", __func__);
-		goto out;
-	}
-
-	retval = -ENOMEM;
-	ctx = digsig_sign_verify_init(HASH_SHA1, SIGN_RSA);
-	if (!ctx) {
-		DSM_PRINT(DEBUG_SIGN,
-			  "%s: Cannot allocate crypto context.\n", __func__);
-		goto out;
-	}
-
-	read_blocks = kmalloc(DIGSIG_ELF_READ_BLOCK_SIZE, DIGSIG_SAFE_ALLOC);
-	if (!read_blocks) {
-		DSM_ERROR("kmalloc failed in %s for read_block.\n", __func__);
-		goto out;
-	}
 
 	i_size = i_size_read(file->f_dentry->d_inode);
 	for (offset = 0; offset < i_size; offset += DIGSIG_ELF_READ_BLOCK_SIZE) {
@@ -275,15 +412,16 @@ digsig_verify_signature(char *sig_orig, struct file *file,
 			DSM_PRINT(DEBUG_SIGN,
 				  "%s: Unable to read signature in blocks: %d\n",
 				  __func__, retval);
-			goto out;
+			return retval ? retval : -EIO;
 		}
+		digsig_share_update(ctx, read_blocks, retval);
 
 		/* Makan: This is in order to avoid building a buffer
 		   inside the kernel. At each read we check to be sure
 		   that the parts of the signature read are set to 0 */
 		/* Must zero out signature section to match bsign mechanism */
 		lower = sh_offset;	/* lower bound of memset */
-		upper = sh_offset + DIGSIG_ELF_SIG_SIZE;	/* upper bound */
+		upper = sh_offset + sig_size;	/* upper bound */
 
 		if ((lower < offset + DIGSIG_ELF_READ_BLOCK_SIZE) &&
 		    (offset < upper)) {
@@ -301,288 +439,952 @@ digsig_verify_signature(char *sig_orig, struct file *file,
 		if (retval < 0) {
 			DSM_PRINT(DEBUG_SIGN,
 				  "%s: Error updating crypto verification\n", __func__);
-			goto out;
+			return retval;
 		}
+		digsig_hash_progress(file, offset,
+				     offset + DIGSIG_ELF_READ_BLOCK_SIZE, i_size);
+		if (fatal_signal_pending(current))
+			return -EINTR;
+		cond_resched();
 	}
 
-	/* A bit of bsign formatting else hashes won't match, works with bsign v0.4.4 */
-	retval = digsig_sign_verify_final(ctx, DIGSIG_ELF_SIG_SIZE,
-					    sig_orig + DIGSIG_BSIGN_INFOS);
-	if (retval != 0) {
-		DSM_PRINT(DEBUG_SIGN,
-			  "%s: Error calculating final crypto verification\n", __func__);
-		retval = -EPERM;
-		goto out;
-	}
-
-	// retval = 0;
-
-out:
-	kfree(read_blocks);
-	if (ctx) {
-		kfree(ctx->tvmem);
-		kfree(ctx);
-	}
-	up(&digsig_sem);
-	return retval;
+	return 0;
 }
 
 /*
- * If the file is opened for writing, deny mmap(PROT_EXEC) access.
- * Otherwise, increment the inode->i_security, which is our own
- * writecount.  When the file is closed, f->f_security will be 1,
- * and so we will decrement the inode->i_security.
- * Just to be clear:  file->f_security is 1 or 0.  inode->i_security
- * is the *number* of processes which have this file mmapped(PROT_EXEC),
- * so it can be >1.
+ * Bytes hashed in one update in a large file, fetched the update before.
+ * prefetch() is prefetchnta on x86, which brings the lines close to the
+ * CPU without keeping them in L2 and L3: hashing a file of a gigabyte
+ * then leaves the working set of the other tasks of the socket alone.
+ * A piece ahead is enough to cover the memory latency, and little
+ * enough to still be in L1 when it is hashed.
  */
-static int digsig_deny_write_access(struct file *file)
+#define DIGSIG_NT_PIECE 4096
+
+/* Hash the bytes, and feed them to the digest shared with IMA. */
+static int digsig_hash_bytes(SIGCTX *ctx, char *p, loff_t len)
 {
-	struct inode *inode = file->f_dentry->d_inode;
-	unsigned long isec;
+	loff_t n;
+	int retval;
 
-	spin_lock(&inode->i_lock);
-	isec = get_inode_security(inode);
-	if (atomic_read(&inode->i_writecount) > 0) {
-		spin_unlock(&inode->i_lock);
-		return -ETXTBSY;
+	if (!ctx->nontemporal) {
+		digsig_share_update(ctx, p, len);
+		return digsig_sign_verify_update(ctx, p, len);
 	}
-	set_inode_security(inode, (isec+1));
-	set_file_security(file, 1);
-	spin_unlock(&inode->i_lock);
 
+	prefetch_range(p, min_t(loff_t, len, DIGSIG_NT_PIECE));
+	for (; len > 0; p += n, len -= n) {
+		n = min_t(loff_t, len, DIGSIG_NT_PIECE);
+		if (len > n)
+			prefetch_range(p + n,
+				       min_t(loff_t, len - n, DIGSIG_NT_PIECE));
+		digsig_share_update(ctx, p, n);
+		retval = digsig_sign_verify_update(ctx, p, n);
+		if (retval)
+			return retval;
+	}
 	return 0;
 }
 
 /*
- * decrement our writer count on the inode.  When it hits 0, we will
- * again allow opening the inode for writing.
+ * Hash the bytes [start, end) of the file, within the pages mapped
+ * together at kaddr, the first of them the page of start.  The part
+ * overlapping the signature section is hashed from the zero page
+ * instead, as bsign hashed it zeroed.
  */
-static void digsig_allow_write_access(struct file *file)
+static int digsig_hash_range(SIGCTX *ctx, char *kaddr, loff_t start,
+			     loff_t end, loff_t sh_offset,
+			     unsigned long sig_size)
 {
-	struct inode *inode = file->f_dentry->d_inode;
-	unsigned long isec;
-
-	spin_lock(&inode->i_lock);
-	isec = get_inode_security(inode);
-	set_inode_security(inode, (isec-1));
-	set_file_security(file, 0);
-	spin_unlock(&inode->i_lock);
+	loff_t lower = sh_offset, upper = sh_offset + sig_size, len;
+	char *zeroes = page_address(ZERO_PAGE(0));
+	int retval = 0;
+
+	kaddr -= start & PAGE_MASK;	/* at the byte start is at */
+	if (end <= lower || start >= upper)
+		return digsig_hash_bytes(ctx, kaddr + start, end - start);
+
+	lower = max(lower, start);
+	upper = min(upper, end);
+	if (lower > start)
+		retval = digsig_hash_bytes(ctx, kaddr + start, lower - start);
+	/* IMA takes the signature as it is, the hash zeroes in its place */
+	digsig_share_update(ctx, kaddr + lower, upper - lower);
+	for (; !retval && lower < upper; lower += len) {
+		len = min_t(loff_t, upper - lower, PAGE_SIZE);
+		retval = digsig_sign_verify_update(ctx, zeroes, len);
+	}
+	if (!retval && end > upper)
+		retval = digsig_hash_bytes(ctx, kaddr + upper, end - upper);
+	return retval;
 }
 
 /*
- * the file is being closed.  If we ever mmaped it for exec, then
- * file->f_security>0, and we decrement the inode usage count to
- * show that we are done with it.
+ * Pages hashed in one update.  The SIMD hash drivers save the FPU state
+ * and turn preemption off around each update: 64 KiB at a time makes
+ * up for the save, and keeps preemption off for no more than about a
+ * hundred microseconds at the speed of these drivers.
  */
-static void digsig_file_free_security(struct file *file)
-{
-	if (file->f_security)
-		digsig_allow_write_access(file);
-}
+#define DIGSIG_HASH_RUN 16
 
-/**
- * Basic verification of an ELF header
- *
- * @param elf_hdr pointer to an elfhdr
- * @return 0 if header ok, -2 if non-elf, -1 otherwise
+/*
+ * Hash the bytes [start, end) of the file, held by the n pages of run,
+ * the first the page of start.  The pages are mapped together so that
+ * the hash sees them in one update, or one at a time if they can not be.
  */
-static inline int elf_sanity_check32(struct elf32_hdr *elf_hdr)
+static int digsig_hash_run(SIGCTX *ctx, struct page **run, unsigned int n,
+			   loff_t start, loff_t end, loff_t sh_offset,
+			   unsigned long sig_size)
 {
-	if (memcmp(elf_hdr->e_ident, ELFMAG, SELFMAG) != 0) {
-		DSM_PRINT(DEBUG_SIGN, "%s: Binary is not elf format\n",
-			  __func__);
-		return -2;
+	unsigned int i;
+	loff_t next;
+	char *kaddr;
+	int retval = 0;
+
+	kaddr = n > 1 ? vm_map_ram(run, n, -1, PAGE_KERNEL) : NULL;
+	if (kaddr) {
+		retval = digsig_hash_range(ctx, kaddr, start, end, sh_offset,
+					   sig_size);
+		vm_unmap_ram(kaddr, n);
+		return retval;
 	}
 
-	if (!elf_hdr->e_shoff) {
-		DSM_ERROR("%s: No section header!\n", __func__);
-		return -1;
+	for (i = 0; i < n && !retval; i++, start = next) {
+		next = min_t(loff_t, end,
+			     ((start >> PAGE_CACHE_SHIFT) + 1) << PAGE_CACHE_SHIFT);
+		retval = digsig_hash_range(ctx, kmap(run[i]), start, next,
+					   sh_offset, sig_size);
+		kunmap(run[i]);
 	}
+	return retval;
+}
 
-	if (elf_hdr->e_shentsize != sizeof(Elf32_Shdr)) {
-		DSM_ERROR("%s: Section header is wrong size!\n", __func__);
-		return -1;
-	}
+/*
+ * Start reading the whole file in the background as soon as we know it
+ * will be verified, so that the hashing below does not wait for one
+ * small synchronous read per page.
+ */
+static void digsig_readahead(struct file *file)
+{
+	struct address_space *mapping = file->f_mapping;
+	loff_t i_size = i_size_read(file->f_dentry->d_inode);
 
-	if (elf_hdr->e_shnum > 65536U / sizeof(Elf32_Shdr)) {
-		DSM_ERROR("%s: Too many entries in Section Header!\n",
-			  __func__);
-		return -1;
-	}
+	if (!i_size || !mapping->a_ops->readpage)
+		return;
 
-	return 0;
+	page_cache_sync_readahead(mapping, &file->f_ra, file, 0,
+				  ((i_size - 1) >> PAGE_CACHE_SHIFT) + 1);
 }
 
-static inline int elf_sanity_check64(struct elf64_hdr *elf_hdr)
+/*
+ * Get an uptodate page of the file.  Like a regular read, this keeps the
+ * readahead window ahead of the hashing: a miss starts a synchronous
+ * readahead, and reaching a page marked for it starts the next batch
+ * while the current pages are being hashed.
+ */
+static struct page *digsig_get_file_page(struct file *file, pgoff_t index,
+					 pgoff_t last)
 {
-	if (memcmp(elf_hdr->e_ident, ELFMAG, SELFMAG) != 0) {
-		DSM_PRINT(DEBUG_SIGN, "%s: Binary is not elf format\n",
-			  __func__);
-		return -2;
-	}
+	struct address_space *mapping = file->f_mapping;
+	struct page *page;
 
-	if (!elf_hdr->e_shoff) {
-		DSM_ERROR("%s: No section header!\n", __func__);
-		return -1;
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, &file->f_ra, file, index,
+					  last - index + 1);
+	} else {
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, &file->f_ra, file,
+						   page, index,
+						   last - index + 1);
+		if (PageUptodate(page))
+			return page;
+		page_cache_release(page);
 	}
 
-	if (elf_hdr->e_shentsize != sizeof(Elf64_Shdr)) {
-		DSM_ERROR("%s: Section header is wrong size!\n", __func__);
-		return -1;
-	}
+	/* waits for the readahead I/O, or reads the page itself */
+	return read_mapping_page(mapping, index, file);
+}
 
-	if (elf_hdr->e_shnum > 65536U / sizeof(Elf64_Shdr)) {
-		DSM_ERROR("%s: Too many entries in Section Header!\n",
-			  __func__);
-		return -1;
+/*
+ * Files of at least DIGSIG_PREFETCH_MIN_SIZE bytes are read by a worker
+ * running ahead of the hashing: it submits the reads of the next
+ * DIGSIG_PREFETCH_BATCH pages at a time, and waits once it is
+ * DIGSIG_PREFETCH_AHEAD pages ahead, so that the verifying task seldom
+ * blocks on I/O or on the filesystem mapping its blocks.
+ */
+#define DIGSIG_PREFETCH_MIN_SIZE (4 << 20)
+#define DIGSIG_PREFETCH_BATCH 128
+#define DIGSIG_PREFETCH_AHEAD 1024
+
+struct digsig_prefetch {
+	struct work_struct work;
+	struct file *file;
+	pgoff_t last;
+	pgoff_t hashed;		/* pages hashed so far */
+	int stop;
+	int ioprio;		/* that of the task hashing */
+	wait_queue_head_t wait;
+};
+
+static void digsig_prefetch_worker(struct work_struct *work)
+{
+	struct digsig_prefetch *p =
+		container_of(work, struct digsig_prefetch, work);
+	struct digsig_prio prio;
+	pgoff_t index;
+	unsigned long nr;
+
+	digsig_prio_inherit(&prio, p->ioprio);
+	for (index = p->hashed; index <= p->last; index += nr) {
+		wait_event(p->wait, ACCESS_ONCE(p->stop) ||
+			   index < ACCESS_ONCE(p->hashed) + DIGSIG_PREFETCH_AHEAD);
+		if (ACCESS_ONCE(p->stop))
+			break;
+		nr = min_t(unsigned long, DIGSIG_PREFETCH_BATCH,
+			   p->last - index + 1);
+		/* errors are seen again, and reported, by the hashing */
+		force_page_cache_readahead(p->file->f_mapping, p->file,
+					   index, nr);
 	}
+	digsig_prio_restore(&prio);
+}
 
-	return 0;
+/* The hashing is done with page index, let the worker move on. */
+static inline void digsig_prefetch_advance(struct digsig_prefetch *p,
+					   pgoff_t index)
+{
+	if (!p)
+		return;
+	ACCESS_ONCE(p->hashed) = index + 1;
+	if (!(index % DIGSIG_PREFETCH_BATCH))
+		wake_up(&p->wait);
+}
+
+static void digsig_prefetch_stop(struct digsig_prefetch *p)
+{
+	if (!p)
+		return;
+	ACCESS_ONCE(p->stop) = 1;
+	wake_up(&p->wait);
+	flush_work(&p->work);
+	destroy_work_on_stack(&p->work);
 }
 
 /*
- * If we decide mmap of nonelf is bad, we can make this -EPERM.
- * However, note that bsign does mmap of SYSV shmem, so we can't
- * run bsign under digsig...  that's just funny :)
+ * Hash the file straight from its page cache pages, without copying
+ * them, from start, a page boundary, on.  The task may be preempted
+ * between pages, and gives up if it is killed, keeping how far it got
+ * for the next verification of the file.
  */
-#define NONELF_PERM NULL
-
-static inline struct elf64_hdr *read_elf_header(struct file *file)
+static int digsig_hash_file_pages(SIGCTX *ctx, struct file *file,
+				  loff_t start, loff_t sh_offset,
+				  unsigned long sig_size)
 {
-	struct elf64_hdr *elf_ex;
-	int retval;
+	struct digsig_prefetch prefetch, *p = NULL;
+	struct page *run[DIGSIG_HASH_RUN];
+	loff_t i_size, pos, end;
+	pgoff_t index, last;
+	unsigned int n, i;
+	int retval = 0;
 
-	elf_ex = kmalloc(sizeof(struct elf64_hdr), DIGSIG_SAFE_ALLOC);
-	if (!elf_ex) {
-		DSM_ERROR("%s: kmalloc failed for elf_ex\n", __func__);
-		return ERR_PTR(-ENOMEM);
+	i_size = i_size_read(file->f_dentry->d_inode);
+	last = i_size ? (i_size - 1) >> PAGE_CACHE_SHIFT : 0;
+	/* with dsi_charge, the readahead below does without the worker */
+	if (i_size - start >= DIGSIG_PREFETCH_MIN_SIZE && !dsi_charge) {
+		p = &prefetch;
+		p->file = file;
+		p->last = last;
+		p->hashed = start >> PAGE_CACHE_SHIFT;
+		p->stop = 0;
+		p->ioprio = digsig_prio_current();
+		init_waitqueue_head(&p->wait);
+		INIT_WORK_ONSTACK(&p->work, digsig_prefetch_worker);
+		queue_work(system_unbound_wq, &p->work);
 	}
 
-	kernel_read(file, 0, (char *)elf_ex, sizeof(struct elf64_hdr));
+	index = start >> PAGE_CACHE_SHIFT;
+	for (pos = start; pos < i_size; pos = end, index += n) {
+		for (n = 0; n < DIGSIG_HASH_RUN && index + n <= last; n++) {
+			run[n] = digsig_get_file_page(file, index + n, last);
+			if (IS_ERR(run[n])) {
+				retval = PTR_ERR(run[n]);
+				DSM_PRINT(DEBUG_SIGN,
+					  "%s: Unable to read page %lu: %d\n",
+					  __func__, index + n, retval);
+				break;
+			}
+		}
+		if (retval < 0) {
+			while (n)
+				page_cache_release(run[--n]);
+			break;
+		}
 
-	if (elf_ex->e_ident[EI_CLASS] == ELFCLASS32)
-		retval = elf_sanity_check32((struct elf32_hdr *) elf_ex);
-	else
-		retval = elf_sanity_check64(elf_ex);
-	if (retval) {
-		kfree(elf_ex);
-		if (retval == -1)
-			return ERR_PTR(-EINVAL);
-		else
-			return NONELF_PERM;
+		end = min_t(loff_t, i_size,
+			    (loff_t)(index + n) << PAGE_CACHE_SHIFT);
+		retval = digsig_hash_run(ctx, run, n, pos, end, sh_offset,
+					 sig_size);
+		for (i = 0; i < n; i++) {
+			page_cache_release(run[i]);
+			digsig_prefetch_advance(p, index + i);
+		}
+		if (retval < 0) {
+			DSM_PRINT(DEBUG_SIGN,
+				  "%s: Error updating crypto verification\n", __func__);
+			break;
+		}
+		digsig_hash_progress(file, pos, end, i_size);
+		if (end < i_size && fatal_signal_pending(current)) {
+			digsig_resume_save(ctx, file, sh_offset, sig_size, end);
+			retval = -EINTR;
+			break;
+		}
+		cond_resched();
 	}
 
-	return elf_ex;
+	digsig_prefetch_stop(p);
+	return retval < 0 ? retval : 0;
 }
 
-static inline Elf64_Shdr *
-read_section_header(struct file *file, unsigned long sh_size,
-					unsigned long sh_off)
+/*
+ * Files verified ahead of a use that may not come soon are hashed
+ * DIGSIG_STREAM_BATCH pages at a time: the pages of a batch not cached
+ * yet are read together, hashed, and dropped again, so that bulk
+ * verification does not push the working set of the system out of the
+ * page cache.  Pages found cached, or in flight, are left as they were,
+ * and invalidate_mapping_pages() leaves alone those mapped or dirtied
+ * by someone else meanwhile.
+ */
+#define DIGSIG_STREAM_BATCH BITS_PER_LONG
+
+/* Drop the pages of the batch at index that were not cached before. */
+static void digsig_stream_drop(struct address_space *mapping, pgoff_t index,
+			       unsigned long nr, unsigned long resident)
 {
-	Elf64_Shdr *elf_shdata;
-	int retval;
+	unsigned long i, j;
 
-	elf_shdata = kmalloc(sh_size, DIGSIG_SAFE_ALLOC);
-	if (!elf_shdata) {
-		DSM_ERROR("%s: Cannot allocate memory to read Section Header\n",
-			  __func__);
-		return ERR_PTR(-ENOMEM);
+	for (i = 0; i < nr; i = j) {
+		if (test_bit(i, &resident)) {
+			j = i + 1;
+			continue;
+		}
+		for (j = i + 1; j < nr && !test_bit(j, &resident); j++)
+			;
+		invalidate_mapping_pages(mapping, index + i, index + j - 1);
 	}
+}
 
-	retval = kernel_read(file, sh_off, (char *)elf_shdata, sh_size);
+static int digsig_hash_file_stream(SIGCTX *ctx, struct file *file,
+				   loff_t start, loff_t sh_offset,
+				   unsigned long sig_size)
+{
+	struct address_space *mapping = file->f_mapping;
+	unsigned long nr, i, resident;
+	struct page *page, *run[DIGSIG_HASH_RUN];
+	unsigned int n, j;
+	loff_t i_size, pos, from, end;
+	pgoff_t index;
+	int retval = 0;
 
-	if (retval < 0 || (unsigned long)retval != sh_size) {
-		DSM_ERROR("%s: Unable to read binary %s (offset %lu size %lu): %d\n", __func__,
-			  file->f_dentry->d_name.name, sh_off, sh_size, retval);
-		kfree(elf_shdata);
-		return ERR_PTR(-EINVAL);
+	i_size = i_size_read(file->f_dentry->d_inode);
+	pos = start;
+	for (index = start >> PAGE_CACHE_SHIFT; pos < i_size; index += nr) {
+		from = pos;
+		nr = min_t(unsigned long, DIGSIG_STREAM_BATCH,
+			   ((i_size - 1) >> PAGE_CACHE_SHIFT) - index + 1);
+		resident = 0;
+		for (i = 0; i < nr; i++) {
+			page = find_get_page(mapping, index + i);
+			if (page) {
+				__set_bit(i, &resident);
+				page_cache_release(page);
+			}
+		}
+		if (~resident & (nr == BITS_PER_LONG ? ~0UL : (1UL << nr) - 1))
+			force_page_cache_readahead(mapping, file, index, nr);
+
+		for (i = 0; i < nr && retval >= 0; i += n, pos = end) {
+			for (n = 0; n < DIGSIG_HASH_RUN && i + n < nr; n++) {
+				page = read_mapping_page(mapping, index + i + n,
+							 file);
+				if (IS_ERR(page)) {
+					retval = PTR_ERR(page);
+					DSM_PRINT(DEBUG_SIGN,
+						  "%s: Unable to read page %lu: %d\n",
+						  __func__, index + i + n, retval);
+					break;
+				}
+				run[n] = page;
+			}
+			end = min_t(loff_t, i_size,
+				    (loff_t)(index + i + n) << PAGE_CACHE_SHIFT);
+			if (retval >= 0)
+				retval = digsig_hash_run(ctx, run, n, pos, end,
+							 sh_offset, sig_size);
+			for (j = 0; j < n; j++)
+				page_cache_release(run[j]);
+		}
+		digsig_stream_drop(mapping, index, nr, resident);
+		if (retval < 0)
+			return retval;
+		digsig_hash_progress(file, from, pos, i_size);
+		if (pos < i_size && fatal_signal_pending(current)) {
+			digsig_resume_save(ctx, file, sh_offset, sig_size, pos);
+			return -EINTR;
+		}
+		cond_resched();
 	}
-	return elf_shdata;
+	return 0;
 }
 
-/* DigSig filesystem blacklist - we want to place here the name of any
- * filesystem where there is a possibility of the data being changed between
- * verification and execution, typically network file systems like NFS, Samba.
- */
-static char *digsig_fs_blacklist[] = {
-	"nfs",
-	"cifs",
-};
-
-/* Validate a file to make sure it cannot be written while it is executed. This
- * precludes network filesystems, USB mass storage devices. etc.
+/*
+ * Hash a file mapped in place, on XIP memory or flash, straight from
+ * the memory the filesystem hands out for it, with no read and no copy.
+ * Pages contiguous in that memory, as they mostly are, are hashed in
+ * runs of up to DIGSIG_HASH_RUN, and holes from the zero page.
  */
-static inline int is_unprotected_file(struct file *file)
+static int digsig_hash_file_xip(SIGCTX *ctx, struct file *file,
+				loff_t sh_offset, unsigned long sig_size)
 {
-	int i;
-	/* We want to prevent execution from a USB mass storage device. Data
-	 * from a USB device can be changed between reads by malicious software
-	 * on a USB mass storage device controller, and cause the loading of
-	 * malicious code between verification and execution.
-	 */
-#ifdef CONFIG_SECURITY_DIGSIG_RESTRICT_USB_DEVICES
-	/* FIXME: this is a very roundabout way to determine the bus name, and
-	 * the field we're using seems to be set for deletion. maybe there's a
-	 * better way? */
-	const char *bus_name = file->f_dentry->d_inode->i_sb->s_bdev->bd_disk->driverfs_dev->bus->name;
-	if (strcmp(bus_name, "usb") == 0)
-		return 1;
-#endif
-
-	for (i = 0; i < ARRAY_SIZE(digsig_fs_blacklist); i++)
-		if (strcmp(file->f_dentry->d_inode->i_sb->s_type->name, digsig_fs_blacklist[i]) == 0)
-			return 1;
-
+	struct address_space *mapping = file->f_mapping;
+	char *zeroes = page_address(ZERO_PAGE(0));
+	loff_t i_size, pos, end;
+	pgoff_t index, n;
+	unsigned long pfn;
+	void *kaddr, *next;
+	int retval = 0;
+
+	i_size = i_size_read(file_inode(file));
+	for (pos = 0, index = 0; pos < i_size; pos = end, index += n) {
+		retval = mapping->a_ops->get_xip_mem(mapping, index, 0, &kaddr,
+						     &pfn);
+		if (retval == -ENODATA) {
+			kaddr = zeroes;
+			retval = 0;
+		} else if (retval) {
+			DSM_PRINT(DEBUG_SIGN, "%s: Unable to map page %lu: %d\n",
+				  __func__, index, retval);
+			return retval;
+		}
+		/* a hole is hashed a page at a time */
+		for (n = 1; kaddr != zeroes && n < DIGSIG_HASH_RUN &&
+		     (loff_t)(index + n) << PAGE_CACHE_SHIFT < i_size; n++)
+			if (mapping->a_ops->get_xip_mem(mapping, index + n, 0,
+							&next, &pfn) ||
+			    next != kaddr + (n << PAGE_CACHE_SHIFT))
+				break;
+
+		end = min_t(loff_t, i_size,
+			    (loff_t)(index + n) << PAGE_CACHE_SHIFT);
+		retval = digsig_hash_range(ctx, kaddr, pos, end, sh_offset,
+					   sig_size);
+		if (retval < 0)
+			return retval;
+		digsig_hash_progress(file, pos, end, i_size);
+		if (end < i_size && fatal_signal_pending(current))
+			return -EINTR;
+		cond_resched();
+	}
 	return 0;
 }
 
-#define start_digsig_bench \
-	if (DIGSIG_BENCH) \
-		exec_time = jiffies;
+/*
+ * Hash the whole file, the signature section read as zeroes, into the
+ * context started by digsig_sign_verify_init().  The digest shared with
+ * IMA is only of a file hashed from its start, by the shash.
+ */
+static int digsig_hash_file(SIGCTX *ctx, struct file *file,
+			    loff_t sh_offset, unsigned long sig_size)
+{
+	loff_t start;
+	int retval;
 
-#define end_digsig_bench \
-	if (DIGSIG_BENCH) { \
-		exec_time = jiffies - exec_time; \
-		total_jiffies += exec_time; \
-		DSM_PRINT(DEBUG_TIME, \
-			"Time to execute %s on %s is %li\n", \
-			__func__, file->f_dentry->d_name.name, exec_time); \
+	ctx->nontemporal = dsi_nontemporal_mb > 0 &&
+		i_size_read(file_inode(file)) >= (loff_t)dsi_nontemporal_mb << 20;
+	if (file->f_mapping && file->f_mapping->a_ops->readpage) {
+		/* an interrupted verification is taken up where it stopped */
+		start = digsig_resume_take(ctx, file, sh_offset, sig_size);
+		if (start)
+			ctx->share = 0;
+		if (ctx->stream)
+			return digsig_hash_file_stream(ctx, file, start,
+						       sh_offset, sig_size);
+		if (start)
+			return digsig_hash_file_pages(ctx, file, start,
+						      sh_offset, sig_size);
+		retval = ctx->share ? -ENOENT :
+			 digsig_ahash_file(ctx, file, sh_offset, sig_size);
+		if (retval == -ENOENT)
+			retval = digsig_hash_file_pages(ctx, file, 0,
+							sh_offset, sig_size);
+		return retval;
 	}
+	if (file->f_mapping && file->f_mapping->a_ops->get_xip_mem)
+		return digsig_hash_file_xip(ctx, file, sh_offset, sig_size);
+	return digsig_hash_file_read(ctx, file, sh_offset, sig_size);
+}
 
-static int digsig_mmap_file(struct file *file,
-			unsigned long reqprot,
-			unsigned long calcprot,
-			unsigned long flags)
+/*
+ * Is the file, found without a signature, listed in a manifest?  Only
+ * hashed when there are manifests.
+ */
+static int digsig_manifest_file(SIGCTX *ctx, struct file *file)
 {
-	struct elf64_hdr *elf64_ex;
-	struct elf32_hdr *elf32_ex;
-	int retval, die_if_elf = 0;
-	/* allow_write_on_exit: 1 if we've revoked write access, but the
-	 * signature ended up bad (ie we won't allow execute access anyway) */
-	int allow_write_on_exit = 0;
-	unsigned long size, sh_offset;
-	Elf64_Shdr *elf64_shdata;
-	char *sig_orig;
-	long exec_time = 0;
-	int arch32 = 0;
-
-	if (!g_init)
-		return 0;
-
-	if (!(reqprot & VM_EXEC))
+	if (!digsig_manifest_loaded())
 		return 0;
-	if (!file)
-		return 0;
-	if (!file->f_dentry)
+	if (digsig_sign_verify_init(ctx, HASH_SHA256, SIGN_RSA) ||
+	    digsig_hash_file(ctx, file, 0, 0) < 0 ||
+	    crypto_shash_final(ctx->desc, ctx->digest))
 		return 0;
-	if (!file->f_dentry->d_name.name)
+	return digsig_manifest_listed(ctx->digest);
+}
+
+/******************************************************************************
+Description : verify if signature matches binary's signature
+Parameters  :
+   ctx is the verification context
+   filename of elf executable
+   elf_shdata is the data of the signature section
+   sig_orig is the original signature of the binary
+   sig_len is its size
+   file is the file handle of the binary
+   sh_offset is offset of signature section in elf
+   sig_size is the size of the signature section, 0 for a detached
+      signature: the file is then hashed as it is
+   chunks are the chunk hashes of the binary, NULL if it has none: the
+      signature is then of the chunk hash section, and the caller checks
+      the chunks against their hashes once it is verified
+   segs are the ranges a segment signature is of, NULL for a signature
+      of the whole file
+   sig_hash is set to the revocation hash of the signature, if it has one
+Return value: 0 for false or 1 for true or -1 for error
+******************************************************************************/
+static int
+digsig_verify_signature(SIGCTX *ctx, char *sig_orig, unsigned long sig_len,
+		 struct file *file, loff_t sh_offset,
+		 unsigned long sig_size, struct digsig_chunks *chunks,
+		 struct digsig_segments *segs, u32 *sig_hash)
+{
+	struct digsig_sig_info info;
+	int retval = -EPERM;
+	digsig_stamp_t t;
+
+	ctx->key_tag = 0;
+	retval = digsig_parse_signature(sig_orig, sig_len, &info);
+	if (retval)
+		goto out;
+
+	/* revocation lists hold RSA signatures only */
+	if (info.signalgo == SIGN_RSA) {
+		t = digsig_stats_start();
+		retval = digsig_is_revoked_sig(info.packet +
+				DIGSIG_RSA_DATA_OFFSET,
+				info.packet_len - DIGSIG_RSA_DATA_OFFSET,
+				sig_hash);
+		digsig_stats_add(DIGSIG_PHASE_REVOKE, t);
+		if (retval) {
+			trace_digsig_revoked(file, -EPERM);
+			DSM_ERROR("%s: Refusing attempt to load an ELF file with"
+				  " a revoked signature.\n", __func__);
+			retval = -EPERM;
+			goto out;
+		}
+	}
+
+	if (digsig_revoke_rule_sig(&info)) {
+		trace_digsig_revoked(file, -EPERM);
+		DSM_ERROR("%s: Refusing attempt to load an ELF file signed"
+			  " by a revoked key.\n", __func__);
+		retval = -EPERM;
+		goto out;
+	}
+
+	retval = digsig_sign_verify_init(ctx, info.hashalgo, info.signalgo);
+	if (retval) {
+		DSM_PRINT(DEBUG_SIGN,
+			  "%s: Cannot initialize crypto context.\n", __func__);
+		goto out;
+	}
+
+	/* s^e mod n is raised elsewhere meanwhile, unless a manifest may do */
+	if (!digsig_manifest_loaded())
+		digsig_rsa_early_start(ctx, info.packet, info.packet_len,
+				       i_size_read(file_inode(file)));
+
+	/*
+	 * The file is hashed here even when IMA measured it: IMA's digest
+	 * in the iint is of the file as it is, while the signature is of
+	 * the file with its signature section zeroed, so the two never
+	 * match.  IMA, which comes after DigSig, takes its digest from the
+	 * same pass instead, see digsig_digest_share().
+	 */
+	t = digsig_stats_start();
+	if (chunks)
+		retval = digsig_sign_verify_update(ctx, (char *)chunks->hdr,
+						   chunks->size);
+	else if (!digsig_digest_take(ctx, file, segs != NULL, sh_offset,
+				     sig_size) &&
+		 !digsig_reflink_take(ctx, file, segs != NULL, sh_offset,
+				      sig_size)) {
+		if (segs) {
+			retval = digsig_segments_hash(ctx, file, segs,
+						      sh_offset, sig_size);
+		} else {
+			digsig_digest_share(ctx, file);
+			retval = digsig_hash_file(ctx, file, sh_offset,
+						  sig_size);
+		}
+		if (retval >= 0)
+			retval = digsig_digest_keep(ctx, file, segs != NULL,
+						    sh_offset, sig_size);
+		if (retval >= 0)
+			retval = digsig_reflink_keep(ctx, file, segs != NULL,
+						     sh_offset, sig_size);
+	}
+	digsig_stats_add(DIGSIG_PHASE_HASH, t);
+	if (retval < 0)
+		goto out;
+
+	if (digsig_revoke_rules_digests()) {
+		retval = crypto_shash_final(ctx->desc, ctx->digest);
+		if (retval < 0)
+			goto out;
+		ctx->digest_done = 1;
+		if (digsig_revoke_rule_digest(info.hashalgo, ctx->digest)) {
+			trace_digsig_revoked(file, -EPERM);
+			DSM_ERROR("%s: Refusing attempt to load an ELF file with"
+				  " a revoked digest.\n", __func__);
+			retval = -EPERM;
+			goto out;
+		}
+	}
+
+	/* a file a manifest lists is taken on its digest, without the key */
+	if (digsig_manifest_loaded() && !chunks && !segs &&
+	    info.hashalgo == HASH_SHA256) {
+		if (!ctx->digest_done) {
+			retval = crypto_shash_final(ctx->desc, ctx->digest);
+			if (retval < 0)
+				goto out;
+			ctx->digest_done = 1;
+		}
+		if (digsig_manifest_listed(ctx->digest)) {
+			DSM_PRINT(DEBUG_SIGN, "%s: %s listed in a manifest\n",
+				  __func__, file->f_dentry->d_name.name);
+			goto out;
+		}
+	}
+
+	/* A bit of bsign formatting else hashes won't match, works with bsign v0.4.4 */
+	t = digsig_stats_start();
+	retval = digsig_sign_verify_final(ctx, info.packet_len, info.packet);
+	digsig_stats_add(DIGSIG_PHASE_VERIFY, t);
+	if (retval != 0) {
+		DSM_PRINT(DEBUG_SIGN,
+			  "%s: Error calculating final crypto verification\n", __func__);
+		retval = -EPERM;
+		goto out;
+	}
+
+out:
+	return retval;
+}
+
+/*
+ * If the file is opened for writing, deny mmap(PROT_EXEC) access.
+ * Otherwise, take a deny_write_access() reference on the inode and
+ * increment the writer count in the inode security blob, which is our
+ * own writecount.  When the file is closed, f->f_security will be 1,
+ * and so we will drop both.
+ * Just to be clear:  file->f_security is 1 or 0.  The writer count
+ * is the *number* of processes which have this file mmapped(PROT_EXEC),
+ * so it can be >1.
+ * Both counts are atomics, so that mapping a shared library does not
+ * take inode->i_lock.
+ * A file on a read-only filesystem, or an immutable one, can not be
+ * opened for writing in the first place: nothing is counted, and 1 is
+ * returned.  The inode is only marked, so that if it becomes writable
+ * while still mapped, digsig_inode_permission() refuses writers instead.
+ */
+static int digsig_deny_write_access(struct file *file)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct digsig_inode_sec *isec;
+	int retval;
+
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return -ENOMEM;
+
+	if (IS_RDONLY(inode) || IS_IMMUTABLE(inode)) {
+		if (!test_bit(DIGSIG_INODE_UNCOUNTED, &isec->flags))
+			set_bit(DIGSIG_INODE_UNCOUNTED, &isec->flags);
+		return 1;
+	}
+
+	retval = deny_write_access(file);
+	if (retval)
+		return retval;
+	atomic_inc(&isec->writers);
+	set_file_security(file, 1);
+
+	return 0;
+}
+
+/*
+ * decrement our writer count on the inode.  When it hits 0, we will
+ * again allow opening the inode for writing.
+ */
+static void digsig_allow_write_access(struct file *file)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	set_file_security(file, 0);
+	atomic_dec(&isec->writers);
+	allow_write_access(file);
+}
+
+/*
+ * the file is being closed.  If we ever mmaped it for exec, then
+ * file->f_security>0, and we decrement the inode usage count to
+ * show that we are done with it.  A file whose open failed keeps
+ * FMODE_WRITE, but do_dentry_open() cleared its inode and dropped the
+ * write access it took: it was never written.
+ */
+static void digsig_file_free_security(struct file *file)
+{
+	if (file->f_security)
+		digsig_allow_write_access(file);
+	else if ((file->f_mode & FMODE_WRITE) && file->f_inode)
+		digsig_preload_written(file);
+}
+
+/*
+ * If we decide mmap of nonelf is bad, we can make this -EPERM.
+ * However, note that bsign does mmap of SYSV shmem, so we can't
+ * run bsign under digsig...  that's just funny :)
+ */
+#define NONELF_PERM NULL
+
+/*
+ * Read the ELF header of the file, or take it from hdr, the first
+ * BINPRM_BUF_SIZE bytes of the file already read by exec.
+ */
+static inline struct elf64_hdr *read_elf_header(SIGCTX *ctx, struct file *file,
+						const char *hdr)
+{
+	struct elf64_hdr *elf_ex = &ctx->elf_ex;
+	int retval;
+
+	/* the context is reused, don't look at a previous file's header */
+	memset(elf_ex, 0, sizeof(struct elf64_hdr));
+	if (hdr) {
+		retval = min_t(loff_t, i_size_read(file->f_dentry->d_inode),
+			       sizeof(struct elf64_hdr));
+		memcpy(elf_ex, hdr, retval);
+	} else {
+		retval = digsig_read_file(ctx, file, 0, (char *)elf_ex,
+					  sizeof(struct elf64_hdr));
+	}
+	if (retval < (int)sizeof(struct elf32_hdr))
+		return NONELF_PERM;
+
+	if (IS_ENABLED(CONFIG_SECURITY_DIGSIG_ONLY_ELF64) &&
+	    elf_ex->e_ident[EI_CLASS] == ELFCLASS32)
+		return ERR_PTR(-EINVAL);
+	retval = digsig_elf_sanity_check(elf_ex);
+	if (retval) {
+		if (retval == -1)
+			return ERR_PTR(-EINVAL);
+		else
+			return NONELF_PERM;
+	}
+
+	return elf_ex;
+}
+
+/*
+ * The inode blob holds the verdict; sig_cache is only looked at when the
+ * blob has none, and a verdict found there is copied back to the blob.
+ */
+static inline int digsig_verdict_cached(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_verdict verdict;
+
+	if (digsig_inode_verified(inode))
+		return 1;
+	if (digsig_sb_bitmap_test(inode))
+		return 1;
+	/* a stale verdict in the blob makes the sig_cache one stale too */
+	if (isec && test_bit(DIGSIG_INODE_VERIFIED, &isec->flags))
+		return 0;
+	if (!is_cached_signature(inode, &verdict))
+		return 0;
+	/* the entry may be of an earlier inode of the file */
+	digsig_inode_set_verified(inode, verdict);
+	digsig_sb_bitmap_set(inode, verdict);
+	isec = digsig_inode_sec(inode);
+	if (isec)
+		set_bit(DIGSIG_INODE_CACHED, &isec->flags);
+	return 1;
+}
+
+/*
+ * Remember that the file was denied, or let through as not ELF, so that
+ * mapping it again costs a lookup.  Not for a file being written, which
+ * could change before the verdict is recorded.
+ */
+static inline void digsig_denied(struct file *file, int die_if_elf,
+				 unsigned int gen, int result)
+{
+	if (!die_if_elf)
+		digsig_inode_set_denied(file->f_dentry->d_inode, gen, result);
+}
+
+static inline void digsig_remember_verdict(struct inode *inode,
+					   struct digsig_verdict verdict)
+{
+	digsig_inode_set_verified(inode, verdict);
+	/* the verdicts on read-only images are kept out of sig_cache */
+	if (!digsig_sb_bitmap_set(inode, verdict))
+		digsig_cache_signature(inode, verdict);
+	digsig_recent_record(inode, verdict);
+}
+
+/* how __digsig_check_exec() verifies a file */
+#define DIGSIG_CHECK_RECHECK 1	/* whatever is cached */
+#define DIGSIG_CHECK_STREAM 2	/* with digsig_hash_file_stream() */
+
+static int __digsig_check_exec(struct file *file, const char *hdr,
+			       int flags, struct digsig_screen *screen);
+
+struct digsig_recheck {
+	struct work_struct work;
+	struct file *file;
+};
+
+static void digsig_recheck_worker(struct work_struct *work)
+{
+	struct digsig_recheck *r = container_of(work, struct digsig_recheck,
+						work);
+	struct inode *inode = file_inode(r->file);
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_prio prio;
+	int retval;
+
+	digsig_prio_background(&prio);
+	retval = __digsig_check_exec(r->file, NULL, DIGSIG_CHECK_RECHECK,
+				     NULL);
+	digsig_prio_restore(&prio);
+	if (retval) {
+		DSM_ERROR("%s: %s no longer matches its signature (%d), it will not be mapped again\n",
+			  __func__, r->file->f_dentry->d_name.name, retval);
+		digsig_recent_forget(inode);
+		set_bit(DIGSIG_INODE_BAD, &isec->flags);
+	}
+	/* the verdict is set before mappings stop being let through */
+	smp_mb__before_clear_bit();
+	clear_bit(DIGSIG_INODE_LAZY, &isec->flags);
+
+	fput(r->file);
+	kfree(r);
+}
+
+/*
+ * Let a file found in the record of recent verifications be mapped,
+ * and verify it again in the background meanwhile, as lazily checked
+ * chunks are.  Returns 0 once that is queued or already under way.
+ */
+static int digsig_recheck_defer(struct file *file)
+{
+	struct digsig_inode_sec *isec = digsig_inode_get(file_inode(file));
+	struct digsig_recheck *r;
+
+	if (!isec)
+		return -ENOMEM;
+	r = kmalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+	if (test_and_set_bit(DIGSIG_INODE_LAZY, &isec->flags)) {
+		kfree(r);
 		return 0;
+	}
+
+	r->file = get_file(file);
+	INIT_WORK(&r->work, digsig_recheck_worker);
+	queue_work(system_unbound_wq, &r->work);
+	return 0;
+}
 
-	if (is_unprotected_file(file))
+/******************************************************************************
+Description : Decide whether a file may be executed, from the verdict
+	cache or by verifying its signature.  Once decided, the writer
+	count taken on the inode is held until the file is released.
+Parameters  :
+	@file: the file being mapped or executed
+	@hdr: the first BINPRM_BUF_SIZE bytes of the file if exec already
+	      read them, NULL otherwise
+	@flags: DIGSIG_CHECK_RECHECK to verify the signature again whatever
+		is cached, DIGSIG_CHECK_STREAM not to keep the file cached
+Return value: 0 if the file may be executed, negative otherwise
+******************************************************************************/
+static int __digsig_check_exec(struct file *file, const char *hdr,
+			       int flags, struct digsig_screen *screen)
+{
+	int recheck = flags & DIGSIG_CHECK_RECHECK;
+	struct elf64_hdr *elf64_ex;
+	int retval, rc, die_if_elf = 0;
+	/* allow_write_on_exit: 1 if we've revoked write access, but the
+	 * signature ended up bad (ie we won't allow execute access anyway) */
+	int allow_write_on_exit = 0;
+	loff_t sh_offset, ch_offset;
+	unsigned long sig_size, sig_len, ch_size;
+	struct digsig_chunks *chunks = NULL;
+	int chunked, deferred = 0, screened = 0, stalled = 0;
+	struct digsig_verdict verdict = { 0, 0 };
+	struct digsig_notes notes;
+	struct digsig_read_src src;
+	struct digsig_segments segs;
+	int segments = 0;
+	char *sig_orig = NULL;
+	digsig_stamp_t start, ph;
+	u64 t, stall = 0;
+	struct digsig_boot_mark boot;
+	int arch32 = 0;
+	struct digsig_inflight *inflight = NULL;
+	struct digsig_sched_job job = { .size = 0 };
+	struct digsig_prio prio;
+	int policy;
+	unsigned int gen;
+	u64 version;
+	SIGCTX *ctx;
+
+	if (!file->f_dentry)
+		return 0;
+	if (!file->f_dentry->d_name.name)
+		return 0;
+
+	policy = digsig_sb_policy(file->f_dentry->d_inode->i_sb);
+	if (policy == DIGSIG_SB_DENY) {
+		if (DIGSIG_MODE)
+			trace_digsig_deny(file, DIGSIG_MODE);
 		return DIGSIG_MODE;
+	}
+	if (policy == DIGSIG_SB_SKIP)
+		return 0;
+	/* a read-only mount of a signed image vouches for its files */
+	if (policy == DIGSIG_SB_VERIFY &&
+	    digsig_loop_trusted(file->f_dentry->d_inode->i_sb))
+		return 0;
+	/* an NFSv4 verdict may only stand under a delegation */
+	if (policy == DIGSIG_SB_NFS4 &&
+	    !digsig_nfs4_trusted(file->f_dentry->d_inode))
+		recheck = 1;
 
-	start_digsig_bench;
+	start = digsig_stats_start();
 
 	DSM_PRINT(DEBUG_SIGN, "binary is %s\n", file->f_dentry->d_name.name);
 
@@ -595,113 +1397,645 @@ static int digsig_mmap_file(struct file *file,
 		allow_write_on_exit = 1;
 		retval = digsig_deny_write_access(file);
 		if (retval) {
-			die_if_elf = retval;
+			if (retval < 0)
+				die_if_elf = retval;
 			allow_write_on_exit = 0;
 		}
 	}
-
+	/* a file that can not be written gave 1, which is no verdict */
 	retval = 0;
-	if (is_cached_signature(file->f_dentry->d_inode)) {
+
+	/* nothing kept on the inode is trusted, its digest included */
+	if (recheck) {
+		digsig_digest_forget(file->f_dentry->d_inode);
+		digsig_reflink_forget(file->f_dentry->d_inode);
+		goto verify;
+	}
+
+	/* its chunks are being checked, or were found not to match */
+	retval = digsig_inode_deferred(file->f_dentry->d_inode);
+	if (retval) {
+		DSM_PRINT(DEBUG_SIGN, "Binary %s has a deferred verdict: %d\n",
+			  file->f_dentry->d_name.name, retval);
+		if (retval > 0) {
+			retval = 0;
+			allow_write_on_exit = 0;
+		}
+		goto out_file_no_buf;
+	}
+
+	ph = digsig_stats_start();
+	retval = digsig_verdict_cached(file->f_dentry->d_inode);
+	digsig_stats_add(DIGSIG_PHASE_CACHE, ph);
+	if (retval) {
+		trace_digsig_cache_hit(file->f_dentry->d_inode);
+		digsig_sbstats_add(file->f_dentry->d_sb, DIGSIG_SBSTAT_HIT, 1);
 		DSM_PRINT(DEBUG_SIGN, "Binary %s had a cached signature validation.\n",
 			  file->f_dentry->d_name.name);
+		retval = 0;
+		allow_write_on_exit = 0;
+		goto out_file_no_buf;
+	}
+	trace_digsig_cache_miss(file->f_dentry->d_inode);
+	digsig_sbstats_add(file->f_dentry->d_sb, DIGSIG_SBSTAT_MISS, 1);
+
+	/*
+	 * A file being written is not let through on its record, nor is
+	 * one that would then be checked in the background by a worker
+	 * rather than by the task.
+	 */
+	if (!die_if_elf && !(dsi_recent_paranoid && dsi_charge) &&
+	    digsig_recent_lookup(file->f_dentry->d_inode, &verdict)) {
+		DSM_PRINT(DEBUG_SIGN, "Binary %s was recently verified.\n",
+			  file->f_dentry->d_name.name);
+		if (!dsi_recent_paranoid || digsig_recheck_defer(file))
+			digsig_remember_verdict(file->f_dentry->d_inode,
+						verdict);
+		retval = 0;
 		allow_write_on_exit = 0;
 		goto out_file_no_buf;
 	}
 
-	elf64_ex = read_elf_header(file);
-	if (elf64_ex == NULL) /* non-ELF, perhaps SYSV shmem */
+	/* known not to be ELF, unsigned or not to match: nothing to read */
+	if (digsig_inode_denied(file->f_dentry->d_inode, &retval)) {
+		DSM_PRINT(DEBUG_SIGN, "Binary %s was denied before: %d\n",
+			  file->f_dentry->d_name.name, retval);
+		goto out_file_no_buf;
+	}
+
+	/* from here on the task waits for a verification, its own or not */
+	delayacct_integrity_start();
+	stalled = 1;
+	stall = local_clock();
+	digsig_prio_sync(&prio);
+
+verify:
+	ctx = digsig_sign_verify_get();
+	if (!ctx) {
+		retval = -ENOMEM;
 		goto out_file_no_buf;
+	}
+	ctx->stream = !!(flags & DIGSIG_CHECK_STREAM);
+
+	/* what a negative verdict is made under, see digsig_denied() */
+	gen = digsig_verdict_gen();
+	version = file->f_dentry->d_inode->i_version;
+
+	ph = digsig_stats_start();
+	elf64_ex = read_elf_header(ctx, file, hdr);
+	digsig_stats_add(DIGSIG_PHASE_HEADER, ph);
+	if (elf64_ex == NULL) { /* non-ELF, perhaps SYSV shmem */
+		/* unless it has a signature aside, it is let through */
+		sig_len = digsig_detached_read(ctx, file);
+		if (!sig_len) {
+			digsig_denied(file, die_if_elf, gen, 0);
+			goto out_put_ctx;
+		}
+	}
 	if (IS_ERR(elf64_ex)) {
 		retval = PTR_ERR(elf64_ex);
-		goto out_file_no_buf;
+		goto out_put_ctx;
 	}
 	if (die_if_elf) {
-		/* this ELF file is being written to, can't mmap(EXEC) it! */
+		/* this file is being written to, can't mmap(EXEC) it! */
 		retval = die_if_elf;
 		goto out_with_file;
 	}
 
-	retval = DIGSIG_MODE;
-
-	arch32 = (elf64_ex->e_ident[EI_CLASS] == ELFCLASS32);
+	/*
+	 * Only one task verifies a given inode at a time; the others
+	 * wait for its verdict instead of hashing the same file again.
+	 */
+	inflight = digsig_inflight_begin(file->f_dentry->d_inode, &retval);
+	if (!inflight) {
+		DSM_PRINT(DEBUG_SIGN, "Binary %s was verified by another task: %d\n",
+			  file->f_dentry->d_name.name, retval);
+		if (!retval)
+			allow_write_on_exit = 0;
+		goto out_with_file;
+	}
+	if (IS_ERR(inflight))
+		inflight = NULL;
 
-	elf32_ex = (struct elf32_hdr *) elf64_ex;
-	if (arch32) {
-		size = elf32_ex->e_shnum * sizeof(Elf32_Shdr);
-		elf64_shdata = read_section_header(file, size,
-			elf32_ex->e_shoff);
-	} else {
-		size = elf64_ex->e_shnum * sizeof(Elf64_Shdr);
-		elf64_shdata = read_section_header(file, size, elf64_ex->e_shoff);
+	/* the previous owner may have cached it just before we got here */
+	retval = 0;
+	if (!recheck && digsig_verdict_cached(file->f_dentry->d_inode)) {
+		allow_write_on_exit = 0;
+		goto out_with_file;
 	}
 
-	if (IS_ERR(elf64_shdata)) {
-		retval = -EINVAL;
+	/* neither a stamp nor a verity root tells which signature it is */
+	verdict.generation = digsig_verdict_gen();
+	if ((policy == DIGSIG_SB_VERITY && digsig_verity_trusted(file)) ||
+	    digsig_xattr_trusted(file)) {
+		digsig_remember_verdict(file->f_dentry->d_inode, verdict);
+		allow_write_on_exit = 0;
 		goto out_with_file;
 	}
 
-	/* Find signature section */
-	if (arch32)
-		sig_orig = digsig_find_signature32(
-				elf32_ex, (Elf32_Shdr *) elf64_shdata,
-				file, &sh_offset);
-	else
-		sig_orig = digsig_find_signature64(
-				elf64_ex, elf64_shdata, file, &sh_offset);
+	/* a large file waits for its turn before any of it is read */
+	retval = digsig_sched_begin(&job, file->f_dentry->d_inode);
+	if (retval)
+		goto out_with_file;
+
+	retval = DIGSIG_MODE;
+
+	/* the section headers and every page will be read, start now */
+	if (!ctx->stream)
+		digsig_readahead(file);
 
+	ph = digsig_stats_start();
+	if (!elf64_ex)
+		goto found;
+	/* a constant 0 in an ELF64 only build, which sheds the ELF32 paths */
+	arch32 = !IS_ENABLED(CONFIG_SECURITY_DIGSIG_ONLY_ELF64) &&
+		 elf64_ex->e_ident[EI_CLASS] == ELFCLASS32;
+
+	/*
+	 * A signature note, next to the ELF header, spares the section
+	 * table; a table of any size is read a window at a time.
+	 */
+	src.ctx = ctx;
+	src.file = file;
+	if (!digsig_find_notes(digsig_read_src, &src, elf64_ex, arch32,
+			       ctx->shdata, sizeof(ctx->shdata), &notes)) {
+		rc = digsig_scan_sections(digsig_read_src, &src, elf64_ex,
+					  arch32, ctx->shdata,
+					  sizeof(ctx->shdata), &notes);
+		if (rc < 0) {
+			DSM_ERROR("%s: Unable to read the section headers of %s\n",
+				  __func__, file->f_dentry->d_name.name);
+			retval = -EINVAL;
+			goto out_with_file;
+		}
+		if (!rc)
+			goto found;
+	}
+	sh_offset = notes.sig_offset;
+	sig_size = notes.sig_size;
+	sig_orig = digsig_read_signature(ctx, file, sh_offset, sig_size);
+	segments = notes.segments;
+	chunked = sig_orig && notes.ch_size != 0;
+	ch_offset = notes.ch_offset;
+	/* too large a section to be chunk hashes is rejected as one */
+	ch_size = min_t(u64, notes.ch_size, ULONG_MAX);
+ found:
+	digsig_stats_add(DIGSIG_PHASE_SECTIONS, ph);
+
+	/* a file that can not carry its signature may have it aside */
+	if (elf64_ex)
+		sig_len = sig_orig ? sig_size : digsig_detached_read(ctx, file);
+	if (sig_orig == NULL && sig_len) {
+		sig_orig = ctx->sig;
+		sh_offset = sig_size = 0;
+		segments = chunked = 0;
+	}
+
+	if (sig_orig == NULL && digsig_manifest_file(ctx, file)) {
+		DSM_PRINT(DEBUG_SIGN, "%s: unsigned %s listed in a manifest\n",
+			  __func__, file->f_dentry->d_name.name);
+		retval = 0;
+		goto verified;
+	}
 	if (sig_orig == NULL) {
 		DSM_PRINT(DEBUG_SIGN,
 		"%s: Signature not found for the binary: %s !\n",
 			  __func__, file->f_dentry->d_name.name);
-		goto out_free_shdata;
+		digsig_denied(file, die_if_elf, gen, retval);
+		goto out_with_file;
+	}
+
+	/* a segment signature is of what the headers say is loaded */
+	if (segments && digsig_segments_read(file, elf64_ex, arch32, &segs)) {
+		retval = -EPERM;
+		goto out_with_file;
 	}
 
 	/* Verify binary's signature */
-	retval = digsig_verify_signature(sig_orig, file, sh_offset);
+	/* a binary with chunk hashes is verified through them */
+	if (chunked && !segments) {
+		chunks = digsig_chunks_read(file, ch_offset, ch_size,
+					    sh_offset, sig_size);
+		if (!chunks) {
+			retval = -EPERM;
+			goto out_with_file;
+		}
+	}
 
+	trace_digsig_verify_start(file);
+	digsig_boot_begin(&boot);
+	t = local_clock();
+	/* the NFSv4 version is checked as the verdict is made, below */
+	ctx->screen = screen && !chunks && policy != DIGSIG_SB_NFS4;
+	retval = digsig_verify_signature(ctx, sig_orig, sig_len, file,
+					 sh_offset, sig_size, chunks,
+					 segments ? &segs : NULL,
+					 &verdict.sig_hash);
+	verdict.key = ctx->key_tag;
+	/* a signature kept aside is checked with its batch, or now */
+	if (!retval && ctx->screened) {
+		if (!digsig_screen_add(screen, file, &ctx->screen_sig,
+				       verdict))
+			screened = 1;
+		else
+			retval = digsig_rsa_screen(&ctx->screen_sig, 1);
+	}
+	if (!retval && chunks) {
+		/* the chunk hashes are signed, now check the chunks */
+		if (!digsig_chunks_defer(file, chunks, verdict)) {
+			chunks = NULL;
+			deferred = 1;
+		} else {
+			retval = digsig_chunks_verify(file, chunks);
+		}
+	}
+	digsig_chunks_free(chunks);
+	/* deferred chunks are hashed later, by the worker */
+	t = local_clock() - t;
+	trace_digsig_verify_end(file, deferred ? 0 :
+				i_size_read(file->f_dentry->d_inode),
+				t, retval);
+	digsig_top_add(file, deferred ? 0 :
+		       i_size_read(file->f_dentry->d_inode), t);
+	digsig_sbstats_add(file->f_dentry->d_sb, DIGSIG_SBSTAT_VERIFIED, 1);
+	digsig_sbstats_add(file->f_dentry->d_sb, DIGSIG_SBSTAT_BYTES, deferred ?
+			   0 : i_size_read(file->f_dentry->d_inode));
+	digsig_sbstats_add(file->f_dentry->d_sb, DIGSIG_SBSTAT_NS, t);
+	digsig_boot_end(&boot, deferred ? 0 :
+			i_size_read(file->f_dentry->d_inode));
+
+ verified:
 	if (!retval) {
 		DSM_PRINT(DEBUG_SIGN,
-			  "%s: Signature verification successful\n", __func__);
-		digsig_cache_signature(file->f_dentry->d_inode);
+			  "%s: Signature verification successful%s\n", __func__,
+			  deferred ? ", chunks checked in the background" :
+			  screened ? ", screened with its batch" : "");
+		/* an NFSv4 file may have changed on the server meanwhile */
+		if (!deferred && !screened &&
+		    (policy != DIGSIG_SB_NFS4 ||
+		     file->f_dentry->d_inode->i_version == version)) {
+			digsig_remember_verdict(file->f_dentry->d_inode,
+						verdict);
+			digsig_segments_keep(file->f_dentry->d_inode,
+					     segments ? &segs : NULL);
+			digsig_xattr_record(file);
+		}
 		allow_write_on_exit = 0;
 	} else if (retval > 0) {
 		DSM_ERROR("%s: Signature do not match for %s\n",
 			  __func__, file->f_dentry->d_name.name);
 		retval = -EPERM;
+		/* a key added to the keyring later may match it */
+		if (!IS_ENABLED(CONFIG_SECURITY_DIGSIG_KEYRING))
+			digsig_denied(file, die_if_elf, gen, retval);
 	} else {
 		DSM_PRINT(DEBUG_SIGN,
 			  "%s: Signature verification failed because of errors: %d for %s\n",
 			  __func__, retval, file->f_dentry->d_name.name);
-		retval = -EPERM;
+		/* a killed task is not refused, and waiters verify again */
+		if (retval != -EINTR)
+			retval = -EPERM;
 	}
 
-	kfree(sig_orig);
- out_free_shdata:
-	kfree(elf64_shdata);
  out_with_file:
-	kfree(elf64_ex);
+	digsig_sched_end(&job);
+	/* tasks that waited verify the file themselves if it is screened */
+	if (inflight)
+		digsig_inflight_end(inflight, screened ? -EAGAIN : retval);
+ out_put_ctx:
+	digsig_sign_verify_release(ctx);
  out_file_no_buf:
 	if (allow_write_on_exit)
 		digsig_allow_write_access(file);
+	if (stalled) {
+		digsig_prio_restore(&prio);
+		delayacct_integrity_end();
+		digsig_boot_stall(stall);
+	}
+
+	digsig_stats_add(DIGSIG_PHASE_TOTAL, start);
+	if (retval < 0)
+		trace_digsig_deny(file, retval);
+
+	return screened && !retval ? DIGSIG_SCREEN_QUEUED : retval;
+}
+
+struct digsig_audit {
+	struct work_struct work;
+	struct file *file;
+};
+
+static void digsig_audit_worker(struct work_struct *work)
+{
+	struct digsig_audit *a = container_of(work, struct digsig_audit,
+					      work);
+	struct inode *inode = file_inode(a->file);
+	struct digsig_prio prio;
+	int retval;
+
+	digsig_prio_background(&prio);
+	retval = __digsig_check_exec(a->file, NULL, 0, NULL);
+	digsig_prio_restore(&prio);
+	if (retval) {
+		trace_digsig_audit(a->file, retval);
+		DSM_LOG(DIGSIG_MODULE_NAME ": audit: %s (dev %u:%u ino %lu) would be denied: %d\n",
+			a->file->f_dentry->d_name.name,
+			MAJOR(inode->i_sb->s_dev), MINOR(inode->i_sb->s_dev),
+			inode->i_ino, retval);
+	}
+	clear_bit(DIGSIG_INODE_AUDIT, &digsig_inode_sec(inode)->flags);
+
+	fput(a->file);
+	kfree(a);
+}
+
+/*
+ * In audit mode, let a file without a verdict through at once and
+ * verify it in the background, once however often it is mapped
+ * meanwhile.  A file already found wanting was already reported.
+ */
+static int digsig_audit_exec(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec;
+	struct digsig_audit *a;
+	int result;
+
+	if (digsig_inode_verified(inode) || digsig_inode_denied(inode, &result))
+		return 0;
+	isec = digsig_inode_get(inode);
+	if (!isec || test_and_set_bit(DIGSIG_INODE_AUDIT, &isec->flags))
+		return 0;
+	a = kmalloc(sizeof(*a), GFP_KERNEL);
+	if (!a) {
+		clear_bit(DIGSIG_INODE_AUDIT, &isec->flags);
+		return 0;
+	}
+
+	a->file = get_file(file);
+	INIT_WORK(&a->work, digsig_audit_worker);
+	queue_work(system_unbound_wq, &a->work);
+	return 0;
+}
+
+static int digsig_check_exec(struct file *file, const char *hdr)
+{
+	int retval;
+
+	if (ACCESS_ONCE(dsi_audit))
+		return digsig_audit_exec(file);
+
+	/* the header is read again there, the cache may have it */
+	retval = -EAGAIN;
+	if (digsig_offload_wanted(file))
+		retval = digsig_offload(file);
+	if (retval == -EAGAIN)
+		retval = __digsig_check_exec(file, hdr, 0, NULL);
+	if (!retval)
+		digsig_profile_hit(file);
+	return retval;
+}
+
+/******************************************************************************
+Description : The key is loaded: turn the hooks on.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_set_active(void)
+{
+	/* verifiers read the key locklessly once g_init is seen */
+	smp_wmb();
+	g_init = 1;
+	/* the first exec does not allocate, nor load a hash module */
+	digsig_verify_warm_up();
+	/* before the hooks are on, so no verdict misses the database */
+	digsig_revoke_db_load();
+	digsig_boot_start();
+	digsig_keyring_seal();
+	static_key_slow_inc(&digsig_active_key);
+}
+
+/******************************************************************************
+Description : Verify a file ahead of its use, as mapping it for exec
+	would, so that its verdict is cached.
+Parameters  :
+	@file: a regular file opened for reading
+Return value: 0 if the file may be executed, negative otherwise
+******************************************************************************/
+int digsig_verify_file(struct file *file)
+{
+	if (!g_init)
+		return -ENOKEY;
+	/* from workers, or a task already moved off its isolated CPU */
+	return __digsig_check_exec(file, NULL, 0, NULL);
+}
+
+/******************************************************************************
+Description : Verify a file in bulk, ahead of a use that may not come
+	soon, without leaving in the page cache the pages read to hash it.
+Parameters  :
+	@file: a regular file opened for reading
+Return value: 0 if the file may be executed, negative otherwise
+******************************************************************************/
+int digsig_verify_file_stream(struct file *file)
+{
+	if (!g_init)
+		return -ENOKEY;
+	return __digsig_check_exec(file, NULL, DIGSIG_CHECK_STREAM, NULL);
+}
+
+/******************************************************************************
+Description : Verify a file in bulk, as digsig_verify_file_stream() does,
+	with its RSA signature screened in a batch with others if it can be.
+Parameters  :
+	@file: a regular file opened for reading
+	@s: the batches, from digsig_screen_alloc(); NULL to verify the
+	    file by itself
+Return value: 0 if the file may be executed, negative otherwise, or
+	DIGSIG_SCREEN_QUEUED if the batch is to tell: the file is then
+	held until the batch is screened
+******************************************************************************/
+int digsig_verify_file_screen(struct file *file, struct digsig_screen *s)
+{
+	if (!g_init)
+		return -ENOKEY;
+	return __digsig_check_exec(file, NULL, DIGSIG_CHECK_STREAM, s);
+}
+
+/******************************************************************************
+Description : Keep the verdict of a file whose signature passed with its
+	batch, as one verified by itself would be kept, but only in memory.
+Parameters  :
+	@file: the file, still held by the batch
+	@verdict: its verdict, which records no signature
+Return value: none
+******************************************************************************/
+void digsig_verdict_screened(struct file *file, struct digsig_verdict verdict)
+{
+	digsig_remember_verdict(file_inode(file), verdict);
+}
+
+static int digsig_mmap_file(struct file *file,
+			unsigned long reqprot,
+			unsigned long calcprot,
+			unsigned long flags)
+{
+	int retval;
+
+	if (!digsig_active())
+		return 0;
+
+	if (file && (flags & MAP_SHARED) && (calcprot & PROT_WRITE))
+		digsig_inode_changed(file_inode(file));
+
+	if (!(reqprot & VM_EXEC))
+		return 0;
+	if (!file)
+		return 0;
+
+	retval = digsig_check_exec(file, NULL);
+	/* which of its pages are signed, for digsig_file_mmapped() */
+	if (!retval)
+		retval = digsig_segments_learn(file);
+	return retval;
+}
+
+/* the pages of a file signed by segment that are not, are not executed */
+static int digsig_file_mmapped(struct file *file, unsigned long addr,
+			       unsigned long len)
+{
+	if (!digsig_active())
+		return 0;
+	return digsig_segments_mmapped(file, addr, len);
+}
+
+/*
+ * Verification has just read the whole file into the page cache: fault the
+ * start of an executable mapping of a verified file in at once, rather than
+ * a page at a time as the program runs.  Writable mappings are left alone,
+ * faulting them in would copy every page.
+ */
+static unsigned long digsig_mmap_populate(struct file *file,
+					  unsigned long prot,
+					  unsigned long flags,
+					  unsigned long len)
+{
+	unsigned long max = (unsigned long)ACCESS_ONCE(dsi_prefault_kb) << 10;
+
+	if (!max || !digsig_active())
+		return 0;
+	if (!(prot & PROT_EXEC) || (prot & PROT_WRITE))
+		return 0;
+	if (!digsig_inode_verified(file_inode(file)))
+		return 0;
+	return min(len, max);
+}
 
-	end_digsig_bench;
+/*
+ * The main executable is checked here, from the header exec already
+ * read, rather than when binfmt_elf maps it: the mapping then finds the
+ * verdict in the inode, and the writer count held by the file.
+ */
+static int digsig_bprm_check_security(struct linux_binprm *bprm)
+{
+	int verified, retval;
 
+	digsig_handover_exec(bprm);
+	if (!digsig_active())
+		return 0;
+
+	/* a program run before has had its libraries verified as well */
+	verified = digsig_inode_verified(file_inode(bprm->file));
+	/* ld.so is verified while the binary is */
+	if (!verified)
+		digsig_preload_interp(bprm->file, bprm->buf);
+	retval = digsig_check_exec(bprm->file, bprm->buf);
+	if (!retval && !verified)
+		digsig_preload_exec(bprm->file, bprm->buf);
 	return retval;
 }
 
+/*
+ * The security.digsig stamp is written by DigSig only; userspace can
+ * neither forge nor remove it.
+ */
+static int digsig_inode_setxattr(struct dentry *dentry, const char *name,
+				 const void *value, size_t size, int flags)
+{
+	if (digsig_xattr_protected(name))
+		return -EPERM;
+	/* a verdict may rest on the signature, or be made without one */
+	if (digsig_active() && digsig_detached_name(name) && dentry->d_inode)
+		digsig_inode_changed(dentry->d_inode);
+
+	return cap_inode_setxattr(dentry, name, value, size, flags);
+}
+
+static int digsig_inode_removexattr(struct dentry *dentry, const char *name)
+{
+	if (digsig_xattr_protected(name))
+		return -EPERM;
+	if (digsig_active() && digsig_detached_name(name) && dentry->d_inode)
+		digsig_inode_changed(dentry->d_inode);
+
+	return cap_inode_removexattr(dentry, name);
+}
+
+/* the sig_cache entry outlives the inode, the file may be read back */
 static void digsig_inode_free_security(struct inode *inode)
 {
-	if (is_cached_signature(inode))
-		remove_signature(inode);
+	digsig_inode_free(inode);
+}
+
+/* the policy is known before the first file of the mount is mapped */
+static int digsig_sb_kern_mount(struct super_block *sb, int flags, void *data)
+{
+	if (digsig_active()) {
+		digsig_sb_compute(sb);
+		digsig_bundle_apply(sb);
+		digsig_loop_mount(sb);
+	}
+	return 0;
+}
+
+/* the verdicts of the superblock go with its id, under sb_lock */
+static void digsig_sb_free_security(struct super_block *sb)
+{
+	if (digsig_active())
+		digsig_cache_forget_sb(digsig_sb_id(sb));
+	digsig_sb_free(sb);
+}
+
+/* files may have been changed while it was mounted elsewhere */
+static int digsig_sb_remount(struct super_block *sb, void *data)
+{
+	if (digsig_active()) {
+		digsig_cache_forget_sb(digsig_sb_renew_id(sb));
+		/* the image under it is still the one its bundle was for */
+		digsig_bundle_apply(sb);
+	}
+	return 0;
 }
 
 static struct security_operations digsig_security_ops = {
 	.name			= "digsig",
+	.bprm_check_security	= digsig_bprm_check_security,
 	.mmap_file		= digsig_mmap_file,
+	.mmap_populate		= digsig_mmap_populate,
+	.file_mmapped		= digsig_file_mmapped,
 	.file_free_security	= digsig_file_free_security,
 	.inode_permission	= digsig_inode_permission,
+	.inode_setattr		= digsig_inode_setattr,
+	.file_open		= digsig_file_open,
+	.file_permission	= digsig_file_permission,
+	.file_mprotect		= digsig_file_mprotect,
 	.inode_unlink		= digsig_inode_unlink,
+	.inode_setxattr		= digsig_inode_setxattr,
+	.inode_removexattr	= digsig_inode_removexattr,
 	.inode_free_security    = digsig_inode_free_security,
+	.sb_kern_mount		= digsig_sb_kern_mount,
+	.sb_free_security	= digsig_sb_free_security,
+	.sb_remount		= digsig_sb_remount,
 };
 
 static int __init digsig_init_module(void)
@@ -718,11 +2052,70 @@ static int __init digsig_init_module(void)
 
 	if (digsig_init_caching())
 		goto out;
+	if (digsig_init_ghost())
+		DSM_ERROR("%s: no ghosts to tell cache misses apart\n", __func__);
+
+	if (digsig_init_inode())
+		goto out_cache;
+	if (digsig_init_recent())
+		DSM_ERROR("%s: no record of recent verifications\n", __func__);
+
+	digsig_init_verify();
+	digsig_init_digest();
+	if (digsig_init_memo())
+		DSM_ERROR("%s: no memo of valid signatures\n", __func__);
+	digsig_init_keyring();
+	if (digsig_init_securityfs())
+		DSM_ERROR("%s: no securityfs directory\n", __func__);
+	if (digsig_init_stats())
+		DSM_ERROR("%s: no latency histograms\n", __func__);
+	if (digsig_init_pmu())
+		DSM_ERROR("%s: no hardware counters per phase\n", __func__);
+	if (digsig_init_top())
+		DSM_ERROR("%s: no table of the most expensive files\n", __func__);
+	if (digsig_init_boot())
+		DSM_ERROR("%s: no report of the cost of boot\n", __func__);
+	if (digsig_init_hashsel())
+		DSM_ERROR("%s: no choice of hash implementations\n", __func__);
+	if (digsig_init_engine())
+		DSM_ERROR("%s: no choice of RSA engines\n", __func__);
+	if (digsig_init_sbstats())
+		DSM_ERROR("%s: no counters per superblock\n", __func__);
+	if (digsig_init_lockstat())
+		DSM_ERROR("%s: no lock contention counters\n", __func__);
+	if (digsig_init_replay())
+		DSM_ERROR("%s: no replay of recorded execs\n", __func__);
+	if (digsig_init_views())
+		DSM_ERROR("%s: no views of the cache and keys\n", __func__);
+	if (digsig_init_async())
+		DSM_ERROR("%s: no priorities of asynchronous verifications\n",
+			  __func__);
+	if (digsig_init_bulk())
+		DSM_ERROR("%s: no bulk verification on every CPU\n", __func__);
+	if (digsig_init_preload())
+		DSM_ERROR("%s: no preload manifest\n", __func__);
+	if (digsig_init_installer())
+		DSM_ERROR("%s: no trusted installers\n", __func__);
+	if (digsig_init_profile())
+		DSM_ERROR("%s: no boot profile\n", __func__);
+	if (digsig_init_handover())
+		DSM_ERROR("%s: no handover to the next kernel\n", __func__);
+	if (digsig_init_query())
+		DSM_ERROR("%s: no verdict queries\n", __func__);
+	if (digsig_init_bundle())
+		DSM_ERROR("%s: no verdict bundles\n", __func__);
+	if (digsig_init_tree())
+		DSM_ERROR("%s: no verification of directory trees\n",
+			  __func__);
+	if (digsig_init_revoke_rules())
+		DSM_ERROR("%s: no revocation rules\n", __func__);
+	if (digsig_init_offload())
+		DSM_ERROR("%s: files are verified on isolated CPUs\n", __func__);
 
 	ret = -EINVAL;
 	if (digsig_init_sysfs()) {
 		DSM_ERROR("Error setting up sysfs for DigSig\n");
-		goto out_cache;
+		goto out_inode;
 	}
 
 	/* register */
@@ -730,9 +2123,15 @@ static int __init digsig_init_module(void)
 		DSM_ERROR("%s: Failure registering DigSig as primary security module\n", __func__);
 		goto out_sysfs;
 	}
+
+	/* enforce from here on, before init runs, if the key is built in */
+	if (digsig_init_builtin_key())
+		DSM_ERROR("%s: waiting for a key in /sys/digsig/key\n", __func__);
 	return 0;
 out_sysfs:
 	digsig_cleanup_sysfs();
+out_inode:
+	digsig_inode_cleanup();
 out_cache:
 	digsig_cache_cleanup();
 out:
@@ -0,0 +1,265 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file hashes large files with an asynchronous hash driver, such
+ * as a hardware hash engine, handing it the page cache pages of the
+ * file as scatterlists and sleeping until it is done.
+ *
+ * A multi-buffer driver, which hashes the requests of several tasks at
+ * once in the lanes of its SIMD registers and flushes partly filled
+ * lanes after a timeout, is one too: with dsi_ahash_min_kb=0, every
+ * file goes to it, so that the verifications running at once, as at
+ * boot or through the preload workers, share its lanes.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/scatterlist.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <crypto/hash.h>
+#include <trace/events/digsig.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_ahash.h"
+
+/* pages handed to the driver in one update */
+#define DIGSIG_AHASH_BATCH 64
+
+int dsi_ahash = 0;
+module_param(dsi_ahash, int, 0);
+MODULE_PARM_DESC(dsi_ahash, "Hash large files with an asynchronous hash driver when there is one.\n");
+
+/* smaller files are hashed faster on the CPU, unless the driver batches */
+static int dsi_ahash_min_kb = 1024;
+module_param(dsi_ahash_min_kb, int, 0);
+MODULE_PARM_DESC(dsi_ahash_min_kb, "Files smaller than this, in kilobytes, are hashed on the CPU rather than by the driver.\n");
+
+/*
+ * Transforms are allocated on first use and kept.  An algorithm with no
+ * asynchronous driver is remembered as such, so that it is not looked
+ * up again for every file.
+ */
+static struct crypto_ahash *digsig_ahash_tfm[DIGSIG_HASH_ALGOS];
+
+static struct crypto_ahash *digsig_get_ahash(int algo)
+{
+	struct crypto_ahash *tfm, *old;
+
+	tfm = ACCESS_ONCE(digsig_ahash_tfm[algo]);
+	if (tfm) {
+		smp_read_barrier_depends();
+		return tfm;
+	}
+
+	/* only asynchronous drivers: the others are used through shash */
+	tfm = crypto_alloc_ahash(digsig_hash_name(algo), CRYPTO_ALG_ASYNC,
+				 CRYPTO_ALG_ASYNC);
+
+	old = cmpxchg(&digsig_ahash_tfm[algo], NULL, tfm);
+	if (old) {
+		if (!IS_ERR(tfm))
+			crypto_free_ahash(tfm);
+		tfm = old;
+	}
+	return tfm;
+}
+
+struct digsig_ahash_result {
+	struct completion done;
+	int err;
+};
+
+static void digsig_ahash_done(struct crypto_async_request *req, int err)
+{
+	struct digsig_ahash_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+	res->err = err;
+	complete(&res->done);
+}
+
+static int digsig_ahash_wait(int err, struct digsig_ahash_result *res)
+{
+	if (err == -EINPROGRESS || err == -EBUSY) {
+		wait_for_completion(&res->done);
+		INIT_COMPLETION(res->done);
+		err = res->err;
+	}
+	return err;
+}
+
+/*
+ * digsig_ahash_batch: the scatterlist of one update, and the pages it
+ * points to, which are held until the driver is done with them.
+ */
+struct digsig_ahash_batch {
+	struct scatterlist sg[DIGSIG_AHASH_BATCH + 2];
+	struct page *pages[DIGSIG_AHASH_BATCH];
+	unsigned int nsg, npages, nbytes;
+};
+
+static void digsig_ahash_drop(struct digsig_ahash_batch *b)
+{
+	unsigned int i;
+
+	for (i = 0; i < b->npages; i++)
+		page_cache_release(b->pages[i]);
+	sg_init_table(b->sg, ARRAY_SIZE(b->sg));
+	b->nsg = b->npages = b->nbytes = 0;
+}
+
+/*
+ * Hand the batch to the driver; with digest, as the last of the file,
+ * along with the final, so that the driver sees one request for both.
+ */
+static int digsig_ahash_flush(struct ahash_request *req,
+			      struct digsig_ahash_batch *b,
+			      struct digsig_ahash_result *res, u8 *digest)
+{
+	int err = 0;
+
+	if (b->nsg) {
+		sg_mark_end(&b->sg[b->nsg - 1]);
+		ahash_request_set_crypt(req, b->sg, digest, b->nbytes);
+		err = digsig_ahash_wait(digest ? crypto_ahash_finup(req) :
+					crypto_ahash_update(req), res);
+	} else if (digest) {
+		ahash_request_set_crypt(req, NULL, digest, 0);
+		err = digsig_ahash_wait(crypto_ahash_final(req), res);
+	}
+	digsig_ahash_drop(b);
+	return err;
+}
+
+static void digsig_ahash_add(struct digsig_ahash_batch *b, struct page *page,
+			     unsigned int off, unsigned int len)
+{
+	sg_set_page(&b->sg[b->nsg++], page, len, off);
+	b->nbytes += len;
+}
+
+/*
+ * Add the bytes [start, end) of the file, all within page, with the
+ * part overlapping the signature section taken from the zero page.
+ * The section is at most DIGSIG_ELF_SIG_SIZE bytes, so it overlaps at
+ * most two pages, hence the two spare scatterlist entries.
+ */
+static void digsig_ahash_add_page(struct digsig_ahash_batch *b,
+				  struct page *page, loff_t start, loff_t end,
+				  loff_t sh_offset,
+				  unsigned long sig_size)
+{
+	loff_t lower = sh_offset, upper = sh_offset + sig_size;
+
+	b->pages[b->npages++] = page;
+	if (end <= lower || start >= upper) {
+		digsig_ahash_add(b, page, start & ~PAGE_MASK, end - start);
+		return;
+	}
+
+	lower = max(lower, start);
+	upper = min(upper, end);
+	if (lower > start)
+		digsig_ahash_add(b, page, start & ~PAGE_MASK, lower - start);
+	digsig_ahash_add(b, ZERO_PAGE(0), 0, upper - lower);
+	if (end > upper)
+		digsig_ahash_add(b, page, upper & ~PAGE_MASK, end - upper);
+}
+
+/******************************************************************************
+Description : Hash a file with an asynchronous driver of the context's
+	hash algorithm, if DigSig was booted with dsi_ahash=1, the file is
+	of at least dsi_ahash_min_kb and there is such a driver.  The task
+	sleeps while the driver hashes.
+Parameters  :
+	@ctx: a context whose verification was started; on success its
+	      digest is the file hash and digsig_sign_verify_final() does
+	      not finish its own hash
+	@file: the file, read through its page cache
+	@sh_offset, @sig_size: where the signature section is
+Return value: 0 on success, -ENOENT if the file is to be hashed on the
+	CPU, another negative error if hashing it failed
+******************************************************************************/
+int digsig_ahash_file(SIGCTX *ctx, struct file *file,
+		      loff_t sh_offset, unsigned long sig_size)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct digsig_ahash_result res;
+	struct digsig_ahash_batch *b;
+	struct ahash_request *req;
+	struct crypto_ahash *tfm;
+	struct page *page;
+	loff_t i_size, pos, end, reported = 0;
+	pgoff_t index;
+	int err;
+
+	i_size = i_size_read(file->f_dentry->d_inode);
+	if (!dsi_ahash || i_size < (loff_t)dsi_ahash_min_kb << 10 ||
+	    !mapping->a_ops->readpage)
+		return -ENOENT;
+
+	tfm = digsig_get_ahash(ctx->digestAlgo);
+	if (IS_ERR(tfm))
+		return -ENOENT;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	req = ahash_request_alloc(tfm, GFP_KERNEL);
+	if (!b || !req) {
+		err = -ENOMEM;
+		goto out;
+	}
+	sg_init_table(b->sg, ARRAY_SIZE(b->sg));
+
+	init_completion(&res.done);
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+				   CRYPTO_TFM_REQ_MAY_SLEEP,
+				   digsig_ahash_done, &res);
+
+	err = digsig_ahash_wait(crypto_ahash_init(req), &res);
+	for (pos = 0, index = 0; pos < i_size && !err; pos = end, index++) {
+		page = read_mapping_page(mapping, index, file);
+		if (IS_ERR(page)) {
+			err = PTR_ERR(page);
+			DSM_PRINT(DEBUG_SIGN, "%s: Unable to read page %lu: %d\n",
+				  __func__, index, err);
+			break;
+		}
+
+		end = min_t(loff_t, i_size,
+			    (loff_t)(index + 1) << PAGE_CACHE_SHIFT);
+		digsig_ahash_add_page(b, page, pos, end, sh_offset, sig_size);
+		if (b->npages == DIGSIG_AHASH_BATCH && end < i_size) {
+			err = digsig_ahash_flush(req, b, &res, NULL);
+			/* the driver's state can not be kept, give up */
+			if (!err && fatal_signal_pending(current))
+				err = -EINTR;
+			if ((reported ^ end) & ~(DIGSIG_PROGRESS_STEP - 1)) {
+				trace_digsig_verify_progress(file, end, i_size);
+				reported = end;
+			}
+		}
+	}
+	if (!err)
+		err = digsig_ahash_flush(req, b, &res, ctx->digest);
+	else
+		digsig_ahash_drop(b);
+	if (!err)
+		ctx->digest_done = 1;
+
+out:
+	ahash_request_free(req);
+	kfree(b);
+	return err;
+}
@@ -0,0 +1,28 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the asynchronous hashing of files.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_AHASH_H
+#define _DIGSIG_AHASH_H
+
+#include <linux/fs.h>
+#include <linux/errno.h>
+
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_AHASH
+int digsig_ahash_file(SIGCTX *ctx, struct file *file,
+		      loff_t sh_offset, unsigned long sig_size);
+#else
+#define digsig_ahash_file(ctx, file, sh_offset, sig_size) (-ENOENT)
+#endif
+
+#endif /* _DIGSIG_AHASH_H */
@@ -0,0 +1,229 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies files for the rest of the kernel without making it
+ * wait: digsig_verify_submit() takes a file and returns a request, whose
+ * callback runs once the verdict is made, and which can be waited for
+ * with digsig_verify_wait() or let go with digsig_verify_put().
+ *
+ * The request holds the file until it is verified.  It is verified on
+ * the bulk engine if there is one, and on the unbound workqueue if not;
+ * DIGSIG_ASYNC_URGENT puts it on a high priority workqueue instead,
+ * ahead of bulk work, for a file about to be mapped, and
+ * DIGSIG_ASYNC_IDLE on a workqueue of its own, one file at a time at
+ * the lowest priority.  A file whose pages are mostly on one node is
+ * verified on a CPU of that node, see digsig_numa.c, except for the
+ * idle requests, whose workqueue keeps to one file at a time.  A
+ * request cancelled before it starts is not
+ * verified; one already started runs to the end, its verdict cached.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+
+#include "digsig_common.h"
+#include "digsig_preload.h"
+#include "digsig_bulk.h"
+#include "digsig_async.h"
+#include "digsig_ioprio.h"
+#include "digsig_numa.h"
+
+/* the state of a request */
+#define DIGSIG_ASYNC_QUEUED 0
+#define DIGSIG_ASYNC_RUNNING 1
+#define DIGSIG_ASYNC_CANCELLED 2
+
+/*
+ * digsig_async: a request, shared by the submitter and the worker, and
+ * freed by whichever is done with it last.
+ */
+struct digsig_async {
+	struct work_struct work;
+	struct file *file;
+	unsigned int flags;
+	digsig_async_done_t done;
+	void *data;
+	atomic_t state;
+	atomic_t refs;
+	int result;
+	struct completion completion;
+};
+
+static struct workqueue_struct *digsig_async_urgent_wq;
+static struct workqueue_struct *digsig_async_idle_wq;
+
+static void digsig_async_release(struct digsig_async *req)
+{
+	if (!atomic_dec_and_test(&req->refs))
+		return;
+	if (req->file)
+		fput(req->file);
+	kfree(req);
+}
+
+static void digsig_async_worker(struct work_struct *work)
+{
+	struct digsig_async *req = container_of(work, struct digsig_async, work);
+	int urgent = req->flags & DIGSIG_ASYNC_URGENT;
+	struct digsig_prio prio;
+
+	/* an urgent request is waited for, and read as an exec would be */
+	if (!urgent)
+		digsig_prio_background(&prio);
+	if (atomic_cmpxchg(&req->state, DIGSIG_ASYNC_QUEUED,
+			   DIGSIG_ASYNC_RUNNING) == DIGSIG_ASYNC_QUEUED) {
+		if (req->flags & DIGSIG_ASYNC_STREAM)
+			req->result = digsig_verify_file_stream(req->file);
+		else
+			req->result = digsig_verify_file(req->file);
+	} else {
+		req->result = -ECANCELED;
+	}
+	if (!urgent)
+		digsig_prio_restore(&prio);
+	/* the writer count taken by the verification goes with the file */
+	fput(req->file);
+	req->file = NULL;
+
+	if (req->done)
+		req->done(req, req->result, req->data);
+	complete_all(&req->completion);
+	digsig_async_release(req);
+}
+
+/******************************************************************************
+Description : Verify a file in the background, as mapping it for exec
+	would.
+Parameters  :
+	@file: a regular file opened for reading; the request takes its own
+	       reference
+	@flags: DIGSIG_ASYNC_STREAM, and DIGSIG_ASYNC_URGENT or _IDLE
+	@done: called with the result once the file is verified, or NULL
+	@data: passed to @done
+Return value: the request, to be let go with digsig_verify_put(); an
+	ERR_PTR if it could not be made, in which case @done is not called
+******************************************************************************/
+struct digsig_async *digsig_verify_submit(struct file *file,
+					  unsigned int flags,
+					  digsig_async_done_t done,
+					  void *data)
+{
+	struct digsig_async *req;
+	int node;
+
+	if (!g_init)
+		return ERR_PTR(-ENOKEY);
+	if (!S_ISREG(file_inode(file)->i_mode))
+		return ERR_PTR(-EINVAL);
+	if ((flags & DIGSIG_ASYNC_URGENT) && (flags & DIGSIG_ASYNC_IDLE))
+		return ERR_PTR(-EINVAL);
+	req = kmalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return ERR_PTR(-ENOMEM);
+
+	INIT_WORK(&req->work, digsig_async_worker);
+	req->file = get_file(file);
+	req->flags = flags;
+	req->done = done;
+	req->data = data;
+	atomic_set(&req->state, DIGSIG_ASYNC_QUEUED);
+	atomic_set(&req->refs, 2);	/* the submitter's and the worker's */
+	req->result = 0;
+	init_completion(&req->completion);
+
+	node = digsig_numa_file_node(file);
+	if ((flags & DIGSIG_ASYNC_URGENT) && digsig_async_urgent_wq)
+		queue_work_on(digsig_numa_cpu(node), digsig_async_urgent_wq,
+			      &req->work);
+	else if ((flags & DIGSIG_ASYNC_IDLE) && digsig_async_idle_wq)
+		queue_work(digsig_async_idle_wq, &req->work);
+	else if (digsig_bulk_queue_node(&req->work, node))
+		/* the pool of the node of the CPU given */
+		queue_work_on(digsig_numa_cpu(node), system_unbound_wq,
+			      &req->work);
+	return req;
+}
+EXPORT_SYMBOL_GPL(digsig_verify_submit);
+
+/******************************************************************************
+Description : Wait for a request to be done.
+Parameters  :
+	@req: a request not let go yet
+Return value: the result given to its callback, or -EINTR if the caller
+	was killed first
+******************************************************************************/
+int digsig_verify_wait(struct digsig_async *req)
+{
+	if (wait_for_completion_killable(&req->completion))
+		return -EINTR;
+	return req->result;
+}
+EXPORT_SYMBOL_GPL(digsig_verify_wait);
+
+/******************************************************************************
+Description : Cancel a request that has not started; its callback is
+	called with -ECANCELED.
+Parameters  :
+	@req: a request not let go yet
+Return value: 0 if cancelled, -EBUSY if it started or is done
+******************************************************************************/
+int digsig_verify_cancel(struct digsig_async *req)
+{
+	if (atomic_cmpxchg(&req->state, DIGSIG_ASYNC_QUEUED,
+			   DIGSIG_ASYNC_CANCELLED) != DIGSIG_ASYNC_QUEUED)
+		return -EBUSY;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(digsig_verify_cancel);
+
+/******************************************************************************
+Description : Let a request go; it is still verified, unless cancelled.
+Parameters  :
+	@req: the request
+Return value: none
+******************************************************************************/
+void digsig_verify_put(struct digsig_async *req)
+{
+	digsig_async_release(req);
+}
+EXPORT_SYMBOL_GPL(digsig_verify_put);
+
+/******************************************************************************
+Description : Create the workqueues of the urgent requests and of those
+	that are in no hurry.
+Parameters  : none
+Return value: 0 on success, negative otherwise; they are then verified
+	with the others
+******************************************************************************/
+int __init digsig_init_async(void)
+{
+	struct workqueue_attrs *attrs;
+
+	digsig_async_urgent_wq = alloc_workqueue("digsig_urgent", WQ_HIGHPRI,
+						 0);
+	if (!digsig_async_urgent_wq)
+		return -ENOMEM;
+	digsig_async_idle_wq = alloc_workqueue("digsig_idle", WQ_UNBOUND, 1);
+	if (!digsig_async_idle_wq)
+		return -ENOMEM;
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (attrs) {
+		attrs->nice = 19;
+		cpumask_copy(attrs->cpumask, cpu_possible_mask);
+		apply_workqueue_attrs(digsig_async_idle_wq, attrs);
+		free_workqueue_attrs(attrs);
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the asynchronous verification of files.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_ASYNC_H
+#define _DIGSIG_ASYNC_H
+
+#include <linux/digsig_async.h>
+
+int digsig_init_async(void);
+
+#endif /* _DIGSIG_ASYNC_H */
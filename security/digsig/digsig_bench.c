@@ -0,0 +1,372 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains microbenchmarks of the DigSig primitives, in the
+ * spirit of crypto/tcrypt.c: RSA verifications per second, hashing
+ * throughput through the verification contexts, and lookups per second
+ * of the verdict cache from several CPUs at once.  A run is started by
+ * writing its name to /sys/digsig/bench, and its results are logged:
+ *
+ *	rsa		rsa_verify() and rsa_verify_mont() at 1024, 2048
+ *			and 4096 bits
+ *	hash		digsig_sign_verify_update() for each hash
+ *			algorithm, at block sizes from 64 to 16384 bytes
+ *	cache <n>	is_cached_signature() from n CPUs
+ *	replay <n> [fast]
+ *			a recorded sequence of execs, from n threads,
+ *			see digsig_replay.c
+ *
+ * Each measurement runs for dsi_bench_secs seconds.  The RSA keys and
+ * signatures are random: a verification costs the same whether or not
+ * the signature matches.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/cpumask.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_cache.h"
+#include "digsig_sb.h"
+#include "digsig_bench.h"
+#include "digsig_replay.h"
+#include "gnupg/cipher/rsa-verify.h"
+
+#define BENCH_HASH_BUF 16384
+#define BENCH_CACHE_INODES 256
+
+static int dsi_bench_secs = 1;
+module_param(dsi_bench_secs, int, 0);
+MODULE_PARM_DESC(dsi_bench_secs, "Seconds each DigSig benchmark runs for.\n");
+
+/* one run at a time, the runs share the machine */
+static DEFINE_MUTEX(digsig_bench_mutex);
+
+static u64 digsig_bench_rate(u64 n, u64 ns)
+{
+	return ns ? div64_u64(n * NSEC_PER_SEC, ns) : 0;
+}
+
+/*
+ * A random number of nbits bits, odd, with its top bit set if top is
+ * set and clear otherwise.
+ */
+static MPI digsig_bench_random_mpi(unsigned int nbits, int top)
+{
+	unsigned int nbytes = nbits / 8;
+	byte *buf;
+	MPI a;
+
+	buf = kmalloc(nbytes, GFP_KERNEL);
+	if (!buf)
+		return NULL;
+	get_random_bytes(buf, nbytes);
+	if (top)
+		buf[0] |= 0x80;
+	else
+		buf[0] &= 0x7f;
+	buf[nbytes - 1] |= 1;
+
+	a = mpi_alloc((nbits + BITS_PER_MPI_LIMB - 1) / BITS_PER_MPI_LIMB);
+	if (a)
+		mpi_set_buffer(a, buf, nbytes, 0);
+	kfree(buf);
+	return a;
+}
+
+/******************************************************************************
+Description : Time RSA public key operations with a random key.
+Parameters  :
+	@nbits: size of the modulus
+Return value: 0 on success, -ENOMEM
+******************************************************************************/
+static int digsig_bench_rsa_bits(unsigned int nbits)
+{
+	MPI pkey[2] = { NULL, NULL };
+	MPI data = NULL, hash = NULL, result = NULL;
+	MPI_MONT_CTX mont = NULL;
+	mpi_limb_t *ws = NULL;
+	unsigned long end;
+	u64 ops, start, ns;
+	int rc = -ENOMEM, pass;
+
+	pkey[0] = digsig_bench_random_mpi(nbits, 1);
+	pkey[1] = mpi_alloc_set_ui(65537);
+	data = digsig_bench_random_mpi(nbits, 0);
+	hash = mpi_alloc_set_ui(1);
+	result = mpi_alloc(2 * mpi_get_nlimbs(pkey[0]) + 1);
+	if (!pkey[0] || !pkey[1] || !data || !hash || !result)
+		goto out;
+	mont = mpi_mont_alloc(pkey[0]);
+	if (!mont)
+		goto out;
+	ws = kmalloc(MPI_MONT_WS_LIMBS(mont) * sizeof(*ws), GFP_KERNEL);
+	if (!ws)
+		goto out;
+
+	for (pass = 0; pass < 2; pass++) {
+		ops = 0;
+		end = jiffies + dsi_bench_secs * HZ;
+		start = local_clock();
+		while (time_before(jiffies, end)) {
+			if (pass)
+				rsa_verify_mont(hash, &data, pkey, mont, result,
+						ws);
+			else
+				rsa_verify(hash, &data, pkey);
+			ops++;
+			cond_resched();
+		}
+		ns = local_clock() - start;
+		printk(KERN_INFO "digsig_bench: %s %4u bits: %llu ops in %llu ns, "
+		       "%llu ops/s\n", pass ? "rsa_verify_mont" : "rsa_verify",
+		       nbits, ops, ns, digsig_bench_rate(ops, ns));
+	}
+	rc = 0;
+
+out:
+	kfree(ws);
+	mpi_mont_free(mont);
+	mpi_free(result);
+	mpi_free(hash);
+	mpi_free(data);
+	mpi_free(pkey[1]);
+	mpi_free(pkey[0]);
+	return rc;
+}
+
+static int digsig_bench_rsa(void)
+{
+	static const unsigned int sizes[] = { 1024, 2048, 4096 };
+	int i, rc;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		rc = digsig_bench_rsa_bits(sizes[i]);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+/******************************************************************************
+Description : Time hashing through a verification context, as the file
+	hash is computed, for each hash algorithm and block size.
+Parameters  : none
+Return value: 0 on success, negative on failure
+******************************************************************************/
+static int digsig_bench_hash(void)
+{
+	static const int sizes[] = { 64, 256, 1024, 4096, BENCH_HASH_BUF };
+	unsigned long end;
+	u64 bytes, start, ns;
+	SIGCTX *ctx;
+	char *buf;
+	int algo, i, rc = 0;
+
+	buf = kmalloc(BENCH_HASH_BUF, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	get_random_bytes(buf, BENCH_HASH_BUF);
+
+	ctx = digsig_sign_verify_get();
+	if (!ctx) {
+		kfree(buf);
+		return -ENOMEM;
+	}
+
+	for (algo = 0; algo < DIGSIG_HASH_ALGOS && !rc; algo++) {
+		for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+			rc = digsig_sign_verify_init(ctx, algo, SIGN_RSA);
+			if (rc)
+				break;
+			bytes = 0;
+			end = jiffies + dsi_bench_secs * HZ;
+			start = local_clock();
+			while (time_before(jiffies, end)) {
+				rc = digsig_sign_verify_update(ctx, buf,
+							       sizes[i]);
+				if (rc)
+					break;
+				bytes += sizes[i];
+				cond_resched();
+			}
+			ns = local_clock() - start;
+			if (rc)
+				break;
+			/* the driver, to tell the generic code from others */
+			printk(KERN_INFO "digsig_bench: %s (%s) %5d byte blocks: "
+			       "%llu bytes in %llu ns, %llu MB/s\n",
+			       digsig_hash_name(algo),
+			       crypto_tfm_alg_driver_name(
+					crypto_shash_tfm(ctx->desc->tfm)),
+			       sizes[i], bytes, ns,
+			       digsig_bench_rate(bytes, ns) >> 20);
+		}
+	}
+
+	digsig_sign_verify_release(ctx);
+	kfree(buf);
+	return rc;
+}
+
+struct digsig_bench_cache_worker {
+	struct inode *inodes;
+	unsigned long end;
+	u64 ops, hits;
+	struct completion done;
+};
+
+static int digsig_bench_cache_thread(void *arg)
+{
+	struct digsig_bench_cache_worker *w = arg;
+	unsigned int i = 0;
+
+	while (time_before(jiffies, w->end)) {
+		w->hits += is_cached_signature(&w->inodes[i], NULL);
+		w->ops++;
+		if (++i == BENCH_CACHE_INODES) {
+			i = 0;
+			cond_resched();
+		}
+	}
+	complete(&w->done);
+	return 0;
+}
+
+/******************************************************************************
+Description : Time verdict cache lookups from several CPUs at once.
+	The entries belong to inodes that only exist for the run; the cache
+	only compares their address, number and superblock, and gives them
+	a blob.
+Parameters  :
+	@nthreads: number of CPUs to look up from, each from its own thread
+Return value: 0 on success, negative on failure
+******************************************************************************/
+/* the dummy inodes of the cache benchmark need a superblock of their own */
+static struct digsig_sb_sec digsig_bench_sbsec;
+static struct super_block digsig_bench_sb = {
+	.s_time_gran = 1,
+	.s_security = &digsig_bench_sbsec,
+};
+
+static int digsig_bench_cache(int nthreads)
+{
+	struct digsig_bench_cache_worker *w;
+	struct digsig_verdict verdict = { 0, 0 };
+	struct task_struct *task;
+	struct inode *inodes;
+	unsigned long end;
+	u64 ops = 0, hits = 0, start, ns;
+	int cpu, i, n = 0, rc = 0;
+
+	if (nthreads <= 0 || nthreads > num_online_cpus())
+		return -EINVAL;
+
+	inodes = kcalloc(BENCH_CACHE_INODES, sizeof(*inodes), GFP_KERNEL);
+	w = kcalloc(nthreads, sizeof(*w), GFP_KERNEL);
+	if (!inodes || !w) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	atomic64_set(&digsig_bench_sbsec.id, digsig_sb_new_id());
+	for (i = 0; i < BENCH_CACHE_INODES; i++) {
+		inodes[i].i_sb = &digsig_bench_sb;
+		inodes[i].i_ino = i + 1;
+		digsig_cache_signature(&inodes[i], verdict);
+	}
+
+	end = jiffies + dsi_bench_secs * HZ;
+	start = local_clock();
+	for_each_online_cpu(cpu) {
+		if (n == nthreads)
+			break;
+		w[n].inodes = inodes;
+		w[n].end = end;
+		init_completion(&w[n].done);
+		task = kthread_create(digsig_bench_cache_thread, &w[n],
+				      "digsig_bench/%d", cpu);
+		if (IS_ERR(task)) {
+			rc = PTR_ERR(task);
+			break;
+		}
+		kthread_bind(task, cpu);
+		wake_up_process(task);
+		n++;
+	}
+	for (i = 0; i < n; i++) {
+		wait_for_completion(&w[i].done);
+		ops += w[i].ops;
+		hits += w[i].hits;
+	}
+	ns = local_clock() - start;
+
+	for (i = 0; i < BENCH_CACHE_INODES; i++) {
+		remove_signature(&inodes[i]);
+		digsig_inode_free(&inodes[i]);
+	}
+
+	if (!rc)
+		printk(KERN_INFO "digsig_bench: cache %d cpus: %llu lookups "
+		       "(%llu hits) in %llu ns, %llu lookups/s\n", n, ops,
+		       hits, ns, digsig_bench_rate(ops, ns));
+
+out:
+	kfree(w);
+	kfree(inodes);
+	return rc;
+}
+
+/******************************************************************************
+Description : Run the benchmark written to /sys/digsig/bench.
+Parameters  :
+	@cmd: "rsa", "hash", "cache <nthreads>" or
+	      "replay <nthreads> [fast]", not NUL terminated
+	@count: length of cmd
+Return value: 0 on success, negative on failure
+******************************************************************************/
+int digsig_bench_run(const char *cmd, size_t count)
+{
+	char buf[32];
+	int n, rc;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	memcpy(buf, cmd, count);
+	buf[count] = '\0';
+	strim(buf);
+
+	mutex_lock(&digsig_bench_mutex);
+	if (!strcmp(buf, "rsa"))
+		rc = digsig_bench_rsa();
+	else if (!strcmp(buf, "hash"))
+		rc = digsig_bench_hash();
+	else if (sscanf(buf, "cache %d", &n) == 1)
+		rc = digsig_bench_cache(n);
+	else if (!strncmp(buf, "replay ", 7))
+		rc = digsig_replay_run(buf + 7);
+	else
+		rc = -EINVAL;
+	mutex_unlock(&digsig_bench_mutex);
+
+	if (rc)
+		DSM_ERROR("benchmark \"%s\" failed: %d\n", buf, rc);
+	return rc;
+}
@@ -0,0 +1,24 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the microbenchmarks.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BENCH_H
+#define _DIGSIG_BENCH_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_BENCH
+int digsig_bench_run(const char *cmd, size_t count);
+#else
+#define digsig_bench_run(cmd, count) (-EINVAL)
+#endif
+
+#endif /* _DIGSIG_BENCH_H */
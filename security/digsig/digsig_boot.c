@@ -0,0 +1,258 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file reports what DigSig cost boot.  From the time the key is
+ * loaded until boot is marked done, each verification that was not
+ * answered from the cache adds to the phase of boot it happened in: the
+ * files verified, the bytes hashed, the wall and CPU time of the
+ * verifications, and the time tasks stalled waiting for a verification
+ * before their exec or mmap could go on, their own verification or
+ * someone else's.  Verifications done in the background, by workers,
+ * are not stalls.
+ *
+ * Boot starts in the initramfs phase.  The init system writes the name
+ * of the phase it enters, "rootfs" once the real root is mounted,
+ * "services" once it starts them, and "done" when boot is over, to
+ * /sys/kernel/security/digsig/boot; phases only move forward.  With
+ * dsi_boot_secs, boot is also over that many seconds after the key was
+ * loaded, whether or not "done" was written.
+ *
+ * Reading the file gives one line per phase: its name, the time it
+ * started, in nanoseconds after the key was loaded, the files, the
+ * bytes, and the wall, CPU and stall times in nanoseconds, separated by
+ * tabs.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/atomic.h>
+#include <linux/mutex.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_boot.h"
+
+static int dsi_boot_secs = 0;
+module_param(dsi_boot_secs, int, 0);
+MODULE_PARM_DESC(dsi_boot_secs, "Seconds after the key is loaded at which boot is over, 0 to wait for \"done\".\n");
+
+#define DIGSIG_BOOT_INITRAMFS 0
+#define DIGSIG_BOOT_ROOTFS 1
+#define DIGSIG_BOOT_SERVICES 2
+#define DIGSIG_BOOT_PHASES 3
+#define DIGSIG_BOOT_DONE DIGSIG_BOOT_PHASES
+
+static const char *const digsig_boot_names[DIGSIG_BOOT_PHASES + 1] = {
+	[DIGSIG_BOOT_INITRAMFS] = "initramfs",
+	[DIGSIG_BOOT_ROOTFS] = "rootfs",
+	[DIGSIG_BOOT_SERVICES] = "services",
+	[DIGSIG_BOOT_DONE] = "done",
+};
+
+struct digsig_boot_phase {
+	u64 start;		/* local_clock() when it was entered */
+	atomic64_t files;
+	atomic64_t bytes;
+	atomic64_t wall;
+	atomic64_t cpu;
+	atomic64_t stall;
+};
+
+static struct digsig_boot_phase digsig_boot[DIGSIG_BOOT_PHASES];
+
+/* DIGSIG_BOOT_DONE until the key is loaded, and once boot is over */
+static int digsig_boot_phase = DIGSIG_BOOT_DONE;
+static u64 digsig_boot_key;	/* local_clock() when the key was loaded */
+static DEFINE_MUTEX(digsig_boot_lock);
+
+/******************************************************************************
+Description : The key is loaded: boot is counted from now on, in the
+	initramfs phase.  A key loaded again is not a new boot.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_boot_start(void)
+{
+	mutex_lock(&digsig_boot_lock);
+	if (!digsig_boot_key) {
+		digsig_boot_key = local_clock();
+		digsig_boot[DIGSIG_BOOT_INITRAMFS].start = digsig_boot_key;
+		/* the start is seen before the phase is */
+		smp_wmb();
+		ACCESS_ONCE(digsig_boot_phase) = DIGSIG_BOOT_INITRAMFS;
+	}
+	mutex_unlock(&digsig_boot_lock);
+}
+
+/* The phase to count in, DIGSIG_BOOT_DONE if none. */
+static int digsig_boot_current(void)
+{
+	int phase = ACCESS_ONCE(digsig_boot_phase);
+
+	if (phase == DIGSIG_BOOT_DONE || !dsi_boot_secs)
+		return phase;
+	if (local_clock() - digsig_boot_key <
+	    (u64)dsi_boot_secs * NSEC_PER_SEC)
+		return phase;
+	ACCESS_ONCE(digsig_boot_phase) = DIGSIG_BOOT_DONE;
+	return DIGSIG_BOOT_DONE;
+}
+
+/******************************************************************************
+Description : Note when a verification starts, to count it once it ends.
+Parameters  :
+	@b: where the start is kept, for digsig_boot_end()
+Return value: none
+******************************************************************************/
+void digsig_boot_begin(struct digsig_boot_mark *b)
+{
+	b->wall = 0;
+	if (ACCESS_ONCE(digsig_boot_phase) == DIGSIG_BOOT_DONE)
+		return;
+	b->cpu = task_sched_runtime(current);
+	b->wall = local_clock();
+}
+
+/******************************************************************************
+Description : Count a verification in the phase of boot it ends in.
+Parameters  :
+	@b: what digsig_boot_begin() noted
+	@bytes: the bytes hashed
+Return value: none
+******************************************************************************/
+void digsig_boot_end(struct digsig_boot_mark *b, u64 bytes)
+{
+	struct digsig_boot_phase *p;
+	int phase;
+
+	if (!b->wall)
+		return;
+	phase = digsig_boot_current();
+	if (phase == DIGSIG_BOOT_DONE)
+		return;
+	p = &digsig_boot[phase];
+	atomic64_inc(&p->files);
+	atomic64_add(bytes, &p->bytes);
+	atomic64_add(local_clock() - b->wall, &p->wall);
+	atomic64_add(task_sched_runtime(current) - b->cpu, &p->cpu);
+}
+
+/******************************************************************************
+Description : Count the time a task waited for a verification before its
+	exec or mmap went on.
+Parameters  :
+	@start: local_clock() when it started waiting
+Return value: none
+******************************************************************************/
+void digsig_boot_stall(u64 start)
+{
+	int phase;
+
+	if (current->flags & PF_WQ_WORKER)
+		return;
+	phase = digsig_boot_current();
+	if (phase == DIGSIG_BOOT_DONE)
+		return;
+	atomic64_add(local_clock() - start, &digsig_boot[phase].stall);
+}
+
+static int digsig_boot_show(struct seq_file *m, void *v)
+{
+	struct digsig_boot_phase *p;
+	int i, phase = digsig_boot_current();
+
+	seq_puts(m, "# phase\tstart\tfiles\tbytes\twall\tcpu\tstall\n");
+	if (!digsig_boot_key)
+		return 0;
+	for (i = 0; i < DIGSIG_BOOT_PHASES; i++) {
+		p = &digsig_boot[i];
+		/* a phase skipped over has no start */
+		if (!p->start)
+			continue;
+		seq_printf(m, "%s\t%llu\t%lld\t%lld\t%lld\t%lld\t%lld\n",
+			   digsig_boot_names[i], p->start - digsig_boot_key,
+			   (long long)atomic64_read(&p->files),
+			   (long long)atomic64_read(&p->bytes),
+			   (long long)atomic64_read(&p->wall),
+			   (long long)atomic64_read(&p->cpu),
+			   (long long)atomic64_read(&p->stall));
+	}
+	if (phase == DIGSIG_BOOT_DONE)
+		seq_puts(m, "done\n");
+	return 0;
+}
+
+static int digsig_boot_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_boot_show, NULL);
+}
+
+static ssize_t digsig_boot_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	char kbuf[16], *name;
+	size_t len = min(count, sizeof(kbuf) - 1);
+	int i;
+
+	if (copy_from_user(kbuf, buf, len))
+		return -EFAULT;
+	kbuf[len] = '\0';
+	name = strim(kbuf);
+	for (i = DIGSIG_BOOT_ROOTFS; i <= DIGSIG_BOOT_DONE; i++)
+		if (!strcmp(name, digsig_boot_names[i]))
+			break;
+	if (i > DIGSIG_BOOT_DONE)
+		return -EINVAL;
+
+	mutex_lock(&digsig_boot_lock);
+	/* before the key, or after boot, there is nothing to move */
+	if (digsig_boot_current() == DIGSIG_BOOT_DONE ||
+	    i <= digsig_boot_phase) {
+		mutex_unlock(&digsig_boot_lock);
+		return -EINVAL;
+	}
+	if (i != DIGSIG_BOOT_DONE) {
+		digsig_boot[i].start = local_clock();
+		smp_wmb();
+	}
+	ACCESS_ONCE(digsig_boot_phase) = i;
+	mutex_unlock(&digsig_boot_lock);
+	return count;
+}
+
+static const struct file_operations digsig_boot_fops = {
+	.open = digsig_boot_open,
+	.read = seq_read,
+	.write = digsig_boot_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/boot.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_boot(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("boot", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_boot_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
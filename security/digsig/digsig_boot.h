@@ -0,0 +1,38 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the report of what DigSig cost boot.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BOOT_H
+#define _DIGSIG_BOOT_H
+
+#include <linux/types.h>
+
+/* the start of a verification, 0 wall when it is not counted */
+struct digsig_boot_mark {
+	u64 wall;
+	u64 cpu;
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_BOOT_REPORT
+void digsig_boot_start(void);
+void digsig_boot_begin(struct digsig_boot_mark *b);
+void digsig_boot_end(struct digsig_boot_mark *b, u64 bytes);
+void digsig_boot_stall(u64 start);
+int digsig_init_boot(void);
+#else
+static inline void digsig_boot_start(void) { }
+static inline void digsig_boot_begin(struct digsig_boot_mark *b) { }
+static inline void digsig_boot_end(struct digsig_boot_mark *b, u64 bytes) { }
+static inline void digsig_boot_stall(u64 start) { }
+#define digsig_init_boot() 0
+#endif
+
+#endif /* _DIGSIG_BOOT_H */
@@ -0,0 +1,119 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file loads the public key built into the kernel, so that DigSig
+ * is active from its own initialization, before init or anything of
+ * userspace runs, rather than from the first write to /sys/digsig/key.
+ *
+ * The key is the file CONFIG_SECURITY_DIGSIG_BUILTIN_KEY_FILE names, as
+ * tools/digsig/digsig-sign -P writes it: for RSA, n then e as two
+ * OpenPGP MPIs back to back, which then stand for the 'n' and 'e'
+ * writes; for Ed25519, the 8 byte key ID then the 32 byte key, as the
+ * 'k' write takes them.  Further keys may still be added by key ID.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/errno.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_ed25519.h"
+#include "digsig_initramfs.h"
+#include "digsig_preload.h"
+#include "digsig_builtin.h"
+
+extern const u8 digsig_builtin_key[], digsig_builtin_key_end[];
+
+static int digsig_builtin_loaded __initdata;
+
+/* the length of the OpenPGP MPI at @p, 0 if it does not fit in @len */
+static unsigned int __init digsig_builtin_mpi_len(const u8 *p,
+						  unsigned int len)
+{
+	unsigned int n;
+
+	if (len < 2)
+		return 0;
+	n = 2 + ((p[0] << 8 | p[1]) + 7) / 8;
+	return n <= len ? n : 0;
+}
+
+static int __init digsig_builtin_rsa(const u8 *key, unsigned int len)
+{
+	unsigned int nlen = digsig_builtin_mpi_len(key, len);
+
+	if (!nlen || digsig_builtin_mpi_len(key + nlen, len - nlen) !=
+	    len - nlen)
+		return -EINVAL;
+
+	digsig_init_pkey('n', (unsigned char *)key, nlen);
+	digsig_init_pkey('e', (unsigned char *)key + nlen, len - nlen);
+	if (!digsig_public_key[0] || !digsig_public_key[1])
+		return -ENOMEM;
+
+	if (digsig_init_key_context())
+		DSM_PRINT(DEBUG_SIGN, "%s: no Montgomery context for the key\n",
+			  __func__);
+	return 0;
+}
+
+/******************************************************************************
+Description : Load the built-in public key and turn the hooks on, as the
+	write of a key would.  Called at the end of digsig_init_module(),
+	once everything the first verification needs is set up.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig then waits for a
+	key to be written as usual
+******************************************************************************/
+int __init digsig_init_builtin_key(void)
+{
+	unsigned int len = digsig_builtin_key_end - digsig_builtin_key;
+	int rc;
+
+	if (len == ED25519_KEYID_SIZE + ED25519_KEY_SIZE)
+		rc = digsig_ed25519_set_key(digsig_builtin_key +
+					    ED25519_KEYID_SIZE,
+					    digsig_builtin_key);
+	else
+		rc = digsig_builtin_rsa(digsig_builtin_key, len);
+	if (rc) {
+		DSM_ERROR("%s: the built-in key is unusable: %d\n",
+			  __func__, rc);
+		return rc;
+	}
+
+	/* SHA-1 may not be registered yet, see digsig_builtin_fingerprint() */
+	if (digsig_init_key_fingerprint())
+		DSM_PRINT(DEBUG_INIT, "%s: no key fingerprint yet\n", __func__);
+	digsig_builtin_loaded = 1;
+	digsig_set_active();
+	digsig_initramfs_trust();
+	digsig_preload_start();
+	DSM_PRINT(DEBUG_INIT, "%s: enforcing with the built-in key\n",
+		  __func__);
+	return 0;
+}
+
+/*
+ * security/ is linked before crypto/, so sha1_generic registers after
+ * digsig_init_builtin_key() ran: the fingerprint is computed again once
+ * every initcall before this one has.  Until it is, the stamps and
+ * flags bound to it are off.
+ */
+static int __init digsig_builtin_fingerprint(void)
+{
+	if (!digsig_builtin_loaded || digsig_key_fpr_valid())
+		return 0;
+	if (digsig_init_key_fingerprint())
+		DSM_ERROR("%s: cannot compute key fingerprint, the persistent caches are off\n",
+			  __func__);
+	return 0;
+}
+late_initcall(digsig_builtin_fingerprint);
@@ -0,0 +1,22 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the loading of the public key built into the kernel.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BUILTIN_H
+#define _DIGSIG_BUILTIN_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_BUILTIN_KEY
+int digsig_init_builtin_key(void);
+#else
+#define digsig_init_builtin_key() 0
+#endif
+
+#endif /* _DIGSIG_BUILTIN_H */
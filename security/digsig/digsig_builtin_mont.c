@@ -0,0 +1,178 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file raises signatures to the exponent of the public key built
+ * into the kernel with code specialized for that key at build time.
+ * scripts/digsig_mont computes the Montgomery constants of the key's
+ * modulus from CONFIG_SECURITY_DIGSIG_BUILTIN_KEY_FILE, and unrolls the
+ * square and multiply ladder of its exponent, into
+ * digsig_builtin_mont_key.h: the constants are in .rodata, where
+ * mpi_mont_alloc() would compute them at boot, and the limb count is a
+ * constant, so that the loops below are sized at compile time.
+ *
+ * Only the key built in runs through here, and only while it is the key
+ * loaded as 'n' and 'e'; other keys take mpi_powm_mont_ws() as before.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "gnupg/mpi/mpi-internal.h"
+#include "digsig_builtin_mont.h"
+#include "digsig_builtin_mont_key.h"
+
+#ifdef DIGSIG_BUILTIN_MONT_K
+
+#define K DIGSIG_BUILTIN_MONT_K
+
+static const mpi_limb_t digsig_builtin_n[K] = DIGSIG_BUILTIN_MONT_N;
+static const mpi_limb_t digsig_builtin_rr[K] = DIGSIG_BUILTIN_MONT_RR;
+
+/* only read: mpi_mont_free() leaves a fixed context alone */
+static struct mpi_mont_ctx_s digsig_builtin_mont = {
+	.nlimbs = K,
+	.n = (mpi_limb_t *)digsig_builtin_n,
+	.rr = (mpi_limb_t *)digsig_builtin_rr,
+	.ninv = DIGSIG_BUILTIN_MONT_NINV,
+	.fixed = 1,
+};
+
+/*
+ * RP = TP / R mod n, for TP < n * R of 2 * K limbs.  The carry of each
+ * row is added in at the limb above it as the next row is, rather than
+ * propagated to the top at once.
+ */
+static void digsig_builtin_redc(mpi_ptr_t rp, mpi_ptr_t tp)
+{
+	mpi_ptr_t n = (mpi_ptr_t)digsig_builtin_n;
+	mpi_limb_t cy, t, top = 0;
+	int i;
+
+	for (i = 0; i < K; i++) {
+		cy = mpihelp_addmul_1(tp + i, n, K,
+				      tp[i] * DIGSIG_BUILTIN_MONT_NINV);
+		t = tp[i + K] + top;
+		top = t < top;
+		t += cy;
+		top += t < cy;
+		tp[i + K] = t;
+	}
+
+	/* the result is below 2n, one subtraction brings it below n */
+	if (top || mpihelp_cmp(tp + K, n, K) >= 0)
+		mpihelp_sub_n(rp, tp + K, n, K);
+	else
+		MPN_COPY(rp, tp + K, K);
+}
+
+/* XP = XP^2 / R mod n */
+static void digsig_builtin_sqr(mpi_ptr_t xp, mpi_ptr_t tp, mpi_ptr_t tspace)
+{
+	if (K < KARATSUBA_THRESHOLD)
+		mpih_sqr_n_basecase(tp, xp, K);
+	else
+		mpih_sqr_n(tp, xp, K, tspace);
+	digsig_builtin_redc(xp, tp);
+}
+
+/* XP = XP * AP / R mod n */
+static void digsig_builtin_mul(mpi_ptr_t xp, mpi_ptr_t ap, mpi_ptr_t tp,
+			       mpi_ptr_t tspace)
+{
+	mpihelp_mul_n_ws(tp, xp, ap, K, tspace);
+	digsig_builtin_redc(xp, tp);
+}
+
+/******************************************************************************
+Description : The Montgomery context of the built-in key, if the key is
+	the one the constants were generated for.
+Parameters  :
+	@pkey: n and e of the key, normalized
+Return value: the static context, NULL for another key
+******************************************************************************/
+MPI_MONT_CTX digsig_builtin_mont_ctx(MPI *pkey)
+{
+	if (pkey[0]->nlimbs != K || pkey[0]->sign ||
+	    memcmp(pkey[0]->d, digsig_builtin_n, sizeof(digsig_builtin_n)) ||
+	    pkey[1]->nlimbs != 1 || pkey[1]->d[0] != DIGSIG_BUILTIN_MONT_E)
+		return NULL;
+	return &digsig_builtin_mont;
+}
+
+/******************************************************************************
+Description : RES = BASE ^ e mod n for the built-in key, as
+	mpi_powm_mont_ws() computes it, with the ladder of e unrolled.
+Parameters  :
+	@res: the result, resized if it has no room for K limbs
+	@base: the signature
+	@mont: the context of the key
+	@ws: MPI_MONT_WS_LIMBS(mont) limbs of workspace
+Return value: 0 on success, -1 if mont is not the context of the built-in
+	key or base is not below n: the caller then takes the generic path
+******************************************************************************/
+int digsig_builtin_powm(MPI res, MPI base, MPI_MONT_CTX mont,
+			mpi_limb_t *ws)
+{
+	mpi_ptr_t ap, am, xp, tp, tspace;
+	mpi_size_t rsize;
+
+	if (mont != &digsig_builtin_mont || base->sign || base->nlimbs > K)
+		return -1;
+
+	/* a, a*R, x, the product and the multiplication scratch */
+	ap = ws;
+	am = ap + K;
+	xp = am + K;
+	tp = xp + K;
+	tspace = tp + 2 * K + 1;
+
+	MPN_ZERO(ap, K);
+	MPN_COPY(ap, base->d, base->nlimbs);
+	if (mpihelp_cmp(ap, (mpi_ptr_t)digsig_builtin_n, K) >= 0)
+		return -1;
+
+	mpihelp_mul_n_ws(tp, ap, (mpi_ptr_t)digsig_builtin_rr, K, tspace);
+	digsig_builtin_redc(am, tp);
+	MPN_COPY(xp, am, K);
+
+#define S digsig_builtin_sqr(xp, tp, tspace);
+#define M digsig_builtin_mul(xp, am, tp, tspace);
+	DIGSIG_BUILTIN_MONT_LADDER(S, M)
+#undef S
+#undef M
+
+	/* and out of the Montgomery domain */
+	MPN_ZERO(tp, 2 * K);
+	MPN_COPY(tp, xp, K);
+	digsig_builtin_redc(xp, tp);
+
+	RESIZE_IF_NEEDED(res, K);
+	MPN_COPY(res->d, xp, K);
+	rsize = K;
+	MPN_NORMALIZE(res->d, rsize);
+	res->nlimbs = rsize;
+	res->sign = 0;
+	return 0;
+}
+
+#else /* !DIGSIG_BUILTIN_MONT_K */
+
+/* the built-in key is not one the constants could be generated for */
+MPI_MONT_CTX digsig_builtin_mont_ctx(MPI *pkey)
+{
+	return NULL;
+}
+
+int digsig_builtin_powm(MPI res, MPI base, MPI_MONT_CTX mont,
+			mpi_limb_t *ws)
+{
+	return -1;
+}
+
+#endif /* DIGSIG_BUILTIN_MONT_K */
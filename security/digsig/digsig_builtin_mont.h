@@ -0,0 +1,28 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the RSA arithmetic specialized, at build time, for
+ * the public key built into the kernel.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BUILTIN_MONT_H
+#define _DIGSIG_BUILTIN_MONT_H
+
+#include "gnupg/mpi/mpi.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_BUILTIN_MONT
+MPI_MONT_CTX digsig_builtin_mont_ctx(MPI *pkey);
+int digsig_builtin_powm(MPI res, MPI base, MPI_MONT_CTX mont,
+			mpi_limb_t *ws);
+#else
+#define digsig_builtin_mont_ctx(pkey) ((MPI_MONT_CTX)NULL)
+#define digsig_builtin_powm(res, base, mont, ws) (-1)
+#endif
+
+#endif /* _DIGSIG_BUILTIN_MONT_H */
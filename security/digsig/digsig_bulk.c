@@ -0,0 +1,353 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies files in bulk, for the preload manifest, the boot
+ * profile written back to it and the verdict queries, on every CPU at
+ * once.  Each CPU has a deque of tasks and a runner, a work item bound
+ * to it: a file queued goes to the CPU next in turn, and a runner with
+ * nothing left of its own steals from the others before it stops.
+ *
+ * A file signed in the chunk hash format is split into ranges of
+ * chunks, the parts of its task, pushed on the deque of the CPU
+ * verifying it.  Its runner takes them back newest first, while the
+ * files queued behind it are stolen oldest first, and only then its
+ * parts: a large file is spread over the CPUs that have nothing else,
+ * and does not hold up the small files queued on its CPU.  A runner
+ * waiting for the parts of its file runs those still on its deque
+ * rather than sleeping.
+ *
+ * A file whose pages a node holds, see digsig_numa.c, goes to the CPUs
+ * of that node in turn, and a runner steals from the CPUs of its own
+ * node before it looks at the others: hashing then reads local memory
+ * as long as the node has CPUs to spare.  The parts of a file wake a
+ * CPU of the node of the runner verifying it.
+ *
+ * The tasks are work items, run by their function as a workqueue would
+ * run them: whoever cannot queue them here, the engine not being set
+ * up, queues them on a workqueue instead.  A runner counts what it
+ * ran, a batch at a time, before it stops.
+ *
+ * /sys/kernel/security/digsig/bulk gives one line per CPU: the tasks
+ * its runner ran, those it stole, the parts pushed on its deque, the
+ * tasks waiting on it, and those of the tasks stolen that it took from
+ * another node.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+#include <linux/numa.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/seq_file.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_bulk.h"
+
+/*
+ * digsig_bulk_cpu: the deque of a CPU.  The tasks are linked through
+ * work->entry, which is free as long as they are not on a workqueue.
+ */
+struct digsig_bulk_cpu {
+	spinlock_t lock;
+	struct list_head files;		/* oldest first */
+	struct list_head parts;		/* newest first */
+	unsigned int queued;		/* files and parts */
+	int cpu;
+	struct work_struct runner;
+	struct task_struct *task;	/* the runner, while it runs */
+	unsigned long run, stolen, spawned, remote;
+} ____cacheline_aligned_in_smp;
+
+static DEFINE_PER_CPU(struct digsig_bulk_cpu, digsig_bulk_cpu);
+static struct workqueue_struct *digsig_bulk_wq;
+static int digsig_bulk_next;
+
+/* the deque of the runner calling, NULL if it is not one */
+static struct digsig_bulk_cpu *digsig_bulk_self(void)
+{
+	struct digsig_bulk_cpu *c;
+
+	if (!digsig_bulk_wq)
+		return NULL;
+	c = &per_cpu(digsig_bulk_cpu, raw_smp_processor_id());
+	return c->task == current ? c : NULL;
+}
+
+/*
+ * The online CPU next in turn, of @node if it has one online; a race
+ * only gives two files the same one.
+ */
+static int digsig_bulk_next_cpu(int node)
+{
+	const struct cpumask *mask = cpu_online_mask;
+	int cpu;
+
+	if (node != NUMA_NO_NODE &&
+	    cpumask_intersects(cpumask_of_node(node), cpu_online_mask))
+		mask = cpumask_of_node(node);
+	cpu = cpumask_next_and(ACCESS_ONCE(digsig_bulk_next), mask,
+			       cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first_and(mask, cpu_online_mask);
+	ACCESS_ONCE(digsig_bulk_next) = cpu;
+	return cpu;
+}
+
+static void digsig_bulk_kick(struct digsig_bulk_cpu *c)
+{
+	queue_work_on(c->cpu, digsig_bulk_wq, &c->runner);
+}
+
+static struct work_struct *digsig_bulk_take(struct digsig_bulk_cpu *c,
+					    struct list_head *head, int last)
+{
+	struct work_struct *work;
+
+	if (list_empty(head))
+		return NULL;
+	work = list_entry(last ? head->prev : head->next, struct work_struct,
+			  entry);
+	list_del_init(&work->entry);
+	c->queued--;
+	return work;
+}
+
+/* The runner's own next task: a part of its file, or the oldest file. */
+static struct work_struct *digsig_bulk_pop(struct digsig_bulk_cpu *c,
+					   int parts_only)
+{
+	struct work_struct *work;
+
+	if (!ACCESS_ONCE(c->queued))
+		return NULL;
+	spin_lock(&c->lock);
+	work = digsig_bulk_take(c, &c->parts, 0);
+	if (!work && !parts_only)
+		work = digsig_bulk_take(c, &c->files, 0);
+	spin_unlock(&c->lock);
+	return work;
+}
+
+/*
+ * A task of another CPU: its oldest file, or else its oldest part.  The
+ * CPUs of the runner's node are looked at first, then the others.
+ */
+static struct work_struct *digsig_bulk_steal(struct digsig_bulk_cpu *self)
+{
+	struct digsig_bulk_cpu *v;
+	struct work_struct *work = NULL;
+	int node = cpu_to_node(self->cpu);
+	int cpu, remote;
+
+	for (remote = 0; remote < 2; remote++) {
+		cpu = self->cpu;
+		for (;;) {
+			cpu = cpumask_next(cpu, cpu_possible_mask);
+			if (cpu >= nr_cpu_ids)
+				cpu = cpumask_first(cpu_possible_mask);
+			if (cpu == self->cpu)
+				break;
+			if ((cpu_to_node(cpu) != node) != remote)
+				continue;
+			v = &per_cpu(digsig_bulk_cpu, cpu);
+			if (!ACCESS_ONCE(v->queued))
+				continue;
+			spin_lock(&v->lock);
+			work = digsig_bulk_take(v, &v->files, 0);
+			if (!work)
+				work = digsig_bulk_take(v, &v->parts, 1);
+			spin_unlock(&v->lock);
+			if (work) {
+				self->stolen++;
+				self->remote += remote;
+				return work;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void digsig_bulk_runner(struct work_struct *runner)
+{
+	struct digsig_bulk_cpu *c =
+		container_of(runner, struct digsig_bulk_cpu, runner);
+	struct work_struct *work;
+	unsigned long n = 0;
+
+	c->task = current;
+	while ((work = digsig_bulk_pop(c, 0)) ||
+	       (work = digsig_bulk_steal(c))) {
+		/* the task may free its work item */
+		work->func(work);
+		n++;
+		cond_resched();
+	}
+	c->task = NULL;
+	c->run += n;
+}
+
+/******************************************************************************
+Description : Verify a file in bulk: queue its task on the CPU next in
+	turn of the node holding the file, or on that of the runner queueing
+	it if it is of that node.
+Parameters  :
+	@work: the task, initialized and not queued anywhere
+	@node: the node of the file, NUMA_NO_NODE for any
+Return value: 0 if queued, -EINVAL if the engine is not set up, for the
+	caller to queue the task elsewhere
+******************************************************************************/
+int digsig_bulk_queue_node(struct work_struct *work, int node)
+{
+	struct digsig_bulk_cpu *c;
+
+	if (!digsig_bulk_wq)
+		return -EINVAL;
+	c = digsig_bulk_self();
+	if (c && node != NUMA_NO_NODE && cpu_to_node(c->cpu) != node)
+		c = NULL;
+	if (!c)
+		c = &per_cpu(digsig_bulk_cpu, digsig_bulk_next_cpu(node));
+
+	spin_lock(&c->lock);
+	list_add_tail(&work->entry, &c->files);
+	c->queued++;
+	spin_unlock(&c->lock);
+	digsig_bulk_kick(c);
+	return 0;
+}
+
+/******************************************************************************
+Description : Verify a file in bulk, wherever its pages are.
+Parameters  :
+	@work: the task, initialized and not queued anywhere
+Return value: as for digsig_bulk_queue_node()
+******************************************************************************/
+int digsig_bulk_queue(struct work_struct *work)
+{
+	return digsig_bulk_queue_node(work, NUMA_NO_NODE);
+}
+
+/******************************************************************************
+Description : Push a part of the task the caller runs on its deque, and
+	wake the runner of another CPU to steal it if it has nothing else.
+	The parts are waited for with digsig_bulk_join().
+Parameters  :
+	@work: the part, initialized and not queued anywhere
+Return value: 0 if pushed, -EINVAL if the caller is not a runner, for it
+	to queue the part elsewhere
+******************************************************************************/
+int digsig_bulk_spawn(struct work_struct *work)
+{
+	struct digsig_bulk_cpu *c = digsig_bulk_self();
+	int cpu;
+
+	if (!c)
+		return -EINVAL;
+	spin_lock(&c->lock);
+	list_add(&work->entry, &c->parts);
+	c->queued++;
+	spin_unlock(&c->lock);
+	c->spawned++;
+
+	/* a CPU of this node, unless it has no other */
+	cpu = digsig_bulk_next_cpu(cpu_to_node(c->cpu));
+	if (cpu == c->cpu)
+		cpu = digsig_bulk_next_cpu(NUMA_NO_NODE);
+	if (cpu != c->cpu)
+		digsig_bulk_kick(&per_cpu(digsig_bulk_cpu, cpu));
+	return 0;
+}
+
+/******************************************************************************
+Description : Wait for the parts of the caller's task: run those still
+	on its deque, then sleep until the ones stolen are done.
+Parameters  :
+	@done: completed once the last part is done
+Return value: none
+******************************************************************************/
+void digsig_bulk_join(struct completion *done)
+{
+	struct digsig_bulk_cpu *c = digsig_bulk_self();
+	struct work_struct *work;
+
+	while (c && !completion_done(done) && (work = digsig_bulk_pop(c, 1)))
+		work->func(work);
+	wait_for_completion(done);
+}
+
+static int digsig_bulk_show(struct seq_file *m, void *v)
+{
+	struct digsig_bulk_cpu *c;
+	int cpu;
+
+	seq_puts(m, "# cpu\trun\tstolen\tspawned\tqueued\tremote\n");
+	for_each_possible_cpu(cpu) {
+		c = &per_cpu(digsig_bulk_cpu, cpu);
+		if (!c->run && !c->spawned && !cpu_online(cpu))
+			continue;
+		seq_printf(m, "%d\t%lu\t%lu\t%lu\t%u\t%lu\n", cpu, c->run,
+			   c->stolen, c->spawned, ACCESS_ONCE(c->queued),
+			   c->remote);
+	}
+	return 0;
+}
+
+static int digsig_bulk_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_bulk_show, NULL);
+}
+
+static const struct file_operations digsig_bulk_fops = {
+	.open = digsig_bulk_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Set up the deques and the runners, and create
+	/sys/kernel/security/digsig/bulk.
+Parameters  : none
+Return value: 0 on success, negative otherwise; the tasks are then
+	queued on workqueues, as before
+******************************************************************************/
+int __init digsig_init_bulk(void)
+{
+	struct digsig_bulk_cpu *c;
+	struct dentry *d;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		c = &per_cpu(digsig_bulk_cpu, cpu);
+		spin_lock_init(&c->lock);
+		INIT_LIST_HEAD(&c->files);
+		INIT_LIST_HEAD(&c->parts);
+		c->cpu = cpu;
+		INIT_WORK(&c->runner, digsig_bulk_runner);
+	}
+
+	/* hashing does not sleep much: the runners do not hold up others */
+	digsig_bulk_wq = alloc_workqueue("digsig_bulk", WQ_CPU_INTENSIVE, 1);
+	if (!digsig_bulk_wq)
+		return -ENOMEM;
+
+	if (!digsig_securityfs_dir)
+		return 0;
+	d = securityfs_create_file("bulk", 0400, digsig_securityfs_dir, NULL,
+				   &digsig_bulk_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification of files in bulk, on every CPU.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BULK_H
+#define _DIGSIG_BULK_H
+
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_BULK
+int digsig_bulk_queue(struct work_struct *work);
+int digsig_bulk_queue_node(struct work_struct *work, int node);
+int digsig_bulk_spawn(struct work_struct *work);
+void digsig_bulk_join(struct completion *done);
+int digsig_init_bulk(void);
+#else
+#define digsig_bulk_queue(work) (-EINVAL)
+#define digsig_bulk_queue_node(work, node) (-EINVAL)
+#define digsig_bulk_spawn(work) (-EINVAL)
+#define digsig_bulk_join(done) wait_for_completion(done)
+#define digsig_init_bulk() 0
+#endif
+
+#endif /* _DIGSIG_BULK_H */
@@ -0,0 +1,353 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file takes verdict bundles: the verdicts on the files of a
+ * read-only image, made once, by the build of the image or on a host
+ * that verified them, signed with the DigSig key and imported by every
+ * host that mounts the same image, which then verifies none of the
+ * files listed.  A bundle names the files by inode number, which an
+ * image gives the same on every host, and the image by the root hash
+ * of the dm-verity table it is read through: unlike the UUID of a
+ * filesystem, which is only what the device says and which squashfs
+ * does not have, the root covers every block the inodes are read from,
+ * so the bundle only applies to the image its verdicts were made on.
+ *
+ * A bundle is written whole to /sys/kernel/security/digsig/bundle, in
+ * the format of digsig_format.h, in one or more writes at increasing
+ * offsets.  Once its signature is verified, it is applied to the
+ * images mounted with its root, and then to each mounted after, by
+ * setting the bits of its inodes in their verdict bitmaps, see
+ * digsig_sb_bitmap.c; an image whose device is not one verity target
+ * over the whole of it, or which keeps no bitmap, takes no bundle.
+ *
+ * A bundle holds under the revocations in force when it was imported:
+ * after a signature is revoked or a key retired its verdicts are
+ * dropped with the bitmaps, the files are verified one by one again,
+ * and the bundle is not applied to the images mounted after until it
+ * is imported again.  It holds, too, only for the dm-verity table its
+ * root was read from at mount: once another table is loaded and
+ * resumed under the image, whatever its root, the verdicts are
+ * dropped and the files verified again, until the image is remounted
+ * and its root checked anew.  Reading the file lists the bundles: the
+ * algorithm and the root, the inodes, and whether it is stale.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+#include <linux/mutex.h>
+#include <linux/rculist.h>
+#include <linux/kref.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/err.h>
+#include <asm/unaligned.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_inode.h"
+#include "digsig_sysfs.h"
+#include "digsig_verity.h"
+#include "digsig_sb_bitmap.h"
+#include "digsig_bundle.h"
+
+/* as many as the verity roots */
+#define DIGSIG_BUNDLE_MAX_BUNDLES 16
+
+/*
+ * digsig_bundle: a bundle whose signature was verified.  A bundle of
+ * the root of one already imported replaces it.  The list holds a
+ * reference, and so does each mount applying it, as the mounts do it
+ * under the s_umount of their superblock, which an import takes after
+ * digsig_bundle_mutex.
+ */
+struct digsig_bundle {
+	struct list_head list;
+	struct kref ref;
+	char alg[DIGSIG_BUNDLE_ALG_SIZE];
+	unsigned int size;
+	u8 digest[DIGSIG_BUNDLE_MAX_DIGEST];
+	unsigned int generation;	/* digsig_verdict_gen() at import */
+	u32 count;
+	u32 ino[];
+};
+
+/* changed under digsig_bundle_mutex, looked up under RCU */
+static LIST_HEAD(digsig_bundles);
+static DEFINE_MUTEX(digsig_bundle_mutex);
+static unsigned int digsig_bundle_count;
+
+/* the bundle being written */
+static char *bundle_buf;
+static size_t bundle_size, bundle_len;
+
+static struct digsig_bundle *digsig_bundle_find(const char *alg,
+						const u8 *digest,
+						unsigned int size)
+{
+	struct digsig_bundle *b;
+
+	list_for_each_entry_rcu(b, &digsig_bundles, list)
+		if (b->size == size && !strcmp(b->alg, alg) &&
+		    !memcmp(b->digest, digest, size))
+			return b;
+	return NULL;
+}
+
+static void digsig_bundle_release(struct kref *ref)
+{
+	vfree(container_of(ref, struct digsig_bundle, ref));
+}
+
+static inline void digsig_bundle_put(struct digsig_bundle *b)
+{
+	kref_put(&b->ref, digsig_bundle_release);
+}
+
+/* Apply a bundle, or the one of its root if @b is NULL, to a superblock. */
+static void digsig_bundle_seed(struct super_block *sb, struct digsig_bundle *b)
+{
+	struct digsig_verity_table table;
+	char alg[DIGSIG_VERITY_ALG_SIZE];
+	u8 digest[DIGSIG_VERITY_MAX_DIGEST];
+	int size, rc;
+
+	size = digsig_verity_sb_root(sb, alg, digest, &table);
+	if (!size)
+		return;
+
+	if (b) {
+		if (b->size != size || strcmp(b->alg, alg) ||
+		    memcmp(b->digest, digest, size))
+			return;
+		kref_get(&b->ref);
+	} else {
+		rcu_read_lock();
+		b = digsig_bundle_find(alg, digest, size);
+		if (b)
+			kref_get(&b->ref);
+		rcu_read_unlock();
+		if (!b)
+			return;
+	}
+
+	rc = -ESTALE;
+	if (b->generation == digsig_verdict_gen())
+		rc = digsig_sb_bitmap_seed(sb, b->generation, &table, b->ino,
+					   b->count);
+	DSM_PRINT(DEBUG_SIGN, "%s: %u verdicts on %s from its bundle: %d\n",
+		  __func__, b->count, sb->s_id, rc);
+	digsig_bundle_put(b);
+}
+
+static void digsig_bundle_seed_one(struct super_block *sb, void *arg)
+{
+	digsig_bundle_seed(sb, arg);
+}
+
+/******************************************************************************
+Description : Apply the bundle of the root of a superblock, if one was
+	imported since the last revocation.
+Parameters  :
+	@sb: the superblock, being mounted or remounted
+Return value: none
+******************************************************************************/
+void digsig_bundle_apply(struct super_block *sb)
+{
+	if (ACCESS_ONCE(digsig_bundle_count))
+		digsig_bundle_seed(sb, NULL);
+}
+
+/*
+ * Check the signature of the staged bundle and keep it.  Returns the
+ * bundle, with a reference for the caller to apply it.
+ */
+static struct digsig_bundle *digsig_bundle_commit(void)
+{
+	struct digsig_bundle_hdr *hdr = (void *)bundle_buf;
+	struct digsig_bundle *b, *old;
+	u32 size = le32_to_cpu(hdr->digest_size);
+	u32 count = le32_to_cpu(hdr->count);
+	u32 sig_size = le32_to_cpu(hdr->sig_size);
+	const __le32 *ino = (void *)(bundle_buf + sizeof(*hdr) + size);
+	u32 i;
+	int rc;
+
+	rc = digsig_verify_buffer(bundle_buf, bundle_size - sig_size,
+				  bundle_buf + bundle_size - sig_size,
+				  sig_size);
+	if (rc)
+		return ERR_PTR(rc);
+
+	b = vmalloc(sizeof(*b) + (size_t)count * sizeof(u32));
+	if (!b)
+		return ERR_PTR(-ENOMEM);
+	memset(b, 0, sizeof(*b));
+	kref_init(&b->ref);
+	strcpy(b->alg, hdr->alg);
+	b->size = size;
+	memcpy(b->digest, hdr + 1, size);
+	b->count = count;
+	for (i = 0; i < count; i++)
+		b->ino[i] = get_unaligned_le32(&ino[i]);
+	b->generation = digsig_verdict_gen();
+
+	old = digsig_bundle_find(b->alg, b->digest, b->size);
+	if (old) {
+		list_replace_rcu(&old->list, &b->list);
+	} else if (digsig_bundle_count >= DIGSIG_BUNDLE_MAX_BUNDLES) {
+		vfree(b);
+		return ERR_PTR(-ENOSPC);
+	} else {
+		list_add_tail_rcu(&b->list, &digsig_bundles);
+		ACCESS_ONCE(digsig_bundle_count) = digsig_bundle_count + 1;
+	}
+	kref_get(&b->ref);
+
+	if (old) {
+		synchronize_rcu();
+		digsig_bundle_put(old);
+	}
+	DSM_PRINT(DEBUG_SIGN, "%s: bundle of %u inodes added\n", __func__,
+		  count);
+	return b;
+}
+
+static void digsig_bundle_drop(void)
+{
+	vfree(bundle_buf);
+	bundle_buf = NULL;
+	bundle_size = bundle_len = 0;
+}
+
+/* Check the header of a bundle, and size it. */
+static int digsig_bundle_start(const char *buf, size_t count)
+{
+	const struct digsig_bundle_hdr *hdr = (const void *)buf;
+	u32 size, n, sig_size;
+
+	if (count < sizeof(*hdr) ||
+	    memcmp(hdr->magic, DIGSIG_BUNDLE_MAGIC, sizeof(hdr->magic)))
+		return -EINVAL;
+	size = le32_to_cpu(hdr->digest_size);
+	n = le32_to_cpu(hdr->count);
+	sig_size = le32_to_cpu(hdr->sig_size);
+	if (!size || size > DIGSIG_BUNDLE_MAX_DIGEST ||
+	    n > DIGSIG_BUNDLE_MAX || !digsig_sig_size_ok(sig_size) ||
+	    strnlen(hdr->alg, sizeof(hdr->alg)) == sizeof(hdr->alg))
+		return -EINVAL;
+
+	bundle_size = sizeof(*hdr) + size + (size_t)n * sizeof(u32) +
+		sig_size;
+	bundle_buf = vmalloc(bundle_size);
+	if (!bundle_buf) {
+		bundle_size = 0;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static ssize_t digsig_bundle_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct digsig_bundle *b = NULL;
+	char hdr[sizeof(struct digsig_bundle_hdr)];
+	ssize_t rc = count;
+
+	mutex_lock(&digsig_bundle_mutex);
+	if (*ppos == 0) {
+		digsig_bundle_drop();
+		if (copy_from_user(hdr, buf, min(count, sizeof(hdr)))) {
+			rc = -EFAULT;
+			goto out;
+		}
+		rc = digsig_bundle_start(hdr, count);
+		if (rc)
+			goto out;
+		rc = count;
+	}
+
+	if (!bundle_buf || *ppos != bundle_len ||
+	    count > bundle_size - bundle_len) {
+		digsig_bundle_drop();
+		rc = -EINVAL;
+		goto out;
+	}
+	if (copy_from_user(bundle_buf + bundle_len, buf, count)) {
+		digsig_bundle_drop();
+		rc = -EFAULT;
+		goto out;
+	}
+	bundle_len += count;
+	*ppos += count;
+	if (bundle_len == bundle_size) {
+		b = digsig_bundle_commit();
+		if (IS_ERR(b)) {
+			DSM_ERROR("%s: bundle refused: %ld\n", __func__,
+				  PTR_ERR(b));
+			rc = PTR_ERR(b);
+			b = NULL;
+		}
+		digsig_bundle_drop();
+	}
+out:
+	mutex_unlock(&digsig_bundle_mutex);
+
+	/* the images mounted already */
+	if (b) {
+		iterate_supers(digsig_bundle_seed_one, b);
+		digsig_bundle_put(b);
+	}
+	return rc;
+}
+
+static int digsig_bundle_show(struct seq_file *m, void *v)
+{
+	unsigned int gen = digsig_verdict_gen();
+	struct digsig_bundle *b;
+
+	mutex_lock(&digsig_bundle_mutex);
+	list_for_each_entry(b, &digsig_bundles, list)
+		seq_printf(m, "%s:%*phN %u%s\n", b->alg, b->size, b->digest,
+			   b->count, b->generation == gen ? "" : " stale");
+	mutex_unlock(&digsig_bundle_mutex);
+	return 0;
+}
+
+static int digsig_bundle_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_bundle_show, NULL);
+}
+
+static const struct file_operations digsig_bundle_fops = {
+	.open = digsig_bundle_open,
+	.read = seq_read,
+	.write = digsig_bundle_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/bundle.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_bundle(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("bundle", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_bundle_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
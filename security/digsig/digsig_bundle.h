@@ -0,0 +1,28 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verdict bundles of read-only images.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_BUNDLE_H
+#define _DIGSIG_BUNDLE_H
+
+#include <linux/fs.h>
+
+#include "digsig_format.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_BUNDLE
+void digsig_bundle_apply(struct super_block *sb);
+int digsig_init_bundle(void);
+#else
+#define digsig_bundle_apply(sb) do { } while (0)
+#define digsig_init_bundle() 0
+#endif
+
+#endif /* _DIGSIG_BUNDLE_H */
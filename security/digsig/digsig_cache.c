@@ -16,6 +16,14 @@
  *         Chris Wright    Sep 2004
  *         Serge Hallyn Sep 2004: moved to smp-scalable seqlock-based design.
  *
+ * The table is published under RCU and resized online: it grows while
+ * its buckets keep evicting, and shrinks back under memory pressure.
+ *
+ * Entries name the file by superblock id, inode number and generation,
+ * not by inode address, so a verdict outlives the inode: a file read
+ * back into the icache finds it as long as its change time and
+ * i_version are those it was verified with.
+ *
  */
 
 #include <linux/moduleparam.h>
@@ -25,11 +33,32 @@
 #include <linux/uaccess.h>
 #include <linux/kobject.h>
 #include <linux/hash.h>
+#include <linux/prefetch.h>
 #include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/nodemask.h>
+#include <linux/gfp.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/time.h>
+#include <linux/sched.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/nsproxy.h>
 
 #include "digsig_common.h"
 #include "digsig_cache.h"
 #include "digsig_verify.h"
+#include "digsig_sb.h"
+#include "digsig_lockstat.h"
+#include "digsig_ghost.h"
+
+#include <trace/events/digsig.h>
 
 #ifdef CONFIG_SECURITY_DIGSIG_DEBUG
 #define DIGSIG_MODE 0		/*permissive  mode */
@@ -42,115 +71,734 @@
 extern int dsi_cache_buckets;
 
 /*
- * digsig_hash_line: seqlock_t = 28 bytes; next_evicted=2;
- * Assuming 128 byte cache line, this leaves 98 bytes for
- * the entry structs.  Each of those is 12 bytes, so we'll
- * use 8 entries per bucket (96 bytes)
+ * Upper bound, in entries, the table may grow to on its own.  It can
+ * be changed at runtime through /sys/digsig/cache_capacity.
+ */
+static int dsi_cache_target = 32768;
+module_param(dsi_cache_target, int, 0);
+MODULE_PARM_DESC(dsi_cache_target, "Number of signature validations the cache may grow to.\n");
+
+/*
+ * Upper bound, in kilobytes, of the memory the table may take, 0 for
+ * none: the table does not grow past it whatever its target.
+ */
+static int dsi_cache_max_kb = 0;
+module_param(dsi_cache_max_kb, int, 0);
+MODULE_PARM_DESC(dsi_cache_max_kb, "Memory the signature cache may take, in kilobytes, 0 for no limit.\n");
+
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_QUOTA
+/*
+ * Entries of a bucket that the verdicts cached from one mount namespace
+ * other than the initial one may hold, 0 for no limit; see
+ * cache_owner().
+ */
+static int dsi_cache_quota = 2;
+module_param(dsi_cache_quota, int, 0);
+MODULE_PARM_DESC(dsi_cache_quota, "Entries of a cache bucket one container may hold, 0 for no limit.\n");
+#endif
+
+#ifndef CONFIG_SECURITY_DIGSIG_COMPACT_CACHE
+/*
+ * digsig_hash_line: the seqlock (8 bytes without lock debugging),
+ * next_evicted and one 8 bit tag per entry fill the first cache line
+ * of a bucket; the 8 entries, 56 bytes each on 64-bit, take the next
+ * 448 bytes, so a bucket is 512 bytes.
  *
- * We will default to 128 buckets, taking 16384 bytes, and
- * giving between 128 and 1024 (depending on # collisions)
- * entries.
+ * We will default to 128 buckets, taking 64k, and giving between 128
+ * and 1024 (depending on # collisions) entries.
  */
 #define ENTRIES_PER_BUCKET 8
+#define CACHE_ALIGN ____cacheline_aligned
 
 /*
  * digsig_hash_entry: a single inode signature validation cache
- * entry.  Since we don't clear these on file unload, we check the
- * inode number and i_sb to ensure the inode was not cleared since
- * we cached the validation.
+ * entry.  Files are named by the id of their superblock (see
+ * digsig_sb_sec), i_ino and i_generation, which outlive the inode;
+ * whether the entry is used is told by its tag in the line.  The
+ * change time and i_version tell whether the file was written since.
+ * The verdict tells whether a signature revoked since still leaves it
+ * standing.
  *
- * 12 bytes
+ * 56 bytes
  */
 struct digsig_hash_entry {
-	struct inode *inode;
+	u64 i_sb_id;
 	unsigned long i_ino;
-	struct super_block *i_sb;
+	u32 i_generation;
+	struct digsig_verdict verdict;
+	struct timespec i_ctime;
+	u64 i_version;
 };
+#else
+/*
+ * digsig_hash_line, compact: no alignment; with the 12 byte entries a
+ * bucket takes 120 bytes on 32-bit without lock debugging, 15 per
+ * entry where the full entries take 64.
+ */
+#define ENTRIES_PER_BUCKET 8
+#define CACHE_ALIGN
 
 /*
- * digsig_hash_line: this is a cache entry bucket.  hash(inode)
- * will index to a hash bucket, which contains ENTRIES_PER_BUCKET
- * entries for collisions.  In this way a lookup should be write-less,
- * and entirely contained within one cache line.
+ * digsig_hash_entry, compact: the file and its state are only kept as
+ * a 64 bit hash, keyed with a secret drawn at boot so that a file can
+ * not be made to collide with a verified one, of what the full entry
+ * holds.  A file written since hashes to another key, and is not
+ * found.  Only the verdict generation is kept: once the revocation
+ * list changed, every verdict is made again.
  *
- * When a bucket is full, we evict in a round-robin fashion (unless
- * the next_evicted happened to be the last allocated)
+ * 12 bytes
+ */
+struct digsig_hash_entry {
+	u32 key_hi, key_lo;
+	unsigned int generation;
+};
+
+static u32 digsig_cache_seed[2];
+#endif
+
+/*
+ * digsig_hash_line: this is a cache entry bucket.  The hash of the
+ * file indexes a hash bucket, which contains ENTRIES_PER_BUCKET
+ * entries for collisions.  @tags holds, in byte i, 8 further bits of
+ * the hash for entry i, or 0 if the entry is free; a lookup compares
+ * the 8 tags at once and only reads the entries whose tag matches, so
+ * that a miss stays write-less and within the first cache line.
+ *
+ * When a bucket is full, next_evicted is the hand of a CLOCK: bit i of
+ * @refs is set by lookups that hit entry i, bit i + 8 by lookups that
+ * hit it again, and the hand clears one of them per entry it passes,
+ * evicting the first entry with neither.  A new entry has neither, so
+ * a burst of files mapped once only evicts each other, while a file
+ * hit twice since the hand last passed survives two rounds.  Lookups
+ * only set a bit that is clear, so the line of a hot bucket is written
+ * once per round of the hand, not on every lookup.
  */
 struct digsig_hash_line {
 	seqlock_t sequence;
-	struct digsig_hash_entry entry[ENTRIES_PER_BUCKET];
 	short next_evicted;
+	u64 tags;
+	unsigned long refs;
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+	u32 born[ENTRIES_PER_BUCKET];	/* get_seconds() at insert */
+#endif
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_QUOTA
+	u8 owner[ENTRIES_PER_BUCKET];	/* cache_owner() at insert */
+#endif
+	struct digsig_hash_entry entry[ENTRIES_PER_BUCKET] CACHE_ALIGN;
+} CACHE_ALIGN;
+
+/*
+ * When each entry was inserted, for /sys/kernel/security/digsig/entries:
+ * on 64-bit it fills the rest of the first cache line of the bucket.
+ */
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+#define line_born(l, i) ((l)->born[i])
+#define line_set_born(l, i, t) ((l)->born[i] = (t))
+#else
+#define line_born(l, i) 0
+#define line_set_born(l, i, t) do { } while (0)
+#endif
+
+/*
+ * Who cached each entry.  Owner 0 is the shared pool: the verdicts
+ * cached from the initial mount namespace, and those of files looked
+ * up from more than one namespace, which are told by SHARED_BIT in
+ * @refs until the entry is next written.  Every other owner may hold
+ * no more than dsi_cache_quota entries of a bucket: past it, it
+ * evicts one of its own, so that the exec churn of one container
+ * leaves the verdicts of the host and of the other containers alone.
+ */
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_QUOTA
+#define line_owner(l, i) \
+	(test_bit(SHARED_BIT(i), &(l)->refs) ? 0 : (l)->owner[i])
+#define line_set_owner(l, i, o) ((l)->owner[i] = (o))
+#else
+#define line_owner(l, i) 0
+#define line_set_owner(l, i, o) do { } while (0)
+#endif
+
+/*
+ * digsig_cache_table: one generation of the cache.  Readers find the
+ * current table through sig_cache under rcu_read_lock().  While a
+ * resize copies the entries into a new table, @next points to it so
+ * that invalidations reach both copies.
+ */
+struct digsig_cache_table {
+	unsigned int bits;
+	unsigned int alloc;	/* CACHE_ALLOC_*, how to free it */
+	atomic_t evictions;
+	struct digsig_cache_table __rcu *next;
+	struct digsig_hash_line line[0];
+};
+
+static struct digsig_cache_table __rcu *sig_cache;
+
+/* serializes resizes; wanted_bits is the size the worker will apply */
+static DEFINE_MUTEX(digsig_cache_mutex);
+static unsigned int digsig_min_bits, digsig_max_bits, digsig_wanted_bits;
+
+static void digsig_cache_resize_fn(struct work_struct *work);
+static DECLARE_WORK(digsig_cache_resize_work, digsig_cache_resize_fn);
+
+#define capacity(bits) ((1UL << (bits)) * ENTRIES_PER_BUCKET)
+
+/* counters kept per CPU for /sys/kernel/security/digsig/cache */
+#define CACHE_STAT_LOOKUP 0
+#define CACHE_STAT_HIT 1
+#define CACHE_STAT_MISS 2
+#define CACHE_STAT_INSERT 3
+#define CACHE_STAT_EVICT 4	/* a valid entry made room for another */
+#define CACHE_STAT_DROP 5	/* nothing inserted */
+#define CACHE_STAT_STALE 6	/* the file was changed since, left to writers */
+#define CACHE_STAT_DEFER 7	/* the bucket was locked, insert queued */
+#define CACHE_STAT_QUOTA 8	/* an owner at its quota evicted its own */
+#define CACHE_STAT_L1 9		/* hit in the table of the CPU */
+#define CACHE_STATS 10
+
+#ifdef CONFIG_SECURITY_DIGSIG_STATS
+static DEFINE_PER_CPU(unsigned long [CACHE_STATS], digsig_cache_stats);
+#define cache_stat(i) this_cpu_inc(digsig_cache_stats[i])
+#else
+#define cache_stat(i) do { } while (0)
+#endif
+
+/*
+ * Validations that found their bucket locked wait in a queue of the
+ * CPU, and are inserted by the next insert on the CPU that gets its
+ * bucket, or by the worker.  An entry queued before a remove_signature()
+ * may be of a file written since, so the queue is thrown away when
+ * digsig_cache_removals moved.
+ */
+#define CACHE_PENDING 16
+
+struct digsig_cache_pending {
+	spinlock_t lock;
+	unsigned int count;
+	struct {
+		u64 hash;
+		unsigned int removals;
+		u8 owner;
+		struct digsig_hash_entry e;
+	} slot[CACHE_PENDING];
 };
 
-static struct digsig_hash_line *sig_cache;
-static int digsig_hash_bits;
+static DEFINE_PER_CPU(struct digsig_cache_pending, digsig_cache_pending);
+static atomic_t digsig_cache_removals = ATOMIC_INIT(0);
+
+static void digsig_cache_pending_fn(struct work_struct *work);
+static DECLARE_WORK(digsig_cache_pending_work, digsig_cache_pending_fn);
+
+/*
+ * Ids of superblocks gone or remounted, and tags of keys retired, whose
+ * entries the worker drops in one walk of the table.  Past CACHE_DEAD
+ * of either waiting, the entries are left to eviction: an id is never
+ * given again, so they can not match anything, and the verdict of a
+ * retired key no longer stands once looked up.
+ */
+#define CACHE_DEAD 32
+
+static u64 digsig_cache_dead[CACHE_DEAD];
+static unsigned int digsig_cache_ndead;
+static u32 digsig_cache_dead_keys[CACHE_DEAD];
+static unsigned int digsig_cache_ndead_keys;
+static DEFINE_SPINLOCK(digsig_cache_dead_lock);
 
-#define hash(inode) hash_long((unsigned long)inode, digsig_hash_bits)
+static void digsig_cache_sweep_fn(struct work_struct *work);
+static DECLARE_WORK(digsig_cache_sweep_work, digsig_cache_sweep_fn);
+
+
+/*
+ * The bucket takes the top bits of the hash, the tag bits 32 to 39,
+ * which stay clear of the bucket index up to 2^24 buckets.
+ */
+static inline struct digsig_hash_line *
+hash_line(struct digsig_cache_table *t, u64 h)
+{
+	return &t->line[t->bits ? h >> (64 - t->bits) : 0];
+}
+
+/*
+ * Each file may live in either of two buckets: the one of the top bits
+ * of its hash, and that of its bottom 32 bits hashed again.  It is put
+ * in the one with fewer entries, so that the buckets fill evenly and a
+ * table holds many more verdicts before it starts evicting; lookups
+ * read both.  When the two are the same bucket, as in a table of one,
+ * it is only read once.
+ */
+static inline struct digsig_hash_line *
+hash_line2(struct digsig_cache_table *t, u64 h)
+{
+	return &t->line[t->bits ? hash_32((u32)h, t->bits) : 0];
+}
+
+static inline u8 hash_tag(u64 h)
+{
+	u8 tag = h >> 32;
+
+	return tag ? tag : 1;
+}
+
+#define TAG_ONES 0x0101010101010101ULL
+#define TAG_HIGHS 0x8080808080808080ULL
+#define line_tag(tags, i) ((u8)((tags) >> ((i) * 8)))
+
+/*
+ * Entries of the line whose tag may be @tag, as the high bit of their
+ * byte: a byte of tags ^ tag is zero for each match.  A borrow may
+ * flag a byte above a match as well, which the key comparison weeds
+ * out.
+ */
+static inline u64 tag_matches(u64 tags, u8 tag)
+{
+	u64 x = tags ^ (TAG_ONES * tag);
+
+	return (x - TAG_ONES) & ~x & TAG_HIGHS;
+}
+
+/* the next entry flagged in @m, which it clears */
+static inline int next_match(u64 *m)
+{
+	int i = __ffs64(*m) / 8;
+
+	*m &= *m - 1;
+	return i;
+}
+
+static inline void line_set_tag(struct digsig_hash_line *l, int i, u8 tag)
+{
+	l->tags = (l->tags & ~(0xffULL << (i * 8))) | ((u64)tag << (i * 8));
+}
+
+/* the entries of the line in use: the bytes of the tags not zero */
+static inline int line_used(const struct digsig_hash_line *l)
+{
+	u64 x = l->tags;
+
+	x |= x >> 4;
+	x |= x >> 2;
+	x |= x >> 1;
+	return hweight64(x & TAG_ONES);
+}
+
+#define REF_BIT(i) (i)
+#define HOT_BIT(i) ((i) + ENTRIES_PER_BUCKET)
+#define SHARED_BIT(i) ((i) + 2 * ENTRIES_PER_BUCKET)
+
+/* called without the lock: the bits are only set with atomic ops */
+static inline void line_reference(struct digsig_hash_line *l, int i)
+{
+	if (!test_bit(REF_BIT(i), &l->refs))
+		set_bit(REF_BIT(i), &l->refs);
+	else if (!test_bit(HOT_BIT(i), &l->refs))
+		set_bit(HOT_BIT(i), &l->refs);
+}
+
+/* the bits of @refs lookups set, one or both per entry */
+#define LINE_REFS ((1UL << (2 * ENTRIES_PER_BUCKET)) - 1)
+
+static inline void line_free(struct digsig_hash_line *l, int i)
+{
+	line_set_tag(l, i, 0);
+	clear_bit(REF_BIT(i), &l->refs);
+	clear_bit(HOT_BIT(i), &l->refs);
+}
+
+/*
+ * Write-lock both lines of a file, the one of the lower address first,
+ * which is the order of everyone that waits for the two.
+ */
+static void lock_pair(struct digsig_hash_line *l1, struct digsig_hash_line *l2,
+		      int site)
+{
+	if (l2 < l1)
+		swap(l1, l2);
+	digsig_write_seqlock(&l1->sequence, site);
+	if (l2 != l1)
+		digsig_write_seqlock(&l2->sequence, site);
+}
+
+/* the same without waiting; 0 if either line is locked */
+static int trylock_pair(struct digsig_hash_line *l1,
+			struct digsig_hash_line *l2)
+{
+	if (!spin_trylock(&l1->sequence.lock))
+		return 0;
+	if (l2 != l1 && !spin_trylock(&l2->sequence.lock)) {
+		spin_unlock(&l1->sequence.lock);
+		return 0;
+	}
+	write_seqcount_begin(&l1->sequence.seqcount);
+	if (l2 != l1)
+		write_seqcount_begin(&l2->sequence.seqcount);
+	return 1;
+}
+
+static void unlock_pair(struct digsig_hash_line *l1,
+			struct digsig_hash_line *l2, int site)
+{
+	if (l2 != l1)
+		digsig_write_sequnlock(&l2->sequence, site);
+	digsig_write_sequnlock(&l1->sequence, site);
+}
+
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_QUOTA
+/*
+ * The owner of the verdicts the current task caches: 0 for the initial
+ * mount namespace, else 8 bits of the address of its namespace.  Two
+ * containers whose bits collide share one quota.
+ */
+static u8 cache_owner(void)
+{
+	struct nsproxy *ns = current->nsproxy;
+	u8 o;
+
+	if (!dsi_cache_quota || !ns || ns->mnt_ns == init_nsproxy.mnt_ns)
+		return 0;
+	o = hash_ptr(ns->mnt_ns, 8);
+	return o ? o : 1;
+}
+
+/*
+ * A file found by another owner than the one that cached it is a file
+ * of the system, or of an image the containers share: it joins the
+ * shared pool.  Called without the lock, as line_reference().
+ */
+static inline void line_share(struct digsig_hash_line *l, int i, u8 owner,
+			      u8 found)
+{
+	if (found && found != owner && !test_bit(SHARED_BIT(i), &l->refs))
+		set_bit(SHARED_BIT(i), &l->refs);
+}
+#else
+#define cache_owner() 0
+#define line_share(l, i, owner, found) do { } while (0)
+#endif
+
+static inline u64 inode_version(struct inode *inode)
+{
+	return digsig_inode_versioned(inode) ? inode->i_version : 0;
+}
+
+#ifndef CONFIG_SECURITY_DIGSIG_COMPACT_CACHE
+#define hash(sb_id, ino) hash_64((sb_id) ^ (ino), 64)
 
 /******************************************************************************
-Description : does the cache validation entry describe this inode?
-	If the inode * is the same value, but i_ino or i_sb has changed, then
-	the inode has been unloaded since we saved the validation, so we must
-	clear the entry.
+Description : Fill the key of an entry for the file of an inode, as it
+	is now; the verdict is left alone.
 Parameters  :
-	@p: a cached signature validation entry
+	@e: the entry
 	@inode: an inode
-Return value: 1 if the sig entry is for the given inode, 0 otherwise
+	@sb_id: digsig_sb_id() of the inode's superblock
+Return value: the hash of the entry, see hash_line() and hash_tag()
 ******************************************************************************/
-static inline int
-is_same_inode(struct digsig_hash_entry *e, struct inode *inode)
+static inline u64 entry_fill(struct digsig_hash_entry *e, struct inode *inode,
+			     u64 sb_id)
 {
-	if (e->inode != inode)
-		return 0;
-	if (e->i_ino != inode->i_ino || e->i_sb != inode->i_sb) {
-		e->inode = NULL;
-		return 0;
-	}
+	e->i_sb_id = sb_id;
+	e->i_ino = inode->i_ino;
+	e->i_generation = inode->i_generation;
+	e->i_ctime = inode->i_ctime;
+	e->i_version = inode_version(inode);
+	return hash(sb_id, e->i_ino);
+}
+
+static inline u64 entry_hash(const struct digsig_hash_entry *e)
+{
+	return hash(e->i_sb_id, e->i_ino);
+}
+
+/* do the entries name the same file, whether or not it changed since? */
+static inline int same_file(const struct digsig_hash_entry *a,
+			    const struct digsig_hash_entry *b)
+{
+	return a->i_sb_id == b->i_sb_id && a->i_ino == b->i_ino &&
+	       a->i_generation == b->i_generation;
+}
+
+/*
+ * Is the file as it was when its validation was cached?  If not, it was
+ * written since.  The entry is not cleared here, lookups run on the
+ * read side of the seqlock and must not write to the line: the
+ * verification that follows caches the new validation in its place.
+ */
+static inline int same_state(const struct digsig_hash_entry *a,
+			     const struct digsig_hash_entry *b)
+{
+	return timespec_equal(&a->i_ctime, &b->i_ctime) &&
+	       a->i_version == b->i_version;
+}
+
+static inline int entry_of_sb(const struct digsig_hash_entry *e, u64 sb_id)
+{
+	return e->i_sb_id == sb_id;
+}
+
+static inline int entry_of_key(const struct digsig_hash_entry *e, u32 tag)
+{
+	return e->verdict.key == tag;
+}
+
+static inline void entry_set_verdict(struct digsig_hash_entry *e,
+				     struct digsig_verdict verdict)
+{
+	e->verdict = verdict;
+}
 
+/* the verdict of an entry; 0 if it no longer stands without a recheck */
+static inline int entry_verdict(const struct digsig_hash_entry *e,
+				struct digsig_verdict *v)
+{
+	*v = e->verdict;
 	return 1;
 }
+#else
+static inline u64 entry_fill(struct digsig_hash_entry *e, struct inode *inode,
+			     u64 sb_id)
+{
+	u64 ino = inode->i_ino, version = inode_version(inode), key;
+	u32 w[9] = {
+		(u32)sb_id, (u32)(sb_id >> 32), (u32)ino, (u32)(ino >> 32),
+		inode->i_generation, (u32)inode->i_ctime.tv_sec,
+		(u32)inode->i_ctime.tv_nsec, (u32)version,
+		(u32)(version >> 32),
+	};
+
+	key = ((u64)jhash2(w, ARRAY_SIZE(w), digsig_cache_seed[0]) << 32) |
+	      jhash2(w, ARRAY_SIZE(w), digsig_cache_seed[1]);
+	e->key_hi = key >> 32;
+	e->key_lo = key;
+	return key;
+}
+
+static inline u64 entry_hash(const struct digsig_hash_entry *e)
+{
+	return ((u64)e->key_hi << 32) | e->key_lo;
+}
+
+static inline int same_file(const struct digsig_hash_entry *a,
+			    const struct digsig_hash_entry *b)
+{
+	return a->key_hi == b->key_hi && a->key_lo == b->key_lo;
+}
+
+/* the state is in the key */
+#define same_state(a, b) 1
+
+/* the superblock id is in the key: the entries are left to eviction */
+#define entry_of_sb(e, sb_id) 0
+#define entry_of_key(e, tag) 0
+
+static inline void entry_set_verdict(struct digsig_hash_entry *e,
+				     struct digsig_verdict verdict)
+{
+	e->generation = verdict.generation;
+}
+
+static inline int entry_verdict(const struct digsig_hash_entry *e,
+				struct digsig_verdict *v)
+{
+	v->generation = e->generation;
+	v->sig_hash = 0;
+	v->key = 0;
+	return e->generation == atomic_read(&digsig_verdict_generation);
+}
+#endif
+
+/*
+ * Each CPU keeps the entries it last found, or inserted, in a small
+ * direct-mapped table of its own, looked up before the shared one: the
+ * few files most mappings are of are then found in cache lines no
+ * other CPU writes, without a seqlock.  A slot only stands while
+ * digsig_cache_removals is what it was when the entry was read from the
+ * shared table, so every remove_signature() drops the tables of all
+ * CPUs at once.  The entries of superblocks gone can not match, and the
+ * verdicts of keys retired no longer stand when they are looked up, as
+ * in the shared table.
+ */
+#define CACHE_L1_SIZE 32
+
+struct digsig_cache_l1 {
+	struct {
+		unsigned int removals;
+		int used;
+		struct digsig_hash_entry e;
+	} slot[CACHE_L1_SIZE];
+};
+
+static DEFINE_PER_CPU(struct digsig_cache_l1, digsig_cache_l1);
+
+/* the bucket takes the top bits of the hash, the slot the bottom ones */
+#define l1_slot(l1, h) (&(l1)->slot[(h) & (CACHE_L1_SIZE - 1)])
+
+static int digsig_cache_l1_lookup(u64 h, struct digsig_hash_entry *want,
+				  unsigned int removals,
+				  struct digsig_verdict *v, int *standing)
+{
+	struct digsig_cache_l1 *l1;
+	int found = 0;
+
+	l1 = &get_cpu_var(digsig_cache_l1);
+	if (l1_slot(l1, h)->used && l1_slot(l1, h)->removals == removals &&
+	    same_file(&l1_slot(l1, h)->e, want) &&
+	    same_state(&l1_slot(l1, h)->e, want)) {
+		*standing = entry_verdict(&l1_slot(l1, h)->e, v);
+		found = 1;
+	}
+	put_cpu_var(digsig_cache_l1);
+	return found;
+}
+
+static void digsig_cache_l1_fill(u64 h, struct digsig_hash_entry *e,
+				 unsigned int removals)
+{
+	struct digsig_cache_l1 *l1;
+
+	l1 = &get_cpu_var(digsig_cache_l1);
+	l1_slot(l1, h)->e = *e;
+	l1_slot(l1, h)->removals = removals;
+	l1_slot(l1, h)->used = 1;
+	put_cpu_var(digsig_cache_l1);
+}
 
 /******************************************************************************
 Description : Define if the inode is already in the list.
 Parameters  : @inode the one we search for
+	@verdict: if not NULL, the entry must still stand, and its verdict
+		is copied there
 Return value: 1 if found, 0 otherwise
 ******************************************************************************/
-int is_cached_signature(struct inode *inode)
+int is_cached_signature(struct inode *inode, struct digsig_verdict *verdict)
 {
-	struct digsig_hash_line *l;
-	unsigned seq;
-	int i, h, found;
+	struct digsig_cache_table *t;
+	struct digsig_hash_line *l, *l2;
+	struct digsig_hash_entry want, e;
+	struct digsig_verdict v;
+	u64 sb_id = digsig_sb_id(inode->i_sb), h = 0, m;
+	unsigned seq, removals;
+	int i, hit = 0, found = 0, stale = 0, was_stale = 0, standing = 0;
+	u8 owner = 0;
 
-	h = hash(inode);
-	l = &sig_cache[h];
-	do {
-		found = 0;
-		seq = read_seqbegin(&l->sequence);
-		for (i = 0; i < ENTRIES_PER_BUCKET && !found; i++)
-			if (is_same_inode(&l->entry[i], inode))
-				found = 1;
-	} while (read_seqretry(&l->sequence, seq));
+	/* nothing was cached for a superblock DigSig never looked at */
+	if (!sb_id)
+		goto out;
 
-	return found;
+	h = entry_fill(&want, inode, sb_id);
+	/* read before the entry, see remove_signature() */
+	removals = atomic_read(&digsig_cache_removals);
+	smp_rmb();
+	if (digsig_cache_l1_lookup(h, &want, removals, &v, &standing)) {
+		cache_stat(CACHE_STAT_L1);
+		found = 1;
+		goto out;
+	}
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	l = hash_line(t, h);
+	l2 = hash_line2(t, h);
+	/* the second line is on its way while the first is read */
+	prefetch(l2);
+	for (;;) {
+		do {
+			found = stale = 0;
+			seq = read_seqbegin(&l->sequence);
+			m = tag_matches(ACCESS_ONCE(l->tags), hash_tag(h));
+			while (m && !found) {
+				i = next_match(&m);
+				if (!same_file(&l->entry[i], &want))
+					continue;
+				if (same_state(&l->entry[i], &want)) {
+					standing = entry_verdict(&l->entry[i],
+								 &v);
+					owner = line_owner(l, i);
+					e = l->entry[i];
+					hit = i;
+					found = 1;
+				} else
+					stale = 1;
+			}
+		} while (digsig_read_seqretry(&l->sequence, seq,
+					      DIGSIG_LS_CACHE_LOOKUP));
+		was_stale |= stale;
+		if (found || l == l2)
+			break;
+		l = l2;
+	}
+	stale = was_stale;
+	if (found) {
+		line_reference(l, hit);
+		line_share(l, hit, cache_owner(), owner);
+	}
+	rcu_read_unlock();
+	if (found)
+		digsig_cache_l1_fill(h, &e, removals);
+
+out:
+	cache_stat(CACHE_STAT_LOOKUP);
+	cache_stat(found ? CACHE_STAT_HIT : CACHE_STAT_MISS);
+	if (stale)
+		cache_stat(CACHE_STAT_STALE);
+	if (!found)
+		digsig_ghost_miss(h, stale);
+	if (!found || !verdict)
+		return found;
+	/* the entry is left as it is, the blob takes the refreshed verdict */
+	if (!standing || !digsig_verdict_current(&v)) {
+		digsig_ghost_expired();
+		return 0;
+	}
+	*verdict = v;
+	return 1;
 }
 
 /******************************************************************************
 Description : remove_signature
+	The entry is removed from the current table and, if a resize is
+	copying it, from the table being filled as well.
 Parameters  : @inode to be removed
 Return value: none
 ******************************************************************************/
 void remove_signature(struct inode *inode)
 {
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_cache_table *t;
 	struct digsig_hash_line *l;
-	int i, h;
+	struct digsig_hash_entry want;
+	u64 sb_id = digsig_sb_id(inode->i_sb), h, m;
+	int i, k;
 
-	h = hash(inode);
-	l = &sig_cache[h];
-	write_seqlock(&l->sequence);
-	for (i = 0; i < ENTRIES_PER_BUCKET; i++)
-		if (is_same_inode(&l->entry[i], inode))
-			l->entry[i].inode = 0;
-	write_sequnlock(&l->sequence);
+	if (isec)
+		clear_bit(DIGSIG_INODE_CACHED, &isec->flags);
+	trace_digsig_cache_remove(inode);
+
+	/* the tables of the CPUs are dropped before the entry */
+	atomic_inc(&digsig_cache_removals);
+	smp_mb__after_atomic_inc();
+	if (!sb_id)
+		return;
+
+	h = entry_fill(&want, inode, sb_id);
+	rcu_read_lock();
+	for (t = rcu_dereference(sig_cache); t; t = rcu_dereference(t->next)) {
+		for (k = 0; k < 2; k++) {
+			l = k ? hash_line2(t, h) : hash_line(t, h);
+			if (k && l == hash_line(t, h))
+				break;
+			digsig_write_seqlock(&l->sequence,
+					     DIGSIG_LS_CACHE_REMOVE);
+			m = tag_matches(l->tags, hash_tag(h));
+			while (m) {
+				i = next_match(&m);
+				if (same_file(&l->entry[i], &want)) {
+					line_free(l, i);
+					digsig_ghost_add(h, DIGSIG_GHOST_REMOVED);
+				}
+			}
+			digsig_write_sequnlock(&l->sequence,
+					       DIGSIG_LS_CACHE_REMOVE);
+		}
+	}
+	rcu_read_unlock();
 }
 
 static inline short inc_evicted(struct digsig_hash_line *l)
@@ -161,51 +809,882 @@ static inline short inc_evicted(struct digsig_hash_line *l)
 	return ret;
 }
 
+/*
+ * Move the hand to the first entry referenced neither once nor twice,
+ * taking a reference from each entry it passes, and return that entry.
+ * It stops within three turns of the bucket.
+ */
+static short clock_evict(struct digsig_hash_line *l)
+{
+	short i;
+
+	for (;;) {
+		i = inc_evicted(l);
+		if (test_and_clear_bit(HOT_BIT(i), &l->refs))
+			continue;
+		if (test_and_clear_bit(REF_BIT(i), &l->refs))
+			continue;
+		return i;
+	}
+}
+
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_QUOTA
+/*
+ * The entry an owner other than the shared pool evicts, if it holds
+ * its quota of the line already: the hand only takes references from,
+ * and stops at, the entries of the owner, of which there is one at
+ * least.  -1 if the owner is under its quota.
+ */
+static short quota_evict(struct digsig_hash_line *l, u8 owner)
+{
+	int i, held = 0;
+
+	if (!owner)
+		return -1;
+	for (i = 0; i < ENTRIES_PER_BUCKET; i++)
+		if (line_tag(l->tags, i) && line_owner(l, i) == owner)
+			held++;
+	if (held < dsi_cache_quota)
+		return -1;
+
+	for (;;) {
+		i = inc_evicted(l);
+		if (!line_tag(l->tags, i) || line_owner(l, i) != owner)
+			continue;
+		if (test_and_clear_bit(HOT_BIT(i), &l->refs))
+			continue;
+		if (test_and_clear_bit(REF_BIT(i), &l->refs))
+			continue;
+		return i;
+	}
+}
+#else
+#define quota_evict(l, owner) (-1)
+#endif
+
+/* the entry of the line for the same file as @e, -1 if none */
+static int line_find(struct digsig_hash_line *l, u8 tag,
+		     const struct digsig_hash_entry *e)
+{
+	u64 m = tag_matches(l->tags, tag);
+	int i;
+
+	while (m) {
+		i = next_match(&m);
+		if (same_file(&l->entry[i], e))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Store an entry in a line whose lock is held, in place of an older
+ * entry for the same file if there is one: this is where the entries
+ * lookups found stale are reclaimed.  Returns 1 if a valid entry had
+ * to be evicted to make room, 2 if it was one of @owner's own for its
+ * quota.
+ */
+static int digsig_line_insert(struct digsig_hash_line *l, u8 tag,
+			      struct digsig_hash_entry *e, u32 born, u8 owner)
+{
+	int i, evicted = 0;
+
+	i = line_find(l, tag, e);
+	if (i >= 0) {
+		l->entry[i] = *e;
+		line_set_born(l, i, born);
+		/* verified again by another owner, the file is shared */
+		if (line_owner(l, i) != owner) {
+			line_set_owner(l, i, 0);
+			clear_bit(SHARED_BIT(i), &l->refs);
+		}
+		return 0;
+	}
+
+	i = quota_evict(l, owner);
+	if (i >= 0) {
+		evicted = 2;
+		goto store;
+	}
+
+	for (i = 0; i < ENTRIES_PER_BUCKET && line_tag(l->tags, i); i++)
+		;
+
+	if (i == ENTRIES_PER_BUCKET) {
+		i = clock_evict(l);
+		evicted = 1;
+	} else if (i == l->next_evicted)
+		inc_evicted(l);
+
+store:
+	if (evicted)
+		digsig_ghost_add(entry_hash(&l->entry[i]), evicted == 2 ?
+				 DIGSIG_GHOST_QUOTA : DIGSIG_GHOST_CAPACITY);
+	l->entry[i] = *e;
+	line_set_tag(l, i, tag);
+	line_set_born(l, i, born);
+	line_set_owner(l, i, owner);
+	clear_bit(REF_BIT(i), &l->refs);
+	clear_bit(HOT_BIT(i), &l->refs);
+	clear_bit(SHARED_BIT(i), &l->refs);
+	return evicted;
+}
+
+/*
+ * Which of the two lines of a file, both locked, its entry goes to: the
+ * one with an older entry of the file, else the one with fewer entries,
+ * the first one if they have as many.  When both are full, the one
+ * fewer of whose entries were looked up since its hand last passed
+ * evicts, so that the entry given up is a colder one.
+ */
+static struct digsig_hash_line *pair_choose(struct digsig_hash_line *l1,
+					    struct digsig_hash_line *l2,
+					    u8 tag, struct digsig_hash_entry *e)
+{
+	int n1, n2;
+
+	if (l1 == l2 || line_find(l1, tag, e) >= 0)
+		return l1;
+	if (line_find(l2, tag, e) >= 0)
+		return l2;
+	n1 = line_used(l1);
+	n2 = line_used(l2);
+	if (n1 != n2)
+		return n1 < n2 ? l1 : l2;
+	if (n1 == ENTRIES_PER_BUCKET &&
+	    hweight_long(l2->refs & LINE_REFS) <
+	    hweight_long(l1->refs & LINE_REFS))
+		return l2;
+	return l1;
+}
+
+/*
+ * A table that keeps evicting is too small: once a table has evicted
+ * an eighth of its capacity, ask the worker to double it.
+ */
+static void digsig_cache_note_eviction(struct digsig_cache_table *t)
+{
+	if (t->bits >= ACCESS_ONCE(digsig_max_bits))
+		return;
+	if (atomic_inc_return(&t->evictions) != capacity(t->bits) / 8)
+		return;
+
+	if (ACCESS_ONCE(digsig_wanted_bits) <= t->bits)
+		ACCESS_ONCE(digsig_wanted_bits) = t->bits + 1;
+	schedule_work(&digsig_cache_resize_work);
+}
+
+/*
+ * Finish an insert into the lines of a file whose write sides were
+ * entered: the locks are released here.
+ */
+static void digsig_cache_insert(struct digsig_cache_table *t,
+				struct digsig_hash_line *l1,
+				struct digsig_hash_line *l2, u64 h,
+				struct digsig_hash_entry *e, u8 owner, int site)
+{
+	struct digsig_hash_line *l = pair_choose(l1, l2, hash_tag(h), e);
+	int evicted;
+
+	evicted = digsig_line_insert(l, hash_tag(h), e, get_seconds(), owner);
+	unlock_pair(l1, l2, site);
+
+	cache_stat(CACHE_STAT_INSERT);
+	/* a container at its quota is no reason to grow the table */
+	if (evicted == 2)
+		cache_stat(CACHE_STAT_QUOTA);
+	else if (evicted) {
+		cache_stat(CACHE_STAT_EVICT);
+		digsig_cache_note_eviction(t);
+	}
+}
+
+/* queue a validation whose bucket was locked, for the worker */
+static void digsig_cache_defer(u64 h, unsigned int removals, u8 owner,
+			       struct digsig_hash_entry *e)
+{
+	struct digsig_cache_pending *p;
+	int queued = 0;
+
+	p = &get_cpu_var(digsig_cache_pending);
+	spin_lock(&p->lock);
+	if (p->count < CACHE_PENDING) {
+		p->slot[p->count].hash = h;
+		p->slot[p->count].removals = removals;
+		p->slot[p->count].owner = owner;
+		p->slot[p->count].e = *e;
+		p->count++;
+		queued = 1;
+	}
+	spin_unlock(&p->lock);
+	put_cpu_var(digsig_cache_pending);
+
+	if (!queued) {
+		cache_stat(CACHE_STAT_DROP);
+		return;
+	}
+	cache_stat(CACHE_STAT_DEFER);
+	schedule_work(&digsig_cache_pending_work);
+}
+
+/*
+ * Insert the queued validations of a CPU.  Unless @wait, those whose
+ * bucket is still locked stay queued.
+ */
+static void digsig_cache_drain(struct digsig_cache_pending *p, int wait)
+{
+	struct digsig_cache_table *t;
+	struct digsig_hash_line *l, *l2;
+	unsigned int i, n = 0;
+
+	spin_lock(&p->lock);
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	for (i = 0; i < p->count; i++) {
+		if (p->slot[i].removals != atomic_read(&digsig_cache_removals)) {
+			cache_stat(CACHE_STAT_DROP);
+			continue;
+		}
+		l = hash_line(t, p->slot[i].hash);
+		l2 = hash_line2(t, p->slot[i].hash);
+		if (wait) {
+			lock_pair(l, l2, DIGSIG_LS_CACHE_DRAIN);
+		} else if (trylock_pair(l, l2)) {
+			digsig_lock_acquired(DIGSIG_LS_CACHE_DRAIN, 0);
+		} else {
+			digsig_lock_deferred(DIGSIG_LS_CACHE_DRAIN);
+			p->slot[n++] = p->slot[i];
+			continue;
+		}
+		digsig_cache_insert(t, l, l2, p->slot[i].hash, &p->slot[i].e,
+				    p->slot[i].owner, DIGSIG_LS_CACHE_DRAIN);
+	}
+	rcu_read_unlock();
+	p->count = n;
+	spin_unlock(&p->lock);
+}
+
+static void digsig_cache_pending_fn(struct work_struct *work)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		digsig_cache_drain(per_cpu_ptr(&digsig_cache_pending, cpu), 1);
+}
+
 /******************************************************************************
 Description :
  * We've validated the signature on inode.  Cache that decision.
  * If the hash bucket is full, we pick the next evicted entry in a round-robin
  * fashion.  Otherwise, we make sure that the next evicted entry will not be
  * the one we just inserted.
+ * If the bucket is locked, the validation is queued and inserted later;
+ * it is only lost if the queue of the CPU is full.
+ * Only inodes with a DigSig blob are cached: the blob flags the inode as
+ * cached, which is what writers look at before the table.  A file changed
+ * too recently for its change time to tell a later write is not cached
+ * here, its blob alone keeps the verdict.
 Parameters  :
 	@inode: inode whose signature validation to cache
+	@verdict: what the validation was made under
 Return value: none
 ******************************************************************************/
-void digsig_cache_signature(struct inode *inode)
+void digsig_cache_signature(struct inode *inode, struct digsig_verdict verdict)
 {
-	struct digsig_hash_line *l;
-	int i, h;
+	struct digsig_inode_sec *isec;
+	struct digsig_cache_table *t;
+	struct digsig_hash_line *l, *l2;
+	struct digsig_cache_pending *p;
+	struct digsig_hash_entry e;
+	unsigned int removals;
+	u64 sb_id, h;
+	u8 owner;
 
 	if (!inode)
 		panic("digsig:%s:asked to cache null inode\n", __func__);
 
-	h = hash(inode);
+	if (!digsig_ctime_settled(inode)) {
+		cache_stat(CACHE_STAT_DROP);
+		return;
+	}
+
+	/* the flag tells writers to look the entry up and drop it */
+	isec = digsig_inode_get(inode);
+	sb_id = digsig_sb_id(inode->i_sb);
+	if (!isec || !sb_id) {
+		cache_stat(CACHE_STAT_DROP);
+		return;
+	}
+	set_bit(DIGSIG_INODE_CACHED, &isec->flags);
+	trace_digsig_cache_insert(inode);
 
-	l = &sig_cache[h];
+	h = entry_fill(&e, inode, sb_id);
+	entry_set_verdict(&e, verdict);
+	removals = atomic_read(&digsig_cache_removals);
+	owner = cache_owner();
 
-	DSM_PRINT(DEBUG_SIGN,
-		"%s: adding cache entry at %d\n", __func__, h);
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	l = hash_line(t, h);
+	l2 = hash_line2(t, h);
 
-	if (!spin_trylock(&l->sequence.lock))
+	DSM_PRINT(DEBUG_SIGN, "%s: adding cache entry at %ld or %ld\n",
+		  __func__, (long)(l - t->line), (long)(l2 - t->line));
+
+	if (!trylock_pair(l, l2)) {
+		rcu_read_unlock();
+		digsig_lock_deferred(DIGSIG_LS_CACHE_INSERT);
+		digsig_cache_defer(h, removals, owner, &e);
 		return;
-	else
-		write_seqcount_begin(&l->sequence.seqcount);
+	}
+	digsig_lock_acquired(DIGSIG_LS_CACHE_INSERT, 0);
 
-	for (i = 0; i < ENTRIES_PER_BUCKET && l->entry[i].inode; i++)
-		;
+	digsig_cache_insert(t, l, l2, h, &e, owner, DIGSIG_LS_CACHE_INSERT);
+	rcu_read_unlock();
+	digsig_cache_l1_fill(h, &e, removals);
 
+	p = &get_cpu_var(digsig_cache_pending);
+	if (ACCESS_ONCE(p->count))
+		digsig_cache_drain(p, 0);
+	put_cpu_var(digsig_cache_pending);
+}
 
-	if (i == ENTRIES_PER_BUCKET)
-		i = inc_evicted(l);
-	else if (i == l->next_evicted)
-		inc_evicted(l);
+/******************************************************************************
+Description : Drop the entries of a superblock that goes away or is
+	remounted.  Its id no longer names it, so its entries can not be
+	found any more; the worker frees their slots.
+Parameters  :
+	@sb_id: the id the superblock had, see digsig_sb_sec
+Return value: none; callable from atomic context
+******************************************************************************/
+void digsig_cache_forget_sb(u64 sb_id)
+{
+	unsigned long flags;
+
+	/* compact entries hold no id to tell them by */
+	if (!sb_id || IS_ENABLED(CONFIG_SECURITY_DIGSIG_COMPACT_CACHE))
+		return;
 
-	l->entry[i].inode = inode;
-	l->entry[i].i_ino = inode->i_ino;
-	l->entry[i].i_sb = inode->i_sb;
-	write_sequnlock(&l->sequence);
+	spin_lock_irqsave(&digsig_cache_dead_lock, flags);
+	if (digsig_cache_ndead < CACHE_DEAD)
+		digsig_cache_dead[digsig_cache_ndead++] = sb_id;
+	spin_unlock_irqrestore(&digsig_cache_dead_lock, flags);
+	schedule_work(&digsig_cache_sweep_work);
 }
 
+/******************************************************************************
+Description : Drop the entries of the verdicts made with a key that was
+	retired.  They no longer stand already, the worker frees their
+	slots.
+Parameters  :
+	@tag: the key tag of the verdicts, see digsig_verdict
+Return value: none
+******************************************************************************/
+void digsig_cache_forget_key(u32 tag)
+{
+	unsigned long flags;
+
+	/* compact entries do not hold the key */
+	if (!tag || IS_ENABLED(CONFIG_SECURITY_DIGSIG_COMPACT_CACHE))
+		return;
+
+	spin_lock_irqsave(&digsig_cache_dead_lock, flags);
+	if (digsig_cache_ndead_keys < CACHE_DEAD)
+		digsig_cache_dead_keys[digsig_cache_ndead_keys++] = tag;
+	spin_unlock_irqrestore(&digsig_cache_dead_lock, flags);
+	schedule_work(&digsig_cache_sweep_work);
+}
+
+/*
+ * Free the entries of the superblocks gone, and of the keys retired,
+ * since the last walk.  The mutex keeps the table from being resized,
+ * and freed, meanwhile.
+ */
+static void digsig_cache_sweep_fn(struct work_struct *work)
+{
+	u64 dead[CACHE_DEAD];
+	u32 dead_keys[CACHE_DEAD];
+	struct digsig_cache_table *t;
+	struct digsig_hash_line *l;
+	unsigned int ndead, ndead_keys, n, i, j;
+	unsigned long flags;
+
+	spin_lock_irqsave(&digsig_cache_dead_lock, flags);
+	ndead = digsig_cache_ndead;
+	memcpy(dead, digsig_cache_dead, ndead * sizeof(dead[0]));
+	digsig_cache_ndead = 0;
+	ndead_keys = digsig_cache_ndead_keys;
+	memcpy(dead_keys, digsig_cache_dead_keys,
+	       ndead_keys * sizeof(dead_keys[0]));
+	digsig_cache_ndead_keys = 0;
+	spin_unlock_irqrestore(&digsig_cache_dead_lock, flags);
+	if (!ndead && !ndead_keys)
+		return;
+
+	mutex_lock(&digsig_cache_mutex);
+	t = rcu_dereference_protected(sig_cache,
+				      lockdep_is_held(&digsig_cache_mutex));
+	for (n = 0; n < (1U << t->bits); n++) {
+		l = &t->line[n];
+		digsig_write_seqlock(&l->sequence, DIGSIG_LS_CACHE_SWEEP);
+		for (i = 0; i < ENTRIES_PER_BUCKET; i++) {
+			if (!line_tag(l->tags, i))
+				continue;
+			for (j = 0; j < ndead; j++)
+				if (entry_of_sb(&l->entry[i], dead[j])) {
+					line_free(l, i);
+					break;
+				}
+			if (j < ndead) {
+				digsig_ghost_add(entry_hash(&l->entry[i]),
+						 DIGSIG_GHOST_DROPPED);
+				continue;
+			}
+			for (j = 0; j < ndead_keys; j++)
+				if (entry_of_key(&l->entry[i], dead_keys[j])) {
+					line_free(l, i);
+					digsig_ghost_add(entry_hash(&l->entry[i]),
+							 DIGSIG_GHOST_DROPPED);
+					break;
+				}
+		}
+		digsig_write_sequnlock(&l->sequence, DIGSIG_LS_CACHE_SWEEP);
+		if (!(n & 255))
+			cond_resched();
+	}
+	mutex_unlock(&digsig_cache_mutex);
+}
+
+#define CACHE_ALLOC_SLAB 0
+#define CACHE_ALLOC_VMALLOC 1
+#define CACHE_ALLOC_INTERLEAVE 2	/* pages spread over the nodes */
+
+#define table_size(bits) \
+	(sizeof(struct digsig_cache_table) + \
+	 (1UL << (bits)) * sizeof(struct digsig_hash_line))
+
+/*
+ * Map zeroed pages taken from each online node in turn, so that the
+ * lookups of every node are spread over all of them rather than all
+ * served by the node that happened to grow the table.  A bucket never
+ * straddles two pages.
+ */
+static void *digsig_alloc_interleaved(size_t size)
+{
+	unsigned int i, n = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	struct page **pages;
+	void *p = NULL;
+	int node = numa_node_id();
+
+	pages = vzalloc(n * sizeof(*pages));
+	if (!pages)
+		return NULL;
+
+	for (i = 0; i < n; i++) {
+		node = next_online_node(node);
+		if (node == MAX_NUMNODES)
+			node = first_online_node;
+		pages[i] = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO |
+					    __GFP_NOWARN, 0);
+		if (!pages[i])
+			goto out;
+	}
+	p = vmap(pages, n, VM_MAP, PAGE_KERNEL);
+out:
+	if (!p)
+		while (i--)
+			__free_page(pages[i]);
+	vfree(pages);
+	return p;
+}
+
+static void digsig_free_table(struct digsig_cache_table *t)
+{
+	unsigned long off, size;
+
+	if (!t)
+		return;
+	switch (t->alloc) {
+	case CACHE_ALLOC_SLAB:
+		kfree(t);
+		break;
+	case CACHE_ALLOC_VMALLOC:
+		vfree(t);
+		break;
+	case CACHE_ALLOC_INTERLEAVE:
+		size = PAGE_ALIGN(table_size(t->bits));
+		vunmap(t);
+		for (off = 0; off < size; off += PAGE_SIZE)
+			__free_page(vmalloc_to_page((char *)t + off));
+		break;
+	}
+}
+
+/*
+ * Tables up to a costly order come from the slab.  Larger ones, which
+ * a fragmented machine could not give in one piece, are vmalloc'd, with
+ * their pages interleaved over the nodes on NUMA machines.
+ */
+static struct digsig_cache_table *digsig_alloc_table(unsigned int bits)
+{
+	struct digsig_cache_table *t = NULL;
+	size_t size = table_size(bits);
+	unsigned int alloc = CACHE_ALLOC_SLAB;
+	int i;
+
+	if (size <= (PAGE_SIZE << PAGE_ALLOC_COSTLY_ORDER))
+		t = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (!t && nr_online_nodes > 1) {
+		t = digsig_alloc_interleaved(size);
+		alloc = CACHE_ALLOC_INTERLEAVE;
+	}
+	if (!t) {
+		t = vzalloc(size);
+		alloc = CACHE_ALLOC_VMALLOC;
+	}
+	if (!t)
+		return NULL;
+
+	t->bits = bits;
+	t->alloc = alloc;
+	atomic_set(&t->evictions, 0);
+	for (i = 0; i < (1 << bits); i++)
+		seqlock_init(&t->line[i].sequence);
+
+	return t;
+}
+
+/*
+ * Move every entry of @old into @new.  Entries that collide in the
+ * smaller table when shrinking are evicted as usual.
+ */
+static void digsig_copy_table(struct digsig_cache_table *old,
+			      struct digsig_cache_table *new)
+{
+	struct digsig_hash_line *ol, *nl, *nl2;
+	struct digsig_hash_entry *e;
+	u64 h;
+	int i, j;
+
+	for (i = 0; i < (1 << old->bits); i++) {
+		ol = &old->line[i];
+		digsig_write_seqlock(&ol->sequence, DIGSIG_LS_CACHE_RESIZE);
+		for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+			e = &ol->entry[j];
+			if (!line_tag(ol->tags, j))
+				continue;
+			h = entry_hash(e);
+			nl = hash_line(new, h);
+			nl2 = hash_line2(new, h);
+			lock_pair(nl, nl2, DIGSIG_LS_CACHE_RESIZE);
+			digsig_line_insert(pair_choose(nl, nl2, hash_tag(h), e),
+					   hash_tag(h), e, line_born(ol, j),
+					   line_owner(ol, j));
+			unlock_pair(nl, nl2, DIGSIG_LS_CACHE_RESIZE);
+		}
+		digsig_write_sequnlock(&ol->sequence, DIGSIG_LS_CACHE_RESIZE);
+	}
+}
+
+/*
+ * Replace the table by one of @bits.  Called with digsig_cache_mutex
+ * held.  While the copy runs, lookups and inserts still use the old
+ * table, and invalidations go to both, so that no stale validation can
+ * survive into the new table.  A validation cached in an already
+ * copied line is lost, which only costs a later verification.
+ */
+static int digsig_resize_table(unsigned int bits)
+{
+	struct digsig_cache_table *old, *new;
+
+	old = rcu_dereference_protected(sig_cache,
+					lockdep_is_held(&digsig_cache_mutex));
+	if (old->bits == bits)
+		return 0;
+
+	new = digsig_alloc_table(bits);
+	if (!new)
+		return -ENOMEM;
+
+	rcu_assign_pointer(old->next, new);
+	/* every remove_signature() now also reaches the new table */
+	synchronize_rcu();
+
+	digsig_copy_table(old, new);
+	rcu_assign_pointer(sig_cache, new);
+	synchronize_rcu();
+
+	DSM_PRINT(DEBUG_SIGN, "%s: cache resized from %lu to %lu entries\n",
+		  __func__, capacity(old->bits), capacity(new->bits));
+	digsig_free_table(old);
+	return 0;
+}
+
+static void digsig_cache_resize_fn(struct work_struct *work)
+{
+	unsigned int bits;
+
+	mutex_lock(&digsig_cache_mutex);
+	bits = clamp(ACCESS_ONCE(digsig_wanted_bits), digsig_min_bits,
+		     digsig_max_bits);
+	if (digsig_resize_table(bits))
+		DSM_ERROR("%s: no memory to resize the cache\n", __func__);
+	mutex_unlock(&digsig_cache_mutex);
+}
+
+/*
+ * Under memory pressure give back half of a table that grew past its
+ * initial size.  The cache is rebuilt from verifications as needed.
+ */
+static unsigned long digsig_cache_count(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	struct digsig_cache_table *t;
+	unsigned long count = 0;
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	if (t->bits > digsig_min_bits)
+		count = capacity(t->bits) / 2;
+	rcu_read_unlock();
+
+	return count;
+}
+
+static unsigned long digsig_cache_scan(struct shrinker *shrink,
+				       struct shrink_control *sc)
+{
+	struct digsig_cache_table *t;
+	unsigned int bits;
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	bits = t->bits;
+	rcu_read_unlock();
+
+	if (bits <= digsig_min_bits)
+		return SHRINK_STOP;
+
+	ACCESS_ONCE(digsig_wanted_bits) = bits - 1;
+	schedule_work(&digsig_cache_resize_work);
+	return capacity(bits) / 2;
+}
+
+static struct shrinker digsig_cache_shrinker = {
+	.count_objects = digsig_cache_count,
+	.scan_objects = digsig_cache_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static unsigned int digsig_entries_to_bits(unsigned long entries)
+{
+	unsigned long buckets = DIV_ROUND_UP(entries, ENTRIES_PER_BUCKET);
+
+	return buckets > 1 ? order_base_2(buckets) : 0;
+}
+
+/* the largest of @bits, or fewer, whose table fits in dsi_cache_max_kb */
+static unsigned int digsig_cap_bits(unsigned int bits)
+{
+	if (dsi_cache_max_kb <= 0)
+		return bits;
+	while (bits && table_size(bits) > (unsigned long)dsi_cache_max_kb << 10)
+		bits--;
+	return bits;
+}
+
+/******************************************************************************
+Description : Report the current and target size of the cache, in entries.
+Parameters  :
+	@cur: set to the number of entries of the current table
+	@target: set to the number of entries the cache may grow to
+Return value: none
+******************************************************************************/
+void digsig_cache_capacity(unsigned long *cur, unsigned long *target)
+{
+	struct digsig_cache_table *t;
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	*cur = capacity(t->bits);
+	rcu_read_unlock();
+	*target = capacity(ACCESS_ONCE(digsig_max_bits));
+}
+
+/******************************************************************************
+Description : Change the size the cache may grow to.  A target below the
+	current size shrinks the table right away.
+Parameters  :
+	@entries: new target, in entries; rounded up to a power of two
+		number of buckets, and never below dsi_cache_buckets nor above
+		dsi_cache_max_kb
+Return value: 0 on success, -ENOMEM if the table could not be shrunk
+******************************************************************************/
+int digsig_cache_set_target(unsigned long entries)
+{
+	struct digsig_cache_table *t;
+	unsigned int bits = max(digsig_cap_bits(digsig_entries_to_bits(entries)),
+				digsig_min_bits);
+	int rc = 0;
+
+	mutex_lock(&digsig_cache_mutex);
+	digsig_max_bits = bits;
+	t = rcu_dereference_protected(sig_cache,
+				      lockdep_is_held(&digsig_cache_mutex));
+	if (t->bits > bits)
+		rc = digsig_resize_table(bits);
+	digsig_wanted_bits = min(digsig_wanted_bits, bits);
+	mutex_unlock(&digsig_cache_mutex);
+
+	return rc;
+}
+
+#ifdef CONFIG_SECURITY_DIGSIG_STATS
+static const char *digsig_cache_stat_names[CACHE_STATS] = {
+	[CACHE_STAT_LOOKUP] = "lookups",
+	[CACHE_STAT_HIT] = "hits",
+	[CACHE_STAT_MISS] = "misses",
+	[CACHE_STAT_INSERT] = "inserts",
+	[CACHE_STAT_EVICT] = "evictions",
+	[CACHE_STAT_DROP] = "drops",
+	[CACHE_STAT_STALE] = "stale",
+	[CACHE_STAT_DEFER] = "deferred",
+	[CACHE_STAT_QUOTA] = "quota",
+	[CACHE_STAT_L1] = "cpu_hits",
+};
+
+/******************************************************************************
+Description : Show the counters, summed over the CPUs, and how many
+	buckets hold each number of entries.  The buckets are read without
+	their locks, so the histogram is only a snapshot.
+Parameters  :
+	@m: the seq_file of /sys/kernel/security/digsig/cache
+Return value: none
+******************************************************************************/
+void digsig_cache_stats_show(struct seq_file *m)
+{
+	unsigned long occupancy[ENTRIES_PER_BUCKET + 1] = { 0 };
+	struct digsig_cache_table *t;
+	unsigned long sum;
+	u64 tags;
+	int i, j, n, cpu;
+
+	for (i = 0; i < CACHE_STATS; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(digsig_cache_stats, cpu)[i];
+		seq_printf(m, "%s %lu\n", digsig_cache_stat_names[i], sum);
+	}
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	for (i = 0; i < (1 << t->bits); i++) {
+		tags = ACCESS_ONCE(t->line[i].tags);
+		for (j = 0, n = 0; j < ENTRIES_PER_BUCKET; j++)
+			if (line_tag(tags, j))
+				n++;
+		occupancy[n]++;
+	}
+	seq_printf(m, "buckets %lu\noccupancy", 1UL << t->bits);
+	rcu_read_unlock();
+
+	for (n = 0; n <= ENTRIES_PER_BUCKET; n++)
+		seq_printf(m, " %lu", occupancy[n]);
+	seq_putc(m, '\n');
+	digsig_ghost_show(m);
+}
+#endif
+
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+/*
+ * /sys/kernel/security/digsig/entries walks the table a bucket at a
+ * time, under RCU but without the locks of the buckets: each one is
+ * copied on the read side of its seqlock, and a resize meanwhile only
+ * shows some entries twice or not at all.
+ */
+static void *digsig_cache_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct digsig_cache_table *t;
+
+	rcu_read_lock();
+	t = rcu_dereference(sig_cache);
+	m->private = t;
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+	if (*pos > (1 << t->bits))
+		return NULL;
+	return &t->line[*pos - 1];
+}
+
+static void *digsig_cache_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct digsig_cache_table *t = m->private;
+
+	if (++*pos > (1 << t->bits))
+		return NULL;
+	return &t->line[*pos - 1];
+}
+
+static void digsig_cache_seq_stop(struct seq_file *m, void *v)
+{
+	rcu_read_unlock();
+}
+
+static int digsig_cache_seq_show(struct seq_file *m, void *v)
+{
+	struct digsig_hash_entry entry[ENTRIES_PER_BUCKET];
+	u32 born[ENTRIES_PER_BUCKET];
+	struct digsig_hash_line *l = v;
+	unsigned long refs, now = get_seconds();
+	unsigned seq;
+	u64 tags;
+	int i;
+
+	if (v == SEQ_START_TOKEN) {
+#ifndef CONFIG_SECURITY_DIGSIG_COMPACT_CACHE
+		seq_puts(m, "# sb ino igen generation sig_hash key age refs\n");
+#else
+		seq_puts(m, "# key generation age refs\n");
+#endif
+		return 0;
+	}
+
+	do {
+		seq = read_seqbegin(&l->sequence);
+		tags = l->tags;
+		refs = l->refs;
+		memcpy(entry, l->entry, sizeof(entry));
+		memcpy(born, l->born, sizeof(born));
+	} while (read_seqretry(&l->sequence, seq));
+
+	for (i = 0; i < ENTRIES_PER_BUCKET; i++) {
+		struct digsig_hash_entry *e = &entry[i];
+		int r = test_bit(HOT_BIT(i), &refs) ? 2 :
+			test_bit(REF_BIT(i), &refs) ? 1 : 0;
+
+		if (!line_tag(tags, i))
+			continue;
+#ifndef CONFIG_SECURITY_DIGSIG_COMPACT_CACHE
+		seq_printf(m, "%llu %lu %u %u %08x %u %lu %d\n",
+			   e->i_sb_id, e->i_ino, e->i_generation,
+			   e->verdict.generation, e->verdict.sig_hash,
+			   e->verdict.key, now - born[i], r);
+#else
+		seq_printf(m, "%08x%08x %u %lu %d\n", e->key_hi, e->key_lo,
+			   e->generation, now - born[i], r);
+#endif
+	}
+	return 0;
+}
+
+const struct seq_operations digsig_cache_seq_ops = {
+	.start = digsig_cache_seq_start,
+	.next = digsig_cache_seq_next,
+	.stop = digsig_cache_seq_stop,
+	.show = digsig_cache_seq_show,
+};
+#endif
+
 /******************************************************************************
 Description : Initialize caching
 Parameters  : none
@@ -213,34 +1692,43 @@ Return value: 0 on success, 1 on failure.
 ******************************************************************************/
 int __init digsig_init_caching(void)
 {
-	int i, j;
+	struct digsig_cache_table *t;
+	int cpu;
 
 	/* dsi_cache_buckets must be a power of two */
-	digsig_hash_bits = ilog2(dsi_cache_buckets);
-	if (dsi_cache_buckets != (1 << digsig_hash_bits)) {
-		digsig_hash_bits++;
-		dsi_cache_buckets = 1 << digsig_hash_bits;
+	digsig_min_bits = ilog2(dsi_cache_buckets);
+	if (dsi_cache_buckets != (1 << digsig_min_bits)) {
+		digsig_min_bits++;
+		dsi_cache_buckets = 1 << digsig_min_bits;
 		DSM_PRINT(DEBUG_INIT,
 			  "%s: dsi_cache_buckets set to %d (bits %d)\n",
-			  __func__, dsi_cache_buckets, digsig_hash_bits);
+			  __func__, dsi_cache_buckets, digsig_min_bits);
 	}
+	if (digsig_cap_bits(digsig_min_bits) != digsig_min_bits) {
+		digsig_min_bits = digsig_cap_bits(digsig_min_bits);
+		dsi_cache_buckets = 1 << digsig_min_bits;
+		DSM_PRINT(DEBUG_INIT,
+			  "%s: dsi_cache_buckets cut to %d to fit in %d kB\n",
+			  __func__, dsi_cache_buckets, dsi_cache_max_kb);
+	}
+	digsig_max_bits = max(digsig_cap_bits(digsig_entries_to_bits(dsi_cache_target)),
+			      digsig_min_bits);
+	digsig_wanted_bits = digsig_min_bits;
+#ifdef CONFIG_SECURITY_DIGSIG_COMPACT_CACHE
+	get_random_bytes(digsig_cache_seed, sizeof(digsig_cache_seed));
+#endif
 
-	sig_cache = kmalloc(dsi_cache_buckets * sizeof(struct digsig_hash_line),
-			    GFP_KERNEL);
-
-
-	if (!sig_cache) {
+	t = digsig_alloc_table(digsig_min_bits);
+	if (!t) {
 		DSM_PRINT(DEBUG_ERROR, "No memory to initialize digsig cache.\n");
 		return 1;
 	}
+	RCU_INIT_POINTER(sig_cache, t);
 
-	for (i = 0; i < dsi_cache_buckets; i++) {
-		seqlock_init(&sig_cache[i].sequence);
-		sig_cache[i].next_evicted = 0;
-		for (j = 0; j < ENTRIES_PER_BUCKET; j++)
-			sig_cache[i].entry[j].inode = NULL;
-	}
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(digsig_cache_pending, cpu).lock);
 
+	register_shrinker(&digsig_cache_shrinker);
 	return 0;
 }
 
@@ -249,6 +1737,15 @@ int __init digsig_init_caching(void)
  */
 void digsig_cache_cleanup(void)
 {
-	kfree(sig_cache);
-	sig_cache = NULL;
+	struct digsig_cache_table *t;
+
+	unregister_shrinker(&digsig_cache_shrinker);
+	cancel_work_sync(&digsig_cache_resize_work);
+	cancel_work_sync(&digsig_cache_pending_work);
+	cancel_work_sync(&digsig_cache_sweep_work);
+
+	t = rcu_dereference_protected(sig_cache, 1);
+	RCU_INIT_POINTER(sig_cache, NULL);
+	synchronize_rcu();
+	digsig_free_table(t);
 }
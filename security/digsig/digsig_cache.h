@@ -20,12 +20,24 @@
 
 #include <linux/fs.h>
 #include "gnupg/mpi/mpi.h"
+#include "digsig_inode.h"
 
-int is_cached_signature(struct inode *inode);
+int is_cached_signature(struct inode *inode, struct digsig_verdict *verdict);
 void remove_signature(struct inode *inode);
-void digsig_cache_signature(struct inode *inode);
+void digsig_cache_forget_sb(u64 sb_id);
+void digsig_cache_forget_key(u32 tag);
+void digsig_cache_signature(struct inode *inode, struct digsig_verdict verdict);
 int digsig_init_caching(void);
 void digsig_cache_cleanup(void);
+void digsig_cache_capacity(unsigned long *cur, unsigned long *target);
+int digsig_cache_set_target(unsigned long entries);
+#ifdef CONFIG_SECURITY_DIGSIG_STATS
+struct seq_file;
+void digsig_cache_stats_show(struct seq_file *m);
+#endif
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+extern const struct seq_operations digsig_cache_seq_ops;
+#endif
 
 #endif /* _DSI_CACHE_H */
 
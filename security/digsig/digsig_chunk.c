@@ -0,0 +1,436 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies files signed in the chunk hash format: the
+ * signature covers a list of chunk hashes, so the chunks can be hashed
+ * on several CPUs at once instead of the whole file on one.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_chunk.h"
+#include "digsig_inode.h"
+#include "digsig_cache.h"
+#include "digsig_xattr.h"
+#include "digsig_recent.h"
+#include "digsig_bulk.h"
+#include "digsig_ioprio.h"
+
+/* no more workers than this, and at least this many chunks for each */
+#define DIGSIG_CHUNK_MAX_WORKERS 8
+#define DIGSIG_CHUNK_PER_WORKER 4
+
+/*
+ * digsig_chunk_work: one range of chunks, hashed by a worker or by the
+ * verifying task itself.
+ */
+struct digsig_chunk_work {
+	struct work_struct work;
+	struct file *file;
+	struct digsig_chunks *c;
+	u32 first, last;		/* [first, last) */
+	int result;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+/*
+ * digsig_chunk_defer: the chunks of a file that was granted its mapping
+ * before they were checked.
+ */
+struct digsig_chunk_defer {
+	struct work_struct work;
+	struct file *file;
+	struct digsig_chunks *c;
+	struct digsig_verdict verdict;
+};
+
+int dsi_chunk_lazy = 0;
+module_param(dsi_chunk_lazy, int, 0);
+MODULE_PARM_DESC(dsi_chunk_lazy, "Map chunk hashed binaries before their chunks are checked.\n");
+
+static const char *const digsig_chunk_hash_names[DIGSIG_CHUNK_ALGOS] = {
+	[DIGSIG_CHUNK_SHA256] = "sha256",
+	[DIGSIG_CHUNK_BLAKE2B] = "blake2b-256",
+};
+
+static struct crypto_shash *digsig_chunk_tfm[DIGSIG_CHUNK_ALGOS];
+
+static struct crypto_shash *digsig_chunk_get_tfm(int algo)
+{
+	struct crypto_shash *tfm, *old;
+
+	tfm = ACCESS_ONCE(digsig_chunk_tfm[algo]);
+	if (tfm) {
+		smp_read_barrier_depends();
+		return tfm;
+	}
+
+	tfm = crypto_alloc_shash(digsig_chunk_hash_names[algo], 0, 0);
+	if (IS_ERR(tfm))
+		return tfm;
+
+	old = cmpxchg(&digsig_chunk_tfm[algo], NULL, tfm);
+	if (old) {
+		crypto_free_shash(tfm);
+		tfm = old;
+	}
+	return tfm;
+}
+
+/* allocate the transforms as the key is loaded, not on the first exec */
+void digsig_chunk_warm_up(void)
+{
+	int i;
+
+	for (i = 0; i < DIGSIG_CHUNK_ALGOS; i++)
+		if (IS_ERR(digsig_chunk_get_tfm(i)))
+			DSM_ERROR("%s: no %s transform\n", __func__,
+				  digsig_chunk_hash_names[i]);
+}
+
+static void digsig_chunk_section_free(void *p)
+{
+	if (is_vmalloc_addr(p))
+		vfree(p);
+	else
+		kfree(p);
+}
+
+/******************************************************************************
+Description : Read and check the chunk hash section of a file.
+Parameters  :
+	@file: the file being verified
+	@offset, @size: where its chunk hash section is
+	@sig_offset, @sig_size: where its signature section is
+Return value: the chunk hashes, NULL if the section is not a valid one
+	for this file or could not be read
+******************************************************************************/
+struct digsig_chunks *digsig_chunks_read(struct file *file,
+					 loff_t offset,
+					 unsigned long size,
+					 loff_t sig_offset,
+					 unsigned long sig_size)
+{
+	struct digsig_chunks *c;
+	struct digsig_chunk_hdr *hdr;
+	loff_t i_size = i_size_read(file->f_dentry->d_inode);
+	int retval;
+
+	if (size < sizeof(*hdr) || size > DIGSIG_CHUNK_MAX_SECTION)
+		return NULL;
+	/* the chunks are hashed from the page cache */
+	if (!file->f_mapping || !file->f_mapping->a_ops->readpage)
+		return NULL;
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return NULL;
+	if (size <= PAGE_SIZE)
+		hdr = kmalloc(size, GFP_KERNEL);
+	else
+		hdr = vmalloc(size);
+	if (!hdr)
+		goto err;
+	c->hdr = hdr;
+	c->size = size;
+
+	retval = kernel_read(file, offset, (char *)hdr, size);
+	if (retval != size) {
+		DSM_PRINT(DEBUG_SIGN, "%s: Unable to read chunk hashes: %d\n",
+			  __func__, retval);
+		goto err;
+	}
+
+	c->shift = le32_to_cpu(hdr->chunk_shift);
+	c->nchunks = le32_to_cpu(hdr->nchunks);
+	c->file_size = le64_to_cpu(hdr->file_size);
+	c->hashes = (const u8 *)(hdr + 1);
+	if (!memcmp(hdr->magic, DIGSIG_CHUNK_MAGIC, sizeof(hdr->magic)))
+		c->algo = DIGSIG_CHUNK_SHA256;
+	else if (!memcmp(hdr->magic, DIGSIG_CHUNK_MAGIC_BLAKE2B,
+			 sizeof(hdr->magic)))
+		c->algo = DIGSIG_CHUNK_BLAKE2B;
+	else
+		c->algo = -1;
+	if (c->algo < 0 ||
+	    c->shift < DIGSIG_CHUNK_MIN_SHIFT ||
+	    c->shift > DIGSIG_CHUNK_MAX_SHIFT ||
+	    c->file_size != i_size ||
+	    c->nchunks != DIV_ROUND_UP(i_size, 1ULL << c->shift) ||
+	    size != sizeof(*hdr) + (size_t)c->nchunks * DIGSIG_CHUNK_HASH_SIZE) {
+		DSM_PRINT(DEBUG_SIGN, "%s: chunk hash section does not match\n",
+			  __func__);
+		goto err;
+	}
+
+	c->zero_start[0] = sig_offset;
+	c->zero_end[0] = sig_offset + sig_size;
+	c->zero_start[1] = offset;
+	c->zero_end[1] = offset + size;
+	return c;
+
+err:
+	digsig_chunks_free(c);
+	return NULL;
+}
+
+void digsig_chunks_free(struct digsig_chunks *c)
+{
+	if (!c)
+		return;
+	digsig_chunk_section_free(c->hdr);
+	kfree(c);
+}
+
+/*
+ * Hash the bytes [start, end) of the file, all within the page mapped
+ * at kaddr, with the signature and chunk hash sections read as zeroes.
+ */
+static int digsig_chunk_hash_range(struct shash_desc *desc,
+				   struct digsig_chunks *c, char *kaddr,
+				   loff_t start, loff_t end)
+{
+	char *zeroes = page_address(ZERO_PAGE(0));
+	loff_t next;
+	int i, zero, retval = 0;
+
+	while (start < end && !retval) {
+		next = end;
+		zero = 0;
+		for (i = 0; i < 2; i++) {
+			if (start >= c->zero_start[i] && start < c->zero_end[i]) {
+				next = min(next, c->zero_end[i]);
+				zero = 1;
+			} else if (c->zero_start[i] > start) {
+				next = min(next, c->zero_start[i]);
+			}
+		}
+		if (zero)
+			retval = crypto_shash_update(desc, zeroes, next - start);
+		else
+			retval = crypto_shash_update(desc,
+					kaddr + (start & ~PAGE_MASK),
+					next - start);
+		start = next;
+	}
+	return retval;
+}
+
+static int digsig_chunk_check(struct shash_desc *desc, struct file *file,
+			      struct digsig_chunks *c, u32 chunk)
+{
+	u8 hash[DIGSIG_CHUNK_HASH_SIZE];
+	loff_t pos = (loff_t)chunk << c->shift;
+	loff_t end = min(c->file_size, pos + (1LL << c->shift));
+	loff_t pend;
+	struct page *page;
+	int retval;
+
+	retval = crypto_shash_init(desc);
+	for (; pos < end && !retval; pos = pend) {
+		page = read_mapping_page(file->f_mapping,
+					 pos >> PAGE_CACHE_SHIFT, file);
+		if (IS_ERR(page))
+			return PTR_ERR(page);
+
+		pend = min_t(loff_t, end, (pos | ~PAGE_MASK) + 1);
+		retval = digsig_chunk_hash_range(desc, c, kmap(page), pos, pend);
+		kunmap(page);
+		page_cache_release(page);
+	}
+	if (!retval)
+		retval = crypto_shash_final(desc, hash);
+	if (retval)
+		return retval;
+
+	if (memcmp(hash, c->hashes + chunk * DIGSIG_CHUNK_HASH_SIZE,
+		   DIGSIG_CHUNK_HASH_SIZE)) {
+		DSM_PRINT(DEBUG_SIGN, "%s: chunk %u does not match\n",
+			  __func__, chunk);
+		return -EPERM;
+	}
+	return 0;
+}
+
+static int digsig_chunk_check_range(struct digsig_chunk_work *w)
+{
+	struct crypto_shash *tfm = digsig_chunk_get_tfm(w->c->algo);
+	struct shash_desc *desc;
+	u32 i;
+	int retval = 0;
+
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+	desc->tfm = tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	for (i = w->first; i < w->last && !retval; i++)
+		retval = digsig_chunk_check(desc, w->file, w->c, i);
+
+	kfree(desc);
+	return retval;
+}
+
+static void digsig_chunk_worker(struct work_struct *work)
+{
+	struct digsig_chunk_work *w =
+		container_of(work, struct digsig_chunk_work, work);
+
+	w->result = digsig_chunk_check_range(w);
+	if (atomic_dec_and_test(w->pending))
+		complete(w->done);
+}
+
+/******************************************************************************
+Description : Check every chunk of the file against its hash.  Large
+	files are split into ranges of chunks hashed by unbound workers,
+	or by the other CPUs when verified in bulk, while the caller
+	hashes the first range, unless dsi_charge keeps the work in the
+	caller.
+Parameters  :
+	@file: the file, whose chunk hash section was read into @c and
+	       whose signature of that section was verified
+	@c: the chunk hashes
+Return value: 0 if every chunk matches, -EPERM if one does not,
+	another negative error if the file could not be read
+******************************************************************************/
+int digsig_chunks_verify(struct file *file, struct digsig_chunks *c)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct digsig_chunk_work *works;
+	unsigned int nworkers, i;
+	atomic_t pending;
+	int retval;
+
+	nworkers = dsi_charge ? 1 : min_t(unsigned int, num_online_cpus(),
+					  DIGSIG_CHUNK_MAX_WORKERS);
+	nworkers = min_t(unsigned int, nworkers,
+			 c->nchunks / DIGSIG_CHUNK_PER_WORKER);
+	if (nworkers < 1)
+		nworkers = 1;
+
+	works = kcalloc(nworkers, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return -ENOMEM;
+
+	atomic_set(&pending, nworkers);
+	for (i = 0; i < nworkers; i++) {
+		works[i].file = file;
+		works[i].c = c;
+		works[i].first = (u64)c->nchunks * i / nworkers;
+		works[i].last = (u64)c->nchunks * (i + 1) / nworkers;
+		works[i].pending = &pending;
+		works[i].done = &done;
+		INIT_WORK(&works[i].work, digsig_chunk_worker);
+		if (i && digsig_bulk_spawn(&works[i].work))
+			queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	/* the first range is ours */
+	digsig_chunk_worker(&works[0].work);
+	digsig_bulk_join(&done);
+
+	retval = 0;
+	for (i = 0; i < nworkers; i++)
+		if (works[i].result && !retval)
+			retval = works[i].result;
+
+	kfree(works);
+	return retval;
+}
+
+static void digsig_chunk_defer_worker(struct work_struct *work)
+{
+	struct digsig_chunk_defer *d =
+		container_of(work, struct digsig_chunk_defer, work);
+	struct inode *inode = file_inode(d->file);
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_prio prio;
+	int retval;
+
+	digsig_prio_background(&prio);
+	retval = digsig_chunks_verify(d->file, d->c);
+	digsig_prio_restore(&prio);
+	if (!retval) {
+		digsig_inode_set_verified(inode, d->verdict);
+		digsig_cache_signature(inode, d->verdict);
+		digsig_recent_record(inode, d->verdict);
+		digsig_xattr_record(d->file);
+	} else {
+		DSM_ERROR("%s: chunks of %s do not match (%d), it will not be mapped again\n",
+			  __func__, d->file->f_dentry->d_name.name, retval);
+		set_bit(DIGSIG_INODE_BAD, &isec->flags);
+	}
+	/* the verdict is set before mappings stop being let through */
+	smp_mb__before_clear_bit();
+	clear_bit(DIGSIG_INODE_LAZY, &isec->flags);
+
+	digsig_chunks_free(d->c);
+	fput(d->file);
+	kfree(d);
+}
+
+/******************************************************************************
+Description : Check the chunks of the file in the background, so that it
+	can be mapped as soon as the signature of its chunk hash section is
+	verified.  Until the chunks are checked, further mappings of the
+	file are granted too; once one is found not to match, the file can
+	not be mapped again until it is written.  The writer count taken by
+	the mapping is held, with the file, until the check is done.
+Parameters  :
+	@file: the file, whose chunk hash section was read into @c and
+	       whose signature of that section was verified
+	@c: the chunk hashes
+	@verdict: what the verification was made under
+Return value: 0 if the check was queued and @c handed over to it, a
+	negative error if the chunks must be checked by the caller
+******************************************************************************/
+int digsig_chunks_defer(struct file *file, struct digsig_chunks *c,
+			struct digsig_verdict verdict)
+{
+	struct digsig_inode_sec *isec;
+	struct digsig_chunk_defer *d;
+
+	if (!dsi_chunk_lazy || dsi_charge)
+		return -EINVAL;
+
+	isec = digsig_inode_get(file_inode(file));
+	if (!isec)
+		return -ENOMEM;
+	d = kmalloc(sizeof(*d), GFP_KERNEL);
+	if (!d)
+		return -ENOMEM;
+	if (test_and_set_bit(DIGSIG_INODE_LAZY, &isec->flags)) {
+		kfree(d);
+		return -EBUSY;
+	}
+
+	d->file = get_file(file);
+	d->c = c;
+	d->verdict = verdict;
+	INIT_WORK(&d->work, digsig_chunk_defer_worker);
+	queue_work(system_unbound_wq, &d->work);
+	return 0;
+}
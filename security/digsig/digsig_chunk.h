@@ -0,0 +1,61 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the checking of files by chunk hashes.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_CHUNK_H
+#define _DIGSIG_CHUNK_H
+
+#include <linux/fs.h>
+#include <linux/types.h>
+
+#include "digsig_inode.h"
+#include "digsig_format.h"
+
+#define DIGSIG_CHUNK_SHA256 0
+#define DIGSIG_CHUNK_BLAKE2B 1
+#define DIGSIG_CHUNK_ALGOS 2
+
+/*
+ * digsig_chunks: a chunk hash section read from a file, and where the
+ * parts of the file that are hashed as zeroes are.
+ */
+struct digsig_chunks {
+	struct digsig_chunk_hdr *hdr;	/* the whole section */
+	size_t size;
+	const u8 *hashes;
+	int algo;			/* DIGSIG_CHUNK_SHA256 or _BLAKE2B */
+	unsigned int shift;
+	u32 nchunks;
+	loff_t file_size;
+	loff_t zero_start[2], zero_end[2];
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_CHUNKED
+struct digsig_chunks *digsig_chunks_read(struct file *file,
+					 loff_t offset,
+					 unsigned long size,
+					 loff_t sig_offset,
+					 unsigned long sig_size);
+int digsig_chunks_verify(struct file *file, struct digsig_chunks *c);
+int digsig_chunks_defer(struct file *file, struct digsig_chunks *c,
+			struct digsig_verdict verdict);
+void digsig_chunks_free(struct digsig_chunks *c);
+void digsig_chunk_warm_up(void);
+#else
+#define digsig_chunks_read(file, off, size, sig_off, sig_size) \
+	((struct digsig_chunks *)NULL)
+#define digsig_chunks_verify(file, c) (-EINVAL)
+#define digsig_chunks_defer(file, c, gen) (-EINVAL)
+#define digsig_chunks_free(c) do { } while (0)
+#define digsig_chunk_warm_up() do { } while (0)
+#endif
+
+#endif /* _DIGSIG_CHUNK_H */
@@ -30,6 +30,8 @@
 #include <linux/interrupt.h>
 #include <linux/pid.h>
 #include <linux/init.h>
+#include <linux/ratelimit.h>
+#include <linux/jump_label.h>
 
 /* DSM-DIGSIG error types */
 #define DSM_SUCCESS             1
@@ -38,6 +40,26 @@
 #define DIGSIG_SAFE_ALLOC (in_interrupt () ? GFP_ATOMIC : GFP_KERNEL)
 
 extern int g_init;
+extern struct static_key digsig_active_key;
+
+/*
+ * With dsi_charge, the work of verifying a file for a task is all done
+ * by that task, never handed to shared workers, so that the CPU time
+ * and the I/O are accounted to its cgroups.
+ */
+extern int dsi_charge;
+
+/*
+ * Has a key been loaded?  The hooks test this patched branch rather than
+ * g_init, so they cost next to nothing until then; the cache and the
+ * other records can only be filled from that point on.
+ */
+static inline bool digsig_active(void)
+{
+	return static_key_false(&digsig_active_key);
+}
+
+void digsig_set_active(void);
 
 /* dsi_debug.h definitions below */
 
@@ -74,13 +96,32 @@ extern int DigsigDebugLevel;
 
 #define DIGSIG_MODULE_NAME "digsig"
 
-/* This is a hack to avoid using va_lists */
+void digsig_log(struct ratelimit_state *rs, const char *func,
+		const char *fmt, ...) __printf(3, 4);
+
+/*
+ * Messages go through digsig_log(), which buffers them for a worker to
+ * printk, with a rate limit for each call site.
+ */
+#define DSM_LOG(fmt, arg...)						\
+do {									\
+	static DEFINE_RATELIMIT_STATE(_dsm_rs, DEFAULT_RATELIMIT_INTERVAL, \
+				      DEFAULT_RATELIMIT_BURST);		\
+	digsig_log(&_dsm_rs, __func__, fmt, ##arg);			\
+} while (0)
+
 #define DSM_PRINT(dbg, fmt, arg...) \
-    if (dbg & DigsigDebugLevel) printk(DIGSIG_MODULE_NAME ": " fmt, ##arg)
+do { \
+	if ((dbg) & DigsigDebugLevel) \
+		DSM_LOG(DIGSIG_MODULE_NAME ": " fmt, ##arg); \
+} while (0)
 
 #define DSM_PRINT_NO_PREFIX(dbg, fmt, arg...) \
-    if (dbg & DigsigDebugLevel) printk(fmt, ##arg)
+do { \
+	if ((dbg) & DigsigDebugLevel) \
+		DSM_LOG(fmt, ##arg); \
+} while (0)
 
-#define DSM_ERROR(fmt, arg...) printk(DIGSIG_MODULE_NAME ": error: " fmt, ##arg)
+#define DSM_ERROR(fmt, arg...) DSM_LOG(DIGSIG_MODULE_NAME ": error: " fmt, ##arg)
 
 #endif /* _DIGSIG_COMMON_H */
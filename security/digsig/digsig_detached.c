@@ -0,0 +1,58 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file reads signatures kept aside from the files they sign, in
+ * the security.digsig.sig extended attribute, for the files that can
+ * not carry a signature section: scripts and other files that are not
+ * ELF, and binaries that are not ours to sign again.  The attribute
+ * holds a signature in the format of the ELF signature section, of the
+ * whole file as it is.
+ *
+ * The signature is checked with the DigSig key like any other, so the
+ * attribute need not be protected; changing it only makes the file be
+ * verified again.  Files signed both ways are verified from their
+ * section, and files found signed by neither are treated as before.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/xattr.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_detached.h"
+
+/******************************************************************************
+Description : Read the detached signature of the file, if it has one,
+	into the verification context.
+Parameters  :
+	@ctx: the verification context, whose sig buffer receives it
+	@file: the file about to be verified
+Return value: the size of the signature, 0 if there is none of a size
+	we know
+******************************************************************************/
+int digsig_detached_read(SIGCTX *ctx, struct file *file)
+{
+	struct dentry *dentry = file->f_dentry;
+	struct inode *inode = dentry->d_inode;
+	int rc;
+
+	if (!inode->i_op->getxattr)
+		return 0;
+
+	rc = inode->i_op->getxattr(dentry, XATTR_NAME_DIGSIG_SIG, ctx->sig,
+				   sizeof(ctx->sig));
+	if (rc != DIGSIG_ELF_SIG_SIZE && rc != DIGSIG_ED25519_SIG_SIZE) {
+		if (rc > 0)
+			DSM_PRINT(DEBUG_SIGN, "%s: %s has a signature of %d bytes\n",
+				  __func__, dentry->d_name.name, rc);
+		return 0;
+	}
+	return rc;
+}
@@ -0,0 +1,29 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the signatures kept aside from the files.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_DETACHED_H
+#define _DIGSIG_DETACHED_H
+
+#include <linux/fs.h>
+#include <linux/xattr.h>
+
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_DETACHED
+int digsig_detached_read(SIGCTX *ctx, struct file *file);
+#define digsig_detached_name(name) (strcmp(name, XATTR_NAME_DIGSIG_SIG) == 0)
+#else
+#define digsig_detached_read(ctx, file) 0
+#define digsig_detached_name(name) 0
+#endif
+
+#endif /* _DIGSIG_DETACHED_H */
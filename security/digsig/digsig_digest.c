@@ -0,0 +1,281 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the digest of a file on its inode, apart from the
+ * verdict: a verdict dropped for another reason than a change of the
+ * file, because the key that made it was retired, a revocation rule
+ * was added or the cache evicted it, is then made again from the
+ * digest, with one signature operation and without reading the file.
+ *
+ * The digest is of what the signature is of, the file with its
+ * signature section read as zeroes or its segments, and is only taken
+ * while the file is as it was hashed: the same size, times, i_version
+ * and generation.  It is dropped when the file is opened for writing
+ * or its attributes change, as verdicts are.  Chunked files are not
+ * kept: their signature is of the chunk section, which costs nothing to
+ * hash again.
+ *
+ * Once IMA has a policy, a file hashed whole is also hashed as it is, on
+ * the same pass, with IMA's transform, and that digest is kept beside
+ * the other: IMA, which measures the file after DigSig verified it,
+ * takes it through integrity_shared_digest() rather than read and hash
+ * the file a second time.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/time.h>
+#include <linux/integrity.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_digest.h"
+
+static int dsi_digest_min_kb = 64;
+module_param(dsi_digest_min_kb, int, 0);
+MODULE_PARM_DESC(dsi_digest_min_kb, "Keep the digest of files of this many kilobytes and more on their inode, -1 for none.\n");
+
+/*
+ * digsig_digest: the digest of a file, how it was hashed and what the
+ * file looked like then.  It is not changed once published: a new one
+ * replaces it, and readers copy it out under rcu_read_lock().
+ */
+struct digsig_digest {
+	struct rcu_head rcu;
+	int algo;
+	int segments;
+	loff_t sh_offset, sig_size;
+	loff_t size;
+	struct timespec mtime, ctime;
+	u64 version;
+	u32 igen;
+	u8 digest[DIGSIG_MAX_DIGEST_LENGTH];
+	struct crypto_shash *shared_tfm;	/* NULL if none for IMA */
+	u8 shared[DIGSIG_MAX_DIGEST_LENGTH];
+};
+
+/* what the file looks like */
+static void digsig_digest_state(struct digsig_digest *d, struct inode *inode)
+{
+	d->size = i_size_read(inode);
+	d->mtime = inode->i_mtime;
+	d->ctime = inode->i_ctime;
+	d->version = digsig_inode_versioned(inode) ? inode->i_version : 0;
+	d->igen = inode->i_generation;
+}
+
+static int digsig_digest_state_match(const struct digsig_digest *d,
+				     const struct digsig_digest *cur)
+{
+	return d->size == cur->size &&
+	       timespec_equal(&d->mtime, &cur->mtime) &&
+	       timespec_equal(&d->ctime, &cur->ctime) &&
+	       d->version == cur->version && d->igen == cur->igen;
+}
+
+static void digsig_digest_fill(struct digsig_digest *d, SIGCTX *ctx,
+			       struct inode *inode, int segments,
+			       loff_t sh_offset, unsigned long sig_size)
+{
+	d->algo = ctx->digestAlgo;
+	d->segments = segments;
+	d->sh_offset = sh_offset;
+	d->sig_size = sig_size;
+	digsig_digest_state(d, inode);
+}
+
+static int digsig_digest_match(const struct digsig_digest *d,
+			       const struct digsig_digest *cur)
+{
+	return d->algo == cur->algo && d->segments == cur->segments &&
+	       d->sh_offset == cur->sh_offset &&
+	       d->sig_size == cur->sig_size &&
+	       digsig_digest_state_match(d, cur);
+}
+
+/* Are digests of a file of this inode kept? */
+static int digsig_digest_wanted(struct inode *inode)
+{
+	return dsi_digest_min_kb >= 0 &&
+	       i_size_read(inode) >= (loff_t)dsi_digest_min_kb << 10;
+}
+
+/******************************************************************************
+Description : Take the digest kept for a file in place of hashing it.
+Parameters  :
+	@ctx: a context whose verification was just started
+	@file: the file about to be hashed, held from writers
+	@segments: whether the signature is of the segments of the file
+	@sh_offset, @sig_size: where its signature section is
+Return value: 1 if the digest of the file is in ctx->digest, 0 if the
+	file must be hashed
+******************************************************************************/
+int digsig_digest_take(SIGCTX *ctx, struct file *file, int segments,
+		       loff_t sh_offset, unsigned long sig_size)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_digest *d, cur;
+	int found = 0;
+
+	if (!isec || !ACCESS_ONCE(isec->digest))
+		return 0;
+
+	digsig_digest_fill(&cur, ctx, inode, segments, sh_offset, sig_size);
+	rcu_read_lock();
+	d = rcu_dereference(isec->digest);
+	if (d && digsig_digest_match(d, &cur)) {
+		memcpy(ctx->digest, d->digest, gDigestLength[d->algo]);
+		ctx->digest_done = 1;
+		found = 1;
+	}
+	rcu_read_unlock();
+
+	if (found)
+		DSM_PRINT(DEBUG_SIGN, "%s: %s not hashed again\n", __func__,
+			  file->f_dentry->d_name.name);
+	return found;
+}
+
+/******************************************************************************
+Description : Finish the digest of a file just hashed, and keep it on its
+	inode for the verifications to come.
+Parameters  :
+	@ctx: the context, whose descriptor holds the hash of the file
+	@file: the file hashed, held from writers meanwhile
+	@segments, @sh_offset, @sig_size: as for digsig_digest_take()
+Return value: 0, or negative if the digest could not be finished; a
+	digest that can not be kept is only lost
+******************************************************************************/
+int digsig_digest_keep(SIGCTX *ctx, struct file *file, int segments,
+		       loff_t sh_offset, unsigned long sig_size)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec;
+	struct digsig_digest *d;
+	int rc;
+
+	if (!digsig_digest_wanted(inode))
+		return 0;
+	/* the asynchronous hash finishes the digest itself */
+	if (!ctx->digest_done) {
+		rc = crypto_shash_final(ctx->desc, ctx->digest);
+		if (rc < 0)
+			return rc;
+		ctx->digest_done = 1;
+	}
+
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return 0;
+	d = kmalloc(sizeof(*d), GFP_KERNEL);
+	if (!d)
+		return 0;
+	digsig_digest_fill(d, ctx, inode, segments, sh_offset, sig_size);
+	memcpy(d->digest, ctx->digest, gDigestLength[d->algo]);
+	d->shared_tfm = NULL;
+	if (ctx->share && !crypto_shash_final(ctx->share_desc, d->shared))
+		d->shared_tfm = ctx->share_desc->tfm;
+	ctx->share = 0;
+
+	d = xchg(&isec->digest, d);
+	if (d)
+		kfree_rcu(d, rcu);
+	return 0;
+}
+
+/******************************************************************************
+Description : Drop the digest kept for an inode that may change.
+Parameters  :
+	@inode: the inode
+Return value: none
+******************************************************************************/
+void digsig_digest_forget(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_digest *d;
+
+	if (!isec || !ACCESS_ONCE(isec->digest))
+		return;
+	d = xchg(&isec->digest, NULL);
+	if (d)
+		kfree_rcu(d, rcu);
+}
+
+/******************************************************************************
+Description : Start, beside the context's own digest, the digest of the file
+	as it is, with the transform IMA asked for, to keep with the other.
+Parameters  :
+	@ctx: a context whose verification was just started
+	@file: the file about to be hashed whole, from its start
+Return value: none; without IMA, or memory, the file is only hashed for
+	DigSig
+******************************************************************************/
+void digsig_digest_share(SIGCTX *ctx, struct file *file)
+{
+	struct crypto_shash *tfm = integrity_wanted_digest();
+	struct shash_desc *desc = ctx->share_desc;
+
+	if (!tfm || !digsig_digest_wanted(file_inode(file)) ||
+	    crypto_shash_digestsize(tfm) > DIGSIG_MAX_DIGEST_LENGTH)
+		return;
+	if (!desc || desc->tfm != tfm) {
+		kfree(desc);
+		desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm),
+			       GFP_KERNEL);
+		ctx->share_desc = desc;
+		if (!desc)
+			return;
+		desc->tfm = tfm;
+		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	}
+	if (!crypto_shash_init(desc))
+		ctx->share = 1;
+}
+
+/* integrity_digest_fn: the digest kept for IMA, if the file is as it was */
+static int digsig_digest_shared(struct file *file, struct crypto_shash *tfm,
+				u8 *digest)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_digest *d, cur;
+	int rc = -ENOENT;
+
+	if (!isec || !ACCESS_ONCE(isec->digest))
+		return rc;
+
+	digsig_digest_state(&cur, inode);
+	rcu_read_lock();
+	d = rcu_dereference(isec->digest);
+	if (d && d->shared_tfm == tfm && digsig_digest_state_match(d, &cur)) {
+		memcpy(digest, d->shared, crypto_shash_digestsize(tfm));
+		rc = 0;
+	}
+	rcu_read_unlock();
+
+	if (!rc)
+		DSM_PRINT(DEBUG_SIGN, "%s: %s not hashed again for IMA\n",
+			  __func__, file->f_dentry->d_name.name);
+	return rc;
+}
+
+/******************************************************************************
+Description : Hand the digests kept for IMA to the integrity layer.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void __init digsig_init_digest(void)
+{
+	integrity_set_digest_source(digsig_digest_shared);
+}
@@ -0,0 +1,37 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the file digests kept on inodes, apart from their
+ * verdicts.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_DIGEST_H
+#define _DIGSIG_DIGEST_H
+
+#include <linux/fs.h>
+
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_DIGEST_CACHE
+int digsig_digest_take(SIGCTX *ctx, struct file *file, int segments,
+		       loff_t sh_offset, unsigned long sig_size);
+int digsig_digest_keep(SIGCTX *ctx, struct file *file, int segments,
+		       loff_t sh_offset, unsigned long sig_size);
+void digsig_digest_forget(struct inode *inode);
+void digsig_digest_share(SIGCTX *ctx, struct file *file);
+void digsig_init_digest(void);
+#else
+#define digsig_digest_take(ctx, file, segments, sh_offset, sig_size) 0
+#define digsig_digest_keep(ctx, file, segments, sh_offset, sig_size) 0
+#define digsig_digest_forget(inode) do { } while (0)
+#define digsig_digest_share(ctx, file) do { } while (0)
+#define digsig_init_digest() do { } while (0)
+#endif
+
+#endif /* _DIGSIG_DIGEST_H */
@@ -0,0 +1,537 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the Ed25519 signature verification (RFC 8032).
+ *
+ * Field elements are kept in five 51 bit limbs and multiplied with
+ * 128 bit products, which is why this needs a 64 bit kernel.  Nothing
+ * here handles secrets, so none of it needs to run in constant time.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <asm/unaligned.h>
+
+#include "digsig_common.h"
+#include "digsig_ed25519.h"
+
+typedef unsigned __int128 u128;
+
+/* an element of GF(2^255 - 19), h[0] + h[1] 2^51 + ... + h[4] 2^204 */
+typedef struct {
+	u64 v[5];
+} fe;
+
+/* a point in extended coordinates: x = X/Z, y = Y/Z, x y = T/Z */
+struct ge {
+	fe X, Y, Z, T;
+};
+
+#define MASK51 ((1ULL << 51) - 1)
+
+static const fe fe_d = { { 0x34dca135978a3ULL, 0x1a8283b156ebdULL,
+	0x5e7a26001c029ULL, 0x739c663a03cbbULL, 0x52036cee2b6ffULL } };
+static const fe fe_d2 = { { 0x69b9426b2f159ULL, 0x35050762add7aULL,
+	0x3cf44c0038052ULL, 0x6738cc7407977ULL, 0x2406d9dc56dffULL } };
+static const fe fe_sqrtm1 = { { 0x61b274a0ea0b0ULL, 0x0d5a5fc8f189dULL,
+	0x7ef5e9cbd0c60ULL, 0x78595a6804c9eULL, 0x2b8324804fc1dULL } };
+
+static const struct ge ge_base = {
+	{ { 0x62d608f25d51aULL, 0x412a4b4f6592aULL, 0x75b7171a4b31dULL,
+	    0x1ff60527118feULL, 0x216936d3cd6e5ULL } },
+	{ { 0x6666666666658ULL, 0x4ccccccccccccULL, 0x1999999999999ULL,
+	    0x3333333333333ULL, 0x6666666666666ULL } },
+	{ { 1, 0, 0, 0, 0 } },
+	{ { 0x68ab3a5b7dda3ULL, 0x00eea2a5eadbbULL, 0x2af8df483c27eULL,
+	    0x332b375274732ULL, 0x67875f0fd78b7ULL } },
+};
+
+/* the group order, 2^252 + 27742317777372353535851937790883648493 */
+static const u8 ed25519_order[32] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+	0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10,
+};
+
+/* the key, decoded and negated once when it is loaded */
+static struct {
+	int loaded;
+	u8 pk[ED25519_KEY_SIZE];
+	u8 keyid[ED25519_KEYID_SIZE];
+	struct ge minus_a;
+	struct ge base_minus_a;		/* B - A */
+} ed25519_key;
+
+/******************************************************************************
+                             Field arithmetic
+******************************************************************************/
+
+static inline void fe_carry(fe *h)
+{
+	u64 c;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		c = h->v[i] >> 51;
+		h->v[i] &= MASK51;
+		h->v[i + 1] += c;
+	}
+	c = h->v[4] >> 51;
+	h->v[4] &= MASK51;
+	h->v[0] += 19 * c;
+}
+
+static void fe_add(fe *h, const fe *f, const fe *g)
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		h->v[i] = f->v[i] + g->v[i];
+	fe_carry(h);
+}
+
+/* f - g, with 4p added first so that no limb goes negative */
+static void fe_sub(fe *h, const fe *f, const fe *g)
+{
+	h->v[0] = f->v[0] + 0x1fffffffffffb4ULL - g->v[0];
+	h->v[1] = f->v[1] + 0x1ffffffffffffcULL - g->v[1];
+	h->v[2] = f->v[2] + 0x1ffffffffffffcULL - g->v[2];
+	h->v[3] = f->v[3] + 0x1ffffffffffffcULL - g->v[3];
+	h->v[4] = f->v[4] + 0x1ffffffffffffcULL - g->v[4];
+	fe_carry(h);
+}
+
+static void fe_neg(fe *h, const fe *f)
+{
+	static const fe zero;
+
+	fe_sub(h, &zero, f);
+}
+
+static void fe_mul(fe *h, const fe *f, const fe *g)
+{
+	const u64 *a = f->v, *b = g->v;
+	u64 b1 = 19 * b[1], b2 = 19 * b[2], b3 = 19 * b[3], b4 = 19 * b[4];
+	u128 r0, r1, r2, r3, r4;
+	u64 c;
+
+	r0 = (u128)a[0] * b[0] + (u128)a[1] * b4 + (u128)a[2] * b3 +
+	     (u128)a[3] * b2 + (u128)a[4] * b1;
+	r1 = (u128)a[0] * b[1] + (u128)a[1] * b[0] + (u128)a[2] * b4 +
+	     (u128)a[3] * b3 + (u128)a[4] * b2;
+	r2 = (u128)a[0] * b[2] + (u128)a[1] * b[1] + (u128)a[2] * b[0] +
+	     (u128)a[3] * b4 + (u128)a[4] * b3;
+	r3 = (u128)a[0] * b[3] + (u128)a[1] * b[2] + (u128)a[2] * b[1] +
+	     (u128)a[3] * b[0] + (u128)a[4] * b4;
+	r4 = (u128)a[0] * b[4] + (u128)a[1] * b[3] + (u128)a[2] * b[2] +
+	     (u128)a[3] * b[1] + (u128)a[4] * b[0];
+
+	r1 += (u64)(r0 >> 51);
+	h->v[0] = (u64)r0 & MASK51;
+	r2 += (u64)(r1 >> 51);
+	h->v[1] = (u64)r1 & MASK51;
+	r3 += (u64)(r2 >> 51);
+	h->v[2] = (u64)r2 & MASK51;
+	r4 += (u64)(r3 >> 51);
+	h->v[3] = (u64)r3 & MASK51;
+	c = (u64)(r4 >> 51);
+	h->v[4] = (u64)r4 & MASK51;
+	r0 = (u128)c * 19 + h->v[0];
+	h->v[0] = (u64)r0 & MASK51;
+	h->v[1] += (u64)(r0 >> 51);
+}
+
+static inline void fe_sq(fe *h, const fe *f)
+{
+	fe_mul(h, f, f);
+}
+
+static void fe_sqn(fe *h, const fe *f, int n)
+{
+	fe_sq(h, f);
+	while (--n)
+		fe_sq(h, h);
+}
+
+static void fe_frombytes(fe *h, const u8 *s)
+{
+	h->v[0] = get_unaligned_le64(s) & MASK51;
+	h->v[1] = (get_unaligned_le64(s + 6) >> 3) & MASK51;
+	h->v[2] = (get_unaligned_le64(s + 12) >> 6) & MASK51;
+	h->v[3] = (get_unaligned_le64(s + 19) >> 1) & MASK51;
+	h->v[4] = (get_unaligned_le64(s + 24) >> 12) & MASK51;
+}
+
+/* the canonical encoding: fully reduced modulo p */
+static void fe_tobytes(u8 *s, const fe *f)
+{
+	fe h = *f;
+	u64 q;
+	int i;
+
+	fe_carry(&h);
+	fe_carry(&h);
+
+	/* q is 1 if h >= p, 0 otherwise */
+	q = (h.v[0] + 19) >> 51;
+	for (i = 1; i < 5; i++)
+		q = (h.v[i] + q) >> 51;
+
+	h.v[0] += 19 * q;
+	for (i = 0; i < 4; i++) {
+		h.v[i + 1] += h.v[i] >> 51;
+		h.v[i] &= MASK51;
+	}
+	h.v[4] &= MASK51;
+
+	put_unaligned_le64(h.v[0] | h.v[1] << 51, s);
+	put_unaligned_le64(h.v[1] >> 13 | h.v[2] << 38, s + 8);
+	put_unaligned_le64(h.v[2] >> 26 | h.v[3] << 25, s + 16);
+	put_unaligned_le64(h.v[3] >> 39 | h.v[4] << 12, s + 24);
+}
+
+static int fe_isnonzero(const fe *f)
+{
+	static const u8 zero[32];
+	u8 s[32];
+
+	fe_tobytes(s, f);
+	return memcmp(s, zero, sizeof(s)) != 0;
+}
+
+static int fe_isnegative(const fe *f)
+{
+	u8 s[32];
+
+	fe_tobytes(s, f);
+	return s[0] & 1;
+}
+
+/* z^(2^250 - 1), and z^11 on the way, shared by fe_invert and fe_pow22523 */
+static void fe_pow2250m1(fe *out, fe *z11, const fe *z)
+{
+	fe z2, z9, z_5_0, z_10_0, z_20_0, z_50_0, z_100_0, t;
+
+	fe_sq(&z2, z);
+	fe_sqn(&t, &z2, 2);
+	fe_mul(&z9, &t, z);
+	fe_mul(z11, &z9, &z2);
+	fe_sq(&t, z11);
+	fe_mul(&z_5_0, &t, &z9);		/* 2^5 - 1 */
+	fe_sqn(&t, &z_5_0, 5);
+	fe_mul(&z_10_0, &t, &z_5_0);		/* 2^10 - 1 */
+	fe_sqn(&t, &z_10_0, 10);
+	fe_mul(&z_20_0, &t, &z_10_0);		/* 2^20 - 1 */
+	fe_sqn(&t, &z_20_0, 20);
+	fe_mul(&t, &t, &z_20_0);		/* 2^40 - 1 */
+	fe_sqn(&t, &t, 10);
+	fe_mul(&z_50_0, &t, &z_10_0);		/* 2^50 - 1 */
+	fe_sqn(&t, &z_50_0, 50);
+	fe_mul(&z_100_0, &t, &z_50_0);		/* 2^100 - 1 */
+	fe_sqn(&t, &z_100_0, 100);
+	fe_mul(&t, &t, &z_100_0);		/* 2^200 - 1 */
+	fe_sqn(&t, &t, 50);
+	fe_mul(out, &t, &z_50_0);		/* 2^250 - 1 */
+}
+
+/* z^(p - 2) = z^(2^255 - 21) */
+static void fe_invert(fe *out, const fe *z)
+{
+	fe t, z11;
+
+	fe_pow2250m1(&t, &z11, z);
+	fe_sqn(&t, &t, 5);
+	fe_mul(out, &t, &z11);
+}
+
+/* z^((p - 5) / 8) = z^(2^252 - 3) */
+static void fe_pow22523(fe *out, const fe *z)
+{
+	fe t, z11;
+
+	fe_pow2250m1(&t, &z11, z);
+	fe_sqn(&t, &t, 2);
+	fe_mul(out, &t, z);
+}
+
+/******************************************************************************
+                             Group operations
+******************************************************************************/
+
+static void ge_identity(struct ge *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->Y.v[0] = 1;
+	p->Z.v[0] = 1;
+}
+
+/* r = p + q, "add-2008-hwcd-3"; r may alias p or q */
+static void ge_add(struct ge *r, const struct ge *p, const struct ge *q)
+{
+	fe a, b, c, d, e, f, g, h, t;
+
+	fe_sub(&a, &p->Y, &p->X);
+	fe_sub(&t, &q->Y, &q->X);
+	fe_mul(&a, &a, &t);
+	fe_add(&b, &p->Y, &p->X);
+	fe_add(&t, &q->Y, &q->X);
+	fe_mul(&b, &b, &t);
+	fe_mul(&c, &p->T, &q->T);
+	fe_mul(&c, &c, &fe_d2);
+	fe_mul(&d, &p->Z, &q->Z);
+	fe_add(&d, &d, &d);
+	fe_sub(&e, &b, &a);
+	fe_sub(&f, &d, &c);
+	fe_add(&g, &d, &c);
+	fe_add(&h, &b, &a);
+	fe_mul(&r->X, &e, &f);
+	fe_mul(&r->Y, &g, &h);
+	fe_mul(&r->T, &e, &h);
+	fe_mul(&r->Z, &f, &g);
+}
+
+/* r = 2p, "dbl-2008-hwcd" with a = -1; r may alias p */
+static void ge_double(struct ge *r, const struct ge *p)
+{
+	fe a, b, c, e, f, g, h;
+
+	fe_sq(&a, &p->X);
+	fe_sq(&b, &p->Y);
+	fe_sq(&c, &p->Z);
+	fe_add(&c, &c, &c);
+	fe_add(&e, &p->X, &p->Y);
+	fe_sq(&e, &e);
+	fe_sub(&e, &e, &a);
+	fe_sub(&e, &e, &b);
+	fe_sub(&g, &b, &a);		/* -A + B */
+	fe_sub(&f, &g, &c);
+	fe_neg(&h, &a);
+	fe_sub(&h, &h, &b);		/* -A - B */
+	fe_mul(&r->X, &e, &f);
+	fe_mul(&r->Y, &g, &h);
+	fe_mul(&r->T, &e, &h);
+	fe_mul(&r->Z, &f, &g);
+}
+
+static void ge_tobytes(u8 *s, const struct ge *p)
+{
+	fe recip, x, y;
+
+	fe_invert(&recip, &p->Z);
+	fe_mul(&x, &p->X, &recip);
+	fe_mul(&y, &p->Y, &recip);
+	fe_tobytes(s, &y);
+	s[31] |= fe_isnegative(&x) << 7;
+}
+
+/* RFC 8032 5.1.3, returns -EINVAL if s is not the encoding of a point */
+static int ge_frombytes(struct ge *p, const u8 *s)
+{
+	fe u, v, v3, vxx, check;
+	u8 canon[32];
+
+	fe_frombytes(&p->Y, s);
+	fe_tobytes(canon, &p->Y);
+	canon[31] |= s[31] & 0x80;
+	if (memcmp(canon, s, sizeof(canon)))
+		return -EINVAL;		/* y >= p */
+
+	memset(&p->Z, 0, sizeof(p->Z));
+	p->Z.v[0] = 1;
+
+	/* x^2 = u / v, u = y^2 - 1, v = d y^2 + 1 */
+	fe_sq(&u, &p->Y);
+	fe_mul(&v, &u, &fe_d);
+	fe_sub(&u, &u, &p->Z);
+	fe_add(&v, &v, &p->Z);
+
+	/* x = u v^3 (u v^7)^((p - 5) / 8) */
+	fe_sq(&v3, &v);
+	fe_mul(&v3, &v3, &v);
+	fe_sq(&p->X, &v3);
+	fe_mul(&p->X, &p->X, &v);
+	fe_mul(&p->X, &p->X, &u);
+	fe_pow22523(&p->X, &p->X);
+	fe_mul(&p->X, &p->X, &v3);
+	fe_mul(&p->X, &p->X, &u);
+
+	fe_sq(&vxx, &p->X);
+	fe_mul(&vxx, &vxx, &v);
+	fe_sub(&check, &vxx, &u);
+	if (fe_isnonzero(&check)) {
+		fe_add(&check, &vxx, &u);
+		if (fe_isnonzero(&check))
+			return -EINVAL;
+		fe_mul(&p->X, &p->X, &fe_sqrtm1);
+	}
+
+	if (!fe_isnonzero(&p->X) && (s[31] >> 7))
+		return -EINVAL;
+	if (fe_isnegative(&p->X) != (s[31] >> 7))
+		fe_neg(&p->X, &p->X);
+
+	fe_mul(&p->T, &p->X, &p->Y);
+	return 0;
+}
+
+/******************************************************************************
+                             Scalars
+******************************************************************************/
+
+/* is the little endian s smaller than the group order? */
+static int sc_is_canonical(const u8 *s)
+{
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		if (s[i] < ed25519_order[i])
+			return 1;
+		if (s[i] > ed25519_order[i])
+			return 0;
+	}
+	return 0;
+}
+
+/* r = x mod L, x being 64 little endian bytes, one per element */
+static void sc_reduce(u8 *r, s64 x[64])
+{
+	s64 carry;
+	int i, j;
+
+	for (i = 63; i >= 32; --i) {
+		carry = 0;
+		for (j = i - 32; j < i - 12; ++j) {
+			x[j] += carry - 16 * x[i] * ed25519_order[j - (i - 32)];
+			carry = (x[j] + 128) >> 8;
+			x[j] -= carry * 256;
+		}
+		x[j] += carry;
+		x[i] = 0;
+	}
+	carry = 0;
+	for (j = 0; j < 32; ++j) {
+		x[j] += carry - (x[31] >> 4) * ed25519_order[j];
+		carry = x[j] >> 8;
+		x[j] &= 255;
+	}
+	for (j = 0; j < 32; ++j)
+		x[j] -= carry * ed25519_order[j];
+	for (i = 0; i < 32; ++i) {
+		x[i + 1] += x[i] >> 8;
+		r[i] = x[i] & 255;
+	}
+}
+
+/*
+ * r = [s]B - [k]A, both scalars at once (Straus): one doubling per bit
+ * and at most one addition, of B, -A or B - A.
+ */
+static void ge_double_scalarmult(struct ge *r, const u8 *s, const u8 *k)
+{
+	int i, bs, bk;
+
+	ge_identity(r);
+	for (i = 255; i >= 0; i--) {
+		ge_double(r, r);
+		bs = (s[i >> 3] >> (i & 7)) & 1;
+		bk = (k[i >> 3] >> (i & 7)) & 1;
+		if (bs && bk)
+			ge_add(r, r, &ed25519_key.base_minus_a);
+		else if (bs)
+			ge_add(r, r, &ge_base);
+		else if (bk)
+			ge_add(r, r, &ed25519_key.minus_a);
+	}
+}
+
+/******************************************************************************
+Description : Load the Ed25519 public key.  The key is decoded and the
+	points the verifications need are computed here, once.
+Parameters  :
+	@pk: the 32 byte encoded public key
+	@keyid: its key ID, as carried by the signatures made with it
+Return value: 0 on success, -EINVAL if pk does not encode a point,
+	-EPERM if a key was already loaded
+******************************************************************************/
+int digsig_ed25519_set_key(const u8 *pk, const u8 *keyid)
+{
+	struct ge a;
+
+	if (ed25519_key.loaded)
+		return -EPERM;
+	if (ge_frombytes(&a, pk))
+		return -EINVAL;
+
+	memcpy(ed25519_key.pk, pk, ED25519_KEY_SIZE);
+	memcpy(ed25519_key.keyid, keyid, ED25519_KEYID_SIZE);
+	ed25519_key.minus_a = a;
+	fe_neg(&ed25519_key.minus_a.X, &a.X);
+	fe_neg(&ed25519_key.minus_a.T, &a.T);
+	ge_add(&ed25519_key.base_minus_a, &ge_base, &ed25519_key.minus_a);
+
+	/* verifiers read the key locklessly once loaded is seen */
+	smp_wmb();
+	ed25519_key.loaded = 1;
+	return 0;
+}
+
+/* the key ID of the loaded key, or NULL */
+const u8 *digsig_ed25519_keyid(void)
+{
+	if (!ed25519_key.loaded)
+		return NULL;
+	smp_rmb();
+	return ed25519_key.keyid;
+}
+
+/*
+ * The loaded key, or NULL.  Signatures that do not name its key ID are
+ * rejected before any curve arithmetic.
+ */
+const u8 *digsig_ed25519_key(const u8 *keyid)
+{
+	if (!ACCESS_ONCE(ed25519_key.loaded))
+		return NULL;
+	smp_rmb();
+	if (keyid && memcmp(keyid, ed25519_key.keyid, ED25519_KEYID_SIZE))
+		return NULL;
+	return ed25519_key.pk;
+}
+
+/******************************************************************************
+Description : Verify an Ed25519 signature with the loaded key.
+Parameters  :
+	@sig: the 64 byte signature, R || S
+	@hram: SHA-512(R || A || M), computed by the caller, which owns the
+	       hash descriptors
+Return value: 0 if the signature is valid, -EPERM if it is not, -ENOKEY
+	if no key is loaded
+******************************************************************************/
+int digsig_ed25519_verify(const u8 *sig, const u8 *hram)
+{
+	s64 x[64];
+	u8 k[32], check[32];
+	struct ge r;
+	int i;
+
+	if (!digsig_ed25519_key(NULL))
+		return -ENOKEY;
+	if (!sc_is_canonical(sig + 32))
+		return -EPERM;
+
+	for (i = 0; i < 64; i++)
+		x[i] = hram[i];
+	sc_reduce(k, x);
+
+	ge_double_scalarmult(&r, sig + 32, k);
+	ge_tobytes(check, &r);
+
+	return memcmp(check, sig, sizeof(check)) ? -EPERM : 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the Ed25519 signature verification.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_ED25519_H
+#define _DIGSIG_ED25519_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+#define ED25519_KEY_SIZE	32
+#define ED25519_SIG_SIZE	64
+#define ED25519_KEYID_SIZE	8
+
+#ifdef CONFIG_SECURITY_DIGSIG_ED25519
+int digsig_ed25519_set_key(const u8 *pk, const u8 *keyid);
+const u8 *digsig_ed25519_key(const u8 *keyid);
+const u8 *digsig_ed25519_keyid(void);
+int digsig_ed25519_verify(const u8 *sig, const u8 *hram);
+#else
+#define digsig_ed25519_set_key(pk, keyid) (-EINVAL)
+#define digsig_ed25519_key(keyid) ((const u8 *)NULL)
+#define digsig_ed25519_keyid() ((const u8 *)NULL)
+#define digsig_ed25519_verify(sig, hram) (-ENOKEY)
+#endif
+
+#endif /* _DIGSIG_ED25519_H */
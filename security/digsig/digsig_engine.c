@@ -0,0 +1,231 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file lets the RSA engine of the verifications be chosen at run
+ * time, to compare a new one against the one in use on the same hosts
+ * and the same signatures before rolling it out.  The engines are the
+ * Montgomery arithmetic, with the constants precomputed per key, which
+ * is the default, and the plain mpi_powm() that rsa_verify() used.
+ *
+ * /sys/kernel/security/digsig/engine takes:
+ *
+ *	<engine> [<percent>]	verify with <engine> that share of the
+ *				signatures, 100 if not given, the others
+ *				with the default engine
+ *	shadow | noshadow	also verify each signature with the engine
+ *				not picked, and compare the verdicts
+ *	reset			zero the counters
+ *
+ * Reading it gives one line per engine: its name, the share of the
+ * verifications it gets, and how many RSA operations it did, shadow
+ * ones included, with their total and longest time in nanoseconds;
+ * then the shadow mode, the verdicts compared and those that differed.
+ * A difference is also logged: whichever engine is wrong, it is a bug.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/random.h>
+#include <linux/atomic.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_engine.h"
+
+static const char *const digsig_engine_names[DIGSIG_ENGINES] = {
+	[DIGSIG_ENGINE_MONT] = "mont",
+	[DIGSIG_ENGINE_LEGACY] = "legacy",
+};
+
+struct digsig_engine_stat {
+	atomic64_t ops;
+	atomic64_t ns;
+	atomic64_t max_ns;
+};
+
+static struct digsig_engine_stat digsig_engine_stats[DIGSIG_ENGINES];
+
+/* the engine given a share of the verifications, and the share */
+static int digsig_engine_candidate = DIGSIG_ENGINE_MONT;
+static int digsig_engine_percent;
+static int digsig_engine_shadow;
+static atomic64_t digsig_engine_compared = ATOMIC64_INIT(0);
+static atomic64_t digsig_engine_mismatched = ATOMIC64_INIT(0);
+
+/******************************************************************************
+Description : Pick the engine of a verification.
+Parameters  : none
+Return value: one of DIGSIG_ENGINE_*
+******************************************************************************/
+int digsig_engine_pick(void)
+{
+	int percent = ACCESS_ONCE(digsig_engine_percent);
+
+	if (percent >= 100 || (percent > 0 && prandom_u32() % 100 < percent))
+		return ACCESS_ONCE(digsig_engine_candidate);
+	return DIGSIG_ENGINE_MONT;
+}
+
+/* Is each signature verified with both engines? */
+int digsig_engine_shadowing(void)
+{
+	return ACCESS_ONCE(digsig_engine_shadow);
+}
+
+u64 digsig_engine_start(void)
+{
+	return local_clock();
+}
+
+/******************************************************************************
+Description : Count an RSA operation of an engine.
+Parameters  :
+	@engine: the engine
+	@start: digsig_engine_start() before the operation
+Return value: none
+******************************************************************************/
+void digsig_engine_account(int engine, u64 start)
+{
+	struct digsig_engine_stat *s = &digsig_engine_stats[engine];
+	s64 ns = local_clock() - start, max;
+
+	atomic64_inc(&s->ops);
+	atomic64_add(ns, &s->ns);
+	for (max = atomic64_read(&s->max_ns); ns > max;
+	     max = atomic64_read(&s->max_ns))
+		if (atomic64_cmpxchg(&s->max_ns, max, ns) == max)
+			break;
+}
+
+/******************************************************************************
+Description : Compare the verdict of a signature with that of the shadow
+	engine on it.
+Parameters  :
+	@engine: the engine whose verdict stands
+	@verdict, @shadow_verdict: 0 for valid, negative otherwise
+Return value: none
+******************************************************************************/
+void digsig_engine_compare(int engine, int verdict, int shadow_verdict)
+{
+	atomic64_inc(&digsig_engine_compared);
+	if (!verdict == !shadow_verdict)
+		return;
+	atomic64_inc(&digsig_engine_mismatched);
+	DSM_ERROR("%s: engine %s found the signature %s, the other %s\n",
+		  __func__, digsig_engine_names[engine],
+		  verdict ? "invalid" : "valid",
+		  shadow_verdict ? "invalid" : "valid");
+}
+
+static int digsig_engine_show(struct seq_file *m, void *v)
+{
+	struct digsig_engine_stat *s;
+	int i, share, percent = ACCESS_ONCE(digsig_engine_percent);
+	int candidate = ACCESS_ONCE(digsig_engine_candidate);
+
+	seq_puts(m, "# engine\tshare\tops\tns\tmax_ns\n");
+	for (i = 0; i < DIGSIG_ENGINES; i++) {
+		s = &digsig_engine_stats[i];
+		/* the share is 0 while the candidate is the default */
+		share = i == DIGSIG_ENGINE_MONT ? 100 - percent :
+			i == candidate ? percent : 0;
+		seq_printf(m, "%s\t%d\t%lld\t%lld\t%lld\n",
+			   digsig_engine_names[i], share,
+			   (long long)atomic64_read(&s->ops),
+			   (long long)atomic64_read(&s->ns),
+			   (long long)atomic64_read(&s->max_ns));
+	}
+	seq_printf(m, "shadow\t%s\t%lld\t%lld\n",
+		   digsig_engine_shadowing() ? "on" : "off",
+		   (long long)atomic64_read(&digsig_engine_compared),
+		   (long long)atomic64_read(&digsig_engine_mismatched));
+	return 0;
+}
+
+static int digsig_engine_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_engine_show, NULL);
+}
+
+static ssize_t digsig_engine_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	char kbuf[32], *line, *name;
+	size_t len = min(count, sizeof(kbuf) - 1);
+	int i, percent = 100;
+
+	if (copy_from_user(kbuf, buf, len))
+		return -EFAULT;
+	kbuf[len] = '\0';
+	line = strim(kbuf);
+	name = strsep(&line, " \t");
+
+	if (!strcmp(name, "shadow") || !strcmp(name, "noshadow")) {
+		ACCESS_ONCE(digsig_engine_shadow) = name[0] == 's';
+		return count;
+	}
+	if (!strcmp(name, "reset")) {
+		for (i = 0; i < DIGSIG_ENGINES; i++) {
+			atomic64_set(&digsig_engine_stats[i].ops, 0);
+			atomic64_set(&digsig_engine_stats[i].ns, 0);
+			atomic64_set(&digsig_engine_stats[i].max_ns, 0);
+		}
+		atomic64_set(&digsig_engine_compared, 0);
+		atomic64_set(&digsig_engine_mismatched, 0);
+		return count;
+	}
+
+	for (i = 0; i < DIGSIG_ENGINES; i++)
+		if (!strcmp(name, digsig_engine_names[i]))
+			break;
+	if (i == DIGSIG_ENGINES)
+		return -EINVAL;
+	if (line && (kstrtoint(skip_spaces(line), 10, &percent) ||
+		     percent < 0 || percent > 100))
+		return -EINVAL;
+
+	/* a share of the default engine is the whole of it */
+	ACCESS_ONCE(digsig_engine_percent) = 0;
+	smp_wmb();
+	ACCESS_ONCE(digsig_engine_candidate) = i;
+	smp_wmb();
+	ACCESS_ONCE(digsig_engine_percent) =
+		i == DIGSIG_ENGINE_MONT ? 0 : percent;
+	return count;
+}
+
+static const struct file_operations digsig_engine_fops = {
+	.open = digsig_engine_open,
+	.read = seq_read,
+	.write = digsig_engine_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/engine.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_engine(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("engine", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_engine_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
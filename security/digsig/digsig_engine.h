@@ -0,0 +1,40 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the selection of the RSA engines and their
+ * counters.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_ENGINE_H
+#define _DIGSIG_ENGINE_H
+
+#include <linux/types.h>
+
+/* how s^e mod n is computed */
+#define DIGSIG_ENGINE_MONT 0	/* Montgomery, with the key's constants */
+#define DIGSIG_ENGINE_LEGACY 1	/* mpi_powm(), as rsa_verify() did */
+#define DIGSIG_ENGINES 2
+
+#ifdef CONFIG_SECURITY_DIGSIG_ENGINES
+int digsig_engine_pick(void);
+int digsig_engine_shadowing(void);
+u64 digsig_engine_start(void);
+void digsig_engine_account(int engine, u64 start);
+void digsig_engine_compare(int engine, int verdict, int shadow_verdict);
+int digsig_init_engine(void);
+#else
+#define digsig_engine_pick() DIGSIG_ENGINE_MONT
+#define digsig_engine_shadowing() 0
+static inline u64 digsig_engine_start(void) { return 0; }
+static inline void digsig_engine_account(int engine, u64 start) { }
+#define digsig_engine_compare(engine, verdict, shadow_verdict) do { } while (0)
+#define digsig_init_engine() 0
+#endif
+
+#endif /* _DIGSIG_ENGINE_H */
@@ -0,0 +1,360 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file finds the signature of an ELF file and parses it.  It uses
+ * no kernel service but the DSM_* messages: the file is read through
+ * the callback of the caller, and the headers are in its buffers.
+ * tools/digsig builds this file as it is into userspace, to profile and
+ * fuzz the parsers on real binaries.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/elf.h>
+
+#include "digsig_common.h"
+#include "digsig_format.h"
+
+int gDigestLength[] = { /* SHA-1 */ 0x14, /* SHA-256 */ 0x20, /* SHA-512 */ 0x40,
+			/* BLAKE2b-512 */ 0x40 };
+
+/*
+ * GPG has no number for BLAKE2b, so its packets carry the first of the
+ * private/experimental ones (RFC 4880, 9.4).
+ */
+#define DIGSIG_PGP_BLAKE2B 100
+
+/* how bsign greets each hash algorithm, and how GPG numbers it */
+static const struct {
+	const char *greeting;
+	int pgp_algo;
+} digsig_bsign_algos[DIGSIG_HASH_ALGOS] = {
+	[HASH_SHA1] = { DIGSIG_BSIGN_STRING, 2 },
+	[HASH_SHA256] = { DIGSIG_BSIGN_SHA256_STRING, 8 },
+	[HASH_SHA512] = { DIGSIG_BSIGN_SHA512_STRING, 10 },
+	[HASH_BLAKE2B] = { DIGSIG_BSIGN_BLAKE2B_STRING, DIGSIG_PGP_BLAKE2B },
+};
+
+/* the bsign greeting of a hash algorithm, DIGSIG_BSIGN_GREET_SIZE long */
+const char *digsig_bsign_greeting(int algo)
+{
+	return digsig_bsign_algos[algo].greeting;
+}
+
+/* the GPG number of a hash algorithm */
+int digsig_pgp_hash_algo(int algo)
+{
+	return digsig_bsign_algos[algo].pgp_algo;
+}
+
+/******************************************************************************
+Description : Find the hash algorithm and the GPG packet of a signature.
+	Greetings other than the SHA-256, SHA-512 and BLAKE2b ones are taken
+	as SHA-1, as bsign signatures always were.  Sections of
+	DIGSIG_ED25519_SIG_SIZE bytes hold an Ed25519 signature instead.
+Parameters  :
+  sig the bytes of a signature section
+  size the size of the section
+  info filled with the layout of the signature
+Return value: 0 on success, -EINVAL if the signature is inconsistent
+******************************************************************************/
+int digsig_parse_signature(char *sig, int size, struct digsig_sig_info *info)
+{
+	int algo, infos;
+
+	if (size == DIGSIG_ED25519_SIG_SIZE) {
+		if (IS_ENABLED(CONFIG_SECURITY_DIGSIG_ONLY_RSA2048_SHA256) ||
+		    memcmp(sig, DIGSIG_BSIGN_ED25519_STRING, 3))
+			return -EINVAL;
+		info->hashalgo = HASH_SHA256;
+		info->signalgo = SIGN_ED25519;
+		info->packet = (unsigned char *)sig + DIGSIG_BSIGN_GREET_SIZE;
+		info->packet_len = size - DIGSIG_BSIGN_GREET_SIZE;
+		return 0;
+	}
+	if (size != DIGSIG_ELF_SIG_SIZE)
+		return -EINVAL;
+
+	info->signalgo = SIGN_RSA;
+	info->hashalgo = HASH_SHA1;
+	for (algo = HASH_SHA256; algo < DIGSIG_HASH_ALGOS; algo++)
+		if (!memcmp(sig, digsig_bsign_algos[algo].greeting, 3))
+			info->hashalgo = algo;
+	if (IS_ENABLED(CONFIG_SECURITY_DIGSIG_ONLY_RSA2048_SHA256) &&
+	    info->hashalgo != HASH_SHA256)
+		return -EINVAL;
+
+	infos = DIGSIG_BSIGN_GREET_SIZE + gDigestLength[info->hashalgo] +
+		DIGSIG_BSIGN_LEN_OFFSET;
+	info->packet = (unsigned char *)sig + infos;
+	info->packet_len = size - infos;
+
+	if (info->hashalgo != HASH_SHA1 &&
+	    info->packet[DIGSIG_RSA_DIGEST_ALGO_OFFSET] !=
+	    digsig_bsign_algos[info->hashalgo].pgp_algo) {
+		DSM_PRINT(DEBUG_SIGN, "%s: greeting and packet disagree on the hash\n",
+			  __func__);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* notes looked at in a PT_NOTE segment, at most */
+#define DIGSIG_NOTES_MAX 16
+
+/*
+ * Walk the notes of the segment at pos, len bytes long, for those of
+ * DigSig.  The note headers are the same in ELF32 and ELF64 files, the
+ * offsets are taken as the 64 bits of ELF64, and all end within loff_t.
+ */
+static void digsig_walk_notes(digsig_read_t read, void *src, u64 pos,
+			      u64 len, struct digsig_notes *notes)
+{
+	char name[sizeof(DIGSIG_NOTE_NAME)];
+	u64 end = pos + len, desc;
+	struct elf32_note nhdr;
+	int i;
+
+	if (end < pos || end > DIGSIG_POS_MAX)
+		return;
+	for (i = 0; i < DIGSIG_NOTES_MAX && end - pos >= sizeof(nhdr); i++) {
+		if (read(src, pos, (char *)&nhdr, sizeof(nhdr)) != sizeof(nhdr))
+			return;
+		desc = pos + sizeof(nhdr) + ALIGN((u64)nhdr.n_namesz, 4);
+		if (desc < pos || desc > end || nhdr.n_descsz > end - desc)
+			return;
+
+		if (nhdr.n_namesz == sizeof(name) &&
+		    read(src, pos + sizeof(nhdr), name,
+			 sizeof(name)) == sizeof(name) &&
+		    !memcmp(name, DIGSIG_NOTE_NAME, sizeof(name))) {
+			if ((nhdr.n_type == DIGSIG_NOTE_SIG ||
+			     nhdr.n_type == DIGSIG_NOTE_SEGMENTS) &&
+			    !notes->sig_size) {
+				notes->sig_offset = desc;
+				notes->sig_size = nhdr.n_descsz;
+				notes->segments =
+					nhdr.n_type == DIGSIG_NOTE_SEGMENTS;
+			} else if (nhdr.n_type == DIGSIG_NOTE_CHUNKS &&
+				   !notes->ch_size) {
+				notes->ch_offset = desc;
+				notes->ch_size = nhdr.n_descsz;
+			}
+		}
+		pos = desc + ALIGN((u64)nhdr.n_descsz, 4);
+		if (pos < desc)
+			return;
+	}
+}
+
+/*
+ * Do the sections found end within loff_t?  The offsets of an ELF64
+ * section header are 64 bits, of which one past LLONG_MAX comes out
+ * negative in the loff_t of found.
+ */
+static int digsig_notes_in_range(struct digsig_notes *found)
+{
+	return found->sig_size <= DIGSIG_POS_MAX &&
+	       found->ch_size <= DIGSIG_POS_MAX &&
+	       (u64)found->sig_offset <= DIGSIG_POS_MAX - found->sig_size &&
+	       (u64)found->ch_offset <= DIGSIG_POS_MAX - found->ch_size;
+}
+
+/*
+ * ELF32 and ELF64 files differ only in the types of their headers, so
+ * the header check and the section and note lookups are generated for
+ * both from one definition.
+ *
+ * elf_sanity_check##bits: basic verification of an ELF header, 0 if
+ * the header is ok, -2 if the file is not ELF, -1 otherwise.  A file
+ * without a section table may still be signed in a note.
+ *
+ * digsig_scan_sections##bits: find the last signature, segment
+ * signature and chunk sections, reading the section table into the
+ * buffer of the caller a window at a time, so that a table of any size
+ * takes no more memory.  Extended section numbering, where e_shnum is 0
+ * and the first entry holds the count, is followed.  The table is
+ * walked from its end, as signers append their sections to the file,
+ * so a signed binary is usually found in the first window however many
+ * sections it has.  The DigSig types are all user ones, with the top bit
+ * set, which the other sections of a binary do not have: the sh_type of
+ * four entries are or-ed and tested at once, and only an entry of a user
+ * type is looked at on its own.
+ *
+ * digsig_find_notes##bits: find the DigSig notes from the program
+ * headers, read into the buffer of the caller; files with more program
+ * headers than fit there are looked up by section.
+ */
+#define DIGSIG_ELF_FUNCS(bits)						\
+static inline int elf_sanity_check##bits(struct elf##bits##_hdr *elf_hdr) \
+{									\
+	if (memcmp(elf_hdr->e_ident, ELFMAG, SELFMAG) != 0) {		\
+		DSM_PRINT(DEBUG_SIGN, "%s: Binary is not elf format\n",	\
+			  __func__);					\
+		return -2;						\
+	}								\
+									\
+	if (!elf_hdr->e_shoff && !elf_hdr->e_phoff) {			\
+		DSM_ERROR("%s: No section header!\n", __func__);	\
+		return -1;						\
+	}								\
+									\
+	if (elf_hdr->e_shoff &&					\
+	    elf_hdr->e_shentsize != sizeof(Elf##bits##_Shdr)) {	\
+		DSM_ERROR("%s: Section header is wrong size!\n", __func__); \
+		return -1;						\
+	}								\
+									\
+	return 0;							\
+}									\
+									\
+static int digsig_scan_sections##bits(digsig_read_t read, void *src,	\
+				     struct elf##bits##_hdr *elf_ex,	\
+				     void *buf, unsigned long buf_size,	\
+				     struct digsig_notes *found)	\
+{									\
+	Elf##bits##_Shdr *shdr = buf;					\
+	unsigned long per = buf_size / sizeof(*shdr), n, len;		\
+	u64 shnum = elf_ex->e_shnum, start, max;			\
+	int sig = 0, segsig = 0, i;					\
+									\
+	memset(found, 0, sizeof(*found));				\
+	if (!elf_ex->e_shoff || !per)					\
+		return 0;						\
+	if (!shnum) {							\
+		len = sizeof(*shdr);					\
+		if (read(src, elf_ex->e_shoff, buf, len) != len)	\
+			return -1;					\
+		shnum = shdr[0].sh_size;				\
+	}								\
+	/* the end of the table must be a file position */		\
+	max = DIGSIG_POS_MAX - elf_ex->e_shoff;				\
+	if (shnum > max / sizeof(*shdr))				\
+		return -1;						\
+									\
+	for (start = shnum; start && !(sig && found->ch_size); ) {	\
+		n = start < per ? start : per;				\
+		start -= n;						\
+		len = n * sizeof(*shdr);				\
+		if (read(src, elf_ex->e_shoff + start * sizeof(*shdr),	\
+			 buf, len) != len)				\
+			return -1;					\
+		for (i = n - 1; i >= 0; i--) {				\
+			/* four entries at once, until a user type */	\
+			while (i >= 3 &&				\
+			       !((shdr[i].sh_type | shdr[i - 1].sh_type | \
+				  shdr[i - 2].sh_type |			\
+				  shdr[i - 3].sh_type) & SHT_LOUSER))	\
+				i -= 4;					\
+			if (i < 0)					\
+				break;					\
+			switch (shdr[i].sh_type) {			\
+			case DIGSIG_ELF_SIG_SECTION:			\
+				if (sig++)				\
+					break;				\
+				found->sig_offset = shdr[i].sh_offset;	\
+				found->sig_size = shdr[i].sh_size;	\
+				found->segments = 0;			\
+				break;					\
+			case DIGSIG_ELF_SEGSIG_SECTION:			\
+				if (sig || segsig++)			\
+					break;				\
+				found->sig_offset = shdr[i].sh_offset;	\
+				found->sig_size = shdr[i].sh_size;	\
+				found->segments = 1;			\
+				break;					\
+			case DIGSIG_ELF_CHUNK_SECTION:			\
+				if (found->ch_size)			\
+					break;				\
+				found->ch_offset = shdr[i].sh_offset;	\
+				found->ch_size = shdr[i].sh_size;	\
+				break;					\
+			}						\
+		}							\
+	}								\
+	if (!sig && !segsig)						\
+		found->ch_offset = found->ch_size = 0;			\
+	if (!digsig_notes_in_range(found))				\
+		return -1;						\
+	return digsig_sig_size_ok(found->sig_size);			\
+}									\
+									\
+static void digsig_find_notes##bits(digsig_read_t read, void *src,	\
+				    struct elf##bits##_hdr *elf_ex,	\
+				    void *buf, unsigned long buf_size,	\
+				    struct digsig_notes *notes)		\
+{									\
+	Elf##bits##_Phdr *phdr = buf;					\
+	unsigned long size = elf_ex->e_phnum * sizeof(*phdr);		\
+	int i;								\
+									\
+	if (!elf_ex->e_phoff || elf_ex->e_phentsize != sizeof(*phdr) ||	\
+	    !size || size > buf_size)					\
+		return;							\
+	if (read(src, elf_ex->e_phoff, (char *)phdr, size) != size)	\
+		return;							\
+	for (i = 0; i < elf_ex->e_phnum; i++)				\
+		if (phdr[i].p_type == PT_NOTE)				\
+			digsig_walk_notes(read, src, phdr[i].p_offset,	\
+					  phdr[i].p_filesz, notes);	\
+}
+
+DIGSIG_ELF_FUNCS(32)
+DIGSIG_ELF_FUNCS(64)
+
+/*
+ * Check the ELF header of either class, as elf_sanity_check##bits: the
+ * header buffer must hold a struct elf64_hdr, of which an ELF32 header
+ * only uses the start.
+ */
+int digsig_elf_sanity_check(struct elf64_hdr *elf64_ex)
+{
+	if (elf64_ex->e_ident[EI_CLASS] == ELFCLASS32)
+		return elf_sanity_check32((struct elf32_hdr *) elf64_ex);
+	return elf_sanity_check64(elf64_ex);
+}
+
+/*
+ * Find the DigSig notes of the file, read as arch32 says, with phdr as
+ * room for the program headers: 1 if it has a signature note of a size
+ * we know, 0 if it is to be looked up by section.
+ */
+int digsig_find_notes(digsig_read_t read, void *src,
+		      struct elf64_hdr *elf64_ex, int arch32, void *phdr,
+		      unsigned long phdr_size, struct digsig_notes *notes)
+{
+	memset(notes, 0, sizeof(*notes));
+	if (arch32)
+		digsig_find_notes32(read, src, (struct elf32_hdr *) elf64_ex,
+				    phdr, phdr_size, notes);
+	else
+		digsig_find_notes64(read, src, elf64_ex, phdr, phdr_size,
+				    notes);
+	return digsig_sig_size_ok(notes->sig_size);
+}
+
+/*
+ * Find the signature section from the section header table, read as
+ * arch32 says with buf as the window it is read through, or the segment
+ * signature one: 1 if there is one of a size we know, with its place,
+ * and that of the last chunk section, in found; 0 if there is none; -1
+ * if the table can not be read.
+ */
+int digsig_scan_sections(digsig_read_t read, void *src,
+			 struct elf64_hdr *elf64_ex, int arch32, void *buf,
+			 unsigned long buf_size, struct digsig_notes *found)
+{
+	if (arch32)
+		return digsig_scan_sections32(read, src,
+					      (struct elf32_hdr *) elf64_ex,
+					      buf, buf_size, found);
+	return digsig_scan_sections64(read, src, elf64_ex, buf, buf_size,
+				      found);
+}
@@ -0,0 +1,271 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the layout of signed ELF files, of the signatures
+ * bsign writes, and of the chunk hash sections and manifests that go
+ * with them.  The parsing of the signatures only takes buffers and a
+ * read callback, so that tools/digsig builds it in userspace too, and
+ * signs files in these formats.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_FORMAT_H
+#define _DIGSIG_FORMAT_H
+
+#include <linux/types.h>
+#include <linux/elf.h>
+
+#include "digsig_ed25519.h"
+
+#define DIGSIG_ELF_SIG_SECTION 0x80736967	/* ((0x80 << 24)|('s' << 16)|('i' << 8)|'g') */
+#define DIGSIG_ELF_SIG_SIZE 512	/* Total signature size */
+#define DIGSIG_ED25519_SIG_SIZE (DIGSIG_BSIGN_GREET_SIZE + \
+				 ED25519_KEYID_SIZE + ED25519_SIG_SIZE)
+
+/*
+ * The signature may be carried instead in an ELF note, owner "DigSig",
+ * in a PT_NOTE segment: it is then found from the program headers, next
+ * to the ELF header, without reading the section table.  The note
+ * descriptor is the signature, of either format below, and is zeroed
+ * when the file is hashed as the section would be.
+ */
+#define DIGSIG_NOTE_NAME "DigSig"
+#define DIGSIG_NOTE_SIG 1
+
+/*
+ * Format of digital signature done by bsign:
+ * - "#1; bsign v%s\n"
+ * - hash of file with sig section zerod (crypto class and timestamp not added to hash)
+ * - length of digsig (2 bytes)
+ * - digsig
+ *
+ * The greeting selects the hash algorithm: "#1;" is SHA-1, as written by
+ * bsign, while "#2;", "#3;" and "#5;" are SHA-256, SHA-512 and
+ * BLAKE2b-512.  The file hash
+ * is as long as the algorithm's digest, so the offset of the digsig
+ * depends on it.
+ *
+ * Ed25519 signatures ("#4;") are a section of their own size:
+ * - "#4; bsign v%s\n"
+ * - key ID (8 bytes)
+ * - Ed25519 signature (64 bytes) of the greeting followed by the
+ *   SHA-256 hash of the file with the sig section zeroed
+ */
+
+#define DIGSIG_BSIGN_VERSION    "0.4.5"
+#define DIGSIG_BSIGN_STRING     "#1; bsign v" DIGSIG_BSIGN_VERSION "\n"
+#define DIGSIG_BSIGN_SHA256_STRING "#2; bsign v" DIGSIG_BSIGN_VERSION "\n"
+#define DIGSIG_BSIGN_SHA512_STRING "#3; bsign v" DIGSIG_BSIGN_VERSION "\n"
+#define DIGSIG_BSIGN_ED25519_STRING "#4; bsign v" DIGSIG_BSIGN_VERSION "\n"
+#define DIGSIG_BSIGN_BLAKE2B_STRING "#5; bsign v" DIGSIG_BSIGN_VERSION "\n"
+#define DIGSIG_BSIGN_GREET_SIZE (sizeof(DIGSIG_BSIGN_STRING) - 1)
+#define DIGSIG_BSIGN_HASH       20	/* sha1 hash */
+#define DIGSIG_BSIGN_LEN_OFFSET 2	/* length of digsig added by bsign */
+#define DIGSIG_BSIGN_INFOS      (DIGSIG_BSIGN_GREET_SIZE + DIGSIG_BSIGN_HASH+DIGSIG_BSIGN_LEN_OFFSET)
+
+/* GPG .sig file/section structure:
+ * 89     00 95 03          05      00    3F293CEB
+ * hdrlen       sig version md5 len class timestamp
+ *
+ * D39C2077 C307562E 01          02          29
+ * keyid[0] keyid[1] pubkey algo digest algo digest start[0]
+ *
+ * C2              03FF         Rest of .sig
+ * digest start[1] nbits of MPI MPI (as read by mpi_read)
+ */
+
+#define DIGSIG_RSA_CLASS_OFFSET     5
+#define DIGSIG_RSA_TIMESTAMP_OFFSET 6
+#define DIGSIG_RSA_KEYID_OFFSET     10
+#define DIGSIG_RSA_DIGEST_ALGO_OFFSET 19
+#define DIGSIG_RSA_DATA_OFFSET      22
+#define DIGSIG_KEYID_SIZE 8	/* the issuer key ID of the packet */
+
+#define DIGSIG_ELF_CHUNK_SECTION 0x80636873	/* ((0x80 << 24)|('c' << 16)|('h' << 8)|'s') */
+#define DIGSIG_NOTE_CHUNKS 2	/* the chunk hash section, as a DigSig note */
+#define DIGSIG_ELF_SEGSIG_SECTION 0x80736567	/* ((0x80 << 24)|('s' << 16)|('e' << 8)|'g') */
+#define DIGSIG_NOTE_SEGMENTS 3	/* the segment signature, as a DigSig note */
+
+/* ranges a segment signature covers, at most, once merged */
+#define DIGSIG_SEGMENTS_MAX 16
+/*
+ * the ranges are rounded out to this, the largest page size the ELF
+ * loaders map segments by, and cut at the end of the file
+ */
+#define DIGSIG_SEGMENTS_ALIGN 65536
+
+#define DIGSIG_CHUNK_MAGIC "DSCHUNK1"		/* SHA-256 chunk hashes */
+#define DIGSIG_CHUNK_MAGIC_BLAKE2B "DSCHUNK2"	/* BLAKE2b-256 ones */
+#define DIGSIG_CHUNK_HASH_SIZE 32
+#define DIGSIG_CHUNK_MIN_SHIFT 12
+#define DIGSIG_CHUNK_MAX_SHIFT 24
+#define DIGSIG_CHUNK_MAX_SECTION (4 << 20)
+
+/*
+ * Format of the chunk hash section:
+ * - struct digsig_chunk_hdr
+ * - nchunks SHA-256 hashes, or BLAKE2b-256 ones after the second magic,
+ *   one per chunk of 2^chunk_shift bytes of the file (the last one may
+ *   be short), each hashed with the signature and chunk hash sections
+ *   zeroed
+ *
+ * The signature section then signs the hash of the whole chunk hash
+ * section instead of the hash of the file, so the file is verified by
+ * checking the signature of this section once and the chunks against
+ * their hashes, in any order and on any CPU.
+ */
+struct digsig_chunk_hdr {
+	u8 magic[8];
+	__le32 chunk_shift;
+	__le32 nchunks;
+	__le64 file_size;
+} __packed;
+
+#define DIGSIG_MANIFEST_MAGIC "DSMANIF1"
+#define DIGSIG_MANIFEST_DIGEST_SIZE 32	/* SHA-256 */
+/* digests listed at once, from all manifests */
+#define DIGSIG_MANIFEST_MAX (1U << 22)
+
+/*
+ * Format of a manifest, written to /sys/digsig/manifest:
+ * - struct digsig_manifest_hdr
+ * - count digests, each the SHA-256 digest of a file as a "#2;"
+ *   signature signs it: with its signature section zeroed if it has
+ *   one, as it is otherwise
+ * - a signature section of sig_size bytes, in the format of the ELF
+ *   signature section, signing everything before it
+ */
+struct digsig_manifest_hdr {
+	u8 magic[8];
+	__le32 count;
+	__le32 sig_size;
+} __packed;
+
+#define DIGSIG_REVOKE_DB_MAGIC "DSREVDB1"
+#define DIGSIG_REVOKE_DB_DIGEST_SIZE 32	/* SHA-256 */
+#define DIGSIG_REVOKE_DB_MAX (1U << 22)
+#define DIGSIG_REVOKE_DB_BLOCK_SHIFT 9	/* bits per filter block, log2 */
+#define DIGSIG_REVOKE_DB_MAX_SHIFT 28	/* bits of the filter, log2 */
+#define DIGSIG_REVOKE_DB_PROBES 3
+
+/*
+ * Format of a revocation database, read whole when the key is loaded
+ * and used where it lies:
+ * - struct digsig_revoke_db_hdr, of 64 bytes
+ * - a Bloom filter of 2^bloom_shift bits, bit n of it in bit n % 8 of
+ *   byte n / 8.  A digest sets its bits in one block of
+ *   2^DIGSIG_REVOKE_DB_BLOCK_SHIFT bits, the block of the little-endian
+ *   word at byte 4 of the digest, modulo the number of blocks; its
+ *   DIGSIG_REVOKE_DB_PROBES bits in the block are the successive
+ *   DIGSIG_REVOKE_DB_BLOCK_SHIFT bit fields, lowest first, of the
+ *   little-endian word at byte 8
+ * - count digests, sorted and distinct, each the SHA-256 digest of the
+ *   magnitude of a revoked signature MPI, as in a bulk revocation list
+ * - a signature section of sig_size bytes, in the format of the ELF
+ *   signature section, signing everything before it
+ */
+struct digsig_revoke_db_hdr {
+	u8 magic[8];
+	__le32 count;
+	__le32 sig_size;
+	__le32 bloom_shift;
+	u8 reserved[44];	/* zero */
+} __packed;
+
+#define DIGSIG_BUNDLE_MAGIC "DSBNDL01"
+#define DIGSIG_BUNDLE_ALG_SIZE 16
+#define DIGSIG_BUNDLE_MAX_DIGEST 64
+/* inodes of one image, at most */
+#define DIGSIG_BUNDLE_MAX (1U << 22)
+
+/*
+ * Format of a verdict bundle, written to
+ * /sys/kernel/security/digsig/bundle:
+ * - struct digsig_bundle_hdr
+ * - the root digest of the dm-verity table of the image, digest_size
+ *   bytes
+ * - count little-endian 32-bit inode numbers, those of the files of the
+ *   image found valid
+ * - a signature section of sig_size bytes, in the format of the ELF
+ *   signature section, signing everything before it
+ */
+struct digsig_bundle_hdr {
+	u8 magic[8];
+	char alg[DIGSIG_BUNDLE_ALG_SIZE];	/* as in the table, NUL padded */
+	__le32 digest_size;
+	__le32 count;
+	__le32 sig_size;
+} __packed;
+
+/**
+ * Supported algorithms
+ */
+#define HASH_SHA1 0
+#define HASH_SHA256 1
+#define HASH_SHA512 2
+#define HASH_BLAKE2B 3
+#define DIGSIG_HASH_ALGOS 4
+#define DIGSIG_MAX_DIGEST_LENGTH 64
+#define SIGN_RSA 0
+#define SIGN_ED25519 1
+
+/*
+ * digsig_sig_info: where the parts of a signature section are, once its
+ * format is known.
+ */
+struct digsig_sig_info {
+	int hashalgo;
+	int signalgo;
+	unsigned char *packet;		/* the GPG signature packet, or the
+					   key ID and Ed25519 signature */
+	int packet_len;
+};
+
+/* the largest file position, the offsets found in a file are below */
+#define DIGSIG_POS_MAX (~0ULL >> 1)
+
+/* the section sizes of the signature formats we know */
+static inline int digsig_sig_size_ok(u64 size)
+{
+	return size == DIGSIG_ELF_SIG_SIZE || size == DIGSIG_ED25519_SIG_SIZE;
+}
+
+/*
+ * where the DigSig notes, or sections, of a file are, sizes of 0 when
+ * there are none;
+ * segments is set if the signature is of the segments only
+ */
+struct digsig_notes {
+	loff_t sig_offset;
+	u64 sig_size;
+	loff_t ch_offset;
+	u64 ch_size;
+	int segments;
+};
+
+/*
+ * Reads len bytes of the file at pos into buf, for the lookups below:
+ * the number of bytes read, short at the end of the file, or negative.
+ */
+typedef int (*digsig_read_t)(void *src, loff_t pos, char *buf,
+			     unsigned long len);
+
+extern int gDigestLength[DIGSIG_HASH_ALGOS];
+
+int digsig_elf_sanity_check(struct elf64_hdr *elf64_ex);
+int digsig_find_notes(digsig_read_t read, void *src,
+		      struct elf64_hdr *elf64_ex, int arch32, void *phdr,
+		      unsigned long phdr_size, struct digsig_notes *notes);
+int digsig_scan_sections(digsig_read_t read, void *src,
+			 struct elf64_hdr *elf64_ex, int arch32, void *buf,
+			 unsigned long buf_size, struct digsig_notes *found);
+int digsig_parse_signature(char *sig, int size, struct digsig_sig_info *info);
+const char *digsig_bsign_greeting(int algo);
+int digsig_pgp_hash_algo(int algo);
+
+#endif /* _DIGSIG_FORMAT_H */
@@ -0,0 +1,231 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file tells the misses of the verdict cache apart, to size it on
+ * what a larger cache would have saved.  As ARC does, the cache keeps a
+ * ghost of each entry it lets go: 32 bits of the hash of the file, why
+ * the entry went and, for an entry evicted to make room, the eviction
+ * count at the time.  A miss then looks for the ghost of its file, and
+ * is counted as:
+ *
+ *	cold		no ghost: never cached, or forgotten since
+ *	capacity	evicted to make room for another file
+ *	quota		evicted for the quota of the container that cached it
+ *	removed		dropped as the file was written or unlinked
+ *	dropped		dropped with its superblock or the key it was made
+ *			with
+ *	written		found, but for the file as it was before a write
+ *	expired		found, but made before a revocation
+ *
+ * A file evicted for capacity, and looked up again after the cache
+ * evicted d more entries, would have been found in a cache d + 1
+ * entries larger.  The capacity misses are kept in a histogram of that
+ * distance, shown as 'gain <entries> <misses>' lines: the misses a
+ * cache larger by that many entries would have turned into hits.
+ *
+ * The ghosts are kept in a table of dsi_cache_ghosts slots, one per
+ * hash, of 8 bytes each: a ghost is overwritten by the next one of its
+ * slot, and its miss then counts as cold, so the gains are only told
+ * up to about the size of the table.  With the compact cache, whose
+ * entries are hashed with the state of the file, the miss of a file
+ * written since its entry went finds no ghost either.  The counters
+ * are shown after those of the cache, in
+ * /sys/kernel/security/digsig/cache.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/seq_file.h>
+#include <linux/atomic.h>
+
+#include "digsig_common.h"
+#include "digsig_ghost.h"
+
+static int dsi_cache_ghosts = 16384;
+module_param(dsi_cache_ghosts, int, 0);
+MODULE_PARM_DESC(dsi_cache_ghosts, "Number of ghosts of the entries the verdict cache let go, to tell its misses apart, 0 for none.\n");
+
+/* the misses, by class */
+#define GHOST_MISS_COLD 4
+#define GHOST_MISS_WRITTEN 5
+#define GHOST_MISS_EXPIRED 6
+#define GHOST_MISSES 7
+
+/* the capacity misses, by ilog2() of the entries that would have held them */
+#define GHOST_BINS 32
+
+/* a slot: the tag, the reason and the eviction count, 0 when empty */
+#define GHOST_CLOCK_BITS 30
+#define GHOST_CLOCK_MASK ((1U << GHOST_CLOCK_BITS) - 1)
+#define ghost_tag(h) ((u32)(h) | 1)
+#define ghost_make(h, reason, clock) \
+	(((u64)ghost_tag(h) << 32) | ((u64)(reason) << GHOST_CLOCK_BITS) | \
+	 ((clock) & GHOST_CLOCK_MASK))
+#define ghost_slot_tag(v) ((u32)((v) >> 32))
+#define ghost_slot_reason(v) ((int)(((u32)(v)) >> GHOST_CLOCK_BITS))
+#define ghost_slot_clock(v) ((u32)(v) & GHOST_CLOCK_MASK)
+
+struct digsig_ghost_stats {
+	unsigned long miss[GHOST_MISSES];
+	unsigned long gain[GHOST_BINS];
+};
+
+static const char *digsig_ghost_miss_names[GHOST_MISSES] = {
+	[DIGSIG_GHOST_CAPACITY] = "capacity",
+	[DIGSIG_GHOST_QUOTA] = "quota",
+	[DIGSIG_GHOST_REMOVED] = "removed",
+	[DIGSIG_GHOST_DROPPED] = "dropped",
+	[GHOST_MISS_COLD] = "cold",
+	[GHOST_MISS_WRITTEN] = "written",
+	[GHOST_MISS_EXPIRED] = "expired",
+};
+
+static DEFINE_PER_CPU(struct digsig_ghost_stats, digsig_ghost_stats);
+
+/*
+ * The slots are read and written without a lock: two ghosts racing for
+ * a slot only leave one of them, as a later one would have.
+ */
+static atomic64_t *digsig_ghosts;
+static unsigned int digsig_ghost_bits;
+static atomic_t digsig_ghost_clock = ATOMIC_INIT(0);
+
+static inline atomic64_t *ghost_slot(u64 h)
+{
+	return &digsig_ghosts[hash_64(h, digsig_ghost_bits)];
+}
+
+/******************************************************************************
+Description : Keep the ghost of an entry the cache lets go.
+Parameters  :
+	@h: the hash of the entry, as the lookups of its file make it
+	@reason: one of DIGSIG_GHOST_*
+Return value: none; callable with the lock of a bucket held
+******************************************************************************/
+void digsig_ghost_add(u64 h, int reason)
+{
+	u32 clock = 0;
+
+	if (!digsig_ghosts)
+		return;
+	if (reason == DIGSIG_GHOST_CAPACITY)
+		clock = atomic_inc_return(&digsig_ghost_clock);
+	atomic64_set(ghost_slot(h), ghost_make(h, reason, clock));
+}
+
+/******************************************************************************
+Description : Count a lookup that found no entry for its file, by the
+	ghost the file left, which is taken.
+Parameters  :
+	@h: the hash of the lookup, 0 if it had none
+	@stale: an entry was found for the file before it was written
+Return value: none
+******************************************************************************/
+void digsig_ghost_miss(u64 h, int stale)
+{
+	atomic64_t *slot;
+	u64 v;
+	u32 d;
+	int reason = GHOST_MISS_COLD;
+
+	if (!digsig_ghosts)
+		return;
+	if (stale) {
+		this_cpu_inc(digsig_ghost_stats.miss[GHOST_MISS_WRITTEN]);
+		return;
+	}
+
+	slot = ghost_slot(h);
+	v = atomic64_read(slot);
+	if (h && v && ghost_slot_tag(v) == ghost_tag(h) &&
+	    atomic64_cmpxchg(slot, v, 0) == v) {
+		reason = ghost_slot_reason(v);
+		if (reason == DIGSIG_GHOST_CAPACITY) {
+			/* the entries evicted since, this one included */
+			d = (atomic_read(&digsig_ghost_clock) -
+			     ghost_slot_clock(v)) & GHOST_CLOCK_MASK;
+			this_cpu_inc(digsig_ghost_stats.gain[ilog2(d + 1)]);
+		}
+	}
+	this_cpu_inc(digsig_ghost_stats.miss[reason]);
+}
+
+/******************************************************************************
+Description : Count a lookup that found its file, with a verdict made
+	before the revocations changed.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_ghost_expired(void)
+{
+	if (digsig_ghosts)
+		this_cpu_inc(digsig_ghost_stats.miss[GHOST_MISS_EXPIRED]);
+}
+
+/******************************************************************************
+Description : Show the misses by class, and the gains of larger caches.
+Parameters  :
+	@m: the seq_file of /sys/kernel/security/digsig/cache
+Return value: none
+******************************************************************************/
+void digsig_ghost_show(struct seq_file *m)
+{
+	unsigned long miss[GHOST_MISSES] = { 0 }, gain[GHOST_BINS] = { 0 };
+	unsigned long sum = 0;
+	struct digsig_ghost_stats *s;
+	int i, cpu;
+
+	if (!digsig_ghosts)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(&digsig_ghost_stats, cpu);
+		for (i = 0; i < GHOST_MISSES; i++)
+			miss[i] += s->miss[i];
+		for (i = 0; i < GHOST_BINS; i++)
+			gain[i] += s->gain[i];
+	}
+	for (i = 0; i < GHOST_MISSES; i++)
+		seq_printf(m, "miss_%s %lu\n", digsig_ghost_miss_names[i],
+			   miss[i]);
+	seq_printf(m, "ghosts %lu\n", 1UL << digsig_ghost_bits);
+
+	/* bin i holds the misses that needed 2^i to 2^(i+1) - 1 entries */
+	for (i = 0; i < GHOST_BINS - 1 && i <= digsig_ghost_bits; i++) {
+		sum += gain[i];
+		seq_printf(m, "gain %lu %lu\n", 2UL << i, sum);
+	}
+}
+
+/******************************************************************************
+Description : Allocate the ghost table, of dsi_cache_ghosts rounded up to
+	a power of two.
+Parameters  : none
+Return value: 0 on success or without ghosts, -ENOMEM; the misses are then
+	not told apart
+******************************************************************************/
+int __init digsig_init_ghost(void)
+{
+	unsigned long n;
+
+	if (dsi_cache_ghosts <= 0)
+		return 0;
+
+	n = roundup_pow_of_two(max(dsi_cache_ghosts, 64));
+	digsig_ghosts = vzalloc(n * sizeof(*digsig_ghosts));
+	if (!digsig_ghosts)
+		return -ENOMEM;
+	digsig_ghost_bits = ilog2(n);
+	DSM_PRINT(DEBUG_INIT, "%s: %lu ghosts\n", __func__, n);
+	return 0;
+}
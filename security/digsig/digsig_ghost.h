@@ -0,0 +1,40 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the ghost entries of the verdict cache.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_GHOST_H
+#define _DIGSIG_GHOST_H
+
+#include <linux/types.h>
+
+/* why an entry left the cache */
+#define DIGSIG_GHOST_CAPACITY 0	/* evicted to make room */
+#define DIGSIG_GHOST_QUOTA 1	/* evicted for the quota of its owner */
+#define DIGSIG_GHOST_REMOVED 2	/* the file was written or unlinked */
+#define DIGSIG_GHOST_DROPPED 3	/* its superblock or key went away */
+
+#ifdef CONFIG_SECURITY_DIGSIG_CACHE_GHOST
+struct seq_file;
+
+void digsig_ghost_add(u64 h, int reason);
+void digsig_ghost_miss(u64 h, int stale);
+void digsig_ghost_expired(void);
+void digsig_ghost_show(struct seq_file *m);
+int digsig_init_ghost(void);
+#else
+#define digsig_ghost_add(h, reason) do { } while (0)
+#define digsig_ghost_miss(h, stale) do { } while (0)
+#define digsig_ghost_expired() do { } while (0)
+#define digsig_ghost_show(m) do { } while (0)
+#define digsig_init_ghost() 0
+#endif
+
+#endif /* _DIGSIG_GHOST_H */
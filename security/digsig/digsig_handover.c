@@ -0,0 +1,390 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file hands the records of recently verified files over to the
+ * next kernel across kexec, so that it does not verify every file again
+ * under load.  Reading /sys/kernel/security/digsig/handover gives the
+ * records made under the key loaded through sysfs, in the format of
+ * digsig_handover.h, each naming its file by the UUID of its filesystem
+ * and by what of the file is on disk: inode number, generation, size,
+ * change time and i_version.
+ *
+ * The next kernel, booted with dsi_handover=1, takes the records written
+ * back to the same file, once, after the same key was loaded.  They go
+ * to the recent records, where a file that was not changed since finds
+ * its verdict the first time it is mapped, and where every verdict is
+ * checked against the revocation list once.
+ *
+ * The records are not signed: the key fingerprint in them only says
+ * which keys they were made under, and anyone who may write the file
+ * could list unsigned files in them.  So they are taken only from the
+ * initramfs, which is verified as a whole: the file is closed as soon
+ * as init runs a program from outside rootfs, the real init after
+ * switch_root, or with no initramfs at all, before userspace of the
+ * root filesystem runs.  The import is off unless asked for, and
+ * taken only once.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/binfmts.h>
+#include <linux/sched.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/string.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_sb.h"
+#include "digsig_recent.h"
+#include "digsig_handover.h"
+
+/* records taken at once */
+#define DIGSIG_HANDOVER_MAX (1U << 18)
+
+/* superblocks told apart at once; those of the others are left out */
+#define DIGSIG_HANDOVER_SBS 64
+
+static int dsi_handover = 0;
+module_param(dsi_handover, int, 0);
+MODULE_PARM_DESC(dsi_handover, "Take the verdicts of the previous kernel once.\n");
+
+static DEFINE_MUTEX(digsig_handover_mutex);
+static int digsig_handover_taken;
+
+/* the handover being written, which may take several writes */
+static char *handover_buf;
+static size_t handover_size, handover_len;
+
+struct digsig_handover_sb {
+	u64 sb_id;
+	u8 uuid[16];
+};
+
+struct digsig_handover_sbs {
+	unsigned int count;
+	struct digsig_handover_sb sb[DIGSIG_HANDOVER_SBS];
+};
+
+static const u8 digsig_no_uuid[16];
+
+static void digsig_handover_add_sb(struct super_block *sb, void *data)
+{
+	struct digsig_handover_sbs *sbs = data;
+	u64 id = digsig_sb_id(sb);
+
+	if (!id || !memcmp(sb->s_uuid, digsig_no_uuid, sizeof(sb->s_uuid)) ||
+	    sbs->count == DIGSIG_HANDOVER_SBS)
+		return;
+	sbs->sb[sbs->count].sb_id = id;
+	memcpy(sbs->sb[sbs->count].uuid, sb->s_uuid, sizeof(sb->s_uuid));
+	sbs->count++;
+}
+
+/* the superblocks mounted, with a UUID and looked at by DigSig */
+static struct digsig_handover_sbs *digsig_handover_sbs(void)
+{
+	struct digsig_handover_sbs *sbs;
+
+	sbs = kzalloc(sizeof(*sbs), GFP_KERNEL);
+	if (sbs)
+		iterate_supers(digsig_handover_add_sb, sbs);
+	return sbs;
+}
+
+struct digsig_handover_export {
+	struct digsig_handover_sbs *sbs;
+	struct digsig_handover_rec *rec;
+	u32 count, max;
+};
+
+static int digsig_handover_export_one(const struct digsig_recent_entry *e,
+				      void *data)
+{
+	struct digsig_handover_export *x = data;
+	struct digsig_handover_rec *r;
+	unsigned int i;
+
+	/* a key added by key ID may not be loaded in the next kernel */
+	if (e->verdict.key)
+		return 0;
+	for (i = 0; i < x->sbs->count; i++)
+		if (x->sbs->sb[i].sb_id == e->sb_id)
+			break;
+	if (i == x->sbs->count)
+		return 0;
+	if (x->count == x->max)
+		return -ENOSPC;
+
+	r = &x->rec[x->count++];
+	memcpy(r->uuid, x->sbs->sb[i].uuid, sizeof(r->uuid));
+	r->ino = cpu_to_le64(e->ino);
+	r->igen = cpu_to_le32(e->igen);
+	r->sig_hash = cpu_to_le32(e->verdict.sig_hash);
+	r->size = cpu_to_le64(e->size);
+	r->ctime_sec = cpu_to_le64(e->ctime.tv_sec);
+	r->ctime_nsec = cpu_to_le32(e->ctime.tv_nsec);
+	r->version = cpu_to_le64(e->version);
+	return 0;
+}
+
+static int digsig_handover_count_one(const struct digsig_recent_entry *e,
+				     void *data)
+{
+	(*(u32 *)data)++;
+	return 0;
+}
+
+/* Snapshot the records into a buffer read from the file. */
+static char *digsig_handover_export(size_t *len)
+{
+	struct digsig_handover_export x;
+	struct digsig_handover_hdr *hdr;
+	char *buf;
+	int rc;
+
+	/* the next kernel could not tell which keys the records are of */
+	if (!digsig_key_fpr_valid())
+		return ERR_PTR(-ENOKEY);
+	x.sbs = digsig_handover_sbs();
+	if (!x.sbs)
+		return ERR_PTR(-ENOMEM);
+	x.max = 0;
+	digsig_recent_for_each(digsig_handover_count_one, &x.max);
+	x.max = min(x.max, DIGSIG_HANDOVER_MAX);
+	buf = vmalloc(sizeof(*hdr) + (size_t)x.max * sizeof(*x.rec));
+	if (!buf) {
+		kfree(x.sbs);
+		return ERR_PTR(-ENOMEM);
+	}
+	hdr = (void *)buf;
+	x.rec = (void *)(hdr + 1);
+	x.count = 0;
+
+	/* a full buffer still makes a valid handover */
+	rc = digsig_recent_for_each(digsig_handover_export_one, &x);
+	kfree(x.sbs);
+	if (rc && rc != -ENOSPC) {
+		vfree(buf);
+		return ERR_PTR(rc);
+	}
+
+	memcpy(hdr->magic, DIGSIG_HANDOVER_MAGIC, sizeof(hdr->magic));
+	hdr->count = cpu_to_le32(x.count);
+	memcpy(hdr->key_fpr, digsig_key_fpr, sizeof(hdr->key_fpr));
+	*len = sizeof(*hdr) + (size_t)x.count * sizeof(*x.rec);
+	return buf;
+}
+
+/* Take the records of the handover fully written. */
+static int digsig_handover_import(void)
+{
+	struct digsig_handover_hdr *hdr = (void *)handover_buf;
+	struct digsig_handover_rec *r = (void *)(hdr + 1);
+	struct digsig_handover_sbs *sbs;
+	struct digsig_recent_entry e;
+	u32 count = le32_to_cpu(hdr->count), n = 0, i, j;
+
+	if (!digsig_key_fpr_valid() ||
+	    memcmp(hdr->key_fpr, digsig_key_fpr, sizeof(hdr->key_fpr)))
+		return -EKEYREJECTED;
+	sbs = digsig_handover_sbs();
+	if (!sbs)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++, r++) {
+		for (j = 0; j < sbs->count; j++)
+			if (!memcmp(sbs->sb[j].uuid, r->uuid, sizeof(r->uuid)))
+				break;
+		if (j == sbs->count)
+			continue;
+
+		e.sb_id = sbs->sb[j].sb_id;
+		e.ino = le64_to_cpu(r->ino);
+		e.igen = le32_to_cpu(r->igen);
+		e.size = le64_to_cpu(r->size);
+		e.ctime.tv_sec = le64_to_cpu(r->ctime_sec);
+		e.ctime.tv_nsec = le32_to_cpu(r->ctime_nsec);
+		e.version = le64_to_cpu(r->version);
+		/* the revocation list may have moved on: check it once */
+		e.verdict.generation = digsig_verdict_gen() - 1;
+		e.verdict.sig_hash = le32_to_cpu(r->sig_hash);
+		e.verdict.key = 0;
+		digsig_recent_insert(&e);
+		n++;
+	}
+	kfree(sbs);
+
+	DSM_PRINT(DEBUG_INIT, "%s: %u of %u verdicts taken\n", __func__, n,
+		  count);
+	return 0;
+}
+
+static void digsig_handover_drop(void)
+{
+	vfree(handover_buf);
+	handover_buf = NULL;
+	handover_size = handover_len = 0;
+}
+
+static ssize_t digsig_handover_write(struct file *file,
+				     const char __user *ubuf, size_t count,
+				     loff_t *ppos)
+{
+	struct digsig_handover_hdr hdr;
+	ssize_t rc = count;
+	u32 n;
+
+	mutex_lock(&digsig_handover_mutex);
+	if (!dsi_handover || !g_init || digsig_handover_taken) {
+		rc = -EPERM;
+		goto out;
+	}
+
+	if (*ppos == 0) {
+		digsig_handover_drop();
+		if (count < sizeof(hdr) ||
+		    copy_from_user(&hdr, ubuf, sizeof(hdr))) {
+			rc = -EINVAL;
+			goto out;
+		}
+		n = le32_to_cpu(hdr.count);
+		if (memcmp(hdr.magic, DIGSIG_HANDOVER_MAGIC,
+			   sizeof(hdr.magic)) || n > DIGSIG_HANDOVER_MAX) {
+			rc = -EINVAL;
+			goto out;
+		}
+		handover_size = sizeof(hdr) +
+			(size_t)n * sizeof(struct digsig_handover_rec);
+		handover_buf = vmalloc(handover_size);
+		if (!handover_buf) {
+			handover_size = 0;
+			rc = -ENOMEM;
+			goto out;
+		}
+	}
+
+	if (!handover_buf || *ppos != handover_len ||
+	    count > handover_size - handover_len) {
+		digsig_handover_drop();
+		rc = -EINVAL;
+		goto out;
+	}
+	if (copy_from_user(handover_buf + handover_len, ubuf, count)) {
+		digsig_handover_drop();
+		rc = -EFAULT;
+		goto out;
+	}
+	handover_len += count;
+	*ppos += count;
+
+	if (handover_len == handover_size) {
+		int err = digsig_handover_import();
+
+		if (err) {
+			DSM_ERROR("%s: handover refused: %d\n", __func__, err);
+			rc = err;
+		}
+		digsig_handover_taken = 1;
+		digsig_handover_drop();
+	}
+out:
+	mutex_unlock(&digsig_handover_mutex);
+	return rc;
+}
+
+/******************************************************************************
+Description : Close the import once init runs a program from outside
+	rootfs: from then on, the file could be written by the userspace of
+	the root filesystem, which the records could then put anything past.
+Parameters  :
+	@bprm: the program about to be run
+Return value: none
+******************************************************************************/
+void digsig_handover_exec(struct linux_binprm *bprm)
+{
+	if (!dsi_handover || ACCESS_ONCE(digsig_handover_taken) ||
+	    !is_global_init(current) ||
+	    !strcmp(file_inode(bprm->file)->i_sb->s_type->name, "rootfs"))
+		return;
+
+	mutex_lock(&digsig_handover_mutex);
+	digsig_handover_taken = 1;
+	digsig_handover_drop();
+	mutex_unlock(&digsig_handover_mutex);
+	DSM_PRINT(DEBUG_INIT, "%s: handover closed\n", __func__);
+}
+
+static int digsig_handover_open(struct inode *inode, struct file *file)
+{
+	size_t len;
+	char *buf;
+
+	file->private_data = NULL;
+	if (!(file->f_mode & FMODE_READ))
+		return 0;
+	if (file->f_mode & FMODE_WRITE)
+		return -EINVAL;
+	if (!g_init)
+		return -ENOKEY;
+
+	buf = digsig_handover_export(&len);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+	file->private_data = buf;
+	return 0;
+}
+
+static ssize_t digsig_handover_read(struct file *file, char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct digsig_handover_hdr *hdr = file->private_data;
+	size_t len;
+
+	if (!hdr)
+		return -EINVAL;
+	len = sizeof(*hdr) + (size_t)le32_to_cpu(hdr->count) *
+		sizeof(struct digsig_handover_rec);
+	return simple_read_from_buffer(ubuf, count, ppos, hdr, len);
+}
+
+static int digsig_handover_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations digsig_handover_fops = {
+	.open = digsig_handover_open,
+	.read = digsig_handover_read,
+	.write = digsig_handover_write,
+	.release = digsig_handover_release,
+	.llseek = generic_file_llseek,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/handover.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_handover(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("handover", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_handover_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the handover of verdicts to the next kernel.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_HANDOVER_H
+#define _DIGSIG_HANDOVER_H
+
+#include <linux/types.h>
+#include "digsig_verify.h"
+
+#define DIGSIG_HANDOVER_MAGIC "DSHAND01"
+
+/*
+ * Format of /sys/kernel/security/digsig/handover:
+ * - struct digsig_handover_hdr, with the fingerprint of the key the
+ *   verdicts were made under
+ * - count struct digsig_handover_rec, each naming a file by the UUID of
+ *   its filesystem and by what of it is on disk
+ */
+struct digsig_handover_hdr {
+	u8 magic[8];
+	__le32 count;
+	u8 key_fpr[SHA1_DIGEST_LENGTH];
+} __packed;
+
+struct digsig_handover_rec {
+	u8 uuid[16];
+	__le64 ino;
+	__le32 igen;
+	__le32 sig_hash;
+	__le64 size;
+	__le64 ctime_sec;
+	__le32 ctime_nsec;
+	__le64 version;
+} __packed;
+
+struct linux_binprm;
+
+#ifdef CONFIG_SECURITY_DIGSIG_HANDOVER
+int digsig_init_handover(void);
+void digsig_handover_exec(struct linux_binprm *bprm);
+#else
+#define digsig_init_handover() 0
+#define digsig_handover_exec(bprm) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_HANDOVER_H */
@@ -0,0 +1,288 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file picks, for each hash algorithm, the fastest of the
+ * implementations the crypto API offers, as the RAID-6 code picks its
+ * syndrome functions.  The highest priority one, which the crypto API
+ * hands out by default, is not always the fastest on a given host.
+ *
+ * Once the crypto drivers are registered, at late_initcall, every
+ * implementation found under a driver name DigSig knows of, and the
+ * default one, hashes 64 byte and page sized blocks for
+ * dsi_hash_calib_us microseconds each.  The fastest on pages, as files
+ * are hashed a page at a time, is used from then on.  The drivers
+ * named in dsi_hash_prefer, separated by commas, are used instead of
+ * the fastest of their algorithm.
+ *
+ * /sys/kernel/security/digsig/hash lists the implementations, one per
+ * line: the algorithm, the driver, the MB/s on 64 byte blocks and on
+ * pages, and a * for those in use.  Writing a driver name to it uses
+ * that driver from then on.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/math64.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_format.h"
+#include "digsig_verify.h"
+#include "digsig_hashsel.h"
+
+static int dsi_hash_calib_us = 2000;
+module_param(dsi_hash_calib_us, int, 0);
+MODULE_PARM_DESC(dsi_hash_calib_us, "Microseconds each hash implementation is timed for at boot, 0 not to time them.\n");
+
+static char *dsi_hash_prefer = "";
+module_param(dsi_hash_prefer, charp, 0);
+MODULE_PARM_DESC(dsi_hash_prefer, "Hash drivers used rather than the fastest, separated by commas.\n");
+
+/* the suffixes of the driver names of the implementations in the tree */
+static const char *const digsig_hashsel_suffixes[] = {
+	"generic", "ssse3", "asm", "ce", "neon", "powerpc", "sparc64", "s390",
+};
+
+/* the default implementation, and one per suffix */
+#define DIGSIG_HASHSEL_MAX (1 + ARRAY_SIZE(digsig_hashsel_suffixes))
+
+struct digsig_hashsel_impl {
+	struct crypto_shash *tfm;	/* kept, contexts may still use it */
+	unsigned int small_mbs;		/* MB/s on 64 byte blocks */
+	unsigned int page_mbs;		/* MB/s on pages */
+};
+
+static struct digsig_hashsel_impl
+digsig_hashsel[DIGSIG_HASH_ALGOS][DIGSIG_HASHSEL_MAX];
+static unsigned int digsig_hashsel_count[DIGSIG_HASH_ALGOS];
+static DEFINE_MUTEX(digsig_hashsel_lock);
+
+static const char *digsig_hashsel_driver(struct crypto_shash *tfm)
+{
+	return crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm));
+}
+
+/* Add the implementation of the name to the algorithm's, once. */
+static void digsig_hashsel_add(int algo, const char *name)
+{
+	struct crypto_shash *tfm;
+	unsigned int i, n = digsig_hashsel_count[algo];
+
+	tfm = crypto_alloc_shash(name, 0, 0);
+	if (IS_ERR(tfm))
+		return;
+	for (i = 0; i < n; i++)
+		if (!strcmp(digsig_hashsel_driver(digsig_hashsel[algo][i].tfm),
+			    digsig_hashsel_driver(tfm)))
+			break;
+	if (i < n || n == DIGSIG_HASHSEL_MAX) {
+		crypto_free_shash(tfm);
+		return;
+	}
+	digsig_hashsel[algo][n].tfm = tfm;
+	digsig_hashsel_count[algo] = n + 1;
+}
+
+/* MB/s of the transform on blocks of len bytes from buf */
+static unsigned int digsig_hashsel_rate(struct crypto_shash *tfm,
+					const u8 *buf, unsigned int len)
+{
+	struct shash_desc *desc;
+	u8 out[DIGSIG_MAX_DIGEST_LENGTH];
+	u64 start, end, now, bytes = 0;
+
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc)
+		return 0;
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	if (crypto_shash_init(desc)) {
+		kfree(desc);
+		return 0;
+	}
+	start = local_clock();
+	end = start + (u64)dsi_hash_calib_us * NSEC_PER_USEC;
+	do {
+		if (crypto_shash_update(desc, buf, len))
+			break;
+		bytes += len;
+		now = local_clock();
+	} while (now < end);
+	crypto_shash_final(desc, out);
+	kfree(desc);
+
+	/* bytes per nanosecond, in MB/s */
+	return now > start ? div64_u64(bytes * 1000, now - start) : 0;
+}
+
+/* Is the driver among those of dsi_hash_prefer? */
+static int digsig_hashsel_preferred(const char *driver)
+{
+	const char *p = dsi_hash_prefer;
+	size_t len = strlen(driver);
+
+	while (p && *p) {
+		if (!strncmp(p, driver, len) && (p[len] == ',' || !p[len]))
+			return 1;
+		p = strchr(p, ',');
+		if (p)
+			p++;
+	}
+	return 0;
+}
+
+static void digsig_hashsel_algo(int algo, const u8 *buf)
+{
+	struct digsig_hashsel_impl *im = digsig_hashsel[algo], *best = NULL;
+	char name[CRYPTO_MAX_ALG_NAME];
+	const char *alg = digsig_hash_name(algo);
+	unsigned int i;
+
+	digsig_hashsel_add(algo, alg);
+	for (i = 0; i < ARRAY_SIZE(digsig_hashsel_suffixes); i++) {
+		snprintf(name, sizeof(name), "%s-%s", alg,
+			 digsig_hashsel_suffixes[i]);
+		digsig_hashsel_add(algo, name);
+	}
+	if (!digsig_hashsel_count[algo])
+		return;
+
+	/* one implementation needs no timing */
+	for (i = 0; i < digsig_hashsel_count[algo]; i++) {
+		if (dsi_hash_calib_us > 0 && digsig_hashsel_count[algo] > 1) {
+			im[i].small_mbs = digsig_hashsel_rate(im[i].tfm, buf, 64);
+			im[i].page_mbs = digsig_hashsel_rate(im[i].tfm, buf,
+							     PAGE_SIZE);
+		}
+		if (!best || im[i].page_mbs > best->page_mbs)
+			best = &im[i];
+		cond_resched();
+	}
+	for (i = 0; i < digsig_hashsel_count[algo]; i++)
+		if (digsig_hashsel_preferred(digsig_hashsel_driver(im[i].tfm)))
+			best = &im[i];
+
+	digsig_set_shash(algo, best->tfm);
+	DSM_LOG(DIGSIG_MODULE_NAME ": %s: using %s (%u MB/s)\n", alg,
+		digsig_hashsel_driver(best->tfm), best->page_mbs);
+}
+
+/*
+ * Time the implementations once the crypto algorithms are registered,
+ * which is after DigSig's own module_init.
+ */
+static int __init digsig_hashsel_calibrate(void)
+{
+	u8 *buf;
+	int algo;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return 0;
+	memset(buf, 0xa5, PAGE_SIZE);
+
+	mutex_lock(&digsig_hashsel_lock);
+	for (algo = 0; algo < DIGSIG_HASH_ALGOS; algo++)
+		digsig_hashsel_algo(algo, buf);
+	mutex_unlock(&digsig_hashsel_lock);
+	kfree(buf);
+	return 0;
+}
+late_initcall(digsig_hashsel_calibrate);
+
+static int digsig_hashsel_show(struct seq_file *m, void *v)
+{
+	struct digsig_hashsel_impl *im;
+	struct crypto_shash *cur;
+	unsigned int i;
+	int algo;
+
+	seq_puts(m, "# algo\tdriver\tsmall\tpage\n");
+	mutex_lock(&digsig_hashsel_lock);
+	for (algo = 0; algo < DIGSIG_HASH_ALGOS; algo++) {
+		cur = digsig_get_shash(algo);
+		for (i = 0; i < digsig_hashsel_count[algo]; i++) {
+			im = &digsig_hashsel[algo][i];
+			seq_printf(m, "%s\t%s\t%u\t%u%s\n",
+				   digsig_hash_name(algo),
+				   digsig_hashsel_driver(im->tfm),
+				   im->small_mbs, im->page_mbs,
+				   im->tfm == cur ? "\t*" : "");
+		}
+	}
+	mutex_unlock(&digsig_hashsel_lock);
+	return 0;
+}
+
+static int digsig_hashsel_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_hashsel_show, NULL);
+}
+
+static ssize_t digsig_hashsel_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	char kbuf[CRYPTO_MAX_ALG_NAME], *name;
+	size_t len = min(count, sizeof(kbuf) - 1);
+	unsigned int i;
+	int algo, rc = -ENOENT;
+
+	if (copy_from_user(kbuf, buf, len))
+		return -EFAULT;
+	kbuf[len] = '\0';
+	name = strim(kbuf);
+
+	mutex_lock(&digsig_hashsel_lock);
+	for (algo = 0; algo < DIGSIG_HASH_ALGOS; algo++)
+		for (i = 0; i < digsig_hashsel_count[algo]; i++)
+			if (!strcmp(name, digsig_hashsel_driver(
+					digsig_hashsel[algo][i].tfm))) {
+				digsig_set_shash(algo,
+						 digsig_hashsel[algo][i].tfm);
+				rc = count;
+			}
+	mutex_unlock(&digsig_hashsel_lock);
+	return rc;
+}
+
+static const struct file_operations digsig_hashsel_fops = {
+	.open = digsig_hashsel_open,
+	.read = seq_read,
+	.write = digsig_hashsel_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/hash; it lists the hash
+	implementations once they are timed, at late_initcall.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_hashsel(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("hash", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_hashsel_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
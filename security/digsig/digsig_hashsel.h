@@ -0,0 +1,22 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the choice of the hash implementations.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_HASHSEL_H
+#define _DIGSIG_HASHSEL_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_HASH_SELECT
+int digsig_init_hashsel(void);
+#else
+#define digsig_init_hashsel() 0
+#endif
+
+#endif /* _DIGSIG_HASHSEL_H */
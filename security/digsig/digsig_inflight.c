@@ -0,0 +1,191 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file coalesces concurrent verifications of the same inode, so
+ * that a burst of processes starting a freshly installed binary
+ * verifies it once instead of once per process.
+ *
+ * A task that waits for the verification of another lends it its CPU
+ * priority, if that is higher, as a task blocked on an rt_mutex does:
+ * a real time task, or one of a lower nice value, does not wait for a
+ * verification a background or niced task started, and that the
+ * scheduler would leave behind.  The owner runs at the priority of the
+ * highest of its waiters until its verdict is out, and then is put back
+ * to what it had, as its waiters wake.  A change of priority made to
+ * the owner from outside meanwhile is undone with it.  With
+ * dsi_inflight_pi=0 the owner is left its own priority.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/completion.h>
+
+#include "digsig_common.h"
+#include "digsig_inflight.h"
+#include "digsig_ioprio.h"
+
+#define INFLIGHT_BITS 6
+#define INFLIGHT_BUCKETS (1 << INFLIGHT_BITS)
+
+/*
+ * The table only holds verifications that are running right now, so
+ * it stays small and a single lock is enough: it is only taken on
+ * cache misses, which already pay for a full file hash.
+ */
+static DEFINE_SPINLOCK(inflight_lock);
+static struct hlist_head inflight_table[INFLIGHT_BUCKETS];
+
+static int dsi_inflight_pi = 1;
+module_param(dsi_inflight_pi, int, 0644);
+MODULE_PARM_DESC(dsi_inflight_pi, "Raise a verification to the CPU priority of the tasks waiting for it.\n");
+
+/* SCHED_IDLE runs behind everything, whatever its nice value says */
+static int digsig_inflight_outranks(struct task_struct *p,
+				    struct task_struct *q)
+{
+	if (q->policy == SCHED_IDLE)
+		return p->policy != SCHED_IDLE;
+	return p->prio < q->prio && p->policy != SCHED_IDLE;
+}
+
+/*
+ * Raise the owner of F to the CPU priority of the current task, about
+ * to wait for it.  Called with inflight_lock held, which keeps the
+ * owner in the table until it takes its entry out, and so alive.
+ */
+static void digsig_inflight_boost(struct digsig_inflight *f)
+{
+	struct task_struct *owner = f->owner;
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (!dsi_inflight_pi || owner == current ||
+	    !digsig_inflight_outranks(current, owner))
+		return;
+
+	if (f->policy < 0) {
+		f->policy = owner->policy;
+		f->rt_priority = owner->rt_priority;
+		f->nice = task_nice(owner);
+	}
+	if (current->policy == SCHED_FIFO || current->policy == SCHED_RR) {
+		param.sched_priority = current->rt_priority;
+		sched_setscheduler_nocheck(owner, current->policy, &param);
+	} else {
+		if (owner->policy == SCHED_IDLE)
+			sched_setscheduler_nocheck(owner, SCHED_NORMAL, &param);
+		if (task_nice(owner) > task_nice(current))
+			set_user_nice(owner, task_nice(current));
+	}
+	DSM_PRINT(DEBUG_SIGN, "%s: %s/%d raised for %s/%d\n", __func__,
+		  owner->comm, task_pid_nr(owner), current->comm,
+		  task_pid_nr(current));
+}
+
+static void digsig_inflight_put(struct digsig_inflight *f)
+{
+	if (atomic_dec_and_test(&f->count))
+		kfree(f);
+}
+
+/******************************************************************************
+Description : Join or start the verification of an inode.
+Parameters  :
+	@inode: the inode about to be verified
+	@result: set to the owner's verdict if we waited for another task
+Return value: NULL if another task verified the inode while we waited
+	(*result holds its verdict; if that task was killed instead, the
+	caller takes over), otherwise an entry owned by the caller,
+	which must verify the file and pass the verdict to
+	digsig_inflight_end().  ERR_PTR(-ENOMEM) if no entry could be
+	allocated; the caller then verifies without coalescing.
+******************************************************************************/
+struct digsig_inflight *digsig_inflight_begin(struct inode *inode, int *result)
+{
+	struct digsig_inflight *f, *new;
+	struct hlist_head *head = &inflight_table[hash_ptr(inode, INFLIGHT_BITS)];
+
+again:
+	new = kmalloc(sizeof(*new), GFP_KERNEL);
+
+	spin_lock(&inflight_lock);
+	hlist_for_each_entry(f, head, node) {
+		if (f->inode == inode) {
+			atomic_inc(&f->count);
+			/* the owner is left the lock only once done */
+			digsig_prio_promote(f->owner);
+			digsig_inflight_boost(f);
+			spin_unlock(&inflight_lock);
+			kfree(new);
+
+			if (wait_for_completion_killable(&f->done)) {
+				*result = -EINTR;
+			} else if (f->result == -EINTR ||
+				   f->result == -EAGAIN) {
+				/*
+				 * the owner was killed, or left the verdict
+				 * to a batch; its entry is gone
+				 */
+				digsig_inflight_put(f);
+				goto again;
+			} else {
+				*result = f->result;
+			}
+			digsig_inflight_put(f);
+			return NULL;
+		}
+	}
+
+	if (!new) {
+		spin_unlock(&inflight_lock);
+		DSM_ERROR("%s: no memory for in-flight entry\n", __func__);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	new->inode = inode;
+	new->owner = current;
+	new->result = 0;
+	new->policy = -1;
+	init_completion(&new->done);
+	atomic_set(&new->count, 1);
+	hlist_add_head(&new->node, head);
+	spin_unlock(&inflight_lock);
+
+	return new;
+}
+
+/******************************************************************************
+Description : Publish the verdict of an owned verification and wake
+	every task waiting for it.
+Parameters  :
+	@f: entry returned by digsig_inflight_begin()
+	@result: the verdict, as returned to the owner's caller
+Return value: none
+******************************************************************************/
+void digsig_inflight_end(struct digsig_inflight *f, int result)
+{
+	struct sched_param param;
+
+	spin_lock(&inflight_lock);
+	hlist_del(&f->node);
+	spin_unlock(&inflight_lock);
+
+	/* no waiter can raise us once out of the table */
+	if (f->policy >= 0) {
+		param.sched_priority = f->rt_priority;
+		sched_setscheduler_nocheck(current, f->policy, &param);
+		set_user_nice(current, f->nice);
+	}
+	f->result = result;
+	complete_all(&f->done);
+	digsig_inflight_put(f);
+}
@@ -0,0 +1,45 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the in-flight verification table.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_INFLIGHT_H
+#define _DIGSIG_INFLIGHT_H
+
+#include <linux/fs.h>
+#include <linux/completion.h>
+#include <linux/sched.h>
+
+/*
+ * digsig_inflight: one verification of an inode in progress.  The
+ * first task to miss the cache for an inode owns the entry and
+ * verifies the file; tasks arriving while it runs wait on @done and
+ * take the owner's verdict instead of hashing the file again.  A
+ * waiter of a higher CPU priority than the owner raises it to its own;
+ * what the owner had is kept in @policy, @rt_priority and @nice until
+ * it puts it back in digsig_inflight_end().
+ */
+struct digsig_inflight {
+	struct hlist_node node;
+	struct inode *inode;
+	struct task_struct *owner;
+	struct completion done;
+	atomic_t count;
+	int result;
+	int policy;			/* -1 if the owner was not raised */
+	int rt_priority;
+	int nice;
+};
+
+struct digsig_inflight *digsig_inflight_begin(struct inode *inode,
+					      int *result);
+void digsig_inflight_end(struct digsig_inflight *f, int result);
+
+#endif /* _DIGSIG_INFLIGHT_H */
@@ -0,0 +1,317 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file lets the files of a signed initramfs through without
+ * verifying them one by one.  The archive is signed as a whole, and
+ * init/initramfs.c hands it over before unpacking it, signature and
+ * trailer stripped, then notes every regular file it writes to rootfs.
+ *
+ * The crypto algorithms are not registered yet while rootfs is
+ * populated, and the key is only loaded later, by early userspace, so
+ * the work is done in two steps.  The archive is hashed at late_initcall,
+ * before init/initramfs.c frees it.  Its signature is then checked
+ * against that digest when a key is loaded, and every noted file still
+ * as it was unpacked is marked verified, so that the tools run out of
+ * the initramfs afterwards are never hashed.
+ *
+ * A file written since it was unpacked is verified as any other.  A
+ * signature that does not verify is checked again when the next key is
+ * loaded, unless it is revoked.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/initrd.h>
+#include <linux/fs.h>
+#include <linux/namei.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_revocation.h"
+#include "digsig_inode.h"
+#include "digsig_initramfs.h"
+
+#define INITRAMFS_HASH_STEP (1UL << 20)
+
+struct digsig_initramfs_file {
+	struct list_head list;
+	struct inode *inode;
+	loff_t size;
+	struct timespec mtime;
+	struct timespec ctime;
+};
+
+static DEFINE_MUTEX(digsig_initramfs_mutex);
+static LIST_HEAD(digsig_initramfs_files);
+static int digsig_initramfs_noting;
+
+/* the archive, from unpacking until it is hashed */
+static char *archive;
+static unsigned long archive_len;
+
+static char *archive_sig;
+static int archive_sig_size;
+static u8 archive_digest[DIGSIG_MAX_DIGEST_LENGTH];
+static int archive_hashed;
+
+/******************************************************************************
+Description : Find out whether the initramfs about to be unpacked is signed,
+	and if so, start noting the files unpacked from it.
+Parameters  :
+	@buf: the initramfs image
+	@len: its length; set to that of the archive if it is signed
+Return value: 1 if it is signed, 0 otherwise
+******************************************************************************/
+int __init digsig_initramfs_signed(char *buf, unsigned long *len)
+{
+	struct digsig_initramfs_trailer *t;
+	u32 sig_size;
+
+	if (*len < sizeof(*t))
+		return 0;
+	t = (void *)(buf + *len - sizeof(*t));
+	if (memcmp(t->magic, DIGSIG_INITRAMFS_MAGIC, sizeof(t->magic)))
+		return 0;
+	sig_size = le32_to_cpu(t->sig_size);
+	if ((sig_size != DIGSIG_ELF_SIG_SIZE &&
+	     sig_size != DIGSIG_ED25519_SIG_SIZE) ||
+	    *len - sizeof(*t) < sig_size) {
+		DSM_ERROR("%s: bad signed initramfs trailer\n", __func__);
+		return 0;
+	}
+
+	archive_len = *len - sizeof(*t) - sig_size;
+	archive_sig = kmemdup(buf + archive_len, sig_size, GFP_KERNEL);
+	if (!archive_sig)
+		return 0;
+	archive_sig_size = sig_size;
+	archive = buf;
+	*len = archive_len;
+	digsig_initramfs_noting = 1;
+	return 1;
+}
+
+/******************************************************************************
+Description : Note a file just unpacked from a signed initramfs.
+Parameters  :
+	@name: its path in rootfs
+Return value: none; a file not noted is verified when it is mapped
+******************************************************************************/
+void __init digsig_initramfs_note(const char *name)
+{
+	struct digsig_initramfs_file *f;
+	struct inode *inode;
+	struct path path;
+
+	if (!digsig_initramfs_noting)
+		return;
+	if (kern_path(name, 0, &path))
+		return;
+	inode = path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode))
+		goto out;
+
+	f = kmalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		goto out;
+	ihold(inode);
+	f->inode = inode;
+	f->size = i_size_read(inode);
+	f->mtime = inode->i_mtime;
+	f->ctime = inode->i_ctime;
+	list_add_tail(&f->list, &digsig_initramfs_files);
+out:
+	path_put(&path);
+}
+
+static void digsig_initramfs_drop(void)
+{
+	struct digsig_initramfs_file *f, *next;
+
+	list_for_each_entry_safe(f, next, &digsig_initramfs_files, list) {
+		list_del(&f->list);
+		iput(f->inode);
+		kfree(f);
+	}
+	kfree(archive_sig);
+	archive_sig = NULL;
+	archive_hashed = 0;
+}
+
+/******************************************************************************
+Description : Stop noting files once the initramfs is unpacked.
+Parameters  :
+	@ok: whether it was unpacked without errors
+Return value: 1 if the image must be kept until DigSig hashed it, and freed
+	at late_initcall_sync; 0 if it may be freed now
+******************************************************************************/
+int __init digsig_initramfs_unpacked(int ok)
+{
+	if (!digsig_initramfs_noting)
+		return 0;
+	digsig_initramfs_noting = 0;
+	if (ok)
+		return 1;
+
+	digsig_initramfs_drop();
+	archive = NULL;
+	return 0;
+}
+
+static int digsig_initramfs_unchanged(struct digsig_initramfs_file *f)
+{
+	struct inode *inode = f->inode;
+
+	return inode->i_nlink && i_size_read(inode) == f->size &&
+	       timespec_equal(&inode->i_mtime, &f->mtime) &&
+	       timespec_equal(&inode->i_ctime, &f->ctime);
+}
+
+/* Check the signature of the archive against its digest. */
+static int digsig_initramfs_verify(struct digsig_verdict *verdict)
+{
+	struct digsig_sig_info info;
+	SIGCTX *ctx;
+	int rc;
+
+	rc = digsig_parse_signature(archive_sig, archive_sig_size, &info);
+	if (rc)
+		return -EPERM;
+
+	verdict->sig_hash = 0;
+	if (info.signalgo == SIGN_RSA &&
+	    digsig_is_revoked_sig(info.packet + DIGSIG_RSA_DATA_OFFSET,
+				  info.packet_len - DIGSIG_RSA_DATA_OFFSET,
+				  &verdict->sig_hash))
+		return -EPERM;
+
+	ctx = digsig_sign_verify_get();
+	if (!ctx)
+		return -ENOMEM;
+	verdict->generation = digsig_verdict_gen();
+	rc = digsig_sign_verify_init(ctx, info.hashalgo, info.signalgo);
+	if (!rc) {
+		memcpy(ctx->digest, archive_digest,
+		       gDigestLength[info.hashalgo]);
+		ctx->digest_done = 1;
+		rc = digsig_sign_verify_final(ctx, info.packet_len,
+					      info.packet) ? -EAGAIN : 0;
+		verdict->key = ctx->key_tag;
+	}
+	digsig_sign_verify_release(ctx);
+	return rc;
+}
+
+/* Called with digsig_initramfs_mutex held. */
+static void __digsig_initramfs_trust(void)
+{
+	struct digsig_initramfs_file *f;
+	struct digsig_verdict verdict;
+	int rc, n = 0;
+
+	if (!archive_hashed)
+		return;
+
+	rc = digsig_initramfs_verify(&verdict);
+	if (rc == -EAGAIN || rc == -ENOMEM) {
+		DSM_PRINT(DEBUG_SIGN, "%s: initramfs signature not verified: %d\n",
+			  __func__, rc);
+		return;
+	}
+	if (rc) {
+		DSM_ERROR("%s: initramfs signature refused\n", __func__);
+	} else {
+		list_for_each_entry(f, &digsig_initramfs_files, list)
+			if (digsig_initramfs_unchanged(f)) {
+				digsig_inode_set_verified(f->inode, verdict);
+				n++;
+			}
+		DSM_PRINT(DEBUG_SIGN, "%s: %d initramfs files verified\n",
+			  __func__, n);
+	}
+	digsig_initramfs_drop();
+}
+
+/*
+ * Hash the archive with the algorithm its signature names.  This can
+ * not wait for DigSig's own module_init, which runs before the crypto
+ * algorithms register.
+ */
+static int __init digsig_initramfs_hash(void)
+{
+	struct digsig_sig_info info;
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+	unsigned long off, n;
+	int rc;
+
+	if (!archive)
+		return 0;
+
+	rc = digsig_parse_signature(archive_sig, archive_sig_size, &info);
+	if (rc)
+		goto out;
+	tfm = digsig_get_shash(info.hashalgo);
+	if (IS_ERR(tfm)) {
+		rc = PTR_ERR(tfm);
+		goto out;
+	}
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	rc = crypto_shash_init(desc);
+	for (off = 0; !rc && off < archive_len; off += n) {
+		n = min(archive_len - off, INITRAMFS_HASH_STEP);
+		rc = crypto_shash_update(desc, archive + off, n);
+		cond_resched();
+	}
+	if (!rc)
+		rc = crypto_shash_final(desc, archive_digest);
+	kfree(desc);
+
+out:
+	mutex_lock(&digsig_initramfs_mutex);
+	archive = NULL;
+	if (rc) {
+		DSM_ERROR("%s: cannot hash the signed initramfs: %d\n",
+			  __func__, rc);
+		digsig_initramfs_drop();
+	} else {
+		archive_hashed = 1;
+		if (g_init)
+			__digsig_initramfs_trust();
+	}
+	mutex_unlock(&digsig_initramfs_mutex);
+	return 0;
+}
+late_initcall(digsig_initramfs_hash);
+
+/******************************************************************************
+Description : Check the signature of the initramfs with the keys loaded, and
+	mark the files unpacked from it verified if it is valid.
+	Called whenever a key is loaded.
+Parameters  : none
+Return value: none; the files are verified one by one if it is not
+******************************************************************************/
+void digsig_initramfs_trust(void)
+{
+	mutex_lock(&digsig_initramfs_mutex);
+	__digsig_initramfs_trust();
+	mutex_unlock(&digsig_initramfs_mutex);
+}
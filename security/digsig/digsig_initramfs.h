@@ -0,0 +1,35 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the trust of files unpacked from a signed initramfs.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_INITRAMFS_H
+#define _DIGSIG_INITRAMFS_H
+
+#include <linux/types.h>
+
+/*
+ * A signed initramfs ends with the signature section of the archive
+ * before it, as bsign makes them, followed by this trailer.
+ */
+#define DIGSIG_INITRAMFS_MAGIC "DIGSIGCPIO01"
+
+struct digsig_initramfs_trailer {
+	__le32 sig_size;
+	char magic[12];
+} __packed;
+
+#ifdef CONFIG_SECURITY_DIGSIG_INITRAMFS
+void digsig_initramfs_trust(void);
+#else
+#define digsig_initramfs_trust() do { } while (0)
+#endif
+
+#endif /* _DIGSIG_INITRAMFS_H */
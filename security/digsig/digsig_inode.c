@@ -0,0 +1,181 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the verification verdict and the writer count of an
+ * inode in its security blob, so that a mapping of an already verified
+ * file is decided from the inode alone.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_inode.h"
+#include "digsig_revocation.h"
+#include "digsig_revoke_rules.h"
+#include "digsig_reflink.h"
+
+/*
+ * Bumped whenever the revocation list changes.  Verdicts remember the
+ * generation they were made in, and are checked against the list again
+ * once it moved on.
+ */
+atomic_t digsig_verdict_generation = ATOMIC_INIT(0);
+
+static struct kmem_cache *digsig_inode_cachep;
+
+/******************************************************************************
+Description : Find the blob of an inode, allocating it on first use.
+	DigSig may be loaded after inodes were created, and most inodes are
+	never mapped for execution, so the blob is not allocated from the
+	inode_alloc_security hook but lazily here.
+Parameters  :
+	@inode: the inode about to be mapped for execution
+Return value: the blob, or NULL if there is no memory for one
+******************************************************************************/
+struct digsig_inode_sec *digsig_inode_get(struct inode *inode)
+{
+	struct digsig_inode_sec *isec, *old;
+
+	isec = digsig_inode_sec(inode);
+	if (isec)
+		return isec;
+
+	isec = kmem_cache_zalloc(digsig_inode_cachep, GFP_KERNEL);
+	if (!isec) {
+		DSM_ERROR("%s: no memory for inode security blob\n", __func__);
+		return NULL;
+	}
+
+	old = cmpxchg(&inode->i_security, NULL, isec);
+	if (old) {
+		kmem_cache_free(digsig_inode_cachep, isec);
+		isec = old;
+	}
+
+	return isec;
+}
+
+/******************************************************************************
+Description : Record that the signature of an inode is valid.
+Parameters  :
+	@inode: an inode whose signature was just verified
+	@verdict: what the verification was made under
+Return value: none; without a blob the verdict is simply not remembered
+******************************************************************************/
+void digsig_inode_set_verified(struct inode *inode,
+			       struct digsig_verdict verdict)
+{
+	struct digsig_inode_sec *isec = digsig_inode_get(inode);
+
+	if (!isec)
+		return;
+
+	clear_bit(DIGSIG_INODE_DENIED, &isec->flags);
+	memcpy(isec->key_id, digsig_key_fpr, DIGSIG_KEY_ID_SIZE);
+	isec->verdict = verdict;
+	isec->version = inode->i_version;
+	/* digsig_inode_verified() reads the generation after the flag */
+	smp_wmb();
+	set_bit(DIGSIG_INODE_VERIFIED, &isec->flags);
+}
+
+/******************************************************************************
+Description : Record that an inode was found not to be ELF, unsigned or
+	not to match its signature, so that it is not read again until it
+	is written.
+Parameters  :
+	@inode: an inode just checked, and held from writers meanwhile
+	@generation: digsig_verdict_gen() from before the check
+	@result: what the check returned
+Return value: none; without a blob the verdict is simply not remembered
+******************************************************************************/
+void digsig_inode_set_denied(struct inode *inode, unsigned int generation,
+			     int result)
+{
+	struct digsig_inode_sec *isec = digsig_inode_get(inode);
+
+	if (!isec)
+		return;
+
+	/* a verdict the check just overruled was stale */
+	clear_bit(DIGSIG_INODE_VERIFIED, &isec->flags);
+	isec->denied.generation = generation;
+	isec->denied.result = result;
+	isec->denied.version = inode->i_version;
+	/* digsig_inode_denied() reads the result after the flag */
+	smp_wmb();
+	set_bit(DIGSIG_INODE_DENIED, &isec->flags);
+}
+
+/******************************************************************************
+Description : Check a verdict made before the revocation list last changed,
+	or a key was retired, against the list and the keys.  A verdict
+	whose signature is not listed, and whose key is still loaded, is
+	moved to the current generation, so that it is checked only once.
+Parameters  :
+	@v: the verdict
+Return value: 1 if the verdict still stands, 0 if it must be made again
+******************************************************************************/
+int digsig_verdict_recheck(struct digsig_verdict *v)
+{
+	unsigned int gen = digsig_verdict_gen();
+
+	/* the revocation rules look at more than the verdict records */
+	if (digsig_revoke_rules_older(v->generation) ||
+	    digsig_revoked_hash_listed(v->sig_hash) ||
+	    !digsig_key_tag_live(v->key))
+		return 0;
+	ACCESS_ONCE(v->generation) = gen;
+	return 1;
+}
+
+/*
+ * Have every verdict checked against the revocation list and the keys,
+ * lazily, on its next lookup.
+ */
+void digsig_inode_invalidate_all(void)
+{
+	/* whatever made the verdicts stale is visible before the bump */
+	smp_mb__before_atomic_inc();
+	atomic_inc(&digsig_verdict_generation);
+}
+
+void digsig_inode_free(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = inode->i_security;
+
+	digsig_reflink_forget(inode);
+	inode->i_security = NULL;
+	if (isec) {
+		kfree(isec->resume);
+		kfree(isec->digest);
+		kfree(isec->segments);
+		kmem_cache_free(digsig_inode_cachep, isec);
+	}
+}
+
+int __init digsig_init_inode(void)
+{
+	digsig_inode_cachep = KMEM_CACHE(digsig_inode_sec, 0);
+	if (!digsig_inode_cachep) {
+		DSM_ERROR("%s: cannot create inode blob cache\n", __func__);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void digsig_inode_cleanup(void)
+{
+	kmem_cache_destroy(digsig_inode_cachep);
+}
@@ -0,0 +1,255 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the per-inode security blob.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_INODE_H
+#define _DIGSIG_INODE_H
+
+#include <linux/fs.h>
+#include <linux/bitops.h>
+#include <linux/atomic.h>
+
+#include "digsig_sb.h"
+
+#define DIGSIG_KEY_ID_SIZE 8
+
+struct digsig_resume;
+struct digsig_digest;
+struct digsig_reflink;
+struct digsig_segments_map;
+
+/* bits in digsig_inode_sec->flags */
+#define DIGSIG_INODE_VERIFIED 0
+#define DIGSIG_INODE_LAZY 1
+#define DIGSIG_INODE_BAD 2
+#define DIGSIG_INODE_UNCOUNTED 3
+#define DIGSIG_INODE_CACHED 4
+#define DIGSIG_INODE_DENIED 5
+#define DIGSIG_INODE_AUDIT 6
+#define DIGSIG_INODE_STAMPED 7
+#define DIGSIG_INODE_SEGMENTS 8
+
+/*
+ * digsig_verdict: what a verdict was made under.
+ * @generation: digsig_verdict_gen() from before the revocation list was
+ *	looked at.
+ * @sig_hash: revocation hash of the signature that was verified, 0 if
+ *	it is not known.  Once the generation moves on, the verdict still
+ *	stands as long as no revoked signature has that hash.
+ * @key: tag of the key added by key ID that verified the signature, 0
+ *	for the others; the verdict stands only until that key is retired.
+ */
+struct digsig_verdict {
+	unsigned int generation;
+	u32 sig_hash;
+	u32 key;
+};
+
+/*
+ * digsig_inode_sec: what DigSig knows about an inode, hung off
+ * inode->i_security.  It is only allocated for inodes that were mapped
+ * for execution, so an inode without one has no writer count and no
+ * verdict.
+ *
+ * @writers: number of open files that mapped the inode for execution.
+ *	Each of them also holds a deny_write_access() reference on the
+ *	inode, so that it can not be opened for writing meanwhile.
+ * @flags: DIGSIG_INODE_VERIFIED once the signature was found valid,
+ *	DIGSIG_INODE_LAZY while its chunks are checked in the background,
+ *	DIGSIG_INODE_BAD once they were found not to match,
+ *	DIGSIG_INODE_UNCOUNTED once it was mapped for execution without a
+ *	writer count, because it could not be written at the time,
+ *	DIGSIG_INODE_CACHED while sig_cache may hold an entry for it, so
+ *	that inodes without one are written without a cache lookup,
+ *	DIGSIG_INODE_DENIED once it was found not to be ELF, unsigned or
+ *	not to match its signature, so that it is not read again,
+ *	DIGSIG_INODE_AUDIT while it is verified in the background in
+ *	audit mode, DIGSIG_INODE_STAMPED while it may carry the
+ *	security.digsig stamp, so that it is removed before the inode is
+ *	written, DIGSIG_INODE_SEGMENTS once @segments tells whether it was
+ *	signed by segment.
+ * @verdict: what the verdict was made under.
+ * @denied: for a DIGSIG_INODE_DENIED inode, what the check returned,
+ *	and the generation and i_version it was made under; kept apart
+ *	from @verdict, which a racing lookup may still be reading.
+ * @version: inode->i_version when the verdict was made.  On filesystems
+ *	mounted with i_version, as IMA and EVM use it, a verdict is also
+ *	stale once the inode changed, however it was written; so it is
+ *	on NFSv4, once the change attribute of the server moved.
+ * @key_id: identifies the public key that made the verdict.
+ * @resume: the hash progress of a verification that was interrupted,
+ *	NULL if there is none; see digsig_resume.c.
+ * @digest: the digest of the file as it was last hashed, NULL if none
+ *	is kept; read under RCU, see digsig_digest.c.
+ * @reflink: the digest kept by the extents of the file, for its
+ *	reflinked copies, NULL if none; see digsig_reflink.c.
+ * @segments: the pages a segment signature is of, the only ones that
+ *	may be mapped for execution, NULL for a file signed whole; read
+ *	under RCU, see digsig_segments.c.
+ */
+struct digsig_inode_sec {
+	atomic_t writers;
+	unsigned long flags;
+	struct digsig_verdict verdict;
+	u64 version;
+	struct {
+		unsigned int generation;
+		int result;
+		u64 version;
+	} denied;
+	u8 key_id[DIGSIG_KEY_ID_SIZE];
+	struct digsig_resume *resume;
+	struct digsig_digest *digest;
+	struct digsig_reflink *reflink;
+	struct digsig_segments_map *segments;
+};
+
+extern atomic_t digsig_verdict_generation;
+
+/*
+ * The generation a verdict about to be made belongs to, read before the
+ * revocation list is looked at: a signature revoked after that makes the
+ * verdict stale as soon as it is recorded.
+ */
+static inline unsigned int digsig_verdict_gen(void)
+{
+	unsigned int gen = atomic_read(&digsig_verdict_generation);
+
+	smp_rmb();
+	return gen;
+}
+
+int digsig_verdict_recheck(struct digsig_verdict *v);
+
+/*
+ * Does the verdict still stand?  Only when the revocation list changed
+ * since it was made does this look at the list.
+ */
+static inline int digsig_verdict_current(struct digsig_verdict *v)
+{
+	if (ACCESS_ONCE(v->generation) == atomic_read(&digsig_verdict_generation))
+		return 1;
+	return digsig_verdict_recheck(v);
+}
+
+static inline struct digsig_inode_sec *digsig_inode_sec(struct inode *inode)
+{
+	return ACCESS_ONCE(inode->i_security);
+}
+
+/* Does i_version tell when the inode changed, for its verdicts? */
+static inline int digsig_inode_versioned(struct inode *inode)
+{
+	return IS_I_VERSION(inode) || digsig_sb_change_attr(inode->i_sb);
+}
+
+/*
+ * Seconds within which a file changed may be written again without its
+ * change time moving, on filesystems with coarse timestamps.
+ */
+#define DIGSIG_CTIME_SETTLE 2
+
+/*
+ * Would a write to the file now move its change time?  Until then, a
+ * verdict on it is only kept in the inode blob, which writers clear,
+ * and not where its times alone would have to tell it stale.
+ */
+static inline int digsig_ctime_settled(struct inode *inode)
+{
+	struct timespec now = current_fs_time(inode->i_sb);
+
+	return now.tv_sec - inode->i_ctime.tv_sec >= DIGSIG_CTIME_SETTLE;
+}
+
+/*
+ * Is there a current verdict for the inode?  This is the cache lookup
+ * of the mmap hook: no hashing, no lock.
+ */
+static inline int digsig_inode_verified(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (!isec || !test_bit(DIGSIG_INODE_VERIFIED, &isec->flags))
+		return 0;
+	smp_rmb();
+	if (digsig_inode_versioned(inode) && isec->version != inode->i_version)
+		return 0;
+	return digsig_verdict_current(&isec->verdict);
+}
+
+/*
+ * Is the verdict on the inode still being made in the background?
+ * Return 1 if it may be mapped meanwhile, -EPERM if its chunks did not
+ * match, 0 if there is no such verdict.
+ */
+static inline int digsig_inode_deferred(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (!isec)
+		return 0;
+	if (test_bit(DIGSIG_INODE_BAD, &isec->flags))
+		return -EPERM;
+	return test_bit(DIGSIG_INODE_LAZY, &isec->flags);
+}
+
+/*
+ * Was the inode found not to be ELF, unsigned, or not to match its
+ * signature?  The revocation list changing only makes such a verdict
+ * harsher, but the verdict is still dropped then, like the others.
+ * Return 1 and set *result to what the check returned, 0 otherwise.
+ */
+static inline int digsig_inode_denied(struct inode *inode, int *result)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (!isec || !test_bit(DIGSIG_INODE_DENIED, &isec->flags))
+		return 0;
+	smp_rmb();
+	if (digsig_inode_versioned(inode) &&
+	    isec->denied.version != inode->i_version)
+		return 0;
+	if (isec->denied.generation != atomic_read(&digsig_verdict_generation))
+		return 0;
+	*result = isec->denied.result;
+	return 1;
+}
+
+/* May sig_cache hold an entry for the inode? */
+static inline int digsig_inode_cached(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	return isec && test_bit(DIGSIG_INODE_CACHED, &isec->flags);
+}
+
+static inline void digsig_inode_invalidate(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (isec) {
+		clear_bit(DIGSIG_INODE_VERIFIED, &isec->flags);
+		clear_bit(DIGSIG_INODE_BAD, &isec->flags);
+		clear_bit(DIGSIG_INODE_DENIED, &isec->flags);
+	}
+}
+
+struct digsig_inode_sec *digsig_inode_get(struct inode *inode);
+void digsig_inode_set_verified(struct inode *inode,
+			       struct digsig_verdict verdict);
+void digsig_inode_set_denied(struct inode *inode, unsigned int generation,
+			     int result);
+void digsig_inode_invalidate_all(void);
+void digsig_inode_free(struct inode *inode);
+int digsig_init_inode(void);
+void digsig_inode_cleanup(void);
+
+#endif /* _DIGSIG_INODE_H */
@@ -0,0 +1,214 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the trusted installers: the processes registered by
+ * writing 1 to /sys/kernel/security/digsig/installer, until they exit
+ * or write 0.  The signed ELF files an installer, or a process it
+ * started, writes are verified as soon as their last writer closes
+ * them, in bulk, rather than a while later at the lowest priority as
+ * dsi_preload_on_write verifies the others: the pages just written are
+ * hashed from the page cache, with no read of the disk, and the first
+ * exec finds the verdict made, as does a deploy that runs what it just
+ * copied.  With the digests kept, a verdict dropped since is made again
+ * with the signature operation alone.
+ *
+ * Reading the file lists the process IDs registered.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/sched.h>
+#include <linux/pid.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/err.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_installer.h"
+
+/* installers registered at once */
+#define DIGSIG_INSTALLERS_MAX 16
+
+/* ancestors of a task looked at for an installer */
+#define DIGSIG_INSTALLER_DEPTH 16
+
+static struct pid *digsig_installers[DIGSIG_INSTALLERS_MAX];
+static int digsig_installers_count;
+static DEFINE_SPINLOCK(digsig_installers_lock);
+
+/* the slot of a thread group, -1 if it is not registered */
+static int digsig_installer_slot(struct pid *tgid)
+{
+	int i;
+
+	for (i = 0; i < DIGSIG_INSTALLERS_MAX; i++)
+		if (ACCESS_ONCE(digsig_installers[i]) == tgid)
+			return i;
+	return -1;
+}
+
+/* drop the installers that exited, under digsig_installers_lock */
+static void digsig_installers_prune(void)
+{
+	int i;
+
+	for (i = 0; i < DIGSIG_INSTALLERS_MAX; i++) {
+		if (!digsig_installers[i] ||
+		    pid_task(digsig_installers[i], PIDTYPE_PID))
+			continue;
+		put_pid(digsig_installers[i]);
+		digsig_installers[i] = NULL;
+		digsig_installers_count--;
+	}
+}
+
+/******************************************************************************
+Description : Is the current task a trusted installer, or started by one?
+	The struct pids compared may be put meanwhile, but are only freed
+	after a grace period.
+Parameters  : none
+Return value: 1 if it is, 0 otherwise
+******************************************************************************/
+int digsig_installer_current(void)
+{
+	struct task_struct *t = current, *parent;
+	int depth, found = 0;
+
+	if (!ACCESS_ONCE(digsig_installers_count))
+		return 0;
+
+	rcu_read_lock();
+	for (depth = 0; depth < DIGSIG_INSTALLER_DEPTH && !found; depth++) {
+		found = digsig_installer_slot(task_tgid(t)) >= 0;
+		parent = rcu_dereference(t->real_parent);
+		if (parent == t || is_global_init(t))
+			break;
+		t = parent;
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+static int digsig_installer_register(void)
+{
+	struct pid *tgid = get_pid(task_tgid(current));
+	int i, rc = -ENOSPC;
+
+	spin_lock(&digsig_installers_lock);
+	digsig_installers_prune();
+	if (digsig_installer_slot(tgid) >= 0) {
+		rc = 0;
+	} else {
+		for (i = 0; i < DIGSIG_INSTALLERS_MAX; i++)
+			if (!digsig_installers[i])
+				break;
+		if (i < DIGSIG_INSTALLERS_MAX) {
+			digsig_installers[i] = tgid;
+			digsig_installers_count++;
+			tgid = NULL;
+			rc = 0;
+		}
+	}
+	spin_unlock(&digsig_installers_lock);
+	put_pid(tgid);
+	return rc;
+}
+
+static void digsig_installer_unregister(void)
+{
+	struct pid *tgid = NULL;
+	int i;
+
+	spin_lock(&digsig_installers_lock);
+	i = digsig_installer_slot(task_tgid(current));
+	if (i >= 0) {
+		tgid = digsig_installers[i];
+		digsig_installers[i] = NULL;
+		digsig_installers_count--;
+	}
+	digsig_installers_prune();
+	spin_unlock(&digsig_installers_lock);
+	put_pid(tgid);
+}
+
+static ssize_t digsig_installer_write(struct file *file,
+				      const char __user *ubuf, size_t count,
+				      loff_t *ppos)
+{
+	char c;
+	int rc;
+
+	if (!count)
+		return -EINVAL;
+	if (get_user(c, ubuf))
+		return -EFAULT;
+
+	switch (c) {
+	case '1':
+		rc = digsig_installer_register();
+		if (rc)
+			return rc;
+		DSM_PRINT(DEBUG_SIGN, "%s: %s (%d) registered\n", __func__,
+			  current->comm, task_tgid_vnr(current));
+		break;
+	case '0':
+		digsig_installer_unregister();
+		break;
+	default:
+		return -EINVAL;
+	}
+	return count;
+}
+
+static int digsig_installer_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	spin_lock(&digsig_installers_lock);
+	digsig_installers_prune();
+	for (i = 0; i < DIGSIG_INSTALLERS_MAX; i++)
+		if (digsig_installers[i])
+			seq_printf(m, "%d\n", pid_vnr(digsig_installers[i]));
+	spin_unlock(&digsig_installers_lock);
+	return 0;
+}
+
+static int digsig_installer_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_installer_show, NULL);
+}
+
+static const struct file_operations digsig_installer_fops = {
+	.open = digsig_installer_open,
+	.read = seq_read,
+	.write = digsig_installer_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/installer.
+Parameters  : none
+Return value: 0 on success, negative otherwise; no process is then an
+	installer
+******************************************************************************/
+int __init digsig_init_installer(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+	d = securityfs_create_file("installer", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_installer_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
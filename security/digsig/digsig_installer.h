@@ -0,0 +1,25 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the trusted installers, whose files are verified
+ * as soon as they are written.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_INSTALLER_H
+#define _DIGSIG_INSTALLER_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_INSTALLER
+int digsig_installer_current(void);
+int digsig_init_installer(void);
+#else
+#define digsig_installer_current() 0
+#define digsig_init_installer() 0
+#endif
+
+#endif /* _DIGSIG_INSTALLER_H */
@@ -0,0 +1,220 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file gives the reads of a verification the priority of what
+ * waits for it.  A task mapping a file for exec is stopped until the
+ * file is read through, so its reads are served as best-effort level 0
+ * for the verification, ahead of the bulk I/O of the class.  The
+ * verifications nothing waits for yet, those of the preload manifest,
+ * of files written and closed, of directory trees and queries, of the
+ * rechecks, audits and deferred chunks, and the warm-up, read in the
+ * idle class, served once the disk has nothing else to do, and hash in
+ * SCHED_IDLE, on the CPU time nothing else wants.
+ *
+ * The priorities are those of the task that reads: the class of its
+ * I/O context, which CFQ looks at for each request, and its policy,
+ * both put back once the verification is done, as the worker threads
+ * are shared with other work.  A task whose own class is idle or real
+ * time is left the class it has.
+ *
+ * A task that maps a file a background verification is reading waits
+ * for its verdict, see digsig_inflight_begin(): it raises that worker
+ * to the priorities of an exec for the rest of the verification, so
+ * that the exec does not wait for the disk to be idle.
+ *
+ * With dsi_ioprio=0 the priorities are left alone.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/iocontext.h>
+#include <linux/ioprio.h>
+
+#include "digsig_common.h"
+#include "digsig_ioprio.h"
+
+static int dsi_ioprio = 1;
+module_param(dsi_ioprio, int, 0);
+MODULE_PARM_DESC(dsi_ioprio, "Read files for exec first, and in the background when the disk is idle.\n");
+
+#define DIGSIG_IOPRIO_SYNC IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 0)
+#define DIGSIG_IOPRIO_IDLE IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+
+/*
+ * Only the background verifications running right now are listed, a
+ * handful at most, and the list is only looked at by a task about to
+ * wait for one: a single lock is enough.
+ */
+static DEFINE_SPINLOCK(digsig_prio_lock);
+static LIST_HEAD(digsig_prio_background_list);
+
+static void digsig_prio_none(struct digsig_prio *p)
+{
+	p->task = NULL;
+	p->ioc = NULL;
+	p->ioprio = 0;
+	p->policy = -1;
+	p->promoted = 0;
+}
+
+/* the class the I/O of the task is served in */
+static int digsig_prio_class(struct task_struct *task, struct io_context *ioc)
+{
+	if (ioprio_valid(ioc->ioprio))
+		return IOPRIO_PRIO_CLASS(ioc->ioprio);
+	return task_nice_ioclass(task);
+}
+
+/* Set the I/O priority of the current task, keeping the one it had in P. */
+static void digsig_prio_set(struct digsig_prio *p, int ioprio)
+{
+	p->ioc = get_task_io_context(current, GFP_NOIO, NUMA_NO_NODE);
+	if (!p->ioc)
+		return;
+	p->ioprio = p->ioc->ioprio;
+	p->ioc->ioprio = ioprio;
+}
+
+/******************************************************************************
+Description : Serve the reads of the current task first, for a
+	verification something waits for, if the task is of the
+	best-effort class.
+Parameters  :
+	@p: where the priority to put back is kept
+Return value: none
+******************************************************************************/
+void digsig_prio_sync(struct digsig_prio *p)
+{
+	struct io_context *ioc;
+
+	digsig_prio_none(p);
+	if (!dsi_ioprio)
+		return;
+	ioc = get_task_io_context(current, GFP_NOIO, NUMA_NO_NODE);
+	if (!ioc)
+		return;
+	if (digsig_prio_class(current, ioc) == IOPRIO_CLASS_BE)
+		digsig_prio_set(p, DIGSIG_IOPRIO_SYNC);
+	put_io_context(ioc);
+}
+
+/******************************************************************************
+Description : Move the current task to the idle I/O class and to
+	SCHED_IDLE, for a verification nothing waits for yet.
+Parameters  :
+	@p: where the priorities to put back are kept
+Return value: none
+******************************************************************************/
+void digsig_prio_background(struct digsig_prio *p)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	digsig_prio_none(p);
+	if (!dsi_ioprio)
+		return;
+	digsig_prio_set(p, DIGSIG_IOPRIO_IDLE);
+	if (current->policy == SCHED_NORMAL || current->policy == SCHED_BATCH) {
+		p->policy = current->policy;
+		sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+	}
+
+	p->task = current;
+	spin_lock(&digsig_prio_lock);
+	list_add(&p->node, &digsig_prio_background_list);
+	spin_unlock(&digsig_prio_lock);
+}
+
+/******************************************************************************
+Description : The I/O priority of the current task, to be handed to a
+	worker reading for it.
+Parameters  : none
+Return value: the priority, 0 if the task has none of its own
+******************************************************************************/
+int digsig_prio_current(void)
+{
+	struct io_context *ioc = current->io_context;
+
+	return dsi_ioprio && ioc ? ioc->ioprio : 0;
+}
+
+/******************************************************************************
+Description : Read at the I/O priority of the task the current one works
+	for.
+Parameters  :
+	@p: where the priority to put back is kept
+	@ioprio: digsig_prio_current() of that task
+Return value: none
+******************************************************************************/
+void digsig_prio_inherit(struct digsig_prio *p, int ioprio)
+{
+	digsig_prio_none(p);
+	if (ioprio_valid(ioprio))
+		digsig_prio_set(p, ioprio);
+}
+
+/******************************************************************************
+Description : Raise a task verifying in the background to the priority
+	of an exec, as the current task is about to wait for it.  A task
+	waiting in the background itself leaves it be.
+Parameters  :
+	@owner: the task verifying the file, which can not exit meanwhile
+Return value: none
+******************************************************************************/
+void digsig_prio_promote(struct task_struct *owner)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	struct digsig_prio *p;
+
+	if (!dsi_ioprio || owner == current)
+		return;
+
+	spin_lock(&digsig_prio_lock);
+	list_for_each_entry(p, &digsig_prio_background_list, node)
+		if (p->task == current)
+			goto out;
+	list_for_each_entry(p, &digsig_prio_background_list, node) {
+		if (p->task != owner || p->promoted)
+			continue;
+		p->promoted = 1;
+		if (p->ioc)
+			p->ioc->ioprio = DIGSIG_IOPRIO_SYNC;
+		if (p->policy >= 0)
+			sched_setscheduler_nocheck(owner, p->policy, &param);
+		DSM_PRINT(DEBUG_SIGN, "%s: %s/%d raised for an exec\n",
+			  __func__, owner->comm, task_pid_nr(owner));
+	}
+out:
+	spin_unlock(&digsig_prio_lock);
+}
+
+/******************************************************************************
+Description : Put back the priorities digsig_prio_sync(),
+	digsig_prio_background() or digsig_prio_inherit() changed.
+Parameters  :
+	@p: the priorities kept
+Return value: none
+******************************************************************************/
+void digsig_prio_restore(struct digsig_prio *p)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (p->task) {
+		spin_lock(&digsig_prio_lock);
+		list_del(&p->node);
+		spin_unlock(&digsig_prio_lock);
+	}
+	if (p->policy >= 0)
+		sched_setscheduler_nocheck(current, p->policy, &param);
+	if (p->ioc) {
+		p->ioc->ioprio = p->ioprio;
+		put_io_context(p->ioc);
+	}
+}
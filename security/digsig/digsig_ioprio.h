@@ -0,0 +1,50 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the priorities verifications read and run at.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_IOPRIO_H
+#define _DIGSIG_IOPRIO_H
+
+#include <linux/list.h>
+#include <linux/sched.h>
+
+/*
+ * digsig_prio: what a task had before a verification changed its
+ * priorities, put back by digsig_prio_restore().  The tasks verifying
+ * in the background are listed, so that a task waiting for one of them
+ * can raise it.
+ */
+struct digsig_prio {
+	struct list_head node;
+	struct task_struct *task;	/* if listed */
+	struct io_context *ioc;
+	int ioprio;
+	int policy;			/* -1 if left alone */
+	int promoted;
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_IOPRIO
+void digsig_prio_sync(struct digsig_prio *p);
+void digsig_prio_background(struct digsig_prio *p);
+int digsig_prio_current(void);
+void digsig_prio_inherit(struct digsig_prio *p, int ioprio);
+void digsig_prio_promote(struct task_struct *owner);
+void digsig_prio_restore(struct digsig_prio *p);
+#else
+#define digsig_prio_sync(p) ((void)(p))
+#define digsig_prio_background(p) ((void)(p))
+#define digsig_prio_current() 0
+#define digsig_prio_inherit(p, ioprio) ((void)(p), (void)(ioprio))
+#define digsig_prio_promote(owner) do { } while (0)
+#define digsig_prio_restore(p) ((void)(p))
+#endif
+
+#endif /* _DIGSIG_IOPRIO_H */
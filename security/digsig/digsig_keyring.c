@@ -0,0 +1,172 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies signatures against the asymmetric keys of the
+ * ".digsig" keyring, through crypto/asymmetric_keys and lib/mpi, so
+ * that DigSig shares the RSA code (and its fixes) used for module and
+ * integrity signatures.  Keys are loaded with, for an X.509 certificate:
+ *
+ *	keyctl padd asymmetric "" %keyring:.digsig < cert.der
+ *
+ * A signature is checked against the key whose ID ends in the 8 byte
+ * key ID of its GPG packet.  Signatures without such a key fall back
+ * to the public key loaded through sysfs.  Keys are only taken until
+ * the hooks are on: the keyring is then sealed, so that root may not
+ * enrol a key of its own once DigSig enforces.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <linux/key.h>
+#include <linux/key-type.h>
+#include <linux/mpi.h>
+#include <crypto/public_key.h>
+#include <keys/asymmetric-type.h>
+
+#include "digsig_common.h"
+#include "digsig_keyring.h"
+
+#define DIGSIG_KEYID_SIZE 8
+
+static struct key *digsig_keyring;
+
+/* GPG digest algorithm numbers (RFC 4880, 9.4) */
+static int digsig_pkey_hash_algo(int pgp_hash_algo)
+{
+	switch (pgp_hash_algo) {
+	case 2:
+		return PKEY_HASH_SHA1;
+	case 8:
+		return PKEY_HASH_SHA256;
+	case 9:
+		return PKEY_HASH_SHA384;
+	case 10:
+		return PKEY_HASH_SHA512;
+	case 11:
+		return PKEY_HASH_SHA224;
+	}
+	return -ENOPKG;
+}
+
+static struct key *digsig_keyring_find(const u8 *keyid)
+{
+	char name[3 + 2 * DIGSIG_KEYID_SIZE + 1];
+	key_ref_t kref;
+
+	snprintf(name, sizeof(name), "id:%*phN", DIGSIG_KEYID_SIZE, keyid);
+
+	kref = keyring_search(make_key_ref(digsig_keyring, 1),
+			      &key_type_asymmetric, name);
+	if (IS_ERR(kref)) {
+		switch (PTR_ERR(kref)) {
+		case -EACCES:
+		case -ENOTDIR:
+		case -EAGAIN:
+			return ERR_PTR(-ENOKEY);
+		}
+		return ERR_CAST(kref);
+	}
+	return key_ref_to_ptr(kref);
+}
+
+/******************************************************************************
+Description : Verify a signature with the keyring key of its key ID.
+Parameters  :
+	@pgp_hash_algo: digest algorithm from the signature packet
+	@digest: the digest that was signed, greeting and trailer included
+	@digestlen: its length
+	@keyid: the 8 byte key ID from the signature packet
+	@sig_mpi: the signature MPI, in GPG format (bit count first)
+	@mpilen: bytes available at sig_mpi
+Return value: 0 if the signature is valid, -ENOKEY if no key of that ID
+	is loaded (the caller then uses the sysfs key), another negative
+	error if the signature is invalid or can not be checked
+******************************************************************************/
+int digsig_keyring_verify(int pgp_hash_algo, const u8 *digest, int digestlen,
+			  const u8 *keyid, const u8 *sig_mpi, int mpilen)
+{
+	struct public_key_signature pks;
+	struct key *key;
+	unsigned nread = mpilen;
+	int hash_algo, rc = -ENOMEM;
+
+	if (!digsig_keyring)
+		return -ENOKEY;
+
+	hash_algo = digsig_pkey_hash_algo(pgp_hash_algo);
+	if (hash_algo < 0)
+		return hash_algo;
+
+	key = digsig_keyring_find(keyid);
+	if (IS_ERR(key))
+		return PTR_ERR(key);
+
+	memset(&pks, 0, sizeof(pks));
+	pks.pkey_hash_algo = hash_algo;
+	pks.digest = (u8 *)digest;
+	pks.digest_size = digestlen;
+	pks.nr_mpi = 1;
+	pks.rsa.s = mpi_read_from_buffer(sig_mpi, &nread);
+
+	if (pks.rsa.s)
+		rc = verify_signature(key, &pks);
+
+	mpi_free(pks.rsa.s);
+	key_put(key);
+
+	DSM_PRINT(DEBUG_SIGN, "%s: keyring key %*phN: %d\n", __func__,
+		  DIGSIG_KEYID_SIZE, keyid, rc);
+	return rc;
+}
+
+/******************************************************************************
+Description : Create the ".digsig" keyring.
+Parameters  : none
+Return value: none; without the keyring only the sysfs key is used
+******************************************************************************/
+void __init digsig_init_keyring(void)
+{
+	struct key *keyring;
+
+	keyring = keyring_alloc(".digsig", KUIDT_INIT(0), KGIDT_INIT(0),
+				current_cred(),
+				(KEY_POS_ALL & ~KEY_POS_SETATTR) |
+				KEY_USR_VIEW | KEY_USR_READ |
+				KEY_USR_WRITE | KEY_USR_SEARCH,
+				KEY_ALLOC_NOT_IN_QUOTA, NULL);
+	if (IS_ERR(keyring)) {
+		DSM_ERROR("%s: cannot allocate keyring: %ld\n", __func__,
+			  PTR_ERR(keyring));
+		return;
+	}
+
+	digsig_keyring = keyring;
+}
+
+/******************************************************************************
+Description : Take no more keys in the ".digsig" keyring, nor let any be
+	unlinked: the hooks are on.  Its permissions can not be set back,
+	as it does not grant setattr.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_keyring_seal(void)
+{
+	struct key *keyring = digsig_keyring;
+
+	if (!keyring)
+		return;
+
+	down_write(&keyring->sem);
+	keyring->perm &= ~(KEY_POS_WRITE | KEY_USR_WRITE | KEY_GRP_WRITE |
+			   KEY_OTH_WRITE);
+	up_write(&keyring->sem);
+}
@@ -0,0 +1,34 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification against keys in the kernel keyring.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_KEYRING_H
+#define _DIGSIG_KEYRING_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+/*
+ * This header is shared by code built against DigSig's own MPI library
+ * and code built against lib/mpi, so it must not pull in either.
+ */
+#ifdef CONFIG_SECURITY_DIGSIG_KEYRING
+int digsig_keyring_verify(int pgp_hash_algo, const u8 *digest, int digestlen,
+			  const u8 *keyid, const u8 *sig_mpi, int mpilen);
+void digsig_init_keyring(void);
+void digsig_keyring_seal(void);
+#else
+#define digsig_keyring_verify(algo, digest, dlen, keyid, mpi, mlen) (-ENOKEY)
+#define digsig_init_keyring() do { } while (0)
+#define digsig_keyring_seal() do { } while (0)
+#endif
+
+#endif /* _DIGSIG_KEYRING_H */
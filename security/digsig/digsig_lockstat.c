@@ -0,0 +1,209 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file counts how much DigSig's own locks are fought over, so that
+ * the exec throughput lost to serialization can be measured: the lines
+ * of the verdict cache, the buckets of the recent records, and
+ * revoked_list_wlock.  Each place a lock is taken is counted apart:
+ *
+ * - acquired, and of those, contended, with the time spent waiting,
+ *   total and longest, or given up on when the caller defers instead;
+ * - held, the times the lock was let go with others waiting for it,
+ *   which tells what the holder was doing while they waited;
+ * - retried, for the read side of a seqlock, the lookups done again
+ *   because a writer went through the line meanwhile.
+ *
+ * The counters are kept per CPU and read, added up, from
+ * /sys/kernel/security/digsig/locks, which writing to clears.  Every
+ * wait is also reported by the digsig_lock_contended tracepoint.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+
+#include <trace/events/digsig.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_lockstat.h"
+
+struct digsig_lock_counters {
+	u64 acquired;
+	u64 contended;
+	u64 deferred;
+	u64 wait_ns;
+	u64 max_ns;
+	u64 held;
+	u64 retried;
+};
+
+static DEFINE_PER_CPU(struct digsig_lock_counters [DIGSIG_LOCK_SITES],
+		      digsig_lockstat);
+
+static const char *digsig_lock_sites[DIGSIG_LOCK_SITES] = {
+	[DIGSIG_LS_CACHE_LOOKUP] = "cache_lookup",
+	[DIGSIG_LS_CACHE_INSERT] = "cache_insert",
+	[DIGSIG_LS_CACHE_DRAIN] = "cache_drain",
+	[DIGSIG_LS_CACHE_REMOVE] = "cache_remove",
+	[DIGSIG_LS_CACHE_SWEEP] = "cache_sweep",
+	[DIGSIG_LS_CACHE_RESIZE] = "cache_resize",
+	[DIGSIG_LS_RECENT_LOOKUP] = "recent_lookup",
+	[DIGSIG_LS_RECENT_RECORD] = "recent_record",
+	[DIGSIG_LS_RECENT_FORGET] = "recent_forget",
+	[DIGSIG_LS_RECENT_INSERT] = "recent_insert",
+	[DIGSIG_LS_REVOKED_ADD] = "revoked_add",
+	[DIGSIG_LS_REVOKED_LIST] = "revoked_list",
+};
+
+/******************************************************************************
+Description : Count a lock taken, and the wait if there was one.
+Parameters  :
+	@site: one of DIGSIG_LS_*
+	@wait_start: local_clock() when the wait began, 0 if the lock was free
+Return value: none
+******************************************************************************/
+void digsig_lock_acquired(int site, u64 wait_start)
+{
+	struct digsig_lock_counters *c;
+	u64 ns = 0;
+
+	c = &get_cpu_var(digsig_lockstat)[site];
+	c->acquired++;
+	if (wait_start) {
+		ns = local_clock() - wait_start;
+		c->contended++;
+		c->wait_ns += ns;
+		if (ns > c->max_ns)
+			c->max_ns = ns;
+	}
+	put_cpu_var(digsig_lockstat);
+
+	if (wait_start)
+		trace_digsig_lock_contended(digsig_lock_sites[site], ns);
+}
+
+/* The lock was found taken and the caller went on without it. */
+void digsig_lock_deferred(int site)
+{
+	this_cpu_inc(digsig_lockstat[site].deferred);
+	trace_digsig_lock_contended(digsig_lock_sites[site], 0);
+}
+
+/* The lock was let go by @site with others waiting for it. */
+void digsig_lock_released(int site)
+{
+	this_cpu_inc(digsig_lockstat[site].held);
+}
+
+/* A reader at @site went through the line again. */
+void digsig_lock_retried(int site)
+{
+	this_cpu_inc(digsig_lockstat[site].retried);
+}
+
+static void digsig_lockstat_sum(int site, struct digsig_lock_counters *sum)
+{
+	struct digsig_lock_counters *c;
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		c = &per_cpu(digsig_lockstat, cpu)[site];
+		sum->acquired += c->acquired;
+		sum->contended += c->contended;
+		sum->deferred += c->deferred;
+		sum->wait_ns += c->wait_ns;
+		sum->max_ns = max(sum->max_ns, c->max_ns);
+		sum->held += c->held;
+		sum->retried += c->retried;
+	}
+}
+
+/******************************************************************************
+Description : Add up the waits of all the sites, for a run to report those
+	it caused.
+Parameters  :
+	@contended: the locks found taken
+	@wait_ns: the time waited for them
+Return value: none
+******************************************************************************/
+void digsig_lockstat_total(u64 *contended, u64 *wait_ns)
+{
+	struct digsig_lock_counters c;
+	int site;
+
+	*contended = *wait_ns = 0;
+	for (site = 0; site < DIGSIG_LOCK_SITES; site++) {
+		digsig_lockstat_sum(site, &c);
+		*contended += c.contended;
+		*wait_ns += c.wait_ns;
+	}
+}
+
+static int digsig_lockstat_show(struct seq_file *m, void *v)
+{
+	struct digsig_lock_counters c;
+	int site;
+
+	seq_puts(m, "# site acquired contended deferred wait_ns max_ns"
+		 " held retried\n");
+	for (site = 0; site < DIGSIG_LOCK_SITES; site++) {
+		digsig_lockstat_sum(site, &c);
+		seq_printf(m, "%s %llu %llu %llu %llu %llu %llu %llu\n",
+			   digsig_lock_sites[site], c.acquired, c.contended,
+			   c.deferred, c.wait_ns, c.max_ns, c.held, c.retried);
+	}
+	return 0;
+}
+
+static int digsig_lockstat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_lockstat_show, NULL);
+}
+
+/* Clear the counters; a lock taken meanwhile may stay counted. */
+static ssize_t digsig_lockstat_write(struct file *file, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(digsig_lockstat, cpu), 0,
+		       sizeof(per_cpu(digsig_lockstat, cpu)));
+	return count;
+}
+
+static const struct file_operations digsig_lockstat_fops = {
+	.open = digsig_lockstat_open,
+	.read = seq_read,
+	.write = digsig_lockstat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/locks.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_lockstat(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("locks", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_lockstat_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the contention counters of DigSig's locks.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_LOCKSTAT_H
+#define _DIGSIG_LOCKSTAT_H
+
+#include <linux/types.h>
+#include <linux/sched.h>
+#include <linux/seqlock.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+
+/* the places a lock is taken, each counted apart */
+#define DIGSIG_LS_CACHE_LOOKUP 0	/* cache line, read side */
+#define DIGSIG_LS_CACHE_INSERT 1	/* cache line, from the verifier */
+#define DIGSIG_LS_CACHE_DRAIN 2		/* cache line, deferred inserts */
+#define DIGSIG_LS_CACHE_REMOVE 3	/* cache line, file changed */
+#define DIGSIG_LS_CACHE_SWEEP 4		/* cache line, dead sb or key */
+#define DIGSIG_LS_CACHE_RESIZE 5	/* cache line, table resized */
+#define DIGSIG_LS_RECENT_LOOKUP 6	/* recent bucket, read side */
+#define DIGSIG_LS_RECENT_RECORD 7	/* recent bucket, file verified */
+#define DIGSIG_LS_RECENT_FORGET 8	/* recent bucket, file changed */
+#define DIGSIG_LS_RECENT_INSERT 9	/* recent bucket, handover */
+#define DIGSIG_LS_REVOKED_ADD 10	/* revoked_list_wlock, one more */
+#define DIGSIG_LS_REVOKED_LIST 11	/* revoked_list_wlock, new list */
+#define DIGSIG_LOCK_SITES 12
+
+#ifdef CONFIG_SECURITY_DIGSIG_LOCKSTAT
+void digsig_lock_acquired(int site, u64 wait_start);
+void digsig_lock_deferred(int site);
+void digsig_lock_released(int site);
+void digsig_lock_retried(int site);
+void digsig_lockstat_total(u64 *contended, u64 *wait_ns);
+int digsig_init_lockstat(void);
+
+static inline void digsig_write_seqlock(seqlock_t *sl, int site)
+{
+	u64 t = 0;
+
+	if (!spin_trylock(&sl->lock)) {
+		t = local_clock();
+		spin_lock(&sl->lock);
+	}
+	write_seqcount_begin(&sl->seqcount);
+	digsig_lock_acquired(site, t);
+}
+
+/* what holds a lock others wait for is counted as it lets go */
+static inline void digsig_write_sequnlock(seqlock_t *sl, int site)
+{
+	int waited = spin_is_contended(&sl->lock);
+
+	write_sequnlock(sl);
+	if (waited)
+		digsig_lock_released(site);
+}
+
+static inline int digsig_read_seqretry(const seqlock_t *sl, unsigned seq,
+				       int site)
+{
+	if (!read_seqretry(sl, seq))
+		return 0;
+	digsig_lock_retried(site);
+	return 1;
+}
+
+static inline void digsig_mutex_lock(struct mutex *m, int site)
+{
+	u64 t = 0;
+
+	if (!mutex_trylock(m)) {
+		t = local_clock();
+		mutex_lock(m);
+	}
+	digsig_lock_acquired(site, t);
+}
+
+static inline void digsig_mutex_unlock(struct mutex *m, int site)
+{
+	int waited = !list_empty(&m->wait_list);
+
+	mutex_unlock(m);
+	if (waited)
+		digsig_lock_released(site);
+}
+#else
+#define digsig_lock_acquired(site, wait_start) do { } while (0)
+#define digsig_lock_deferred(site) do { } while (0)
+#define digsig_lockstat_total(contended, wait_ns) \
+	do { *(contended) = *(wait_ns) = 0; } while (0)
+#define digsig_init_lockstat() 0
+#define digsig_write_seqlock(sl, site) write_seqlock(sl)
+#define digsig_write_sequnlock(sl, site) write_sequnlock(sl)
+#define digsig_read_seqretry(sl, seq, site) read_seqretry(sl, seq)
+#define digsig_mutex_lock(m, site) mutex_lock(m)
+#define digsig_mutex_unlock(m, site) mutex_unlock(m)
+#endif
+
+#endif /* _DIGSIG_LOCKSTAT_H */
@@ -0,0 +1,108 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the deferred log.  DSM_PRINT() and DSM_ERROR() do
+ * not printk() from the hooks: the message is formatted into a ring
+ * buffer, and a worker hands the buffered lines to printk() a tick
+ * later, so that a slow console never holds up an exec.  Each call site
+ * is rate limited on its own, and lines that find the buffer full are
+ * dropped and counted.
+ *
+ * The formatting itself still happens in the caller, the arguments
+ * (file names, mostly) do not outlive the call; it is cheap next to
+ * the console.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ratelimit.h>
+#include <linux/atomic.h>
+
+#include "digsig_common.h"
+
+#define DIGSIG_LOG_SIZE 16384	/* bytes of buffered lines, a power of 2 */
+#define DIGSIG_LOG_LINE 255	/* longest record of a kfifo_rec_1 */
+
+static int dsi_log_sync = 0;
+module_param(dsi_log_sync, int, 0);
+MODULE_PARM_DESC(dsi_log_sync, "Print DigSig messages at once instead of from a worker.\n");
+
+static STRUCT_KFIFO_REC_1(DIGSIG_LOG_SIZE) digsig_log_fifo = {
+	{
+		{
+			.in = 0,
+			.out = 0,
+			.mask = DIGSIG_LOG_SIZE - 1,
+			.esize = 1,
+			.data = digsig_log_fifo.buf,
+		}
+	}
+};
+static DEFINE_SPINLOCK(digsig_log_lock);
+static atomic_t digsig_log_dropped = ATOMIC_INIT(0);
+
+static void digsig_log_flush(struct work_struct *work)
+{
+	char line[DIGSIG_LOG_LINE + 1];
+	unsigned int len;
+	int dropped;
+
+	while ((len = kfifo_out_spinlocked(&digsig_log_fifo, line,
+					   DIGSIG_LOG_LINE, &digsig_log_lock)))
+		printk("%.*s", len, line);
+
+	dropped = atomic_xchg(&digsig_log_dropped, 0);
+	if (dropped)
+		printk(KERN_WARNING DIGSIG_MODULE_NAME
+		       ": %d log messages dropped\n", dropped);
+}
+
+static DECLARE_DELAYED_WORK(digsig_log_work, digsig_log_flush);
+
+/******************************************************************************
+Description : Log a message, through the ring buffer unless dsi_log_sync
+	is set.  Callers go through DSM_PRINT() and DSM_ERROR(), which give
+	each call site its rate limit.
+Parameters  :
+	@rs: rate limit of the call site
+	@func: the call site, named when its messages are suppressed
+	@fmt: printk format, with the level and prefix
+Return value: none
+******************************************************************************/
+void digsig_log(struct ratelimit_state *rs, const char *func,
+		const char *fmt, ...)
+{
+	char line[DIGSIG_LOG_LINE + 1];
+	unsigned long flags;
+	va_list args;
+	int len;
+
+	if (!___ratelimit(rs, func))
+		return;
+
+	va_start(args, fmt);
+	if (dsi_log_sync) {
+		vprintk(fmt, args);
+		va_end(args);
+		return;
+	}
+	len = vscnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+
+	spin_lock_irqsave(&digsig_log_lock, flags);
+	if (!kfifo_in(&digsig_log_fifo, line, len))
+		atomic_inc(&digsig_log_dropped);
+	spin_unlock_irqrestore(&digsig_log_lock, flags);
+
+	/* a no-op while a flush is pending, so lines are printed in batches */
+	schedule_delayed_work(&digsig_log_work, 1);
+}
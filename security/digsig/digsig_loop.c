@@ -0,0 +1,162 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file trusts the files of a read-only filesystem image mounted
+ * from a loop device once the image file itself is found signed, as
+ * packages and container layers shipped as images are: the signature
+ * of the image covers every byte the filesystem reads, so verifying
+ * the executables inside it one by one proves nothing more.
+ *
+ * The image is signed as a file that is not ELF, with a detached
+ * signature, see digsig_detached.c.  It is verified the first time a
+ * file of the mount is mapped for execution, with its pages hashed as
+ * they stream past rather than kept in the page cache, and its verdict
+ * is then kept on its inode like that of any other file: the mount is
+ * trusted for as long as that verdict stands.  The image is held
+ * against writing from the mount to its unmount, as the files mapped
+ * for execution are, since the pages of the files of the mount are
+ * read back from it once evicted; an image open for writing when it
+ * is mounted is not trusted.  One whose signature was revoked, or
+ * whose key was retired, is verified again on the next lookup.
+ *
+ * Only a mount that is read-only, of a loop device bound read-only to
+ * the whole of the image, without offset, size limit or transfer
+ * function, is trusted, and the loop device is looked at again on each
+ * lookup: LOOP_SET_STATUS can change it while the image is mounted.
+ * An image found unsigned is not verified again until the next
+ * revocation.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/blkdev.h>
+#include <linux/genhd.h>
+#include <linux/major.h>
+#include <linux/loop.h>
+
+#include "../../drivers/block/loop.h"
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_sb.h"
+#include "digsig_preload.h"
+#include "digsig_loop.h"
+
+/* The loop device under @sb, if it maps the whole of a file as it is. */
+static struct loop_device *digsig_loop_device(struct super_block *sb)
+{
+	struct block_device *bdev = sb->s_bdev;
+	struct loop_device *lo;
+
+	if (!bdev || MAJOR(bdev->bd_dev) != LOOP_MAJOR || !bdev->bd_disk ||
+	    bdev != bdev->bd_contains)
+		return NULL;
+	lo = bdev->bd_disk->private_data;
+	if (!lo || ACCESS_ONCE(lo->lo_state) != Lo_bound ||
+	    !(ACCESS_ONCE(lo->lo_flags) & LO_FLAGS_READ_ONLY) ||
+	    ACCESS_ONCE(lo->lo_offset) || ACCESS_ONCE(lo->lo_sizelimit) ||
+	    ACCESS_ONCE(lo->lo_encryption) ||
+	    ACCESS_ONCE(lo->lo_encrypt_key_size))
+		return NULL;
+	return lo;
+}
+
+/******************************************************************************
+Description : Note the image under a superblock being mounted, if it is on
+	a loop device that could be trusted from it.
+Parameters  :
+	@sb: the superblock, its DigSig data computed
+Return value: none
+******************************************************************************/
+void digsig_loop_mount(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct loop_device *lo;
+	struct file *image;
+
+	if (!sbsec || sbsec->loop_file || !(sb->s_flags & MS_RDONLY))
+		return;
+	lo = digsig_loop_device(sb);
+	if (!lo)
+		return;
+	/* the device stays bound to it while it is mounted */
+	image = lo->lo_backing_file;
+	if (!image || !S_ISREG(file_inode(image)->i_mode))
+		return;
+
+	/* not written to for as long as the mount may be trusted */
+	if (deny_write_access(image)) {
+		DSM_PRINT(DEBUG_SIGN, "%s: the image of %s is open for writing\n",
+			  __func__, sb->s_id);
+		return;
+	}
+	get_file(image);
+	if (cmpxchg(&sbsec->loop_file, NULL, image)) {
+		allow_write_access(image);
+		fput(image);
+	} else
+		DSM_PRINT(DEBUG_SIGN, "%s: %s is an image on loop%d\n",
+			  __func__, sb->s_id, lo->lo_number);
+}
+
+/******************************************************************************
+Description : May the files of a superblock be trusted from the signature
+	of the image it was mounted from?
+Parameters  :
+	@sb: the superblock of a file about to be mapped for execution
+Return value: 1 if the file need not be verified, 0 otherwise
+******************************************************************************/
+int digsig_loop_trusted(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct loop_device *lo;
+	struct file *image;
+	unsigned int gen;
+
+	if (!sbsec || !(image = ACCESS_ONCE(sbsec->loop_file)) ||
+	    !(sb->s_flags & MS_RDONLY))
+		return 0;
+	lo = digsig_loop_device(sb);
+	if (!lo || ACCESS_ONCE(lo->lo_backing_file) != image)
+		return 0;
+	if (digsig_inode_verified(file_inode(image)))
+		return 1;
+
+	/* tried since the last revocation, and found unsigned or invalid */
+	gen = digsig_verdict_gen() + 1;
+	if (ACCESS_ONCE(sbsec->loop_gen) == gen)
+		return 0;
+
+	/* the other files of the mount wait for this verification */
+	digsig_verify_file_stream(image);
+	if (digsig_inode_verified(file_inode(image))) {
+		DSM_PRINT(DEBUG_SIGN, "%s: the image of %s is signed\n",
+			  __func__, sb->s_id);
+		return 1;
+	}
+	ACCESS_ONCE(sbsec->loop_gen) = gen;
+	return 0;
+}
+
+/******************************************************************************
+Description : Let go of the image of a superblock going away.
+Parameters  :
+	@sbsec: the DigSig data of the superblock
+Return value: none
+******************************************************************************/
+void digsig_loop_free(struct digsig_sb_sec *sbsec)
+{
+	struct file *image = xchg(&sbsec->loop_file, NULL);
+
+	if (image) {
+		allow_write_access(image);
+		fput(image);
+	}
+}
@@ -0,0 +1,30 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the trust in signed loop images.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_LOOP_H
+#define _DIGSIG_LOOP_H
+
+#include <linux/fs.h>
+
+#include "digsig_sb.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_LOOP
+void digsig_loop_mount(struct super_block *sb);
+int digsig_loop_trusted(struct super_block *sb);
+void digsig_loop_free(struct digsig_sb_sec *sbsec);
+#else
+#define digsig_loop_mount(sb) do { } while (0)
+#define digsig_loop_trusted(sb) 0
+#define digsig_loop_free(sbsec) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_LOOP_H */
@@ -0,0 +1,337 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the digests of files listed in signed manifests.  A
+ * manifest is signed once with the DigSig key, often for all the files
+ * of a package, and a file whose digest it lists is let through on
+ * that digest alone: the per-file public key operation is skipped, or
+ * the file need not be signed at all.
+ *
+ * The digests of every manifest loaded are merged, straight from the
+ * manifests written and the table in force, into one table in
+ * Eytzinger order: the root at 1, the children of k at 2k and 2k + 1,
+ * so that a search goes down the array rather than jumping about it.
+ * Beside the digests, an array of their first four bytes is searched
+ * first: the 16 descendants four levels below a node share a cache
+ * line of it, which is fetched while the node is compared, and the
+ * digests themselves are only read on a match of the prefix.  A search
+ * of millions of digests then waits on a couple of cache misses, the
+ * top of the array staying cached.
+ *
+ * The table is looked up under RCU and replaced whole.  Manifests are
+ * only ever added; the negative verdicts made before one was loaded
+ * are dropped then.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/prefetch.h>
+#include <linux/cache.h>
+#include <asm/unaligned.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_inode.h"
+#include "digsig_manifest.h"
+
+/*
+ * digsig_manifest_table: the digests listed, in Eytzinger order from 1,
+ * and the first four bytes of each, big-endian, in the same order.
+ */
+struct digsig_manifest_table {
+	u32 count;
+	u32 *prefix;
+	u8 (*digests)[DIGSIG_MANIFEST_DIGEST_SIZE];
+};
+
+/* the prefixes in one cache line, the descendants four levels down */
+#define DIGSIG_MANIFEST_FANOUT (L1_CACHE_BYTES / sizeof(u32))
+
+static struct digsig_manifest_table __rcu *digsig_manifest;
+int digsig_manifest_count;
+
+/* the manifest being written, which may take several writes */
+static DEFINE_MUTEX(digsig_manifest_mutex);
+static char *manifest_buf;
+static size_t manifest_size, manifest_len;
+
+static int digsig_manifest_cmp(const void *key, const void *elt)
+{
+	return memcmp(key, elt, DIGSIG_MANIFEST_DIGEST_SIZE);
+}
+
+/* The slot of the smallest digest of an Eytzinger array of n, 0 if empty. */
+static u32 digsig_eytz_first(u32 n)
+{
+	u32 k = n ? 1 : 0;
+
+	while (k && 2 * k <= n)
+		k *= 2;
+	return k;
+}
+
+/* The slot of the digest after that of slot k, 0 after the last one. */
+static u32 digsig_eytz_next(u32 k, u32 n)
+{
+	if (2 * k + 1 <= n) {
+		k = 2 * k + 1;
+		while (2 * k <= n)
+			k *= 2;
+		return k;
+	}
+	while (k & 1)
+		k >>= 1;
+	return k >> 1;
+}
+
+/******************************************************************************
+Description : Is the digest listed in a manifest?
+Parameters  :
+	@digest: the SHA-256 digest of a file, as a "#2;" signature signs it
+Return value: 1 if it is, 0 otherwise
+******************************************************************************/
+int digsig_manifest_listed(const u8 *digest)
+{
+	struct digsig_manifest_table *t;
+	u32 key = get_unaligned_be32(digest), k = 1;
+	int cmp, found = 0;
+
+	rcu_read_lock();
+	t = rcu_dereference(digsig_manifest);
+	while (t && k <= t->count) {
+		if (DIGSIG_MANIFEST_FANOUT * k <= t->count)
+			prefetch(&t->prefix[DIGSIG_MANIFEST_FANOUT * k]);
+		if (t->prefix[k] != key)
+			cmp = t->prefix[k] < key ? -1 : 1;
+		else
+			cmp = memcmp(t->digests[k], digest,
+				     DIGSIG_MANIFEST_DIGEST_SIZE);
+		if (!cmp) {
+			found = 1;
+			break;
+		}
+		k = 2 * k + (cmp < 0);
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+static struct digsig_manifest_table *digsig_manifest_alloc(u32 count)
+{
+	struct digsig_manifest_table *t;
+	size_t prefix_size = ALIGN((count + 1) * sizeof(u32), L1_CACHE_BYTES);
+
+	t = kmalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return NULL;
+	/* slot 0 is not used; vmalloc() gives page aligned lines */
+	t->prefix = vmalloc(prefix_size +
+			    (count + 1) * (size_t)DIGSIG_MANIFEST_DIGEST_SIZE);
+	if (!t->prefix) {
+		kfree(t);
+		return NULL;
+	}
+	t->digests = (void *)((char *)t->prefix + prefix_size);
+	t->count = count;
+	return t;
+}
+
+static void digsig_manifest_free(struct digsig_manifest_table *t)
+{
+	if (!t)
+		return;
+	vfree(t->prefix);
+	kfree(t);
+}
+
+/*
+ * Walk the union of the digests in force and the count sorted digests
+ * at new, in order and once each, and return their number; into t, if
+ * given, sized for that number.
+ */
+static u32 digsig_manifest_union(struct digsig_manifest_table *old,
+				 u8 (*new)[DIGSIG_MANIFEST_DIGEST_SIZE],
+				 u32 count, struct digsig_manifest_table *t)
+{
+	u32 i = old ? digsig_eytz_first(old->count) : 0, j = 0, n = 0;
+	u32 k = t ? digsig_eytz_first(t->count) : 0;
+	const u8 *last = NULL, *next;
+	int cmp;
+
+	while (i || j < count) {
+		if (!i)
+			cmp = 1;
+		else if (j == count)
+			cmp = -1;
+		else
+			cmp = memcmp(old->digests[i], new[j],
+				     DIGSIG_MANIFEST_DIGEST_SIZE);
+		if (cmp <= 0) {
+			next = old->digests[i];
+			i = digsig_eytz_next(i, old->count);
+			if (!cmp)
+				j++;
+		} else {
+			next = new[j++];
+		}
+		if (last && !memcmp(last, next, DIGSIG_MANIFEST_DIGEST_SIZE))
+			continue;
+		last = next;
+		n++;
+		if (t) {
+			memcpy(t->digests[k], next, DIGSIG_MANIFEST_DIGEST_SIZE);
+			t->prefix[k] = get_unaligned_be32(next);
+			k = digsig_eytz_next(k, t->count);
+		}
+	}
+	return n;
+}
+
+/*
+ * Merge the count digests at new, in any order, with those in force:
+ * the new ones are sorted in place unless they are sorted already, as
+ * digsig-sign writes them, then the union of both is counted and laid
+ * out in a new table without duplicates.
+ */
+static int digsig_manifest_merge(u8 (*new)[DIGSIG_MANIFEST_DIGEST_SIZE],
+				 u32 count)
+{
+	struct digsig_manifest_table *old, *t;
+	u32 i, total;
+
+	old = rcu_dereference_protected(digsig_manifest,
+			lockdep_is_held(&digsig_manifest_mutex));
+
+	for (i = 1; i < count; i++)
+		if (memcmp(new[i - 1], new[i], DIGSIG_MANIFEST_DIGEST_SIZE) > 0)
+			break;
+	if (i < count)
+		sort(new, count, DIGSIG_MANIFEST_DIGEST_SIZE,
+		     digsig_manifest_cmp, NULL);
+
+	total = digsig_manifest_union(old, new, count, NULL);
+	if (total > DIGSIG_MANIFEST_MAX)
+		return -ENOSPC;
+	t = digsig_manifest_alloc(total);
+	if (!t)
+		return -ENOMEM;
+	digsig_manifest_union(old, new, count, t);
+
+	rcu_assign_pointer(digsig_manifest, t);
+	ACCESS_ONCE(digsig_manifest_count) = total;
+	synchronize_rcu();
+	digsig_manifest_free(old);
+	return 0;
+}
+
+/* Check the signature of the staged manifest and add its digests. */
+static int digsig_manifest_commit(void)
+{
+	struct digsig_manifest_hdr *hdr = (void *)manifest_buf;
+	u32 count = le32_to_cpu(hdr->count);
+	u32 sig_size = le32_to_cpu(hdr->sig_size);
+	int rc;
+
+	rc = digsig_verify_buffer(manifest_buf, manifest_size - sig_size,
+				  manifest_buf + manifest_size - sig_size,
+				  sig_size);
+	if (rc)
+		return rc;
+
+	rc = digsig_manifest_merge((void *)(hdr + 1), count);
+	if (rc)
+		return rc;
+
+	/* files found unsigned before may be listed now */
+	digsig_inode_invalidate_all();
+	DSM_PRINT(DEBUG_SIGN, "%s: %u digests added, %d listed\n", __func__,
+		  count, digsig_manifest_count);
+	return 0;
+}
+
+static void digsig_manifest_drop(void)
+{
+	vfree(manifest_buf);
+	manifest_buf = NULL;
+	manifest_size = manifest_len = 0;
+}
+
+/******************************************************************************
+Description : Take a manifest, in the format of digsig_manifest.h, in one
+	or more writes at increasing offsets.  Its digests are added once
+	the whole manifest is written and its signature verified.
+Parameters  :
+	@buf, @count: this part of the manifest
+	@off: the offset of this part
+Return value: @count, or a negative error
+******************************************************************************/
+ssize_t digsig_manifest_write(const char *buf, loff_t off, size_t count)
+{
+	struct digsig_manifest_hdr *hdr;
+	ssize_t rc = count;
+	u32 n, sig_size;
+
+	mutex_lock(&digsig_manifest_mutex);
+	if (off == 0) {
+		digsig_manifest_drop();
+
+		hdr = (struct digsig_manifest_hdr *)buf;
+		if (count < sizeof(*hdr) ||
+		    memcmp(hdr->magic, DIGSIG_MANIFEST_MAGIC,
+			   sizeof(hdr->magic))) {
+			rc = -EINVAL;
+			goto out;
+		}
+		n = le32_to_cpu(hdr->count);
+		sig_size = le32_to_cpu(hdr->sig_size);
+		if (n > DIGSIG_MANIFEST_MAX ||
+		    (sig_size != DIGSIG_ELF_SIG_SIZE &&
+		     sig_size != DIGSIG_ED25519_SIG_SIZE)) {
+			rc = -EINVAL;
+			goto out;
+		}
+
+		manifest_size = sizeof(*hdr) +
+			(size_t)n * DIGSIG_MANIFEST_DIGEST_SIZE + sig_size;
+		manifest_buf = vmalloc(manifest_size);
+		if (!manifest_buf) {
+			manifest_size = 0;
+			rc = -ENOMEM;
+			goto out;
+		}
+	}
+
+	if (!manifest_buf || off != manifest_len ||
+	    count > manifest_size - manifest_len) {
+		digsig_manifest_drop();
+		rc = -EINVAL;
+		goto out;
+	}
+
+	memcpy(manifest_buf + manifest_len, buf, count);
+	manifest_len += count;
+	if (manifest_len == manifest_size) {
+		int err = digsig_manifest_commit();
+
+		if (err) {
+			DSM_ERROR("%s: manifest refused: %d\n", __func__, err);
+			rc = err;
+		}
+		digsig_manifest_drop();
+	}
+out:
+	mutex_unlock(&digsig_manifest_mutex);
+	return rc;
+}
@@ -0,0 +1,32 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the signed manifests of file digests.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_MANIFEST_H
+#define _DIGSIG_MANIFEST_H
+
+#include <linux/fs.h>
+#include <linux/types.h>
+
+#include "digsig_format.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_MANIFEST
+extern int digsig_manifest_count;
+#define digsig_manifest_loaded() ACCESS_ONCE(digsig_manifest_count)
+ssize_t digsig_manifest_write(const char *buf, loff_t off, size_t count);
+int digsig_manifest_listed(const u8 *digest);
+#else
+#define digsig_manifest_loaded() 0
+#define digsig_manifest_write(buf, off, count) (-EINVAL)
+#define digsig_manifest_listed(digest) 0
+#endif
+
+#endif /* _DIGSIG_MANIFEST_H */
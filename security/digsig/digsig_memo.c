@@ -0,0 +1,192 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file remembers the signatures found valid, by the digest of the
+ * file and the SHA-256 of the signature packet, so that another copy of
+ * a signed file, in another layer of a container image, another chroot
+ * or an identical package unpacked again, is hashed but not verified
+ * again: the signature operation over the same packet and digest can
+ * only give the same result.
+ *
+ * An entry also holds the fingerprint of the keys loaded and the tag of
+ * the key that verified it, and is only taken while both still stand.
+ * Only valid signatures are remembered; revocation is looked at before
+ * the memo, as before the signature operation.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/log2.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/err.h>
+#include <asm/unaligned.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_memo.h"
+
+static int dsi_memo_entries = 1024;
+module_param(dsi_memo_entries, int, 0);
+MODULE_PARM_DESC(dsi_memo_entries, "Number of valid signatures remembered, 0 for none.\n");
+
+#define MEMO_WAYS 4
+#define MEMO_FPR_SIZE 8
+
+struct digsig_memo_entry {
+	u8 digest[DIGSIG_MAX_DIGEST_LENGTH];
+	u8 key[DIGSIG_MEMO_KEY_SIZE];
+	u8 fpr[MEMO_FPR_SIZE];	/* of digsig_key_fpr when it was made */
+	u32 key_tag;
+	u8 hashalgo, signalgo, used;
+};
+
+/* a set of entries; the one to replace when it is full goes round */
+struct digsig_memo_set {
+	spinlock_t lock;
+	unsigned int next;
+	struct digsig_memo_entry e[MEMO_WAYS];
+};
+
+static struct digsig_memo_set *digsig_memo;
+static unsigned int digsig_memo_mask;
+
+/* both are digests, the set is taken from their first bytes */
+static struct digsig_memo_set *digsig_memo_set(const u8 *digest,
+					       const u8 *key)
+{
+	u32 h = get_unaligned_le32(digest) ^ get_unaligned_le32(key);
+
+	return &digsig_memo[h & digsig_memo_mask];
+}
+
+static int digsig_memo_match(const struct digsig_memo_entry *e, SIGCTX *ctx,
+			     const u8 *key)
+{
+	int len = gDigestLength[digsig_ctx_hash(ctx)];
+
+	return e->used && e->hashalgo == digsig_ctx_hash(ctx) &&
+	       e->signalgo == digsig_ctx_sign(ctx) &&
+	       !memcmp(e->key, key, DIGSIG_MEMO_KEY_SIZE) &&
+	       !memcmp(e->digest, ctx->digest, len) &&
+	       !memcmp(e->fpr, digsig_key_fpr, MEMO_FPR_SIZE);
+}
+
+/******************************************************************************
+Description : Look for a signature already found valid for the digest of
+	the context.
+Parameters  :
+	@ctx: a context whose digest is done
+	@packet, @len: the signature packet
+	@key: set to what the packet is known by, for digsig_memo_insert()
+Return value: 1 if the signature is valid, ctx->key_tag then being set to
+	the key that verified it; 0 if it is not known; -1 if it can not be
+	remembered either
+******************************************************************************/
+int digsig_memo_lookup(SIGCTX *ctx, const u8 *packet, int len, u8 *key)
+{
+	struct crypto_shash *tfm;
+	struct digsig_memo_set *s;
+	struct digsig_memo_entry *e;
+	int i, found = 0;
+	u32 tag = 0;
+
+	if (!digsig_memo)
+		return -1;
+	tfm = digsig_get_shash(HASH_SHA256);
+	if (IS_ERR(tfm))
+		return -1;
+	{
+		struct {
+			struct shash_desc shash;
+			char ctx[crypto_shash_descsize(tfm)];
+		} desc;
+
+		desc.shash.tfm = tfm;
+		desc.shash.flags = 0;
+		if (crypto_shash_digest(&desc.shash, packet, len, key))
+			return -1;
+	}
+
+	s = digsig_memo_set(ctx->digest, key);
+	spin_lock(&s->lock);
+	for (i = 0; i < MEMO_WAYS; i++) {
+		e = &s->e[i];
+		if (digsig_memo_match(e, ctx, key)) {
+			tag = e->key_tag;
+			found = 1;
+			break;
+		}
+	}
+	spin_unlock(&s->lock);
+
+	if (!found || !digsig_key_tag_live(tag))
+		return 0;
+	ctx->key_tag = tag;
+	return 1;
+}
+
+/******************************************************************************
+Description : Remember that the signature of the context is valid.
+Parameters  :
+	@ctx: the context whose signature was just verified
+	@key: what digsig_memo_lookup() set for its packet
+Return value: none
+******************************************************************************/
+void digsig_memo_insert(SIGCTX *ctx, const u8 *key)
+{
+	struct digsig_memo_set *s = digsig_memo_set(ctx->digest, key);
+	struct digsig_memo_entry *e;
+	int i;
+
+	spin_lock(&s->lock);
+	for (i = 0; i < MEMO_WAYS && s->e[i].used; i++)
+		if (digsig_memo_match(&s->e[i], ctx, key))
+			goto out;
+	if (i == MEMO_WAYS) {
+		i = s->next;
+		s->next = (s->next + 1) % MEMO_WAYS;
+	}
+	e = &s->e[i];
+	memcpy(e->digest, ctx->digest, gDigestLength[digsig_ctx_hash(ctx)]);
+	memcpy(e->key, key, DIGSIG_MEMO_KEY_SIZE);
+	memcpy(e->fpr, digsig_key_fpr, MEMO_FPR_SIZE);
+	e->key_tag = ctx->key_tag;
+	e->hashalgo = digsig_ctx_hash(ctx);
+	e->signalgo = digsig_ctx_sign(ctx);
+	e->used = 1;
+out:
+	spin_unlock(&s->lock);
+}
+
+/******************************************************************************
+Description : Allocate the memo, of dsi_memo_entries rounded up to a power
+	of two.
+Parameters  : none
+Return value: 0 on success, negative otherwise; signatures are then all
+	verified
+******************************************************************************/
+int __init digsig_init_memo(void)
+{
+	unsigned long sets, i;
+
+	if (dsi_memo_entries <= 0)
+		return 0;
+	sets = roundup_pow_of_two(DIV_ROUND_UP(dsi_memo_entries, MEMO_WAYS));
+	digsig_memo = vzalloc(sets * sizeof(*digsig_memo));
+	if (!digsig_memo)
+		return -ENOMEM;
+	for (i = 0; i < sets; i++)
+		spin_lock_init(&digsig_memo[i].lock);
+	digsig_memo_mask = sets - 1;
+	return 0;
+}
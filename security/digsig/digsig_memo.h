@@ -0,0 +1,37 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the memo of signature verifications.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_MEMO_H
+#define _DIGSIG_MEMO_H
+
+#include <crypto/sha.h>
+
+#include "digsig_verify.h"
+
+/* what a signature packet is known by in the memo, its SHA-256 */
+#define DIGSIG_MEMO_KEY_SIZE SHA256_DIGEST_SIZE
+
+#ifdef CONFIG_SECURITY_DIGSIG_MEMO
+int digsig_memo_lookup(SIGCTX *ctx, const u8 *packet, int len, u8 *key);
+void digsig_memo_insert(SIGCTX *ctx, const u8 *key);
+int digsig_init_memo(void);
+#else
+static inline int digsig_memo_lookup(SIGCTX *ctx, const u8 *packet, int len,
+				     u8 *key)
+{
+	return -1;
+}
+static inline void digsig_memo_insert(SIGCTX *ctx, const u8 *key) { }
+#define digsig_init_memo() 0
+#endif
+
+#endif /* _DIGSIG_MEMO_H */
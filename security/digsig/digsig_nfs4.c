@@ -0,0 +1,63 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file lets files be executed from NFSv4.  NFS ones are refused,
+ * as their data can change on the server between verification and
+ * execution without the client writing it, so the usual verdict, held
+ * until the file is opened for writing, means nothing there.
+ *
+ * NFSv4 keeps a change attribute for every file, which the server moves
+ * on every change and the client copies to i_version whenever it
+ * revalidates the inode, as it does on open.  The superblocks given the
+ * nfs4 policy have their verdicts checked against it, as on a local
+ * filesystem mounted with i_version: a file is verified from the page
+ * cache of the client, which is revalidated as it is read, and only
+ * verified again once the change attribute moved.  A verdict is not
+ * recorded if the attribute moved while the file was being read.
+ *
+ * The change attribute is only as recent as the last revalidation.
+ * Booted with dsi_nfs4_deleg=1, a verdict is only reused while the
+ * client holds a read delegation of the file, which the server must
+ * recall before letting anyone change it; without one the file is
+ * verified again.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/string.h>
+#include <linux/nfs_fs.h>
+#include <linux/nfs_xdr.h>
+
+#include "digsig_common.h"
+#include "digsig_nfs4.h"
+
+static int dsi_nfs4_deleg = 0;
+module_param(dsi_nfs4_deleg, int, 0);
+MODULE_PARM_DESC(dsi_nfs4_deleg, "Reuse NFSv4 verdicts only under a read delegation.\n");
+
+/* Is the superblock an NFSv4 one, whose i_version is the change attribute? */
+int digsig_nfs4_sb(struct super_block *sb)
+{
+	return !strcmp(sb->s_type->name, "nfs4");
+}
+
+/******************************************************************************
+Description : Can the verdict on an NFSv4 inode be reused, its change
+	attribute being the same?
+Parameters  :
+	@inode: an inode of a superblock digsig_nfs4_sb() is true of
+Return value: 1 if it can, 0 if the file is to be verified again
+******************************************************************************/
+int digsig_nfs4_trusted(struct inode *inode)
+{
+	if (!dsi_nfs4_deleg)
+		return 1;
+	return !!NFS_PROTO(inode)->have_delegation(inode, FMODE_READ);
+}
@@ -0,0 +1,26 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification of files on NFSv4.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_NFS4_H
+#define _DIGSIG_NFS4_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_NFS4
+int digsig_nfs4_sb(struct super_block *sb);
+int digsig_nfs4_trusted(struct inode *inode);
+#else
+#define digsig_nfs4_sb(sb) 0
+#define digsig_nfs4_trusted(inode) 0
+#endif
+
+#endif /* _DIGSIG_NFS4_H */
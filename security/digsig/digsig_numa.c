@@ -0,0 +1,125 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file finds where the pages of a file are, so that the file is
+ * hashed on a CPU of the node that holds them, instead of streamed over
+ * the interconnect: the pages of a file read by one task mostly sit on
+ * its node, and the verification, queued from another, would otherwise
+ * run wherever the workqueue puts it.
+ *
+ * The page cache of a file is sampled at DIGSIG_NUMA_SAMPLES places
+ * evenly spread over it; the node holding more than half of those
+ * cached is the node of the file, if most of them are.  A file with no
+ * such node is verified where it would have been: the pages it reads in
+ * are then allocated on the node of the CPU verifying it, as for any
+ * read.  Only files of dsi_numa_min_kb and more are sampled, and only
+ * once more than one node is online.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/radix-tree.h>
+#include <linux/nodemask.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+#include <linux/smp.h>
+
+#include "digsig_common.h"
+#include "digsig_numa.h"
+
+static int dsi_numa_min_kb = 256;
+module_param(dsi_numa_min_kb, int, 0);
+MODULE_PARM_DESC(dsi_numa_min_kb, "Verify files of this many kilobytes and more on the node holding their pages, -1 for anywhere.\n");
+
+#define DIGSIG_NUMA_SAMPLES 32
+
+/* the CPU last handed out */
+static int digsig_numa_next;
+
+/******************************************************************************
+Description : Find the node that holds most of the page cache of a file.
+Parameters  :
+	@file: the file about to be verified
+Return value: the node, or NUMA_NO_NODE if the file is small, mostly not
+	cached, or spread over the nodes
+******************************************************************************/
+int digsig_numa_file_node(struct file *file)
+{
+	struct address_space *mapping = file->f_mapping;
+	unsigned short nodes[DIGSIG_NUMA_SAMPLES];
+	loff_t size = i_size_read(file_inode(file));
+	pgoff_t npages;
+	struct page *page;
+	int i, n = 0, node = NUMA_NO_NODE, votes = 0;
+
+	if (dsi_numa_min_kb < 0 || num_online_nodes() < 2 ||
+	    size < (loff_t)dsi_numa_min_kb << 10 ||
+	    size < DIGSIG_NUMA_SAMPLES * PAGE_CACHE_SIZE)
+		return NUMA_NO_NODE;
+
+	npages = (size - 1) >> PAGE_CACHE_SHIFT;
+	for (i = 0; i < DIGSIG_NUMA_SAMPLES; i++) {
+		page = find_get_page(mapping, (u64)npages * i /
+				     (DIGSIG_NUMA_SAMPLES - 1));
+		/* a shmem page out in swap is no page */
+		if (!page || radix_tree_exceptional_entry(page))
+			continue;
+		nodes[n++] = page_to_nid(page);
+		page_cache_release(page);
+	}
+	if (n <= DIGSIG_NUMA_SAMPLES / 2)
+		return NUMA_NO_NODE;
+
+	/* the majority, if there is one */
+	for (i = 0; i < n; i++) {
+		if (!votes)
+			node = nodes[i];
+		votes += nodes[i] == node ? 1 : -1;
+	}
+	for (i = 0, votes = 0; i < n; i++)
+		votes += nodes[i] == node;
+	if (votes <= n / 2)
+		return NUMA_NO_NODE;
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %s is on node %d, %d of %d pages\n",
+		  __func__, file->f_dentry->d_name.name, node, votes, n);
+	return node;
+}
+
+/******************************************************************************
+Description : Pick a CPU of a node to queue work on: the CPU calling if it
+	is one, the next in turn otherwise.
+Parameters  :
+	@node: the node, or NUMA_NO_NODE
+Return value: the CPU, or WORK_CPU_UNBOUND for anywhere
+******************************************************************************/
+int digsig_numa_cpu(int node)
+{
+	const struct cpumask *mask;
+	int cpu;
+
+	if (node == NUMA_NO_NODE)
+		return WORK_CPU_UNBOUND;
+	if (cpu_to_node(raw_smp_processor_id()) == node)
+		return raw_smp_processor_id();
+
+	/* a race only gives two files the same CPU */
+	mask = cpumask_of_node(node);
+	cpu = cpumask_next_and(ACCESS_ONCE(digsig_numa_next), mask,
+			       cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first_and(mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		return WORK_CPU_UNBOUND;
+	ACCESS_ONCE(digsig_numa_next) = cpu;
+	return cpu;
+}
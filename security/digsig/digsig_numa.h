@@ -0,0 +1,29 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the placement of verifications on the node that
+ * holds the pages of their file.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_NUMA_H
+#define _DIGSIG_NUMA_H
+
+#include <linux/fs.h>
+#include <linux/numa.h>
+#include <linux/workqueue.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_NUMA
+int digsig_numa_file_node(struct file *file);
+int digsig_numa_cpu(int node);
+#else
+#define digsig_numa_file_node(file) NUMA_NO_NODE
+#define digsig_numa_cpu(node) WORK_CPU_UNBOUND
+#endif
+
+#endif /* _DIGSIG_NUMA_H */
@@ -0,0 +1,213 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file moves verifications off isolated CPUs.  A task running on
+ * a CPU given to isolcpus= or nohz_full= that maps a file without a
+ * verdict, such as a dlopen()ed plugin, would otherwise hash the file
+ * and check its signature right there.  With dsi_offload, it sleeps
+ * instead while a worker on one of the other CPUs, the housekeeping
+ * ones, verifies the file.
+ *
+ * Files with a verdict are still decided in place, from the inode.
+ *
+ * With dsi_charge, the task itself is moved to the housekeeping CPUs
+ * for the verification instead, so that the work stays its own, and is
+ * then given back the CPUs it was allowed before.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/cpumask.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/delayacct.h>
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_preload.h"
+#include "digsig_offload.h"
+#include "digsig_boot.h"
+
+static int dsi_offload = 0;
+module_param(dsi_offload, int, 0);
+MODULE_PARM_DESC(dsi_offload, "Verify files mapped on isolated CPUs on the housekeeping ones.\n");
+
+static struct workqueue_struct *digsig_offload_wq;
+static cpumask_var_t digsig_isolated, digsig_housekeeping;
+
+/*
+ * digsig_offload_req: one verification handed to a housekeeping CPU.
+ * It is shared by the waiting task and the worker, and freed by
+ * whichever is done with it last, as the task may be killed first.
+ */
+struct digsig_offload_req {
+	struct work_struct work;
+	struct file *file;
+	int result;
+	struct completion done;
+	atomic_t refs;
+};
+
+static void digsig_offload_put(struct digsig_offload_req *r)
+{
+	if (atomic_dec_and_test(&r->refs)) {
+		fput(r->file);
+		kfree(r);
+	}
+}
+
+static void digsig_offload_worker(struct work_struct *work)
+{
+	struct digsig_offload_req *r =
+		container_of(work, struct digsig_offload_req, work);
+
+	r->result = digsig_verify_file(r->file);
+	complete(&r->done);
+	digsig_offload_put(r);
+}
+
+/******************************************************************************
+Description : Should the file be verified on another CPU?
+Parameters  :
+	@file: a file about to be checked for execution
+Return value: 1 if the task runs on an isolated CPU and the file has no
+	verdict, 0 otherwise
+******************************************************************************/
+int digsig_offload_wanted(struct file *file)
+{
+	if (!digsig_offload_wq || (current->flags & PF_WQ_WORKER))
+		return 0;
+	/* where the task happens to run now is good enough */
+	if (!cpumask_test_cpu(raw_smp_processor_id(), digsig_isolated))
+		return 0;
+	return !digsig_inode_verified(file_inode(file));
+}
+
+/*
+ * Verify the file in the task, moved to the housekeeping CPUs meanwhile.
+ * An affinity set by someone else during the verification is lost.
+ */
+static int digsig_offload_migrate(struct file *file)
+{
+	cpumask_var_t saved;
+	int result;
+
+	if (!alloc_cpumask_var(&saved, GFP_KERNEL))
+		return -EAGAIN;
+	cpumask_copy(saved, tsk_cpus_allowed(current));
+	if (set_cpus_allowed_ptr(current, digsig_housekeeping)) {
+		free_cpumask_var(saved);
+		return -EAGAIN;
+	}
+
+	result = digsig_verify_file(file);
+
+	set_cpus_allowed_ptr(current, saved);
+	free_cpumask_var(saved);
+	return result;
+}
+
+/******************************************************************************
+Description : Verify a file on a housekeeping CPU, sleeping meanwhile.
+Parameters  :
+	@file: the file being mapped
+Return value: what the verification returned, -EINTR if the task was
+	killed first; the verdict is cached either way.  -EAGAIN if the
+	file must be verified in place after all.
+******************************************************************************/
+int digsig_offload(struct file *file)
+{
+	struct digsig_offload_req *r;
+	int result;
+	u64 t;
+
+	if (dsi_charge)
+		return digsig_offload_migrate(file);
+
+	r = kmalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -EAGAIN;
+	r->file = get_file(file);
+	init_completion(&r->done);
+	atomic_set(&r->refs, 2);
+	INIT_WORK(&r->work, digsig_offload_worker);
+	queue_work(digsig_offload_wq, &r->work);
+
+	/* the worker is charged the verification, the task its wait */
+	delayacct_integrity_start();
+	t = local_clock();
+	if (wait_for_completion_killable(&r->done))
+		result = -EINTR;
+	else
+		result = r->result;
+	delayacct_integrity_end();
+	digsig_boot_stall(t);
+	digsig_offload_put(r);
+	return result;
+}
+
+/******************************************************************************
+Description : Find the isolated CPUs, and set up a workqueue whose
+	workers run on the others.
+Parameters  : none
+Return value: 0; without isolated or without housekeeping CPUs, files
+	are verified where they are mapped
+******************************************************************************/
+int __init digsig_init_offload(void)
+{
+	struct workqueue_attrs *attrs;
+
+	if (!dsi_offload)
+		return 0;
+	if (!zalloc_cpumask_var(&digsig_isolated, GFP_KERNEL))
+		return -ENOMEM;
+	if (!zalloc_cpumask_var(&digsig_housekeeping, GFP_KERNEL)) {
+		free_cpumask_var(digsig_isolated);
+		return -ENOMEM;
+	}
+	cpumask_copy(digsig_isolated, cpu_isolated_map);
+#ifdef CONFIG_NO_HZ_FULL
+	if (tick_nohz_full_running)
+		cpumask_or(digsig_isolated, digsig_isolated,
+			   tick_nohz_full_mask);
+#endif
+
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!attrs)
+		goto err;
+	cpumask_andnot(digsig_housekeeping, cpu_possible_mask, digsig_isolated);
+	cpumask_copy(attrs->cpumask, digsig_housekeeping);
+	if (cpumask_empty(digsig_isolated) || cpumask_empty(attrs->cpumask)) {
+		free_workqueue_attrs(attrs);
+		goto err;
+	}
+
+	digsig_offload_wq = alloc_workqueue("digsig_offload", WQ_UNBOUND, 0);
+	if (digsig_offload_wq &&
+	    apply_workqueue_attrs(digsig_offload_wq, attrs)) {
+		destroy_workqueue(digsig_offload_wq);
+		digsig_offload_wq = NULL;
+	}
+	if (digsig_offload_wq)
+		DSM_PRINT(DEBUG_INIT, "%s: %u housekeeping CPUs verify for %u isolated ones\n",
+			  __func__, cpumask_weight(attrs->cpumask),
+			  cpumask_weight(digsig_isolated));
+	free_workqueue_attrs(attrs);
+	if (digsig_offload_wq)
+		return 0;
+err:
+	free_cpumask_var(digsig_housekeeping);
+	free_cpumask_var(digsig_isolated);
+	return 0;
+}
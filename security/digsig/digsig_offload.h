@@ -0,0 +1,28 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification of files mapped on isolated CPUs.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_OFFLOAD_H
+#define _DIGSIG_OFFLOAD_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_OFFLOAD
+int digsig_offload_wanted(struct file *file);
+int digsig_offload(struct file *file);
+int digsig_init_offload(void);
+#else
+#define digsig_offload_wanted(file) 0
+#define digsig_offload(file) (-EINVAL)
+#define digsig_init_offload() 0
+#endif
+
+#endif /* _DIGSIG_OFFLOAD_H */
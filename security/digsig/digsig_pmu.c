@@ -0,0 +1,274 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file counts, next to the latency histograms, the CPU cycles,
+ * instructions and last level cache misses of each phase of a check,
+ * so that the time of a phase can be told apart into the bignum
+ * arithmetic stalling on memory, the ELF parsing branching badly or
+ * the page cache copies.  The counters are those of the PMU of each
+ * CPU, pinned, counting in the kernel only, and read at the start and
+ * the end of each phase as the time is.
+ *
+ * A CPU counter counts whatever runs on the CPU, so a phase only counts
+ * if it ran on one CPU and the task did not switch out meanwhile: the
+ * phases that waited for the disk, or were preempted or migrated, are
+ * counted as dropped, with their time in the latency histograms only.
+ * The counters are off unless DigSig is booted with dsi_pmu=1, or 1 is
+ * written to /sys/kernel/security/digsig/pmu, which then gives one line
+ * per phase: the phases counted, their cycles, instructions and cache
+ * misses, and those dropped.  Writing 0 releases the counters.  A CPU
+ * brought online afterwards has none.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/perf_event.h>
+#include <linux/uaccess.h>
+#include <linux/err.h>
+
+#include "digsig_common.h"
+#include "digsig_stats.h"
+#include "digsig_sysfs.h"
+
+static int dsi_pmu = 0;
+module_param(dsi_pmu, int, 0);
+MODULE_PARM_DESC(dsi_pmu, "Count the CPU cycles, instructions and cache misses of each phase.\n");
+
+struct digsig_pmu_stats {
+	u64 count[DIGSIG_PHASES];
+	u64 sum[DIGSIG_PHASES][DIGSIG_PMU_EVENTS];
+	u64 dropped[DIGSIG_PHASES];
+};
+
+static DEFINE_PER_CPU(struct digsig_pmu_stats, digsig_pmu_stats);
+static DEFINE_PER_CPU(struct perf_event *[DIGSIG_PMU_EVENTS], digsig_pmu_event);
+static DEFINE_MUTEX(digsig_pmu_lock);
+static int digsig_pmu_on;
+
+static const u64 digsig_pmu_config[DIGSIG_PMU_EVENTS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+};
+
+/*
+ * The counters of this CPU, read as the PMU has them now; -1 if one
+ * is not counting.  The events are only released once no reader can
+ * be in here, with interrupts off.
+ */
+static int digsig_pmu_read(u64 *v)
+{
+	struct perf_event *event;
+	unsigned long flags;
+	int cpu, i;
+
+	if (!ACCESS_ONCE(digsig_pmu_on))
+		return -1;
+
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	for (i = 0; i < DIGSIG_PMU_EVENTS; i++) {
+		event = __this_cpu_read(digsig_pmu_event[i]);
+		if (!event || event->state != PERF_EVENT_STATE_ACTIVE) {
+			cpu = -1;
+			break;
+		}
+		event->pmu->read(event);
+		v[i] = local64_read(&event->count);
+	}
+	local_irq_restore(flags);
+	return cpu;
+}
+
+/******************************************************************************
+Description : Take the counters at the start of a phase.
+Parameters  :
+	@s: the stamp of the phase, its time taken by the caller
+Return value: none
+******************************************************************************/
+void digsig_pmu_start(struct digsig_stamp *s)
+{
+	s->cpu = digsig_pmu_read(s->pmu);
+	s->csw = current->nvcsw + current->nivcsw;
+}
+
+/******************************************************************************
+Description : Account the counters since @start to a phase, if the phase
+	ran on the CPU of @start only.
+Parameters  :
+	@phase: one of DIGSIG_PHASE_*
+	@start: the stamp of digsig_stats_start() from when the phase began
+Return value: none
+******************************************************************************/
+void digsig_pmu_add(int phase, const struct digsig_stamp *start)
+{
+	u64 v[DIGSIG_PMU_EVENTS];
+	int cpu, i;
+
+	if (start->cpu < 0)
+		return;
+	cpu = digsig_pmu_read(v);
+	if (cpu != start->cpu ||
+	    current->nvcsw + current->nivcsw != start->csw) {
+		this_cpu_inc(digsig_pmu_stats.dropped[phase]);
+		return;
+	}
+	this_cpu_inc(digsig_pmu_stats.count[phase]);
+	for (i = 0; i < DIGSIG_PMU_EVENTS; i++)
+		this_cpu_add(digsig_pmu_stats.sum[phase][i],
+			     v[i] - start->pmu[i]);
+}
+
+static void digsig_pmu_release(void)
+{
+	struct perf_event **e;
+	int cpu, i;
+
+	ACCESS_ONCE(digsig_pmu_on) = 0;
+	synchronize_sched();
+	for_each_possible_cpu(cpu) {
+		e = per_cpu(digsig_pmu_event, cpu);
+		for (i = 0; i < DIGSIG_PMU_EVENTS; i++) {
+			if (e[i])
+				perf_event_release_kernel(e[i]);
+			e[i] = NULL;
+		}
+	}
+}
+
+/* Create the counters of the CPUs online, and clear the sums. */
+static int digsig_pmu_create(void)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(attr),
+		.pinned = 1,
+		.exclude_user = 1,
+		.exclude_hv = 1,
+	};
+	struct perf_event *event;
+	int cpu, i, n = 0;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		for (i = 0; i < DIGSIG_PMU_EVENTS; i++) {
+			attr.config = digsig_pmu_config[i];
+			event = perf_event_create_kernel_counter(&attr, cpu,
+								 NULL, NULL,
+								 NULL);
+			if (IS_ERR(event)) {
+				DSM_PRINT(DEBUG_SIGN, "%s: no counter %d on CPU %d: %ld\n",
+					  __func__, i, cpu, PTR_ERR(event));
+				continue;
+			}
+			per_cpu(digsig_pmu_event, cpu)[i] = event;
+			n++;
+		}
+	}
+	put_online_cpus();
+	if (!n)
+		return -ENODEV;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&digsig_pmu_stats, cpu), 0,
+		       sizeof(struct digsig_pmu_stats));
+	ACCESS_ONCE(digsig_pmu_on) = 1;
+	return 0;
+}
+
+static int digsig_pmu_show(struct seq_file *m, void *v)
+{
+	struct digsig_pmu_stats *s;
+	u64 count, sum[DIGSIG_PMU_EVENTS], dropped;
+	int phase, cpu, i;
+
+	seq_puts(m, "# phase count cycles instructions cache_misses dropped\n");
+	for (phase = 0; phase < DIGSIG_PHASES; phase++) {
+		count = dropped = 0;
+		memset(sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			s = per_cpu_ptr(&digsig_pmu_stats, cpu);
+			count += s->count[phase];
+			for (i = 0; i < DIGSIG_PMU_EVENTS; i++)
+				sum[i] += s->sum[phase][i];
+			dropped += s->dropped[phase];
+		}
+		seq_printf(m, "%s %llu %llu %llu %llu %llu\n",
+			   digsig_phase_names[phase], count, sum[0], sum[1],
+			   sum[2], dropped);
+	}
+	return 0;
+}
+
+static int digsig_pmu_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_pmu_show, NULL);
+}
+
+static ssize_t digsig_pmu_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	int on, rc;
+
+	rc = kstrtoint_from_user(buf, count, 10, &on);
+	if (rc)
+		return rc;
+
+	mutex_lock(&digsig_pmu_lock);
+	digsig_pmu_release();
+	if (on)
+		rc = digsig_pmu_create();
+	mutex_unlock(&digsig_pmu_lock);
+	return rc ? rc : count;
+}
+
+static const struct file_operations digsig_pmu_fops = {
+	.open = digsig_pmu_open,
+	.read = seq_read,
+	.write = digsig_pmu_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* the PMU drivers register themselves after DigSig is set up */
+static int __init digsig_pmu_boot(void)
+{
+	if (!dsi_pmu)
+		return 0;
+	mutex_lock(&digsig_pmu_lock);
+	if (digsig_pmu_create())
+		DSM_ERROR("%s: no hardware counters\n", __func__);
+	mutex_unlock(&digsig_pmu_lock);
+	return 0;
+}
+late_initcall(digsig_pmu_boot);
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/pmu.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_pmu(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("pmu", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_pmu_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the hardware counters of the phases of a check.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_PMU_H
+#define _DIGSIG_PMU_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_PMU
+/* cycles, instructions and last level cache misses */
+#define DIGSIG_PMU_EVENTS 3
+
+/* when a phase began, by the clock and by the counters of its CPU */
+struct digsig_stamp {
+	u64 ns;
+	u64 pmu[DIGSIG_PMU_EVENTS];
+	unsigned long csw;
+	int cpu;
+};
+
+void digsig_pmu_start(struct digsig_stamp *s);
+void digsig_pmu_add(int phase, const struct digsig_stamp *start);
+int digsig_init_pmu(void);
+#else
+#define digsig_init_pmu() 0
+#endif
+
+#endif /* _DIGSIG_PMU_H */
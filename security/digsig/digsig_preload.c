@@ -0,0 +1,1133 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies files ahead of their use: the absolute paths
+ * written to /sys/kernel/security/digsig/preload, one per line, are
+ * opened and verified in the background, at most dsi_preload_jobs at a
+ * time, so that their verdicts are cached when they are executed.  A
+ * manifest written before the key is queued until the key is loaded.
+ * The pages read to hash these files are dropped from the page cache
+ * once hashed, unless they were cached already; the files verified
+ * because they are about to be mapped, below, are kept cached.
+ *
+ * Files on rotational disks are verified in the order of their first
+ * block, from bmap(), rather than in the order written, so that the
+ * disk reads them in one sweep rather than seeking back and forth:
+ * the paths queued are taken dsi_preload_order at a time, opened, and
+ * sorted by device and block.  A file is read in its own order, so
+ * the order is only as good as files are contiguous; dsi_preload_jobs
+ * set to 1 keeps the verifications of a sweep from interleaving.  The
+ * other files are verified in bulk, on every CPU, when DigSig has the
+ * bulk engine.
+ *
+ * What follows a tab on a line is ignored, so that the boot profile
+ * read from /sys/kernel/security/digsig/profile can be written back as
+ * it is.
+ *
+ * With dsi_screen, the RSA signatures of the paths are screened in
+ * batches, the last one once no path is left queued; the files of a
+ * batch are counted once it is screened.
+ *
+ * Reading the file tells how many of the paths are still queued, and
+ * how many were verified, failed or skipped (not regular files).
+ *
+ * With dsi_preload_on_open, files opened the way ld.so opens libraries,
+ * read-only and close-on-exec, are verified in the background too, as
+ * soon as they are opened: ld.so then reads their headers while they
+ * are hashed, and the mmap that follows finds the verdict made or in
+ * flight rather than starting it.
+ *
+ * With dsi_preload_needed, an executable verified at exec has the
+ * libraries of its DT_NEEDED entries, and theirs in turn, looked up in
+ * the directories of dsi_preload_needed_path under the root of the
+ * task and verified in the background, in the order ld.so maps them.
+ * RPATH and RUNPATH are not followed, nor LD_LIBRARY_PATH: a library
+ * found elsewhere is only verified when it is mapped.
+ *
+ * With dsi_preload_interp, the interpreter of an executable about to be
+ * verified at exec is verified alongside it, right away rather than on
+ * the preload workqueue, so that binfmt_elf finds its verdict made or
+ * in flight when it maps it.
+ *
+ * With dsi_preload_on_write, an ELF file signed in a section or a note
+ * is verified in the background once its last writer closes it, as a
+ * package manager installs it, so that its first exec finds the verdict
+ * made.  The verification waits dsi_preload_on_write milliseconds, so
+ * that a file written by several closes in a row is hashed once, and
+ * runs on its own workqueue, one file at a time at the lowest priority,
+ * behind the manifest and everything else.  The files of a trusted
+ * installer are verified at once, in bulk, whether or not
+ * dsi_preload_on_write is set.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/uaccess.h>
+#include <linux/kobject.h>
+#include <linux/err.h>
+#include <linux/elf.h>
+#include <linux/cred.h>
+#include <linux/path.h>
+#include <linux/namei.h>
+#include <linux/file.h>
+#include <linux/fs_struct.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/sort.h>
+#include <linux/blkdev.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_preload.h"
+#include "digsig_inode.h"
+#include "digsig_sb.h"
+#include "digsig_format.h"
+#include "digsig_bulk.h"
+#include "digsig_async.h"
+#include "digsig_installer.h"
+#include "digsig_ioprio.h"
+#include "digsig_screen.h"
+
+/* paths waiting at once, beyond which writes fail with -ENOSPC */
+#define DIGSIG_PRELOAD_MAX 65536
+
+/* files opened and waiting at once, beyond which opens are not followed */
+#define DIGSIG_PRELOAD_OPEN_MAX 64
+
+/* paths sorted at once, at most */
+#define DIGSIG_PRELOAD_ORDER_MAX 1024
+
+static int dsi_preload_jobs = 4;
+module_param(dsi_preload_jobs, int, 0);
+MODULE_PARM_DESC(dsi_preload_jobs, "Number of files verified at once from the preload manifest.\n");
+
+static int dsi_preload_order = 256;
+module_param(dsi_preload_order, int, 0);
+MODULE_PARM_DESC(dsi_preload_order, "Paths of the preload manifest on rotational disks verified in the order of their blocks, this many sorted at a time, 0 for the order written.\n");
+
+static int dsi_preload_on_open = 0;
+module_param(dsi_preload_on_open, int, 0);
+MODULE_PARM_DESC(dsi_preload_on_open, "Verify libraries in the background as soon as they are opened.\n");
+
+static int dsi_preload_on_write = 0;
+module_param(dsi_preload_on_write, int, 0);
+MODULE_PARM_DESC(dsi_preload_on_write, "Verify signed ELF files in the background this many milliseconds after their last writer closes them, 0 not to.\n");
+
+static int dsi_preload_needed = 0;
+module_param(dsi_preload_needed, int, 0);
+MODULE_PARM_DESC(dsi_preload_needed, "Verify the libraries an executable needs in the background when it is verified.\n");
+
+/* the multiarch directories of the distributions that have them */
+#ifdef CONFIG_X86_64
+#define DIGSIG_NEEDED_MULTIARCH ":/lib/x86_64-linux-gnu:/usr/lib/x86_64-linux-gnu"
+#else
+#define DIGSIG_NEEDED_MULTIARCH ""
+#endif
+
+static char *dsi_preload_needed_path =
+	"/lib64:/usr/lib64:/lib:/usr/lib" DIGSIG_NEEDED_MULTIARCH;
+module_param(dsi_preload_needed_path, charp, 0);
+MODULE_PARM_DESC(dsi_preload_needed_path, "Directories the libraries an executable needs are looked for in, separated by colons.\n");
+
+static int dsi_preload_interp = 0;
+module_param(dsi_preload_interp, int, 0);
+MODULE_PARM_DESC(dsi_preload_interp, "Verify the interpreter of an executable alongside it at exec.\n");
+
+/* libraries one executable has verified, its own and theirs */
+#define DIGSIG_NEEDED_MAX 64
+
+/* program headers and dynamic entries read from a file */
+#define DIGSIG_NEEDED_PHNUM 64
+#define DIGSIG_NEEDED_DYN_MAX (64 << 10)
+
+struct digsig_preload_item {
+	struct work_struct work;
+	struct list_head list;
+	struct file *file;	/* once opened to be sorted */
+	dev_t dev;
+	sector_t block;		/* the first of the file on dev */
+	char path[];
+};
+
+/* a file opened by ld.so, reopened by the worker under the opener's cred */
+struct digsig_preload_opened {
+	struct work_struct work;
+	struct path path;
+	const struct cred *cred;
+};
+
+/* a file just written, reopened once its writers are gone */
+struct digsig_preload_closed {
+	struct delayed_work work;
+	struct path path;
+	const struct cred *cred;
+};
+
+/* the line being written, which may straddle writes */
+struct digsig_preload_line {
+	size_t len;
+	int overlong;
+	char buf[PATH_MAX];
+};
+
+static struct workqueue_struct *digsig_preload_wq;
+static struct workqueue_struct *digsig_written_wq;
+static LIST_HEAD(digsig_preload_pending);	/* until the key is loaded */
+static DEFINE_SPINLOCK(digsig_preload_lock);
+static int digsig_preload_started;
+
+/* the paths to sort before they are verified, and those being sorted */
+static LIST_HEAD(digsig_preload_unsorted);
+static struct digsig_preload_item *digsig_preload_window[DIGSIG_PRELOAD_ORDER_MAX];
+static void digsig_preload_sort_work(struct work_struct *work);
+static DECLARE_WORK(digsig_preload_sort, digsig_preload_sort_work);
+
+static atomic_t digsig_preload_queued = ATOMIC_INIT(0);
+static atomic_t digsig_preload_verified = ATOMIC_INIT(0);
+static atomic_t digsig_preload_failed = ATOMIC_INIT(0);
+static atomic_t digsig_preload_skipped = ATOMIC_INIT(0);
+static atomic_t digsig_preload_opening = ATOMIC_INIT(0);
+static atomic_t digsig_preload_opened = ATOMIC_INIT(0);
+static atomic_t digsig_preload_execs = ATOMIC_INIT(0);
+static atomic_t digsig_preload_needed_verified = ATOMIC_INIT(0);
+static atomic_t digsig_preload_writing = ATOMIC_INIT(0);
+static atomic_t digsig_preload_written_verified = ATOMIC_INIT(0);
+
+/* the batches of the manifest, NULL without dsi_screen */
+static struct digsig_screen *digsig_preload_screen;
+
+/*
+ * An executable whose libraries are looked up: the names found in the
+ * dynamic sections so far, of which @done were looked up, and the root
+ * and credentials of the task that executed it.
+ */
+struct digsig_preload_exec {
+	struct work_struct work;
+	struct file *file;
+	struct path root;
+	const struct cred *cred;
+	u8 class;
+	u16 machine;
+	unsigned int count;
+	char *name[DIGSIG_NEEDED_MAX];
+	char path[PATH_MAX];
+};
+
+/* the verdict of a path whose signature was screened with others */
+static void digsig_preload_screened(struct file *file, int rc, void *data)
+{
+	if (rc) {
+		DSM_PRINT(DEBUG_SIGN, "%s: %s failed: %d\n", __func__,
+			  file->f_dentry->d_name.name, rc);
+		atomic_inc(&digsig_preload_failed);
+	} else
+		atomic_inc(&digsig_preload_verified);
+}
+
+static void digsig_preload_work(struct work_struct *work)
+{
+	struct digsig_preload_item *item =
+		container_of(work, struct digsig_preload_item, work);
+	struct digsig_prio prio;
+	struct file *file;
+	int rc;
+
+	digsig_prio_background(&prio);
+	file = item->file;
+	if (!file)
+		file = filp_open(item->path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file)) {
+		DSM_PRINT(DEBUG_SIGN, "%s: cannot open %s: %ld\n", __func__,
+			  item->path, PTR_ERR(file));
+		atomic_inc(&digsig_preload_failed);
+		goto out;
+	}
+
+	if (!S_ISREG(file_inode(file)->i_mode)) {
+		atomic_inc(&digsig_preload_skipped);
+	} else {
+		/*
+		 * the paths of a manifest may not be executed for a while;
+		 * the files opened are about to be, and are not screened
+		 */
+		rc = digsig_verify_file_screen(file, item->file ? NULL :
+					       digsig_preload_screen);
+		if (rc < 0) {
+			DSM_PRINT(DEBUG_SIGN, "%s: %s failed: %d\n", __func__,
+				  item->path, rc);
+			atomic_inc(&digsig_preload_failed);
+		} else if (rc != DIGSIG_SCREEN_QUEUED)
+			atomic_inc(&digsig_preload_verified);
+	}
+	/* the writer count taken by the verification goes with the file */
+	filp_close(file, NULL);
+
+out:
+	digsig_prio_restore(&prio);
+	/* the last path of the manifest screens the batch it left */
+	if (atomic_dec_and_test(&digsig_preload_queued))
+		digsig_screen_flush(digsig_preload_screen);
+	kfree(item);
+}
+
+/* A file not read in disk order is verified in bulk, if it can be. */
+static void digsig_preload_run(struct digsig_preload_item *item)
+{
+	if (digsig_bulk_queue(&item->work))
+		queue_work(digsig_preload_wq, &item->work);
+}
+
+static int digsig_preload_cmp(const void *a, const void *b)
+{
+	const struct digsig_preload_item *x = *(void * const *)a;
+	const struct digsig_preload_item *y = *(void * const *)b;
+
+	if (x->dev != y->dev)
+		return x->dev < y->dev ? -1 : 1;
+	if (x->block != y->block)
+		return x->block < y->block ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Open the file of the path, and find where it starts if it is on a
+ * rotational disk; 0 if it need not be sorted.  A path that does not
+ * open is left to the verification to report.
+ */
+static int digsig_preload_locate(struct digsig_preload_item *item)
+{
+	struct file *file;
+	struct inode *inode;
+	struct super_block *sb;
+
+	file = filp_open(item->path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return 0;
+	item->file = file;
+	inode = file_inode(file);
+	sb = inode->i_sb;
+	if (!S_ISREG(inode->i_mode) || !sb->s_bdev ||
+	    blk_queue_nonrot(bdev_get_queue(sb->s_bdev)))
+		return 0;
+	item->dev = sb->s_dev;
+	item->block = bmap(inode, 0);
+	return 1;
+}
+
+/* Verify the paths queued in the order of their blocks, a window at a time. */
+static void digsig_preload_sort_work(struct work_struct *work)
+{
+	struct digsig_preload_item **v = digsig_preload_window, *item;
+	int max = clamp(dsi_preload_order, 1, DIGSIG_PRELOAD_ORDER_MAX);
+	int n, m, i;
+
+	for (;;) {
+		spin_lock(&digsig_preload_lock);
+		for (n = 0; n < max && !list_empty(&digsig_preload_unsorted);
+		     n++) {
+			item = list_first_entry(&digsig_preload_unsorted,
+						struct digsig_preload_item,
+						list);
+			list_del(&item->list);
+			v[n] = item;
+		}
+		spin_unlock(&digsig_preload_lock);
+		if (!n)
+			break;
+
+		for (i = m = 0; i < n; i++)
+			if (digsig_preload_locate(v[i]))
+				v[m++] = v[i];
+			else
+				digsig_preload_run(v[i]);
+		sort(v, m, sizeof(*v), digsig_preload_cmp, NULL);
+		for (i = 0; i < m; i++)
+			queue_work(digsig_preload_wq, &v[i]->work);
+		cond_resched();
+	}
+}
+
+/* Verify the path, sorted first if need be; digsig_preload_lock is held. */
+static void digsig_preload_submit(struct digsig_preload_item *item)
+{
+	if (dsi_preload_order > 0) {
+		list_add_tail(&item->list, &digsig_preload_unsorted);
+		queue_work(digsig_preload_wq, &digsig_preload_sort);
+	} else {
+		digsig_preload_run(item);
+	}
+}
+
+static int digsig_preload_queue(const char *path, size_t len)
+{
+	struct digsig_preload_item *item;
+
+	if (path[0] != '/')
+		return -EINVAL;
+	if (atomic_inc_return(&digsig_preload_queued) > DIGSIG_PRELOAD_MAX) {
+		atomic_dec(&digsig_preload_queued);
+		return -ENOSPC;
+	}
+
+	item = kmalloc(sizeof(*item) + len + 1, GFP_KERNEL);
+	if (!item) {
+		atomic_dec(&digsig_preload_queued);
+		return -ENOMEM;
+	}
+	INIT_WORK(&item->work, digsig_preload_work);
+	item->file = NULL;
+	memcpy(item->path, path, len);
+	item->path[len] = '\0';
+
+	spin_lock(&digsig_preload_lock);
+	if (digsig_preload_started)
+		digsig_preload_submit(item);
+	else
+		list_add_tail(&item->list, &digsig_preload_pending);
+	spin_unlock(&digsig_preload_lock);
+	return 0;
+}
+
+/******************************************************************************
+Description : The key is loaded: verify the paths queued until now, and
+	those written from now on as they come.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_preload_start(void)
+{
+	struct digsig_preload_item *item, *next;
+
+	if (!digsig_preload_wq)
+		return;
+
+	spin_lock(&digsig_preload_lock);
+	digsig_preload_started = 1;
+	list_for_each_entry_safe(item, next, &digsig_preload_pending, list) {
+		list_del(&item->list);
+		digsig_preload_submit(item);
+	}
+	spin_unlock(&digsig_preload_lock);
+}
+
+/*
+ * Only ELF objects go on to be verified: the header read here is the one
+ * ld.so is about to read, and other files opened close-on-exec are not
+ * kept from being written while they would be hashed for nothing.
+ */
+static int digsig_preload_is_elf(struct file *file)
+{
+	struct elfhdr hdr;
+
+	if (kernel_read(file, 0, (char *)&hdr, sizeof(hdr)) != sizeof(hdr))
+		return 0;
+	return !memcmp(hdr.e_ident, ELFMAG, SELFMAG) &&
+	       (hdr.e_type == ET_DYN || hdr.e_type == ET_EXEC);
+}
+
+static void digsig_preload_open_work(struct work_struct *work)
+{
+	struct digsig_preload_opened *item =
+		container_of(work, struct digsig_preload_opened, work);
+	struct digsig_prio prio;
+	struct file *file;
+
+	digsig_prio_background(&prio);
+	file = dentry_open(&item->path, O_RDONLY | O_LARGEFILE, item->cred);
+	if (!IS_ERR(file)) {
+		if (digsig_preload_is_elf(file) && !digsig_verify_file(file))
+			atomic_inc(&digsig_preload_opened);
+		fput(file);
+	}
+	digsig_prio_restore(&prio);
+
+	atomic_dec(&digsig_preload_opening);
+	path_put(&item->path);
+	put_cred(item->cred);
+	kfree(item);
+}
+
+/******************************************************************************
+Description : Verify in the background a file that looks like a library
+	being opened by ld.so or dlopen(), so that its verdict is made or in
+	flight when it is mapped.  A file already with a verdict, or whose
+	verdict would not be cached, is left alone.
+Parameters  :
+	@file: a file being opened, not for writing
+	@cred: the credentials it is opened with
+Return value: none
+******************************************************************************/
+void digsig_preload_open_file(struct file *file, const struct cred *cred)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_preload_opened *item;
+	int policy, result;
+
+	/* the task opening it should pay for it, when it maps it */
+	if (!dsi_preload_on_open || !digsig_preload_started || dsi_charge)
+		return;
+	if ((file->f_flags & (O_ACCMODE | O_CLOEXEC)) != (O_RDONLY | O_CLOEXEC))
+		return;
+	if (!S_ISREG(inode->i_mode) ||
+	    i_size_read(inode) < sizeof(struct elfhdr))
+		return;
+	if (digsig_inode_verified(inode) || digsig_inode_deferred(inode) ||
+	    digsig_inode_denied(inode, &result))
+		return;
+	policy = digsig_sb_policy(inode->i_sb);
+	if (policy != DIGSIG_SB_VERIFY && policy != DIGSIG_SB_VERITY &&
+	    policy != DIGSIG_SB_NFS4)
+		return;
+
+	if (atomic_inc_return(&digsig_preload_opening) > DIGSIG_PRELOAD_OPEN_MAX)
+		goto out;
+	item = kmalloc(sizeof(*item), GFP_KERNEL);
+	if (!item)
+		goto out;
+	INIT_WORK(&item->work, digsig_preload_open_work);
+	item->path = file->f_path;
+	path_get(&item->path);
+	item->cred = get_cred(cred);
+	queue_work(digsig_preload_wq, &item->work);
+	return;
+
+out:
+	atomic_dec(&digsig_preload_opening);
+}
+
+static int digsig_written_read(void *src, loff_t pos, char *buf,
+			       unsigned long len)
+{
+	return kernel_read(src, pos, buf, len);
+}
+
+/*
+ * Is the file an ELF object with a signature?  Files that are not, most
+ * of those a package manager writes, are not worth hashing ahead.
+ */
+static int digsig_preload_is_signed(struct file *file)
+{
+	struct elf64_hdr ehdr;
+	struct digsig_notes notes;
+	void *buf;
+	int arch32, rc = 0;
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	if (kernel_read(file, 0, (char *)&ehdr, sizeof(ehdr)) <
+	    (int)sizeof(struct elf32_hdr) || digsig_elf_sanity_check(&ehdr))
+		return 0;
+	arch32 = ehdr.e_ident[EI_CLASS] == ELFCLASS32;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return 0;
+	if (digsig_find_notes(digsig_written_read, file, &ehdr, arch32, buf,
+			      PAGE_SIZE, &notes) ||
+	    digsig_scan_sections(digsig_written_read, file, &ehdr, arch32, buf,
+				 PAGE_SIZE, &notes) > 0)
+		rc = 1;
+	kfree(buf);
+	return rc;
+}
+
+static void digsig_preload_written_work(struct work_struct *work)
+{
+	struct digsig_preload_closed *item =
+		container_of(to_delayed_work(work),
+			     struct digsig_preload_closed, work);
+	struct inode *inode = item->path.dentry->d_inode;
+	struct digsig_prio prio;
+	struct file *file;
+
+	digsig_prio_background(&prio);
+	/* written again since, or verified already by its first exec */
+	if (atomic_read(&inode->i_writecount) > 0 ||
+	    digsig_inode_verified(inode))
+		goto out;
+	file = dentry_open(&item->path, O_RDONLY | O_LARGEFILE, item->cred);
+	if (IS_ERR(file))
+		goto out;
+	/* the pages just written are kept cached for the exec */
+	if (digsig_preload_is_elf(file) && digsig_preload_is_signed(file) &&
+	    !digsig_verify_file(file))
+		atomic_inc(&digsig_preload_written_verified);
+	fput(file);
+
+out:
+	digsig_prio_restore(&prio);
+	atomic_dec(&digsig_preload_writing);
+	path_put(&item->path);
+	put_cred(item->cred);
+	kfree(item);
+}
+
+/******************************************************************************
+Description : Verify in the background, a little later, a file its last
+	writer is closing, if it turns out to be a signed ELF object, so
+	that its first exec finds the verdict made; right away if the
+	writer is a trusted installer.
+Parameters  :
+	@file: a file open for writing, being freed
+Return value: none
+******************************************************************************/
+void digsig_preload_written(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_preload_closed *item;
+	int policy, installer;
+
+	if (!digsig_preload_started || dsi_charge)
+		return;
+	installer = digsig_preload_wq && digsig_installer_current();
+	if (!installer && (!dsi_preload_on_write || !digsig_written_wq))
+		return;
+	/* the writer count of the file itself is dropped after this */
+	if (!S_ISREG(inode->i_mode) || atomic_read(&inode->i_writecount) > 1 ||
+	    i_size_read(inode) < sizeof(struct elfhdr))
+		return;
+	policy = digsig_sb_policy(inode->i_sb);
+	if (policy != DIGSIG_SB_VERIFY && policy != DIGSIG_SB_VERITY &&
+	    policy != DIGSIG_SB_NFS4)
+		return;
+
+	if (atomic_inc_return(&digsig_preload_writing) > DIGSIG_PRELOAD_OPEN_MAX)
+		goto out;
+	item = kmalloc(sizeof(*item), GFP_KERNEL);
+	if (!item)
+		goto out;
+	INIT_DELAYED_WORK(&item->work, digsig_preload_written_work);
+	item->path = file->f_path;
+	path_get(&item->path);
+	item->cred = get_cred(file->f_cred);
+	/* never queued as delayed work, the timer is not needed */
+	if (installer) {
+		if (digsig_bulk_queue(&item->work.work))
+			queue_work(digsig_preload_wq, &item->work.work);
+		return;
+	}
+	queue_delayed_work(digsig_written_wq, &item->work,
+			   msecs_to_jiffies(dsi_preload_on_write));
+	return;
+
+out:
+	atomic_dec(&digsig_preload_writing);
+}
+
+/* a program header, of either class */
+struct digsig_needed_phdr {
+	u32 type;
+	u64 offset, vaddr, filesz;
+};
+
+static void digsig_needed_phdr(const void *tab, int arch32, int i,
+			       struct digsig_needed_phdr *ph)
+{
+	if (arch32) {
+		const Elf32_Phdr *p = (const Elf32_Phdr *)tab + i;
+
+		ph->type = p->p_type;
+		ph->offset = p->p_offset;
+		ph->vaddr = p->p_vaddr;
+		ph->filesz = p->p_filesz;
+	} else {
+		const Elf64_Phdr *p = (const Elf64_Phdr *)tab + i;
+
+		ph->type = p->p_type;
+		ph->offset = p->p_offset;
+		ph->vaddr = p->p_vaddr;
+		ph->filesz = p->p_filesz;
+	}
+}
+
+static void digsig_needed_dyn(const void *tab, int arch32, int i, s64 *tag,
+			      u64 *val)
+{
+	if (arch32) {
+		const Elf32_Dyn *d = (const Elf32_Dyn *)tab + i;
+
+		*tag = d->d_tag;
+		*val = d->d_un.d_val;
+	} else {
+		const Elf64_Dyn *d = (const Elf64_Dyn *)tab + i;
+
+		*tag = d->d_tag;
+		*val = d->d_un.d_val;
+	}
+}
+
+/* add a DT_NEEDED name, a file name alone, unless it is known already */
+static void digsig_needed_add(struct digsig_preload_exec *x, const char *name)
+{
+	unsigned int i;
+
+	if (!*name || strchr(name, '/') || x->count == DIGSIG_NEEDED_MAX)
+		return;
+	for (i = 0; i < x->count; i++)
+		if (!strcmp(x->name[i], name))
+			return;
+	x->name[x->count] = kstrdup(name, GFP_KERNEL);
+	if (x->name[x->count])
+		x->count++;
+}
+
+/*
+ * Add the DT_NEEDED names of an ELF file of the class and machine of
+ * the executable.  The string table is found from its address through
+ * the PT_LOAD segment that holds it, as ld.so finds it.
+ */
+static void digsig_needed_scan(struct digsig_preload_exec *x,
+			       struct file *file)
+{
+	struct elf64_hdr ehdr;
+	struct elf32_hdr *e32 = (struct elf32_hdr *)&ehdr;
+	struct digsig_needed_phdr ph, dyn = { .type = PT_NULL };
+	void *phdrs = NULL, *dyns = NULL;
+	u64 strtab = 0, stroff = 0, val;
+	unsigned long phoff, phsize, entsize;
+	int arch32, phnum, ndyn, i, len;
+	char name[NAME_MAX + 1];
+	s64 tag;
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	if (kernel_read(file, 0, (char *)&ehdr, sizeof(ehdr)) <
+	    (int)sizeof(*e32) || digsig_elf_sanity_check(&ehdr) ||
+	    ehdr.e_ident[EI_CLASS] != x->class || ehdr.e_machine != x->machine)
+		return;
+	arch32 = x->class == ELFCLASS32;
+	phnum = arch32 ? e32->e_phnum : ehdr.e_phnum;
+	phoff = arch32 ? e32->e_phoff : ehdr.e_phoff;
+	entsize = arch32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr);
+	if (!phnum || phnum > DIGSIG_NEEDED_PHNUM)
+		return;
+
+	phsize = phnum * entsize;
+	phdrs = kmalloc(phsize, GFP_KERNEL);
+	if (!phdrs || kernel_read(file, phoff, phdrs, phsize) != phsize)
+		goto out;
+	for (i = 0; i < phnum; i++) {
+		digsig_needed_phdr(phdrs, arch32, i, &ph);
+		if (ph.type == PT_DYNAMIC)
+			dyn = ph;
+	}
+	if (dyn.type != PT_DYNAMIC || !dyn.filesz ||
+	    dyn.filesz > DIGSIG_NEEDED_DYN_MAX)
+		goto out;
+
+	entsize = arch32 ? sizeof(Elf32_Dyn) : sizeof(Elf64_Dyn);
+	ndyn = dyn.filesz / entsize;
+	dyns = kmalloc(dyn.filesz, GFP_KERNEL);
+	if (!dyns || kernel_read(file, dyn.offset, dyns, dyn.filesz) !=
+	    dyn.filesz)
+		goto out;
+	for (i = 0; i < ndyn; i++) {
+		digsig_needed_dyn(dyns, arch32, i, &tag, &val);
+		if (tag == DT_NULL)
+			break;
+		if (tag == DT_STRTAB)
+			strtab = val;
+	}
+	for (i = 0; i < phnum && strtab; i++) {
+		digsig_needed_phdr(phdrs, arch32, i, &ph);
+		if (ph.type == PT_LOAD && strtab >= ph.vaddr &&
+		    strtab - ph.vaddr < ph.filesz) {
+			stroff = ph.offset + (strtab - ph.vaddr);
+			break;
+		}
+	}
+	if (!stroff)
+		goto out;
+
+	for (i = 0; i < ndyn; i++) {
+		digsig_needed_dyn(dyns, arch32, i, &tag, &val);
+		if (tag == DT_NULL)
+			break;
+		if (tag != DT_NEEDED)
+			continue;
+		len = kernel_read(file, stroff + val, name, sizeof(name));
+		if (len <= 0 || !memchr(name, '\0', len))
+			continue;
+		digsig_needed_add(x, name);
+	}
+out:
+	kfree(dyns);
+	kfree(phdrs);
+}
+
+/* open a library from the directories of dsi_preload_needed_path */
+static struct file *digsig_needed_open(struct digsig_preload_exec *x,
+				       const char *name)
+{
+	const char *dir = dsi_preload_needed_path, *end;
+	struct elf64_hdr ehdr;
+	struct file *file;
+	size_t len;
+
+	for (; *dir; dir = *end ? end + 1 : end) {
+		end = strchr(dir, ':');
+		if (!end)
+			end = dir + strlen(dir);
+		len = end - dir;
+		if (!len || len + 1 + strlen(name) >= sizeof(x->path))
+			continue;
+		memcpy(x->path, dir, len);
+		x->path[len] = '/';
+		strcpy(x->path + len + 1, name);
+
+		file = file_open_root(x->root.dentry, x->root.mnt, x->path,
+				      O_RDONLY | O_LARGEFILE);
+		if (IS_ERR(file))
+			continue;
+		/* ld.so passes over a library of another class, so do we */
+		if (S_ISREG(file_inode(file)->i_mode) &&
+		    kernel_read(file, 0, (char *)&ehdr, EI_NIDENT + 4) ==
+		    EI_NIDENT + 4 && !memcmp(ehdr.e_ident, ELFMAG, SELFMAG) &&
+		    ehdr.e_ident[EI_CLASS] == x->class &&
+		    ehdr.e_machine == x->machine)
+			return file;
+		fput(file);
+	}
+	return NULL;
+}
+
+static void digsig_preload_exec_work(struct work_struct *work)
+{
+	struct digsig_preload_exec *x =
+		container_of(work, struct digsig_preload_exec, work);
+	const struct cred *old = override_creds(x->cred);
+	struct digsig_prio prio;
+	struct file *file;
+	unsigned int i;
+
+	digsig_prio_background(&prio);
+	digsig_needed_scan(x, x->file);
+	for (i = 0; i < x->count; i++) {
+		file = digsig_needed_open(x, x->name[i]);
+		if (!file)
+			continue;
+		if (!digsig_inode_verified(file_inode(file)) &&
+		    !digsig_verify_file(file))
+			atomic_inc(&digsig_preload_needed_verified);
+		digsig_needed_scan(x, file);
+		fput(file);
+	}
+	digsig_prio_restore(&prio);
+	revert_creds(old);
+
+	for (i = 0; i < x->count; i++)
+		kfree(x->name[i]);
+	atomic_dec(&digsig_preload_execs);
+	fput(x->file);
+	path_put(&x->root);
+	put_cred(x->cred);
+	kfree(x);
+}
+
+/******************************************************************************
+Description : Verify in the background the libraries an executable just
+	verified needs, so that ld.so finds their verdicts made or in flight.
+Parameters  :
+	@file: the executable
+	@hdr: the first BINPRM_BUF_SIZE bytes of the file
+Return value: none
+******************************************************************************/
+void digsig_preload_exec(struct file *file, const char *hdr)
+{
+	const struct elf32_hdr *e = (const struct elf32_hdr *)hdr;
+	struct digsig_preload_exec *x;
+
+	if (!dsi_preload_needed || !digsig_preload_started || dsi_charge)
+		return;
+	if (memcmp(e->e_ident, ELFMAG, SELFMAG) ||
+	    (e->e_type != ET_EXEC && e->e_type != ET_DYN))
+		return;
+
+	if (atomic_inc_return(&digsig_preload_execs) > DIGSIG_PRELOAD_OPEN_MAX)
+		goto out;
+	x = kzalloc(sizeof(*x), GFP_KERNEL);
+	if (!x)
+		goto out;
+	INIT_WORK(&x->work, digsig_preload_exec_work);
+	x->file = get_file(file);
+	get_fs_root(current->fs, &x->root);
+	x->cred = get_current_cred();
+	x->class = e->e_ident[EI_CLASS];
+	x->machine = e->e_machine;
+	queue_work(digsig_preload_wq, &x->work);
+	return;
+
+out:
+	atomic_dec(&digsig_preload_execs);
+}
+
+/* the PT_INTERP path of an executable, NULL if it has none */
+static char *digsig_interp_name(struct file *file, const char *hdr)
+{
+	const struct elf64_hdr *e = (const struct elf64_hdr *)hdr;
+	const struct elf32_hdr *e32 = (const struct elf32_hdr *)hdr;
+	struct digsig_needed_phdr ph;
+	unsigned long phoff, phsize;
+	int arch32, phnum, i;
+	char *phdrs, *name = NULL;
+
+	arch32 = e->e_ident[EI_CLASS] == ELFCLASS32;
+	phnum = arch32 ? e32->e_phnum : e->e_phnum;
+	phoff = arch32 ? e32->e_phoff : e->e_phoff;
+	if (!phnum || phnum > DIGSIG_NEEDED_PHNUM)
+		return NULL;
+	phsize = phnum * (arch32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr));
+	phdrs = kmalloc(phsize, GFP_KERNEL);
+	if (!phdrs || kernel_read(file, phoff, phdrs, phsize) != phsize)
+		goto out;
+
+	for (i = 0; i < phnum; i++) {
+		digsig_needed_phdr(phdrs, arch32, i, &ph);
+		if (ph.type != PT_INTERP)
+			continue;
+		/* binfmt_elf takes no other */
+		if (ph.filesz < 2 || ph.filesz > PATH_MAX)
+			break;
+		name = kmalloc(ph.filesz, GFP_KERNEL);
+		if (name && (kernel_read(file, ph.offset, name, ph.filesz) !=
+			     ph.filesz || name[ph.filesz - 1])) {
+			kfree(name);
+			name = NULL;
+		}
+		break;
+	}
+out:
+	kfree(phdrs);
+	return name;
+}
+
+/******************************************************************************
+Description : Start verifying the interpreter of an executable about to be
+	verified at exec, so that the two verifications run side by side.
+	An interpreter with a verdict already is left alone.
+Parameters  :
+	@file: the executable
+	@hdr: the first BINPRM_BUF_SIZE bytes of the file
+Return value: none
+******************************************************************************/
+static void digsig_preload_interp_done(struct digsig_async *req, int result,
+				       void *data)
+{
+	if (!result)
+		atomic_inc(&digsig_preload_opened);
+	atomic_dec(&digsig_preload_opening);
+}
+
+void digsig_preload_interp(struct file *file, const char *hdr)
+{
+	const struct elf32_hdr *e = (const struct elf32_hdr *)hdr;
+	struct digsig_async *req;
+	struct file *interp;
+	struct inode *inode;
+	struct path path;
+	char *name;
+	int result;
+
+	if (!dsi_preload_interp || !digsig_preload_started || dsi_charge)
+		return;
+	if (memcmp(e->e_ident, ELFMAG, SELFMAG) ||
+	    (e->e_type != ET_EXEC && e->e_type != ET_DYN))
+		return;
+
+	/* looked up from the task, as binfmt_elf will */
+	name = digsig_interp_name(file, hdr);
+	if (!name)
+		return;
+	result = kern_path(name, LOOKUP_FOLLOW, &path);
+	kfree(name);
+	if (result)
+		return;
+
+	inode = path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) || digsig_inode_verified(inode) ||
+	    digsig_inode_deferred(inode) || digsig_inode_denied(inode, &result))
+		goto out;
+	if (atomic_inc_return(&digsig_preload_opening) > DIGSIG_PRELOAD_OPEN_MAX)
+		goto out_dec;
+	interp = dentry_open(&path, O_RDONLY | O_LARGEFILE, current_cred());
+	if (IS_ERR(interp))
+		goto out_dec;
+	/* not behind the manifest, nor bulk work */
+	req = digsig_verify_submit(interp, DIGSIG_ASYNC_URGENT,
+				   digsig_preload_interp_done, NULL);
+	fput(interp);
+	if (IS_ERR(req))
+		goto out_dec;
+	digsig_verify_put(req);
+	goto out;
+
+out_dec:
+	atomic_dec(&digsig_preload_opening);
+out:
+	path_put(&path);
+}
+
+static int digsig_preload_line_end(struct digsig_preload_line *l)
+{
+	char *tab;
+	int rc = 0;
+
+	/* the size and hits of a line of the boot profile are not needed */
+	tab = memchr(l->buf, '\t', l->len);
+	if (tab) {
+		l->len = tab - l->buf;
+		l->overlong = 0;
+	}
+
+	if (l->overlong)
+		rc = -ENAMETOOLONG;
+	else if (l->len)
+		rc = digsig_preload_queue(l->buf, l->len);
+	l->len = 0;
+	l->overlong = 0;
+	return rc;
+}
+
+static int digsig_preload_open(struct inode *inode, struct file *file)
+{
+	struct digsig_preload_line *l = NULL;
+
+	if (file->f_mode & FMODE_WRITE) {
+		l = kzalloc(sizeof(*l), GFP_KERNEL);
+		if (!l)
+			return -ENOMEM;
+	}
+	file->private_data = l;
+	return 0;
+}
+
+static ssize_t digsig_preload_write(struct file *file, const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct digsig_preload_line *l = file->private_data;
+	size_t i, n = min_t(size_t, count, PAGE_SIZE);
+	char *kbuf;
+	int rc = 0;
+
+	kbuf = kmalloc(n, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	if (copy_from_user(kbuf, ubuf, n)) {
+		kfree(kbuf);
+		return -EFAULT;
+	}
+
+	for (i = 0; i < n && !rc; i++) {
+		if (kbuf[i] == '\n')
+			rc = digsig_preload_line_end(l);
+		else if (l->len < sizeof(l->buf) - 1)
+			l->buf[l->len++] = kbuf[i];
+		else
+			l->overlong = 1;
+	}
+	kfree(kbuf);
+
+	return rc ? rc : n;
+}
+
+static ssize_t digsig_preload_read(struct file *file, char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	char buf[160];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf),
+			"queued %d verified %d failed %d skipped %d opened %d"
+			" needed %d written %d\n",
+			atomic_read(&digsig_preload_queued),
+			atomic_read(&digsig_preload_verified),
+			atomic_read(&digsig_preload_failed),
+			atomic_read(&digsig_preload_skipped),
+			atomic_read(&digsig_preload_opened),
+			atomic_read(&digsig_preload_needed_verified),
+			atomic_read(&digsig_preload_written_verified));
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+/* a last line without its newline is taken when the file is closed */
+static int digsig_preload_release(struct inode *inode, struct file *file)
+{
+	struct digsig_preload_line *l = file->private_data;
+
+	if (l) {
+		digsig_preload_line_end(l);
+		kfree(l);
+	}
+	return 0;
+}
+
+static const struct file_operations digsig_preload_fops = {
+	.open = digsig_preload_open,
+	.read = digsig_preload_read,
+	.write = digsig_preload_write,
+	.release = digsig_preload_release,
+	.llseek = generic_file_llseek,
+};
+
+/* one file at a time at the lowest priority, not to slow the install down */
+static struct workqueue_struct *digsig_written_alloc(void)
+{
+	struct workqueue_attrs *attrs;
+	struct workqueue_struct *wq;
+
+	wq = alloc_workqueue("digsig_written", WQ_UNBOUND, 1);
+	if (!wq)
+		return NULL;
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (attrs) {
+		attrs->nice = 19;
+		cpumask_copy(attrs->cpumask, cpu_possible_mask);
+		apply_workqueue_attrs(wq, attrs);
+		free_workqueue_attrs(attrs);
+	}
+	return wq;
+}
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/preload, and the
+	workqueues verifying what is written there, and the files written.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_preload(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	digsig_preload_wq = alloc_workqueue("digsig_preload", WQ_UNBOUND,
+					    clamp(dsi_preload_jobs, 1,
+						  WQ_UNBOUND_MAX_ACTIVE));
+	if (!digsig_preload_wq)
+		return -ENOMEM;
+
+	d = securityfs_create_file("preload", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_preload_fops);
+	if (IS_ERR(d)) {
+		destroy_workqueue(digsig_preload_wq);
+		digsig_preload_wq = NULL;
+		return PTR_ERR(d);
+	}
+	/* the files written are verified on their exec without it */
+	if (dsi_preload_on_write > 0)
+		digsig_written_wq = digsig_written_alloc();
+	digsig_preload_screen = digsig_screen_alloc(digsig_preload_screened,
+						    NULL);
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification of files ahead of their use.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_PRELOAD_H
+#define _DIGSIG_PRELOAD_H
+
+#include <linux/fs.h>
+
+/* in digsig.c: verify a file as if it was mapped for exec */
+int digsig_verify_file(struct file *file);
+/* the same, for a file that may not be used soon */
+int digsig_verify_file_stream(struct file *file);
+
+#ifdef CONFIG_SECURITY_DIGSIG_PRELOAD
+void digsig_preload_start(void);
+void digsig_preload_open_file(struct file *file, const struct cred *cred);
+void digsig_preload_exec(struct file *file, const char *hdr);
+void digsig_preload_interp(struct file *file, const char *hdr);
+void digsig_preload_written(struct file *file);
+int digsig_init_preload(void);
+#else
+#define digsig_preload_start() do { } while (0)
+#define digsig_preload_open_file(file, cred) do { } while (0)
+#define digsig_preload_exec(file, hdr) do { } while (0)
+#define digsig_preload_interp(file, hdr) do { } while (0)
+#define digsig_preload_written(file) do { } while (0)
+#define digsig_init_preload() 0
+#endif
+
+#endif /* _DIGSIG_PRELOAD_H */
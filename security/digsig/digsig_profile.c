@@ -0,0 +1,239 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file records which files are let through during the first
+ * dsi_profile_secs seconds of uptime, in the order they were first
+ * mapped, and lists them in /sys/kernel/security/digsig/profile, one
+ * per line: the path, the size and the number of times the file was
+ * mapped, separated by tabs.
+ *
+ * The list is meant to be saved by the init system and written back to
+ * /sys/kernel/security/digsig/preload early on the next boot, which
+ * ignores what follows the path.  The files that boot needs are then
+ * verified in the background, in the order they were used, as soon as
+ * the key is loaded.
+ *
+ * Files are told apart by superblock id and inode number.  Those whose
+ * path can not be written back, unlinked or holding a tab or a newline,
+ * are not recorded.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/dcache.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_sb.h"
+#include "digsig_profile.h"
+
+static int dsi_profile_secs = 300;
+module_param(dsi_profile_secs, int, 0);
+MODULE_PARM_DESC(dsi_profile_secs, "Seconds of uptime during which the files mapped are recorded.\n");
+
+static int dsi_profile_entries = 2048;
+module_param(dsi_profile_entries, int, 0);
+MODULE_PARM_DESC(dsi_profile_entries, "Number of files recorded at most.\n");
+
+struct digsig_profile_entry {
+	struct hlist_node node;
+	u64 sb_id;
+	unsigned long ino;
+	loff_t size;
+	atomic_t hits;
+	char path[];
+};
+
+static DEFINE_SPINLOCK(digsig_profile_lock);
+static struct hlist_head *digsig_profile_hash;
+static unsigned int digsig_profile_bits;
+
+/* in the order of first use; only ever appended to */
+static struct digsig_profile_entry **digsig_profile_list;
+static unsigned int digsig_profile_count;
+
+static int digsig_profile_open;
+static unsigned long digsig_profile_end;
+
+static struct digsig_profile_entry *
+digsig_profile_find(struct hlist_head *head, u64 sb_id, unsigned long ino)
+{
+	struct digsig_profile_entry *e;
+
+	hlist_for_each_entry(e, head, node)
+		if (e->sb_id == sb_id && e->ino == ino)
+			return e;
+	return NULL;
+}
+
+/* Record a file mapped for the first time. */
+static void digsig_profile_add(struct file *file, struct hlist_head *head,
+			       u64 sb_id)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_profile_entry *e;
+	char *buf, *path;
+	size_t len;
+
+	if (d_unlinked(file->f_path.dentry))
+		return;
+	buf = __getname();
+	if (!buf)
+		return;
+	path = d_path(&file->f_path, buf, PATH_MAX);
+	if (IS_ERR(path) || path[0] != '/' || strpbrk(path, "\t\n"))
+		goto out;
+
+	len = strlen(path);
+	e = kmalloc(sizeof(*e) + len + 1, GFP_KERNEL);
+	if (!e)
+		goto out;
+	e->sb_id = sb_id;
+	e->ino = inode->i_ino;
+	e->size = i_size_read(inode);
+	atomic_set(&e->hits, 1);
+	memcpy(e->path, path, len + 1);
+
+	spin_lock(&digsig_profile_lock);
+	/* mapped meanwhile by another task, or the profile is full */
+	if (digsig_profile_find(head, sb_id, e->ino) ||
+	    digsig_profile_count >= dsi_profile_entries) {
+		spin_unlock(&digsig_profile_lock);
+		kfree(e);
+		goto out;
+	}
+	hlist_add_head(&e->node, head);
+	digsig_profile_list[digsig_profile_count] = e;
+	/* readers find the entry complete once they see the count */
+	smp_wmb();
+	digsig_profile_count++;
+	spin_unlock(&digsig_profile_lock);
+out:
+	__putname(buf);
+}
+
+/******************************************************************************
+Description : Record that a file was let through, if the profile is still
+	being recorded.
+Parameters  :
+	@file: a file just allowed to be mapped for execution
+Return value: none
+******************************************************************************/
+void digsig_profile_hit(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_profile_entry *e;
+	struct hlist_head *head;
+	u64 sb_id;
+
+	if (!ACCESS_ONCE(digsig_profile_open))
+		return;
+	if (time_after(jiffies, digsig_profile_end)) {
+		digsig_profile_open = 0;
+		DSM_PRINT(DEBUG_INIT, "%s: %u files recorded\n", __func__,
+			  digsig_profile_count);
+		return;
+	}
+
+	sb_id = digsig_sb_id(inode->i_sb);
+	if (!sb_id)
+		return;
+	head = &digsig_profile_hash[hash_64(sb_id ^ inode->i_ino,
+					    digsig_profile_bits)];
+
+	spin_lock(&digsig_profile_lock);
+	e = digsig_profile_find(head, sb_id, inode->i_ino);
+	if (e)
+		atomic_inc(&e->hits);
+	spin_unlock(&digsig_profile_lock);
+
+	if (!e && ACCESS_ONCE(digsig_profile_count) < dsi_profile_entries)
+		digsig_profile_add(file, head, sb_id);
+}
+
+static int digsig_profile_show(struct seq_file *m, void *v)
+{
+	struct digsig_profile_entry *e;
+	unsigned int i, n = ACCESS_ONCE(digsig_profile_count);
+
+	smp_rmb();
+	for (i = 0; i < n; i++) {
+		e = digsig_profile_list[i];
+		seq_printf(m, "%s\t%lld\t%d\n", e->path, (long long)e->size,
+			   atomic_read(&e->hits));
+	}
+	return 0;
+}
+
+static int digsig_profile_fopen(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_profile_show, NULL);
+}
+
+static const struct file_operations digsig_profile_fops = {
+	.open = digsig_profile_fopen,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/profile, and start
+	recording.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_profile(void)
+{
+	struct dentry *d;
+	unsigned long n;
+	int rc = -ENOMEM;
+
+	if (dsi_profile_secs <= 0 || dsi_profile_entries <= 0)
+		return 0;
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	n = max(roundup_pow_of_two(dsi_profile_entries), 2UL);
+	digsig_profile_hash = vzalloc(n * sizeof(*digsig_profile_hash));
+	digsig_profile_list = vzalloc(dsi_profile_entries *
+				      sizeof(*digsig_profile_list));
+	if (!digsig_profile_hash || !digsig_profile_list)
+		goto out;
+	digsig_profile_bits = ilog2(n);
+
+	d = securityfs_create_file("profile", 0400, digsig_securityfs_dir,
+				   NULL, &digsig_profile_fops);
+	if (IS_ERR(d)) {
+		rc = PTR_ERR(d);
+		goto out;
+	}
+
+	/* jiffies start at INITIAL_JIFFIES at boot */
+	digsig_profile_end = INITIAL_JIFFIES + dsi_profile_secs * HZ;
+	digsig_profile_open = 1;
+	return 0;
+
+out:
+	vfree(digsig_profile_hash);
+	vfree(digsig_profile_list);
+	digsig_profile_hash = NULL;
+	digsig_profile_list = NULL;
+	return rc;
+}
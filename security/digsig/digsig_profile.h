@@ -0,0 +1,26 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the record of the files used at boot.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_PROFILE_H
+#define _DIGSIG_PROFILE_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_PROFILE
+void digsig_profile_hit(struct file *file);
+int digsig_init_profile(void);
+#else
+#define digsig_profile_hit(file) do { } while (0)
+#define digsig_init_profile() 0
+#endif
+
+#endif /* _DIGSIG_PROFILE_H */
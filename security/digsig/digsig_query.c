@@ -0,0 +1,297 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file lets a deploy agent or package manager find out whether
+ * files will be let through before it uses them.  It writes the numbers
+ * of file descriptors it holds, separated by spaces or newlines, to
+ * /sys/kernel/security/digsig/query; the files are verified in
+ * parallel, as mapping them for exec would, and the write returns once
+ * they all are.  Reading the file then gives one line per descriptor:
+ * the descriptor, 0 or the negative error mapping the file would get,
+ * and the time its verification took, in nanoseconds.
+ *
+ * Each file is verified through a file of its own, opened read-only, so
+ * that the descriptor of the caller is not kept from being written.
+ * Verdicts are cached as usual, which warms the cache for what follows;
+ * the pages read to hash the files are not, unless they already were.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/cred.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/uaccess.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_preload.h"
+#include "digsig_query.h"
+#include "digsig_bulk.h"
+#include "digsig_numa.h"
+#include "digsig_ioprio.h"
+
+/* descriptors taken by one write */
+#define DIGSIG_QUERY_MAX 256
+
+/* the longest line of the results: "fd result ns\n" */
+#define DIGSIG_QUERY_LINE 48
+
+struct digsig_query_item {
+	struct work_struct work;
+	struct digsig_query_batch *batch;
+	struct file *file;
+	int fd;
+	int result;
+	u64 ns;
+};
+
+/*
+ * digsig_query_batch: the files of one write.  It is shared by the
+ * writer and the workers, and freed by whichever is done with it last,
+ * as the writer may be killed first.
+ */
+struct digsig_query_batch {
+	atomic_t refs;
+	atomic_t pending;
+	struct completion done;
+	unsigned int count;
+	struct digsig_query_item item[];
+};
+
+/* the results of the last write, read back from the same open file */
+struct digsig_query {
+	struct mutex lock;
+	size_t len, pos;
+	char buf[DIGSIG_QUERY_MAX * DIGSIG_QUERY_LINE];
+};
+
+static void digsig_query_put(struct digsig_query_batch *b)
+{
+	unsigned int i;
+
+	if (!atomic_dec_and_test(&b->refs))
+		return;
+	for (i = 0; i < b->count; i++)
+		if (b->item[i].file)
+			fput(b->item[i].file);
+	kfree(b);
+}
+
+static void digsig_query_verify(struct digsig_query_item *it)
+{
+	u64 t = local_clock();
+
+	it->result = digsig_verify_file_stream(it->file);
+	it->ns = local_clock() - t;
+}
+
+static void digsig_query_worker(struct work_struct *work)
+{
+	struct digsig_query_item *it =
+		container_of(work, struct digsig_query_item, work);
+	struct digsig_query_batch *b = it->batch;
+	struct digsig_prio prio;
+
+	digsig_prio_background(&prio);
+	digsig_query_verify(it);
+	digsig_prio_restore(&prio);
+	if (atomic_dec_and_test(&b->pending))
+		complete(&b->done);
+	digsig_query_put(b);
+}
+
+/* Open the file of a descriptor of the caller, for DigSig's own use. */
+static int digsig_query_open_fd(struct digsig_query_item *it)
+{
+	struct file *f = fget(it->fd);
+	int rc = 0;
+
+	if (!f)
+		return -EBADF;
+	if (!S_ISREG(file_inode(f)->i_mode)) {
+		rc = -EINVAL;
+	} else {
+		it->file = dentry_open(&f->f_path, O_RDONLY | O_LARGEFILE,
+				       current_cred());
+		if (IS_ERR(it->file)) {
+			rc = PTR_ERR(it->file);
+			it->file = NULL;
+		}
+	}
+	fput(f);
+	return rc;
+}
+
+/* Verify the files of the batch, in parallel unless dsi_charge. */
+static int digsig_query_run(struct digsig_query_batch *b)
+{
+	struct digsig_query_item *it;
+	unsigned int i;
+	int rc;
+
+	atomic_set(&b->pending, 1);
+	for (i = 0; i < b->count; i++) {
+		it = &b->item[i];
+		it->batch = b;
+		it->result = digsig_query_open_fd(it);
+		if (it->result)
+			continue;
+		if (dsi_charge) {
+			digsig_query_verify(it);
+			continue;
+		}
+		atomic_inc(&b->pending);
+		atomic_inc(&b->refs);
+		INIT_WORK(&it->work, digsig_query_worker);
+		if (digsig_bulk_queue_node(&it->work,
+					   digsig_numa_file_node(it->file)))
+			queue_work(system_unbound_wq, &it->work);
+	}
+	if (atomic_dec_and_test(&b->pending))
+		complete(&b->done);
+
+	rc = wait_for_completion_killable(&b->done);
+	return rc ? -EINTR : 0;
+}
+
+static int digsig_query_parse(char *kbuf, struct digsig_query_batch *b)
+{
+	char *p = kbuf, *tok;
+	int fd;
+
+	while ((tok = strsep(&p, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (b->count == DIGSIG_QUERY_MAX)
+			return -E2BIG;
+		if (kstrtoint(tok, 10, &fd) || fd < 0)
+			return -EINVAL;
+		b->item[b->count].fd = fd;
+		b->item[b->count].file = NULL;
+		b->item[b->count].ns = 0;
+		b->count++;
+	}
+	return 0;
+}
+
+static ssize_t digsig_query_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct digsig_query *q = file->private_data;
+	struct digsig_query_batch *b;
+	char *kbuf;
+	unsigned int i;
+	int rc;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+	if (!g_init)
+		return -ENOKEY;
+	kbuf = kmalloc(count + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	if (copy_from_user(kbuf, ubuf, count)) {
+		kfree(kbuf);
+		return -EFAULT;
+	}
+	kbuf[count] = '\0';
+	b = kzalloc(sizeof(*b) + DIGSIG_QUERY_MAX * sizeof(b->item[0]),
+		    GFP_KERNEL);
+	if (!b) {
+		kfree(kbuf);
+		return -ENOMEM;
+	}
+	atomic_set(&b->refs, 1);
+	init_completion(&b->done);
+
+	rc = digsig_query_parse(kbuf, b);
+	kfree(kbuf);
+	if (!rc)
+		rc = digsig_query_run(b);
+	if (rc)
+		goto out;
+
+	mutex_lock(&q->lock);
+	q->len = q->pos = 0;
+	for (i = 0; i < b->count; i++)
+		q->len += scnprintf(q->buf + q->len, sizeof(q->buf) - q->len,
+				    "%d %d %llu\n", b->item[i].fd,
+				    b->item[i].result, b->item[i].ns);
+	mutex_unlock(&q->lock);
+	rc = count;
+out:
+	digsig_query_put(b);
+	return rc;
+}
+
+static ssize_t digsig_query_read(struct file *file, char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct digsig_query *q = file->private_data;
+	size_t n;
+
+	mutex_lock(&q->lock);
+	n = min(count, q->len - q->pos);
+	if (copy_to_user(ubuf, q->buf + q->pos, n)) {
+		mutex_unlock(&q->lock);
+		return -EFAULT;
+	}
+	q->pos += n;
+	mutex_unlock(&q->lock);
+	return n;
+}
+
+static int digsig_query_open(struct inode *inode, struct file *file)
+{
+	struct digsig_query *q;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return -ENOMEM;
+	mutex_init(&q->lock);
+	file->private_data = q;
+	return nonseekable_open(inode, file);
+}
+
+static int digsig_query_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations digsig_query_fops = {
+	.open = digsig_query_open,
+	.read = digsig_query_read,
+	.write = digsig_query_write,
+	.release = digsig_query_release,
+	.llseek = no_llseek,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/query.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_query(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("query", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_query_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
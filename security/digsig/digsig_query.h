@@ -0,0 +1,22 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verdict queries of deploy agents.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_QUERY_H
+#define _DIGSIG_QUERY_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_QUERY
+int digsig_init_query(void);
+#else
+#define digsig_init_query() 0
+#endif
+
+#endif /* _DIGSIG_QUERY_H */
@@ -0,0 +1,267 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps a record of recently verified files, by superblock id
+ * and inode number rather than by inode, that outlives both the sig_cache
+ * entry and the inode itself.  A file mapped again after its verdict
+ * was evicted, or after its inode left the icache, is let through on
+ * the record as long as the file is unchanged: same generation, size,
+ * change time and, on filesystems that keep it, i_version.
+ *
+ * With dsi_recent_paranoid, a file let through on the record is also
+ * hashed again in the background, as lazily checked chunks are, and is
+ * not mapped again if it no longer matches its signature.
+ *
+ * Records are dropped when the file is unlinked.  Those of a superblock
+ * that went away or was remounted no longer match its id, and are left
+ * for newer records to take their place.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seqlock.h>
+#include <linux/vmalloc.h>
+#include <linux/time.h>
+#include <linux/sched.h>
+
+#include "digsig_common.h"
+#include "digsig_recent.h"
+#include "digsig_sb.h"
+#include "digsig_lockstat.h"
+
+#define RECENT_PER_BUCKET 4
+
+static int dsi_recent_entries = 16384;
+module_param(dsi_recent_entries, int, 0);
+MODULE_PARM_DESC(dsi_recent_entries, "Number of recently verified files remembered.\n");
+
+int dsi_recent_paranoid = 0;
+module_param(dsi_recent_paranoid, int, 0);
+MODULE_PARM_DESC(dsi_recent_paranoid, "Hash files let through on their record again in the background.\n");
+
+struct digsig_recent_bucket {
+	seqlock_t lock;
+	struct digsig_recent_entry entry[RECENT_PER_BUCKET];
+	unsigned int next;
+};
+
+static struct digsig_recent_bucket *digsig_recent;
+static unsigned int digsig_recent_bits;
+
+static inline struct digsig_recent_bucket *
+digsig_recent_bucket(u64 sb_id, unsigned long ino)
+{
+	return &digsig_recent[hash_64(sb_id ^ ino, digsig_recent_bits)];
+}
+
+static void digsig_recent_fill(struct digsig_recent_entry *e,
+			       struct inode *inode)
+{
+	e->sb_id = digsig_sb_id(inode->i_sb);
+	e->ino = inode->i_ino;
+	e->igen = inode->i_generation;
+	e->size = i_size_read(inode);
+	e->ctime = inode->i_ctime;
+	e->version = digsig_inode_versioned(inode) ? inode->i_version : 0;
+}
+
+static inline int digsig_recent_match(const struct digsig_recent_entry *e,
+				      const struct digsig_recent_entry *cur)
+{
+	return e->sb_id == cur->sb_id && e->ino == cur->ino &&
+	       e->igen == cur->igen && e->size == cur->size &&
+	       timespec_equal(&e->ctime, &cur->ctime) &&
+	       e->version == cur->version;
+}
+
+/******************************************************************************
+Description : Remember that the file was verified.
+Parameters  :
+	@inode: the inode of a file whose signature was just verified
+	@verdict: what the verification was made under
+Return value: none
+******************************************************************************/
+void digsig_recent_record(struct inode *inode, struct digsig_verdict verdict)
+{
+	struct digsig_recent_bucket *b;
+	struct digsig_recent_entry e;
+	int i;
+
+	if (!digsig_recent)
+		return;
+	if (!digsig_ctime_settled(inode))
+		return;
+
+	digsig_recent_fill(&e, inode);
+	e.verdict = verdict;
+	if (!e.sb_id)
+		return;
+
+	b = digsig_recent_bucket(e.sb_id, e.ino);
+	digsig_write_seqlock(&b->lock, DIGSIG_LS_RECENT_RECORD);
+	for (i = 0; i < RECENT_PER_BUCKET; i++)
+		if (b->entry[i].sb_id == e.sb_id && b->entry[i].ino == e.ino)
+			break;
+	if (i == RECENT_PER_BUCKET) {
+		i = b->next;
+		b->next = (b->next + 1) % RECENT_PER_BUCKET;
+	}
+	b->entry[i] = e;
+	digsig_write_sequnlock(&b->lock, DIGSIG_LS_RECENT_RECORD);
+}
+
+/******************************************************************************
+Description : Was the file verified, and is it unchanged since?
+Parameters  :
+	@inode: the inode of a file without a cached verdict
+	@verdict: receives the verdict of the record, which still stands
+Return value: 1 if the file may be mapped on its record, 0 otherwise
+******************************************************************************/
+int digsig_recent_lookup(struct inode *inode, struct digsig_verdict *verdict)
+{
+	struct digsig_recent_bucket *b;
+	struct digsig_recent_entry cur;
+	struct digsig_verdict v;
+	unsigned seq;
+	int i, found;
+
+	if (!digsig_recent)
+		return 0;
+
+	digsig_recent_fill(&cur, inode);
+	if (!cur.sb_id)
+		return 0;
+	b = digsig_recent_bucket(cur.sb_id, cur.ino);
+	do {
+		found = 0;
+		seq = read_seqbegin(&b->lock);
+		for (i = 0; i < RECENT_PER_BUCKET && !found; i++)
+			if (digsig_recent_match(&b->entry[i], &cur)) {
+				v = b->entry[i].verdict;
+				found = 1;
+			}
+	} while (digsig_read_seqretry(&b->lock, seq, DIGSIG_LS_RECENT_LOOKUP));
+
+	if (!found || !digsig_verdict_current(&v))
+		return 0;
+	*verdict = v;
+	return 1;
+}
+
+/******************************************************************************
+Description : Drop the record of a file.
+Parameters  :
+	@inode: the inode of the file
+Return value: none
+******************************************************************************/
+void digsig_recent_forget(struct inode *inode)
+{
+	struct digsig_recent_bucket *b;
+	u64 sb_id;
+	int i;
+
+	if (!digsig_recent || !inode)
+		return;
+	sb_id = digsig_sb_id(inode->i_sb);
+	if (!sb_id)
+		return;
+
+	b = digsig_recent_bucket(sb_id, inode->i_ino);
+	digsig_write_seqlock(&b->lock, DIGSIG_LS_RECENT_FORGET);
+	for (i = 0; i < RECENT_PER_BUCKET; i++)
+		if (b->entry[i].sb_id == sb_id &&
+		    b->entry[i].ino == inode->i_ino)
+			b->entry[i].sb_id = 0;
+	digsig_write_sequnlock(&b->lock, DIGSIG_LS_RECENT_FORGET);
+}
+
+/******************************************************************************
+Description : Call @fn on a copy of every record, for the handover to the
+	next kernel.
+Parameters  :
+	@fn: called with each record and @data; a non-zero return stops
+	@data: passed to @fn
+Return value: what @fn returned last
+******************************************************************************/
+int digsig_recent_for_each(int (*fn)(const struct digsig_recent_entry *e,
+				     void *data), void *data)
+{
+	struct digsig_recent_entry copy[RECENT_PER_BUCKET];
+	unsigned long i, n;
+	unsigned seq;
+	int j, rc = 0;
+
+	if (!digsig_recent)
+		return 0;
+	n = 1UL << digsig_recent_bits;
+	for (i = 0; i < n && !rc; i++) {
+		do {
+			seq = read_seqbegin(&digsig_recent[i].lock);
+			memcpy(copy, digsig_recent[i].entry, sizeof(copy));
+		} while (read_seqretry(&digsig_recent[i].lock, seq));
+
+		for (j = 0; j < RECENT_PER_BUCKET && !rc; j++)
+			if (copy[j].sb_id)
+				rc = fn(&copy[j], data);
+		cond_resched();
+	}
+	return rc;
+}
+
+/******************************************************************************
+Description : Add a record made by the previous kernel.
+Parameters  :
+	@e: the record, naming a superblock of this kernel
+Return value: none
+******************************************************************************/
+void digsig_recent_insert(const struct digsig_recent_entry *e)
+{
+	struct digsig_recent_bucket *b;
+
+	if (!digsig_recent || !e->sb_id)
+		return;
+
+	b = digsig_recent_bucket(e->sb_id, e->ino);
+	digsig_write_seqlock(&b->lock, DIGSIG_LS_RECENT_INSERT);
+	b->entry[b->next] = *e;
+	b->next = (b->next + 1) % RECENT_PER_BUCKET;
+	digsig_write_sequnlock(&b->lock, DIGSIG_LS_RECENT_INSERT);
+}
+
+/******************************************************************************
+Description : Allocate the table, of dsi_recent_entries rounded up to a
+	power of 2.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig then verifies
+	every file whose verdict is not cached
+******************************************************************************/
+int __init digsig_init_recent(void)
+{
+	unsigned long n;
+
+	if (dsi_recent_entries <= 0)
+		return 0;
+
+	n = roundup_pow_of_two(DIV_ROUND_UP(dsi_recent_entries,
+					    RECENT_PER_BUCKET));
+	n = max(n, 2UL);
+	digsig_recent = vzalloc(n * sizeof(*digsig_recent));
+	if (!digsig_recent)
+		return -ENOMEM;
+	digsig_recent_bits = ilog2(n);
+	while (n--)
+		seqlock_init(&digsig_recent[n].lock);
+
+	DSM_PRINT(DEBUG_INIT, "%s: %lu recently verified files remembered\n",
+		  __func__, (1UL << digsig_recent_bits) * RECENT_PER_BUCKET);
+	return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the record of recently verified files.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_RECENT_H
+#define _DIGSIG_RECENT_H
+
+#include <linux/fs.h>
+
+#include "digsig_inode.h"
+
+struct digsig_recent_entry {
+	u64 sb_id;
+	unsigned long ino;
+	u32 igen;
+	struct digsig_verdict verdict;
+	loff_t size;
+	struct timespec ctime;
+	u64 version;
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_RECENT
+extern int dsi_recent_paranoid;
+void digsig_recent_record(struct inode *inode, struct digsig_verdict verdict);
+int digsig_recent_lookup(struct inode *inode, struct digsig_verdict *verdict);
+void digsig_recent_forget(struct inode *inode);
+int digsig_recent_for_each(int (*fn)(const struct digsig_recent_entry *e,
+				     void *data), void *data);
+void digsig_recent_insert(const struct digsig_recent_entry *e);
+int digsig_init_recent(void);
+#else
+#define dsi_recent_paranoid 0
+#define digsig_recent_record(inode, verdict) do { } while (0)
+#define digsig_recent_lookup(inode, verdict) 0
+#define digsig_recent_forget(inode) do { } while (0)
+#define digsig_init_recent() 0
+#endif
+
+#endif /* _DIGSIG_RECENT_H */
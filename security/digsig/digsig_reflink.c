@@ -0,0 +1,332 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file shares the digest of a file with its reflinked copies, as
+ * the layers of container images unpacked with cp --reflink or
+ * deduplicated are: on a filesystem that copies data on write, the
+ * extents a file maps are never written in place, so another file that
+ * maps exactly the same extents, over the same size, holds the same
+ * bytes, and its digest is that of the first.  A copy is then not read
+ * to be verified; its signature is still checked, and revocation looked
+ * at, as for any other file.
+ *
+ * The digest of a file just hashed is kept with its extent map, as
+ * FIEMAP tells it: the logical offset, the physical address and the
+ * length of each extent, whose order and holes the comparison covers.
+ * A map is only taken while each extent is data at rest, written and
+ * copied on write: not with dirty pages, which FIEMAP shows as delayed
+ * allocation, nor inline, compressed or unwritten extents, which are
+ * filled in place, nor for a file marked nodatacow.  Only btrfs is
+ * trusted to copy on write; XFS, in this tree, does not share extents.
+ *
+ * An entry lives as long as the file it was taken from is unchanged,
+ * and goes with its verdict when the file is opened for writing or its
+ * attributes change, see digsig_inode_changed(), or with its inode:
+ * until then its extents can not be freed, and then handed to a file
+ * with other contents at the same place.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include <linux/magic.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/spinlock.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/rcupdate.h>
+#include <linux/uaccess.h>
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_reflink.h"
+
+static int dsi_reflink_min_kb = 64;
+module_param(dsi_reflink_min_kb, int, 0);
+MODULE_PARM_DESC(dsi_reflink_min_kb, "Share the digests of files of this many kilobytes and more with their reflinked copies, -1 for none.\n");
+
+static int dsi_reflink_entries = 4096;
+module_param(dsi_reflink_entries, int, 0);
+MODULE_PARM_DESC(dsi_reflink_entries, "Number of extent maps kept to find reflinked copies by.\n");
+
+/* files of more extents are hashed as they are */
+#define DIGSIG_REFLINK_EXTENTS 16
+#define DIGSIG_REFLINK_BITS 10
+
+/* extents whose data may be written in place, or is not on disk yet */
+#define DIGSIG_REFLINK_UNSTABLE (FIEMAP_EXTENT_UNKNOWN | \
+	FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | \
+	FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED | \
+	FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL | \
+	FIEMAP_EXTENT_UNWRITTEN)
+
+struct digsig_reflink_extent {
+	u64 logical, physical, length;
+};
+
+/*
+ * digsig_reflink: the digest of a file by its extent map.  It is not
+ * changed once in the table, and is only looked at under RCU.
+ */
+struct digsig_reflink {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	struct inode *inode;	/* the file it was taken from */
+	struct super_block *sb;
+	u32 key;
+	int algo;
+	int segments;
+	loff_t sh_offset, sig_size;
+	loff_t size;
+	u8 digest[DIGSIG_MAX_DIGEST_LENGTH];
+	unsigned int count;
+	struct digsig_reflink_extent ext[];
+};
+
+/* changed under digsig_reflink_lock */
+static DEFINE_HASHTABLE(digsig_reflinks, DIGSIG_REFLINK_BITS);
+static DEFINE_SPINLOCK(digsig_reflink_lock);
+static int digsig_reflink_count;
+
+#define digsig_reflink_size(n) \
+	(sizeof(struct digsig_reflink) + \
+	 (n) * sizeof(struct digsig_reflink_extent))
+
+/* Are the digests of this file shared? */
+static int digsig_reflink_wanted(struct inode *inode)
+{
+	return dsi_reflink_min_kb >= 0 && dsi_reflink_entries > 0 &&
+	       inode->i_sb->s_magic == BTRFS_SUPER_MAGIC &&
+	       inode->i_op->fiemap &&
+	       i_size_read(inode) >= (loff_t)dsi_reflink_min_kb << 10;
+}
+
+/*
+ * The extent map of a file and how it is hashed, in @r, which has room
+ * for DIGSIG_REFLINK_EXTENTS and is followed by the room FIEMAP needs.
+ * FIEMAP and FS_IOC_GETFLAGS write to user space, so the buffers are
+ * passed with the kernel segment.
+ */
+static int digsig_reflink_map(struct digsig_reflink *r, SIGCTX *ctx,
+			      struct file *file, int segments,
+			      loff_t sh_offset, unsigned long sig_size)
+{
+	struct inode *inode = file_inode(file);
+	struct fiemap_extent *fe = (void *)&r->ext[DIGSIG_REFLINK_EXTENTS];
+	struct fiemap_extent_info fieinfo = { 0, };
+	mm_segment_t old_fs;
+	unsigned int flags = 0, i;
+	int rc = -EOPNOTSUPP;
+
+	r->sb = inode->i_sb;
+	r->algo = ctx->digestAlgo;
+	r->segments = segments;
+	r->sh_offset = sh_offset;
+	r->sig_size = sig_size;
+	r->size = i_size_read(inode);
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	/* a nodatacow file is written in place */
+	if (file->f_op->unlocked_ioctl)
+		rc = file->f_op->unlocked_ioctl(file, FS_IOC_GETFLAGS,
+						(unsigned long)&flags);
+	if (!rc && !(flags & FS_NOCOW_FL)) {
+		fieinfo.fi_extents_max = DIGSIG_REFLINK_EXTENTS + 1;
+		fieinfo.fi_extents_start = (struct fiemap_extent __user *)fe;
+		rc = inode->i_op->fiemap(inode, &fieinfo, 0, r->size);
+	} else if (!rc) {
+		rc = -EOPNOTSUPP;
+	}
+	set_fs(old_fs);
+	if (rc)
+		return rc;
+
+	if (!fieinfo.fi_extents_mapped ||
+	    fieinfo.fi_extents_mapped > DIGSIG_REFLINK_EXTENTS)
+		return -E2BIG;
+	for (i = 0; i < fieinfo.fi_extents_mapped; i++) {
+		if (fe[i].fe_flags & DIGSIG_REFLINK_UNSTABLE)
+			return -EAGAIN;
+		r->ext[i].logical = fe[i].fe_logical;
+		r->ext[i].physical = fe[i].fe_physical;
+		r->ext[i].length = fe[i].fe_length;
+	}
+	r->count = i;
+	r->key = jhash(r->ext, i * sizeof(r->ext[0]), (u32)r->size);
+	return 0;
+}
+
+static struct digsig_reflink *digsig_reflink_get(SIGCTX *ctx, struct file *file,
+						 int segments, loff_t sh_offset,
+						 unsigned long sig_size)
+{
+	struct digsig_reflink *r;
+
+	r = kmalloc(digsig_reflink_size(DIGSIG_REFLINK_EXTENTS) +
+		    (DIGSIG_REFLINK_EXTENTS + 1) * sizeof(struct fiemap_extent),
+		    GFP_KERNEL);
+	if (r && digsig_reflink_map(r, ctx, file, segments, sh_offset,
+				    sig_size)) {
+		kfree(r);
+		r = NULL;
+	}
+	return r;
+}
+
+/* Is @r, kept for another file, of the file whose map is @cur? */
+static int digsig_reflink_match(const struct digsig_reflink *r,
+				const struct digsig_reflink *cur)
+{
+	struct inode *src = r->inode;
+
+	return r->key == cur->key && r->sb == cur->sb &&
+	       r->count == cur->count && r->size == cur->size &&
+	       r->algo == cur->algo && r->segments == cur->segments &&
+	       r->sh_offset == cur->sh_offset &&
+	       r->sig_size == cur->sig_size &&
+	       !memcmp(r->ext, cur->ext, r->count * sizeof(r->ext[0])) &&
+	       /* not being evicted, which is about to free the extents */
+	       !(ACCESS_ONCE(src->i_state) & (I_FREEING | I_WILL_FREE)) &&
+	       ACCESS_ONCE(src->i_nlink);
+}
+
+/******************************************************************************
+Description : Take the digest kept for a file that maps the same extents
+	as the file about to be hashed, in place of hashing it.
+Parameters  :
+	@ctx: a context whose verification was just started
+	@file: the file about to be hashed, held from writers
+	@segments: whether the signature is of the segments of the file
+	@sh_offset, @sig_size: where its signature section is
+Return value: 1 if the digest of the file is in ctx->digest, 0 if the
+	file must be hashed
+******************************************************************************/
+int digsig_reflink_take(SIGCTX *ctx, struct file *file, int segments,
+			loff_t sh_offset, unsigned long sig_size)
+{
+	struct digsig_reflink *cur, *r;
+	int found = 0;
+
+	if (!ACCESS_ONCE(digsig_reflink_count) ||
+	    !digsig_reflink_wanted(file_inode(file)))
+		return 0;
+	cur = digsig_reflink_get(ctx, file, segments, sh_offset, sig_size);
+	if (!cur)
+		return 0;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(digsig_reflinks, r, node, cur->key)
+		if (digsig_reflink_match(r, cur)) {
+			memcpy(ctx->digest, r->digest, gDigestLength[r->algo]);
+			ctx->digest_done = 1;
+			found = 1;
+			break;
+		}
+	rcu_read_unlock();
+	kfree(cur);
+
+	if (found)
+		DSM_PRINT(DEBUG_SIGN, "%s: %s shares the extents of a file "
+			  "hashed\n", __func__, file->f_dentry->d_name.name);
+	return found;
+}
+
+/******************************************************************************
+Description : Keep the digest of a file just hashed by its extent map, for
+	its reflinked copies.
+Parameters  :
+	@ctx: the context, whose descriptor holds the hash of the file
+	@file: the file hashed, held from writers meanwhile
+	@segments, @sh_offset, @sig_size: as for digsig_reflink_take()
+Return value: 0, or negative if the digest could not be finished; a
+	digest that can not be kept is only lost
+******************************************************************************/
+int digsig_reflink_keep(SIGCTX *ctx, struct file *file, int segments,
+			loff_t sh_offset, unsigned long sig_size)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec;
+	struct digsig_reflink *cur, *r, *old;
+	int rc;
+
+	if (!digsig_reflink_wanted(inode) ||
+	    ACCESS_ONCE(digsig_reflink_count) >= dsi_reflink_entries)
+		return 0;
+	if (!ctx->digest_done) {
+		rc = crypto_shash_final(ctx->desc, ctx->digest);
+		if (rc < 0)
+			return rc;
+		ctx->digest_done = 1;
+	}
+
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return 0;
+	cur = digsig_reflink_get(ctx, file, segments, sh_offset, sig_size);
+	if (!cur)
+		return 0;
+	r = kmemdup(cur, digsig_reflink_size(cur->count), GFP_KERNEL);
+	kfree(cur);
+	if (!r)
+		return 0;
+	r->inode = inode;
+	memcpy(r->digest, ctx->digest, gDigestLength[r->algo]);
+
+	spin_lock(&digsig_reflink_lock);
+	old = isec->reflink;
+	if (old) {
+		hash_del_rcu(&old->node);
+		digsig_reflink_count--;
+	}
+	if (digsig_reflink_count < dsi_reflink_entries) {
+		hash_add_rcu(digsig_reflinks, &r->node, r->key);
+		isec->reflink = r;
+		ACCESS_ONCE(digsig_reflink_count) = digsig_reflink_count + 1;
+		r = NULL;
+	} else {
+		isec->reflink = NULL;
+	}
+	spin_unlock(&digsig_reflink_lock);
+
+	kfree(r);
+	if (old)
+		kfree_rcu(old, rcu);
+	return 0;
+}
+
+/******************************************************************************
+Description : Drop the extent map kept for an inode that may change, or is
+	going away.
+Parameters  :
+	@inode: the inode
+Return value: none
+******************************************************************************/
+void digsig_reflink_forget(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_reflink *r;
+
+	if (!isec || !ACCESS_ONCE(isec->reflink))
+		return;
+
+	spin_lock(&digsig_reflink_lock);
+	r = isec->reflink;
+	isec->reflink = NULL;
+	if (r) {
+		hash_del_rcu(&r->node);
+		ACCESS_ONCE(digsig_reflink_count) = digsig_reflink_count - 1;
+	}
+	spin_unlock(&digsig_reflink_lock);
+
+	if (r)
+		kfree_rcu(r, rcu);
+}
@@ -0,0 +1,33 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the digests shared by the reflinked copies of a
+ * file.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_REFLINK_H
+#define _DIGSIG_REFLINK_H
+
+#include <linux/fs.h>
+
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_REFLINK
+int digsig_reflink_take(SIGCTX *ctx, struct file *file, int segments,
+			loff_t sh_offset, unsigned long sig_size);
+int digsig_reflink_keep(SIGCTX *ctx, struct file *file, int segments,
+			loff_t sh_offset, unsigned long sig_size);
+void digsig_reflink_forget(struct inode *inode);
+#else
+#define digsig_reflink_take(ctx, file, segments, sh_offset, sig_size) 0
+#define digsig_reflink_keep(ctx, file, segments, sh_offset, sig_size) 0
+#define digsig_reflink_forget(inode) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_REFLINK_H */
@@ -0,0 +1,468 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file replays a recorded sequence of files mapped for execution
+ * against a corpus of those files, through the whole of DigSig: the
+ * verdict cache, the in-flight table, the hashing and the RSA
+ * verification, as digsig_verify_file() runs them for an exec.  Engine
+ * changes can then be measured against the mix of files a host actually
+ * runs rather than against loops over one file.
+ *
+ * The sequence is written to /sys/kernel/security/digsig/replay, in one
+ * or more writes at increasing offsets, one event per line:
+ *
+ *	<microseconds> <path>
+ *
+ * the time of the event since any point before the first, and the path
+ * of the file in the corpus; blank lines and lines starting with '#'
+ * are skipped.  A run is then started through /sys/digsig/bench:
+ *
+ *	replay <n> [fast]
+ *
+ * which replays the sequence from n threads, each taking the next event
+ * as it is done with one: at the pace of the recording, an event not
+ * started before its time, or with fast, as fast as the threads go.
+ * Reading the replay file gives the report of the last run: the events
+ * replayed, denied and whose file could not be opened, the time and the
+ * throughput, the events started later than their time and by how much
+ * at most, the distribution of the latencies, with its percentiles, and
+ * the waits on DigSig's locks meanwhile, if they are counted, see
+ * digsig_lockstat.c.
+ *
+ * The verdicts of a run stay cached for the next: to replay from cold,
+ * remount the corpus in between, which drops them.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+#include <linux/err.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_preload.h"
+#include "digsig_lockstat.h"
+#include "digsig_replay.h"
+
+/* the largest sequence taken, in bytes */
+#define DIGSIG_REPLAY_MAX_SIZE (64 << 20)
+#define DIGSIG_REPLAY_MAX_THREADS 256
+/* an event started later than this after its time is counted late */
+#define DIGSIG_REPLAY_LATE_NS NSEC_PER_MSEC
+/* the latencies, by ilog2() of their nanoseconds */
+#define DIGSIG_REPLAY_BINS 40
+
+struct digsig_replay_event {
+	u64 ns;			/* since the first event */
+	const char *path;	/* in replay_buf */
+};
+
+/* the sequence as written, and its events once parsed for a run */
+static DEFINE_MUTEX(digsig_replay_mutex);
+static char *replay_buf;
+static size_t replay_size, replay_len;
+static struct digsig_replay_event *replay_events;
+static unsigned long replay_count;
+
+struct digsig_replay_stats {
+	u64 events, denied, missing, late;
+	u64 max_late_ns, max_ns, sum_ns;
+	u64 bins[DIGSIG_REPLAY_BINS];
+};
+
+/* a run: the events are taken in order, by whichever thread is free */
+struct digsig_replay_run {
+	atomic_long_t next;
+	int fast;
+	int stop;
+	u64 start;
+};
+
+struct digsig_replay_worker {
+	struct digsig_replay_run *run;
+	struct task_struct *task;
+	struct digsig_replay_stats stats;
+	struct completion done;
+};
+
+/* the report of the last run */
+static struct digsig_replay_report {
+	int threads, fast;
+	u64 ns;
+	u64 contended, wait_ns;
+	struct digsig_replay_stats stats;
+} replay_report;
+
+static void digsig_replay_drop(void)
+{
+	vfree(replay_events);
+	replay_events = NULL;
+	replay_count = 0;
+	vfree(replay_buf);
+	replay_buf = NULL;
+	replay_size = replay_len = 0;
+}
+
+/*
+ * Split the sequence into its events, the paths terminated in place.
+ * Done once, before the first run of the sequence.
+ */
+static int digsig_replay_parse(void)
+{
+	struct digsig_replay_event *ev;
+	unsigned long n = 0, lines = 0;
+	unsigned long long us, first = 0;
+	char *p, *end, *path;
+	size_t i;
+
+	if (replay_events)
+		return 0;
+	if (!replay_len || replay_buf[replay_len - 1] != '\n')
+		return -EINVAL;
+	for (i = 0; i < replay_len; i++)
+		lines += replay_buf[i] == '\n';
+	ev = vmalloc(lines * sizeof(*ev));
+	if (!ev)
+		return -ENOMEM;
+
+	for (p = replay_buf; p < replay_buf + replay_len; p = end + 1) {
+		end = memchr(p, '\n', replay_buf + replay_len - p);
+		*end = '\0';
+		p = skip_spaces(p);
+		if (!*p || *p == '#')
+			continue;
+		path = strpbrk(p, " \t");
+		if (!path)
+			goto inval;
+		*path = '\0';
+		path = strim(path + 1);
+		if (kstrtoull(p, 10, &us) || *path != '/')
+			goto inval;
+		if (!n)
+			first = us;
+		if (us < first)
+			goto inval;
+		ev[n].ns = (us - first) * NSEC_PER_USEC;
+		ev[n].path = path;
+		n++;
+	}
+	replay_events = ev;
+	replay_count = n;
+	return 0;
+inval:
+	vfree(ev);
+	/* the lines are cut up now, the sequence is to be written again */
+	digsig_replay_drop();
+	return -EINVAL;
+}
+
+/* Sleep until @ns after the start of the run, unless it is stopped. */
+static void digsig_replay_wait(struct digsig_replay_run *run, u64 ns)
+{
+	ktime_t t;
+	s64 d;
+
+	while (!ACCESS_ONCE(run->stop)) {
+		d = run->start + ns - local_clock();
+		if (d <= 0)
+			return;
+		t = ns_to_ktime(d);
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout_range(&t, 50 * NSEC_PER_USEC,
+					 HRTIMER_MODE_REL);
+	}
+}
+
+static int digsig_replay_thread(void *arg)
+{
+	struct digsig_replay_worker *w = arg;
+	struct digsig_replay_run *run = w->run;
+	struct digsig_replay_stats *s = &w->stats;
+	struct digsig_replay_event *ev;
+	struct file *file;
+	unsigned long i;
+	u64 t, ns;
+	s64 late;
+	int rc;
+
+	while (!ACCESS_ONCE(run->stop)) {
+		i = atomic_long_inc_return(&run->next) - 1;
+		if (i >= replay_count)
+			break;
+		ev = &replay_events[i];
+		if (!run->fast)
+			digsig_replay_wait(run, ev->ns);
+
+		t = local_clock();
+		late = t - (run->start + ev->ns);
+		if (!run->fast && late > DIGSIG_REPLAY_LATE_NS) {
+			s->late++;
+			s->max_late_ns = max_t(u64, s->max_late_ns, late);
+		}
+
+		file = filp_open(ev->path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(file)) {
+			s->missing++;
+			continue;
+		}
+		t = local_clock();
+		rc = digsig_verify_file(file);
+		ns = local_clock() - t;
+		filp_close(file, NULL);
+
+		s->events++;
+		if (rc)
+			s->denied++;
+		s->sum_ns += ns;
+		s->max_ns = max(s->max_ns, ns);
+		s->bins[min(ns ? ilog2(ns) : 0, DIGSIG_REPLAY_BINS - 1)]++;
+		cond_resched();
+	}
+	complete(&w->done);
+	return 0;
+}
+
+static void digsig_replay_add(struct digsig_replay_stats *sum,
+			      const struct digsig_replay_stats *s)
+{
+	int i;
+
+	sum->events += s->events;
+	sum->denied += s->denied;
+	sum->missing += s->missing;
+	sum->late += s->late;
+	sum->max_late_ns = max(sum->max_late_ns, s->max_late_ns);
+	sum->max_ns = max(sum->max_ns, s->max_ns);
+	sum->sum_ns += s->sum_ns;
+	for (i = 0; i < DIGSIG_REPLAY_BINS; i++)
+		sum->bins[i] += s->bins[i];
+}
+
+/******************************************************************************
+Description : Replay the sequence written to the replay file, for
+	"replay <n> [fast]" written to /sys/digsig/bench.
+Parameters  :
+	@args: what follows "replay", NUL terminated
+Return value: 0 on success, negative on failure; the report is then
+	read from the replay file
+******************************************************************************/
+int digsig_replay_run(const char *args)
+{
+	struct digsig_replay_report *r = &replay_report;
+	struct digsig_replay_worker *w;
+	struct digsig_replay_run run;
+	u64 contended, wait_ns;
+	char mode[8] = "";
+	int i, n, nthreads, rc;
+
+	n = sscanf(args, "%d %7s", &nthreads, mode);
+	if (n < 1 || nthreads <= 0 || nthreads > DIGSIG_REPLAY_MAX_THREADS ||
+	    (n == 2 && strcmp(mode, "fast")))
+		return -EINVAL;
+
+	mutex_lock(&digsig_replay_mutex);
+	rc = digsig_replay_parse();
+	if (rc)
+		goto out;
+	w = kcalloc(nthreads, sizeof(*w), GFP_KERNEL);
+	rc = -ENOMEM;
+	if (!w)
+		goto out;
+
+	memset(r, 0, sizeof(*r));
+	r->threads = nthreads;
+	r->fast = n == 2;
+	atomic_long_set(&run.next, 0);
+	run.fast = r->fast;
+	run.stop = 0;
+	digsig_lockstat_total(&r->contended, &r->wait_ns);
+	run.start = local_clock();
+
+	rc = 0;
+	for (n = 0; n < nthreads; n++) {
+		w[n].run = &run;
+		init_completion(&w[n].done);
+		w[n].task = kthread_create(digsig_replay_thread, &w[n],
+					   "digsig_replay/%d", n);
+		if (IS_ERR(w[n].task)) {
+			rc = PTR_ERR(w[n].task);
+			break;
+		}
+		/* to be woken if the run is stopped, gone or not */
+		get_task_struct(w[n].task);
+		wake_up_process(w[n].task);
+	}
+	if (rc)
+		ACCESS_ONCE(run.stop) = 1;
+
+	/* a replay at the pace of the recording may take long */
+	for (i = 0; i < n && !ACCESS_ONCE(run.stop); i++)
+		if (wait_for_completion_killable(&w[i].done)) {
+			ACCESS_ONCE(run.stop) = 1;
+			rc = -EINTR;
+		}
+	for (i = 0; i < n; i++) {
+		if (ACCESS_ONCE(run.stop))
+			wake_up_process(w[i].task);
+		wait_for_completion(&w[i].done);
+		put_task_struct(w[i].task);
+		digsig_replay_add(&r->stats, &w[i].stats);
+	}
+	r->ns = local_clock() - run.start;
+	digsig_lockstat_total(&contended, &wait_ns);
+	r->contended = contended - r->contended;
+	r->wait_ns = wait_ns - r->wait_ns;
+	kfree(w);
+
+	if (!rc)
+		printk(KERN_INFO "digsig_bench: replay %d threads%s: %llu "
+		       "events in %llu ns, %llu events/s\n", r->threads,
+		       r->fast ? " fast" : "", r->stats.events, r->ns,
+		       r->ns ? div64_u64(r->stats.events * NSEC_PER_SEC,
+					 r->ns) : 0);
+out:
+	mutex_unlock(&digsig_replay_mutex);
+	return rc;
+}
+
+/* the latency below which @permille of the events were, by bin */
+static u64 digsig_replay_percentile(const struct digsig_replay_stats *s,
+				    unsigned int permille)
+{
+	u64 want = div_u64(s->events * permille + 999, 1000), sum = 0;
+	int i;
+
+	for (i = 0; i < DIGSIG_REPLAY_BINS; i++) {
+		sum += s->bins[i];
+		if (sum >= want)
+			return min(2ULL << i, s->max_ns);
+	}
+	return s->max_ns;
+}
+
+static int digsig_replay_show(struct seq_file *m, void *v)
+{
+	struct digsig_replay_report *r = &replay_report;
+	struct digsig_replay_stats *s = &r->stats;
+	int i;
+
+	mutex_lock(&digsig_replay_mutex);
+	seq_printf(m, "events %lu\n", replay_count);
+	if (!r->threads)
+		goto out;
+	seq_printf(m, "threads %d%s\n", r->threads, r->fast ? " fast" : "");
+	seq_printf(m, "replayed %llu\ndenied %llu\nmissing %llu\n",
+		   s->events, s->denied, s->missing);
+	seq_printf(m, "time_ns %llu\nevents_per_s %llu\n", r->ns,
+		   r->ns ? div64_u64(s->events * NSEC_PER_SEC, r->ns) : 0);
+	if (!r->fast)
+		seq_printf(m, "late %llu\nmax_late_ns %llu\n", s->late,
+			   s->max_late_ns);
+	seq_printf(m, "mean_ns %llu\np50_ns %llu\np90_ns %llu\n"
+		   "p99_ns %llu\np999_ns %llu\nmax_ns %llu\n",
+		   s->events ? div64_u64(s->sum_ns, s->events) : 0,
+		   digsig_replay_percentile(s, 500),
+		   digsig_replay_percentile(s, 900),
+		   digsig_replay_percentile(s, 990),
+		   digsig_replay_percentile(s, 999), s->max_ns);
+	seq_printf(m, "lock_contended %llu\nlock_wait_ns %llu\n",
+		   r->contended, r->wait_ns);
+	/* bin i holds the latencies from 2^i to 2^(i+1) - 1 ns */
+	for (i = 0; i < DIGSIG_REPLAY_BINS; i++)
+		if (s->bins[i])
+			seq_printf(m, "lat %llu %llu\n", 2ULL << i, s->bins[i]);
+out:
+	mutex_unlock(&digsig_replay_mutex);
+	return 0;
+}
+
+static int digsig_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_replay_show, NULL);
+}
+
+static ssize_t digsig_replay_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	size_t size;
+	char *p;
+	ssize_t rc = count;
+
+	mutex_lock(&digsig_replay_mutex);
+	if (*ppos == 0)
+		digsig_replay_drop();
+	if (*ppos != replay_len || replay_events ||
+	    count > DIGSIG_REPLAY_MAX_SIZE - replay_len) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	/* the buffer doubles, a long sequence comes in many writes */
+	if (replay_len + count > replay_size) {
+		size = max_t(size_t, replay_len + count, 2 * replay_size);
+		size = min_t(size_t, max_t(size_t, size, PAGE_SIZE),
+			     DIGSIG_REPLAY_MAX_SIZE);
+		p = vmalloc(size);
+		if (!p) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		if (replay_buf)
+			memcpy(p, replay_buf, replay_len);
+		vfree(replay_buf);
+		replay_buf = p;
+		replay_size = size;
+	}
+	if (copy_from_user(replay_buf + replay_len, buf, count)) {
+		rc = -EFAULT;
+		goto out;
+	}
+	replay_len += count;
+	*ppos += count;
+out:
+	mutex_unlock(&digsig_replay_mutex);
+	return rc;
+}
+
+static const struct file_operations digsig_replay_fops = {
+	.open = digsig_replay_open,
+	.read = seq_read,
+	.write = digsig_replay_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/replay.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_replay(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("replay", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_replay_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
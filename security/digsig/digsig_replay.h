@@ -0,0 +1,24 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the replay of recorded execs.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_REPLAY_H
+#define _DIGSIG_REPLAY_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_REPLAY
+int digsig_replay_run(const char *args);
+int digsig_init_replay(void);
+#else
+#define digsig_replay_run(args) (-EINVAL)
+#define digsig_init_replay() 0
+#endif
+
+#endif /* _DIGSIG_REPLAY_H */
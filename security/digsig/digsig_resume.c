@@ -0,0 +1,164 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the hash progress of a verification whose task was
+ * killed: the offset reached and the exported hash state are hung off
+ * the inode, and the next verification of the file, as long as it is
+ * unchanged, imports the state and hashes on from that offset instead
+ * of from the start.  Only files of dsi_resume_min_mb and more are
+ * worth it.
+ *
+ * The state is dropped when the file is opened for writing or its
+ * attributes change, as verdicts are, and is only taken once: a second
+ * interruption saves a state of its own.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/time.h>
+#include <crypto/hash.h>
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_resume.h"
+
+static int dsi_resume_min_mb = 64;
+module_param(dsi_resume_min_mb, int, 0);
+MODULE_PARM_DESC(dsi_resume_min_mb, "Keep the hash progress of interrupted verifications of files of this many megabytes and more.\n");
+
+/*
+ * digsig_resume: how far an interrupted verification hashed a file,
+ * and what the file looked like then.
+ */
+struct digsig_resume {
+	int algo;
+	loff_t pos;
+	loff_t sh_offset, sig_size;
+	loff_t size;
+	struct timespec mtime, ctime;
+	u64 version;
+	u32 igen;
+	u8 state[];
+};
+
+static void digsig_resume_fill(struct digsig_resume *r, struct inode *inode)
+{
+	r->size = i_size_read(inode);
+	r->mtime = inode->i_mtime;
+	r->ctime = inode->i_ctime;
+	r->version = digsig_inode_versioned(inode) ? inode->i_version : 0;
+	r->igen = inode->i_generation;
+}
+
+static int digsig_resume_match(const struct digsig_resume *r,
+			       const struct digsig_resume *cur)
+{
+	return r->algo == cur->algo && r->sh_offset == cur->sh_offset &&
+	       r->sig_size == cur->sig_size && r->size == cur->size &&
+	       timespec_equal(&r->mtime, &cur->mtime) &&
+	       timespec_equal(&r->ctime, &cur->ctime) &&
+	       r->version == cur->version && r->igen == cur->igen;
+}
+
+/******************************************************************************
+Description : Pick up the hash progress of an interrupted verification.
+Parameters  :
+	@ctx: a context whose verification was just started
+	@file: the file about to be hashed
+	@sh_offset, @sig_size: where its signature section is
+Return value: the offset to hash on from, whose state was imported into
+	the context's descriptor, or 0 to hash from the start
+******************************************************************************/
+loff_t digsig_resume_take(SIGCTX *ctx, struct file *file,
+			  loff_t sh_offset, unsigned long sig_size)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_resume *r, cur;
+	loff_t pos = 0;
+
+	if (!isec || !ACCESS_ONCE(isec->resume))
+		return 0;
+	r = xchg(&isec->resume, NULL);
+	if (!r)
+		return 0;
+
+	cur.algo = ctx->digestAlgo;
+	cur.sh_offset = sh_offset;
+	cur.sig_size = sig_size;
+	digsig_resume_fill(&cur, inode);
+	if (digsig_resume_match(r, &cur) && r->pos < cur.size &&
+	    !crypto_shash_import(ctx->desc, r->state)) {
+		pos = r->pos;
+		DSM_PRINT(DEBUG_SIGN, "%s: %s resumed at %lld\n", __func__,
+			  file->f_dentry->d_name.name, pos);
+	}
+	kfree(r);
+	return pos;
+}
+
+/******************************************************************************
+Description : Keep the hash progress of a verification about to give up.
+Parameters  :
+	@ctx: the context, whose descriptor holds the hash of the file up
+	      to @pos
+	@file: the file being hashed, held from writers meanwhile
+	@sh_offset, @sig_size: where its signature section is
+	@pos: how far the file was hashed
+Return value: none; progress that can not be kept is lost
+******************************************************************************/
+void digsig_resume_save(SIGCTX *ctx, struct file *file,
+			loff_t sh_offset, unsigned long sig_size,
+			loff_t pos)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct digsig_inode_sec *isec;
+	struct digsig_resume *r;
+
+	if (dsi_resume_min_mb < 0 || !pos ||
+	    i_size_read(inode) < (loff_t)dsi_resume_min_mb << 20)
+		return;
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return;
+
+	r = kmalloc(sizeof(*r) + crypto_shash_statesize(ctx->desc->tfm),
+		    GFP_KERNEL);
+	if (!r)
+		return;
+	if (crypto_shash_export(ctx->desc, r->state)) {
+		kfree(r);
+		return;
+	}
+	r->algo = ctx->digestAlgo;
+	r->pos = pos;
+	r->sh_offset = sh_offset;
+	r->sig_size = sig_size;
+	digsig_resume_fill(r, inode);
+
+	kfree(xchg(&isec->resume, r));
+	DSM_PRINT(DEBUG_SIGN, "%s: %s interrupted at %lld\n", __func__,
+		  file->f_dentry->d_name.name, pos);
+}
+
+/******************************************************************************
+Description : Drop the hash progress kept for an inode that may change.
+Parameters  :
+	@inode: the inode
+Return value: none
+******************************************************************************/
+void digsig_resume_forget(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (isec && ACCESS_ONCE(isec->resume))
+		kfree(xchg(&isec->resume, NULL));
+}
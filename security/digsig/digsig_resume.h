@@ -0,0 +1,35 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the hash progress kept for interrupted
+ * verifications.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_RESUME_H
+#define _DIGSIG_RESUME_H
+
+#include <linux/fs.h>
+
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_RESUME
+loff_t digsig_resume_take(SIGCTX *ctx, struct file *file,
+			  loff_t sh_offset, unsigned long sig_size);
+void digsig_resume_save(SIGCTX *ctx, struct file *file,
+			loff_t sh_offset, unsigned long sig_size,
+			loff_t pos);
+void digsig_resume_forget(struct inode *inode);
+#else
+#define digsig_resume_take(ctx, file, sh_offset, sig_size) ((loff_t)0)
+#define digsig_resume_save(ctx, file, sh_offset, sig_size, pos) \
+	do { } while (0)
+#define digsig_resume_forget(inode) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_RESUME_H */
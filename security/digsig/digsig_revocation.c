@@ -17,6 +17,8 @@
  * modifs: Chris Wright Sept 2004
  *         Serge Hallyn Sep 2004: added a hash table (keyed on the first 4
  +                        bytes of the hash) for quicker revocation lookup.
+ *         The table is now keyed on a digest of the whole signature,
+ *         grows with the list, and can be loaded in bulk.
  */
 
 #include <linux/moduleparam.h>
@@ -25,11 +27,23 @@
 #include <linux/uaccess.h>
 #include <linux/kobject.h>
 #include <linux/hash.h>
+#include <linux/rculist.h>
+#include <linux/jhash.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/cache.h>
+#include <linux/seq_file.h>
+#include <crypto/hash.h>
 
 #include "digsig_common.h"
-#include "digsig_cache.h"
 #include "digsig_revocation.h"
+#include "digsig_inode.h"
 #include "digsig_verify.h"
+#include "digsig_lockstat.h"
+#include "digsig_revoke_rules.h"
+#include "digsig_revoke_db.h"
 
 #ifdef CONFIG_SECURITY_DIGSIG_DEBUG
 #define DIGSIG_MODE 0		/*permissive  mode */
@@ -39,87 +53,612 @@
 #define DIGSIG_BENCH 0
 #endif
 
-DEFINE_SPINLOCK(revoked_list_wlock);
+static DEFINE_MUTEX(revoked_list_wlock);
 
-#define REVOKE_BITS 6
-#define REVOKE_BUCKETS 64
+/*
+ * Revoked signatures are kept in a hash table keyed by the SHA-256
+ * digest of their MPI magnitude, so that a lookup needs neither an MPI
+ * decode nor an MPI compare, and a revocation list is 32 bytes per
+ * entry.  The table is doubled whenever it holds more than two entries
+ * per bucket.  Each entry has a link for the current table and one for
+ * the next: a resize links every entry into the new table while readers
+ * still walk the old one, publishes the new table, and frees the old
+ * one once no reader can see it.
+ */
+#define REVOKE_MIN_BITS 6
+#define REVOKE_MAX_BITS 20
+
+/*
+ * Almost no signature looked up is revoked, so each table has a Bloom
+ * filter in front of its buckets, of 32 bits per bucket: at least 16
+ * bits per entry.  It is split in blocks of one cache line, and the
+ * REVOKE_BLOOM_PROBES bits of an entry are all in the block its hash
+ * picks, so that a negative lookup reads a single line.
+ */
+#define REVOKE_BLOOM_SHIFT 5		/* bits per bucket, log2 */
+#define REVOKE_BLOOM_BLOCK_SHIFT 9	/* bits per block, log2 */
+#define REVOKE_BLOOM_PROBES 3
+
+/* no list holds more entries than this */
+#define REVOKE_LIST_MAX (1U << 20)
+
+/*
+ * revoked_table: one generation of the table.  @bulk is the array the
+ * entries of the last bulk list live in, which are not freed one by one;
+ * it is handed on to the tables the list grows into.
+ */
+struct revoked_table {
+	unsigned int bits;
+	int idx;			/* of the entries' links used here */
+	unsigned long *bloom;		/* after the buckets */
+	struct revoked_sig *bulk;
+	struct hlist_head buckets[];
+};
+
+static struct revoked_table __rcu *dsi_revoked_sigs;
+static unsigned int revoked_count;
+
+/*
+ * Order-independent summary of the revoked signatures loaded so far.
+ * Persistent verdicts record it, so that loading a revocation list
+ * different from the one in force when a file was stamped makes the
+ * stamp worthless.
+ */
+static u32 revoked_stamp;
+
+/*
+ * The key of a signature: the digest of the bytes of its MPI magnitude,
+ * without the bit count and leading zeroes that GPG allows, so that two
+ * encodings of the same signature have the same key.
+ */
+static int digsig_revoked_digest(const unsigned char *raw, int len, u8 *digest)
+{
+	struct crypto_shash *tfm = digsig_get_shash(HASH_SHA256);
+	unsigned int nbytes;
+
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	if (len < 2)
+		return -EINVAL;
+	nbytes = (((raw[0] << 8) | raw[1]) + 7) / 8;
+	if (nbytes > len - 2)
+		return -EINVAL;
+	for (raw += 2; nbytes && !*raw; raw++)
+		nbytes--;
+
+	{
+		struct {
+			struct shash_desc shash;
+			char ctx[crypto_shash_descsize(tfm)];
+		} desc;
+
+		desc.shash.tfm = tfm;
+		desc.shash.flags = 0;
+		return crypto_shash_digest(&desc.shash, raw, nbytes, digest);
+	}
+}
+
+/*
+ * The digests are uniform, their first word is as good a hash as any.
+ * Verdicts record it, with 0 standing for an unknown signature.
+ */
+static inline u32 digsig_revoked_hash(const u8 *digest)
+{
+	u32 hash;
+
+	memcpy(&hash, digest, sizeof(hash));
+	return hash;
+}
+
+#define REVOKE_BLOOM_BLOCK_MASK ((1U << REVOKE_BLOOM_BLOCK_SHIFT) - 1)
+
+/*
+ * The block of an entry comes from the top bits of its hash, as its
+ * bucket does, and its bits within the block from a mix of the whole
+ * hash.
+ */
+static inline unsigned int digsig_bloom_block(struct revoked_table *t,
+					      u32 hash)
+{
+	return hash_32(hash, t->bits + REVOKE_BLOOM_SHIFT -
+		       REVOKE_BLOOM_BLOCK_SHIFT) << REVOKE_BLOOM_BLOCK_SHIFT;
+}
+
+static inline u32 digsig_bloom_mix(u32 h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	return h ^ (h >> 16);
+}
+
+static void digsig_bloom_add(struct revoked_table *t, u32 hash)
+{
+	unsigned int block = digsig_bloom_block(t, hash);
+	u32 mix = digsig_bloom_mix(hash);
+	int i;
+
+	for (i = 0; i < REVOKE_BLOOM_PROBES; i++) {
+		set_bit(block + (mix & REVOKE_BLOOM_BLOCK_MASK), t->bloom);
+		mix >>= REVOKE_BLOOM_BLOCK_SHIFT;
+	}
+}
+
+static int digsig_bloom_test(struct revoked_table *t, u32 hash)
+{
+	unsigned int block = digsig_bloom_block(t, hash);
+	u32 mix = digsig_bloom_mix(hash);
+	int i;
+
+	for (i = 0; i < REVOKE_BLOOM_PROBES; i++) {
+		if (!test_bit(block + (mix & REVOKE_BLOOM_BLOCK_MASK), t->bloom))
+			return 0;
+		mix >>= REVOKE_BLOOM_BLOCK_SHIFT;
+	}
+	return 1;
+}
+
+static struct revoked_sig *
+digsig_revoked_find(struct revoked_table *t, const u8 *digest, u32 hash)
+{
+	struct revoked_sig *e;
+
+	hlist_for_each_entry_rcu(e,
+			&t->buckets[hash_32(hash, t->bits)], node[t->idx]) {
+		if (e->hash == hash &&
+		    !memcmp(e->digest, digest, REVOKE_DIGEST_SIZE))
+			return e;
+	}
+	return NULL;
+}
 
-static struct hlist_head dsi_revoked_sigs[REVOKE_BUCKETS];
+/* the filter bits are set before the entry can be found */
+static void digsig_revoked_link(struct revoked_table *t, struct revoked_sig *e)
+{
+	digsig_bloom_add(t, e->hash);
+	hlist_add_head_rcu(&e->node[t->idx],
+			   &t->buckets[hash_32(e->hash, t->bits)]);
+}
+
+static struct revoked_table *digsig_revoked_table_alloc(unsigned int bits)
+{
+	size_t size = sizeof(struct revoked_table) +
+		      (sizeof(struct hlist_head) << bits) + L1_CACHE_BYTES +
+		      ((1UL << (bits + REVOKE_BLOOM_SHIFT)) / BITS_PER_BYTE);
+	struct revoked_table *t;
+
+	if (size <= PAGE_SIZE)
+		t = kzalloc(size, GFP_KERNEL);
+	else
+		t = vzalloc(size);
+	if (!t)
+		return NULL;
+
+	t->bits = bits;
+	t->bloom = PTR_ALIGN((unsigned long *)&t->buckets[1U << bits],
+			     L1_CACHE_BYTES);
+	return t;
+}
+
+static void digsig_revoked_vfree(void *p)
+{
+	if (is_vmalloc_addr(p))
+		vfree(p);
+	else
+		kfree(p);
+}
+
+/* Free a table no reader can see any more, and the entries in it. */
+static void digsig_revoked_table_destroy(struct revoked_table *t)
+{
+	struct hlist_node *tmp;
+	struct revoked_sig *e;
+	unsigned int i;
+
+	for (i = 0; i < (1U << t->bits); i++)
+		hlist_for_each_entry_safe(e, tmp, &t->buckets[i], node[t->idx])
+			if (!e->bulk)
+				kfree(e);
+	digsig_revoked_vfree(t->bulk);
+	digsig_revoked_vfree(t);
+}
+
+/* Double the table; a table that can not grow just gets longer chains. */
+static void digsig_revoked_grow(struct revoked_table *old)
+{
+	struct revoked_table *t;
+	struct revoked_sig *e;
+	unsigned int i;
+
+	t = digsig_revoked_table_alloc(old->bits + 1);
+	if (!t)
+		return;
+	t->idx = !old->idx;
+	t->bulk = old->bulk;
+
+	for (i = 0; i < (1U << old->bits); i++)
+		hlist_for_each_entry(e, &old->buckets[i], node[old->idx])
+			digsig_revoked_link(t, e);
+
+	rcu_assign_pointer(dsi_revoked_sigs, t);
+	synchronize_rcu();
+	digsig_revoked_vfree(old);
+}
 
 /*
  * Description: Called at exec (digsig_verify_signature) to check whether the
  *  signature has been revoked.  If it has, exec permission is outright
- *  denied.
+ *  denied.  Verifications run concurrently, so the table is walked
+ *  under RCU and never takes revoked_list_wlock.
+ *  raw is the signature MPI as encoded in the packet, len the bytes
+ *  left in the packet from there.  The hash of the signature is stored
+ *  in *hash for the verdict to record; it is left alone if the
+ *  signature can not be decoded.
  */
 #ifdef CONFIG_SECURITY_DIGSIG_REVOCATION
-int digsig_is_revoked_sig(char *buffer)
+int digsig_is_revoked_sig(const unsigned char *raw, int len, u32 *hash)
 {
-	struct hlist_node *tmp;
-	char *tmp1 = buffer + DIGSIG_BSIGN_INFOS + DIGSIG_RSA_DATA_OFFSET;
-	int count = DIGSIG_ELF_SIG_SIZE - DIGSIG_BSIGN_INFOS - DIGSIG_RSA_DATA_OFFSET;
-	int h, ret = 0;
-	MPI file_sig = mpi_read_from_buffer(tmp1, &count, 0);
+	u8 digest[REVOKE_DIGEST_SIZE];
+	struct revoked_table *t;
+	int ret = 0;
 
-	h = hash_long(*(unsigned long *)tmp1, REVOKE_BITS);
+	if (digsig_revoked_digest(raw, len, digest))
+		return 0;	/* nor will it verify */
+	*hash = digsig_revoked_hash(digest);
+	if (digsig_revoke_db_listed(digest))
+		return 1;
+	if (!ACCESS_ONCE(revoked_count))
+		return 0;
 
-	hlist_for_each(tmp, &dsi_revoked_sigs[h]) {
-		struct revoked_sig *e = hlist_entry(tmp, struct revoked_sig, next);
-		if (mpi_cmp(file_sig, e->sig) == 0) {
-			ret = 1;
-			goto out;
+	rcu_read_lock();
+	t = rcu_dereference(dsi_revoked_sigs);
+	if (t && digsig_bloom_test(t, *hash) &&
+	    digsig_revoked_find(t, digest, *hash))
+		ret = 1;
+	rcu_read_unlock();
+
+	return ret;
+}
+
+/*
+ * Description: Called when the revocation list changed since a verdict
+ *  was made, on the hash the verdict recorded.  A hash the filter or a
+ *  bucket has is taken as listed, without the digest to tell for sure:
+ *  that only costs verifying the file again.
+ */
+int digsig_revoked_hash_listed(u32 hash)
+{
+	struct revoked_table *t;
+	struct revoked_sig *e;
+	int ret = 0;
+
+	if (!hash)
+		return 1;	/* the signature is not known */
+	if (digsig_revoke_db_hash_listed(hash))
+		return 1;
+
+	rcu_read_lock();
+	t = rcu_dereference(dsi_revoked_sigs);
+	if (t && digsig_bloom_test(t, hash)) {
+		hlist_for_each_entry_rcu(e,
+			&t->buckets[hash_32(hash, t->bits)], node[t->idx]) {
+			if (e->hash == hash) {
+				ret = 1;
+				break;
+			}
 		}
 	}
+	rcu_read_unlock();
 
-out:
-	mpi_free(file_sig);
 	return ret;
 }
+
+/*
+ * Description: Is any signature revoked, by the list or the database?
+ *  Signatures that are screened together are not checked by their
+ *  bytes, see digsig_screen.c.
+ */
+int digsig_revoked_sigs(void)
+{
+	return ACCESS_ONCE(revoked_count) || digsig_revoke_db_any();
+}
 #endif
 
+/*
+ * Verdicts made before the list changed may be of revoked signatures:
+ * each is checked against the list on its next lookup.
+ */
+static void digsig_revoked_changed(void)
+{
+	digsig_inode_invalidate_all();
+}
+
 int digsig_add_revoked_sig(const char *buffer)
 {
-	int rcount = DIGSIG_ELF_SIG_SIZE - DIGSIG_BSIGN_INFOS - DIGSIG_RSA_DATA_OFFSET;
-	const char *tmp1 = buffer + DIGSIG_BSIGN_INFOS + DIGSIG_RSA_DATA_OFFSET;
+	struct digsig_sig_info info;
+	struct revoked_table *t;
 	struct revoked_sig *s;
-	int h;
+	int ret = 0;
 
-	s = kmalloc(sizeof(struct revoked_sig), GFP_ATOMIC);
+	if (digsig_parse_signature((char *)buffer, DIGSIG_ELF_SIG_SIZE,
+				   &info))
+		return -EINVAL;
 
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
 	if (!s)
 		return -ENOMEM;
+	ret = digsig_revoked_digest(info.packet + DIGSIG_RSA_DATA_OFFSET,
+				    info.packet_len - DIGSIG_RSA_DATA_OFFSET,
+				    s->digest);
+	if (ret) {
+		kfree(s);
+		return ret;
+	}
+	s->hash = digsig_revoked_hash(s->digest);
 
-	INIT_HLIST_NODE(&s->next);
+	digsig_mutex_lock(&revoked_list_wlock, DIGSIG_LS_REVOKED_ADD);
+	t = rcu_dereference_protected(dsi_revoked_sigs,
+				      lockdep_is_held(&revoked_list_wlock));
+	if (!t) {
+		t = digsig_revoked_table_alloc(REVOKE_MIN_BITS);
+		if (!t) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		rcu_assign_pointer(dsi_revoked_sigs, t);
+	}
+	if (revoked_count >= REVOKE_LIST_MAX) {
+		ret = -ENOSPC;
+		goto out;
+	}
+	if (digsig_revoked_find(t, s->digest, s->hash))
+		goto out;	/* already revoked */
 
-	h = hash_long(*(unsigned long *)tmp1, REVOKE_BITS);
-	s->sig = mpi_read_from_buffer(tmp1, &rcount, 0);
-	spin_lock(&revoked_list_wlock);
-	hlist_add_head(&s->next, &dsi_revoked_sigs[h]);
-	spin_unlock(&revoked_list_wlock);
+	digsig_revoked_link(t, s);
+	revoked_stamp += jhash(s->digest, REVOKE_DIGEST_SIZE, 0);
+	s = NULL;
+	if (++revoked_count > (2U << t->bits) && t->bits < REVOKE_MAX_BITS)
+		digsig_revoked_grow(t);
+out:
+	digsig_mutex_unlock(&revoked_list_wlock, DIGSIG_LS_REVOKED_ADD);
+	kfree(s);
+	if (ret)
+		return ret;
 
+	digsig_revoked_changed();
 	return 0;
 }
 
-inline void digsig_init_revocation(void)
-{
-	int i;
+/*
+ * A bulk list is staged here as it is written, and replaces the
+ * revocations in force once all of it is in.
+ */
+static DEFINE_MUTEX(revoke_list_mutex);
+static char *revoke_list;
+static size_t revoke_list_size, revoke_list_len;
 
-	for (i = 0; i < REVOKE_BUCKETS; i++)
-		INIT_HLIST_HEAD(&dsi_revoked_sigs[i]);
+static void digsig_revoke_list_drop(void)
+{
+	digsig_revoked_vfree(revoke_list);
+	revoke_list = NULL;
+	revoke_list_size = revoke_list_len = 0;
 }
 
-void digsig_cleanup_revocation(void)
+/* Build a table of the staged list and put it in force. */
+static int digsig_revoke_list_commit(void)
 {
-	int i;
-	struct hlist_node *tmp;
+	struct digsig_revoke_list_hdr *hdr = (void *)revoke_list;
+	u32 count = le32_to_cpu(hdr->count);
+	u32 sig_size = le32_to_cpu(hdr->sig_size);
+	const u8 *digests = (const u8 *)(hdr + 1);
+	struct revoked_table *t, *old;
 	struct revoked_sig *e;
+	unsigned int bits;
+	u32 i, n, stamp = 0;
+	int rc;
+
+	if (sig_size) {
+		rc = digsig_verify_buffer(revoke_list,
+					  revoke_list_size - sig_size,
+					  revoke_list + revoke_list_size - sig_size,
+					  sig_size);
+		if (rc)
+			return rc;
+	} else if (g_init) {
+		/* a list may drop revocations, so only a signed one */
+		return -EPERM;
+	}
+
+	bits = REVOKE_MIN_BITS;
+	while ((2U << bits) < count && bits < REVOKE_MAX_BITS)
+		bits++;
+	t = digsig_revoked_table_alloc(bits);
+	if (!t)
+		return -ENOMEM;
+	if (count) {
+		t->bulk = vzalloc(count * sizeof(*e));
+		if (!t->bulk) {
+			digsig_revoked_vfree(t);
+			return -ENOMEM;
+		}
+	}
+
+	for (i = 0, n = 0; i < count; i++) {
+		e = &t->bulk[n];
+		memcpy(e->digest, digests + i * REVOKE_DIGEST_SIZE,
+		       REVOKE_DIGEST_SIZE);
+		e->hash = digsig_revoked_hash(e->digest);
+		e->bulk = 1;
+		if (digsig_revoked_find(t, e->digest, e->hash))
+			continue;
+		digsig_revoked_link(t, e);
+		stamp += jhash(e->digest, REVOKE_DIGEST_SIZE, 0);
+		n++;
+	}
+
+	digsig_mutex_lock(&revoked_list_wlock, DIGSIG_LS_REVOKED_LIST);
+	old = rcu_dereference_protected(dsi_revoked_sigs,
+					lockdep_is_held(&revoked_list_wlock));
+	rcu_assign_pointer(dsi_revoked_sigs, t);
+	revoked_count = n;
+	revoked_stamp = stamp;
+	digsig_mutex_unlock(&revoked_list_wlock, DIGSIG_LS_REVOKED_LIST);
+
+	digsig_revoked_changed();
+	if (old) {
+		synchronize_rcu();
+		digsig_revoked_table_destroy(old);
+	}
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %u revocations in force\n", __func__, n);
+	return 0;
+}
+
+/******************************************************************************
+Description : Take the next part of a bulk revocation list.  A write at
+	offset 0 starts a new list; the list replaces the revocations in
+	force once its last byte is written.  After the key is loaded, only
+	signed lists are accepted, as a list may drop revocations.
+Parameters  :
+	@buf, @off, @count: the part written, where it goes in the list
+Return value: @count, or a negative error, after which the list must be
+	written again from the start
+******************************************************************************/
+ssize_t digsig_revoke_list_write(const char *buf, loff_t off, size_t count)
+{
+	struct digsig_revoke_list_hdr *hdr;
+	size_t size;
+	ssize_t rc = count;
+	u32 n, sig_size;
+
+	mutex_lock(&revoke_list_mutex);
+	if (off == 0) {
+		digsig_revoke_list_drop();
+
+		hdr = (struct digsig_revoke_list_hdr *)buf;
+		if (count < sizeof(*hdr) ||
+		    memcmp(hdr->magic, DIGSIG_REVOKE_LIST_MAGIC,
+			   sizeof(hdr->magic))) {
+			rc = -EINVAL;
+			goto out;
+		}
+		n = le32_to_cpu(hdr->count);
+		sig_size = le32_to_cpu(hdr->sig_size);
+		if (n > REVOKE_LIST_MAX ||
+		    (sig_size && sig_size != DIGSIG_ELF_SIG_SIZE &&
+		     sig_size != DIGSIG_ED25519_SIG_SIZE)) {
+			rc = -EINVAL;
+			goto out;
+		}
+
+		size = sizeof(*hdr) + (size_t)n * REVOKE_DIGEST_SIZE + sig_size;
+		revoke_list = vmalloc(size);
+		if (!revoke_list) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		revoke_list_size = size;
+	}
+
+	if (!revoke_list || off != revoke_list_len ||
+	    count > revoke_list_size - revoke_list_len) {
+		digsig_revoke_list_drop();
+		rc = -EINVAL;
+		goto out;
+	}
 
-	for (i = 0; i < REVOKE_BUCKETS; i++) {
-		while (!hlist_empty(&dsi_revoked_sigs[i])) {
-			tmp = dsi_revoked_sigs[i].first;
-			hlist_del(tmp);
-			e = hlist_entry(tmp, struct revoked_sig, next);
-			mpi_free(e->sig);
-			kfree(e);
+	memcpy(revoke_list + revoke_list_len, buf, count);
+	revoke_list_len += count;
+	if (revoke_list_len == revoke_list_size) {
+		int err = digsig_revoke_list_commit();
+
+		if (err) {
+			DSM_ERROR("%s: revocation list refused: %d\n",
+				  __func__, err);
+			rc = err;
 		}
+		digsig_revoke_list_drop();
 	}
+out:
+	mutex_unlock(&revoke_list_mutex);
+	return rc;
+}
+
+u32 digsig_revocation_stamp(void)
+{
+	return ACCESS_ONCE(revoked_stamp) + digsig_revoke_rules_stamp() +
+	       digsig_revoke_db_stamp();
+}
+
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+/*
+ * /sys/kernel/security/digsig/revoked walks the table a bucket at a
+ * time under RCU: a list loaded meanwhile is shown in part.
+ */
+static void *digsig_revoked_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct revoked_table *t;
+
+	rcu_read_lock();
+	t = rcu_dereference(dsi_revoked_sigs);
+	m->private = t;
+	if (!t || *pos >= (1U << t->bits))
+		return NULL;
+	return &t->buckets[*pos];
+}
+
+static void *digsig_revoked_seq_next(struct seq_file *m, void *v,
+				     loff_t *pos)
+{
+	struct revoked_table *t = m->private;
+
+	if (++*pos >= (1U << t->bits))
+		return NULL;
+	return &t->buckets[*pos];
+}
+
+static void digsig_revoked_seq_stop(struct seq_file *m, void *v)
+{
+	rcu_read_unlock();
+}
+
+static int digsig_revoked_seq_show(struct seq_file *m, void *v)
+{
+	struct revoked_table *t = m->private;
+	struct revoked_sig *e;
+
+	hlist_for_each_entry_rcu(e, (struct hlist_head *)v, node[t->idx])
+		seq_printf(m, "%*phN %08x%s\n", REVOKE_DIGEST_SIZE, e->digest,
+			   e->hash, e->bulk ? " bulk" : "");
+	return 0;
+}
+
+const struct seq_operations digsig_revoked_seq_ops = {
+	.start = digsig_revoked_seq_start,
+	.next = digsig_revoked_seq_next,
+	.stop = digsig_revoked_seq_stop,
+	.show = digsig_revoked_seq_show,
+};
+#endif
+
+inline void digsig_init_revocation(void)
+{
+}
+
+void digsig_cleanup_revocation(void)
+{
+	struct revoked_table *t;
+
+	mutex_lock(&revoked_list_wlock);
+	t = rcu_dereference_protected(dsi_revoked_sigs,
+				      lockdep_is_held(&revoked_list_wlock));
+	RCU_INIT_POINTER(dsi_revoked_sigs, NULL);
+	revoked_count = 0;
+	mutex_unlock(&revoked_list_wlock);
+	if (!t)
+		return;
+
+	synchronize_rcu();
+	digsig_revoked_table_destroy(t);
 }
@@ -19,26 +19,53 @@
 #define _DSI_REVOKE_H
 
 #include <linux/fs.h>
-#include "gnupg/mpi/mpi.h"
+#include <linux/types.h>
+
+#define REVOKE_DIGEST_SIZE 32	/* SHA-256 */
 
 /*
- * A linear array of revoked signatures.
- *
- * If performance is a concern, this could be changed to a hash
- * table.
+ * A revoked signature, by the SHA-256 digest of its MPI magnitude.  It
+ * is linked into the hash table through node[table->idx].
  */
 struct revoked_sig {
-	struct hlist_node next;
-	MPI sig;
+	struct hlist_node node[2];
+	u32 hash;
+	u8 bulk;		/* in the array of a bulk list */
+	u8 digest[REVOKE_DIGEST_SIZE];
 };
 
+/*
+ * Format of a bulk revocation list, written to /sys/digsig/revoke_list:
+ * - struct digsig_revoke_list_hdr
+ * - count digests, each the SHA-256 digest of the magnitude of a revoked
+ *   signature MPI: its bytes without the leading zeroes
+ * - if sig_size is not 0, a signature section of that size, in the
+ *   format of the ELF signature section, signing everything before it
+ */
+#define DIGSIG_REVOKE_LIST_MAGIC "DSREVOK1"
+
+struct digsig_revoke_list_hdr {
+	u8 magic[8];
+	__le32 count;
+	__le32 sig_size;
+} __packed;
+
 void digsig_init_revocation(void);
 void digsig_cleanup_revocation(void);
 int digsig_add_revoked_sig(const char *buffer);
+ssize_t digsig_revoke_list_write(const char *buf, loff_t off, size_t count);
+u32 digsig_revocation_stamp(void);
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+extern const struct seq_operations digsig_revoked_seq_ops;
+#endif
 #ifdef CONFIG_SECURITY_DIGSIG_REVOCATION
-int digsig_is_revoked_sig(char *buffer);
+int digsig_is_revoked_sig(const unsigned char *raw, int len, u32 *hash);
+int digsig_revoked_hash_listed(u32 hash);
+int digsig_revoked_sigs(void);
 #else
-#define digsig_is_revoked_sig(x) 0
+#define digsig_is_revoked_sig(raw, len, hash) 0
+#define digsig_revoked_hash_listed(hash) 0
+#define digsig_revoked_sigs() 0
 #endif
 
 #endif /* _DSI_REVOKE_H */
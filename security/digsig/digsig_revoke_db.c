@@ -0,0 +1,260 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file loads a prebuilt revocation database, dsi_revoke_db, when
+ * the key is loaded, before the hooks are turned on.  The database is
+ * in the layout it is used in: a Bloom filter, then the sorted digests
+ * of the revoked signatures, then a signature over both.  It is read
+ * whole, its signature checked once, and looked up where it lies, so
+ * that a list of any size costs one read and one hash at boot, rather
+ * than an allocation and a link per entry.
+ *
+ * A signature is looked up in its block of the filter, a single cache
+ * line, and only then searched for among the digests.  The database
+ * revokes signatures on top of the revocation lists, and is not
+ * replaced once loaded.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/err.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+
+#include "digsig_common.h"
+#include "digsig_format.h"
+#include "digsig_verify.h"
+#include "digsig_inode.h"
+#include "digsig_revoke_db.h"
+
+static char *dsi_revoke_db = "/lib/digsig/revoked.db";
+module_param(dsi_revoke_db, charp, 0);
+MODULE_PARM_DESC(dsi_revoke_db, "Path of the revocation database loaded with the key, empty for none.\n");
+
+struct digsig_revoke_db {
+	void *blob;
+	const u8 *bloom;
+	unsigned int shift;	/* of the filter bits */
+	const u8 *digests;
+	u32 count;
+	u32 stamp;
+};
+
+static struct digsig_revoke_db *digsig_revoke_db;
+static int digsig_revoke_db_tried;
+
+static int digsig_revoke_db_bloom_test(struct digsig_revoke_db *db,
+				       const u8 *digest)
+{
+	u32 block = get_unaligned_le32(digest + 4) &
+		((1U << (db->shift - DIGSIG_REVOKE_DB_BLOCK_SHIFT)) - 1);
+	u32 probe = get_unaligned_le32(digest + 8);
+	u32 bit;
+	int i;
+
+	block <<= DIGSIG_REVOKE_DB_BLOCK_SHIFT;
+	for (i = 0; i < DIGSIG_REVOKE_DB_PROBES; i++) {
+		bit = block + (probe & ((1U << DIGSIG_REVOKE_DB_BLOCK_SHIFT) - 1));
+		if (!(db->bloom[bit >> 3] & (1U << (bit & 7))))
+			return 0;
+		probe >>= DIGSIG_REVOKE_DB_BLOCK_SHIFT;
+	}
+	return 1;
+}
+
+/* the first of the digests that does not sort before the first len bytes */
+static u32 digsig_revoke_db_search(struct digsig_revoke_db *db, const u8 *key,
+				   size_t len)
+{
+	u32 lo = 0, hi = db->count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (memcmp(db->digests + (size_t)mid *
+			   DIGSIG_REVOKE_DB_DIGEST_SIZE, key, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/******************************************************************************
+Description : Is the signature of the digest in the database?
+Parameters  :
+	@digest: the SHA-256 digest of the magnitude of the signature MPI
+Return value: 1 if it is revoked, 0 otherwise
+******************************************************************************/
+int digsig_revoke_db_listed(const u8 *digest)
+{
+	struct digsig_revoke_db *db = ACCESS_ONCE(digsig_revoke_db);
+	u32 i;
+
+	if (!db || !digsig_revoke_db_bloom_test(db, digest))
+		return 0;
+	smp_read_barrier_depends();
+	i = digsig_revoke_db_search(db, digest, DIGSIG_REVOKE_DB_DIGEST_SIZE);
+	return i < db->count &&
+	       !memcmp(db->digests + (size_t)i * DIGSIG_REVOKE_DB_DIGEST_SIZE,
+		       digest, DIGSIG_REVOKE_DB_DIGEST_SIZE);
+}
+
+/******************************************************************************
+Description : Is a signature of the hash a verdict recorded in the
+	database?  The hash is the first four bytes of the digest.
+Parameters  :
+	@hash: the hash of the signature
+Return value: 1 if one may be revoked, 0 otherwise
+******************************************************************************/
+int digsig_revoke_db_hash_listed(u32 hash)
+{
+	struct digsig_revoke_db *db = ACCESS_ONCE(digsig_revoke_db);
+	u32 i;
+
+	if (!db)
+		return 0;
+	smp_read_barrier_depends();
+	i = digsig_revoke_db_search(db, (const u8 *)&hash, sizeof(hash));
+	return i < db->count &&
+	       !memcmp(db->digests + (size_t)i * DIGSIG_REVOKE_DB_DIGEST_SIZE,
+		       &hash, sizeof(hash));
+}
+
+/* Are any signatures revoked by the database? */
+int digsig_revoke_db_any(void)
+{
+	struct digsig_revoke_db *db = ACCESS_ONCE(digsig_revoke_db);
+
+	return db && db->count;
+}
+
+u32 digsig_revoke_db_stamp(void)
+{
+	struct digsig_revoke_db *db = ACCESS_ONCE(digsig_revoke_db);
+
+	return db ? db->stamp : 0;
+}
+
+static int digsig_revoke_db_read(struct file *file, void *buf, size_t len)
+{
+	loff_t pos = 0;
+	int n;
+
+	while (pos < len) {
+		n = kernel_read(file, pos, (char *)buf + pos,
+				min_t(size_t, len - pos, INT_MAX));
+		if (n <= 0)
+			return n < 0 ? n : -EIO;
+		pos += n;
+	}
+	return 0;
+}
+
+/* Check the header against the size of the file, and find the parts. */
+static int digsig_revoke_db_parse(struct digsig_revoke_db *db,
+				  const struct digsig_revoke_db_hdr *hdr,
+				  loff_t size)
+{
+	u32 count = le32_to_cpu(hdr->count);
+	u32 sig_size = le32_to_cpu(hdr->sig_size);
+	u32 shift = le32_to_cpu(hdr->bloom_shift);
+	u64 bloom_size;
+
+	if (memchr_inv(hdr->reserved, 0, sizeof(hdr->reserved)) ||
+	    memcmp(hdr->magic, DIGSIG_REVOKE_DB_MAGIC, sizeof(hdr->magic)) ||
+	    count > DIGSIG_REVOKE_DB_MAX ||
+	    shift < DIGSIG_REVOKE_DB_BLOCK_SHIFT ||
+	    shift > DIGSIG_REVOKE_DB_MAX_SHIFT ||
+	    (sig_size != DIGSIG_ELF_SIG_SIZE &&
+	     sig_size != DIGSIG_ED25519_SIG_SIZE))
+		return -EINVAL;
+	bloom_size = (1ULL << shift) / BITS_PER_BYTE;
+	if (size != sizeof(*hdr) + bloom_size +
+		    (u64)count * DIGSIG_REVOKE_DB_DIGEST_SIZE + sig_size)
+		return -EINVAL;
+
+	db->shift = shift;
+	db->count = count;
+	db->bloom = (const u8 *)db->blob + sizeof(*hdr);
+	db->digests = db->bloom + bloom_size;
+	return 0;
+}
+
+/******************************************************************************
+Description : Load the revocation database, once, as the key is loaded;
+	a database that is missing is not an error, one that does not
+	verify is refused.  The key must be usable already.
+Parameters  : none
+Return value: none
+******************************************************************************/
+void digsig_revoke_db_load(void)
+{
+	struct digsig_revoke_db_hdr hdr;
+	struct digsig_revoke_db *db;
+	struct file *file;
+	loff_t size;
+	size_t sig_at;
+	int rc;
+
+	if (digsig_revoke_db_tried || !dsi_revoke_db || !*dsi_revoke_db)
+		return;
+	digsig_revoke_db_tried = 1;
+
+	file = filp_open(dsi_revoke_db, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return;
+	db = kzalloc(sizeof(*db), GFP_KERNEL);
+	size = i_size_read(file_inode(file));
+	rc = -ENOMEM;
+	if (!db)
+		goto out;
+	rc = -EINVAL;
+	if (!S_ISREG(file_inode(file)->i_mode) ||
+	    kernel_read(file, 0, (char *)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    digsig_revoke_db_parse(db, &hdr, size))
+		goto out;
+
+	rc = -ENOMEM;
+	db->blob = vmalloc(size);
+	if (!db->blob)
+		goto out;
+	rc = digsig_revoke_db_read(file, db->blob, size);
+	if (rc)
+		goto out;
+	/* the header read again is the one checked */
+	rc = -EINVAL;
+	if (digsig_revoke_db_parse(db, db->blob, size))
+		goto out;
+
+	sig_at = size - le32_to_cpu(hdr.sig_size);
+	rc = digsig_verify_buffer(db->blob, sig_at, (char *)db->blob + sig_at,
+				  size - sig_at);
+	if (rc)
+		goto out;
+	db->stamp = jhash((char *)db->blob + sig_at, size - sig_at, 0) | 1;
+
+	/* the database is complete before it can be seen */
+	smp_wmb();
+	ACCESS_ONCE(digsig_revoke_db) = db;
+	db = NULL;
+	digsig_inode_invalidate_all();
+	DSM_LOG(DIGSIG_MODULE_NAME ": %u revocations from %s\n",
+		digsig_revoke_db->count, dsi_revoke_db);
+out:
+	fput(file);
+	if (db) {
+		DSM_ERROR("%s: %s refused: %d\n", __func__, dsi_revoke_db, rc);
+		vfree(db->blob);
+		kfree(db);
+	}
+}
@@ -0,0 +1,32 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the revocation database loaded with the key.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_REVOKE_DB_H
+#define _DIGSIG_REVOKE_DB_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_REVOKE_DB
+void digsig_revoke_db_load(void);
+int digsig_revoke_db_listed(const u8 *digest);
+int digsig_revoke_db_hash_listed(u32 hash);
+int digsig_revoke_db_any(void);
+u32 digsig_revoke_db_stamp(void);
+#else
+#define digsig_revoke_db_load() do { } while (0)
+#define digsig_revoke_db_listed(digest) 0
+#define digsig_revoke_db_hash_listed(hash) 0
+#define digsig_revoke_db_any() 0
+#define digsig_revoke_db_stamp() 0
+#endif
+
+#endif /* _DIGSIG_REVOKE_DB_H */
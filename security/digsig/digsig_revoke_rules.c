@@ -0,0 +1,346 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file revokes signatures by rule rather than one by one, so that
+ * everything a compromised build server signed can be revoked without
+ * listing each signature it made.  Rules are written to
+ * /sys/kernel/security/digsig/revoke_rules, one per line:
+ *
+ *   key <key ID>              every signature of the key
+ *   key <key ID> <from> <to>  those made between the two times, in
+ *                             seconds since the epoch, both included
+ *   digest <hash> <digest>    any signature of that digest
+ *
+ * Key IDs and digests are in hex.  The time is the one GPG puts in the
+ * signature packet; Ed25519 signatures have none, so a rule with a time
+ * range revokes every Ed25519 signature of its key.  The digest is the
+ * one the signature is of: that of the file with its signature section
+ * zeroed, as for a manifest.
+ *
+ * Rules are only ever added, and a verification looks at each key rule
+ * and at one bucket of the digest rules, whatever number of files they
+ * cover.  Verdicts made before a rule was added are made again rather
+ * than rechecked, as they do not record what the rules look at.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/jhash.h>
+#include <asm/unaligned.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_inode.h"
+#include "digsig_verify.h"
+#include "digsig_revoke_rules.h"
+
+#define DIGSIG_KEY_RULES 64
+#define DIGSIG_DIGEST_RULES (1U << 16)
+#define DIGSIG_DIGEST_RULE_BITS 12
+
+struct digsig_key_rule {
+	u8 keyid[DIGSIG_KEYID_SIZE];
+	u32 from, to;
+};
+
+struct digsig_digest_rule {
+	struct hlist_node node;
+	u8 algo;
+	u8 digest[DIGSIG_MAX_DIGEST_LENGTH];
+};
+
+static DEFINE_MUTEX(digsig_revoke_rules_mutex);
+
+/* only ever appended to: readers see an entry once they see the count */
+static struct digsig_key_rule digsig_key_rules[DIGSIG_KEY_RULES];
+static unsigned int digsig_key_rule_count;
+
+static DEFINE_HASHTABLE(digsig_digest_rules, DIGSIG_DIGEST_RULE_BITS);
+unsigned int digsig_digest_rule_count;
+
+/* the generation the last rule was added in; see digsig_revoke_rules_older */
+static unsigned int digsig_revoke_rules_gen;
+static int digsig_revoke_rules_any;
+static u32 digsig_rules_stamp;
+
+static inline u32 digsig_digest_rule_key(int algo, const u8 *digest)
+{
+	return get_unaligned((const u32 *)digest) ^ algo;
+}
+
+/******************************************************************************
+Description : Is the signature revoked by a key rule?
+Parameters  :
+	@info: the parsed signature
+Return value: 1 if it is, 0 otherwise
+******************************************************************************/
+int digsig_revoke_rule_sig(const struct digsig_sig_info *info)
+{
+	const struct digsig_key_rule *r;
+	const u8 *keyid;
+	unsigned int i, n = ACCESS_ONCE(digsig_key_rule_count);
+	u32 when = 0;
+
+	if (!n)
+		return 0;
+	smp_rmb();
+
+	if (info->signalgo == SIGN_RSA) {
+		keyid = info->packet + DIGSIG_RSA_KEYID_OFFSET;
+		when = get_unaligned_be32(info->packet +
+					  DIGSIG_RSA_TIMESTAMP_OFFSET);
+	} else {
+		keyid = info->packet;
+	}
+
+	for (i = 0; i < n; i++) {
+		r = &digsig_key_rules[i];
+		if (memcmp(r->keyid, keyid, DIGSIG_KEYID_SIZE))
+			continue;
+		/* an Ed25519 signature has no time to tell it apart by */
+		if (info->signalgo != SIGN_RSA ||
+		    (when >= r->from && when <= r->to))
+			return 1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+Description : Is the digest a signature is of revoked by a digest rule?
+Parameters  :
+	@algo: HASH_*
+	@digest: the digest, of gDigestLength[algo] bytes
+Return value: 1 if it is, 0 otherwise
+******************************************************************************/
+int digsig_revoke_rule_digest(int algo, const u8 *digest)
+{
+	struct digsig_digest_rule *r;
+	int ret = 0;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(digsig_digest_rules, r, node,
+				   digsig_digest_rule_key(algo, digest)) {
+		if (r->algo == algo &&
+		    !memcmp(r->digest, digest, gDigestLength[algo])) {
+			ret = 1;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+/******************************************************************************
+Description : Was a verdict made before the last rule was added?  If so it
+	can not be rechecked, and must be made again.
+Parameters  :
+	@generation: the generation of the verdict
+Return value: 1 if it was, 0 otherwise
+******************************************************************************/
+int digsig_revoke_rules_older(unsigned int generation)
+{
+	if (!ACCESS_ONCE(digsig_revoke_rules_any))
+		return 0;
+	return (int)(generation - ACCESS_ONCE(digsig_revoke_rules_gen)) < 0;
+}
+
+/* Summary of the rules, for the stamps of persistent verdicts. */
+u32 digsig_revoke_rules_stamp(void)
+{
+	return ACCESS_ONCE(digsig_rules_stamp);
+}
+
+/* Called with digsig_revoke_rules_mutex held. */
+static void digsig_revoke_rules_added(const void *rule, size_t len)
+{
+	digsig_rules_stamp += jhash(rule, len, 1);
+	/*
+	 * Verdicts older than the rule are dropped on their next lookup.
+	 * The generation is taken before the bump, so that none checked
+	 * meanwhile escapes.
+	 */
+	ACCESS_ONCE(digsig_revoke_rules_gen) = digsig_verdict_gen() + 1;
+	smp_wmb();
+	ACCESS_ONCE(digsig_revoke_rules_any) = 1;
+	digsig_inode_invalidate_all();
+}
+
+static int digsig_add_key_rule(char *args)
+{
+	struct digsig_key_rule *r;
+	char *hex = strsep(&args, " ");
+	unsigned int from = 0, to = ~0U;
+	int rc = 0;
+
+	if (!hex || strlen(hex) != 2 * DIGSIG_KEYID_SIZE)
+		return -EINVAL;
+	if (args && (sscanf(args, "%u %u", &from, &to) != 2 || from > to))
+		return -EINVAL;
+
+	mutex_lock(&digsig_revoke_rules_mutex);
+	if (digsig_key_rule_count == DIGSIG_KEY_RULES) {
+		rc = -ENOSPC;
+		goto out;
+	}
+	r = &digsig_key_rules[digsig_key_rule_count];
+	if (hex2bin(r->keyid, hex, DIGSIG_KEYID_SIZE)) {
+		rc = -EINVAL;
+		goto out;
+	}
+	r->from = from;
+	r->to = to;
+	smp_wmb();
+	digsig_key_rule_count++;
+	digsig_revoke_rules_added(r, sizeof(*r));
+out:
+	mutex_unlock(&digsig_revoke_rules_mutex);
+	return rc;
+}
+
+static int digsig_add_digest_rule(char *args)
+{
+	struct digsig_digest_rule *r;
+	char *name = strsep(&args, " ");
+	int algo, rc = 0;
+
+	if (!name || !args)
+		return -EINVAL;
+	for (algo = 0; algo < DIGSIG_HASH_ALGOS; algo++)
+		if (!strcmp(name, digsig_hash_name(algo)))
+			break;
+	if (algo == DIGSIG_HASH_ALGOS ||
+	    strlen(args) != 2 * gDigestLength[algo])
+		return -EINVAL;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+	r->algo = algo;
+	if (hex2bin(r->digest, args, gDigestLength[algo])) {
+		kfree(r);
+		return -EINVAL;
+	}
+
+	mutex_lock(&digsig_revoke_rules_mutex);
+	if (digsig_digest_rule_count == DIGSIG_DIGEST_RULES) {
+		rc = -ENOSPC;
+	} else if (digsig_revoke_rule_digest(algo, r->digest)) {
+		rc = 0;		/* already revoked */
+	} else {
+		hash_add_rcu(digsig_digest_rules, &r->node,
+			     digsig_digest_rule_key(algo, r->digest));
+		ACCESS_ONCE(digsig_digest_rule_count) =
+			digsig_digest_rule_count + 1;
+		digsig_revoke_rules_added(&r->algo,
+					  1 + gDigestLength[algo]);
+		r = NULL;
+	}
+	mutex_unlock(&digsig_revoke_rules_mutex);
+	kfree(r);
+	return rc;
+}
+
+static ssize_t digsig_revoke_rules_write(struct file *file,
+					 const char __user *ubuf,
+					 size_t count, loff_t *ppos)
+{
+	char *buf, *line, *p, *kind;
+	int rc = 0;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, count)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+	buf[count] = '\0';
+
+	p = buf;
+	while (!rc && (line = strsep(&p, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line)
+			continue;
+		kind = strsep(&line, " ");
+		if (line)
+			line = skip_spaces(line);
+		if (!strcmp(kind, "key"))
+			rc = digsig_add_key_rule(line);
+		else if (!strcmp(kind, "digest"))
+			rc = digsig_add_digest_rule(line);
+		else
+			rc = -EINVAL;
+	}
+	kfree(buf);
+
+	if (rc) {
+		DSM_ERROR("%s: bad revocation rule: %d\n", __func__, rc);
+		return rc;
+	}
+	return count;
+}
+
+static int digsig_revoke_rules_show(struct seq_file *m, void *v)
+{
+	struct digsig_digest_rule *r;
+	unsigned int i, n = ACCESS_ONCE(digsig_key_rule_count);
+	int bkt;
+
+	smp_rmb();
+	for (i = 0; i < n; i++)
+		seq_printf(m, "key %*phN %u %u\n", DIGSIG_KEYID_SIZE,
+			   digsig_key_rules[i].keyid, digsig_key_rules[i].from,
+			   digsig_key_rules[i].to);
+
+	rcu_read_lock();
+	hash_for_each_rcu(digsig_digest_rules, bkt, r, node)
+		seq_printf(m, "digest %s %*phN\n", digsig_hash_name(r->algo),
+			   gDigestLength[r->algo], r->digest);
+	rcu_read_unlock();
+	return 0;
+}
+
+static int digsig_revoke_rules_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_revoke_rules_show, NULL);
+}
+
+static const struct file_operations digsig_revoke_rules_fops = {
+	.open = digsig_revoke_rules_open,
+	.read = seq_read,
+	.write = digsig_revoke_rules_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/revoke_rules.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_revoke_rules(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("revoke_rules", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_revoke_rules_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
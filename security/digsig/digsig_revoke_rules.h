@@ -0,0 +1,37 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the revocation rules by key, signing time and
+ * file digest.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_REVOKE_RULES_H
+#define _DIGSIG_REVOKE_RULES_H
+
+#include <linux/types.h>
+#include "digsig_verify.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_REVOKE_RULES
+extern unsigned int digsig_digest_rule_count;
+#define digsig_revoke_rules_digests() ACCESS_ONCE(digsig_digest_rule_count)
+int digsig_revoke_rule_sig(const struct digsig_sig_info *info);
+int digsig_revoke_rule_digest(int algo, const u8 *digest);
+int digsig_revoke_rules_older(unsigned int generation);
+u32 digsig_revoke_rules_stamp(void);
+int digsig_init_revoke_rules(void);
+#else
+#define digsig_revoke_rules_digests() 0
+#define digsig_revoke_rule_sig(info) 0
+#define digsig_revoke_rule_digest(algo, digest) 0
+#define digsig_revoke_rules_older(generation) 0
+#define digsig_revoke_rules_stamp() 0
+#define digsig_init_revoke_rules() 0
+#endif
+
+#endif /* _DIGSIG_REVOKE_RULES_H */
@@ -0,0 +1,323 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file decides, once per superblock, what is done with the files
+ * mapped for execution from it: whether they are verified, refused, let
+ * through, or trusted from the dm-verity device under them.  The
+ * decision comes from a small table of rules, matched against the
+ * filesystem type, the device, and the buses the device hangs off.
+ * The table can be changed at runtime through /sys/digsig/policy; the
+ * superblocks then pick up the new table on their next lookup.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/genhd.h>
+#include <linux/blkdev.h>
+#include <linux/device.h>
+#include <linux/kdev_t.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "digsig_common.h"
+#include "digsig_sb.h"
+#include "digsig_verity.h"
+#include "digsig_nfs4.h"
+#include "digsig_sb_bitmap.h"
+#include "digsig_sbstats.h"
+#include "digsig_loop.h"
+
+#define DIGSIG_SB_MAX_RULES 32
+#define DIGSIG_SB_NAME_SIZE 32
+
+/* what a rule is matched against */
+#define DIGSIG_RULE_FS 0
+#define DIGSIG_RULE_DEV 1
+#define DIGSIG_RULE_BUS 2
+
+struct digsig_sb_rule {
+	int type;
+	char name[DIGSIG_SB_NAME_SIZE];	/* DIGSIG_RULE_FS, DIGSIG_RULE_BUS */
+	dev_t dev;			/* DIGSIG_RULE_DEV */
+	int policy;
+};
+
+static const char *digsig_sb_types[] = {
+	[DIGSIG_RULE_FS] = "fs",
+	[DIGSIG_RULE_DEV] = "dev",
+	[DIGSIG_RULE_BUS] = "bus",
+};
+
+static const char *digsig_sb_policies[] = {
+	[DIGSIG_SB_VERIFY] = "verify",
+	[DIGSIG_SB_DENY] = "deny",
+	[DIGSIG_SB_VERITY] = "verity",
+	[DIGSIG_SB_SKIP] = "skip",
+#ifdef CONFIG_SECURITY_DIGSIG_NFS4
+	[DIGSIG_SB_NFS4] = "nfs4",
+#endif
+};
+
+/*
+ * The rules in force at boot.  Data on network filesystems can change
+ * between verification and execution, and so can data read from a USB
+ * mass storage device, whose controller may be malicious.  NFSv4 mounts,
+ * of a type of their own, are the exception when their verdicts can be
+ * held by the change attribute of the server.
+ */
+#ifdef CONFIG_SECURITY_DIGSIG_NFS4
+#define DIGSIG_SB_NFS4_DEFAULT DIGSIG_SB_NFS4
+#else
+#define DIGSIG_SB_NFS4_DEFAULT DIGSIG_SB_DENY
+#endif
+
+static struct digsig_sb_rule digsig_sb_rules[DIGSIG_SB_MAX_RULES] = {
+	{ .type = DIGSIG_RULE_FS, .name = "nfs", .policy = DIGSIG_SB_DENY },
+	{ .type = DIGSIG_RULE_FS, .name = "nfs4",
+	  .policy = DIGSIG_SB_NFS4_DEFAULT },
+	{ .type = DIGSIG_RULE_FS, .name = "cifs", .policy = DIGSIG_SB_DENY },
+#ifdef CONFIG_SECURITY_DIGSIG_RESTRICT_USB_DEVICES
+	{ .type = DIGSIG_RULE_BUS, .name = "usb", .policy = DIGSIG_SB_DENY },
+#endif
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_RESTRICT_USB_DEVICES
+static int digsig_sb_nrules = 4;
+#else
+static int digsig_sb_nrules = 3;
+#endif
+
+/* protects the rules, and the computation of the policies from them */
+static DEFINE_MUTEX(digsig_sb_mutex);
+
+/*
+ * Bumped whenever the rules change.  It starts away from the 0 a new
+ * blob is zeroed with, so that a blob is never current before its
+ * policy was computed.
+ */
+atomic_t digsig_sb_generation = ATOMIC_INIT(1);
+
+static atomic64_t digsig_sb_ids = ATOMIC64_INIT(0);
+
+/* a superblock id never given before, never 0 */
+u64 digsig_sb_new_id(void)
+{
+	return atomic64_inc_return(&digsig_sb_ids);
+}
+
+/* Does the disk of @bdev sit, however deep, on a device of @bus? */
+static int digsig_sb_on_bus(struct block_device *bdev, const char *bus)
+{
+	struct device *dev;
+
+	if (!bdev->bd_disk)
+		return 0;
+	for (dev = disk_to_dev(bdev->bd_disk); dev; dev = dev->parent)
+		if (dev->bus && !strcmp(dev->bus->name, bus))
+			return 1;
+	return 0;
+}
+
+static int digsig_sb_match(struct digsig_sb_rule *r, struct super_block *sb)
+{
+	switch (r->type) {
+	case DIGSIG_RULE_FS:
+		return !strcmp(sb->s_type->name, r->name);
+	case DIGSIG_RULE_DEV:
+		return sb->s_bdev && sb->s_bdev->bd_dev == r->dev;
+	case DIGSIG_RULE_BUS:
+		return sb->s_bdev && digsig_sb_on_bus(sb->s_bdev, r->name);
+	}
+	return 0;
+}
+
+/******************************************************************************
+Description : Compute the policy of a superblock from the rules, and
+	store it with the superblock.
+Parameters  :
+	@sb: the superblock
+Return value: the policy, DIGSIG_SB_DENY if there is no memory to store
+	it
+******************************************************************************/
+int digsig_sb_compute(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	int i, policy;
+
+	if (!sbsec) {
+		sbsec = kzalloc(sizeof(*sbsec), GFP_KERNEL);
+		if (!sbsec)
+			return DIGSIG_SB_DENY;
+		atomic64_set(&sbsec->id, digsig_sb_new_id());
+		if (cmpxchg(&sb->s_security, NULL, sbsec)) {
+			kfree(sbsec);
+			sbsec = sb->s_security;
+		}
+	}
+
+	mutex_lock(&digsig_sb_mutex);
+	policy = dsi_verity ? DIGSIG_SB_VERITY : DIGSIG_SB_VERIFY;
+	for (i = 0; i < digsig_sb_nrules; i++)
+		if (digsig_sb_match(&digsig_sb_rules[i], sb)) {
+			policy = digsig_sb_rules[i].policy;
+			break;
+		}
+	/* only NFSv4 has a change attribute to keep verdicts by */
+	if (policy == DIGSIG_SB_NFS4 && !digsig_nfs4_sb(sb))
+		policy = DIGSIG_SB_VERIFY;
+	sbsec->change_attr = policy == DIGSIG_SB_NFS4;
+	sbsec->policy = policy;
+	/* digsig_sb_policy() reads the policy after the generation */
+	smp_wmb();
+	sbsec->generation = atomic_read(&digsig_sb_generation);
+	mutex_unlock(&digsig_sb_mutex);
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %s (%s) is %s\n", __func__, sb->s_id,
+		  sb->s_type->name, digsig_sb_policies[policy]);
+	return policy;
+}
+
+/******************************************************************************
+Description : Give a superblock a new id, which drops the verdicts made
+	under the old one.
+Parameters  :
+	@sb: the superblock, being remounted
+Return value: the old id, 0 if the superblock had none
+******************************************************************************/
+u64 digsig_sb_renew_id(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+
+	if (!sbsec)
+		return 0;
+	digsig_sb_bitmap_free(sbsec);
+	return atomic64_xchg(&sbsec->id, digsig_sb_new_id());
+}
+
+void digsig_sb_free(struct super_block *sb)
+{
+	if (sb->s_security) {
+		digsig_sb_bitmap_free(sb->s_security);
+		digsig_sbstats_free(sb->s_security);
+		digsig_loop_free(sb->s_security);
+	}
+	kfree(sb->s_security);
+	sb->s_security = NULL;
+}
+
+/******************************************************************************
+Description : List the rules, first match first, for /sys/digsig/policy.
+Parameters  :
+	@buf: a page
+Return value: the length written
+******************************************************************************/
+ssize_t digsig_sb_rules_show(char *buf)
+{
+	struct digsig_sb_rule *r;
+	ssize_t len = 0;
+
+	mutex_lock(&digsig_sb_mutex);
+	for (r = digsig_sb_rules; r < digsig_sb_rules + digsig_sb_nrules; r++) {
+		if (r->type == DIGSIG_RULE_DEV)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 "dev:%u:%u %s\n", MAJOR(r->dev),
+					 MINOR(r->dev),
+					 digsig_sb_policies[r->policy]);
+		else
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%s:%s %s\n",
+					 digsig_sb_types[r->type], r->name,
+					 digsig_sb_policies[r->policy]);
+	}
+	mutex_unlock(&digsig_sb_mutex);
+
+	return len;
+}
+
+static int digsig_sb_same_rule(struct digsig_sb_rule *a,
+			       struct digsig_sb_rule *b)
+{
+	if (a->type != b->type)
+		return 0;
+	if (a->type == DIGSIG_RULE_DEV)
+		return a->dev == b->dev;
+	return !strcmp(a->name, b->name);
+}
+
+/******************************************************************************
+Description : Change the rule for one filesystem type, device or bus.
+	The rule is written as "fs:<type> <policy>", "dev:<major>:<minor>
+	<policy>" or "bus:<name> <policy>", where the policy is verify,
+	deny, verity, skip or, for NFSv4 mounts, nfs4.  A new rule is matched after the existing
+	ones; "default" as the policy removes the rule.
+Parameters  :
+	@buf, @count: the rule
+Return value: 0 on success, negative otherwise
+******************************************************************************/
+int digsig_sb_rule_store(const char *buf, size_t count)
+{
+	char match[DIGSIG_SB_NAME_SIZE + 4], action[8];
+	struct digsig_sb_rule rule, *r;
+	unsigned int major, minor;
+	int i, remove = 0, rc = 0;
+
+	memset(&rule, 0, sizeof(rule));
+	if (count >= PAGE_SIZE ||
+	    sscanf(buf, "%35s %7s", match, action) != 2)
+		return -EINVAL;
+
+	if (!strncmp(match, "fs:", 3) && match[3]) {
+		rule.type = DIGSIG_RULE_FS;
+		strlcpy(rule.name, match + 3, sizeof(rule.name));
+	} else if (!strncmp(match, "bus:", 4) && match[4]) {
+		rule.type = DIGSIG_RULE_BUS;
+		strlcpy(rule.name, match + 4, sizeof(rule.name));
+	} else if (sscanf(match, "dev:%u:%u", &major, &minor) == 2) {
+		rule.type = DIGSIG_RULE_DEV;
+		rule.dev = MKDEV(major, minor);
+	} else {
+		return -EINVAL;
+	}
+
+	if (!strcmp(action, "default")) {
+		remove = 1;
+	} else {
+		for (i = 0; i < ARRAY_SIZE(digsig_sb_policies); i++)
+			if (!strcmp(action, digsig_sb_policies[i]))
+				break;
+		if (i == ARRAY_SIZE(digsig_sb_policies))
+			return -EINVAL;
+		rule.policy = i;
+	}
+
+	mutex_lock(&digsig_sb_mutex);
+	for (r = digsig_sb_rules; r < digsig_sb_rules + digsig_sb_nrules; r++)
+		if (digsig_sb_same_rule(r, &rule))
+			break;
+
+	if (remove) {
+		if (r < digsig_sb_rules + digsig_sb_nrules) {
+			memmove(r, r + 1, (digsig_sb_rules + digsig_sb_nrules -
+					   r - 1) * sizeof(*r));
+			digsig_sb_nrules--;
+		}
+	} else if (r < digsig_sb_rules + digsig_sb_nrules) {
+		r->policy = rule.policy;
+	} else if (digsig_sb_nrules < DIGSIG_SB_MAX_RULES) {
+		digsig_sb_rules[digsig_sb_nrules++] = rule;
+	} else {
+		rc = -ENOSPC;
+	}
+	/* every superblock computes its policy again */
+	if (!rc)
+		atomic_inc(&digsig_sb_generation);
+	mutex_unlock(&digsig_sb_mutex);
+
+	return rc;
+}
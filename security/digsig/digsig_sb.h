@@ -0,0 +1,108 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the per-superblock verification policy.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SB_H
+#define _DIGSIG_SB_H
+
+#include <linux/fs.h>
+#include <linux/atomic.h>
+
+/* what is done with a file mapped for execution from a superblock */
+#define DIGSIG_SB_VERIFY 0	/* check its signature */
+#define DIGSIG_SB_DENY 1	/* refuse it */
+#define DIGSIG_SB_VERITY 2	/* trust a signed dm-verity root, else verify */
+#define DIGSIG_SB_SKIP 3	/* let it through unchecked */
+#define DIGSIG_SB_NFS4 4	/* verify it, the verdict kept by change attribute */
+
+/*
+ * digsig_sb_sec: hung off sb->s_security the first time a file of the
+ * superblock is looked at, or at mount.
+ *
+ * @policy: one of DIGSIG_SB_*, from the first rule of the policy table
+ *	that matches the superblock.
+ * @generation: digsig_sb_generation when @policy was computed; the
+ *	policy is computed again once the table changed.
+ * @change_attr: set for an NFSv4 superblock under DIGSIG_SB_NFS4, whose
+ *	i_version is the change attribute of the server: its verdicts are
+ *	checked against it, as on a filesystem mounted with i_version.
+ * @id: names the superblock in sig_cache and the recent records.  Ids
+ *	are never reused, so the verdicts of a superblock that went away
+ *	never match a new one at the same address, and a remount drops
+ *	the verdicts of the superblock by giving it a new id.
+ * @bitmap: the verdicts on the files of a read-only image, one bit per
+ *	inode, NULL if there are none; see digsig_sb_bitmap.c.
+ * @stats: per CPU counters of the verifications of its files, NULL until
+ *	the first is counted; see digsig_sbstats.c.
+ * @loop_file: the image a read-only mount of a loop device was made
+ *	from, held, and denied writers, until the superblock goes away;
+ *	see digsig_loop.c.
+ * @loop_gen: digsig_verdict_gen() + 1 when the image was last found not
+ *	to be signed, 0 if it never was.
+ */
+struct digsig_sb_bitmap;
+struct digsig_sb_stats;
+
+struct digsig_sb_sec {
+	int policy;
+	unsigned int generation;
+	int change_attr;
+	atomic64_t id;
+	struct digsig_sb_bitmap __rcu *bitmap;
+	struct digsig_sb_stats __percpu *stats;
+	struct file *loop_file;
+	unsigned int loop_gen;
+};
+
+extern atomic_t digsig_sb_generation;
+
+u64 digsig_sb_new_id(void);
+
+/* the id of the superblock, 0 if DigSig never looked at it */
+static inline u64 digsig_sb_id(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+
+	return sbsec ? atomic64_read(&sbsec->id) : 0;
+}
+
+int digsig_sb_compute(struct super_block *sb);
+
+/* Are the verdicts on the files of the superblock held by i_version? */
+static inline int digsig_sb_change_attr(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+
+	return sbsec && ACCESS_ONCE(sbsec->change_attr);
+}
+
+/*
+ * The policy of the superblock of a file about to be mapped: two loads
+ * from the same line, unless the policy table changed.
+ */
+static inline int digsig_sb_policy(struct super_block *sb)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+
+	if (likely(sbsec && sbsec->generation ==
+		   atomic_read(&digsig_sb_generation))) {
+		smp_rmb();
+		return sbsec->policy;
+	}
+	return digsig_sb_compute(sb);
+}
+
+u64 digsig_sb_renew_id(struct super_block *sb);
+void digsig_sb_free(struct super_block *sb);
+ssize_t digsig_sb_rules_show(char *buf);
+int digsig_sb_rule_store(const char *buf, size_t count);
+
+#endif /* _DIGSIG_SB_H */
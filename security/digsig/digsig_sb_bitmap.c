@@ -0,0 +1,245 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the verdicts on the files of squashfs images in one
+ * bit per inode, hung off the superblock.  The inode numbers of such an
+ * image are dense, from 1 up to the number of its inodes, and its files
+ * never change while it is mounted, so a verdict needs neither the
+ * inode, nor its size and times, nor a place in sig_cache, whose
+ * entries it would otherwise push out: a lookup is one bit test, and
+ * an image of 100k files costs 16 KB once all are verified.
+ *
+ * A bitmap holds the verdicts of one generation, see
+ * digsig_verdict_gen(): one made before a signature was revoked, a key
+ * retired or the revocation rules changed is not taken from it, and the
+ * first verdict made after that starts a new, empty bitmap.  The bitmap
+ * grows, doubling, up to DIGSIG_SB_BITMAP_MAX inodes; the verdicts on
+ * the inodes past that are kept in sig_cache.  The bits of a verdict
+ * bundle, see digsig_bundle.c, are set all at once at mount; they
+ * hold for the dm-verity table whose root the bundle names, so the
+ * bitmap they are in is dropped like a stale one once another table
+ * is loaded and resumed under the image.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/bitops.h>
+#include <linux/log2.h>
+#include <linux/magic.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+
+#include "digsig_common.h"
+#include "digsig_sb_bitmap.h"
+
+/* inodes of an image, at most, whose verdicts are kept in bits */
+#define DIGSIG_SB_BITMAP_MAX (1UL << 22)
+#define DIGSIG_SB_BITMAP_MIN 1024
+
+struct digsig_sb_bitmap {
+	struct rcu_head rcu;
+	unsigned int generation;
+	struct digsig_verity_table table;	/* that of a bundle's bits */
+	unsigned long bits;
+	unsigned long map[];
+};
+
+/* serializes the replacement of bitmaps, which are only read under RCU */
+static DEFINE_SPINLOCK(digsig_sb_bitmap_lock);
+
+/* Is the superblock that of an image whose inode numbers are dense? */
+static inline int digsig_sb_bitmap_fs(struct super_block *sb)
+{
+	return sb->s_magic == SQUASHFS_MAGIC && (sb->s_flags & MS_RDONLY);
+}
+
+/* Are the bits of the bitmap verdicts of the generation? */
+static inline int digsig_sb_bitmap_valid(struct digsig_sb_bitmap *bm,
+					 unsigned int gen)
+{
+	return bm->generation == gen && digsig_verity_table_live(&bm->table);
+}
+
+/******************************************************************************
+Description : Look up the verdict on an inode of a read-only image.
+Parameters  :
+	@inode: the inode about to be mapped
+Return value: 1 if the file was found valid, since the last revocation,
+	0 otherwise
+******************************************************************************/
+int digsig_sb_bitmap_test(struct inode *inode)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(inode->i_sb->s_security);
+	struct digsig_sb_bitmap *bm;
+	int found = 0;
+
+	if (!sbsec || !ACCESS_ONCE(sbsec->bitmap))
+		return 0;
+
+	rcu_read_lock();
+	bm = rcu_dereference(sbsec->bitmap);
+	if (bm && inode->i_ino < bm->bits &&
+	    digsig_sb_bitmap_valid(bm, digsig_verdict_gen()))
+		found = test_bit(inode->i_ino, bm->map);
+	rcu_read_unlock();
+	return found;
+}
+
+/*
+ * A bitmap of the generation for an inode number, replacing the old one
+ * whose bits are copied if they are of the same generation.  Called
+ * under digsig_sb_bitmap_lock.
+ */
+static struct digsig_sb_bitmap *
+digsig_sb_bitmap_grow(struct digsig_sb_sec *sbsec,
+		      struct digsig_sb_bitmap *old, unsigned int gen,
+		      unsigned long ino)
+{
+	struct digsig_sb_bitmap *bm;
+	unsigned long bits, old_bits = 0;
+
+	bits = max_t(unsigned long, roundup_pow_of_two(ino + 1),
+		     DIGSIG_SB_BITMAP_MIN);
+	if (old && !digsig_sb_bitmap_valid(old, gen))
+		old_bits = 0;
+	else if (old)
+		old_bits = old->bits;
+	bits = max(bits, old_bits);
+	bm = kzalloc(sizeof(*bm) + BITS_TO_LONGS(bits) * sizeof(long),
+		     GFP_ATOMIC | __GFP_NOWARN);
+	if (!bm)
+		return NULL;
+	bm->generation = gen;
+	bm->bits = bits;
+	if (old_bits) {
+		bm->table = old->table;
+		memcpy(bm->map, old->map, BITS_TO_LONGS(old_bits) * sizeof(long));
+	}
+
+	rcu_assign_pointer(sbsec->bitmap, bm);
+	if (old)
+		kfree_rcu(old, rcu);
+	return bm;
+}
+
+/******************************************************************************
+Description : Record a verdict on an inode of a read-only image.
+Parameters  :
+	@inode: the inode found valid
+	@verdict: what the verdict was made under
+Return value: 1 if the verdict is kept in the bitmap, 0 if it is to be
+	cached as on other filesystems
+******************************************************************************/
+int digsig_sb_bitmap_set(struct inode *inode, struct digsig_verdict verdict)
+{
+	struct super_block *sb = inode->i_sb;
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct digsig_sb_bitmap *bm;
+	unsigned int gen = digsig_verdict_gen();
+	unsigned long ino = inode->i_ino;
+
+	if (!sbsec || !digsig_sb_bitmap_fs(sb) || ino >= DIGSIG_SB_BITMAP_MAX)
+		return 0;
+	/* made before a revocation, it goes where it is checked again */
+	if (verdict.generation != gen)
+		return 0;
+
+	spin_lock(&digsig_sb_bitmap_lock);
+	bm = sbsec->bitmap;
+	if (!bm || ino >= bm->bits || !digsig_sb_bitmap_valid(bm, gen))
+		bm = digsig_sb_bitmap_grow(sbsec, bm, gen, ino);
+	if (bm)
+		set_bit(ino, bm->map);
+	spin_unlock(&digsig_sb_bitmap_lock);
+	return bm != NULL;
+}
+
+/******************************************************************************
+Description : Set the bits of many inodes of a read-only image at once, for
+	verdicts made elsewhere: those of a verdict bundle.
+Parameters  :
+	@sb: the superblock of the image
+	@gen: digsig_verdict_gen() when the verdicts were taken
+	@table: the dm-verity table the verdicts hold for
+	@ino, @count: the inode numbers of the files found valid
+Return value: 0 on success, -EINVAL if the superblock keeps no bitmap,
+	-ESTALE if a revocation came since @gen, -ENOMEM
+******************************************************************************/
+int digsig_sb_bitmap_seed(struct super_block *sb, unsigned int gen,
+			  const struct digsig_verity_table *table,
+			  const u32 *ino, u32 count)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct digsig_sb_bitmap *bm, *old;
+	unsigned long bits = 0;
+	u32 i;
+
+	if (!sbsec || !digsig_sb_bitmap_fs(sb))
+		return -EINVAL;
+	for (i = 0; i < count; i++)
+		if (ino[i] < DIGSIG_SB_BITMAP_MAX)
+			bits = max_t(unsigned long, bits, ino[i] + 1);
+	bits = max_t(unsigned long, roundup_pow_of_two(bits),
+		     DIGSIG_SB_BITMAP_MIN);
+
+	/* filled outside the lock, again if the bitmap grew meanwhile */
+	for (;;) {
+		bm = kzalloc(sizeof(*bm) + BITS_TO_LONGS(bits) * sizeof(long),
+			     GFP_KERNEL | __GFP_NOWARN);
+		if (!bm)
+			return -ENOMEM;
+		bm->generation = gen;
+		bm->table = *table;
+		bm->bits = bits;
+		for (i = 0; i < count; i++)
+			if (ino[i] < bits)
+				__set_bit(ino[i], bm->map);
+
+		spin_lock(&digsig_sb_bitmap_lock);
+		old = sbsec->bitmap;
+		if (gen != digsig_verdict_gen()) {
+			spin_unlock(&digsig_sb_bitmap_lock);
+			kfree(bm);
+			return -ESTALE;
+		}
+		if (!old || !digsig_sb_bitmap_valid(old, gen) ||
+		    old->bits <= bits)
+			break;
+		bits = old->bits;
+		spin_unlock(&digsig_sb_bitmap_lock);
+		kfree(bm);
+	}
+
+	if (old && digsig_sb_bitmap_valid(old, gen))
+		bitmap_or(bm->map, bm->map, old->map, old->bits);
+	rcu_assign_pointer(sbsec->bitmap, bm);
+	spin_unlock(&digsig_sb_bitmap_lock);
+	if (old)
+		kfree_rcu(old, rcu);
+	return 0;
+}
+
+/******************************************************************************
+Description : Drop the bitmap of a superblock going away, or remounted.
+Parameters  :
+	@sbsec: the DigSig data of the superblock
+Return value: none
+******************************************************************************/
+void digsig_sb_bitmap_free(struct digsig_sb_sec *sbsec)
+{
+	struct digsig_sb_bitmap *bm;
+
+	spin_lock(&digsig_sb_bitmap_lock);
+	bm = sbsec->bitmap;
+	rcu_assign_pointer(sbsec->bitmap, NULL);
+	spin_unlock(&digsig_sb_bitmap_lock);
+	if (bm)
+		kfree_rcu(bm, rcu);
+}
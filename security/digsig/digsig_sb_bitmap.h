@@ -0,0 +1,40 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verdict bitmaps of read-only images.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SB_BITMAP_H
+#define _DIGSIG_SB_BITMAP_H
+
+#include <linux/fs.h>
+
+#include "digsig_inode.h"
+#include "digsig_sb.h"
+#include "digsig_verity.h"
+
+#ifdef CONFIG_SECURITY_DIGSIG_SB_BITMAP
+int digsig_sb_bitmap_test(struct inode *inode);
+int digsig_sb_bitmap_set(struct inode *inode, struct digsig_verdict verdict);
+int digsig_sb_bitmap_seed(struct super_block *sb, unsigned int gen,
+			  const struct digsig_verity_table *table,
+			  const u32 *ino, u32 count);
+void digsig_sb_bitmap_free(struct digsig_sb_sec *sbsec);
+#else
+#define digsig_sb_bitmap_test(inode) 0
+static inline int digsig_sb_bitmap_set(struct inode *inode,
+				       struct digsig_verdict verdict)
+{
+	return 0;
+}
+#define digsig_sb_bitmap_seed(sb, gen, table, ino, count) (-EINVAL)
+#define digsig_sb_bitmap_free(sbsec) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_SB_BITMAP_H */
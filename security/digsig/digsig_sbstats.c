@@ -0,0 +1,169 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file counts what each superblock costs DigSig: the verdicts
+ * found in the cache and those not found, the files verified, the
+ * bytes they hashed and the time they took.  It tells the mounts worth
+ * trusting as a whole, through dm-verity or a signed image, or worth a
+ * larger cache, from those that cost little.  The counters are per CPU,
+ * allocated the first time a file of the superblock is counted, and go
+ * away with the superblock.
+ *
+ * /sys/kernel/security/digsig/mounts lists the superblocks counted,
+ * one per line: the id DigSig gives the superblock, its filesystem
+ * type, device number and name, then the counters, separated by tabs.
+ * Writing to it zeroes the counters.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/kdev_t.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_sbstats.h"
+
+static const char *const digsig_sbstat_names[DIGSIG_SBSTATS] = {
+	[DIGSIG_SBSTAT_HIT] = "hits",
+	[DIGSIG_SBSTAT_MISS] = "misses",
+	[DIGSIG_SBSTAT_VERIFIED] = "verified",
+	[DIGSIG_SBSTAT_BYTES] = "bytes",
+	[DIGSIG_SBSTAT_NS] = "ns",
+};
+
+/* The counters of the superblock, allocated the first time. */
+static struct digsig_sb_stats __percpu *
+digsig_sbstats_get(struct digsig_sb_sec *sbsec)
+{
+	struct digsig_sb_stats __percpu *stats = ACCESS_ONCE(sbsec->stats);
+
+	if (likely(stats))
+		return stats;
+	stats = alloc_percpu(struct digsig_sb_stats);
+	if (!stats)
+		return NULL;
+	if (cmpxchg(&sbsec->stats, NULL, stats)) {
+		free_percpu(stats);
+		stats = sbsec->stats;
+	}
+	return stats;
+}
+
+/******************************************************************************
+Description : Count against the superblock of a file.
+Parameters  :
+	@sb: the superblock
+	@stat: one of DIGSIG_SBSTAT_*
+	@n: what to add
+Return value: none; what can not be counted is not
+******************************************************************************/
+void digsig_sbstats_add(struct super_block *sb, int stat, u64 n)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct digsig_sb_stats __percpu *stats;
+
+	if (!sbsec)
+		return;
+	stats = digsig_sbstats_get(sbsec);
+	if (stats)
+		this_cpu_add(stats->count[stat], n);
+}
+
+void digsig_sbstats_free(struct digsig_sb_sec *sbsec)
+{
+	free_percpu(sbsec->stats);
+	sbsec->stats = NULL;
+}
+
+static void digsig_sbstats_show_sb(struct super_block *sb, void *data)
+{
+	struct seq_file *m = data;
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct digsig_sb_stats __percpu *stats;
+	u64 sum[DIGSIG_SBSTATS] = { 0 };
+	int cpu, i;
+
+	if (!sbsec || !(stats = ACCESS_ONCE(sbsec->stats)))
+		return;
+	for_each_possible_cpu(cpu)
+		for (i = 0; i < DIGSIG_SBSTATS; i++)
+			sum[i] += per_cpu_ptr(stats, cpu)->count[i];
+
+	seq_printf(m, "%llu\t%s\t%u:%u\t%s",
+		   (unsigned long long)digsig_sb_id(sb), sb->s_type->name,
+		   MAJOR(sb->s_dev), MINOR(sb->s_dev), sb->s_id);
+	for (i = 0; i < DIGSIG_SBSTATS; i++)
+		seq_printf(m, "\t%llu", (unsigned long long)sum[i]);
+	seq_putc(m, '\n');
+}
+
+static int digsig_sbstats_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_puts(m, "# id\ttype\tdev\tname");
+	for (i = 0; i < DIGSIG_SBSTATS; i++)
+		seq_printf(m, "\t%s", digsig_sbstat_names[i]);
+	seq_putc(m, '\n');
+	iterate_supers(digsig_sbstats_show_sb, m);
+	return 0;
+}
+
+static int digsig_sbstats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_sbstats_show, NULL);
+}
+
+static void digsig_sbstats_reset_sb(struct super_block *sb, void *data)
+{
+	struct digsig_sb_sec *sbsec = ACCESS_ONCE(sb->s_security);
+	struct digsig_sb_stats __percpu *stats;
+	int cpu;
+
+	if (!sbsec || !(stats = ACCESS_ONCE(sbsec->stats)))
+		return;
+	/* what is counted meanwhile may survive the reset */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(stats, cpu), 0, sizeof(*stats));
+}
+
+static ssize_t digsig_sbstats_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	iterate_supers(digsig_sbstats_reset_sb, NULL);
+	return count;
+}
+
+static const struct file_operations digsig_sbstats_fops = {
+	.open = digsig_sbstats_open,
+	.read = seq_read,
+	.write = digsig_sbstats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/mounts.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_sbstats(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("mounts", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_sbstats_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the verification counters of each superblock.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SBSTATS_H
+#define _DIGSIG_SBSTATS_H
+
+#include <linux/fs.h>
+
+#include "digsig_sb.h"
+
+#define DIGSIG_SBSTAT_HIT 0	/* verdicts found in the cache */
+#define DIGSIG_SBSTAT_MISS 1	/* and not found */
+#define DIGSIG_SBSTAT_VERIFIED 2	/* files verified */
+#define DIGSIG_SBSTAT_BYTES 3	/* bytes those hashed */
+#define DIGSIG_SBSTAT_NS 4	/* and the time they took */
+#define DIGSIG_SBSTATS 5
+
+struct digsig_sb_stats {
+	u64 count[DIGSIG_SBSTATS];
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_SB_STATS
+void digsig_sbstats_add(struct super_block *sb, int stat, u64 n);
+void digsig_sbstats_free(struct digsig_sb_sec *sbsec);
+int digsig_init_sbstats(void);
+#else
+static inline void digsig_sbstats_add(struct super_block *sb, int stat, u64 n)
+{
+}
+#define digsig_sbstats_free(sbsec) do { } while (0)
+#define digsig_init_sbstats() 0
+#endif
+
+#endif /* _DIGSIG_SBSTATS_H */
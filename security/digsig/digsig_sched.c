@@ -0,0 +1,210 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file bounds how many large files are verified at once.  Files
+ * of dsi_sched_large_kb and more wait their turn before they are read:
+ * no more than dsi_sched_per_dev of them from one device at a time,
+ * and no more than dsi_sched_budget_mb of them in all, so that a burst
+ * of huge binaries neither saturates a disk nor throws the page cache
+ * out, while smaller files are verified as they come.
+ *
+ * Waiting verifications are let through by class, the real-time tasks
+ * first and the background ones, such as preload workers and niced
+ * tasks, last, and within a class smallest file first.  One that has
+ * waited DIGSIG_SCHED_MAX_WAIT goes ahead of the others, so that large
+ * files are not put off forever.
+ *
+ * A single lock is enough: it is only taken for large files, whose
+ * verification costs far more.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/jiffies.h>
+
+#include "digsig_common.h"
+#include "digsig_sched.h"
+
+#define DIGSIG_SCHED_RT 0
+#define DIGSIG_SCHED_NORMAL 1
+#define DIGSIG_SCHED_BACKGROUND 2
+
+#define DIGSIG_SCHED_MAX_WAIT (2 * HZ)
+
+static int dsi_sched_large_kb = 16384;
+module_param(dsi_sched_large_kb, int, 0);
+MODULE_PARM_DESC(dsi_sched_large_kb, "Files of this many kilobytes and more wait for their turn to be verified.\n");
+
+static int dsi_sched_per_dev = 2;
+module_param(dsi_sched_per_dev, int, 0);
+MODULE_PARM_DESC(dsi_sched_per_dev, "Large files from one device verified at once.\n");
+
+static int dsi_sched_budget_mb = 256;
+module_param(dsi_sched_budget_mb, int, 0);
+MODULE_PARM_DESC(dsi_sched_budget_mb, "Megabytes of large files verified at once.\n");
+
+static DEFINE_SPINLOCK(digsig_sched_lock);
+static LIST_HEAD(digsig_sched_waiting);	/* by class, then size */
+static LIST_HEAD(digsig_sched_running);
+static loff_t digsig_sched_inflight;
+static DECLARE_WAIT_QUEUE_HEAD(digsig_sched_wait);
+
+static int digsig_sched_class(void)
+{
+	if (rt_task(current))
+		return DIGSIG_SCHED_RT;
+	if ((current->flags & PF_WQ_WORKER) || task_nice(current) > 0 ||
+	    current->policy == SCHED_IDLE)
+		return DIGSIG_SCHED_BACKGROUND;
+	return DIGSIG_SCHED_NORMAL;
+}
+
+static int digsig_sched_fits(struct digsig_sched_job *job)
+{
+	struct digsig_sched_job *r;
+	int n = 0;
+
+	/* one file goes through on its own, however large */
+	if (digsig_sched_inflight &&
+	    digsig_sched_inflight + job->size >
+	    (loff_t)dsi_sched_budget_mb << 20)
+		return 0;
+	list_for_each_entry(r, &digsig_sched_running, node)
+		if (r->dev == job->dev && ++n >= dsi_sched_per_dev)
+			return 0;
+	return 1;
+}
+
+static void digsig_sched_grant(struct digsig_sched_job *job)
+{
+	list_move(&job->node, &digsig_sched_running);
+	digsig_sched_inflight += job->size;
+	job->granted = 1;
+}
+
+/*
+ * Let through the waiting verifications that fit, those that waited
+ * too long first.  Called with digsig_sched_lock held.
+ */
+static int digsig_sched_run(void)
+{
+	struct digsig_sched_job *job, *tmp;
+	int woken = 0;
+
+	list_for_each_entry_safe(job, tmp, &digsig_sched_waiting, node)
+		if (time_after(jiffies, job->queued + DIGSIG_SCHED_MAX_WAIT) &&
+		    digsig_sched_fits(job)) {
+			digsig_sched_grant(job);
+			woken = 1;
+		}
+	list_for_each_entry_safe(job, tmp, &digsig_sched_waiting, node)
+		if (digsig_sched_fits(job)) {
+			digsig_sched_grant(job);
+			woken = 1;
+		}
+	return woken;
+}
+
+static void digsig_sched_queue(struct digsig_sched_job *job)
+{
+	struct digsig_sched_job *w;
+
+	list_for_each_entry(w, &digsig_sched_waiting, node)
+		if (w->class > job->class ||
+		    (w->class == job->class && w->size > job->size))
+			break;
+	list_add_tail(&job->node, &w->node);
+}
+
+/******************************************************************************
+Description : Wait until a file may be verified.
+Parameters  :
+	@job: filled in here, and passed to digsig_sched_end() afterwards
+	@inode: the inode of the file about to be verified
+Return value: 0 once the file may be read, -EINTR if the task was killed
+	while waiting (@job then needs no digsig_sched_end())
+******************************************************************************/
+int digsig_sched_begin(struct digsig_sched_job *job, struct inode *inode)
+{
+	DEFINE_WAIT(wait);
+	int woken;
+
+	job->size = i_size_read(inode);
+	if (dsi_sched_large_kb <= 0 ||
+	    job->size < (loff_t)dsi_sched_large_kb << 10) {
+		job->size = 0;
+		return 0;
+	}
+	job->dev = inode->i_sb->s_dev;
+	job->class = digsig_sched_class();
+	job->queued = jiffies;
+	job->granted = 0;
+
+	spin_lock(&digsig_sched_lock);
+	digsig_sched_queue(job);
+	woken = digsig_sched_run();
+	spin_unlock(&digsig_sched_lock);
+	if (woken)
+		wake_up_all(&digsig_sched_wait);
+
+	/* waiters look again now and then, for the overdue ones */
+	while (!ACCESS_ONCE(job->granted) && !fatal_signal_pending(current)) {
+		prepare_to_wait(&digsig_sched_wait, &wait, TASK_KILLABLE);
+		if (!ACCESS_ONCE(job->granted) && !fatal_signal_pending(current))
+			schedule_timeout(DIGSIG_SCHED_MAX_WAIT);
+		finish_wait(&digsig_sched_wait, &wait);
+
+		spin_lock(&digsig_sched_lock);
+		woken = digsig_sched_run();
+		spin_unlock(&digsig_sched_lock);
+		if (woken)
+			wake_up_all(&digsig_sched_wait);
+	}
+
+	spin_lock(&digsig_sched_lock);
+	if (!job->granted) {
+		list_del(&job->node);
+		spin_unlock(&digsig_sched_lock);
+		job->size = 0;
+		return -EINTR;
+	}
+	spin_unlock(&digsig_sched_lock);
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %lld bytes let through after %u ms\n",
+		  __func__, job->size, jiffies_to_msecs(jiffies - job->queued));
+	return 0;
+}
+
+/******************************************************************************
+Description : Give up the share of a verification that is done.
+Parameters  :
+	@job: as filled in by digsig_sched_begin()
+Return value: none
+******************************************************************************/
+void digsig_sched_end(struct digsig_sched_job *job)
+{
+	int woken;
+
+	if (!job->size)
+		return;
+
+	spin_lock(&digsig_sched_lock);
+	list_del(&job->node);
+	digsig_sched_inflight -= job->size;
+	woken = digsig_sched_run();
+	spin_unlock(&digsig_sched_lock);
+	if (woken)
+		wake_up_all(&digsig_sched_wait);
+	job->size = 0;
+}
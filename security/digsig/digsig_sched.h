@@ -0,0 +1,41 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the admission of large file verifications.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SCHED_H
+#define _DIGSIG_SCHED_H
+
+#include <linux/fs.h>
+#include <linux/list.h>
+
+/*
+ * digsig_sched_job: a verification waiting for, or holding, its share
+ * of the device and of the byte budget.  @size is 0 for a file small
+ * enough to go through without either.
+ */
+struct digsig_sched_job {
+	struct list_head node;
+	dev_t dev;
+	loff_t size;
+	int class;
+	unsigned long queued;
+	int granted;
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_SCHED
+int digsig_sched_begin(struct digsig_sched_job *job, struct inode *inode);
+void digsig_sched_end(struct digsig_sched_job *job);
+#else
+#define digsig_sched_begin(job, inode) ((job)->size = 0)
+#define digsig_sched_end(job) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_SCHED_H */
@@ -0,0 +1,233 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies the RSA signatures of many files with one
+ * exponentiation.  The product of signatures raised to e is the product
+ * of what each gives, so a batch of files signed with the key loaded as
+ * 'n' and 'e' is checked by raising the product of their signatures
+ * and comparing it to the product of their frames: one exponentiation
+ * and two multiplications per file, where each file takes an
+ * exponentiation by itself.  A batch that does not pass is cut in two
+ * and each half screened again, down to the files that do not match.
+ *
+ * With dsi_screen set to the size of a batch, the files of a tree walk
+ * and of the preload manifest are screened: each is hashed and checked
+ * as usual, its signature and frame are kept aside, and the batch is
+ * screened once full, or once the walk or the manifest is done.  The
+ * file is held, so that it can not be opened for writing, until its
+ * verdict is made.  A signature of another key, or one whose file has
+ * chunks or lives on NFSv4, is verified by itself, as are the files
+ * mapped for exec.
+ *
+ * Screening tells that the key signed the frame of each file, not that
+ * each signature is the one the key made: signatures multiplied by
+ * inverse factors still pass together.  A signature is only revoked by
+ * its bytes, so a batch is only screened while no signature is
+ * revoked, and its verdicts record no signature: any change to the
+ * revocation list has them verified again.  They are not memoized, nor
+ * kept in an extended attribute or inode flag.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_revocation.h"
+#include "digsig_screen.h"
+
+static int dsi_screen = 0;
+module_param(dsi_screen, int, 0);
+MODULE_PARM_DESC(dsi_screen, "RSA signatures of tree walks and the preload manifest screened together, 0 for none.\n");
+
+#define DIGSIG_SCREEN_MAX 64
+
+/* the files of one batch, and their verdicts once screened */
+struct digsig_screen_batch {
+	int n;
+	struct digsig_screen_sig sig[DIGSIG_SCREEN_MAX];
+	struct file *file[DIGSIG_SCREEN_MAX];
+	struct digsig_verdict verdict[DIGSIG_SCREEN_MAX];
+	int result[DIGSIG_SCREEN_MAX];
+};
+
+/*
+ * digsig_screen: the batch being filled on behalf of one walk or
+ * manifest, by as many tasks as it runs; the task that fills it up
+ * screens it.
+ */
+struct digsig_screen {
+	spinlock_t lock;
+	struct digsig_screen_batch *batch;
+	digsig_screen_done_t done;
+	void *data;
+};
+
+/*
+ * Screen the N files of B from LO on, which are known not to pass if
+ * BAD is set.  Returns 1 if they all pass.
+ */
+static int digsig_screen_bisect(struct digsig_screen_batch *b, int lo, int n,
+				int bad)
+{
+	int i, rc, half;
+
+	rc = bad ? -EPERM : digsig_rsa_screen(b->sig + lo, n);
+	if (!rc || rc == -ENOMEM || n == 1) {
+		for (i = lo; i < lo + n; i++)
+			b->result[i] = rc;
+		return !rc;
+	}
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %d signatures from %d do not pass\n",
+		  __func__, n, lo);
+	half = n / 2;
+	/* if the first half passes, the bad signatures are in the other */
+	bad = digsig_screen_bisect(b, lo, half, 0);
+	digsig_screen_bisect(b, lo + half, n - half, bad);
+	return 0;
+}
+
+static void digsig_screen_run(struct digsig_screen *s,
+			      struct digsig_screen_batch *b)
+{
+	struct file *file;
+	int i;
+
+	digsig_screen_bisect(b, 0, b->n, 0);
+	for (i = 0; i < b->n; i++) {
+		file = b->file[i];
+		if (!b->result[i])
+			digsig_verdict_screened(file, b->verdict[i]);
+		else
+			DSM_ERROR("%s: Signature do not match for %s: %d\n",
+				  __func__, file->f_dentry->d_name.name,
+				  b->result[i]);
+		if (s->done)
+			s->done(file, b->result[i], s->data);
+		digsig_screen_sig_free(&b->sig[i]);
+		fput(file);
+	}
+	kfree(b);
+}
+
+/******************************************************************************
+Description : Start screening the files of a walk or a manifest, if
+	dsi_screen asks for it.
+Parameters  :
+	@done: called with the verdict of each file screened, from the task
+	       that screens its batch; may be NULL
+	@data: passed to @done
+Return value: the batches to pass to digsig_verify_file_screen(), NULL
+	if the files are to be verified one by one
+******************************************************************************/
+struct digsig_screen *digsig_screen_alloc(digsig_screen_done_t done,
+					  void *data)
+{
+	struct digsig_screen *s;
+
+	if (dsi_screen <= 1)
+		return NULL;
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return NULL;
+	spin_lock_init(&s->lock);
+	s->done = done;
+	s->data = data;
+	return s;
+}
+
+/******************************************************************************
+Description : Queue the signature of a file for the next batch, and
+	screen the batch if it is full.
+Parameters  :
+	@s: from digsig_screen_alloc()
+	@file: the file, held until its verdict is made
+	@sig: the signature, which the batch takes
+	@verdict: the verdict to keep if the signature passes
+Return value: 0 if queued, -EPERM while a signature is revoked, -ENOMEM;
+	the caller then verifies the signature by itself
+******************************************************************************/
+int digsig_screen_add(struct digsig_screen *s, struct file *file,
+		      struct digsig_screen_sig *sig,
+		      struct digsig_verdict verdict)
+{
+	int max = min(dsi_screen, DIGSIG_SCREEN_MAX);
+	struct digsig_screen_batch *b, *new = NULL;
+
+	if (digsig_revoked_sigs())
+		return -EPERM;
+
+	spin_lock(&s->lock);
+	if (!s->batch) {
+		spin_unlock(&s->lock);
+		new = kmalloc(sizeof(*new), GFP_KERNEL);
+		if (!new)
+			return -ENOMEM;
+		new->n = 0;
+		spin_lock(&s->lock);
+		if (!s->batch) {
+			s->batch = new;
+			new = NULL;
+		}
+	}
+	b = s->batch;
+	b->sig[b->n] = *sig;
+	sig->s = sig->m = NULL;
+	b->file[b->n] = get_file(file);
+	b->verdict[b->n] = verdict;
+	/* the signature is not known, see digsig_revoked_hash_listed() */
+	b->verdict[b->n].sig_hash = 0;
+	if (++b->n < max)
+		b = NULL;
+	else
+		s->batch = NULL;
+	spin_unlock(&s->lock);
+	kfree(new);
+
+	if (b)
+		digsig_screen_run(s, b);
+	return 0;
+}
+
+/******************************************************************************
+Description : Screen the batch being filled, once no more files come.
+Parameters  :
+	@s: from digsig_screen_alloc(), may be NULL
+Return value: none
+******************************************************************************/
+void digsig_screen_flush(struct digsig_screen *s)
+{
+	struct digsig_screen_batch *b;
+
+	if (!s)
+		return;
+	spin_lock(&s->lock);
+	b = s->batch;
+	s->batch = NULL;
+	spin_unlock(&s->lock);
+	if (b)
+		digsig_screen_run(s, b);
+}
+
+/******************************************************************************
+Description : Screen what is left and free the batches.
+Parameters  :
+	@s: from digsig_screen_alloc(), may be NULL
+Return value: none
+******************************************************************************/
+void digsig_screen_free(struct digsig_screen *s)
+{
+	digsig_screen_flush(s);
+	kfree(s);
+}
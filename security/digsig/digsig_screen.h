@@ -0,0 +1,49 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the screening of RSA signatures in batches.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SCREEN_H
+#define _DIGSIG_SCREEN_H
+
+#include <linux/fs.h>
+
+#include "digsig_verify.h"
+#include "digsig_inode.h"
+
+/* digsig_verify_file_screen(): the verdict comes from the batch */
+#define DIGSIG_SCREEN_QUEUED 1
+
+struct digsig_screen;
+
+/* called with the verdict of each file the batch screened */
+typedef void (*digsig_screen_done_t)(struct file *file, int result,
+				     void *data);
+
+/* in digsig.c */
+int digsig_verify_file_screen(struct file *file, struct digsig_screen *s);
+void digsig_verdict_screened(struct file *file, struct digsig_verdict verdict);
+
+#ifdef CONFIG_SECURITY_DIGSIG_SCREEN
+struct digsig_screen *digsig_screen_alloc(digsig_screen_done_t done,
+					  void *data);
+int digsig_screen_add(struct digsig_screen *s, struct file *file,
+		      struct digsig_screen_sig *sig,
+		      struct digsig_verdict verdict);
+void digsig_screen_flush(struct digsig_screen *s);
+void digsig_screen_free(struct digsig_screen *s);
+#else
+#define digsig_screen_alloc(done, data) ((void)(done), NULL)
+#define digsig_screen_add(s, file, sig, verdict) (-EINVAL)
+#define digsig_screen_flush(s) do { } while (0)
+#define digsig_screen_free(s) do { } while (0)
+#endif
+
+#endif /* _DIGSIG_SCREEN_H */
@@ -0,0 +1,472 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies files signed by segment: the signature is of the
+ * ELF header, the program headers and the file contents of the
+ * segments, which is all the ELF loaders read and map, rather than of
+ * the whole file.  The sections no segment holds, debug information and
+ * symbol tables, are not hashed, and verifying an unstripped binary
+ * costs what verifying its stripped copy would.
+ *
+ * The ranges are rounded out to DIGSIG_SEGMENTS_ALIGN, as binfmt_elf and
+ * ld.so map whole pages around each segment.  The signature is found as
+ * the others are, in a section or a DigSig note of its own type, and is
+ * zeroed when the ranges are hashed if it lies within one of them.
+ *
+ * The pages out of the ranges are not signed, and may not be executed:
+ * once a verified file is mapped, the part of an executable mapping out
+ * of them loses PROT_EXEC, as the tail ld.so maps with the first
+ * segment of a library before it maps the others over it, and making a
+ * mapping of such pages executable with mprotect() is refused.  The
+ * executable mappings of the signed pages can not be grown by mremap().
+ * The ranges are kept on the inode, and read again from the file for
+ * a verdict that was not made by hashing it, until it is written.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+
+#include "digsig_common.h"
+#include "digsig_inode.h"
+#include "digsig_segments.h"
+
+/* program headers looked at, at most, as binfmt_elf allows */
+#define DIGSIG_SEGMENTS_PHDR_MAX (65536U / sizeof(Elf64_Phdr))
+
+/*
+ * digsig_segments_map: the pages of the ranges, those wholly signed, and
+ * the page after the end of the file, from which none holds its bytes.
+ */
+struct digsig_segments_map {
+	struct rcu_head rcu;
+	pgoff_t eof;
+	unsigned int n;
+	struct {
+		pgoff_t start, end;
+	} range[DIGSIG_SEGMENTS_MAX];
+};
+
+/*
+ * Add [start, start + len), rounded out, to the ranges, merged with those
+ * it overlaps or touches: 0 on success, -EINVAL if it is past the end of
+ * the file or there are too many ranges.
+ */
+static int digsig_range_add(struct digsig_segments *s, u64 start, u64 len,
+			    loff_t i_size)
+{
+	unsigned int i, j;
+	loff_t end;
+
+	if (!len)
+		return 0;
+	if (start > i_size || len > i_size - start)
+		return -EINVAL;
+	end = min_t(u64, round_up(start + len, DIGSIG_SEGMENTS_ALIGN), i_size);
+	start = round_down(start, DIGSIG_SEGMENTS_ALIGN);
+
+	/* the first range not before it, and the last it runs into */
+	for (i = 0; i < s->n && s->range[i].end < start; i++)
+		;
+	for (j = i; j < s->n && s->range[j].start <= end; j++) {
+		start = min_t(loff_t, start, s->range[j].start);
+		end = max(end, s->range[j].end);
+	}
+
+	if (j == i) {
+		if (s->n == DIGSIG_SEGMENTS_MAX)
+			return -EINVAL;
+		memmove(&s->range[i + 1], &s->range[i],
+			(s->n - i) * sizeof(s->range[0]));
+		s->n++;
+	} else if (j > i + 1) {
+		memmove(&s->range[i + 1], &s->range[j],
+			(s->n - j) * sizeof(s->range[0]));
+		s->n -= j - i - 1;
+	}
+	s->range[i].start = start;
+	s->range[i].end = end;
+	return 0;
+}
+
+#define DIGSIG_SEGMENTS_READ(bits)					\
+static int digsig_segments_read##bits(struct file *file,		\
+				      struct elf##bits##_hdr *elf_ex,	\
+				      struct digsig_segments *s,	\
+				      loff_t i_size)			\
+{									\
+	Elf##bits##_Phdr phdr;						\
+	loff_t pos;							\
+	int i, retval;							\
+									\
+	if (!elf_ex->e_phoff || elf_ex->e_phentsize != sizeof(phdr) ||	\
+	    elf_ex->e_phnum > DIGSIG_SEGMENTS_PHDR_MAX)			\
+		return -EINVAL;						\
+									\
+	retval = digsig_range_add(s, 0, sizeof(*elf_ex), i_size);	\
+	if (!retval)							\
+		retval = digsig_range_add(s, elf_ex->e_phoff,		\
+					  elf_ex->e_phnum * sizeof(phdr), \
+					  i_size);			\
+	for (i = 0; i < elf_ex->e_phnum && !retval; i++) {		\
+		pos = elf_ex->e_phoff + i * sizeof(phdr);		\
+		if (kernel_read(file, pos, (char *)&phdr,		\
+				sizeof(phdr)) != sizeof(phdr))		\
+			return -EIO;					\
+		retval = digsig_range_add(s, phdr.p_offset,		\
+					  phdr.p_filesz, i_size);	\
+	}								\
+	return retval;							\
+}
+
+DIGSIG_SEGMENTS_READ(32)
+DIGSIG_SEGMENTS_READ(64)
+
+/******************************************************************************
+Description : Find the ranges of the file a segment signature is of.
+	Every segment is covered, whatever its type, so that what the ELF
+	loaders read outside of PT_LOAD, the interpreter path for one, is
+	signed too.
+Parameters  :
+	@file: the file being verified
+	@elf64_ex: its ELF header, of either class
+	@arch32: set if the file is ELF32
+	@s: receives the ranges
+Return value: 0 on success, negative if a segment lies outside of the
+	file or there are too many of them
+******************************************************************************/
+int digsig_segments_read(struct file *file, struct elf64_hdr *elf64_ex,
+			 int arch32, struct digsig_segments *s)
+{
+	loff_t i_size = i_size_read(file_inode(file));
+	int retval;
+
+	s->n = 0;
+	if (arch32)
+		retval = digsig_segments_read32(file,
+				(struct elf32_hdr *) elf64_ex, s, i_size);
+	else
+		retval = digsig_segments_read64(file, elf64_ex, s, i_size);
+	if (retval)
+		DSM_PRINT(DEBUG_SIGN, "%s: bad program headers: %d\n",
+			  __func__, retval);
+	return retval;
+}
+
+/*
+ * Hash the bytes [start, end) of the file, all within the page mapped
+ * at kaddr, with the signature read as zeroes.
+ */
+static int digsig_segments_hash_range(SIGCTX *ctx, char *kaddr, loff_t start,
+				      loff_t end, loff_t lower, loff_t upper)
+{
+	char *zeroes = page_address(ZERO_PAGE(0));
+	loff_t next;
+	int retval = 0;
+
+	while (start < end && retval >= 0) {
+		if (start >= lower && start < upper) {
+			next = min(end, upper);
+			retval = digsig_sign_verify_update(ctx, zeroes,
+							   next - start);
+		} else {
+			next = start < lower ? min(end, lower) : end;
+			retval = digsig_sign_verify_update(ctx,
+					kaddr + (start & ~PAGE_MASK),
+					next - start);
+		}
+		start = next;
+	}
+	return retval < 0 ? retval : 0;
+}
+
+/******************************************************************************
+Description : Hash the ranges of the file, in order, into the
+	verification context.
+Parameters  :
+	@ctx: the verification context, its hash initialized
+	@file: the file, read through its page cache
+	@s: the ranges, from digsig_segments_read()
+	@sig_offset: where the signature is, hashed as zeroes
+	@sig_size: the size of the signature
+Return value: 0 on success, negative otherwise
+******************************************************************************/
+int digsig_segments_hash(SIGCTX *ctx, struct file *file,
+			 struct digsig_segments *s, loff_t sig_offset,
+			 unsigned long sig_size)
+{
+	struct address_space *mapping = file->f_mapping;
+	loff_t pos, end;
+	struct page *page;
+	unsigned int i;
+	int retval = 0;
+
+	if (!mapping || !mapping->a_ops->readpage)
+		return -EINVAL;
+
+	for (i = 0; i < s->n && !retval; i++) {
+		for (pos = s->range[i].start; pos < s->range[i].end && !retval;
+		     pos = end) {
+			page = read_mapping_page(mapping,
+						 pos >> PAGE_CACHE_SHIFT, file);
+			if (IS_ERR(page))
+				return PTR_ERR(page);
+
+			end = min_t(loff_t, s->range[i].end,
+				    (pos | ~PAGE_MASK) + 1);
+			retval = digsig_segments_hash_range(ctx, kmap(page),
+					pos, end, sig_offset,
+					sig_offset + sig_size);
+			kunmap(page);
+			page_cache_release(page);
+		}
+	}
+	return retval;
+}
+
+/*
+ * Is page pgoff of the file signed?  Returns the first page after it
+ * for which that changes, ULONG_MAX if none does.
+ */
+static pgoff_t digsig_segments_run(const struct digsig_segments_map *m,
+				   pgoff_t pgoff, int *sig)
+{
+	unsigned int i;
+
+	*sig = 1;
+	if (pgoff >= m->eof)
+		return ULONG_MAX;
+	for (i = 0; i < m->n; i++) {
+		if (pgoff < m->range[i].start)
+			break;
+		if (pgoff < m->range[i].end)
+			return m->range[i].end < m->eof ? m->range[i].end :
+				ULONG_MAX;
+	}
+	*sig = 0;
+	return i < m->n ? m->range[i].start : m->eof;
+}
+
+/* A copy of the pages of the inode, 0 if it has none. */
+static int digsig_segments_get(struct inode *inode,
+			       struct digsig_segments_map *m)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_segments_map *map;
+
+	if (!isec || !ACCESS_ONCE(isec->segments))
+		return 0;
+	rcu_read_lock();
+	map = rcu_dereference(isec->segments);
+	if (map)
+		*m = *map;
+	rcu_read_unlock();
+	return map != NULL;
+}
+
+/******************************************************************************
+Description : Keep on the inode which of its pages may be executed.
+Parameters  :
+	@inode: a file just verified, or whose verdict was just found
+	@s: the ranges its segment signature is of, NULL if it is signed
+	whole
+Return value: 0 on success, -ENOMEM
+******************************************************************************/
+int digsig_segments_keep(struct inode *inode, struct digsig_segments *s)
+{
+	struct digsig_inode_sec *isec = digsig_inode_get(inode);
+	struct digsig_segments_map *map = NULL, *old;
+	loff_t i_size = i_size_read(inode);
+	unsigned int i;
+
+	if (!isec)
+		return -ENOMEM;
+	if (s) {
+		map = kmalloc(sizeof(*map), GFP_KERNEL);
+		if (!map)
+			return -ENOMEM;
+		/* only the pages all of whose bytes in the file are signed */
+		map->eof = DIV_ROUND_UP(i_size, PAGE_SIZE);
+		map->n = s->n;
+		for (i = 0; i < s->n; i++) {
+			map->range[i].start = DIV_ROUND_UP(s->range[i].start,
+							   PAGE_SIZE);
+			map->range[i].end = s->range[i].end == i_size ?
+				map->eof : s->range[i].end >> PAGE_SHIFT;
+		}
+	}
+	old = xchg(&isec->segments, map);
+	if (old)
+		kfree_rcu(old, rcu);
+	smp_wmb();
+	set_bit(DIGSIG_INODE_SEGMENTS, &isec->flags);
+	return 0;
+}
+
+static int digsig_segments_kread(void *src, loff_t pos, char *buf,
+				 unsigned long len)
+{
+	return kernel_read(src, pos, buf, len);
+}
+
+/******************************************************************************
+Description : Find out whether a verified file about to be mapped for
+	execution is signed by segment, if its verdict was not made by
+	hashing it, and keep the ranges of its signature.
+Parameters  :
+	@file: the file
+Return value: 0 on success, negative if the file can not be read; it is
+	not mapped then
+******************************************************************************/
+int digsig_segments_learn(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_segments *s = NULL;
+	struct digsig_notes notes;
+	struct elf64_hdr ehdr;
+	void *buf;
+	int arch32, rc = 0;
+
+	if (isec && test_bit(DIGSIG_INODE_SEGMENTS, &isec->flags))
+		return 0;
+	/* a file let through unverified had no signature to go by */
+	if (!digsig_inode_verified(inode))
+		return 0;
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	if (kernel_read(file, 0, (char *)&ehdr, sizeof(ehdr)) <
+	    (int)sizeof(struct elf32_hdr) || digsig_elf_sanity_check(&ehdr))
+		return digsig_segments_keep(inode, NULL);
+	arch32 = ehdr.e_ident[EI_CLASS] == ELFCLASS32;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	memset(&notes, 0, sizeof(notes));
+	if (!digsig_find_notes(digsig_segments_kread, file, &ehdr, arch32,
+			       buf, PAGE_SIZE, &notes))
+		rc = digsig_scan_sections(digsig_segments_kread, file, &ehdr,
+					  arch32, buf, PAGE_SIZE, &notes);
+	kfree(buf);
+	if (rc < 0)
+		return rc;
+
+	if (notes.segments) {
+		s = kmalloc(sizeof(*s), GFP_KERNEL);
+		if (!s)
+			return -ENOMEM;
+		rc = digsig_segments_read(file, &ehdr, arch32, s);
+	}
+	if (!rc)
+		rc = digsig_segments_keep(inode, s);
+	kfree(s);
+	return rc;
+}
+
+/******************************************************************************
+Description : Forget the ranges of a file about to change.
+Parameters  :
+	@inode: the file
+Return value: none
+******************************************************************************/
+void digsig_segments_forget(struct inode *inode)
+{
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+	struct digsig_segments_map *old;
+
+	if (!isec || !test_and_clear_bit(DIGSIG_INODE_SEGMENTS, &isec->flags))
+		return;
+	old = xchg(&isec->segments, NULL);
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+/******************************************************************************
+Description : Take PROT_EXEC from the pages of a new executable mapping
+	that are not signed, and keep the mapping from growing.
+Parameters  :
+	@file: the file mapped
+	@addr: the start of the mapping
+	@len: its length
+Return value: 0 on success, negative if the protection could not be
+	changed; the mapping is removed then
+******************************************************************************/
+int digsig_segments_mmapped(struct file *file, unsigned long addr,
+			    unsigned long len)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma, *prev;
+	struct digsig_segments_map m;
+	unsigned long start, end, stop = addr + PAGE_ALIGN(len);
+	pgoff_t pgoff, next;
+	int sig, rc;
+
+	vma = find_vma(mm, addr);
+	if (!vma || vma->vm_start > addr || vma->vm_file != file ||
+	    !(vma->vm_flags & VM_EXEC) || !digsig_segments_get(file_inode(file),
+							       &m))
+		return 0;
+
+	for (start = addr; start < stop; start = end) {
+		vma = find_vma(mm, start);
+		if (!vma || vma->vm_start > start)
+			return -ENOMEM;
+		pgoff = vma->vm_pgoff + ((start - vma->vm_start) >> PAGE_SHIFT);
+		next = digsig_segments_run(&m, pgoff, &sig);
+		end = min(stop, vma->vm_end);
+		if (next - pgoff < (end - start) >> PAGE_SHIFT)
+			end = start + ((next - pgoff) << PAGE_SHIFT);
+		if (sig) {
+			vma->vm_flags |= VM_DONTEXPAND;
+			continue;
+		}
+		prev = start > vma->vm_start ? vma : vma->vm_prev;
+		rc = mprotect_fixup(vma, &prev, start, end,
+				    vma->vm_flags & ~VM_EXEC);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+/******************************************************************************
+Description : May a mapping be made executable?
+Parameters  :
+	@vma: the mapping, of a file
+	@prot: the protection it is to have
+Return value: 0 if it may, -EACCES if it holds pages that are not signed
+******************************************************************************/
+int digsig_segments_mprotect(struct vm_area_struct *vma, unsigned long prot)
+{
+	struct digsig_segments_map m;
+	pgoff_t pgoff, end;
+	int sig;
+
+	if (!(prot & PROT_EXEC) || !digsig_segments_get(file_inode(vma->vm_file),
+							&m))
+		return 0;
+	/* its pages may be of any offset */
+	if (vma->vm_flags & VM_NONLINEAR)
+		return -EACCES;
+
+	end = vma->vm_pgoff + vma_pages(vma);
+	for (pgoff = vma->vm_pgoff; pgoff < end; ) {
+		pgoff = digsig_segments_run(&m, pgoff, &sig);
+		if (!sig)
+			return -EACCES;
+	}
+	return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the signatures of the segments of a file.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_SEGMENTS_H
+#define _DIGSIG_SEGMENTS_H
+
+#include <linux/fs.h>
+#include <linux/elf.h>
+#include <linux/mm.h>
+
+#include "digsig_verify.h"
+
+/*
+ * digsig_segments: the ranges of the file a segment signature is of, in
+ * file order and not overlapping: the ELF header, the program headers
+ * and the file contents of every segment, rounded out to
+ * DIGSIG_SEGMENTS_ALIGN.
+ */
+struct digsig_segments {
+	unsigned int n;
+	struct {
+		loff_t start, end;
+	} range[DIGSIG_SEGMENTS_MAX];
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_SEGMENTS
+int digsig_segments_read(struct file *file, struct elf64_hdr *elf64_ex,
+			 int arch32, struct digsig_segments *s);
+int digsig_segments_hash(SIGCTX *ctx, struct file *file,
+			 struct digsig_segments *s, loff_t sig_offset,
+			 unsigned long sig_size);
+int digsig_segments_keep(struct inode *inode, struct digsig_segments *s);
+int digsig_segments_learn(struct file *file);
+void digsig_segments_forget(struct inode *inode);
+int digsig_segments_mmapped(struct file *file, unsigned long addr,
+			    unsigned long len);
+int digsig_segments_mprotect(struct vm_area_struct *vma, unsigned long prot);
+#else
+#define digsig_segments_read(file, elf64_ex, arch32, s) (-EOPNOTSUPP)
+#define digsig_segments_hash(ctx, file, s, sig_offset, sig_size) (-EINVAL)
+#define digsig_segments_keep(inode, s) do { } while (0)
+#define digsig_segments_learn(file) 0
+#define digsig_segments_forget(inode) do { } while (0)
+#define digsig_segments_mmapped(file, addr, len) 0
+#define digsig_segments_mprotect(vma, prot) 0
+#endif
+
+#endif /* _DIGSIG_SEGMENTS_H */
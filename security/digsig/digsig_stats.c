@@ -0,0 +1,200 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps a histogram of the time spent in each phase of a
+ * check, in nanoseconds, so that the cost of DigSig on exec can be
+ * broken down on production systems.  The histograms are kept per CPU,
+ * added up when read from /sys/kernel/security/digsig/latency, and
+ * cleared by writing to that file.  The counters of the verdict cache
+ * are shown next to them, in /sys/kernel/security/digsig/cache.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+#include <linux/string.h>
+#include <linux/err.h>
+#include <linux/kobject.h>
+
+#include "digsig_common.h"
+#include "digsig_stats.h"
+#include "digsig_cache.h"
+#include "digsig_sysfs.h"
+
+/* bucket i counts the times in [2^i, 2^(i+1)) ns, the last one above */
+#define DIGSIG_STATS_BUCKETS 32
+
+struct digsig_stats {
+	u64 hist[DIGSIG_PHASES][DIGSIG_STATS_BUCKETS];
+	u64 count[DIGSIG_PHASES];
+	u64 sum[DIGSIG_PHASES];
+};
+
+static DEFINE_PER_CPU(struct digsig_stats, digsig_stats);
+
+const char *digsig_phase_names[DIGSIG_PHASES] = {
+	[DIGSIG_PHASE_CACHE] = "cache",
+	[DIGSIG_PHASE_HEADER] = "header",
+	[DIGSIG_PHASE_SECTIONS] = "sections",
+	[DIGSIG_PHASE_REVOKE] = "revoke",
+	[DIGSIG_PHASE_HASH] = "hash",
+	[DIGSIG_PHASE_VERIFY] = "verify",
+	[DIGSIG_PHASE_TOTAL] = "total",
+};
+
+static struct dentry *digsig_stats_file, *digsig_cache_file;
+
+/******************************************************************************
+Description : Account the time since @start to a phase.
+Parameters  :
+	@phase: one of DIGSIG_PHASE_*
+	@start: digsig_stats_start() from when the phase began
+Return value: none
+******************************************************************************/
+void digsig_stats_add(int phase, digsig_stamp_t start)
+{
+#ifdef CONFIG_SECURITY_DIGSIG_PMU
+	u64 ns = local_clock() - start.ns;
+#else
+	u64 ns = local_clock() - start;
+#endif
+	int b = ns ? min(fls64(ns) - 1, DIGSIG_STATS_BUCKETS - 1) : 0;
+
+	this_cpu_inc(digsig_stats.hist[phase][b]);
+	this_cpu_inc(digsig_stats.count[phase]);
+	this_cpu_add(digsig_stats.sum[phase], ns);
+#ifdef CONFIG_SECURITY_DIGSIG_PMU
+	digsig_pmu_add(phase, &start);
+#endif
+}
+
+/* Clear the histograms; a phase ending meanwhile may stay counted. */
+void digsig_stats_reset(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&digsig_stats, cpu), 0,
+		       sizeof(struct digsig_stats));
+}
+
+static void digsig_stats_sum(int phase, u64 *hist, u64 *count, u64 *sum)
+{
+	struct digsig_stats *s;
+	int cpu, b;
+
+	memset(hist, 0, DIGSIG_STATS_BUCKETS * sizeof(*hist));
+	*count = *sum = 0;
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(&digsig_stats, cpu);
+		for (b = 0; b < DIGSIG_STATS_BUCKETS; b++)
+			hist[b] += s->hist[phase][b];
+		*count += s->count[phase];
+		*sum += s->sum[phase];
+	}
+}
+
+/* The totals of each phase, for the 'p' command of /sys/digsig/key. */
+void digsig_stats_print(void)
+{
+	u64 hist[DIGSIG_STATS_BUCKETS], count, sum;
+	int phase;
+
+	for (phase = 0; phase < DIGSIG_PHASES; phase++) {
+		digsig_stats_sum(phase, hist, &count, &sum);
+		printk(KERN_INFO "DIGSIG %s: %llu in %llu ns\n",
+		       digsig_phase_names[phase], count, sum);
+	}
+}
+
+static int digsig_stats_show(struct seq_file *m, void *v)
+{
+	u64 hist[DIGSIG_STATS_BUCKETS], count, sum;
+	int phase, b;
+
+	seq_puts(m, "# phase count total_ns, then the counts of"
+		 " [2^i, 2^(i+1)) ns for i = 0..31\n");
+	for (phase = 0; phase < DIGSIG_PHASES; phase++) {
+		digsig_stats_sum(phase, hist, &count, &sum);
+		seq_printf(m, "%s %llu %llu", digsig_phase_names[phase],
+			   count, sum);
+		for (b = 0; b < DIGSIG_STATS_BUCKETS; b++)
+			seq_printf(m, " %llu", hist[b]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int digsig_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_stats_show, NULL);
+}
+
+static ssize_t digsig_stats_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	digsig_stats_reset();
+	return count;
+}
+
+static const struct file_operations digsig_stats_fops = {
+	.open = digsig_stats_open,
+	.read = seq_read,
+	.write = digsig_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int digsig_cache_stats_seq(struct seq_file *m, void *v)
+{
+	digsig_cache_stats_show(m);
+	return 0;
+}
+
+static int digsig_cache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_cache_stats_seq, NULL);
+}
+
+static const struct file_operations digsig_cache_stats_fops = {
+	.open = digsig_cache_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/latency, and cache which
+	shows the counters of the verdict cache.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_stats(void)
+{
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	digsig_stats_file = securityfs_create_file("latency", 0600,
+						   digsig_securityfs_dir, NULL,
+						   &digsig_stats_fops);
+	if (IS_ERR(digsig_stats_file))
+		return PTR_ERR(digsig_stats_file);
+
+	digsig_cache_file = securityfs_create_file("cache", 0400,
+						   digsig_securityfs_dir, NULL,
+						   &digsig_cache_stats_fops);
+	if (IS_ERR(digsig_cache_file)) {
+		securityfs_remove(digsig_stats_file);
+		return PTR_ERR(digsig_cache_file);
+	}
+	return 0;
+}
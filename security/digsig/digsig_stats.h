@@ -0,0 +1,69 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the latency histograms.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_STATS_H
+#define _DIGSIG_STATS_H
+
+#include <linux/types.h>
+#include <linux/sched.h>
+
+#include "digsig_pmu.h"
+
+/* the phases of a check, each with its histogram */
+#define DIGSIG_PHASE_CACHE 0	/* verdict cache lookup */
+#define DIGSIG_PHASE_HEADER 1	/* ELF header read and checked */
+#define DIGSIG_PHASE_SECTIONS 2	/* section table read and searched */
+#define DIGSIG_PHASE_REVOKE 3	/* revocation list lookup */
+#define DIGSIG_PHASE_HASH 4	/* file hashed */
+#define DIGSIG_PHASE_VERIFY 5	/* signature checked against the hash */
+#define DIGSIG_PHASE_TOTAL 6	/* the whole check, hit or miss */
+#define DIGSIG_PHASES 7
+
+/* when a phase began, as digsig_stats_add() takes it */
+#ifdef CONFIG_SECURITY_DIGSIG_PMU
+typedef struct digsig_stamp digsig_stamp_t;
+#else
+typedef u64 digsig_stamp_t;
+#endif
+
+#ifdef CONFIG_SECURITY_DIGSIG_PMU
+static inline digsig_stamp_t digsig_stats_start(void)
+{
+	digsig_stamp_t s;
+
+	digsig_pmu_start(&s);
+	s.ns = local_clock();
+	return s;
+}
+#elif defined(CONFIG_SECURITY_DIGSIG_STATS)
+static inline u64 digsig_stats_start(void)
+{
+	return local_clock();
+}
+#endif
+
+#ifdef CONFIG_SECURITY_DIGSIG_STATS
+extern const char *digsig_phase_names[DIGSIG_PHASES];
+
+void digsig_stats_add(int phase, digsig_stamp_t start);
+void digsig_stats_reset(void);
+void digsig_stats_print(void);
+int digsig_init_stats(void);
+#else
+#define digsig_stats_start() 0ULL
+#define digsig_stats_add(phase, start) do { (void)(start); } while (0)
+#define digsig_stats_reset() do { } while (0)
+#define digsig_stats_print() do { } while (0)
+#define digsig_init_stats() 0
+#endif
+
+#endif /* _DIGSIG_STATS_H */
@@ -36,6 +36,14 @@
 #include "digsig_verify.h"
 #include "digsig_cache.h"
 #include "digsig_revocation.h"
+#include "digsig_ed25519.h"
+#include "digsig_verity.h"
+#include "digsig_manifest.h"
+#include "digsig_sb.h"
+#include "digsig_stats.h"
+#include "digsig_bench.h"
+#include "digsig_initramfs.h"
+#include "digsig_preload.h"
 
 
 /* For use with LTM, we copy everything except the first three bytes
@@ -44,7 +52,6 @@
 */
 #define DIGSIG_KEY_OFFSET 1
 
-extern long int total_jiffies; /* digsig.c */
 
 struct digsig_attribute  {
 	struct attribute attr;
@@ -98,6 +105,86 @@ static ssize_t digsig_status_store(struct kobject *obj,
 	struct attribute *attr, const char *buff, size_t count);
 static DIGSIG_ATTR(status, 0600, digsig_status_show, digsig_status_store);
 
+/*
+ * Prototypes and attribute for /sys/digsig/cache_capacity, which shows the
+ * current and target number of entries of the signature cache, and takes
+ * a new target.
+ */
+static ssize_t digsig_cache_capacity_show(struct kobject *obj,
+	struct attribute *attr, char *buff);
+static ssize_t digsig_cache_capacity_store(struct kobject *obj,
+	struct attribute *attr, const char *buff, size_t count);
+static DIGSIG_ATTR(cache_capacity, 0600, digsig_cache_capacity_show,
+	digsig_cache_capacity_store);
+
+/*
+ * Prototypes and attribute for /sys/digsig/policy, which lists the rules
+ * giving each superblock its policy, and takes a rule to change.
+ */
+static ssize_t digsig_policy_show(struct kobject *obj,
+	struct attribute *attr, char *buff);
+static ssize_t digsig_policy_store(struct kobject *obj,
+	struct attribute *attr, const char *buff, size_t count);
+static DIGSIG_ATTR(policy, 0600, digsig_policy_show, digsig_policy_store);
+
+/*
+ * Prototype and attribute for /sys/digsig/bench, which runs the benchmark
+ * whose name is written to it.
+ */
+static ssize_t digsig_bench_store(struct kobject *obj,
+	struct attribute *attr, const char *buff, size_t count);
+static DIGSIG_ATTR(bench, 0200, NULL, digsig_bench_store);
+
+/*
+ * /sys/digsig/revoke_list takes a whole revocation list in the binary
+ * format of digsig_revocation.h, which replaces the one in force.
+ */
+static ssize_t digsig_revoke_list_bin_write(struct file *file,
+	struct kobject *kobj, struct bin_attribute *attr, char *buf,
+	loff_t off, size_t count)
+{
+	return digsig_revoke_list_write(buf, off, count);
+}
+
+static struct bin_attribute digsig_attr_revoke_list = {
+	.attr = { .name = "revoke_list", .mode = 0200 },
+	.write = digsig_revoke_list_bin_write,
+};
+
+/*
+ * /sys/digsig/verity_root takes a signed dm-verity root hash, in the
+ * format of digsig_verity.h, in a single write.
+ */
+static ssize_t digsig_verity_root_bin_write(struct file *file,
+	struct kobject *kobj, struct bin_attribute *attr, char *buf,
+	loff_t off, size_t count)
+{
+	if (off)
+		return -EINVAL;
+	return digsig_verity_add_root(buf, count);
+}
+
+static struct bin_attribute digsig_attr_verity_root = {
+	.attr = { .name = "verity_root", .mode = 0200 },
+	.write = digsig_verity_root_bin_write,
+};
+
+/*
+ * /sys/digsig/manifest takes a signed manifest of file digests, in the
+ * format of digsig_manifest.h, whose digests are added to those listed.
+ */
+static ssize_t digsig_manifest_bin_write(struct file *file,
+	struct kobject *kobj, struct bin_attribute *attr, char *buf,
+	loff_t off, size_t count)
+{
+	return digsig_manifest_write(buf, off, count);
+}
+
+static struct bin_attribute digsig_attr_manifest = {
+	.attr = { .name = "manifest", .mode = 0200 },
+	.write = digsig_manifest_bin_write,
+};
+
 /*
  * Next are the digsig sysfs file operations.  These are assigned to
  * the files under /sys/digsig.  They will use the digsig_attribute
@@ -166,11 +253,55 @@ int __init digsig_init_sysfs(void)
 
 	if (sysfs_create_file(digsig_kobject, &digsig_attr_status.attr) != 0) {
 		DSM_ERROR("sysfs_create_file() failed for digsig_attr_status\n");
-		goto create_revoke;
+		goto create_status;
+	}
+
+	if (sysfs_create_file(digsig_kobject, &digsig_attr_cache_capacity.attr) != 0) {
+		DSM_ERROR("sysfs_create_file() failed for digsig_attr_cache_capacity\n");
+		goto create_cache_capacity;
+	}
+
+	if (sysfs_create_file(digsig_kobject, &digsig_attr_policy.attr) != 0) {
+		DSM_ERROR("sysfs_create_file() failed for digsig_attr_policy\n");
+		goto create_policy;
+	}
+
+	if (sysfs_create_bin_file(digsig_kobject, &digsig_attr_revoke_list) != 0) {
+		DSM_ERROR("sysfs_create_bin_file() failed for digsig_attr_revoke_list\n");
+		goto create_revoke_list;
+	}
+
+	if (sysfs_create_bin_file(digsig_kobject, &digsig_attr_verity_root) != 0) {
+		DSM_ERROR("sysfs_create_bin_file() failed for digsig_attr_verity_root\n");
+		goto create_verity_root;
+	}
+
+	if (sysfs_create_bin_file(digsig_kobject, &digsig_attr_manifest) != 0) {
+		DSM_ERROR("sysfs_create_bin_file() failed for digsig_attr_manifest\n");
+		goto create_manifest;
+	}
+
+	if (sysfs_create_file(digsig_kobject, &digsig_attr_bench.attr) != 0) {
+		DSM_ERROR("sysfs_create_file() failed for digsig_attr_bench\n");
+		goto create_bench;
 	}
 
 	return 0;
 
+create_bench:
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_manifest);
+create_manifest:
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_verity_root);
+create_verity_root:
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_revoke_list);
+create_revoke_list:
+	sysfs_remove_file(digsig_kobject, &digsig_attr_policy.attr);
+create_policy:
+	sysfs_remove_file(digsig_kobject, &digsig_attr_cache_capacity.attr);
+create_cache_capacity:
+	sysfs_remove_file(digsig_kobject, &digsig_attr_status.attr);
+create_status:
+	sysfs_remove_file(digsig_kobject, &digsig_attr_revoke.attr);
 create_revoke:
 	sysfs_remove_file(digsig_kobject, &digsig_attr_key.attr);
 create_key:
@@ -184,9 +315,36 @@ void digsig_cleanup_sysfs(void)
 	sysfs_remove_file(digsig_kobject, &digsig_attr_key.attr);
 	sysfs_remove_file(digsig_kobject, &digsig_attr_revoke.attr);
 	sysfs_remove_file(digsig_kobject, &digsig_attr_status.attr);
+	sysfs_remove_file(digsig_kobject, &digsig_attr_cache_capacity.attr);
+	sysfs_remove_file(digsig_kobject, &digsig_attr_policy.attr);
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_revoke_list);
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_verity_root);
+	sysfs_remove_bin_file(digsig_kobject, &digsig_attr_manifest);
+	sysfs_remove_file(digsig_kobject, &digsig_attr_bench.attr);
 	kobject_put(digsig_kobject);
 }
 
+/* digsig_securityfs_dir: the /sys/kernel/security/digsig directory */
+struct dentry *digsig_securityfs_dir;
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig, which holds the files
+	that need more than a sysfs attribute: seq_file reports and
+	streams of records.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig then runs
+	without those files
+******************************************************************************/
+int __init digsig_init_securityfs(void)
+{
+	struct dentry *dir = securityfs_create_dir("digsig", NULL);
+
+	if (IS_ERR(dir))
+		return PTR_ERR(dir);
+	digsig_securityfs_dir = dir;
+	return 0;
+}
+
 /********************************************************************************
 Description : This function reads the public key parts
 We receive first n (the modulus) and then e (public exponent). They follow
@@ -194,9 +352,115 @@ this format:
  - 1 byte : character 'n' or 'e'
  - 2 bytes: length of MPI in BITS
  - MPI
+An Ed25519 key is written as 'k', its 8 byte key ID and the 32 byte key.
+It may be added once, after the RSA key, or be the only key; once the
+hooks are on, it is taken only with a signature section after it, as
+for 'K' below.
+More RSA keys are written as 'K', the 8 byte key ID of their signatures,
+then n and e each as above, and may be added at any time; once the hooks
+are on, a signature section, as for the verity roots, follows e and signs
+everything before it with a key already loaded.  'R' and the 8 byte key
+ID retire such a key, and the verdicts made with it.
 Parameters  :
 Return value:
 *********************************************************************************/
+static ssize_t digsig_ed25519_key_store(const char *buff, size_t count)
+{
+	size_t size = DIGSIG_KEY_OFFSET + ED25519_KEYID_SIZE + ED25519_KEY_SIZE;
+	int rc;
+
+	/* once enforcing, only a key trusted ones vouch for is taken */
+	if (g_init) {
+		if (count <= size)
+			return -EINVAL;
+		rc = digsig_verify_buffer((char *)buff, size,
+					  (char *)buff + size, count - size);
+		if (rc)
+			return rc;
+	} else if (count != size) {
+		return -EINVAL;
+	}
+
+	rc = digsig_ed25519_set_key(buff + DIGSIG_KEY_OFFSET + ED25519_KEYID_SIZE,
+				    buff + DIGSIG_KEY_OFFSET);
+	if (rc)
+		return rc;
+
+	if (digsig_init_key_fingerprint())
+		DSM_ERROR("%s: cannot compute key fingerprint\n", __func__);
+	if (!g_init) {
+		digsig_set_active();
+		digsig_preload_start();
+	}
+	digsig_initramfs_trust();
+	return count;
+}
+
+/* The bytes of the MPI at @raw, bit count included, 0 past @size. */
+static size_t digsig_mpi_len(const unsigned char *raw, size_t size)
+{
+	size_t len;
+
+	if (size < 2)
+		return 0;
+	len = 2 + (((raw[0] << 8) | raw[1]) + 7) / 8;
+	return len <= size ? len : 0;
+}
+
+static ssize_t digsig_id_key_store(const char *buff, size_t count)
+{
+	const unsigned char *raw = buff + DIGSIG_KEY_OFFSET + DIGSIG_KEYID_SIZE;
+	size_t n, e, size;
+	int rc;
+
+	if (count <= DIGSIG_KEY_OFFSET + DIGSIG_KEYID_SIZE)
+		return -EINVAL;
+	size = count - DIGSIG_KEY_OFFSET - DIGSIG_KEYID_SIZE;
+
+	/* once enforcing, only a key trusted ones vouch for is taken */
+	if (g_init) {
+		n = digsig_mpi_len(raw, size);
+		e = n ? digsig_mpi_len(raw + n, size - n) : 0;
+		if (!e || n + e == size)
+			return -EINVAL;
+		rc = digsig_verify_buffer((char *)buff, count - (size - n - e),
+					  (char *)raw + n + e, size - n - e);
+		if (rc)
+			return rc;
+		size = n + e;
+	}
+
+	rc = digsig_add_id_key(buff + DIGSIG_KEY_OFFSET, raw, size);
+	if (rc)
+		return rc;
+
+	/* the verdicts kept across boots are bound to the keys loaded */
+	if (digsig_init_key_fingerprint())
+		DSM_ERROR("%s: cannot compute key fingerprint\n", __func__);
+	if (!g_init) {
+		digsig_set_active();
+		digsig_preload_start();
+	}
+	/* the initramfs may be signed with this key */
+	digsig_initramfs_trust();
+	return count;
+}
+
+static ssize_t digsig_id_key_retire(const char *buff, size_t count)
+{
+	int rc;
+
+	if (count != DIGSIG_KEY_OFFSET + DIGSIG_KEYID_SIZE)
+		return -EINVAL;
+
+	rc = digsig_retire_id_key(buff + DIGSIG_KEY_OFFSET);
+	if (rc)
+		return rc;
+	if (digsig_init_key_fingerprint())
+		DSM_ERROR("%s: cannot compute key fingerprint\n", __func__);
+	return count;
+}
+
 static ssize_t
 digsig_key_store(struct kobject *obj, struct attribute *attr, const char *buff, size_t count)
 {
@@ -205,11 +469,17 @@ digsig_key_store(struct kobject *obj, struct attribute *attr, const char *buff,
 
 	switch (buff[0]) {
 	case 'i':
-		total_jiffies = 0;
+		digsig_stats_reset();
 		break;
 	case 'p':
-		printk("total jiffies = %li\n", total_jiffies);
+		digsig_stats_print();
 		break;
+	case 'k':
+		return digsig_ed25519_key_store(buff, count);
+	case 'K':
+		return digsig_id_key_store(buff, count);
+	case 'R':
+		return digsig_id_key_retire(buff, count);
 	}
 
 	/* do not accept to re-initialize the module with
@@ -238,8 +508,16 @@ digsig_key_store(struct kobject *obj, struct attribute *attr, const char *buff,
 
 	digsig_init_pkey(buff[0], raw_public_key, mpi_size);
 
-	if (digsig_public_key[0] && digsig_public_key[1])
-		g_init = 1;
+	if (digsig_public_key[0] && digsig_public_key[1]) {
+		if (digsig_init_key_fingerprint())
+			DSM_ERROR("%s: cannot compute key fingerprint\n", __func__);
+		if (digsig_init_key_context())
+			DSM_PRINT(DEBUG_SIGN, "%s: no Montgomery context for the key\n",
+				  __func__);
+		digsig_set_active();
+		digsig_initramfs_trust();
+		digsig_preload_start();
+	}
 
 	kfree(raw_public_key);
 
@@ -259,16 +537,22 @@ digsig_key_show(struct kobject *obj, struct attribute *attr, char *buff)
 static ssize_t
 digsig_revoked_store(struct kobject *obj, struct attribute *attr, const char *buff, size_t count)
 {
-	if (g_init)
-		return -EPERM;
+	int rc;
 
+	/*
+	 * Revoking only ever denies more, so it is allowed after the key
+	 * is loaded too: lookups run under RCU alongside the update, and
+	 * the verdicts made so far are dropped.
+	 */
 	if (count != DIGSIG_ELF_SIG_SIZE) {
 		DSM_ERROR("digsig_revoked_list_store: Oops - count=%zd, "
 			  "sig size is %d\n", count, DIGSIG_ELF_SIG_SIZE);
 		return -EINVAL;
 	}
 
-	digsig_add_revoked_sig(buff);
+	rc = digsig_add_revoked_sig(buff);
+	if (rc)
+		return rc;
 
 	DSM_PRINT(DEBUG_SIGN, "Added a revoked sig.\n");
 	return count;
@@ -291,3 +575,56 @@ digsig_status_show(struct kobject *obj, struct attribute *attr, char *buff)
 {
 	return scnprintf(buff, PAGE_SIZE, "%s\n", g_init == 0 ? "0" : "1");
 }
+
+/*
+ * callbacks for read/write to /sys/digsig/cache_capacity file
+ */
+static ssize_t
+digsig_cache_capacity_store(struct kobject *obj, struct attribute *attr, const char *buff, size_t count)
+{
+	unsigned long entries;
+	int rc;
+
+	rc = kstrtoul(buff, 0, &entries);
+	if (rc)
+		return rc;
+
+	rc = digsig_cache_set_target(entries);
+	if (rc)
+		return rc;
+
+	return count;
+}
+
+static ssize_t
+digsig_cache_capacity_show(struct kobject *obj, struct attribute *attr, char *buff)
+{
+	unsigned long cur, target;
+
+	digsig_cache_capacity(&cur, &target);
+	return scnprintf(buff, PAGE_SIZE, "%lu %lu\n", cur, target);
+}
+
+static ssize_t
+digsig_policy_show(struct kobject *obj, struct attribute *attr, char *buff)
+{
+	return digsig_sb_rules_show(buff);
+}
+
+static ssize_t
+digsig_policy_store(struct kobject *obj, struct attribute *attr,
+		    const char *buff, size_t count)
+{
+	int rc = digsig_sb_rule_store(buff, count);
+
+	return rc ? rc : count;
+}
+
+static ssize_t
+digsig_bench_store(struct kobject *obj, struct attribute *attr,
+		   const char *buff, size_t count)
+{
+	int rc = digsig_bench_run(buff, count);
+
+	return rc ? rc : count;
+}
@@ -29,4 +29,8 @@ ssize_t digsig_rev_list_show(struct kobject *obj, struct attribute *attr,
 int digsig_init_sysfs(void);
 void digsig_cleanup_sysfs(void);
 
+/* /sys/kernel/security/digsig, for the files that are not sysfs ones */
+extern struct dentry *digsig_securityfs_dir;
+int digsig_init_securityfs(void);
+
 #endif /* _DIGSIG_SYSFS_H */
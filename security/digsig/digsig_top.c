@@ -0,0 +1,225 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file keeps the files whose verification cost the most, so that
+ * those worth stripping, splitting or verifying ahead of use can be
+ * found when boot or a deploy is slow.  Each verification that was not
+ * answered from the cache adds its time and the bytes it hashed to its
+ * file, which is told apart by superblock id and inode number.  Only
+ * the dsi_top_entries most expensive files are kept: a file not in the
+ * table takes the place of the cheapest one when it costs more.
+ *
+ * The table is read from /sys/kernel/security/digsig/top, most
+ * expensive first, one file per line: the total time in nanoseconds,
+ * the bytes hashed, the number of verifications and the path, separated
+ * by tabs.  Writing to the file clears it.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/dcache.h>
+#include <linux/string.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_sb.h"
+#include "digsig_top.h"
+
+/* the end of the path is kept when it is longer */
+#define DIGSIG_TOP_PATH 128
+
+static int dsi_top_entries = 32;
+module_param(dsi_top_entries, int, 0);
+MODULE_PARM_DESC(dsi_top_entries, "Number of most expensive files kept, at most 256.\n");
+
+struct digsig_top_entry {
+	u64 sb_id;
+	unsigned long ino;
+	u64 ns;
+	u64 bytes;
+	u32 count;
+	char path[DIGSIG_TOP_PATH];
+};
+
+static DEFINE_SPINLOCK(digsig_top_lock);
+static struct digsig_top_entry *digsig_top;
+static unsigned int digsig_top_size, digsig_top_used;
+
+/* the cost of the cheapest file kept once the table is full */
+static u64 digsig_top_min;
+
+static void digsig_top_name(struct digsig_top_entry *e, struct file *file)
+{
+	char *p;
+	size_t len;
+
+	p = d_path(&file->f_path, e->path, sizeof(e->path));
+	if (IS_ERR(p)) {
+		/* too long: its name alone */
+		strlcpy(e->path, file->f_dentry->d_name.name, sizeof(e->path));
+		return;
+	}
+	len = strlen(p);
+	memmove(e->path, p, len + 1);
+}
+
+static void digsig_top_update_min(void)
+{
+	unsigned int i;
+	u64 min = ~0ULL;
+
+	for (i = 0; i < digsig_top_used; i++)
+		min = min(min, digsig_top[i].ns);
+	digsig_top_min = digsig_top_used < digsig_top_size ? 0 : min;
+}
+
+/******************************************************************************
+Description : Account a verification that was not answered from the cache.
+Parameters  :
+	@file: the file verified
+	@bytes: the bytes hashed
+	@ns: the time the verification took
+Return value: none
+******************************************************************************/
+void digsig_top_add(struct file *file, u64 bytes, u64 ns)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct digsig_top_entry *e = NULL;
+	unsigned int i;
+	u64 sb_id;
+
+	if (!digsig_top)
+		return;
+	sb_id = digsig_sb_id(inode->i_sb);
+
+	spin_lock(&digsig_top_lock);
+	for (i = 0; i < digsig_top_used; i++)
+		if (digsig_top[i].sb_id == sb_id &&
+		    digsig_top[i].ino == inode->i_ino) {
+			e = &digsig_top[i];
+			break;
+		}
+
+	if (!e) {
+		/* cheaper than the cheapest file kept: not worth a slot */
+		if (ns <= digsig_top_min)
+			goto out;
+		if (digsig_top_used < digsig_top_size) {
+			e = &digsig_top[digsig_top_used++];
+		} else {
+			e = &digsig_top[0];
+			for (i = 1; i < digsig_top_used; i++)
+				if (digsig_top[i].ns < e->ns)
+					e = &digsig_top[i];
+		}
+		e->sb_id = sb_id;
+		e->ino = inode->i_ino;
+		e->ns = e->bytes = 0;
+		e->count = 0;
+		digsig_top_name(e, file);
+	}
+
+	e->ns += ns;
+	e->bytes += bytes;
+	e->count++;
+	digsig_top_update_min();
+out:
+	spin_unlock(&digsig_top_lock);
+}
+
+static int digsig_top_cmp(const void *a, const void *b)
+{
+	const struct digsig_top_entry *x = a, *y = b;
+
+	if (x->ns == y->ns)
+		return 0;
+	return x->ns < y->ns ? 1 : -1;
+}
+
+static int digsig_top_show(struct seq_file *m, void *v)
+{
+	struct digsig_top_entry *copy;
+	unsigned int i, n;
+
+	copy = kmalloc(digsig_top_size * sizeof(*copy), GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+	spin_lock(&digsig_top_lock);
+	n = digsig_top_used;
+	memcpy(copy, digsig_top, n * sizeof(*copy));
+	spin_unlock(&digsig_top_lock);
+
+	sort(copy, n, sizeof(*copy), digsig_top_cmp, NULL);
+	seq_puts(m, "# ns\tbytes\tcount\tpath\n");
+	for (i = 0; i < n; i++)
+		seq_printf(m, "%llu\t%llu\t%u\t%s\n", copy[i].ns,
+			   copy[i].bytes, copy[i].count, copy[i].path);
+	kfree(copy);
+	return 0;
+}
+
+static int digsig_top_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_top_show, NULL);
+}
+
+static ssize_t digsig_top_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	spin_lock(&digsig_top_lock);
+	digsig_top_used = 0;
+	digsig_top_min = 0;
+	spin_unlock(&digsig_top_lock);
+	return count;
+}
+
+static const struct file_operations digsig_top_fops = {
+	.open = digsig_top_open,
+	.read = seq_read,
+	.write = digsig_top_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/top, and start keeping the
+	most expensive files.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_top(void)
+{
+	struct dentry *d;
+	struct digsig_top_entry *top;
+
+	if (dsi_top_entries <= 0)
+		return 0;
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	digsig_top_size = min(dsi_top_entries, 256);
+	top = kcalloc(digsig_top_size, sizeof(*top), GFP_KERNEL);
+	if (!top)
+		return -ENOMEM;
+
+	d = securityfs_create_file("top", 0600, digsig_securityfs_dir, NULL,
+				   &digsig_top_fops);
+	if (IS_ERR(d)) {
+		kfree(top);
+		return PTR_ERR(d);
+	}
+	digsig_top = top;
+	return 0;
+}
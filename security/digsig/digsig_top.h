@@ -0,0 +1,26 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the table of the most expensive verifications.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_TOP_H
+#define _DIGSIG_TOP_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_TOP
+void digsig_top_add(struct file *file, u64 bytes, u64 ns);
+int digsig_init_top(void);
+#else
+#define digsig_top_add(file, bytes, ns) do { } while (0)
+#define digsig_init_top() 0
+#endif
+
+#endif /* _DIGSIG_TOP_H */
@@ -0,0 +1,557 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file verifies the files of a directory tree ahead of their use,
+ * as a container runtime unpacks an image layer and before it starts
+ * the first process from it.  The runtime writes the number of a file
+ * descriptor of the directory to /sys/kernel/security/digsig/tree,
+ * with the filters to apply:
+ *
+ *	<fd> [exec] [elf] [max=<bytes>]
+ *
+ * exec only takes the files with an execute bit set, elf only ELF
+ * executables and shared objects, and max only the files up to that
+ * size.  The write returns once every file taken is verified.
+ *
+ * The tree is walked in parallel: each directory is a task, which
+ * queues a task for each of its subdirectories and another for each of
+ * its files, all verified in bulk, on every CPU, when DigSig has the
+ * bulk engine.  The walk stays on the filesystem of the directory, does
+ * not follow symbolic links, and does not go deeper than
+ * DIGSIG_TREE_DEPTH.  The directories are looked up with the
+ * credentials of the writer.
+ *
+ * Reading the file, from the same open file, also while the write runs,
+ * gives the progress of the last walk: the directories and files seen,
+ * the files verified, failed and skipped by the filters, and the tasks
+ * still pending; then the first files that failed, one per line, the
+ * error and the path.
+ *
+ * With dsi_charge, the tasks are run one after the other by the writer.
+ * With dsi_screen, the RSA signatures of the files are screened in
+ * batches; the files of a batch are counted once it is screened.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/dcache.h>
+#include <linux/security.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/cred.h>
+#include <linux/elf.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/uaccess.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_preload.h"
+#include "digsig_bulk.h"
+#include "digsig_tree.h"
+#include "digsig_ioprio.h"
+#include "digsig_screen.h"
+
+/* the deepest directory walked, below the one written */
+#define DIGSIG_TREE_DEPTH 64
+
+/* room for the lines of the files that failed */
+#define DIGSIG_TREE_ERRORS 4096
+
+/* the longest line of the progress */
+#define DIGSIG_TREE_LINE 128
+
+/*
+ * digsig_tree_walk: one walk, shared by the writer, its tasks and the
+ * readers, and freed by whichever is done with it last.
+ */
+struct digsig_tree_walk {
+	atomic_t refs;
+	atomic_t pending;
+	struct completion done;
+	const struct cred *cred;
+	int exec, elf;
+	loff_t max_size;
+	struct list_head inline_tasks;	/* with dsi_charge */
+	atomic_t dirs, files, verified, failed, skipped;
+	struct digsig_screen *screen;
+	spinlock_t lock;
+	size_t elen;
+	char errors[DIGSIG_TREE_ERRORS];
+};
+
+/* a directory to walk or a file to verify */
+struct digsig_tree_task {
+	struct work_struct work;
+	struct digsig_tree_walk *walk;
+	struct path path;
+	int depth;
+};
+
+/* the entries of a directory, 'type len name\0' each */
+struct digsig_tree_names {
+	struct dir_context ctx;
+	char *buf;
+	size_t len;
+};
+
+/* the walk of an open file, if it started one */
+struct digsig_tree {
+	struct mutex lock;
+	struct digsig_tree_walk *walk;
+};
+
+static void digsig_tree_dir_work(struct work_struct *work);
+
+static void digsig_tree_put(struct digsig_tree_walk *w)
+{
+	if (!atomic_dec_and_test(&w->refs))
+		return;
+	put_cred(w->cred);
+	digsig_screen_free(w->screen);
+	kfree(w);
+}
+
+static void digsig_tree_error(struct digsig_tree_walk *w, struct path *path,
+			      int rc)
+{
+	char *name, *p;
+
+	atomic_inc(&w->failed);
+	name = __getname();
+	if (!name)
+		return;
+	p = d_path(path, name, PATH_MAX);
+	if (!IS_ERR(p)) {
+		spin_lock(&w->lock);
+		if (w->elen + strlen(p) + 16 < sizeof(w->errors))
+			w->elen += scnprintf(w->errors + w->elen,
+					     sizeof(w->errors) - w->elen,
+					     "%d %s\n", rc, p);
+		spin_unlock(&w->lock);
+	}
+	__putname(name);
+}
+
+/* the last task done screens the files left, then wakes the writer */
+static void digsig_tree_pending_dec(struct digsig_tree_walk *w)
+{
+	if (!atomic_dec_and_test(&w->pending))
+		return;
+	digsig_screen_flush(w->screen);
+	complete(&w->done);
+}
+
+static void digsig_tree_end(struct digsig_tree_task *t)
+{
+	struct digsig_tree_walk *w = t->walk;
+
+	path_put(&t->path);
+	kfree(t);
+	digsig_tree_pending_dec(w);
+	digsig_tree_put(w);
+}
+
+/* the verdict of a file whose signature was screened with others */
+static void digsig_tree_screened(struct file *file, int rc, void *data)
+{
+	struct digsig_tree_walk *w = data;
+
+	if (rc)
+		digsig_tree_error(w, &file->f_path, rc);
+	else
+		atomic_inc(&w->verified);
+}
+
+static void digsig_tree_add(struct digsig_tree_walk *w, struct path *path,
+			    int depth, work_func_t func)
+{
+	struct digsig_tree_task *t;
+
+	t = kmalloc(sizeof(*t), GFP_KERNEL);
+	if (!t) {
+		digsig_tree_error(w, path, -ENOMEM);
+		return;
+	}
+	t->walk = w;
+	t->path = *path;
+	path_get(&t->path);
+	t->depth = depth;
+	atomic_inc(&w->pending);
+	atomic_inc(&w->refs);
+	INIT_WORK(&t->work, func);
+
+	if (dsi_charge)
+		list_add_tail(&t->work.entry, &w->inline_tasks);
+	else if (digsig_bulk_queue(&t->work))
+		queue_work(system_unbound_wq, &t->work);
+}
+
+static int digsig_tree_is_elf(struct file *file)
+{
+	struct elfhdr hdr;
+
+	if (kernel_read(file, 0, (char *)&hdr, sizeof(hdr)) != sizeof(hdr))
+		return 0;
+	return !memcmp(hdr.e_ident, ELFMAG, SELFMAG) &&
+	       (hdr.e_type == ET_DYN || hdr.e_type == ET_EXEC);
+}
+
+/* a walk the writer runs itself, with dsi_charge, keeps its priorities */
+static void digsig_tree_prio(struct digsig_prio *p)
+{
+	if (!dsi_charge)
+		digsig_prio_background(p);
+}
+
+static void digsig_tree_prio_restore(struct digsig_prio *p)
+{
+	if (!dsi_charge)
+		digsig_prio_restore(p);
+}
+
+static void digsig_tree_file_work(struct work_struct *work)
+{
+	struct digsig_tree_task *t =
+		container_of(work, struct digsig_tree_task, work);
+	struct digsig_tree_walk *w = t->walk;
+	struct digsig_prio prio;
+	struct file *file;
+	int rc;
+
+	digsig_tree_prio(&prio);
+	file = dentry_open(&t->path, O_RDONLY | O_LARGEFILE, w->cred);
+	if (IS_ERR(file)) {
+		digsig_tree_error(w, &t->path, PTR_ERR(file));
+		goto out;
+	}
+	if (w->elf && !digsig_tree_is_elf(file)) {
+		atomic_inc(&w->skipped);
+	} else {
+		rc = digsig_verify_file_screen(file, w->screen);
+		if (rc < 0)
+			digsig_tree_error(w, &t->path, rc);
+		else if (rc != DIGSIG_SCREEN_QUEUED)
+			atomic_inc(&w->verified);
+	}
+	fput(file);
+out:
+	digsig_tree_prio_restore(&prio);
+	digsig_tree_end(t);
+}
+
+static int digsig_tree_fill(void *ctx, const char *name, int len,
+			    loff_t pos, u64 ino, unsigned int type)
+{
+	struct digsig_tree_names *n = ctx;
+
+	if (type != DT_DIR && type != DT_REG && type != DT_UNKNOWN)
+		return 0;
+	if (len > NAME_MAX || (name[0] == '.' &&
+	    (len == 1 || (len == 2 && name[1] == '.'))))
+		return 0;
+	if (n->len + len + 3 > PAGE_SIZE)
+		return -ENOSPC;
+	n->buf[n->len] = type;
+	n->buf[n->len + 1] = len;
+	memcpy(n->buf + n->len + 2, name, len);
+	n->buf[n->len + 2 + len] = '\0';
+	n->len += len + 3;
+	return 0;
+}
+
+/* Queue what an entry of the directory of T is, if the filters take it. */
+static void digsig_tree_entry(struct digsig_tree_task *t, const char *name,
+			      int len)
+{
+	struct digsig_tree_walk *w = t->walk;
+	struct dentry *parent = t->path.dentry, *d;
+	struct inode *inode;
+	struct path path;
+
+	mutex_lock(&parent->d_inode->i_mutex);
+	d = lookup_one_len(name, parent, len);
+	mutex_unlock(&parent->d_inode->i_mutex);
+	if (IS_ERR(d)) {
+		atomic_inc(&w->failed);
+		return;
+	}
+	inode = d->d_inode;
+	/* the walk stays on the filesystem it started in */
+	if (!inode || d_mountpoint(d))
+		goto out;
+	path.mnt = t->path.mnt;
+	path.dentry = d;
+
+	if (S_ISDIR(inode->i_mode)) {
+		if (t->depth < DIGSIG_TREE_DEPTH)
+			digsig_tree_add(w, &path, t->depth + 1,
+					digsig_tree_dir_work);
+		else
+			digsig_tree_error(w, &path, -ELOOP);
+	} else if (S_ISREG(inode->i_mode)) {
+		atomic_inc(&w->files);
+		if ((w->exec && !(inode->i_mode & S_IXUGO)) ||
+		    (w->max_size && i_size_read(inode) > w->max_size))
+			atomic_inc(&w->skipped);
+		else
+			digsig_tree_add(w, &path, t->depth,
+					digsig_tree_file_work);
+	}
+out:
+	dput(d);
+}
+
+static void digsig_tree_dir_work(struct work_struct *work)
+{
+	struct digsig_tree_task *t =
+		container_of(work, struct digsig_tree_task, work);
+	struct digsig_tree_walk *w = t->walk;
+	struct digsig_tree_names n = { .ctx.actor = digsig_tree_fill };
+	struct digsig_prio prio;
+	const struct cred *old;
+	struct file *dir;
+	char *p;
+	int rc;
+
+	digsig_tree_prio(&prio);
+	n.buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!n.buf) {
+		digsig_tree_error(w, &t->path, -ENOMEM);
+		goto out;
+	}
+	old = override_creds(w->cred);
+	dir = dentry_open(&t->path, O_RDONLY | O_DIRECTORY | O_LARGEFILE,
+			  w->cred);
+	if (IS_ERR(dir)) {
+		digsig_tree_error(w, &t->path, PTR_ERR(dir));
+		goto out_creds;
+	}
+	atomic_inc(&w->dirs);
+
+	/* a page of names at a time, looked up once the directory is let go */
+	for (;;) {
+		n.len = 0;
+		rc = iterate_dir(dir, &n.ctx);
+		if (rc && !n.len)
+			digsig_tree_error(w, &t->path, rc);
+		if (!n.len)
+			break;
+		for (p = n.buf; p < n.buf + n.len; p += (u8)p[1] + 3)
+			digsig_tree_entry(t, p + 2, (u8)p[1]);
+	}
+	fput(dir);
+out_creds:
+	revert_creds(old);
+	free_page((unsigned long)n.buf);
+out:
+	digsig_tree_prio_restore(&prio);
+	digsig_tree_end(t);
+}
+
+static int digsig_tree_parse(char *kbuf, int *fd, struct digsig_tree_walk *w)
+{
+	char *p = kbuf, *tok;
+	int n = 0;
+
+	while ((tok = strsep(&p, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (!n++) {
+			if (kstrtoint(tok, 10, fd) || *fd < 0)
+				return -EINVAL;
+		} else if (!strcmp(tok, "exec")) {
+			w->exec = 1;
+		} else if (!strcmp(tok, "elf")) {
+			w->elf = 1;
+		} else if (!strncmp(tok, "max=", 4)) {
+			if (kstrtoll(tok + 4, 10, &w->max_size) ||
+			    w->max_size < 0)
+				return -EINVAL;
+		} else {
+			return -EINVAL;
+		}
+	}
+	return n ? 0 : -EINVAL;
+}
+
+/* Start the walk of the directory FD at its root. */
+static int digsig_tree_start(struct digsig_tree_walk *w, int fd)
+{
+	struct file *f = fget(fd);
+	struct digsig_tree_task *t;
+	struct list_head *e;
+	int rc;
+
+	if (!f)
+		return -EBADF;
+	if (!S_ISDIR(file_inode(f)->i_mode)) {
+		fput(f);
+		return -ENOTDIR;
+	}
+	atomic_set(&w->pending, 1);
+	digsig_tree_add(w, &f->f_path, 0, digsig_tree_dir_work);
+	fput(f);
+
+	/* with dsi_charge, each task runs here and may queue more */
+	while (!list_empty(&w->inline_tasks)) {
+		e = w->inline_tasks.next;
+		list_del_init(e);
+		t = container_of(e, struct digsig_tree_task, work.entry);
+		t->work.func(&t->work);
+		cond_resched();
+	}
+	digsig_tree_pending_dec(w);
+
+	rc = wait_for_completion_killable(&w->done);
+	return rc ? -EINTR : 0;
+}
+
+static ssize_t digsig_tree_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct digsig_tree *tree = file->private_data;
+	struct digsig_tree_walk *w, *old;
+	char *kbuf;
+	int fd, rc;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+	if (!g_init)
+		return -ENOKEY;
+	kbuf = kmalloc(count + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	if (copy_from_user(kbuf, ubuf, count)) {
+		kfree(kbuf);
+		return -EFAULT;
+	}
+	kbuf[count] = '\0';
+	w = kzalloc(sizeof(*w), GFP_KERNEL);
+	if (!w) {
+		kfree(kbuf);
+		return -ENOMEM;
+	}
+	atomic_set(&w->refs, 1);
+	init_completion(&w->done);
+	spin_lock_init(&w->lock);
+	INIT_LIST_HEAD(&w->inline_tasks);
+	w->cred = get_current_cred();
+	w->screen = digsig_screen_alloc(digsig_tree_screened, w);
+
+	rc = digsig_tree_parse(kbuf, &fd, w);
+	kfree(kbuf);
+	if (rc) {
+		digsig_tree_put(w);
+		return rc;
+	}
+
+	/* the progress read from now on is that of this walk */
+	mutex_lock(&tree->lock);
+	old = tree->walk;
+	atomic_inc(&w->refs);
+	tree->walk = w;
+	mutex_unlock(&tree->lock);
+	if (old)
+		digsig_tree_put(old);
+
+	rc = digsig_tree_start(w, fd);
+	digsig_tree_put(w);
+	return rc ? rc : count;
+}
+
+static ssize_t digsig_tree_read(struct file *file, char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct digsig_tree *tree = file->private_data;
+	struct digsig_tree_walk *w;
+	char *buf;
+	size_t len;
+	ssize_t rc;
+
+	mutex_lock(&tree->lock);
+	w = tree->walk;
+	if (w)
+		atomic_inc(&w->refs);
+	mutex_unlock(&tree->lock);
+	if (!w)
+		return 0;
+
+	buf = kmalloc(DIGSIG_TREE_LINE + DIGSIG_TREE_ERRORS, GFP_KERNEL);
+	if (!buf) {
+		digsig_tree_put(w);
+		return -ENOMEM;
+	}
+	len = scnprintf(buf, DIGSIG_TREE_LINE,
+			"dirs %d files %d verified %d failed %d skipped %d pending %d\n",
+			atomic_read(&w->dirs), atomic_read(&w->files),
+			atomic_read(&w->verified), atomic_read(&w->failed),
+			atomic_read(&w->skipped), atomic_read(&w->pending));
+	spin_lock(&w->lock);
+	memcpy(buf + len, w->errors, w->elen);
+	len += w->elen;
+	spin_unlock(&w->lock);
+
+	rc = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+	kfree(buf);
+	digsig_tree_put(w);
+	return rc;
+}
+
+static int digsig_tree_open(struct inode *inode, struct file *file)
+{
+	struct digsig_tree *tree;
+
+	tree = kzalloc(sizeof(*tree), GFP_KERNEL);
+	if (!tree)
+		return -ENOMEM;
+	mutex_init(&tree->lock);
+	file->private_data = tree;
+	return 0;
+}
+
+static int digsig_tree_release(struct inode *inode, struct file *file)
+{
+	struct digsig_tree *tree = file->private_data;
+
+	if (tree->walk)
+		digsig_tree_put(tree->walk);
+	kfree(tree);
+	return 0;
+}
+
+static const struct file_operations digsig_tree_fops = {
+	.open = digsig_tree_open,
+	.read = digsig_tree_read,
+	.write = digsig_tree_write,
+	.release = digsig_tree_release,
+	.llseek = generic_file_llseek,
+};
+
+/******************************************************************************
+Description : Create /sys/kernel/security/digsig/tree.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without it
+******************************************************************************/
+int __init digsig_init_tree(void)
+{
+	struct dentry *d;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	d = securityfs_create_file("tree", 0600, digsig_securityfs_dir,
+				   NULL, &digsig_tree_fops);
+	return IS_ERR(d) ? PTR_ERR(d) : 0;
+}
@@ -19,13 +19,35 @@
 #include <linux/string.h>
 #include <linux/mm.h>
 #include <linux/highmem.h>
+#include <linux/pagemap.h>
 #include <linux/crypto.h>
+#include <crypto/hash.h>
 #include <linux/err.h>
-#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/cache.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/moduleparam.h>
+#include <asm/unaligned.h>
 
 #include "digsig_common.h"
 #include "digsig_verify.h"
 #include "gnupg/cipher/rsa-verify.h"
+#include "digsig_keyring.h"
+#include "digsig_inode.h"
+#include "digsig_cache.h"
+#include "digsig_memo.h"
+#include "digsig_engine.h"
+#include "digsig_chunk.h"
+#include "digsig_builtin_mont.h"
+#include "digsig_ioprio.h"
 
 /*
  * Public key format: 2 MPIs
@@ -35,88 +57,459 @@
  * n bytes: MPI (ie. 0x29)
  */
 
-#define TVMEMSIZE	4096
-
-int gDigestLength[] = { /* SHA-1 */ 0x14 };
-static struct crypto_hash *sha1_tfm;
 MPI digsig_public_key[] = {MPI_NULL, MPI_NULL};
 
+/*
+ * What verifications need from a public key, derived once when it is
+ * loaded and read-only once it is in use, like the key itself.
+ */
+struct digsig_key_ctx {
+	MPI *pkey;			/* n and e */
+	unsigned int nbits;		/* of the modulus, for the frame */
+	MPI_MONT_CTX mont;		/* NULL: use plain mpi_powm() */
+	unsigned int ws_limbs;		/* SIGCTX workspace for mont */
+};
+
+/* the key loaded as 'n' and 'e', for signatures of no other key ID */
+static struct digsig_key_ctx digsig_key = { .pkey = digsig_public_key };
+unsigned char digsig_key_fpr[SHA1_DIGEST_LENGTH];
+/* set once digsig_key_fpr is that of the keys loaded */
+int digsig_key_fpr_ready;
+/* serializes the updates of digsig_key_fpr */
+static DEFINE_MUTEX(digsig_key_fpr_mutex);
+
+/*
+ * The keys added by key ID, in an open addressed table: key IDs are the
+ * low bits of a SHA-1, so their last bytes pick the slot.  Verifiers
+ * look keys up under RCU and hold a reference while they use one; a
+ * retired key leaves a tombstone in its slot, so that the keys probed
+ * past it are still found, and is freed after the last verification
+ * with it.
+ *
+ * A verdict made with a key is tagged with the key's slot and the
+ * epoch of the slot at the time; retiring the key moves the epoch on,
+ * so its verdicts, and only those, no longer stand.
+ */
+#define DIGSIG_KEYS_MAX 64
+#define DIGSIG_KEYS_SLOTS (2 * DIGSIG_KEYS_MAX)
+#define DIGSIG_KEY_TAG(slot, epoch) (((epoch) << 8) | ((slot) + 1))
+
+struct digsig_id_key {
+	struct digsig_key_ctx ctx;
+	MPI mpi[2];
+	u8 keyid[DIGSIG_KEYID_SIZE];
+	u32 tag;			/* of the verdicts made with it */
+	atomic_t refs;			/* the table's and the verifiers' */
+	struct rcu_head rcu;
+};
+
+static struct digsig_id_key __rcu *digsig_id_keys[DIGSIG_KEYS_SLOTS];
+static u32 digsig_id_key_epoch[DIGSIG_KEYS_SLOTS];
+static DEFINE_MUTEX(digsig_id_keys_mutex);
+static unsigned int digsig_id_keys_count;
+
+/* in a slot whose key was retired */
+static struct digsig_id_key digsig_id_key_gone;
+
+static int dsi_rsa_overlap = 16384;
+module_param(dsi_rsa_overlap, int, 0644);
+MODULE_PARM_DESC(dsi_rsa_overlap, "Raise the signature of a file of at least this many bytes to e on another CPU while it is hashed, 0 for never.\n");
+
 
 /******************************************************************************
                              Internal functions
 ******************************************************************************/
 
 static int
-digsig_rsa_bsign_verify(unsigned char *sha_cat, int length,
-			unsigned char *signed_hash);
+digsig_rsa_bsign_verify(SIGCTX *ctx, unsigned char *sha_cat, int length,
+			unsigned char *signed_hash, int siglen);
+
+static int
+digsig_ed25519_bsign_verify(SIGCTX *ctx, unsigned char *hash, int length,
+			    unsigned char *packet, int packet_len);
 
-static int digsig_sha1_init(SIGCTX *ctx);
+static int digsig_hash_init(SIGCTX *ctx);
+static int digsig_hash_digest(SIGCTX *ctx, unsigned char *buf, int buflen,
+			      unsigned char *digest);
 
-static void digsig_sha1_update(SIGCTX *ctx, char *buf, int buflen);
+static void digsig_hash_update(SIGCTX *ctx, char *buf, int buflen);
 
-static int digsig_sha1_final(SIGCTX *ctx, char *digest);
+static int digsig_hash_final(SIGCTX *ctx, char *digest);
 
+static int digsig_rsa_early_wait(SIGCTX *ctx);
 
-/******************************************************************************
-Description :
-Parameters  :
-  hashalgo the identifier of the hash algorithm to use (HASH_SHA1 for instance)
-  signalgo sign algorithm identifier. Ex. SIGN_RSA
-Return value: a signature context valid for this signature only
-******************************************************************************/
+/* memcmp() that takes the same time wherever the buffers differ */
+static int digsig_memneq(const u8 *a, const u8 *b, size_t n)
+{
+	u8 diff = 0;
+
+	while (n--)
+		diff |= *a++ ^ *b++;
+	return diff != 0;
+}
+
+/* DER encoded DigestInfo prefixes of the PKCS#1 v1.5 signature frame */
+static const byte digsig_asn_sha1[] = /* Object ID is 1.3.14.3.2.26 */
+	{ 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03,
+	  0x02, 0x1a, 0x05, 0x00, 0x04, 0x14 };
+static const byte digsig_asn_sha256[] = /* Object ID is 2.16.840.1.101.3.4.2.1 */
+	{ 0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+	  0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+static const byte digsig_asn_sha512[] = /* Object ID is 2.16.840.1.101.3.4.2.3 */
+	{ 0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+	  0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40 };
+static const byte digsig_asn_blake2b[] = /* Object ID is 1.3.6.1.4.1.1722.12.2.1.16 */
+	{ 0x30, 0x53, 0x30, 0x0f, 0x06, 0x0b, 0x2b, 0x06, 0x01, 0x04, 0x01,
+	  0x8d, 0x3a, 0x0c, 0x02, 0x01, 0x10, 0x05, 0x00, 0x04, 0x40 };
+
+/*
+ * digsig_hash_algo: how each supported hash algorithm is named by the
+ * crypto API, with the DigestInfo of its RSA frame; the bsign greeting
+ * and the GPG number are in digsig_format.c.  The crypto API hands out
+ * the fastest registered implementation of the name, so arch-optimized
+ * drivers are used when they are available.
+ */
+static const struct digsig_hash_algo {
+	const char *name;
+	const byte *asn;
+	unsigned int asn_len;
+} digsig_hash_algos[DIGSIG_HASH_ALGOS] = {
+	[HASH_SHA1] = { "sha1", digsig_asn_sha1, sizeof(digsig_asn_sha1) },
+	[HASH_SHA256] = { "sha256", digsig_asn_sha256,
+			  sizeof(digsig_asn_sha256) },
+	[HASH_SHA512] = { "sha512", digsig_asn_sha512,
+			  sizeof(digsig_asn_sha512) },
+	[HASH_BLAKE2B] = { "blake2b-512", digsig_asn_blake2b,
+			   sizeof(digsig_asn_blake2b) },
+};
+
+/* the crypto API name of a hash algorithm */
+const char *digsig_hash_name(int algo)
+{
+	return digsig_hash_algos[algo].name;
+}
+
+/*
+ * Pool of verification contexts.  Contexts are created on demand and
+ * returned to the pool after use; the pool keeps up to two per CPU,
+ * which is more than the number of verifications that usually run at
+ * the same time.
+ *
+ * Each CPU keeps the context it last released in digsig_ctx_cpu, so
+ * that a verification usually reuses a context, and hash descriptors,
+ * whose cache lines are already local, without taking digsig_ctx_lock.
+ */
+static LIST_HEAD(digsig_ctx_pool);
+static DEFINE_SPINLOCK(digsig_ctx_lock);
+static unsigned int digsig_ctx_pooled;
+static DEFINE_PER_CPU(SIGCTX *, digsig_ctx_cpu);
+
+#define DIGSIG_CTX_POOL_MAX (2 * num_possible_cpus())
+
+/*
+ * shash transforms keep no per-request state, so one transform of each
+ * algorithm is shared by all contexts, and only read once allocated.
+ * They are allocated at init, or on first use if that failed, and kept
+ * for the lifetime of the system.
+ */
+static struct crypto_shash *digsig_shash[DIGSIG_HASH_ALGOS];
+
+struct crypto_shash *digsig_get_shash(int algo)
+{
+	struct crypto_shash *tfm, *old;
+
+	tfm = ACCESS_ONCE(digsig_shash[algo]);
+	if (tfm) {
+		smp_read_barrier_depends();
+		return tfm;
+	}
+
+	tfm = crypto_alloc_shash(digsig_hash_algos[algo].name, 0, 0);
+	if (IS_ERR(tfm))
+		return tfm;
+
+	old = cmpxchg(&digsig_shash[algo], NULL, tfm);
+	if (old) {
+		crypto_free_shash(tfm);
+		tfm = old;
+	}
+	return tfm;
+}
+
+/*
+ * Hash with tfm from now on.  The transform it replaces is not freed:
+ * the descriptors of the contexts move to the new one when they start
+ * a hash, and never in flight.
+ */
+void digsig_set_shash(int algo, struct crypto_shash *tfm)
+{
+	smp_wmb();
+	ACCESS_ONCE(digsig_shash[algo]) = tfm;
+}
+
+static void digsig_ctx_free(SIGCTX *ctx)
+{
+	int i;
+
+	for (i = 0; i < DIGSIG_HASH_ALGOS; i++)
+		kfree(ctx->descs[i]);
+	kfree(ctx->share_desc);
+	kfree(ctx->key_ws);
+	mpi_free(ctx->key_res);
+	mpi_free(ctx->sig_mpi);
+	kfree(ctx);
+}
+
+/*
+ * Size the context's RSA result, and its Montgomery workspace if the key
+ * has a Montgomery context, for the key.  Keys do not change once
+ * loaded, so this allocates once per context, and again only for a key
+ * larger than any it verified with before.
+ */
+static int digsig_ctx_key_ws(SIGCTX *ctx, struct digsig_key_ctx *key)
+{
+	mpi_limb_t *ws;
+
+	if (!ctx->key_res) {
+		ctx->key_res = mpi_alloc(mpi_get_nlimbs(key->pkey[0]));
+		if (!ctx->key_res)
+			return -ENOMEM;
+	}
+	if (key->mont && ctx->key_ws_limbs < key->ws_limbs) {
+		ws = kmalloc(key->ws_limbs * sizeof(mpi_limb_t), GFP_KERNEL);
+		if (!ws)
+			return -ENOMEM;
+		kfree(ctx->key_ws);
+		ctx->key_ws = ws;
+		ctx->key_ws_limbs = key->ws_limbs;
+	}
+	return 0;
+}
 
-SIGCTX *digsig_sign_verify_init(int hashalgo, int signalgo)
+/* s^e mod n of the context's signature, with mont if it is not NULL */
+static void digsig_rsa_public(SIGCTX *ctx, MPI res, struct digsig_key_ctx *key,
+			      MPI_MONT_CTX mont)
+{
+	if (!mont || digsig_builtin_powm(res, ctx->sig_mpi, mont, ctx->key_ws))
+		rsa_public_mont(res, ctx->sig_mpi, key->pkey, mont,
+				ctx->key_ws);
+}
+
+static SIGCTX *digsig_ctx_alloc(void)
 {
 	SIGCTX *ctx;
 
-	/* allocating signature context */
-	ctx = kmalloc(sizeof(SIGCTX), GFP_KERNEL);
+	ctx = kzalloc(sizeof(SIGCTX), GFP_KERNEL);
 	if (!ctx) {
 		DSM_ERROR("Cannot allocate ctx\n");
-		goto err;
+		return NULL;
 	}
+	INIT_LIST_HEAD(&ctx->pool);
+	init_completion(&ctx->rsa_done);
 
-	ctx->tvmem = kmalloc(TVMEMSIZE, GFP_KERNEL);
-	if (!ctx->tvmem) {
-		DSM_ERROR("Cannot allocate plaintext buffer\n");
+	ctx->sig_mpi = mpi_alloc(DIGSIG_SIG_MPI_LIMBS);
+	if (!ctx->sig_mpi)
+		goto err;
+
+	/*
+	 * The running hash state lives in a descriptor per context and
+	 * algorithm.  The SHA-1 one is needed by every verification; the
+	 * others are allocated on first use.
+	 */
+	ctx->digestAlgo = HASH_SHA1;
+	if (digsig_hash_init(ctx)) {
+		DSM_ERROR("tfm allocation failed\n");
 		goto err;
 	}
 
+	return ctx;
+
+err:
+	digsig_ctx_free(ctx);
+	return NULL;
+}
+
+/******************************************************************************
+Description : Get a verification context, from the pool if one is free.
+Parameters  : none
+Return value: a context to pass to digsig_sign_verify_release(), or NULL
+******************************************************************************/
+SIGCTX *digsig_sign_verify_get(void)
+{
+	SIGCTX *ctx;
+
+	ctx = this_cpu_xchg(digsig_ctx_cpu, NULL);
+	if (ctx) {
+		ctx->sig_mpi_src = NULL;
+		ctx->screen = 0;
+		return ctx;
+	}
+
+	spin_lock(&digsig_ctx_lock);
+	if (!list_empty(&digsig_ctx_pool)) {
+		ctx = list_first_entry(&digsig_ctx_pool, SIGCTX, pool);
+		list_del_init(&ctx->pool);
+		digsig_ctx_pooled--;
+	}
+	spin_unlock(&digsig_ctx_lock);
+
+	if (!ctx) {
+		ctx = digsig_ctx_alloc();
+	} else {
+		ctx->sig_mpi_src = NULL;
+		ctx->screen = 0;
+	}
+
+	return ctx;
+}
+
+/******************************************************************************
+Description : Decode the signature MPI of an RSA packet into the
+	context's own MPI, which has room for any signature a section can
+	hold.  Nothing is allocated, and a packet already decoded is not
+	decoded again.
+Parameters  :
+  ctx the verification context
+  packet the GPG signature packet, packet_len its size
+Return value: 0 on success, -EINVAL for a malformed MPI
+******************************************************************************/
+int digsig_decode_signature(SIGCTX *ctx, unsigned char *packet, int packet_len)
+{
+	unsigned nread;
+
+	if (ctx->sig_mpi_src == packet)
+		return 0;
+
+	/* sig_mpi may still be raised for another packet */
+	digsig_rsa_early_wait(ctx);
+	ctx->sig_mpi_src = NULL;
+	if (packet_len <= DIGSIG_RSA_DATA_OFFSET)
+		return -EINVAL;
+
+	nread = packet_len - DIGSIG_RSA_DATA_OFFSET;
+	if (mpi_read_from_buffer_fixed(ctx->sig_mpi,
+				       packet + DIGSIG_RSA_DATA_OFFSET, &nread))
+		return -EINVAL;
+
+	ctx->sig_mpi_src = packet;
+	return 0;
+}
+
+/******************************************************************************
+Description : Start a signature verification in a context.
+Parameters  :
+  ctx a context from digsig_sign_verify_get()
+  hashalgo the identifier of the hash algorithm to use (HASH_SHA1 for instance)
+  signalgo sign algorithm identifier. Ex. SIGN_RSA
+Return value: 0 on success, -EINVAL for an unknown algorithm
+******************************************************************************/
+int digsig_sign_verify_init(SIGCTX *ctx, int hashalgo, int signalgo)
+{
 	/* checking hash algorithm is known */
-	switch (hashalgo) {
-	case HASH_SHA1:
-		if (digsig_sha1_init(ctx)) {
-			DSM_ERROR("Initializing SHA1 failed\n");
-			goto err;
-		}
-		break;
-	default:
+	if (hashalgo < 0 || hashalgo >= DIGSIG_HASH_ALGOS) {
 		DSM_ERROR("Unknown hash algo\n");
-		goto err;
+		return -EINVAL;
+	}
+	ctx->digestAlgo = hashalgo;
+	ctx->digest_done = 0;
+	ctx->share = 0;
+	if (digsig_hash_init(ctx)) {
+		DSM_ERROR("Initializing %s failed\n",
+			  digsig_hash_algos[hashalgo].name);
+		return -EINVAL;
 	}
 
 	/* checking sign algo is known */
 	switch (signalgo) {
 	case SIGN_RSA:
+	case SIGN_ED25519:
 		break;
 	default:
 		DSM_ERROR("Unknown sign algo\n");
-		goto err;
+		return -EINVAL;
 	}
-	ctx->digestAlgo = hashalgo;
 	ctx->signAlgo = signalgo;
-	return ctx;
+	return 0;
+}
 
-err:
-	if (ctx) {
-		kfree(ctx->tvmem);
-		kfree(ctx);
+/******************************************************************************
+Description : Give a verification context back to the pool.
+Parameters  :
+  ctx context returned by digsig_sign_verify_get(), may be NULL
+Return value: none
+******************************************************************************/
+void digsig_sign_verify_release(SIGCTX *ctx)
+{
+	if (!ctx)
+		return;
+
+	/* the result was not needed, but the worker still uses the context */
+	digsig_rsa_early_wait(ctx);
+	if (ctx->meta_page) {
+		page_cache_release(ctx->meta_page);
+		ctx->meta_page = NULL;
 	}
-	return NULL;
+	/* a signature left for a batch that did not take it */
+	if (ctx->screened) {
+		digsig_screen_sig_free(&ctx->screen_sig);
+		ctx->screened = 0;
+	}
+
+	/* keep this one on the CPU, the one it replaces goes to the pool */
+	ctx = this_cpu_xchg(digsig_ctx_cpu, ctx);
+	if (!ctx)
+		return;
+
+	spin_lock(&digsig_ctx_lock);
+	if (digsig_ctx_pooled < DIGSIG_CTX_POOL_MAX) {
+		list_add(&ctx->pool, &digsig_ctx_pool);
+		digsig_ctx_pooled++;
+		ctx = NULL;
+	}
+	spin_unlock(&digsig_ctx_lock);
+
+	if (ctx)
+		digsig_ctx_free(ctx);
 }
 
 /******************************************************************************
-Description :
+Description : Create the MPI cache, allocate the hash transforms, and give
+	each online CPU a context, so that the first verifications after
+	boot do not allocate either.
+Parameters  : none
+Return value: 0; what could not be allocated now is allocated on demand
+******************************************************************************/
+int __init digsig_init_verify(void)
+{
+	unsigned int i, cpu;
+	SIGCTX *ctx;
+
+	/* before the contexts, which hold MPIs of their own */
+	if (mpi_init_pool())
+		DSM_ERROR("%s: no MPI cache\n", __func__);
+
+	for (i = 0; i < DIGSIG_HASH_ALGOS; i++)
+		if (IS_ERR(digsig_get_shash(i)))
+			DSM_ERROR("%s: no %s transform yet\n", __func__,
+				  digsig_hash_algos[i].name);
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		ctx = digsig_ctx_alloc();
+		if (!ctx)
+			break;
+		per_cpu(digsig_ctx_cpu, cpu) = ctx;
+		i++;
+	}
+
+	DSM_PRINT(DEBUG_INIT, "%s: %u verification contexts preallocated\n",
+		  __func__, i);
+	return 0;
+}
+
+/******************************************************************************
+Description : Hash data in place; buf may be any kernel mapping, such as a
+	kmap()ed page cache page.
 Parameters  :
   ctx
   buf data to sign (part of a bigger buffer)
@@ -128,16 +521,7 @@ int digsig_sign_verify_update(SIGCTX *ctx, char *buf, int buflen)
 	if (ctx == NULL)
 		return -EINVAL;
 
-	switch (ctx->digestAlgo) {
-	case HASH_SHA1:
-		digsig_sha1_update(ctx, buf, buflen);
-		break;
-	default:
-		DSM_ERROR("%s: Unknown hash algo\n", __func__);
-		return -EINVAL;
-	}
-
-	return 0;
+	return crypto_shash_update(ctx->desc, buf, buflen);
 }
 
 /******************************************************************************
@@ -149,59 +533,150 @@ int
 digsig_sign_verify_final(SIGCTX *ctx, int siglen /* PublicKey */ ,
 		      unsigned char *signed_hash)
 {
-	char *digest;
-	int rc = -ENOMEM;
+	u8 memo[DIGSIG_MEMO_KEY_SIZE];
+	int rc, memo_rc;
 
-	digest = kmalloc(gDigestLength[ctx->digestAlgo], DIGSIG_SAFE_ALLOC);
-	if (!digest) {
-		DSM_ERROR("kmalloc failed in %s for digest\n", __func__);
-		goto err;
-	}
 	/* TO DO: check the length of the signature: it should be equal to the length
 	   of the modulus */
-	if ((rc = digsig_sha1_final(ctx, digest)) < 0) {
+	if (!ctx->digest_done &&
+	    (rc = digsig_hash_final(ctx, ctx->digest)) < 0) {
 		DSM_ERROR
 		    ("%s: Cannot finalize hash algorithm\n", __func__);
-		goto err;
+		return rc;
 	}
 
-	rc = -EINVAL;
-	if (siglen < gDigestLength[ctx->digestAlgo])
-		goto err;
+	if (siglen < gDigestLength[digsig_ctx_hash(ctx)])
+		return -EINVAL;
 
-	switch (ctx->digestAlgo) {
+	/* another copy of the file was verified with the same signature */
+	memo_rc = digsig_memo_lookup(ctx, signed_hash, siglen, memo);
+	if (memo_rc > 0)
+		return 0;
+
+	rc = -EINVAL;
+	switch (digsig_ctx_sign(ctx)) {
 	case SIGN_RSA:
-		rc = digsig_rsa_bsign_verify(digest,
-					  gDigestLength[ctx->digestAlgo],
-					  signed_hash);
+		rc = digsig_rsa_bsign_verify(ctx, ctx->digest,
+					  gDigestLength[digsig_ctx_hash(ctx)],
+					  signed_hash, siglen);
+		break;
+	case SIGN_ED25519:
+		rc = digsig_ed25519_bsign_verify(ctx, ctx->digest,
+					  gDigestLength[digsig_ctx_hash(ctx)],
+					  signed_hash, siglen);
 		break;
 	default:
 		DSM_ERROR
 		    ("Unsupported cipher algorithm in binary digital signature verification\n");
 	}
 
-	/* free everything */
-	/* do not free SHA1-TFM. For optimization, we choose always to use the same one */
-err:
-	kfree(digest);
+	/* a screened signature is not known to be valid by itself */
+	if (!rc && !memo_rc && !ctx->screened)
+		digsig_memo_insert(ctx, memo);
 	return rc;
 }
 
 /******************************************************************************
-Description :
-   Call this only at the end of the whole program when you do not want to use
-   signature verification again.
+Description : Screen signatures of the key loaded as 'n' and 'e': the
+	product of the signatures, raised to e, must be the product of
+	their frames, mod n.  That is one exponentiation and two
+	multiplications per signature, where verifying them one by one takes
+	an exponentiation each.  A batch that passes says that the key
+	signed each of the frames, not that each signature is the one it
+	would have made: the signatures could be multiplied by inverse
+	factors and still pass.
 Parameters  :
-Return value:
+  sigs the signatures and their frames, from digsig_rsa_screen_keep()
+  n their number, at least 1; for 1 this is the usual verification
+Return value: 0 if the batch passes, -EPERM if it does not, -ENOMEM
 ******************************************************************************/
-void digsig_sign_verify_free(void)
+int digsig_rsa_screen(struct digsig_screen_sig *sigs, int n)
 {
-	if (sha1_tfm) {
-		crypto_free_hash(sha1_tfm);
-		sha1_tfm = NULL;
+	struct digsig_key_ctx *key = &digsig_key;
+	MPI mod = key->pkey[0];
+	MPI ps = NULL, pm = NULL, tmp = NULL;
+	SIGCTX *ctx;
+	int i, rc = -ENOMEM;
+
+	if (!mod || !key->pkey[1])
+		return -EPERM;
+	ctx = digsig_sign_verify_get();
+	if (!ctx)
+		return -ENOMEM;
+	ps = mpi_copy(sigs[0].s);
+	pm = mpi_copy(sigs[0].m);
+	tmp = mpi_alloc(2 * mpi_get_nlimbs(mod) + 1);
+	if (!ps || !pm || !tmp || digsig_ctx_key_ws(ctx, key))
+		goto out;
+
+	/* the products go through tmp, which neither operand is */
+	for (i = 1; i < n; i++) {
+		mpi_mul(tmp, ps, sigs[i].s);
+		mpi_fdiv_r(ps, tmp, mod);
+		mpi_mul(tmp, pm, sigs[i].m);
+		mpi_fdiv_r(pm, tmp, mod);
 	}
-	/* this might cause unpredictable behavior if structures are refering to this,
-	   their pointer might suddenly become NULL, might need a usage count associated */
+
+	/* raised where the signature of a verification is */
+	ctx->sig_mpi_src = NULL;
+	mpi_set(ctx->sig_mpi, ps);
+	digsig_rsa_public(ctx, ctx->key_res, key, key->mont);
+	rc = mpi_cmp(ctx->key_res, pm) ? -EPERM : 0;
+out:
+	mpi_free(tmp);
+	mpi_free(pm);
+	mpi_free(ps);
+	digsig_sign_verify_release(ctx);
+	return rc;
+}
+
+/******************************************************************************
+Description : Free a signature kept for screening.
+Parameters  :
+  sig the signature, whose MPIs may be NULL
+Return value: none
+******************************************************************************/
+void digsig_screen_sig_free(struct digsig_screen_sig *sig)
+{
+	mpi_free(sig->s);
+	mpi_free(sig->m);
+	sig->s = sig->m = NULL;
+}
+
+/******************************************************************************
+Description :
+   Verify a signature section, as bsign makes them for ELF files, over a
+   buffer rather than a file: for the lists and roots DigSig is given
+   at runtime.
+Parameters  :
+  data, len the signed bytes
+  sig, sig_size the signature section
+Return value: 0 if the signature is valid, -ENOKEY if no key is loaded,
+	-EINVAL if the section can not be parsed, -EPERM otherwise
+******************************************************************************/
+int digsig_verify_buffer(char *data, int len, char *sig, int sig_size)
+{
+	struct digsig_sig_info info;
+	SIGCTX *ctx;
+	int rc;
+
+	if (!g_init)
+		return -ENOKEY;
+	if (digsig_parse_signature(sig, sig_size, &info))
+		return -EINVAL;
+
+	ctx = digsig_sign_verify_get();
+	if (!ctx)
+		return -ENOMEM;
+	rc = digsig_sign_verify_init(ctx, info.hashalgo, info.signalgo);
+	if (!rc)
+		rc = digsig_sign_verify_update(ctx, data, len);
+	if (!rc)
+		rc = digsig_sign_verify_final(ctx, info.packet_len,
+					      info.packet);
+	digsig_sign_verify_release(ctx);
+
+	return rc ? -EPERM : 0;
 }
 
 /******************************************************************************
@@ -222,168 +697,870 @@ int digsig_init_pkey(const char read_par, unsigned char *raw_public_key, int mpi
 		nread = mpi_size;
 		digsig_public_key[0] =
 			mpi_read_from_buffer(raw_public_key, &nread, 0);
+		/* normalize now so that verifiers never write to the key */
+		if (digsig_public_key[0])
+			mpi_normalize(digsig_public_key[0]);
 		break;
 	case 'e':
 		DSM_PRINT(DEBUG_SIGN, "Reading raw_public_key_e!\n");
 		nread = mpi_size;
 		digsig_public_key[1] =
 			mpi_read_from_buffer(raw_public_key, &nread, 0);
+		if (digsig_public_key[1])
+			mpi_normalize(digsig_public_key[1]);
 		break;
 	}
 
 	return 0;
 }
 
+static int digsig_hash_mpi(SIGCTX *ctx, MPI a)
+{
+	unsigned nbytes;
+	byte *buf;
+
+	buf = mpi_get_buffer(a, &nbytes, NULL);
+	if (!buf)
+		return -ENOMEM;
+	digsig_hash_update(ctx, buf, nbytes);
+	kfree(buf);
+	return 0;
+}
+
+/*
+ * Hash the keys added by key ID, each as its key ID, n and e, in key ID
+ * order: the fingerprint does not depend on the order they were added
+ * in, nor on the slots they took.
+ */
+static int digsig_hash_id_keys(SIGCTX *ctx)
+{
+	struct digsig_id_key *k, *next;
+	const u8 *last = NULL;
+	int i, rc = 0;
+
+	mutex_lock(&digsig_id_keys_mutex);
+	for (;;) {
+		next = NULL;
+		for (i = 0; i < DIGSIG_KEYS_SLOTS; i++) {
+			k = rcu_dereference_protected(digsig_id_keys[i],
+				lockdep_is_held(&digsig_id_keys_mutex));
+			if (!k || k == &digsig_id_key_gone ||
+			    (last && memcmp(k->keyid, last,
+					    DIGSIG_KEYID_SIZE) <= 0))
+				continue;
+			if (!next || memcmp(k->keyid, next->keyid,
+					    DIGSIG_KEYID_SIZE) < 0)
+				next = k;
+		}
+		if (!next)
+			break;
+		digsig_hash_update(ctx, (char *)next->keyid,
+				   DIGSIG_KEYID_SIZE);
+		rc = digsig_hash_mpi(ctx, next->mpi[0]) ?:
+		     digsig_hash_mpi(ctx, next->mpi[1]);
+		if (rc)
+			break;
+		last = next->keyid;
+	}
+	mutex_unlock(&digsig_id_keys_mutex);
+	return rc;
+}
+
 /******************************************************************************
 Description :
-   Performs RSA verification of signature contained in binary
+   Compute digsig_key_fpr, the SHA-1 of the loaded public keys (n then e,
+   then the Ed25519 key, then the keys added by key ID).  Called whenever
+   a key is complete, added or retired.
 Parameters  :
-Return value: 0 - RSA signature is valid
-              1 - RSA signature is invalid
-              -1 - an error occured
+Return value: 0 on success, negative on failure; digsig_key_fpr_ready is
+   clear then, and the caches kept across boots are not used
 ******************************************************************************/
 
-static int digsig_rsa_bsign_verify(unsigned char *hash_format, int length,
-				   unsigned char *signed_hash)
+int digsig_init_key_fingerprint(void)
 {
-	int rc = 0, cmp;
-	MPI hash, data;
-	unsigned nread = DIGSIG_ELF_SIG_SIZE;
-	int nframe;
-	unsigned char sig_class;
-	unsigned char sig_timestamp[SIZEOF_UNSIGNED_INT];
-	int i;
-	SIGCTX *ctx = NULL;
-	unsigned char *new_sig;
+	u8 fpr[SHA1_DIGEST_LENGTH];
+	SIGCTX *ctx;
+	int i, rc = -ENOMEM;
+
+	mutex_lock(&digsig_key_fpr_mutex);
+	ACCESS_ONCE(digsig_key_fpr_ready) = 0;
+	ctx = digsig_sign_verify_get();
+	if (!ctx)
+		goto unlock;
+	if (digsig_sign_verify_init(ctx, HASH_SHA1, SIGN_RSA)) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < 2 && digsig_public_key[i]; i++) {
+		rc = digsig_hash_mpi(ctx, digsig_public_key[i]);
+		if (rc)
+			goto out;
+	}
+	if (digsig_ed25519_key(NULL))
+		digsig_hash_update(ctx, (char *)digsig_ed25519_key(NULL),
+				   ED25519_KEY_SIZE);
+	rc = digsig_hash_id_keys(ctx);
+	if (rc)
+		goto out;
+
+	rc = digsig_hash_final(ctx, fpr);
+	if (!rc) {
+		memcpy(digsig_key_fpr, fpr, sizeof(fpr));
+		smp_wmb();
+		ACCESS_ONCE(digsig_key_fpr_ready) = 1;
+	}
+out:
+	digsig_sign_verify_release(ctx);
+unlock:
+	mutex_unlock(&digsig_key_fpr_mutex);
+	return rc;
+}
+
+/******************************************************************************
+Description :
+   Precompute what the verifications need from the loaded public key:
+   its bit length and the Montgomery constants of its modulus.  Called
+   once both MPIs have been read (and normalized), before g_init is set.
+Parameters  :
+Return value: 0 on success, negative on failure; verification then
+   falls back to plain mpi_powm()
+******************************************************************************/
 
-	new_sig = kmalloc(gDigestLength[HASH_SHA1], DIGSIG_SAFE_ALLOC);
-	if (!new_sig) {
-		DSM_ERROR("kmalloc failed in %s for new_sig\n", __func__);
+static int digsig_key_ctx_init(struct digsig_key_ctx *key)
+{
+	mpi_mont_free(key->mont);
+
+	key->nbits = mpi_get_nbits(key->pkey[0]);
+#ifdef CONFIG_SECURITY_DIGSIG_ONLY_RSA2048_SHA256
+	if (key->nbits != DIGSIG_FIXED_RSA_BITS)
+		DSM_ERROR("%s: a %u bit key verifies nothing in this build\n",
+			  __func__, key->nbits);
+#endif
+	/* the built-in key has its constants from the build */
+	key->mont = digsig_builtin_mont_ctx(key->pkey);
+	if (!key->mont)
+		key->mont = mpi_mont_alloc(key->pkey[0]);
+	if (!key->mont)
 		return -ENOMEM;
+	key->ws_limbs = MPI_MONT_WS_LIMBS(key->mont);
+	return 0;
+}
+
+int digsig_init_key_context(void)
+{
+	return digsig_key_ctx_init(&digsig_key);
+}
+
+/*
+ * Run on each CPU: hash a block with every algorithm on the context the
+ * CPU keeps, so that its descriptors exist and the code of the hash
+ * implementations has run, and size its RSA workspace for the key and
+ * raise a number to the key's exponent with it.
+ */
+static void digsig_warm_up_cpu(struct work_struct *unused)
+{
+	struct digsig_key_ctx *key = &digsig_key;
+	unsigned char buf[DIGSIG_MAX_DIGEST_LENGTH] = { 0 };
+	struct digsig_prio prio;
+	SIGCTX *ctx;
+	int i;
+
+	ctx = digsig_sign_verify_get();
+	if (!ctx)
+		return;
+	digsig_prio_background(&prio);
+	for (i = 0; i < DIGSIG_HASH_ALGOS; i++) {
+		ctx->digestAlgo = i;
+		digsig_hash_digest(ctx, buf, sizeof(buf), buf);
 	}
+	ctx->digestAlgo = HASH_SHA1;
 
-	/* Get MPI of signed data from .sig file/section */
-	nread = DIGSIG_ELF_SIG_SIZE;
+	if (digsig_public_key[0] && digsig_public_key[1] &&
+	    !digsig_ctx_key_ws(ctx, key)) {
+		mpi_set_ui(ctx->sig_mpi, 2);
+		digsig_rsa_public(ctx, ctx->key_res, key, key->mont);
+	}
+	digsig_prio_restore(&prio);
+	digsig_sign_verify_release(ctx);
+}
 
-	data = mpi_read_from_buffer(signed_hash + DIGSIG_RSA_DATA_OFFSET,
-				    &nread, 0);
-	if (!data) {
-		kfree(new_sig);
-		return -EINVAL;
+/******************************************************************************
+Description : Pay, as the key is loaded, what the first verifications
+	would pay otherwise: the transforms that could not be allocated at
+	init, before their modules could be loaded, with their self-tests,
+	and on each CPU the descriptors and the RSA workspace of its context.
+Parameters  : none
+Return value: none; what fails here is done on demand, as before
+******************************************************************************/
+void digsig_verify_warm_up(void)
+{
+	u64 t = local_clock();
+	int i;
+
+	for (i = 0; i < DIGSIG_HASH_ALGOS; i++)
+		if (IS_ERR(digsig_get_shash(i)))
+			DSM_ERROR("%s: no %s transform\n", __func__,
+				  digsig_hash_algos[i].name);
+	digsig_chunk_warm_up();
+
+	if (schedule_on_each_cpu(digsig_warm_up_cpu))
+		digsig_warm_up_cpu(NULL);
+
+	DSM_PRINT(DEBUG_INIT, "%s: warmed up in %llu us\n", __func__,
+		  (unsigned long long)div_u64(local_clock() - t, NSEC_PER_USEC));
+}
+
+static inline unsigned int digsig_id_key_slot(const u8 *keyid)
+{
+	return get_unaligned_le32(keyid + DIGSIG_KEYID_SIZE - 4) &
+	       (DIGSIG_KEYS_SLOTS - 1);
+}
+
+/*
+ * The slot of the key added for the key ID, -1 if there is none.  Call
+ * under rcu_read_lock() or the table mutex.
+ */
+static int digsig_id_key_find(const u8 *keyid)
+{
+	unsigned int i, slot = digsig_id_key_slot(keyid);
+	struct digsig_id_key *k;
+
+	for (i = 0; i < DIGSIG_KEYS_SLOTS; i++, slot++) {
+		slot %= DIGSIG_KEYS_SLOTS;
+		k = rcu_dereference_check(digsig_id_keys[slot],
+				lockdep_is_held(&digsig_id_keys_mutex));
+		if (!k)
+			return -1;
+		if (k != &digsig_id_key_gone &&
+		    !memcmp(k->keyid, keyid, DIGSIG_KEYID_SIZE))
+			return slot;
 	}
+	return -1;
+}
 
-	/* Get MPI for hash */
-	/* bsign modif - file hash - gpg modif */
-	/* bsign modif: add bsign greet at beginning */
-	/* gpg modif:   add class and timestamp at end */
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+/******************************************************************************
+Description : List the keys loaded, one per line: the key loaded as 'n' and
+	'e' by its fingerprint, the Ed25519 key and the keys added by key ID
+	by their key ID, with the size of their modulus.  The keys of the
+	.digsig keyring are listed in /proc/keys.
+Parameters  :
+	@m: the seq_file of /sys/kernel/security/digsig/keys
+Return value: none
+******************************************************************************/
+void digsig_keys_show(struct seq_file *m)
+{
+	struct digsig_id_key *k;
+	const u8 *id;
+	int i;
 
-	ctx = kmalloc(sizeof(SIGCTX), GFP_KERNEL);
-	if (!ctx) {
-		DSM_ERROR("Cannot allocate ctx\n");
-		mpi_free(data);
-		kfree(new_sig);
+	if (g_init && digsig_key.pkey[0])
+		seq_printf(m, "rsa %*phN %u\n", SHA1_DIGEST_LENGTH,
+			   digsig_key_fpr, mpi_get_nbits(digsig_key.pkey[0]));
+	id = digsig_ed25519_keyid();
+	if (id)
+		seq_printf(m, "ed25519 %*phN\n", ED25519_KEYID_SIZE, id);
+
+	rcu_read_lock();
+	for (i = 0; i < DIGSIG_KEYS_SLOTS; i++) {
+		k = rcu_dereference(digsig_id_keys[i]);
+		if (!k || k == &digsig_id_key_gone)
+			continue;
+		seq_printf(m, "id %*phN %u tag %08x\n", DIGSIG_KEYID_SIZE,
+			   k->keyid, mpi_get_nbits(k->mpi[0]), k->tag);
+	}
+	rcu_read_unlock();
+}
+#endif
+
+static void digsig_id_key_free(struct digsig_id_key *k)
+{
+	mpi_mont_free(k->ctx.mont);
+	mpi_free(k->mpi[0]);
+	mpi_free(k->mpi[1]);
+	kfree(k);
+}
+
+static void digsig_id_key_free_rcu(struct rcu_head *head)
+{
+	digsig_id_key_free(container_of(head, struct digsig_id_key, rcu));
+}
+
+/* the key for the key ID, with a reference, NULL if there is none */
+static struct digsig_id_key *digsig_id_key_get(const u8 *keyid)
+{
+	struct digsig_id_key *k = NULL;
+	int slot;
+
+	if (!ACCESS_ONCE(digsig_id_keys_count))
+		return NULL;
+
+	rcu_read_lock();
+	slot = digsig_id_key_find(keyid);
+	if (slot >= 0) {
+		k = rcu_dereference(digsig_id_keys[slot]);
+		if (!atomic_inc_not_zero(&k->refs))
+			k = NULL;
+	}
+	rcu_read_unlock();
+	return k;
+}
+
+static void digsig_id_key_put(struct digsig_id_key *k)
+{
+	/* a lookup may still be reading it under rcu_read_lock() */
+	if (atomic_dec_and_test(&k->refs))
+		call_rcu(&k->rcu, digsig_id_key_free_rcu);
+}
+
+/******************************************************************************
+Description : Does a verdict made with the key of the tag still stand?
+Parameters  :
+	@tag: the key tag of the verdict, 0 for the keys that can not be
+		retired
+Return value: 1 if the key was not retired since, 0 otherwise
+******************************************************************************/
+int digsig_key_tag_live(u32 tag)
+{
+	unsigned int slot = (tag & 0xff) - 1;
+
+	if (!tag)
+		return 1;
+	if (slot >= DIGSIG_KEYS_SLOTS)
+		return 0;
+	return DIGSIG_KEY_TAG(slot, ACCESS_ONCE(digsig_id_key_epoch[slot])) ==
+	       tag;
+}
+
+/******************************************************************************
+Description :
+   Add an RSA key for the signatures of its key ID, the 8 byte issuer
+   key ID of their GPG packet.  Keys may be added while verifications
+   run; one of a key ID already loaded must be retired first.
+Parameters  :
+   keyid the key ID
+   raw the modulus and then the exponent, each as a 2 byte bit count
+      followed by the MPI
+   size the bytes at raw
+Return value: 0 on success, -EEXIST if a key of that ID is loaded,
+   -ENOSPC if there are DIGSIG_KEYS_MAX of them, -EINVAL if the MPIs
+   can not be read
+******************************************************************************/
+int digsig_add_id_key(const u8 *keyid, const unsigned char *raw, int size)
+{
+	struct digsig_id_key *k, *old;
+	unsigned int nread, slot;
+	int rc = -EINVAL;
+
+	k = kzalloc(sizeof(*k), GFP_KERNEL);
+	if (!k)
 		return -ENOMEM;
+	memcpy(k->keyid, keyid, DIGSIG_KEYID_SIZE);
+	k->ctx.pkey = k->mpi;
+	atomic_set(&k->refs, 1);
+
+	nread = size;
+	k->mpi[0] = mpi_read_from_buffer(raw, &nread, 0);
+	if (!k->mpi[0] || nread >= size)
+		goto err;
+	raw += nread;
+	size -= nread;
+	nread = size;
+	k->mpi[1] = mpi_read_from_buffer(raw, &nread, 0);
+	if (!k->mpi[1] || nread != size ||
+	    mpi_get_nbits(k->mpi[0]) > DIGSIG_MPI_MAX_SIZE_N * 8)
+		goto err;
+	mpi_normalize(k->mpi[0]);
+	mpi_normalize(k->mpi[1]);
+	if (digsig_key_ctx_init(&k->ctx))
+		DSM_PRINT(DEBUG_SIGN, "%s: no Montgomery context for the key\n",
+			  __func__);
+
+	mutex_lock(&digsig_id_keys_mutex);
+	if (digsig_id_key_find(keyid) >= 0) {
+		rc = -EEXIST;
+	} else if (digsig_id_keys_count == DIGSIG_KEYS_MAX) {
+		rc = -ENOSPC;
+	} else {
+		/* the first free slot of the probe, or a tombstone */
+		for (slot = digsig_id_key_slot(keyid);;
+		     slot = (slot + 1) % DIGSIG_KEYS_SLOTS) {
+			old = rcu_dereference_protected(digsig_id_keys[slot],
+				lockdep_is_held(&digsig_id_keys_mutex));
+			if (!old || old == &digsig_id_key_gone)
+				break;
+		}
+		k->tag = DIGSIG_KEY_TAG(slot, digsig_id_key_epoch[slot]);
+		rcu_assign_pointer(digsig_id_keys[slot], k);
+		digsig_id_keys_count++;
+		rc = 0;
+	}
+	mutex_unlock(&digsig_id_keys_mutex);
+	if (rc)
+		goto err;
+
+	DSM_PRINT(DEBUG_SIGN, "%s: key %*phN added, %u bits\n", __func__,
+		  DIGSIG_KEYID_SIZE, keyid, k->ctx.nbits);
+	return 0;
+
+err:
+	digsig_id_key_free(k);
+	return rc;
+}
+
+/******************************************************************************
+Description :
+   Retire the key of a key ID.  Verifications that already hold it
+   finish with it, later ones no longer find it, and the verdicts it
+   made stop standing: they are checked again on their next lookup, and
+   their sig_cache entries are dropped in the background.  The verdicts
+   of the other keys stand.
+Parameters  :
+   keyid the key ID
+Return value: 0 on success, -ENOENT if no key of that ID was added
+******************************************************************************/
+int digsig_retire_id_key(const u8 *keyid)
+{
+	struct digsig_id_key *k;
+	int slot;
+	u32 tag;
+
+	mutex_lock(&digsig_id_keys_mutex);
+	slot = digsig_id_key_find(keyid);
+	if (slot < 0) {
+		mutex_unlock(&digsig_id_keys_mutex);
+		return -ENOENT;
 	}
+	k = rcu_dereference_protected(digsig_id_keys[slot],
+				      lockdep_is_held(&digsig_id_keys_mutex));
+	tag = k->tag;
+	rcu_assign_pointer(digsig_id_keys[slot], &digsig_id_key_gone);
+	ACCESS_ONCE(digsig_id_key_epoch[slot]) =
+		(digsig_id_key_epoch[slot] + 1) & 0xffffff;
+	digsig_id_keys_count--;
+	mutex_unlock(&digsig_id_keys_mutex);
+
+	digsig_id_key_put(k);
+	/* the epoch moved before the generation does */
+	digsig_inode_invalidate_all();
+	digsig_cache_forget_key(tag);
+
+	DSM_PRINT(DEBUG_SIGN, "%s: key %*phN retired\n", __func__,
+		  DIGSIG_KEYID_SIZE, keyid);
+	return 0;
+}
+
+/******************************************************************************
+Description :
+   Check that m = s^e mod n is the PKCS#1 v1.5 encoding of the digest,
+	0x00 0x01 0xff .. 0xff 0x00 DigestInfo digest
+   by writing m out once as a frame as long as the modulus and comparing
+   it in place, without building the expected MPI.
+Parameters  :
+   m the RSA result, algo the hash algorithm, md the digest, mdlen its size
+Return value: 0 if m encodes md, -EPERM otherwise
+******************************************************************************/
+
+static int digsig_rsa_check_frame(SIGCTX *ctx, struct digsig_key_ctx *key,
+				  MPI m, const struct digsig_hash_algo *algo,
+				  const u8 *md, int mdlen)
+{
+	unsigned char *frame = ctx->frame;
+	int nframe = digsig_key_frame(key);
+	int pad = nframe - mdlen - algo->asn_len - 3;
+	int i, diff;
+
+	if (nframe > sizeof(ctx->frame) || pad < 8)
+		return -EPERM;
+	if (mpi_get_buffer_fixed(m, frame, nframe))
+		return -EPERM;
+
+	diff = frame[0] | (frame[1] ^ 0x01);
+	for (i = 2; i < pad + 2; i++)
+		diff |= frame[i] ^ 0xff;
+	diff |= frame[i++];
+	diff |= digsig_memneq(frame + i, algo->asn, algo->asn_len);
+	diff |= digsig_memneq(frame + i + algo->asn_len, md, mdlen);
+
+	return diff ? -EPERM : 0;
+}
 
-	ctx->tvmem = kmalloc(TVMEMSIZE, GFP_KERNEL);
-	if (!ctx->tvmem) {
-		kfree(ctx);
-		mpi_free(data);
-		kfree(new_sig);
-		DSM_ERROR("Cannot allocate plaintext buffer\n");
+/* Write out the frame of md for the key, as a valid signature gives it. */
+static int digsig_rsa_make_frame(unsigned char *frame,
+				 struct digsig_key_ctx *key,
+				 const struct digsig_hash_algo *algo,
+				 const u8 *md, int mdlen)
+{
+	int nframe = digsig_key_frame(key);
+	int pad = nframe - mdlen - algo->asn_len - 3;
+
+	if (nframe > DIGSIG_MPI_MAX_SIZE_N || pad < 8)
+		return -EPERM;
+	frame[0] = 0;
+	frame[1] = 0x01;
+	memset(frame + 2, 0xff, pad);
+	frame[pad + 2] = 0;
+	memcpy(frame + pad + 3, algo->asn, algo->asn_len);
+	memcpy(frame + pad + 3 + algo->asn_len, md, mdlen);
+	return nframe;
+}
+
+/*
+ * Keep the decoded signature of the context and the frame of md for a
+ * batch to screen.  A signature that is not below n, or is 0, would not
+ * verify by itself and is refused here.
+ */
+static int digsig_rsa_screen_keep(SIGCTX *ctx, struct digsig_key_ctx *key,
+				  const struct digsig_hash_algo *algo,
+				  const u8 *md, int mdlen)
+{
+	struct digsig_screen_sig *sig = &ctx->screen_sig;
+	int nframe;
+
+	if (!mpi_cmp_ui(ctx->sig_mpi, 0) ||
+	    mpi_cmp(ctx->sig_mpi, key->pkey[0]) >= 0)
+		return -EPERM;
+	nframe = digsig_rsa_make_frame(ctx->frame, key, algo, md, mdlen);
+	if (nframe < 0)
+		return nframe;
+
+	sig->s = mpi_copy(ctx->sig_mpi);
+	sig->m = mpi_alloc(mpi_get_nlimbs(key->pkey[0]));
+	if (!sig->s || !sig->m) {
+		digsig_screen_sig_free(sig);
 		return -ENOMEM;
 	}
+	mpi_set_buffer(sig->m, ctx->frame, nframe, 0);
+	ctx->screened = 1;
+	return 0;
+}
+
+/* s^e mod n of the context's signature, with the engine's arithmetic */
+static void digsig_rsa_engine(SIGCTX *ctx, MPI res, struct digsig_key_ctx *key,
+			      int engine)
+{
+	u64 t = digsig_engine_start();
+
+	digsig_rsa_public(ctx, res, key,
+			  engine == DIGSIG_ENGINE_LEGACY ? NULL : key->mont);
+	digsig_engine_account(engine, t);
+}
 
-	digsig_sha1_init(ctx);
+/* Verify the signature again with the other engine, to compare verdicts. */
+static void digsig_rsa_shadow(SIGCTX *ctx, struct digsig_key_ctx *key,
+			      const struct digsig_hash_algo *algo,
+			      int engine, int verdict, int mdlen)
+{
+	int other = engine == DIGSIG_ENGINE_MONT ? DIGSIG_ENGINE_LEGACY :
+						   DIGSIG_ENGINE_MONT;
+	MPI res;
+
+	res = mpi_alloc(mpi_get_nlimbs(key->pkey[0]));
+	if (!res)
+		return;
+	digsig_rsa_engine(ctx, res, key, other);
+	digsig_engine_compare(engine, verdict,
+			      digsig_rsa_check_frame(ctx, key, res, algo,
+						     ctx->new_sig, mdlen));
+	mpi_free(res);
+}
 
-	sig_class = signed_hash[DIGSIG_RSA_CLASS_OFFSET];
-	sig_class &= 0xff;
+static void digsig_rsa_early_work(struct work_struct *work)
+{
+	SIGCTX *ctx = container_of(work, SIGCTX, rsa_work);
 
-	for (i = 0; i < SIZEOF_UNSIGNED_INT; i++) {
-		sig_timestamp[i] =
-			signed_hash[DIGSIG_RSA_TIMESTAMP_OFFSET + i] & 0xff;
+	ctx->rsa_engine = digsig_engine_pick();
+	digsig_rsa_engine(ctx, ctx->key_res, &digsig_key, ctx->rsa_engine);
+	complete(&ctx->rsa_done);
+}
+
+/*
+ * Wait for the signature of the context to be raised, if it is being.
+ * Returns 1 if key_res then holds it, with the engine in rsa_engine.
+ */
+static int digsig_rsa_early_wait(SIGCTX *ctx)
+{
+	if (!ctx->rsa_early)
+		return 0;
+	wait_for_completion(&ctx->rsa_done);
+	ctx->rsa_early = 0;
+	return 1;
+}
+
+/******************************************************************************
+Description : Start raising an RSA signature to e on another CPU, as the
+	file it signs is about to be hashed: s^e mod n does not depend on
+	the digest, only the comparison of its frame with it does.  Only
+	for the key loaded as 'n' and 'e', when no key was added for the
+	key ID of the signature, and for files large enough that their
+	hash takes longer than queueing the work.
+Parameters  :
+  ctx the context, initialized for the signature
+  packet the signature packet, packet_len its size
+  size the size of the file
+Return value: none; digsig_rsa_bsign_verify() computes s^e itself if it
+	was not started
+******************************************************************************/
+void digsig_rsa_early_start(SIGCTX *ctx, unsigned char *packet,
+			    int packet_len, loff_t size)
+{
+	struct digsig_id_key *id_key;
+	int min = ACCESS_ONCE(dsi_rsa_overlap);
+
+	if (min <= 0 || size < min || ctx->screen || ctx->rsa_early ||
+	    digsig_ctx_sign(ctx) != SIGN_RSA || num_online_cpus() < 2)
+		return;
+	if (!digsig_public_key[0] || !digsig_public_key[1])
+		return;
+	if (digsig_decode_signature(ctx, packet, packet_len))
+		return;
+	id_key = digsig_id_key_get(packet + DIGSIG_RSA_KEYID_OFFSET);
+	if (id_key) {
+		digsig_id_key_put(id_key);
+		return;
 	}
+	if (digsig_ctx_key_ws(ctx, &digsig_key))
+		return;
+
+	ctx->rsa_early = 1;
+	INIT_COMPLETION(ctx->rsa_done);
+	INIT_WORK(&ctx->rsa_work, digsig_rsa_early_work);
+	/* unbound, so that the scheduler wakes it on an idle CPU */
+	queue_work(system_unbound_wq, &ctx->rsa_work);
+}
 
-	digsig_sha1_update(ctx, DIGSIG_BSIGN_STRING, DIGSIG_BSIGN_GREET_SIZE);
-	digsig_sha1_update(ctx, hash_format, SHA1_DIGEST_LENGTH);
-	digsig_sha1_update(ctx, &sig_class, 1);
-	digsig_sha1_update(ctx, sig_timestamp, SIZEOF_UNSIGNED_INT);
+/******************************************************************************
+Description :
+   Performs RSA verification of signature contained in binary
+Parameters  :
+Return value: 0 - RSA signature is valid
+              1 - RSA signature is invalid
+              -1 - an error occured
+******************************************************************************/
 
-	if ((rc = digsig_sha1_final(ctx, new_sig)) < 0) {
+static int digsig_rsa_bsign_verify(SIGCTX *ctx, unsigned char *hash_format,
+				   int length, unsigned char *signed_hash,
+				   int siglen)
+{
+	int hash = digsig_ctx_hash(ctx);
+	const struct digsig_hash_algo *algo = &digsig_hash_algos[hash];
+	struct digsig_key_ctx *key = &digsig_key;
+	struct digsig_id_key *id_key;
+	unsigned char msg[DIGSIG_BSIGN_GREET_SIZE + DIGSIG_MAX_DIGEST_LENGTH +
+			  1 + SIZEOF_UNSIGNED_INT];
+	unsigned char *p = msg;
+	int engine, rc = 0;
+
+	if (siglen <= DIGSIG_RSA_DATA_OFFSET ||
+	    length > DIGSIG_MAX_DIGEST_LENGTH)
+		return -EINVAL;
+
+	/* Get MPI for hash */
+	/* bsign modif - file hash - gpg modif */
+	/* bsign modif: add bsign greet at beginning */
+	/* gpg modif:   add class and timestamp at end */
+
+	/*
+	 * The whole message is less than two blocks, so it is put
+	 * together here and hashed in one call on the context's own
+	 * descriptor, now that the file hash is final.
+	 */
+	memcpy(p, digsig_bsign_greeting(hash), DIGSIG_BSIGN_GREET_SIZE);
+	p += DIGSIG_BSIGN_GREET_SIZE;
+	memcpy(p, hash_format, length);
+	p += length;
+	*p++ = signed_hash[DIGSIG_RSA_CLASS_OFFSET];
+	memcpy(p, signed_hash + DIGSIG_RSA_TIMESTAMP_OFFSET,
+	       SIZEOF_UNSIGNED_INT);
+	p += SIZEOF_UNSIGNED_INT;
+
+	if ((rc = digsig_hash_digest(ctx, msg, p - msg, ctx->new_sig)) < 0) {
 		DSM_ERROR
 		    ("internal_rsa_verify_final Cannot finalize hash algorithm\n");
-		mpi_free(data);
-		kfree(ctx->tvmem);
-		kfree(ctx);
 		return rc;
 	}
 
-	nframe = mpi_get_nbits(digsig_public_key[0]);
-	hash = do_encode_md(new_sig, nframe);
+	/*
+	 * A key added for the signature's key ID comes first, then a
+	 * keyring key of that ID, and the key loaded as 'n' and 'e' last.
+	 */
+	id_key = digsig_id_key_get(signed_hash + DIGSIG_RSA_KEYID_OFFSET);
+	if (id_key) {
+		key = &id_key->ctx;
+		ctx->key_tag = id_key->tag;
+	} else {
+		rc = digsig_keyring_verify(digsig_pgp_hash_algo(hash),
+					   ctx->new_sig, length,
+					   signed_hash + DIGSIG_RSA_KEYID_OFFSET,
+					   signed_hash + DIGSIG_RSA_DATA_OFFSET,
+					   siglen - DIGSIG_RSA_DATA_OFFSET);
+		/* keyring keys can not verify every hash, ours can */
+		if (rc != -ENOKEY && rc != -ENOPKG)
+			return rc ? -EPERM : 0;
+		if (!digsig_public_key[0] || !digsig_public_key[1])
+			return -EPERM;
+	}
 
-	if (hash == MPI_NULL)
-		DSM_PRINT(DEBUG_SIGN, "mpi creation failed\n");
+	/* Get MPI of signed data from .sig file/section, if not done yet */
+	rc = digsig_decode_signature(ctx, signed_hash, siglen);
+	if (rc)
+		goto out;
 
-	/* Do RSA verification */
-	cmp = rsa_verify(hash, &data, digsig_public_key);
-	rc = cmp ? -EPERM : 0;
+	/* only the signatures of one key can be screened together */
+	if (ctx->screen && key == &digsig_key) {
+		rc = digsig_rsa_screen_keep(ctx, key, algo, ctx->new_sig,
+					    length);
+		goto out;
+	}
 
-	mpi_free(hash);
-	mpi_free(data);
+	/* s^e mod n was computed while the file was hashed, if it could be */
+	if (key == &digsig_key && digsig_rsa_early_wait(ctx)) {
+		engine = ctx->rsa_engine;
+	} else {
+		/* Do RSA verification, without allocating if the key allows it */
+		rc = digsig_ctx_key_ws(ctx, key);
+		if (rc)
+			goto out;
+		engine = digsig_engine_pick();
+		digsig_rsa_engine(ctx, ctx->key_res, key, engine);
+	}
 
-	kfree(ctx->tvmem);
-	kfree(ctx);
+	rc = digsig_rsa_check_frame(ctx, key, ctx->key_res, algo,
+				    ctx->new_sig, length);
+	if (digsig_engine_shadowing())
+		digsig_rsa_shadow(ctx, key, algo, engine, rc, length);
+out:
+	if (id_key)
+		digsig_id_key_put(id_key);
+	return rc;
+}
+
+/******************************************************************************
+Description :
+   Performs Ed25519 verification of a signature contained in a binary.
+   The signed message is the greeting followed by the file hash; Ed25519
+   hashes it again with SHA-512, together with R and the key.
+Parameters  :
+   hash the file hash, length its size
+   packet the key ID followed by the signature, packet_len its size
+Return value: 0 - signature is valid
+              -EPERM - signature is invalid or made with another key
+              other negative values - an error occured
+******************************************************************************/
 
-	kfree(new_sig);
+static int
+digsig_ed25519_bsign_verify(SIGCTX *ctx, unsigned char *hash, int length,
+			    unsigned char *packet, int packet_len)
+{
+	const u8 *pk, *sig = packet + ED25519_KEYID_SIZE;
+	int rc;
 
-	return rc;
+	if (packet_len != ED25519_KEYID_SIZE + ED25519_SIG_SIZE)
+		return -EINVAL;
+
+	pk = digsig_ed25519_key(packet);
+	if (!pk) {
+		DSM_PRINT(DEBUG_SIGN, "%s: no Ed25519 key for the signature\n",
+			  __func__);
+		return -EPERM;
+	}
+
+	/* SHA-512(R || A || greeting || file hash) */
+	ctx->digestAlgo = HASH_SHA512;
+	if (digsig_hash_init(ctx))
+		return -ENOMEM;
+	digsig_hash_update(ctx, (char *)sig, ED25519_SIG_SIZE / 2);
+	digsig_hash_update(ctx, (char *)pk, ED25519_KEY_SIZE);
+	digsig_hash_update(ctx, DIGSIG_BSIGN_ED25519_STRING,
+			   DIGSIG_BSIGN_GREET_SIZE);
+	digsig_hash_update(ctx, hash, length);
+	rc = digsig_hash_final(ctx, ctx->new_sig);
+	if (rc < 0)
+		return rc;
+
+	return digsig_ed25519_verify(sig, ctx->new_sig) ? -EPERM : 0;
 }
 
 
 /******************************************************************************
 Description :
-   initialisation of hash with sha1
+   the context's own descriptor for ctx->digestAlgo, allocated on first
+   use, which becomes the context's current one
 Parameters  :
-Return value: 0 for successful allocation, -1 for failed
+Return value: the descriptor, NULL for failure
 ******************************************************************************/
 
-static int digsig_sha1_init(SIGCTX *ctx)
+static struct shash_desc *digsig_hash_desc(SIGCTX *ctx)
 {
-	if (ctx == NULL)
-		return -1;
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+
+	desc = ctx->descs[ctx->digestAlgo];
+	/* another implementation was picked since the descriptor was made */
+	if (desc && desc->tfm != ACCESS_ONCE(digsig_shash[ctx->digestAlgo])) {
+		kfree(desc);
+		ctx->descs[ctx->digestAlgo] = desc = NULL;
+	}
+	if (!desc) {
+		tfm = digsig_get_shash(ctx->digestAlgo);
+		if (IS_ERR(tfm))
+			return NULL;
+
+		/* a whole number of cache lines, so no other data shares them */
+		desc = kmalloc(ALIGN(sizeof(*desc) + crypto_shash_descsize(tfm),
+				     L1_CACHE_BYTES), GFP_KERNEL);
+		if (!desc)
+			return NULL;
+		desc->tfm = tfm;
+		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+		ctx->descs[ctx->digestAlgo] = desc;
+	}
 
-	if (sha1_tfm == NULL)
-		sha1_tfm = crypto_alloc_hash("sha1", 0, CRYPTO_ALG_ASYNC);
+	ctx->desc = desc;
+	return desc;
+}
 
-	ctx->desc.flags = CRYPTO_ALG_ASYNC;
-	ctx->desc.tfm = sha1_tfm;
-	if (IS_ERR(ctx->desc.tfm)) {
-		DSM_ERROR("tfm allocation failed\n");
+/* initialisation of hash with ctx->digestAlgo; 0 for success, -1 for failure */
+static int digsig_hash_init(SIGCTX *ctx)
+{
+	struct shash_desc *desc;
+
+	if (ctx == NULL)
 		return -1;
-	}
 
-	crypto_hash_init(&ctx->desc);
+	desc = digsig_hash_desc(ctx);
+	if (!desc || crypto_shash_init(desc))
+		return -1;
 	return 0;
 }
 
-
 /******************************************************************************
-Description : Portability layer function.
+Description : Hash a whole message in one call, with ctx->digestAlgo.
 Parameters  :
-Return value: void.
+Return value: 0 for success, negative for failure
 ******************************************************************************/
 
-static void digsig_sha1_update(SIGCTX *ctx, char *buf, int buflen)
+static int digsig_hash_digest(SIGCTX *ctx, unsigned char *buf, int buflen,
+			      unsigned char *digest)
 {
-	char *plaintext;
+	struct shash_desc *desc = digsig_hash_desc(ctx);
+
+	if (!desc)
+		return -ENOMEM;
+	return crypto_shash_digest(desc, buf, buflen, digest);
+}
 
-	memcpy(ctx->tvmem, buf, buflen);
-	plaintext = (void *) ctx->tvmem;
 
-	sg_set_page(&ctx->sg[0], virt_to_page(plaintext), buflen,
-		    ((long) plaintext & ~PAGE_MASK));
+/******************************************************************************
+Description : Portability layer function.
+Parameters  :
+Return value: void.
+******************************************************************************/
 
-	crypto_hash_update(&ctx->desc, ctx->sg, 1);
+static void digsig_hash_update(SIGCTX *ctx, char *buf, int buflen)
+{
+	crypto_shash_update(ctx->desc, buf, buflen);
 }
 
 /******************************************************************************
@@ -392,7 +1569,7 @@ Parameters  :
 Return value: 0 for successful allocation, -EINVAL for failed
 ******************************************************************************/
 
-static int digsig_sha1_final(SIGCTX *ctx, char *digest)
+static int digsig_hash_final(SIGCTX *ctx, char *digest)
 {
 	/* TO DO: check the length of the signature: it should be equal to the length
 	   of the modulus */
@@ -400,6 +1577,5 @@ static int digsig_sha1_final(SIGCTX *ctx, char *digest)
 	if (ctx == NULL)
 		return -EINVAL;
 
-	crypto_hash_final(&ctx->desc, digest);
-	return 0;
+	return crypto_shash_final(ctx->desc, digest);
 }
@@ -18,77 +18,195 @@
 #define _DIGSIG_VERIFY_H
 
 #include <linux/crypto.h>
+#include <crypto/hash.h>
 #include <linux/err.h>
-#include <linux/scatterlist.h>
+#include <linux/elf.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 
 #include "gnupg/mpi/mpi.h"
+#include "digsig_ed25519.h"
+#include "digsig_format.h"
 
 
-#define DIGSIG_ELF_SIG_SECTION 0x80736967	/* ((0x80 << 24)|('s' << 16)|('i' << 8)|'g') */
-#define DIGSIG_ELF_SIG_SIZE 512	/* Total signature size */
 #define DIGSIG_ELF_READ_BLOCK_SIZE 1024	/* Signature will be done in chunks of n bytes */
 
 /*
- * Format of digital signature done by bsign:
- * - "#1; bsign v%s\n"
- * - hash of file with sig section zerod (crypto class and timestamp not added to hash)
- * - length of digsig (2 bytes)
- * - digsig
+ * The hashing of a file reports its progress, with the
+ * digsig_verify_progress trace event, each time it gets past a multiple
+ * of DIGSIG_PROGRESS_STEP bytes, so that the verification of a file of
+ * gigabytes can be followed while it runs.
  */
-
-#define DIGSIG_BSIGN_VERSION    "0.4.5"
-#define DIGSIG_BSIGN_STRING     "#1; bsign v" DIGSIG_BSIGN_VERSION "\n"
-#define DIGSIG_BSIGN_GREET_SIZE (sizeof(DIGSIG_BSIGN_STRING) - 1)
-#define DIGSIG_BSIGN_HASH       20	/* sha1 hash */
-#define DIGSIG_BSIGN_LEN_OFFSET 2	/* length of digsig added by bsign */
-#define DIGSIG_BSIGN_INFOS      (DIGSIG_BSIGN_GREET_SIZE + DIGSIG_BSIGN_HASH+DIGSIG_BSIGN_LEN_OFFSET)
-
-/* GPG .sig file/section structure:
- * 89     00 95 03          05      00    3F293CEB
- * hdrlen       sig version md5 len class timestamp
- *
- * D39C2077 C307562E 01          02          29
- * keyid[0] keyid[1] pubkey algo digest algo digest start[0]
- *
- * C2              03FF         Rest of .sig
- * digest start[1] nbits of MPI MPI (as read by mpi_read)
- */
-
-#define DIGSIG_RSA_CLASS_OFFSET     5
-#define DIGSIG_RSA_TIMESTAMP_OFFSET 6
-#define DIGSIG_RSA_DATA_OFFSET      22
-
+#define DIGSIG_PROGRESS_STEP (64LL << 20)
 
 /*ToDO: makan: this is a constraint, we suppose that the max size of a
   big integer is 1024 bytes. This needs to be modified in order to
   have a dynamic way of allocating memory. */
 
-#define DIGSIG_MPI_MAX_SIZE_N 1024
 #define DIGSIG_MPI_MAX_SIZE_E 128
 
-/**
- * Supported algorithms
+/*
+ * A build for RSA-2048 with SHA-256 only refuses other signatures as
+ * they are parsed.  The algorithms of a context are then constants on
+ * the verification path, and the RSA buffers are sized for the one key.
  */
-#define HASH_SHA1 0
-#define SIGN_RSA 0
+#ifdef CONFIG_SECURITY_DIGSIG_ONLY_RSA2048_SHA256
+#define DIGSIG_FIXED_RSA_BITS 2048
+#define DIGSIG_MPI_MAX_SIZE_N (DIGSIG_FIXED_RSA_BITS / 8)
+#define digsig_ctx_hash(ctx) HASH_SHA256
+#define digsig_ctx_sign(ctx) SIGN_RSA
+#define digsig_key_frame(key) (DIGSIG_FIXED_RSA_BITS / 8)
+#else
+#define DIGSIG_MPI_MAX_SIZE_N 1024
+#define digsig_ctx_hash(ctx) ((ctx)->digestAlgo)
+#define digsig_ctx_sign(ctx) ((ctx)->signAlgo)
+#define digsig_key_frame(key) (((key)->nbits + 7) / 8)
+#endif
+
+/* limbs of the largest signature MPI a signature section can hold */
+#define DIGSIG_SIG_MPI_LIMBS \
+	((DIGSIG_ELF_SIG_SIZE + BYTES_PER_MPI_LIMB - 1) / BYTES_PER_MPI_LIMB)
 
+/*
+ * The section header table is read through the context this many
+ * entries at a time, whatever its size.
+ */
+#define DIGSIG_SHDR_INLINE 64
+
+/*
+ * digsig_screen_sig: an RSA signature of the key loaded as 'n' and 'e',
+ * not raised to e yet, and the frame it must give: a batch checks that
+ * the product of its signatures raised to e is the product of their
+ * frames.
+ */
+struct digsig_screen_sig {
+	MPI s;
+	MPI m;
+};
+
+/*
+ * A verification context holds every buffer one verification needs, from
+ * the ELF header to the digests, together with its hash descriptors.
+ * Contexts are kept in a pool and reused, so that verifying a file does
+ * not go to the slab allocator.
+ */
 typedef struct sig_ctx_st {
-	struct hash_desc desc;
-	struct scatterlist sg[1];
+	struct shash_desc *desc;	/* of digestAlgo, one of descs[] */
 	int digestAlgo;
 	int signAlgo;
-	char *tvmem;
+	struct list_head pool;
+	struct shash_desc *descs[DIGSIG_HASH_ALGOS];
+
+	struct elf64_hdr elf_ex;
+	Elf64_Shdr shdata[DIGSIG_SHDR_INLINE];
+	char sig[DIGSIG_ELF_SIG_SIZE];
+	char read_block[DIGSIG_ELF_READ_BLOCK_SIZE];
+	unsigned char digest[DIGSIG_MAX_DIGEST_LENGTH];
+	int digest_done;		/* digest was hashed outside desc */
+	unsigned char new_sig[DIGSIG_MAX_DIGEST_LENGTH];
+
+	/* RSA workspace, sized for the loaded key on first verification */
+	mpi_limb_t *key_ws;
+	unsigned int key_ws_limbs;
+	u32 key_tag;		/* of the key that verified, 0 if none of ours */
+	MPI key_res;
+
+	/*
+	 * The signature MPI, decoded once per verification for both the
+	 * revocation check and the RSA verification; sig_mpi_src is the
+	 * packet it was decoded from, NULL when there is none.
+	 */
+	MPI sig_mpi;
+	const unsigned char *sig_mpi_src;
+
+	/*
+	 * The page the ELF metadata was last read from, held until the
+	 * context is released.
+	 */
+	struct page *meta_page;
+	pgoff_t meta_index;
+
+	/* the file is hashed without keeping the pages it reads cached */
+	int stream;
+
+	/* the file is large: its bytes are prefetched past the CPU caches */
+	int nontemporal;
+
+	/*
+	 * With share set, the file is also hashed as it is, its signature
+	 * section included, into share_desc, for IMA to take the digest.
+	 */
+	struct shash_desc *share_desc;
+	int share;
+
+	/* s^e mod n, written out to check its padding and digest */
+	unsigned char frame[DIGSIG_MPI_MAX_SIZE_N];
+
+	/*
+	 * With screen set, an RSA signature of the loaded key is left in
+	 * screen_sig for a batch to check, rather than raised to e, and
+	 * screened is set.
+	 */
+	int screen;
+	int screened;
+	struct digsig_screen_sig screen_sig;
+
+	/*
+	 * With rsa_early set, sig_mpi is being raised to e with the key
+	 * loaded as 'n' and 'e', into key_res, by rsa_work on another CPU
+	 * while the file is hashed; rsa_done completes once it is.
+	 */
+	struct work_struct rsa_work;
+	struct completion rsa_done;
+	int rsa_early;
+	int rsa_engine;
 } SIGCTX;
 
-extern int gDigestLength[1];
 extern MPI digsig_public_key[];
+extern unsigned char digsig_key_fpr[SHA1_DIGEST_LENGTH];
+extern int digsig_key_fpr_ready;
 
-SIGCTX *digsig_sign_verify_init(int hashalgo, int signalgo);
+/*
+ * Is digsig_key_fpr that of the keys loaded?  The stamps and flags kept
+ * across boots are bound to it, and are neither written nor trusted
+ * until it is.
+ */
+static inline int digsig_key_fpr_valid(void)
+{
+	int ready = ACCESS_ONCE(digsig_key_fpr_ready);
+
+	smp_rmb();
+	return ready;
+}
+
+const char *digsig_hash_name(int algo);
+struct crypto_shash *digsig_get_shash(int algo);
+void digsig_set_shash(int algo, struct crypto_shash *tfm);
+SIGCTX *digsig_sign_verify_get(void);
+int digsig_sign_verify_init(SIGCTX *ctx, int hashalgo, int signalgo);
 int digsig_sign_verify_update(SIGCTX *ctx, char *buf, int buflen);
 int digsig_sign_verify_final(SIGCTX *ctx, int siglen /* PublicKey */,
 			     unsigned char *signed_hash);
-void digsig_sign_verify_free(void);
+void digsig_sign_verify_release(SIGCTX *ctx);
+int digsig_decode_signature(SIGCTX *ctx, unsigned char *packet, int packet_len);
+void digsig_rsa_early_start(SIGCTX *ctx, unsigned char *packet,
+			    int packet_len, loff_t size);
+int digsig_rsa_screen(struct digsig_screen_sig *sigs, int n);
+void digsig_screen_sig_free(struct digsig_screen_sig *sig);
+int digsig_verify_buffer(char *data, int len, char *sig, int sig_size);
 int digsig_init_pkey(const char read_par, unsigned char *raw_public_key, int mpi_size);
+int digsig_init_key_fingerprint(void);
+int digsig_init_key_context(void);
+void digsig_verify_warm_up(void);
+int digsig_add_id_key(const u8 *keyid, const unsigned char *raw, int size);
+int digsig_retire_id_key(const u8 *keyid);
+int digsig_key_tag_live(u32 tag);
+int digsig_init_verify(void);
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+struct seq_file;
+void digsig_keys_show(struct seq_file *m);
+#endif
 
 
 
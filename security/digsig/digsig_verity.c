@@ -0,0 +1,262 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file lets DigSig take the integrity of a file from the dm-verity
+ * device its filesystem sits on, rather than from the file's own
+ * signature.  dm-verity checks every block read from the device against
+ * a hash tree, so once the root of that tree is known to be signed,
+ * hashing the file again proves nothing more.
+ *
+ * The roots are given to DigSig at runtime, each signed with the DigSig
+ * key, and only a device whose whole table is one verity target with
+ * one of those roots is trusted.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/device-mapper.h>
+#include <linux/rculist.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "../../drivers/md/dm.h"
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_verity.h"
+
+/* a handful of images at most are mounted at once */
+#define DIGSIG_VERITY_MAX_ROOTS 16
+
+/* the table line of a verity target, see verity_status() */
+#define DIGSIG_VERITY_STATUS_SIZE 512
+#define DIGSIG_VERITY_FIELD_ALG 7
+#define DIGSIG_VERITY_FIELD_ROOT 8
+
+int dsi_verity = 0;
+module_param(dsi_verity, int, 0);
+MODULE_PARM_DESC(dsi_verity, "Trust files on dm-verity devices with a signed root hash, unless a policy rule says otherwise.\n");
+
+/*
+ * digsig_verity_root: a root hash whose signature was verified.  Roots
+ * are only ever added, so readers walk the list under RCU alone.
+ */
+struct digsig_verity_root {
+	struct list_head list;
+	char alg[DIGSIG_VERITY_ALG_SIZE];
+	unsigned int size;
+	u8 digest[DIGSIG_VERITY_MAX_DIGEST];
+};
+
+static LIST_HEAD(digsig_verity_roots);
+static DEFINE_MUTEX(digsig_verity_mutex);
+static unsigned int digsig_verity_count;
+
+static struct digsig_verity_root *
+digsig_verity_find(const char *alg, const u8 *digest, unsigned int size)
+{
+	struct digsig_verity_root *r;
+
+	list_for_each_entry_rcu(r, &digsig_verity_roots, list)
+		if (r->size == size && !strcmp(r->alg, alg) &&
+		    !memcmp(r->digest, digest, size))
+			return r;
+	return NULL;
+}
+
+/******************************************************************************
+Description : Add a trusted root, in the format of digsig_verity.h.  The
+	whole root is taken in one write.
+Parameters  :
+	@buf, @count: the root
+Return value: @count, or a negative error
+******************************************************************************/
+int digsig_verity_add_root(char *buf, size_t count)
+{
+	const struct digsig_verity_root_hdr *hdr = (const void *)buf;
+	struct digsig_verity_root *r;
+	u32 size, sig_size;
+	int rc;
+
+	if (count < sizeof(*hdr) ||
+	    memcmp(hdr->magic, DIGSIG_VERITY_MAGIC, sizeof(hdr->magic)))
+		return -EINVAL;
+	size = le32_to_cpu(hdr->digest_size);
+	sig_size = le32_to_cpu(hdr->sig_size);
+	if (!size || size > DIGSIG_VERITY_MAX_DIGEST ||
+	    (sig_size != DIGSIG_ELF_SIG_SIZE &&
+	     sig_size != DIGSIG_ED25519_SIG_SIZE) ||
+	    count != sizeof(*hdr) + size + sig_size ||
+	    strnlen(hdr->alg, sizeof(hdr->alg)) == sizeof(hdr->alg))
+		return -EINVAL;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+	strcpy(r->alg, hdr->alg);
+	r->size = size;
+	memcpy(r->digest, hdr + 1, size);
+
+	rc = digsig_verify_buffer(buf, count - sig_size,
+				  buf + count - sig_size, sig_size);
+	if (rc) {
+		kfree(r);
+		return rc;
+	}
+
+	mutex_lock(&digsig_verity_mutex);
+	if (digsig_verity_find(r->alg, r->digest, r->size)) {
+		kfree(r);
+	} else if (digsig_verity_count >= DIGSIG_VERITY_MAX_ROOTS) {
+		kfree(r);
+		rc = -ENOSPC;
+	} else {
+		list_add_tail_rcu(&r->list, &digsig_verity_roots);
+		digsig_verity_count++;
+	}
+	mutex_unlock(&digsig_verity_mutex);
+
+	return rc ? rc : count;
+}
+
+/*
+ * The root of the table of @md, into @alg and @digest, if the table is
+ * one verity target over the whole device.  Returns the size of the
+ * digest, 0 otherwise.
+ */
+static int digsig_verity_table_root(struct mapped_device *md,
+				    struct block_device *bdev, char *alg,
+				    u8 *digest)
+{
+	char *field[DIGSIG_VERITY_FIELD_ROOT + 1];
+	struct dm_target *ti;
+	struct dm_table *t;
+	char *status, *s, *f;
+	unsigned int size;
+	int n, srcu_idx, ret = 0;
+
+	status = kzalloc(DIGSIG_VERITY_STATUS_SIZE, GFP_KERNEL);
+	if (!status)
+		return 0;
+
+	/* the read section is taken whether there is a table or not */
+	t = dm_get_live_table(md, &srcu_idx);
+	if (t && dm_table_get_num_targets(t) == 1) {
+		ti = dm_table_get_target(t, 0);
+		if (!strcmp(ti->type->name, "verity") && !ti->begin &&
+		    ti->len == i_size_read(bdev->bd_inode) >> SECTOR_SHIFT)
+			ti->type->status(ti, STATUSTYPE_TABLE, 0, status,
+					 DIGSIG_VERITY_STATUS_SIZE - 1);
+	}
+	dm_put_live_table(md, srcu_idx);
+	if (!*status)
+		goto out;
+
+	s = status;
+	for (n = 0; n <= DIGSIG_VERITY_FIELD_ROOT && (f = strsep(&s, " ")); )
+		if (*f)
+			field[n++] = f;
+	if (n <= DIGSIG_VERITY_FIELD_ROOT)
+		goto out;
+	size = strlen(field[DIGSIG_VERITY_FIELD_ROOT]);
+	if (!size || size % 2 || size / 2 > DIGSIG_VERITY_MAX_DIGEST)
+		goto out;
+	size /= 2;
+	if (hex2bin(digest, field[DIGSIG_VERITY_FIELD_ROOT], size) ||
+	    strlcpy(alg, field[DIGSIG_VERITY_FIELD_ALG],
+		    DIGSIG_VERITY_ALG_SIZE) >= DIGSIG_VERITY_ALG_SIZE)
+		goto out;
+	ret = size;
+out:
+	kfree(status);
+	return ret;
+}
+
+/******************************************************************************
+Description : Find the root hash of the dm-verity device a superblock sits
+	on, if the device is one verity target over the whole of it.
+Parameters  :
+	@sb: the superblock
+	@alg: the hash algorithm of the tree, DIGSIG_VERITY_ALG_SIZE bytes
+	@digest: the root, DIGSIG_VERITY_MAX_DIGEST bytes
+	@table: if not NULL, the table the root was read from
+Return value: the size of the root, 0 if the device has none
+******************************************************************************/
+int digsig_verity_sb_root(struct super_block *sb, char *alg, u8 *digest,
+			  struct digsig_verity_table *table)
+{
+	struct block_device *bdev = sb->s_bdev;
+	struct mapped_device *md;
+	u32 nr;
+	int size;
+
+	/* a partition of the device is not what the root covers */
+	if (!bdev || bdev != bdev->bd_contains)
+		return 0;
+
+	md = dm_get_md(bdev->bd_dev);
+	if (!md)
+		return 0;
+	/* counted before the table is looked at: a swap meanwhile shows */
+	nr = dm_get_table_nr(md);
+	smp_rmb();
+	size = digsig_verity_table_root(md, bdev, alg, digest);
+	dm_put(md);
+	if (size && table) {
+		table->md = md;
+		table->nr = nr;
+	}
+	return size;
+}
+
+/******************************************************************************
+Description : Does a device still read through the table a root was read
+	from?  A table loaded and resumed since may have any root.
+Parameters  :
+	@table: as filled by digsig_verity_sb_root(), for a mounted
+		filesystem on the device
+Return value: 1 if it does, or if @table is of no device, 0 otherwise
+******************************************************************************/
+int digsig_verity_table_live(const struct digsig_verity_table *table)
+{
+	return !table->md || dm_get_table_nr(table->md) == table->nr;
+}
+
+/******************************************************************************
+Description : May the file be trusted from the dm-verity device under it?
+	Only asked of files whose superblock has the verity policy.
+Parameters  :
+	@file: the file about to be verified
+Return value: 1 if its signature need not be verified, 0 otherwise
+******************************************************************************/
+int digsig_verity_trusted(struct file *file)
+{
+	char alg[DIGSIG_VERITY_ALG_SIZE];
+	u8 digest[DIGSIG_VERITY_MAX_DIGEST];
+	int size, ret;
+
+	if (!ACCESS_ONCE(digsig_verity_count))
+		return 0;
+	size = digsig_verity_sb_root(file->f_dentry->d_inode->i_sb, alg,
+				     digest, NULL);
+	if (!size)
+		return 0;
+
+	rcu_read_lock();
+	ret = digsig_verity_find(alg, digest, size) != NULL;
+	rcu_read_unlock();
+
+	if (ret)
+		DSM_PRINT(DEBUG_SIGN, "%s: %s trusted from its verity root\n",
+			  __func__, file->f_dentry->d_name.name);
+	return ret;
+}
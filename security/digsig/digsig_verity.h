@@ -0,0 +1,64 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the trusted dm-verity roots.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_VERITY_H
+#define _DIGSIG_VERITY_H
+
+#include <linux/fs.h>
+#include <linux/types.h>
+
+#define DIGSIG_VERITY_MAGIC "DSVROOT1"
+#define DIGSIG_VERITY_ALG_SIZE 16
+#define DIGSIG_VERITY_MAX_DIGEST 64
+
+/*
+ * Format of a trusted root, written to /sys/digsig/verity_root:
+ * - struct digsig_verity_root_hdr
+ * - the root digest of the dm-verity table, digest_size bytes
+ * - a signature section of sig_size bytes, in the format of the ELF
+ *   signature section, signing everything before it
+ */
+struct digsig_verity_root_hdr {
+	u8 magic[8];
+	char alg[DIGSIG_VERITY_ALG_SIZE];	/* as in the table, NUL padded */
+	__le32 digest_size;
+	__le32 sig_size;
+} __packed;
+
+struct mapped_device;
+
+/*
+ * digsig_verity_table: the table a root was read from, to tell later
+ * whether the device still reads through it.  The device is not held:
+ * it is only looked at while the filesystem on it is mounted.
+ */
+struct digsig_verity_table {
+	struct mapped_device *md;	/* NULL if the root of none was read */
+	u32 nr;
+};
+
+#ifdef CONFIG_SECURITY_DIGSIG_VERITY
+extern int dsi_verity;
+int digsig_verity_add_root(char *buf, size_t count);
+int digsig_verity_sb_root(struct super_block *sb, char *alg, u8 *digest,
+			  struct digsig_verity_table *table);
+int digsig_verity_table_live(const struct digsig_verity_table *table);
+int digsig_verity_trusted(struct file *file);
+#else
+#define dsi_verity 0
+#define digsig_verity_add_root(buf, count) (-EINVAL)
+#define digsig_verity_sb_root(sb, alg, digest, table) 0
+#define digsig_verity_table_live(table) 1
+#define digsig_verity_trusted(file) 0
+#endif
+
+#endif /* _DIGSIG_VERITY_H */
@@ -0,0 +1,108 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file shows what DigSig holds, in /sys/kernel/security/digsig:
+ *
+ * entries: the verdicts in the cache, one per line, with how long ago
+ *	each was cached and how referenced it is since the CLOCK hand
+ *	last passed it: 0, 1 or 2 for twice or more.  Entries shown
+ *	with refs 0 and a small age, again and again, are being evicted
+ *	before they are used.
+ * revoked: the revoked signatures, by digest.
+ * keys: the keys loaded.
+ *
+ * The cache and the revocations are walked a bucket at a time, so that
+ * a dump of either never holds up verifications nor a resize.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/security.h>
+#include <linux/seq_file.h>
+
+#include "digsig_common.h"
+#include "digsig_sysfs.h"
+#include "digsig_cache.h"
+#include "digsig_revocation.h"
+#include "digsig_verify.h"
+#include "digsig_views.h"
+
+static int digsig_entries_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &digsig_cache_seq_ops);
+}
+
+static const struct file_operations digsig_entries_fops = {
+	.open = digsig_entries_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+static int digsig_revoked_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &digsig_revoked_seq_ops);
+}
+
+static const struct file_operations digsig_revoked_fops = {
+	.open = digsig_revoked_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+static int digsig_keys_seq(struct seq_file *m, void *v)
+{
+	digsig_keys_show(m);
+	return 0;
+}
+
+static int digsig_keys_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, digsig_keys_seq, NULL);
+}
+
+static const struct file_operations digsig_keys_fops = {
+	.open = digsig_keys_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const struct {
+	const char *name;
+	const struct file_operations *fops;
+} digsig_views[] = {
+	{ "entries", &digsig_entries_fops },
+	{ "revoked", &digsig_revoked_fops },
+	{ "keys", &digsig_keys_fops },
+};
+
+/******************************************************************************
+Description : Create the views of the cache, revocations and keys.
+Parameters  : none
+Return value: 0 on success, negative otherwise; DigSig runs without them
+******************************************************************************/
+int __init digsig_init_views(void)
+{
+	struct dentry *d;
+	int i;
+
+	if (!digsig_securityfs_dir)
+		return -ENOENT;
+
+	for (i = 0; i < ARRAY_SIZE(digsig_views); i++) {
+		d = securityfs_create_file(digsig_views[i].name, 0400,
+					   digsig_securityfs_dir, NULL,
+					   digsig_views[i].fops);
+		if (IS_ERR(d))
+			return PTR_ERR(d);
+	}
+	return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the views of the cache, revocations and keys.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_VIEWS_H
+#define _DIGSIG_VIEWS_H
+
+#ifdef CONFIG_SECURITY_DIGSIG_VIEWS
+int digsig_init_views(void);
+#else
+#define digsig_init_views() 0
+#endif
+
+#endif /* _DIGSIG_VIEWS_H */
@@ -0,0 +1,234 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file records successful signature verifications in the
+ * security.digsig extended attribute, so that a file which has not
+ * changed since it was last verified does not have to be read and
+ * hashed again after a reboot or after its inode left the icache.
+ *
+ * The stamp trusts the filesystem to keep security.* attributes out
+ * of reach of an attacker (userspace can not set or remove it while
+ * DigSig runs; offline changes must be prevented by other means, such
+ * as EVM or read-only media).  A stamp is only honoured if it was
+ * written under the same public key and revocation list, and if the
+ * file's generation, size, change time and, on filesystems that keep
+ * it, i_version are unchanged: unlike the modification time, the owner
+ * of the file can not set those back.  The stamp holds them as writing
+ * it leaves them, and it is removed as soon as the file is opened for
+ * writing, truncated or has its attributes changed.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/fs.h>
+#include <linux/xattr.h>
+#include <linux/string.h>
+#include <linux/time.h>
+
+#include "digsig_common.h"
+#include "digsig_verify.h"
+#include "digsig_revocation.h"
+#include "digsig_xattr.h"
+
+#include "digsig_inode.h"
+
+#define DIGSIG_XATTR_VERSION 2
+
+int dsi_xattr_cache = 0;
+module_param(dsi_xattr_cache, int, 0);
+MODULE_PARM_DESC(dsi_xattr_cache, "Record verifications in the security.digsig xattr.\n");
+
+/*
+ * digsig_xattr_stamp: the on-disk record.  Writing the attribute moves
+ * the ctime and i_version it holds: they are those the inode has once
+ * the stamp is written, see digsig_xattr_write().
+ */
+struct digsig_xattr_stamp {
+	u8 version;
+	u8 key_fpr[SHA1_DIGEST_LENGTH];
+	__le32 revocations;
+	__le32 generation;
+	__le64 size;
+	__le64 ctime_sec;
+	__le32 ctime_nsec;
+	__le64 i_version;
+} __packed;
+
+static inline u64 digsig_xattr_version(struct inode *inode)
+{
+	return digsig_inode_versioned(inode) ? inode->i_version : 0;
+}
+
+static void digsig_xattr_fill(struct digsig_xattr_stamp *s,
+			      struct inode *inode, struct timespec ctime,
+			      u64 version)
+{
+	memset(s, 0, sizeof(*s));
+	s->version = DIGSIG_XATTR_VERSION;
+	memcpy(s->key_fpr, digsig_key_fpr, sizeof(s->key_fpr));
+	s->revocations = cpu_to_le32(digsig_revocation_stamp());
+	s->generation = cpu_to_le32(inode->i_generation);
+	s->size = cpu_to_le64(i_size_read(inode));
+	s->ctime_sec = cpu_to_le64(ctime.tv_sec);
+	s->ctime_nsec = cpu_to_le32(ctime.tv_nsec);
+	s->i_version = cpu_to_le64(version);
+}
+
+/* Drop the stamp; called with i_mutex held. */
+static void digsig_xattr_remove(struct dentry *dentry)
+{
+	struct inode *inode = dentry->d_inode;
+	int rc;
+
+	if (!inode->i_op->removexattr)
+		return;
+	rc = inode->i_op->removexattr(dentry, XATTR_NAME_DIGSIG);
+	if (rc && rc != -ENODATA)
+		DSM_ERROR("%s: cannot remove the stamp of %s: %d\n", __func__,
+			  dentry->d_name.name, rc);
+}
+
+/*
+ * Write the stamp with the ctime and i_version writing it leaves: ctime
+ * is set back to the time taken before the write, and i_version is
+ * expected to move by one, or as much as it did on a first try.  A
+ * stamp that still does not match is removed.  Called with i_mutex held.
+ */
+static int digsig_xattr_write(struct dentry *dentry)
+{
+	struct inode *inode = dentry->d_inode;
+	struct digsig_xattr_stamp s;
+	struct timespec now;
+	u64 before, step;
+	int i, rc;
+
+	step = digsig_inode_versioned(inode) ? 1 : 0;
+	for (i = 0; i < 2; i++) {
+		now = current_fs_time(inode->i_sb);
+		before = digsig_xattr_version(inode);
+		digsig_xattr_fill(&s, inode, now, before + step);
+		rc = __vfs_setxattr_noperm(dentry, XATTR_NAME_DIGSIG, &s,
+					   sizeof(s), 0);
+		if (rc)
+			return rc;
+		inode->i_ctime = now;
+		mark_inode_dirty(inode);
+		if (digsig_xattr_version(inode) == before + step)
+			return 0;
+		step = digsig_xattr_version(inode) - before;
+	}
+	digsig_xattr_remove(dentry);
+	return -ESTALE;
+}
+
+/******************************************************************************
+Description : Does the file carry a stamp matching its current state?
+Parameters  :
+	@file: the file about to be verified
+Return value: 1 if the stamp allows skipping verification, 0 otherwise
+******************************************************************************/
+int digsig_xattr_trusted(struct file *file)
+{
+	struct dentry *dentry = file->f_dentry;
+	struct inode *inode = dentry->d_inode;
+	struct digsig_inode_sec *isec;
+	struct digsig_xattr_stamp disk, cur;
+	int rc;
+
+	if (!dsi_xattr_cache || !inode->i_op->getxattr ||
+	    !digsig_key_fpr_valid())
+		return 0;
+
+	rc = inode->i_op->getxattr(dentry, XATTR_NAME_DIGSIG, &disk,
+				   sizeof(disk));
+	if (rc != sizeof(disk))
+		return 0;
+
+	digsig_xattr_fill(&cur, inode, inode->i_ctime,
+			  digsig_xattr_version(inode));
+	if (memcmp(&disk, &cur, sizeof(disk)))
+		return 0;
+
+	/* without a blob, a write would leave the stamp behind */
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return 0;
+	set_bit(DIGSIG_INODE_STAMPED, &isec->flags);
+
+	DSM_PRINT(DEBUG_SIGN, "%s: %s trusted from its stamp\n", __func__,
+		  dentry->d_name.name);
+	return 1;
+}
+
+/******************************************************************************
+Description : Record a successful verification of the file.
+Parameters  :
+	@file: a file whose signature was just verified
+Return value: none; failing to stamp only costs a later verification
+******************************************************************************/
+void digsig_xattr_record(struct file *file)
+{
+	struct dentry *dentry = file->f_dentry;
+	struct inode *inode = dentry->d_inode;
+	struct digsig_inode_sec *isec;
+	int rc;
+
+	if (!dsi_xattr_cache || !inode->i_op->setxattr || IS_RDONLY(inode) ||
+	    !digsig_key_fpr_valid())
+		return;
+
+	if (!digsig_ctime_settled(inode))
+		return;
+
+	/* set first: a writer opening the file meanwhile removes the stamp */
+	isec = digsig_inode_get(inode);
+	if (!isec)
+		return;
+	set_bit(DIGSIG_INODE_STAMPED, &isec->flags);
+
+	mutex_lock(&inode->i_mutex);
+	rc = digsig_xattr_write(dentry);
+	mutex_unlock(&inode->i_mutex);
+
+	if (rc)
+		DSM_PRINT(DEBUG_SIGN, "%s: cannot stamp %s: %d\n", __func__,
+			  dentry->d_name.name, rc);
+}
+
+/******************************************************************************
+Description : Remove the stamp of a file about to change, if it may
+	carry one.  A file stamped before its inode was read has no blob,
+	but its ctime moves with the change.
+Parameters  :
+	@dentry: the file, opened for writing, truncated or with its
+	attributes changed
+	@locked: whether the caller holds its i_mutex
+Return value: none
+******************************************************************************/
+void digsig_xattr_forget(struct dentry *dentry, int locked)
+{
+	struct inode *inode = dentry->d_inode;
+	struct digsig_inode_sec *isec = digsig_inode_sec(inode);
+
+	if (!isec || !test_and_clear_bit(DIGSIG_INODE_STAMPED, &isec->flags))
+		return;
+	if (!locked)
+		mutex_lock(&inode->i_mutex);
+	digsig_xattr_remove(dentry);
+	if (!locked)
+		mutex_unlock(&inode->i_mutex);
+}
+
+/*
+ * Only DigSig itself may write the stamp.
+ */
+int digsig_xattr_protected(const char *name)
+{
+	return strcmp(name, XATTR_NAME_DIGSIG) == 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * Digital Signature (DigSig)
+ *
+ * This file contains the persistent verification cache.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#ifndef _DIGSIG_XATTR_H
+#define _DIGSIG_XATTR_H
+
+#include <linux/fs.h>
+#include <linux/xattr.h>
+
+#ifdef CONFIG_SECURITY_DIGSIG_XATTR
+int digsig_xattr_trusted(struct file *file);
+void digsig_xattr_record(struct file *file);
+void digsig_xattr_forget(struct dentry *dentry, int locked);
+int digsig_xattr_protected(const char *name);
+#else
+#define digsig_xattr_trusted(file) 0
+#define digsig_xattr_record(file) do { } while (0)
+#define digsig_xattr_forget(dentry, locked) do { } while (0)
+#define digsig_xattr_protected(name) 0
+#endif
+
+#endif /* _DIGSIG_XATTR_H */
@@ -95,7 +95,45 @@ rsa_verify( MPI hash, MPI *data, MPI *pkey)
 }
 
 
+/****************
+ * Like rsa_verify(), but with the Montgomery constants MONT of the
+ * modulus, which are used when the exponent fits into one limb.  RESULT
+ * receives s^e mod n and WS is the MPI_MONT_WS_LIMBS(mont) workspace;
+ * both belong to the caller, so that the call does not allocate.
+ */
+int
+rsa_verify_mont( MPI hash, MPI *data, MPI *pkey, MPI_MONT_CTX mont,
+		 MPI result, mpi_limb_t *ws )
+{
+  RSA_public_key pk;
+
+  pk.n = pkey[0];
+  pk.e = pkey[1];
+  if( !mont || !ws || pk.e->nlimbs != 1 )
+    return rsa_verify( hash, data, pkey );
 
+  if( mpi_powm_mont_ws( result, data[0], pk.e->d[0], mont, ws ) )
+    public( result, data[0], &pk );
+  return mpi_cmp( result, hash )? G10ERR_BAD_SIGN:0;
+}
 
 
+/****************
+ * Compute RESULT = DATA^e mod n, with the Montgomery constants MONT of
+ * the modulus and the workspace WS when they can be used, as in
+ * rsa_verify_mont().  The caller checks the result itself, usually by
+ * comparing its encoding.
+ */
+void
+rsa_public_mont( MPI result, MPI data, MPI *pkey, MPI_MONT_CTX mont,
+		 mpi_limb_t *ws )
+{
+  RSA_public_key pk;
 
+  pk.n = pkey[0];
+  pk.e = pkey[1];
+  if( mont && ws && pk.e->nlimbs == 1
+      && !mpi_powm_mont_ws( result, data, pk.e->d[0], mont, ws ) )
+    return;
+  public( result, data, &pk );
+}
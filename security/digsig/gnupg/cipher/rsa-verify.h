@@ -25,5 +25,9 @@
 #include "../mpi/mpi.h"
 
 int rsa_verify( MPI hash, MPI *data, MPI *pkey);
+int rsa_verify_mont( MPI hash, MPI *data, MPI *pkey, MPI_MONT_CTX mont,
+		     MPI result, mpi_limb_t *ws );
+void rsa_public_mont( MPI result, MPI data, MPI *pkey, MPI_MONT_CTX mont,
+		      mpi_limb_t *ws );
 
 #endif /*G10_RSA_H*/
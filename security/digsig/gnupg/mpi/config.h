@@ -419,8 +419,10 @@
 /* The size of a `unsigned int', as computed by sizeof. */
 #define SIZEOF_UNSIGNED_INT 4
 
-/* The size of a `unsigned long', as computed by sizeof. */
-#define SIZEOF_UNSIGNED_LONG 4
+/* The size of a `unsigned long', as computed by sizeof.  It is also the
+   size of a limb, so limbs are 64 bits on 64 bit kernels. */
+#include <asm/bitsperlong.h>
+#define SIZEOF_UNSIGNED_LONG (BITS_PER_LONG / 8)
 
 /* The size of a `unsigned long long', as computed by sizeof. */
 #define SIZEOF_UNSIGNED_LONG_LONG 8
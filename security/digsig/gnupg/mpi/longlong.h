@@ -482,6 +482,89 @@ extern USItype __udiv_qrnnd ();
 #endif /* 80x86 */
 
 
+/***************************************
+ **************  AMD64  ****************
+ ***************************************/
+#if defined (__x86_64__) && W_TYPE_SIZE == 64
+#define add_ssaaaa(sh, sl, ah, al, bh, bl) \
+  __asm__ ("addq %5,%1\n"                                               \
+	   "adcq %3,%0"                                                 \
+	   : "=r" (sh),                                                 \
+	     "=&r" (sl)                                                 \
+	   : "0" ((UDItype)(ah)),                                       \
+	     "rme" ((UDItype)(bh)),                                     \
+	     "1" ((UDItype)(al)),                                       \
+	     "rme" ((UDItype)(bl)))
+#define sub_ddmmss(sh, sl, ah, al, bh, bl) \
+  __asm__ ("subq %5,%1\n"                                               \
+	   "sbbq %3,%0"                                                 \
+	   : "=r" (sh),                                                 \
+	     "=&r" (sl)                                                 \
+	   : "0" ((UDItype)(ah)),                                       \
+	     "rme" ((UDItype)(bh)),                                     \
+	     "1" ((UDItype)(al)),                                       \
+	     "rme" ((UDItype)(bl)))
+#define umul_ppmm(w1, w0, u, v) \
+  __asm__ ("mulq %3"                                                    \
+	   : "=a" (w0),                                                 \
+	     "=d" (w1)                                                  \
+	   : "%0" ((UDItype)(u)),                                       \
+	     "rm" ((UDItype)(v)))
+#define udiv_qrnnd(q, r, n1, n0, d) \
+  __asm__ ("divq %4"                                                    \
+	   : "=a" (q),                                                  \
+	     "=d" (r)                                                   \
+	   : "0" ((UDItype)(n0)),                                       \
+	     "1" ((UDItype)(n1)),                                       \
+	     "rm" ((UDItype)(d)))
+#define count_leading_zeros(count, x) \
+  do {									\
+    UDItype __cbtmp;							\
+    __asm__ ("bsrq %1,%0"                                               \
+	     : "=r" (__cbtmp) : "rm" ((UDItype)(x)));                   \
+    (count) = __cbtmp ^ 63;						\
+  } while (0)
+#define count_trailing_zeros(count, x) \
+  do {									\
+    UDItype __cbtmp;							\
+    __asm__ ("bsfq %1,%0"                                               \
+	     : "=r" (__cbtmp) : "rm" ((UDItype)(x)));                   \
+    (count) = __cbtmp;							\
+  } while (0)
+#ifndef UMUL_TIME
+#define UMUL_TIME 3
+#endif
+#ifndef UDIV_TIME
+#define UDIV_TIME 40
+#endif
+#endif /* __x86_64__ */
+
+
+/***************************************
+ **************  ARM64  ****************
+ ***************************************/
+#if defined (__aarch64__) && W_TYPE_SIZE == 64
+#define umul_ppmm(w1, w0, u, v) \
+  do {									\
+    UDItype __m0 = (u), __m1 = (v);					\
+    __asm__ ("umulh %0,%1,%2"                                           \
+	     : "=r" (w1) : "r" (__m0), "r" (__m1));                     \
+    (w0) = __m0 * __m1;							\
+  } while (0)
+#define count_leading_zeros(count, x) \
+  do {									\
+    UDItype __cbtmp;							\
+    __asm__ ("clz %0,%1"                                                \
+	     : "=r" (__cbtmp) : "r" ((UDItype)(x)));                    \
+    (count) = __cbtmp;							\
+  } while (0)
+#define COUNT_LEADING_ZEROS_0 64
+#ifndef UMUL_TIME
+#define UMUL_TIME 4
+#endif
+#endif /* __aarch64__ */
+
+
 /***************************************
  **************  I860  *****************
  ***************************************/
@@ -25,9 +25,9 @@
 #include <linux/slab.h>
 
 #define m_alloc(n)		kmalloc(n, GFP_KERNEL)
-#define m_alloc_clear(n)	kmalloc(n, GFP_KERNEL) /* can't memset, no size or don't know how to get it */
+#define m_alloc_clear(n)	kzalloc(n, GFP_KERNEL)
 #define m_alloc_secure(n)	kmalloc(n, GFP_KERNEL)
-#define m_alloc_secure_clear(n) kmalloc(n, GFP_KERNEL) /* can't memset, no size or don't know how to get it */
+#define m_alloc_secure_clear(n) kzalloc(n, GFP_KERNEL)
 #define m_free(n)		kfree(n) 
 #define m_check(n)		/* nothing to do here */
 #define m_size(n)               sizeof(n)
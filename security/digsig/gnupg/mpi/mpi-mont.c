@@ -0,0 +1,204 @@
+/* mpi-mont.c  -  Montgomery exponentiation for small exponents
+ *
+ * This file is part of DigSig.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Note: RSA verification raises the signature to the public exponent,
+ *	 which is small (usually 65537).  mpi_powm() reduces by long
+ *	 division after every step; here the products are reduced with
+ *	 Montgomery's method instead, using constants computed once per
+ *	 modulus by mpi_mont_alloc().
+ */
+
+#include <linux/string.h>
+#include "mpi-internal.h"
+#include "longlong.h"
+
+
+/****************
+ * Return -1/N0 mod 2^BITS_PER_MPI_LIMB for an odd N0.  Each Newton
+ * step doubles the number of correct low bits, starting with 3.
+ */
+static mpi_limb_t
+mont_ninv( mpi_limb_t n0 )
+{
+    mpi_limb_t inv = n0;
+    int i;
+
+    for( i = 0; i < 6; i++ )
+	inv *= 2 - n0 * inv;
+    return -inv;
+}
+
+
+/****************
+ * Set up the Montgomery constants of MOD.  Returns NULL if MOD is not
+ * odd, or if there is no memory.
+ */
+MPI_MONT_CTX
+mpi_mont_alloc( MPI mod )
+{
+    MPI_MONT_CTX ctx;
+    MPI r = MPI_NULL, rr = MPI_NULL;
+    mpi_size_t k = mod->nlimbs;
+
+    if( !k || mod->sign || !(mod->d[0] & 1) )
+	return NULL;
+
+    ctx = m_alloc( sizeof *ctx );
+    if( !ctx )
+	return NULL;
+    ctx->nlimbs = k;
+    ctx->fixed = 0;
+    ctx->n = mpi_alloc_limb_space( 2 * k, 0 );
+    if( !ctx->n )
+	goto fail;
+    ctx->rr = ctx->n + k;
+    MPN_COPY( ctx->n, mod->d, k );
+    ctx->ninv = mont_ninv( mod->d[0] );
+
+    /* R^2 mod n */
+    r = mpi_alloc_set_ui( 1 );
+    rr = mpi_alloc( k + 1 );
+    if( !r || !rr )
+	goto fail;
+    mpi_mul_2exp( r, r, 2 * k * BITS_PER_MPI_LIMB );
+    mpi_fdiv_r( rr, r, mod );
+    MPN_ZERO( ctx->rr, k );
+    MPN_COPY( ctx->rr, rr->d, rr->nlimbs );
+    mpi_free( r );
+    mpi_free( rr );
+    return ctx;
+
+  fail:
+    mpi_free( r );
+    mpi_free( rr );
+    mpi_mont_free( ctx );
+    return NULL;
+}
+
+
+void
+mpi_mont_free( MPI_MONT_CTX ctx )
+{
+    if( !ctx || ctx->fixed )
+	return;
+    if( ctx->n )
+	mpi_free_limb_space( ctx->n );
+    m_free( ctx );
+}
+
+
+/****************
+ * Montgomery reduction: RP = TP / R mod n, for TP < n * R.  TP has
+ * 2 * nlimbs + 1 limbs, the top one zero, and is destroyed.
+ */
+static void
+mont_redc( mpi_ptr_t rp, mpi_ptr_t tp, MPI_MONT_CTX ctx )
+{
+    mpi_size_t k = ctx->nlimbs, i;
+    mpi_limb_t m, cy;
+
+    for( i = 0; i < k; i++ ) {
+	m = tp[i] * ctx->ninv;
+	cy = mpihelp_addmul_1( tp + i, ctx->n, k, m );
+	mpihelp_add_1( tp + i + k, tp + i + k, k + 1 - i, cy );
+    }
+
+    /* the result is below 2n, one subtraction brings it below n */
+    if( tp[2 * k] || mpihelp_cmp( tp + k, ctx->n, k ) >= 0 )
+	mpihelp_sub_n( rp, tp + k, ctx->n, k );
+    else
+	MPN_COPY( rp, tp + k, k );
+}
+
+
+/* RP = AP * BP / R mod n; TP and TSPACE are work areas */
+static void
+mont_mul( mpi_ptr_t rp, mpi_ptr_t ap, mpi_ptr_t bp, MPI_MONT_CTX ctx,
+	  mpi_ptr_t tp, mpi_ptr_t tspace )
+{
+    mpi_size_t k = ctx->nlimbs;
+
+    mpihelp_mul_n_ws( tp, ap, bp, k, tspace );
+    tp[2 * k] = 0;
+    mont_redc( rp, tp, ctx );
+}
+
+
+/****************
+ * RES = BASE ^ EXP mod n, for a one-limb exponent, using the
+ * MPI_MONT_WS_LIMBS(ctx) limbs at WS as workspace.  Returns -1, leaving
+ * RES alone, if BASE is not below n or EXP is zero; the caller then
+ * uses mpi_powm().  RES must have room for nlimbs limbs if it is not
+ * to be resized.
+ */
+int
+mpi_powm_mont_ws( MPI res, MPI base, mpi_limb_t exp, MPI_MONT_CTX ctx,
+		  mpi_limb_t *ws )
+{
+    mpi_size_t k = ctx->nlimbs, rsize;
+    mpi_ptr_t ap, am, xp, tp, tspace;
+    int i;
+
+    if( !exp || base->sign || base->nlimbs > k )
+	return -1;
+
+    /* a, a*R, x, the product and the multiplication scratch */
+    ap = ws;
+    am = ap + k;
+    xp = am + k;
+    tp = xp + k;
+    tspace = tp + 2 * k + 1;
+
+    MPN_ZERO( ap, k );
+    MPN_COPY( ap, base->d, base->nlimbs );
+    if( mpihelp_cmp( ap, ctx->n, k ) >= 0 )
+	return -1;
+
+    /* into the Montgomery domain, then left to right square and multiply */
+    mont_mul( am, ap, ctx->rr, ctx, tp, tspace );
+    MPN_COPY( xp, am, k );
+    for( i = BITS_PER_MPI_LIMB - 2; i >= 0 && !(exp >> (i + 1)); i-- )
+	;
+    for( ; i >= 0; i-- ) {
+	mont_mul( xp, xp, xp, ctx, tp, tspace );
+	if( exp & ((mpi_limb_t)1 << i) )
+	    mont_mul( xp, xp, am, ctx, tp, tspace );
+    }
+
+    /* and back out of it */
+    MPN_ZERO( tp, 2 * k + 1 );
+    MPN_COPY( tp, xp, k );
+    mont_redc( xp, tp, ctx );
+
+    RESIZE_IF_NEEDED( res, k );
+    MPN_COPY( res->d, xp, k );
+    rsize = k;
+    MPN_NORMALIZE( res->d, rsize );
+    res->nlimbs = rsize;
+    res->sign = 0;
+    return 0;
+}
+
+
+/****************
+ * Same as mpi_powm_mont_ws(), with a workspace allocated for the call.
+ */
+int
+mpi_powm_mont( MPI res, MPI base, mpi_limb_t exp, MPI_MONT_CTX ctx )
+{
+    mpi_ptr_t ws;
+    int rc;
+
+    ws = mpi_alloc_limb_space( MPI_MONT_WS_LIMBS(ctx), 0 );
+    if( !ws )
+	return -1;
+    rc = mpi_powm_mont_ws( res, base, exp, ctx, ws );
+    mpi_free_limb_space( ws );
+    return rc;
+}
@@ -0,0 +1,121 @@
+/* mpi-names.h  -  keep this MPI library apart from lib/mpi
+ *
+ * This file is part of DigSig.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Note: lib/mpi was derived from the same GnuPG code and exports most
+ *	 of the same names.  It is linked in whenever module signing,
+ *	 integrity signatures or asymmetric keys are configured, so all
+ *	 global symbols of this copy get a digsig_ prefix.  This file
+ *	 is included first by mpi.h and by the assembly files.
+ */
+
+#ifndef G10_MPI_NAMES_H
+#define G10_MPI_NAMES_H
+
+#define __clz_tab digsig___clz_tab
+#define mpi_add digsig_mpi_add
+#define mpi_add_ui digsig_mpi_add_ui
+#define mpi_addm digsig_mpi_addm
+#define mpi_alloc digsig_mpi_alloc
+#define mpi_alloc_like digsig_mpi_alloc_like
+#define mpi_alloc_limb_space digsig_mpi_alloc_limb_space
+#define mpi_alloc_secure digsig_mpi_alloc_secure
+#define mpi_alloc_set_ui digsig_mpi_alloc_set_ui
+#define mpi_assign_limb_space digsig_mpi_assign_limb_space
+#define mpi_clear digsig_mpi_clear
+#define mpi_clear_bit digsig_mpi_clear_bit
+#define mpi_clear_highbit digsig_mpi_clear_highbit
+#define mpi_cmp digsig_mpi_cmp
+#define mpi_cmp_ui digsig_mpi_cmp_ui
+#define mpi_copy digsig_mpi_copy
+#define mpi_debug_alloc digsig_mpi_debug_alloc
+#define mpi_debug_alloc_like digsig_mpi_debug_alloc_like
+#define mpi_debug_alloc_limb_space digsig_mpi_debug_alloc_limb_space
+#define mpi_debug_alloc_secure digsig_mpi_debug_alloc_secure
+#define mpi_debug_copy digsig_mpi_debug_copy
+#define mpi_debug_free digsig_mpi_debug_free
+#define mpi_debug_free_limb_space digsig_mpi_debug_free_limb_space
+#define mpi_debug_resize digsig_mpi_debug_resize
+#define mpi_divisible_ui digsig_mpi_divisible_ui
+#define mpi_fdiv_q digsig_mpi_fdiv_q
+#define mpi_fdiv_qr digsig_mpi_fdiv_qr
+#define mpi_fdiv_r digsig_mpi_fdiv_r
+#define mpi_fdiv_r_ui digsig_mpi_fdiv_r_ui
+#define mpi_free digsig_mpi_free
+#define mpi_free_limb_space digsig_mpi_free_limb_space
+#define mpi_fromstr digsig_mpi_fromstr
+#define mpi_gcd digsig_mpi_gcd
+#define mpi_get_buffer digsig_mpi_get_buffer
+#define mpi_get_buffer_fixed digsig_mpi_get_buffer_fixed
+#define mpi_get_keyid digsig_mpi_get_keyid
+#define mpi_get_nbits digsig_mpi_get_nbits
+#define mpi_get_opaque digsig_mpi_get_opaque
+#define mpi_get_secure_buffer digsig_mpi_get_secure_buffer
+#define mpi_getbyte digsig_mpi_getbyte
+#define mpi_init_pool digsig_mpi_init_pool
+#define mpi_invm digsig_mpi_invm
+#define mpi_lshift_limbs digsig_mpi_lshift_limbs
+#define mpi_m_check digsig_mpi_m_check
+#define mpi_mont_alloc digsig_mpi_mont_alloc
+#define mpi_mont_free digsig_mpi_mont_free
+#define mpi_mul digsig_mpi_mul
+#define mpi_mul_2exp digsig_mpi_mul_2exp
+#define mpi_mul_ui digsig_mpi_mul_ui
+#define mpi_mulm digsig_mpi_mulm
+#define mpi_mulpowm digsig_mpi_mulpowm
+#define mpi_normalize digsig_mpi_normalize
+#define mpi_powm digsig_mpi_powm
+#define mpi_powm_mont digsig_mpi_powm_mont
+#define mpi_powm_mont_ws digsig_mpi_powm_mont_ws
+#define mpi_putbyte digsig_mpi_putbyte
+#define mpi_read_from_buffer digsig_mpi_read_from_buffer
+#define mpi_read_from_buffer_fixed digsig_mpi_read_from_buffer_fixed
+#define mpi_resize digsig_mpi_resize
+#define mpi_rshift digsig_mpi_rshift
+#define mpi_rshift_limbs digsig_mpi_rshift_limbs
+#define mpi_set digsig_mpi_set
+#define mpi_set_bit digsig_mpi_set_bit
+#define mpi_set_buffer digsig_mpi_set_buffer
+#define mpi_set_highbit digsig_mpi_set_highbit
+#define mpi_set_opaque digsig_mpi_set_opaque
+#define mpi_set_secure digsig_mpi_set_secure
+#define mpi_set_ui digsig_mpi_set_ui
+#define mpi_sub digsig_mpi_sub
+#define mpi_sub_ui digsig_mpi_sub_ui
+#define mpi_subm digsig_mpi_subm
+#define mpi_swap digsig_mpi_swap
+#define mpi_tdiv_q_2exp digsig_mpi_tdiv_q_2exp
+#define mpi_tdiv_qr digsig_mpi_tdiv_qr
+#define mpi_tdiv_r digsig_mpi_tdiv_r
+#define mpi_test_bit digsig_mpi_test_bit
+#define mpi_trailing_zeros digsig_mpi_trailing_zeros
+#define mpih_sqr_n digsig_mpih_sqr_n
+#define mpih_sqr_n_basecase digsig_mpih_sqr_n_basecase
+#define mpihelp_add digsig_mpihelp_add
+#define mpihelp_add_1 digsig_mpihelp_add_1
+#define mpihelp_add_n digsig_mpihelp_add_n
+#define mpihelp_addmul_1 digsig_mpihelp_addmul_1
+#define mpihelp_cmp digsig_mpihelp_cmp
+#define mpihelp_divmod_1 digsig_mpihelp_divmod_1
+#define mpihelp_divrem digsig_mpihelp_divrem
+#define mpihelp_lshift digsig_mpihelp_lshift
+#define mpihelp_mod_1 digsig_mpihelp_mod_1
+#define mpihelp_mul digsig_mpihelp_mul
+#define mpihelp_mul_1 digsig_mpihelp_mul_1
+#define mpihelp_mul_karatsuba_case digsig_mpihelp_mul_karatsuba_case
+#define mpihelp_mul_n digsig_mpihelp_mul_n
+#define mpihelp_mul_n_ws digsig_mpihelp_mul_n_ws
+#define mpihelp_release_karatsuba_ctx digsig_mpihelp_release_karatsuba_ctx
+#define mpihelp_rshift digsig_mpihelp_rshift
+#define mpihelp_sub digsig_mpihelp_sub
+#define mpihelp_sub_1 digsig_mpihelp_sub_1
+#define mpihelp_sub_n digsig_mpihelp_sub_n
+#define mpihelp_submul_1 digsig_mpihelp_submul_1
+#define mpihelp_udiv_w_sdiv digsig_mpihelp_udiv_w_sdiv
+
+#endif /*G10_MPI_NAMES_H*/
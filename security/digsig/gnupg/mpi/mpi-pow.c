@@ -30,9 +30,131 @@
 #include "mpi-internal.h"
 #include "longlong.h"
 
+/* Exponents of up to this many bits are taken bit by bit: for the usual
+ * 3 or 65537 a table of powers costs more than it saves.  */
+#define POWM_WINDOW_THRESHOLD 32
+#define POWM_MAX_WINDOW 6
+
+#define POWM_BIT(ep, n) \
+	((ep)[(n) / BITS_PER_MPI_LIMB] >> ((n) % BITS_PER_MPI_LIMB) & 1)
+
+
+/****************
+ * Return the window size for an exponent of EBITS bits, the one with the
+ * fewest multiplications, counting those making the table of 2^(W-1)
+ * odd powers.  These are the thresholds of the GNU MP Library.
+ */
+static int
+powm_window( mpi_size_t ebits )
+{
+    if( ebits <= POWM_WINDOW_THRESHOLD )
+	return 1;
+    if( ebits <= 81 )
+	return 3;
+    if( ebits <= 241 )
+	return 4;
+    if( ebits <= 673 )
+	return 5;
+    return POWM_MAX_WINDOW;
+}
+
+
+/****************
+ * XP = UP^2 mod MP.  Returns the size of XP, which is not normalized.
+ * *TSPACE is the scratch area of the Karatsuba squaring, of *TSIZE
+ * limbs, and is grown as needed.
+ */
+static mpi_size_t
+powm_sqr( mpi_ptr_t xp, mpi_ptr_t up, mpi_size_t usize,
+	  mpi_ptr_t mp, mpi_size_t msize,
+	  mpi_ptr_t *tspace, mpi_size_t *tsize )
+{
+    mpi_size_t xsize;
+
+    /*mpihelp_mul_n(xp, up, up, usize);*/
+    if( usize < KARATSUBA_THRESHOLD )
+	mpih_sqr_n_basecase( xp, up, usize );
+    else {
+	if( !*tspace ) {
+	    *tsize = 2 * usize;
+	    *tspace = mpi_alloc_limb_space( *tsize, 0 );
+	}
+	else if( *tsize < (2*usize) ) {
+	    mpi_free_limb_space( *tspace );
+	    *tsize = 2 * usize;
+	    *tspace = mpi_alloc_limb_space( *tsize, 0 );
+	}
+	mpih_sqr_n( xp, up, usize, *tspace );
+    }
+
+    xsize = 2 * usize;
+    if( xsize > msize ) {
+	mpihelp_divrem(xp + msize, 0, xp, xsize, mp, msize);
+	xsize = msize;
+    }
+    return xsize;
+}
+
+
+/****************
+ * XP = UP * VP mod MP, in either order of sizes.  Returns the size of
+ * XP, which is not normalized.
+ */
+static mpi_size_t
+powm_mul( mpi_ptr_t xp, mpi_ptr_t up, mpi_size_t usize,
+	  mpi_ptr_t vp, mpi_size_t vsize, mpi_ptr_t mp, mpi_size_t msize,
+	  struct karatsuba_ctx *karactx )
+{
+    mpi_size_t xsize;
+
+    if( usize < vsize ) {
+	mpi_ptr_t tp = up; up = vp; vp = tp;
+	xsize = usize; usize = vsize; vsize = xsize;
+    }
+
+    if( vsize < KARATSUBA_THRESHOLD )
+	mpihelp_mul( xp, up, usize, vp, vsize );
+    else
+	mpihelp_mul_karatsuba_case( xp, up, usize, vp, vsize, karactx );
+
+    xsize = usize + vsize;
+    if( xsize > msize ) {
+	mpihelp_divrem(xp + msize, 0, xp, xsize, mp, msize);
+	xsize = msize;
+    }
+    return xsize;
+}
+
+
+/****************
+ * Return the window of EP whose top bit is BIT, which is set: up to W
+ * bits, ending with a set one, whose position is stored at *LOW.
+ */
+static mpi_limb_t
+powm_window_value( mpi_ptr_t ep, mpi_size_t bit, int w, mpi_size_t *low )
+{
+    mpi_size_t l;
+    mpi_limb_t v = 0;
+
+    l = bit - w + 1;
+    if( l < 0 )
+	l = 0;
+    while( !POWM_BIT( ep, l ) )
+	l++;
+    *low = l;
+    for( l = bit; l >= *low; l-- )
+	v = (v << 1) | POWM_BIT( ep, l );
+    return v;
+}
+
 
 /****************
  * RES = BASE ^ EXP mod MOD
+ *
+ * Exponents of more than POWM_WINDOW_THRESHOLD bits are taken by sliding
+ * windows, with a table of the odd powers of BASE: a key with a large or
+ * random public exponent then costs about one multiplication every W + 1
+ * bits, instead of one every other bit, on top of the squarings.
  */
 void
 mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
@@ -48,6 +170,7 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
     mpi_ptr_t xp_marker=NULL;
     int assign_rp=0;
     mpi_ptr_t tspace = NULL;
+    mpi_ptr_t tab_marker = NULL;
     mpi_size_t tsize=0;   /* to avoid compiler warning */
 			  /* fixme: we should check that the warning is void*/
 
@@ -152,7 +275,7 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
     {
 	mpi_size_t i;
 	mpi_ptr_t xp = xp_marker = mpi_alloc_limb_space( 2 * (msize + 1), msec );
-	int c;
+	int c, w;
 	mpi_limb_t e;
 	mpi_limb_t carry_limb;
 	struct karatsuba_ctx karactx;
@@ -160,6 +283,55 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
 	memset( &karactx, 0, sizeof karactx );
 	negative_result = (ep[0] & 1) && base->sign;
 
+	count_leading_zeros( c, ep[esize-1] );
+	w = powm_window( esize * BITS_PER_MPI_LIMB - c );
+	if( w > 1 ) {
+	    mpi_size_t tabsize[1 << (POWM_MAX_WINDOW - 1)];
+	    mpi_ptr_t tab, tp;
+	    mpi_size_t bit, low, l;
+	    mpi_limb_t v;
+	    int j, n = 1 << (w - 1);
+
+	    /* The odd powers b, b^3, ..., b^(2^W - 1), each the one below
+	     * times b^2, which is kept at RP meanwhile.  */
+	    tab = tab_marker = mpi_alloc_limb_space( n * msize, bsec );
+	    MPN_COPY( tab, bp, bsize );
+	    tabsize[0] = bsize;
+	    rsize = powm_sqr( rp, bp, bsize, mp, msize, &tspace, &tsize );
+	    for( j = 1; j < n; j++ ) {
+		tabsize[j] = powm_mul( xp, tab + (j-1) * msize, tabsize[j-1],
+				       rp, rsize, mp, msize, &karactx );
+		MPN_COPY( tab + j * msize, xp, tabsize[j] );
+	    }
+
+	    /* The top window starts the result, then each bit is a squaring,
+	     * and each window a multiplication by its odd power.  */
+	    bit = esize * BITS_PER_MPI_LIMB - c - 1;
+	    v = powm_window_value( ep, bit, w, &low );
+	    rsize = tabsize[v >> 1];
+	    MPN_COPY( rp, tab + (v >> 1) * msize, rsize );
+	    for( bit = low - 1; bit >= 0; ) {
+		if( !POWM_BIT( ep, bit ) ) {
+		    rsize = powm_sqr( xp, rp, rsize, mp, msize,
+				      &tspace, &tsize );
+		    tp = rp; rp = xp; xp = tp;
+		    bit--;
+		    continue;
+		}
+		v = powm_window_value( ep, bit, w, &low );
+		for( l = bit; l >= low; l-- ) {
+		    rsize = powm_sqr( xp, rp, rsize, mp, msize,
+				      &tspace, &tsize );
+		    tp = rp; rp = xp; xp = tp;
+		}
+		rsize = powm_mul( xp, rp, rsize, tab + (v >> 1) * msize,
+				  tabsize[v >> 1], mp, msize, &karactx );
+		tp = rp; rp = xp; xp = tp;
+		bit = low - 1;
+	    }
+	    goto reduce;
+	}
+
 	i = esize - 1;
 	e = ep[i];
 	count_leading_zeros (c, e);
@@ -179,51 +351,14 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
 	for(;;) {
 	    while( c ) {
 		mpi_ptr_t tp;
-		mpi_size_t xsize;
-
-		/*mpihelp_mul_n(xp, rp, rp, rsize);*/
-		if( rsize < KARATSUBA_THRESHOLD )
-		    mpih_sqr_n_basecase( xp, rp, rsize );
-		else {
-		    if( !tspace ) {
-			tsize = 2 * rsize;
-			tspace = mpi_alloc_limb_space( tsize, 0 );
-		    }
-		    else if( tsize < (2*rsize) ) {
-			mpi_free_limb_space( tspace );
-			tsize = 2 * rsize;
-			tspace = mpi_alloc_limb_space( tsize, 0 );
-		    }
-		    mpih_sqr_n( xp, rp, rsize, tspace );
-		}
-
-		xsize = 2 * rsize;
-		if( xsize > msize ) {
-		    mpihelp_divrem(xp + msize, 0, xp, xsize, mp, msize);
-		    xsize = msize;
-		}
 
+		rsize = powm_sqr( xp, rp, rsize, mp, msize, &tspace, &tsize );
 		tp = rp; rp = xp; xp = tp;
-		rsize = xsize;
 
 		if( (mpi_limb_signed_t)e < 0 ) {
-		    /*mpihelp_mul( xp, rp, rsize, bp, bsize );*/
-		    if( bsize < KARATSUBA_THRESHOLD ) {
-			mpihelp_mul( xp, rp, rsize, bp, bsize );
-		    }
-		    else {
-			mpihelp_mul_karatsuba_case(
-				     xp, rp, rsize, bp, bsize, &karactx );
-		    }
-
-		    xsize = rsize + bsize;
-		    if( xsize > msize ) {
-			mpihelp_divrem(xp + msize, 0, xp, xsize, mp, msize);
-			xsize = msize;
-		    }
-
+		    rsize = powm_mul( xp, rp, rsize, bp, bsize, mp, msize,
+				      &karactx );
 		    tp = rp; rp = xp; xp = tp;
-		    rsize = xsize;
 		}
 		e <<= 1;
 		c--;
@@ -236,6 +371,7 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
 	    c = BITS_PER_MPI_LIMB;
 	}
 
+      reduce:
 	/* We shifted MOD, the modulo reduction argument, left MOD_SHIFT_CNT
 	 * steps.  Adjust the result by reducing it with the original MOD.
 	 *
@@ -286,5 +422,6 @@ mpi_powm( MPI res, MPI base, MPI exp, MPI mod)
     if( ep_marker ) mpi_free_limb_space( ep_marker );
     if( xp_marker ) mpi_free_limb_space( xp_marker );
     if( tspace )    mpi_free_limb_space( tspace );
+    if( tab_marker ) mpi_free_limb_space( tab_marker );
 }
 
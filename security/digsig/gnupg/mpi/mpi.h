@@ -30,6 +30,7 @@
 #ifndef G10_MPI_H
 #define G10_MPI_H
 
+#include "mpi-names.h"
 #include "config.h"
 #include "types.h"
 #include "memory.h" 
@@ -44,8 +45,8 @@
 #define log_bug printk
 
 #define assert(x) do { \
-               if (!x) log_bug("failed assertion\n"); \
-	       } while(0);
+               if (!(x)) log_bug("failed assertion\n"); \
+	       } while (0)
 
 #if BYTES_PER_MPI_LIMB == SIZEOF_UNSIGNED_INT
   typedef unsigned int mpi_limb_t;
@@ -96,6 +97,7 @@ typedef struct gcry_mpi *MPI;
 
 /*-- mpiutil.c --*/
 
+int mpi_init_pool(void);
 MPI mpi_alloc( unsigned nlimbs );
 MPI mpi_alloc_secure( unsigned nlimbs );
 MPI mpi_alloc_like( MPI a );
@@ -116,10 +118,14 @@ void mpi_swap( MPI a, MPI b);
 
 /*-- mpicoder.c --*/
 MPI do_encode_md(const byte *sha_buffer, unsigned nbits);
+MPI do_encode_md_asn(const byte *md, unsigned mdlen, const byte *asnp,
+		     unsigned asnlen, unsigned nbits);
 MPI mpi_read_from_buffer(const byte *buffer, unsigned *ret_nread, int secure);
+int mpi_read_from_buffer_fixed(MPI val, const byte *buffer, unsigned *ret_nread);
 int mpi_fromstr(MPI val, const char *str);
 u32 mpi_get_keyid( MPI a, u32 *keyid );
 byte *mpi_get_buffer( MPI a, unsigned *nbytes, int *sign );
+int mpi_get_buffer_fixed( MPI a, byte *buffer, unsigned nbytes );
 byte *mpi_get_secure_buffer( MPI a, unsigned *nbytes, int *sign );
 void  mpi_set_buffer( MPI a, const byte *buffer, unsigned nbytes, int sign );
 
@@ -156,6 +162,25 @@ int mpi_gcd( MPI g, MPI a, MPI b );
 void mpi_pow( MPI w, MPI u, MPI v);
 void mpi_powm( MPI res, MPI base, MPI exp, MPI mod);
 
+/*-- mpi-mont.c --*/
+struct mpi_mont_ctx_s {
+    int nlimbs;		/* size of the modulus */
+    mpi_limb_t *n;	/* the modulus */
+    mpi_limb_t *rr;	/* R^2 mod n, with R = 2^(nlimbs * BITS_PER_MPI_LIMB) */
+    mpi_limb_t ninv;	/* -1/n mod 2^BITS_PER_MPI_LIMB */
+    int fixed;		/* the constants are static, never freed */
+};
+typedef struct mpi_mont_ctx_s *MPI_MONT_CTX;
+
+/* limbs of workspace mpi_powm_mont_ws() needs */
+#define MPI_MONT_WS_LIMBS(c) (7 * (c)->nlimbs + 1)
+
+MPI_MONT_CTX mpi_mont_alloc( MPI mod );
+void mpi_mont_free( MPI_MONT_CTX ctx );
+int mpi_powm_mont( MPI res, MPI base, mpi_limb_t exp, MPI_MONT_CTX ctx );
+int mpi_powm_mont_ws( MPI res, MPI base, mpi_limb_t exp, MPI_MONT_CTX ctx,
+		      mpi_limb_t *ws );
+
 /*-- mpi-mpow.c --*/
 void mpi_mulpowm( MPI res, MPI *basearray, MPI *exparray, MPI mod);
 
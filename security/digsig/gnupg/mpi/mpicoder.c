@@ -32,18 +32,19 @@ static byte asn[15] = /* Object ID is 1.3.14.3.2.26 */
  
 
 
+/* Encode an MD of mdlen bytes, with the DER prefix of its algorithm */
 MPI
-do_encode_md(const byte *sha_buffer, unsigned nbits)
+do_encode_md_asn(const byte *md, unsigned mdlen, const byte *asnp,
+		 unsigned asnlen, unsigned nbits)
 {
   int nframe = (nbits+7) / 8;
   byte *frame, *fr_pt;
   int i = 0, n;
-  size_t asnlen = DIM(asn);
   MPI a = MPI_NULL;
 
-  if(SHA1_DIGEST_LENGTH + asnlen + 4  > nframe )
+  if(mdlen + asnlen + 4  > nframe )
     log_bug("can't encode a %d bit MD into a %d bits frame\n",
-	    (int)(SHA1_DIGEST_LENGTH*8), (int)nbits);
+	    (int)(mdlen*8), (int)nbits);
 
   /* We encode the MD in this way:
    *
@@ -55,7 +56,7 @@ do_encode_md(const byte *sha_buffer, unsigned nbits)
   n = 0;
   frame[n++] = 0;
   frame[n++] = 1; /* block type */
-  i = nframe - SHA1_DIGEST_LENGTH - asnlen -3 ;
+  i = nframe - mdlen - asnlen -3 ;
   
   if(i <= 1) {
     log_bug("message digest encoding failed\n");
@@ -65,8 +66,8 @@ do_encode_md(const byte *sha_buffer, unsigned nbits)
 
   memset( frame+n, 0xff, i ); n += i;
   frame[n++] = 0;
-  memcpy( frame+n, &asn, asnlen ); n += asnlen;
-  memcpy( frame+n, sha_buffer, SHA1_DIGEST_LENGTH ); n += SHA1_DIGEST_LENGTH;
+  memcpy( frame+n, asnp, asnlen ); n += asnlen;
+  memcpy( frame+n, md, mdlen ); n += mdlen;
   
   i = nframe;
   fr_pt = frame;
@@ -85,6 +86,13 @@ do_encode_md(const byte *sha_buffer, unsigned nbits)
 }
 
 
+MPI
+do_encode_md(const byte *sha_buffer, unsigned nbits)
+{
+  return do_encode_md_asn(sha_buffer, SHA1_DIGEST_LENGTH, asn, DIM(asn), nbits);
+}
+
+
 MPI
 mpi_read_from_buffer(const byte *buffer, unsigned *ret_nread, int secure)
 {
@@ -133,6 +141,48 @@ mpi_read_from_buffer(const byte *buffer, unsigned *ret_nread, int secure)
 }
 
 
+/****************
+ * Like mpi_read_from_buffer(), but into VAL, which must already have
+ * room for the number, so that nothing is allocated.  Returns 0 on
+ * success, -1 if the number is longer than VAL or than the buffer.
+ */
+int
+mpi_read_from_buffer_fixed( MPI val, const byte *buffer, unsigned *ret_nread )
+{
+  int i, j;
+  unsigned nbits, nbytes, nlimbs, nread;
+  mpi_limb_t a;
+
+  if( *ret_nread < 2 )
+    return -1;
+  nbits = buffer[0] << 8 | buffer[1];
+  nbytes = (nbits+7) / 8;
+  nlimbs = (nbytes+BYTES_PER_MPI_LIMB-1) / BYTES_PER_MPI_LIMB;
+  if( (int)nlimbs > val->alloced || nbytes + 2 > *ret_nread )
+    return -1;
+  buffer += 2;
+  nread = 2 + nbytes;
+
+  i = BYTES_PER_MPI_LIMB - nbytes % BYTES_PER_MPI_LIMB;
+  i %= BYTES_PER_MPI_LIMB;
+  val->nbits = nbits;
+  j= val->nlimbs = nlimbs;
+  val->sign = 0;
+  for( ; j > 0; j-- ) {
+    a = 0;
+    for(; i < BYTES_PER_MPI_LIMB; i++ ) {
+      a <<= 8;
+      a |= *buffer++;
+    }
+    i = 0;
+    val->d[j-1] = a;
+  }
+
+  *ret_nread = nread;
+  return 0;
+}
+
+
 /****************
  * Make an mpi from a character string.
  */
@@ -302,6 +352,32 @@ mpi_get_secure_buffer( MPI a, unsigned *nbytes, int *sign )
     return do_get_buffer( a, nbytes, sign, 1 );
 }
 
+/****************
+ * Write A into the NBYTES of BUFFER, big endian and padded with leading
+ * zeroes, without allocating.  Returns -1 if A does not fit.
+ */
+int
+mpi_get_buffer_fixed( MPI a, byte *buffer, unsigned nbytes )
+{
+    byte *p = buffer + nbytes;
+    mpi_limb_t alimb;
+    int i, j;
+
+    for(i=0; i < a->nlimbs; i++ ) {
+	alimb = a->d[i];
+	for(j=0; j < BYTES_PER_MPI_LIMB; j++, alimb >>= 8 ) {
+	    if( p == buffer ) {
+		if( alimb )
+		    return -1;
+		break;
+	    }
+	    *--p = alimb & 0xff;
+	}
+    }
+    memset( buffer, 0, p - buffer );
+    return 0;
+}
+
 /****************
  * Use BUFFER to update MPI.
  */
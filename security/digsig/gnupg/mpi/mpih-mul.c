@@ -222,43 +222,47 @@ mul_n( mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp,
 }
 
 
+/* Square U (pointed to by UP, SIZE limbs) into 2 * SIZE limbs at PRODP,
+ * which must not overlap UP.  Each cross product u[i]*u[j], i < j, is
+ * computed once and the sum doubled, then the squares u[i]^2 of the
+ * diagonal are added in; this takes about half the limb products of
+ * multiplying U by itself.
+ */
 void
 mpih_sqr_n_basecase( mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t size )
 {
     mpi_size_t i;
-    mpi_limb_t cy_limb;
-    mpi_limb_t v_limb;
+    mpi_limb_t hi, lo, t, u, c, c2, cy;
 
-    /* Multiply by the first limb in V separately, as the result can be
-     * stored (not added) to PROD.  We also avoid a loop for zeroing.  */
-    v_limb = up[0];
-    if( v_limb <= 1 ) {
-	if( v_limb == 1 )
-	    MPN_COPY( prodp, up, size );
-	else
-	    MPN_ZERO(prodp, size);
-	cy_limb = 0;
+    if( size == 1 ) {
+	umul_ppmm( prodp[1], prodp[0], up[0], up[0] );
+	return;
     }
-    else
-	cy_limb = mpihelp_mul_1( prodp, up, size, v_limb );
-
-    prodp[size] = cy_limb;
-    prodp++;
 
-    /* For each iteration in the outer loop, multiply one limb from
-     * U with one limb from V, and add it to PROD.  */
-    for( i=1; i < size; i++) {
-	v_limb = up[i];
-	if( v_limb <= 1 ) {
-	    cy_limb = 0;
-	    if( v_limb == 1 )
-		cy_limb = mpihelp_add_n(prodp, prodp, up, size);
-	}
-	else
-	    cy_limb = mpihelp_addmul_1(prodp, up, size, v_limb);
-
-	prodp[size] = cy_limb;
-	prodp++;
+    /* the cross products, row i going to prodp[2i+1 .. size+i] */
+    prodp[0] = 0;
+    prodp[size] = mpihelp_mul_1( prodp + 1, up + 1, size - 1, up[0] );
+    for( i = 1; i < size - 1; i++ )
+	prodp[size + i] = mpihelp_addmul_1( prodp + 2 * i + 1, up + i + 1,
+					    size - i - 1, up[i] );
+    prodp[2 * size - 1] = 0;
+
+    /* twice their sum is below U^2, so nothing is shifted out */
+    mpihelp_lshift( prodp, prodp, 2 * size, 1 );
+
+    for( i = 0, cy = 0; i < size; i++ ) {
+	umul_ppmm( hi, lo, up[i], up[i] );
+	t = prodp[2 * i] + lo;
+	c = t < lo;
+	t += cy;
+	c += t < cy;
+	prodp[2 * i] = t;
+	u = prodp[2 * i + 1] + hi;
+	c2 = u < hi;
+	u += c;
+	c2 += u < c;
+	prodp[2 * i + 1] = u;
+	cy = c2;
     }
 }
 
@@ -340,6 +344,19 @@ mpih_sqr_n( mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t size, mpi_ptr_t tspace)
 }
 
 
+/* Multiply or square like mpihelp_mul_n, but with a caller provided
+ * TSPACE of 2 * SIZE limbs instead of allocating one.  */
+void
+mpihelp_mul_n_ws( mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp,
+		  mpi_size_t size, mpi_ptr_t tspace )
+{
+    if( up == vp )
+	MPN_SQR_N_RECURSE( prodp, up, size, tspace )
+    else
+	MPN_MUL_N_RECURSE( prodp, up, vp, size, tspace )
+}
+
+
 /* This should be made into an inline function in gmp.h.  */
 void
 mpihelp_mul_n( mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp, mpi_size_t size)
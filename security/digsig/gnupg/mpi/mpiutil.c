@@ -19,6 +19,7 @@
  */
 
 #include <linux/string.h>
+#include <linux/percpu.h>
 
 #include "mpi.h"
 #include "mpi-internal.h"
@@ -27,6 +28,71 @@
 
 int DBG_MEMORY = 0; 
 
+/****************
+ * A verification allocates and frees a handful of MPIs and limb arrays
+ * each time: the signature, the encoded hash, the result and the
+ * temporaries of mpi_powm.  The MPIs come from a cache of their own,
+ * and the limb arrays of the sizes 2048 and 4096 bit keys use, rounded
+ * up to the kmalloc size they land in anyway, go to a short per-CPU
+ * free list when freed, for the next verification on that CPU to take.
+ * An array is put back on the list of the size ksize() says it has,
+ * so one krealloc()ed by mpi_resize goes where it now belongs.
+ */
+#define LIMB_POOL_SIZES 4
+#define LIMB_POOL_DEPTH 4
+
+static const size_t limb_pool_size[LIMB_POOL_SIZES] = { 256, 512, 1024, 2048 };
+
+struct limb_pool {
+    int count[LIMB_POOL_SIZES];
+    mpi_ptr_t free[LIMB_POOL_SIZES][LIMB_POOL_DEPTH];
+};
+
+static DEFINE_PER_CPU(struct limb_pool, limb_pool);
+static struct kmem_cache *mpi_cache;
+
+/* the list an array of LEN bytes is taken from, -1 if it is too small */
+static int
+limb_pool_index( size_t len )
+{
+    int i;
+
+    if( len <= limb_pool_size[0] / 2 )
+	return -1;
+    for(i=0; i < LIMB_POOL_SIZES; i++ )
+	if( len <= limb_pool_size[i] )
+	    return i;
+    return -1;
+}
+
+/****************
+ * Create the cache of MPIs.  Called before any MPI is allocated; without
+ * it, MPIs come from kmalloc.
+ */
+int
+mpi_init_pool(void)
+{
+    mpi_cache = kmem_cache_create("digsig_mpi", sizeof(struct gcry_mpi), 0,
+				  0, NULL);
+    return mpi_cache ? 0 : -ENOMEM;
+}
+
+static MPI
+mpi_alloc_header(void)
+{
+    return mpi_cache ? kmem_cache_alloc(mpi_cache, GFP_KERNEL)
+		     : m_alloc( sizeof(struct gcry_mpi) );
+}
+
+static void
+mpi_free_header( MPI a )
+{
+    if( mpi_cache )
+	kmem_cache_free(mpi_cache, a);
+    else
+	m_free(a);
+}
+
 #ifdef M_DEBUG
   #undef mpi_alloc
   #undef mpi_alloc_secure
@@ -55,7 +121,7 @@ mpi_alloc( unsigned nlimbs )
     a = m_debug_alloc( sizeof *a, info );
     a->d = nlimbs? mpi_debug_alloc_limb_space( nlimbs, 0, info ) : NULL;
   #else
-    a = m_alloc( sizeof *a );
+    a = mpi_alloc_header();
     a->d = nlimbs? mpi_alloc_limb_space( nlimbs, 0 ) : NULL;
   #endif
     a->alloced = nlimbs;
@@ -88,7 +154,7 @@ mpi_alloc_secure( unsigned nlimbs )
     a = m_debug_alloc( sizeof *a, info );
     a->d = nlimbs? mpi_debug_alloc_limb_space( nlimbs, 1, info ) : NULL;
   #else
-    a = m_alloc( sizeof *a );
+    a = mpi_alloc_header();
     a->d = nlimbs? mpi_alloc_limb_space( nlimbs, 1 ) : NULL;
   #endif
     a->alloced = nlimbs;
@@ -100,12 +166,6 @@ mpi_alloc_secure( unsigned nlimbs )
 }
 
 
-#if 0
-static void *unused_limbs_5;
-static void *unused_limbs_32;
-static void *unused_limbs_64;
-#endif
-
 mpi_ptr_t
 #ifdef M_DEBUG
 mpi_debug_alloc_limb_space( unsigned nlimbs, int secure, const char *info )
@@ -118,29 +178,24 @@ mpi_alloc_limb_space( unsigned nlimbs, int secure )
 
     if( DBG_MEMORY )
 	log_debug("mpi_alloc_limb_space(%u)\n", (unsigned)len*8 );
-  #if 0
-    if( !secure ) {
-	if( nlimbs == 5 && unused_limbs_5 ) {  /* DSA 160 bits */
-	    p = unused_limbs_5;
-	    unused_limbs_5 = *p;
-	    return p;
-	}
-	else if( nlimbs == 32 && unused_limbs_32 ) {  /* DSA 1024 bits */
-	    p = unused_limbs_32;
-	    unused_limbs_32 = *p;
-	    return p;
-	}
-	else if( nlimbs == 64 && unused_limbs_64 ) {  /* DSA 2*1024 bits */
-	    p = unused_limbs_64;
-	    unused_limbs_64 = *p;
-	    return p;
-	}
-    }
-  #endif
 
   #ifdef M_DEBUG
     p = secure? m_debug_alloc_secure(len, info):m_debug_alloc( len, info );
   #else
+    {
+	int i = limb_pool_index( len );
+	struct limb_pool *lp;
+
+	if( i >= 0 ) {
+	    lp = &get_cpu_var(limb_pool);
+	    p = lp->count[i]? lp->free[i][--lp->count[i]] : NULL;
+	    put_cpu_var(limb_pool);
+	    if( p )
+		return p;
+	    /* the whole of it, for the next one to fit in */
+	    len = limb_pool_size[i];
+	}
+    }
     p = secure? m_alloc_secure( len ):m_alloc( len );
   #endif
 
@@ -159,30 +214,28 @@ mpi_free_limb_space( mpi_ptr_t a )
     if( DBG_MEMORY )
 	log_debug("mpi_free_limb_space of size %lu\n", (ulong)m_size(a)*8 );
 
-  #if 0
-    if( !m_is_secure(a) ) {
-	size_t nlimbs = m_size(a) / 4 ;
-	void *p = a;
-
-	if( nlimbs == 5 ) {  /* DSA 160 bits */
-	    *a = unused_limbs_5;
-	    unused_limbs_5 = a;
-	    return;
-	}
-	else if( nlimbs == 32 ) {  /* DSA 1024 bits */
-	    *a = unused_limbs_32;
-	    unused_limbs_32 = a;
-	    return;
-	}
-	else if( nlimbs == 64 ) {  /* DSA 2*1024 bits */
-	    *a = unused_limbs_64;
-	    unused_limbs_64 = a;
-	    return;
+  #ifndef M_DEBUG
+    {
+	size_t len = ksize(a);
+	struct limb_pool *lp;
+	int i;
+
+	for(i=0; i < LIMB_POOL_SIZES; i++ )
+	    if( len == limb_pool_size[i] )
+		break;
+	if( i < LIMB_POOL_SIZES ) {
+	    lp = &get_cpu_var(limb_pool);
+	    if( lp->count[i] < LIMB_POOL_DEPTH ) {
+		lp->free[i][lp->count[i]++] = a;
+		a = NULL;
+	    }
+	    put_cpu_var(limb_pool);
+	    if( !a )
+		return;
 	}
     }
   #endif
 
-
     m_free(a);
 }
 
@@ -260,7 +313,11 @@ mpi_free( MPI a )
     }
     if( a->flags & ~7 )
 	log_bug("invalid flag value in mpi\n");
+  #ifdef M_DEBUG
     m_free(a);
+  #else
+    mpi_free_header(a);
+  #endif
 }
 
 
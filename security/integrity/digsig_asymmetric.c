@@ -13,6 +13,9 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hashtable.h>
 #include <linux/key-type.h>
 #include <crypto/public_key.h>
 #include <keys/asymmetric-type.h>
@@ -30,14 +33,96 @@ struct signature_v2_hdr {
 	uint8_t sig[0];		/* signature payload */
 } __packed;
 
+/*
+ * The keys found by ID in each keyring, so that appraising a file costs
+ * a probe rather than a search of the keyring.  An entry holds a
+ * reference on its key and is good for as long as the keyring's links
+ * have not changed since the search that found it.
+ */
+struct keyid_cache_entry {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	struct key *keyring;
+	uint32_t keyid;
+	unsigned int changes;	/* keyring->changes before the search */
+	struct key *key;
+};
+
+static DEFINE_HASHTABLE(keyid_cache, 4);
+static DEFINE_SPINLOCK(keyid_cache_lock);
+
+static void keyid_cache_free(struct rcu_head *rcu)
+{
+	struct keyid_cache_entry *e;
+
+	e = container_of(rcu, struct keyid_cache_entry, rcu);
+	key_put(e->key);
+	kfree(e);
+}
+
+static struct key *keyid_cache_lookup(struct key *keyring, uint32_t keyid)
+{
+	struct keyid_cache_entry *e;
+	struct key *key = NULL;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(keyid_cache, e, node, keyid) {
+		if (e->keyring != keyring || e->keyid != keyid)
+			continue;
+		if (e->changes == ACCESS_ONCE(keyring->changes) &&
+		    key_validate(e->key) == 0 &&
+		    atomic_inc_not_zero(&e->key->usage))
+			key = e->key;
+		break;
+	}
+	rcu_read_unlock();
+	return key;
+}
+
+/* Keep the key found, in place of any entry gone stale. */
+static void keyid_cache_add(struct key *keyring, uint32_t keyid,
+			    unsigned int changes, struct key *key)
+{
+	struct keyid_cache_entry *e, *old;
+
+	e = kmalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return;
+	e->keyring = keyring;
+	e->keyid = keyid;
+	e->changes = changes;
+	e->key = key_get(key);
+
+	spin_lock(&keyid_cache_lock);
+	hash_for_each_possible(keyid_cache, old, node, keyid) {
+		if (old->keyring == keyring && old->keyid == keyid) {
+			hash_del_rcu(&old->node);
+			call_rcu(&old->rcu, keyid_cache_free);
+			break;
+		}
+	}
+	hash_add_rcu(keyid_cache, &e->node, keyid);
+	spin_unlock(&keyid_cache_lock);
+}
+
 /*
  * Request an asymmetric key.
  */
 static struct key *request_asymmetric_key(struct key *keyring, uint32_t keyid)
 {
 	struct key *key;
+	unsigned int changes = 0;
 	char name[12];
 
+	if (keyring) {
+		key = keyid_cache_lookup(keyring, keyid);
+		if (key)
+			return key;
+		/* a change from now on makes what is found stale */
+		changes = ACCESS_ONCE(keyring->changes);
+		smp_rmb();
+	}
+
 	sprintf(name, "id:%x", keyid);
 
 	pr_debug("key search: \"%s\"\n", name);
@@ -47,10 +132,12 @@ static struct key *request_asymmetric_key(struct key *keyring, uint32_t keyid)
 		key_ref_t kref;
 		kref = keyring_search(make_key_ref(keyring, 1),
 				      &key_type_asymmetric, name);
-		if (IS_ERR(kref))
+		if (IS_ERR(kref)) {
 			key = ERR_CAST(kref);
-		else
+		} else {
 			key = key_ref_to_ptr(kref);
+			keyid_cache_add(keyring, keyid, changes, key);
+		}
 	} else {
 		key = request_key(&key_type_asymmetric, name, NULL);
 	}
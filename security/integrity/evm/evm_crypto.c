@@ -14,6 +14,8 @@
  */
 
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
 #include <linux/crypto.h>
 #include <linux/xattr.h>
 #include <keys/encrypted-type.h>
@@ -30,12 +32,50 @@ struct crypto_shash *hash_tfm;
 
 static DEFINE_MUTEX(mutex);
 
-static struct shash_desc *init_desc(char type)
+/*
+ * A descriptor and the buffer xattr values are read into, kept per CPU
+ * for each of the HMAC and the hash between calculations, so that one
+ * does not allocate either.  A task takes the context of its CPU and
+ * gives it back when done, to whatever CPU it then runs on; one that
+ * finds none allocates its own.
+ */
+#define EVM_CTX_HMAC 0
+#define EVM_CTX_HASH 1
+#define EVM_XATTR_KEEP 512	/* larger buffers are not kept */
+
+struct evm_ctx {
+	char *xattr_value;
+	size_t xattr_size;	/* allocated at xattr_value */
+	struct shash_desc desc;	/* must be last, the tfm state follows */
+};
+
+static DEFINE_PER_CPU(struct evm_ctx *, evm_ctx_cpu[2]);
+
+static struct evm_ctx *evm_alloc_ctx(struct crypto_shash *tfm, gfp_t gfp)
+{
+	struct evm_ctx *ctx;
+
+	ctx = kmalloc(sizeof(*ctx) + crypto_shash_descsize(tfm), gfp);
+	if (!ctx)
+		return NULL;
+	ctx->xattr_value = NULL;
+	ctx->xattr_size = 0;
+	ctx->desc.tfm = tfm;
+	ctx->desc.flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	return ctx;
+}
+
+static void evm_free_ctx(struct evm_ctx *ctx)
+{
+	kfree(ctx->xattr_value);
+	kfree(ctx);
+}
+
+static struct crypto_shash *init_tfm(char type)
 {
 	long rc;
 	char *algo;
-	struct crypto_shash **tfm;
-	struct shash_desc *desc;
+	struct crypto_shash **tfm, *new;
 
 	if (type == EVM_XATTR_HMAC) {
 		tfm = &hmac_tfm;
@@ -45,45 +85,76 @@ static struct shash_desc *init_desc(char type)
 		algo = evm_hash;
 	}
 
-	if (*tfm == NULL) {
+	/* a tfm is published only once keyed, see below */
+	new = ACCESS_ONCE(*tfm);
+	if (new == NULL) {
 		mutex_lock(&mutex);
-		if (*tfm)
+		new = *tfm;
+		if (new)
 			goto out;
-		*tfm = crypto_alloc_shash(algo, 0, CRYPTO_ALG_ASYNC);
-		if (IS_ERR(*tfm)) {
-			rc = PTR_ERR(*tfm);
+		new = crypto_alloc_shash(algo, 0, CRYPTO_ALG_ASYNC);
+		if (IS_ERR(new)) {
+			rc = PTR_ERR(new);
 			pr_err("Can not allocate %s (reason: %ld)\n", algo, rc);
-			*tfm = NULL;
 			mutex_unlock(&mutex);
 			return ERR_PTR(rc);
 		}
 		if (type == EVM_XATTR_HMAC) {
-			rc = crypto_shash_setkey(*tfm, evmkey, evmkey_len);
+			rc = crypto_shash_setkey(new, evmkey, evmkey_len);
 			if (rc) {
-				crypto_free_shash(*tfm);
-				*tfm = NULL;
+				crypto_free_shash(new);
 				mutex_unlock(&mutex);
 				return ERR_PTR(rc);
 			}
 		}
+		smp_wmb();
+		ACCESS_ONCE(*tfm) = new;
 out:
 		mutex_unlock(&mutex);
+	} else {
+		smp_read_barrier_depends();
 	}
+	return new;
+}
 
-	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(*tfm),
-			GFP_KERNEL);
-	if (!desc)
-		return ERR_PTR(-ENOMEM);
+static struct evm_ctx *init_ctx(char type)
+{
+	int i = type == EVM_XATTR_HMAC ? EVM_CTX_HMAC : EVM_CTX_HASH;
+	struct crypto_shash *tfm;
+	struct evm_ctx *ctx;
+	int rc;
 
-	desc->tfm = *tfm;
-	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	tfm = init_tfm(type);
+	if (IS_ERR(tfm))
+		return ERR_CAST(tfm);
 
-	rc = crypto_shash_init(desc);
+	ctx = this_cpu_xchg(evm_ctx_cpu[i], NULL);
+	if (!ctx) {
+		ctx = evm_alloc_ctx(tfm, GFP_KERNEL);
+		if (!ctx)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	/* for the HMAC, this starts from the state keyed at setkey */
+	rc = crypto_shash_init(&ctx->desc);
 	if (rc) {
-		kfree(desc);
+		evm_free_ctx(ctx);
 		return ERR_PTR(rc);
 	}
-	return desc;
+	return ctx;
+}
+
+static void put_ctx(struct evm_ctx *ctx, char type)
+{
+	int i = type == EVM_XATTR_HMAC ? EVM_CTX_HMAC : EVM_CTX_HASH;
+
+	if (ctx->xattr_size > EVM_XATTR_KEEP) {
+		kfree(ctx->xattr_value);
+		ctx->xattr_value = NULL;
+		ctx->xattr_size = 0;
+	}
+	if (this_cpu_cmpxchg(evm_ctx_cpu[i], NULL, ctx) != NULL)
+		evm_free_ctx(ctx);
 }
 
 /* Protect against 'cutting & pasting' security.evm xattr, include inode
@@ -121,7 +192,8 @@ static void hmac_add_misc(struct shash_desc *desc, struct inode *inode,
  *
  * Instead of retrieving the requested xattr, for performance, calculate
  * the hmac using the requested xattr value. Don't alloc/free memory for
- * each xattr, but attempt to re-use the previously allocated memory.
+ * each xattr, but re-use the buffer of the context, which outlives the
+ * calculation.
  */
 static int evm_calc_hmac_or_hash(struct dentry *dentry,
 				const char *req_xattr_name,
@@ -130,18 +202,18 @@ static int evm_calc_hmac_or_hash(struct dentry *dentry,
 				char type, char *digest)
 {
 	struct inode *inode = dentry->d_inode;
+	struct evm_ctx *ctx;
 	struct shash_desc *desc;
 	char **xattrname;
-	size_t xattr_size = 0;
-	char *xattr_value = NULL;
 	int error;
 	int size;
 
 	if (!inode->i_op || !inode->i_op->getxattr)
 		return -EOPNOTSUPP;
-	desc = init_desc(type);
-	if (IS_ERR(desc))
-		return PTR_ERR(desc);
+	ctx = init_ctx(type);
+	if (IS_ERR(ctx))
+		return PTR_ERR(ctx);
+	desc = &ctx->desc;
 
 	error = -ENODATA;
 	for (xattrname = evm_config_xattrnames; *xattrname != NULL; xattrname++) {
@@ -153,7 +225,8 @@ static int evm_calc_hmac_or_hash(struct dentry *dentry,
 			continue;
 		}
 		size = vfs_getxattr_alloc(dentry, *xattrname,
-					  &xattr_value, xattr_size, GFP_NOFS);
+					  &ctx->xattr_value, ctx->xattr_size,
+					  GFP_NOFS);
 		if (size == -ENOMEM) {
 			error = -ENOMEM;
 			goto out;
@@ -162,14 +235,15 @@ static int evm_calc_hmac_or_hash(struct dentry *dentry,
 			continue;
 
 		error = 0;
-		xattr_size = size;
-		crypto_shash_update(desc, (const u8 *)xattr_value, xattr_size);
+		/* a larger value was read into a buffer of its size */
+		if (size > ctx->xattr_size)
+			ctx->xattr_size = size;
+		crypto_shash_update(desc, (const u8 *)ctx->xattr_value, size);
 	}
 	hmac_add_misc(desc, inode, digest);
 
 out:
-	kfree(xattr_value);
-	kfree(desc);
+	put_ctx(ctx, type);
 	return error;
 }
 
@@ -217,20 +291,43 @@ int evm_update_evmxattr(struct dentry *dentry, const char *xattr_name,
 int evm_init_hmac(struct inode *inode, const struct xattr *lsm_xattr,
 		  char *hmac_val)
 {
-	struct shash_desc *desc;
+	struct evm_ctx *ctx;
 
-	desc = init_desc(EVM_XATTR_HMAC);
-	if (IS_ERR(desc)) {
-		printk(KERN_INFO "init_desc failed\n");
-		return PTR_ERR(desc);
+	ctx = init_ctx(EVM_XATTR_HMAC);
+	if (IS_ERR(ctx)) {
+		printk(KERN_INFO "init_ctx failed\n");
+		return PTR_ERR(ctx);
 	}
 
-	crypto_shash_update(desc, lsm_xattr->value, lsm_xattr->value_len);
-	hmac_add_misc(desc, inode, hmac_val);
-	kfree(desc);
+	crypto_shash_update(&ctx->desc, lsm_xattr->value, lsm_xattr->value_len);
+	hmac_add_misc(&ctx->desc, inode, hmac_val);
+	put_ctx(ctx, EVM_XATTR_HMAC);
 	return 0;
 }
 
+/*
+ * Key the HMAC tfm, and give each CPU its HMAC context, now rather than
+ * on the first appraisal.  What fails here is retried on demand.
+ */
+static void evm_init_hmac_ctx(void)
+{
+	struct crypto_shash *tfm;
+	struct evm_ctx *ctx;
+	int cpu;
+
+	tfm = init_tfm(EVM_XATTR_HMAC);
+	if (IS_ERR(tfm))
+		return;
+	for_each_possible_cpu(cpu) {
+		ctx = evm_alloc_ctx(tfm, GFP_KERNEL);
+		if (!ctx)
+			break;
+		if (cmpxchg(&per_cpu(evm_ctx_cpu[EVM_CTX_HMAC], cpu), NULL,
+			    ctx) != NULL)
+			evm_free_ctx(ctx);
+	}
+}
+
 /*
  * Get the key from the TPM for the SHA1-HMAC
  */
@@ -256,5 +353,7 @@ out:
 	memset(ekp->decrypted_data, 0, ekp->decrypted_datalen);
 	up_read(&evm_key->sem);
 	key_put(evm_key);
+	if (!rc)
+		evm_init_hmac_ctx();
 	return rc;
 }
@@ -0,0 +1,181 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 2 of the
+ * License.
+ *
+ * File: hash.c
+ *	- hashes the content of a file for the integrity subsystems,
+ *	  straight from its page cache pages
+ *	- hands the digest of a file one subsystem computed to another
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/integrity.h>
+#include <crypto/hash.h>
+#include "integrity.h"
+
+/*
+ * Get an uptodate page of the file, keeping the readahead window ahead
+ * of the hashing as a regular read does.
+ */
+static struct page *integrity_get_page(struct file *file, pgoff_t index,
+				       pgoff_t last)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, &file->f_ra, file, index,
+					  last - index + 1);
+	} else {
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, &file->f_ra, file,
+						   page, index,
+						   last - index + 1);
+		if (PageUptodate(page))
+			return page;
+		page_cache_release(page);
+	}
+
+	return read_mapping_page(mapping, index, file);
+}
+
+static int integrity_hash_pages(struct file *file, struct shash_desc *desc,
+				loff_t i_size)
+{
+	pgoff_t index, last = (i_size - 1) >> PAGE_CACHE_SHIFT;
+	struct page *page;
+	size_t len;
+	int rc = 0;
+
+	for (index = 0; index <= last && !rc; index++) {
+		page = integrity_get_page(file, index, last);
+		if (IS_ERR(page))
+			return PTR_ERR(page);
+
+		len = min_t(loff_t, PAGE_CACHE_SIZE,
+			    i_size - ((loff_t)index << PAGE_CACHE_SHIFT));
+		rc = crypto_shash_update(desc, kmap(page), len);
+		kunmap(page);
+		page_cache_release(page);
+	}
+	return rc;
+}
+
+static int integrity_hash_read(struct file *file, struct shash_desc *desc,
+			       loff_t i_size)
+{
+	loff_t offset = 0;
+	char *rbuf;
+	int rc = 0;
+
+	rbuf = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!rbuf)
+		return -ENOMEM;
+
+	while (offset < i_size) {
+		int rbuf_len;
+
+		rbuf_len = kernel_read(file, offset, rbuf, PAGE_SIZE);
+		if (rbuf_len < 0) {
+			rc = rbuf_len;
+			break;
+		}
+		if (rbuf_len == 0)
+			break;
+		offset += rbuf_len;
+
+		rc = crypto_shash_update(desc, rbuf, rbuf_len);
+		if (rc)
+			break;
+	}
+	kfree(rbuf);
+	return rc;
+}
+
+/**
+ * integrity_hash_file - hash the content of a file
+ * @file: the file, open for reading
+ * @desc: an initialized hash descriptor, which is updated, not finalized
+ *
+ * The file is hashed from its page cache pages, without copying them,
+ * after starting the readahead of the whole file.  Files whose mapping
+ * has no readpage are read into a bounce buffer instead.
+ *
+ * Returns 0 on success, negative otherwise.
+ */
+int integrity_hash_file(struct file *file, struct shash_desc *desc)
+{
+	struct address_space *mapping = file->f_mapping;
+	loff_t i_size = i_size_read(file_inode(file));
+
+	if (!i_size)
+		return 0;
+
+	if (!mapping || !mapping->a_ops->readpage)
+		return integrity_hash_read(file, desc, i_size);
+
+	page_cache_sync_readahead(mapping, &file->f_ra, file, 0,
+				  ((i_size - 1) >> PAGE_CACHE_SHIFT) + 1);
+	return integrity_hash_pages(file, desc, i_size);
+}
+
+/*
+ * The transform IMA measures and appraises files with, once it has a
+ * policy, and the module that may have hashed a file with it already,
+ * while hashing it for itself.  IMA's transform is never freed.
+ */
+static struct crypto_shash *integrity_digest_tfm;
+static integrity_digest_fn integrity_digest_source;
+
+/**
+ * integrity_want_digest - ask for the digests of files in an algorithm
+ * @tfm: the transform of the algorithm, NULL when none is wanted
+ *
+ * Modules that hash whole files for themselves compute this digest on
+ * the same pass, so that integrity_shared_digest() may find it.
+ */
+void integrity_want_digest(struct crypto_shash *tfm)
+{
+	ACCESS_ONCE(integrity_digest_tfm) = tfm;
+}
+
+/**
+ * integrity_wanted_digest - the transform given to integrity_want_digest()
+ */
+struct crypto_shash *integrity_wanted_digest(void)
+{
+	return ACCESS_ONCE(integrity_digest_tfm);
+}
+
+/**
+ * integrity_set_digest_source - register where shared digests are found
+ * @fn: called by integrity_shared_digest(); built in, so never removed
+ */
+void integrity_set_digest_source(integrity_digest_fn fn)
+{
+	ACCESS_ONCE(integrity_digest_source) = fn;
+}
+
+/**
+ * integrity_shared_digest - the digest of a file hashed by another module
+ * @file: the file, as it is now
+ * @tfm: the transform the digest is wanted in
+ * @digest: where the digest is written
+ *
+ * Returns 0 if the digest is in @digest, -ENOENT if the file must be
+ * hashed.
+ */
+int integrity_shared_digest(struct file *file, struct crypto_shash *tfm,
+			    u8 *digest)
+{
+	integrity_digest_fn fn = ACCESS_ONCE(integrity_digest_source);
+
+	return fn ? fn(file, tfm, digest) : -ENOENT;
+}
@@ -13,46 +13,48 @@
  *	- implements the integrity hooks: integrity_inode_alloc,
  *	  integrity_inode_free
  *	- cache integrity information associated with an inode
- *	  using a rbtree tree.
+ *	  in a hash table, looked up under RCU and changed under a
+ *	  lock of the bucket only.
  */
 #include <linux/slab.h>
 #include <linux/module.h>
-#include <linux/spinlock.h>
-#include <linux/rbtree.h>
+#include <linux/bootmem.h>
+#include <linux/hash.h>
+#include <linux/rculist_bl.h>
 #include "integrity.h"
 
-static struct rb_root integrity_iint_tree = RB_ROOT;
-static DEFINE_RWLOCK(integrity_iint_lock);
+static struct hlist_bl_head *integrity_iint_hash __read_mostly;
+static unsigned int integrity_iint_hash_shift __read_mostly;
 static struct kmem_cache *iint_cache __read_mostly;
 
 int iint_initialized;
 
+static inline struct hlist_bl_head *iint_bucket(struct inode *inode)
+{
+	return &integrity_iint_hash[hash_ptr(inode, integrity_iint_hash_shift)];
+}
+
 /*
  * __integrity_iint_find - return the iint associated with an inode
+ *
+ * Called under rcu_read_lock() or the lock of the bucket.
  */
 static struct integrity_iint_cache *__integrity_iint_find(struct inode *inode)
 {
 	struct integrity_iint_cache *iint;
-	struct rb_node *n = integrity_iint_tree.rb_node;
-
-	while (n) {
-		iint = rb_entry(n, struct integrity_iint_cache, rb_node);
-
-		if (inode < iint->inode)
-			n = n->rb_left;
-		else if (inode > iint->inode)
-			n = n->rb_right;
-		else
-			break;
-	}
-	if (!n)
-		return NULL;
+	struct hlist_bl_node *n;
 
-	return iint;
+	hlist_bl_for_each_entry_rcu(iint, n, iint_bucket(inode), hnode)
+		if (iint->inode == inode)
+			return iint;
+	return NULL;
 }
 
 /*
  * integrity_iint_find - return the iint associated with an inode
+ *
+ * The iint lives as long as the inode the caller holds, so it is still
+ * valid after the RCU read side section.
  */
 struct integrity_iint_cache *integrity_iint_find(struct inode *inode)
 {
@@ -61,15 +63,19 @@ struct integrity_iint_cache *integrity_iint_find(struct inode *inode)
 	if (!IS_IMA(inode))
 		return NULL;
 
-	read_lock(&integrity_iint_lock);
+	rcu_read_lock();
 	iint = __integrity_iint_find(inode);
-	read_unlock(&integrity_iint_lock);
+	rcu_read_unlock();
 
 	return iint;
 }
 
-static void iint_free(struct integrity_iint_cache *iint)
+/* lookups of other inodes in the bucket may still be walking past it */
+static void iint_free_rcu(struct rcu_head *head)
 {
+	struct integrity_iint_cache *iint =
+		container_of(head, struct integrity_iint_cache, rcu);
+
 	iint->version = 0;
 	iint->flags = 0UL;
 	iint->ima_file_status = INTEGRITY_UNKNOWN;
@@ -89,9 +95,8 @@ static void iint_free(struct integrity_iint_cache *iint)
  */
 struct integrity_iint_cache *integrity_inode_get(struct inode *inode)
 {
-	struct rb_node **p;
-	struct rb_node *node, *parent = NULL;
-	struct integrity_iint_cache *iint, *test_iint;
+	struct hlist_bl_head *b;
+	struct integrity_iint_cache *iint;
 
 	iint = integrity_iint_find(inode);
 	if (iint)
@@ -101,26 +106,15 @@ struct integrity_iint_cache *integrity_inode_get(struct inode *inode)
 	if (!iint)
 		return NULL;
 
-	write_lock(&integrity_iint_lock);
-
-	p = &integrity_iint_tree.rb_node;
-	while (*p) {
-		parent = *p;
-		test_iint = rb_entry(parent, struct integrity_iint_cache,
-				     rb_node);
-		if (inode < test_iint->inode)
-			p = &(*p)->rb_left;
-		else
-			p = &(*p)->rb_right;
-	}
-
+	b = iint_bucket(inode);
+	hlist_bl_lock(b);
 	iint->inode = inode;
-	node = &iint->rb_node;
-	inode->i_flags |= S_IMA;
-	rb_link_node(node, parent, p);
-	rb_insert_color(node, &integrity_iint_tree);
+	hlist_bl_add_head_rcu(&iint->hnode, b);
+	hlist_bl_unlock(b);
 
-	write_unlock(&integrity_iint_lock);
+	/* integrity_iint_find() tests the flag before the lookup */
+	smp_wmb();
+	inode->i_flags |= S_IMA;
 	return iint;
 }
 
@@ -132,17 +126,19 @@ struct integrity_iint_cache *integrity_inode_get(struct inode *inode)
  */
 void integrity_inode_free(struct inode *inode)
 {
+	struct hlist_bl_head *b;
 	struct integrity_iint_cache *iint;
 
 	if (!IS_IMA(inode))
 		return;
 
-	write_lock(&integrity_iint_lock);
+	b = iint_bucket(inode);
+	hlist_bl_lock(b);
 	iint = __integrity_iint_find(inode);
-	rb_erase(&iint->rb_node, &integrity_iint_tree);
-	write_unlock(&integrity_iint_lock);
+	hlist_bl_del_rcu(&iint->hnode);
+	hlist_bl_unlock(b);
 
-	iint_free(iint);
+	call_rcu(&iint->rcu, iint_free_rcu);
 }
 
 static void init_once(void *foo)
@@ -161,6 +157,16 @@ static void init_once(void *foo)
 
 static int __init integrity_iintcache_init(void)
 {
+	unsigned int i;
+
+	/* one bucket per 128k of memory, like the inode hash is per 16k */
+	integrity_iint_hash =
+		alloc_large_system_hash("iint", sizeof(struct hlist_bl_head),
+					0, 17, 0, &integrity_iint_hash_shift,
+					NULL, 0, 0);
+	for (i = 0; i < (1U << integrity_iint_hash_shift); i++)
+		INIT_HLIST_BL_HEAD(&integrity_iint_hash[i]);
+
 	iint_cache =
 	    kmem_cache_create("iint_cache", sizeof(struct integrity_iint_cache),
 			      0, SLAB_PANIC, init_once);
@@ -23,6 +23,7 @@
 #include <linux/hash.h>
 #include <linux/tpm.h>
 #include <linux/audit.h>
+#include <asm/unaligned.h>
 
 #include "../integrity.h"
 
@@ -70,12 +71,14 @@ void ima_fs_cleanup(void);
 int ima_inode_alloc(struct inode *inode);
 int ima_add_template_entry(struct ima_template_entry *entry, int violation,
 			   const char *op, struct inode *inode);
+struct ima_queue_entry *ima_measurement_at(unsigned long n);
 int ima_calc_file_hash(struct file *file, char *digest);
 int ima_calc_buffer_hash(const void *data, int len, char *digest);
 int ima_calc_boot_aggregate(char *digest);
 void ima_add_violation(struct inode *inode, const unsigned char *filename,
 		       const char *op, const char *cause);
 int ima_init_crypto(void);
+void ima_want_digests(bool want);
 
 /*
  * used to protect h_table and sha_table
@@ -85,13 +88,15 @@ extern spinlock_t ima_queue_lock;
 struct ima_h_table {
 	atomic_long_t len;	/* number of stored measurements in the list */
 	atomic_long_t violations;
-	struct hlist_head queue[IMA_MEASURE_HTABLE_SIZE];
+	unsigned int bits;	/* of the number of buckets */
+	struct hlist_head *queue;
 };
 extern struct ima_h_table ima_htable;
 
-static inline unsigned long ima_hash_key(u8 *digest)
+/* the digest is a cryptographic hash, its first word is as good as any */
+static inline unsigned long ima_hash_key(u8 *digest, unsigned int bits)
 {
-	return hash_long(*digest, IMA_HASH_BITS);
+	return hash_32(get_unaligned((u32 *)digest), bits);
 }
 
 /* LIM API function definitions */
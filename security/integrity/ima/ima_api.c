@@ -36,7 +36,8 @@ static const char *IMA_TEMPLATE_NAME = "ima";
  * TPM PCR (called quote) can be retrieved using a TPM user space library
  * and is used to validate the measurement list.
  *
- * Returns 0 on success, error code otherwise
+ * Returns 0 on success, error code otherwise.  On success, the entry
+ * was copied into the list and freed.
  */
 int ima_store_template(struct ima_template_entry *entry,
 		       int violation, struct inode *inode)
@@ -199,10 +199,16 @@ out:
 		}
 		integrity_audit_msg(AUDIT_INTEGRITY_DATA, inode, filename,
 				    op, cause, rc, 0);
+		ima_set_cache_status(iint, func, status);
 	} else {
+		ima_set_cache_status(iint, func, status);
+		/*
+		 * process_measurement() reads the status without i_mutex
+		 * once it sees the flags: the status goes first.
+		 */
+		smp_wmb();
 		ima_cache_flags(iint, func);
 	}
-	ima_set_cache_status(iint, func, status);
 	kfree(xattr_value);
 	return status;
 }
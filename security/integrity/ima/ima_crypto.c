@@ -19,6 +19,7 @@
 #include <linux/scatterlist.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/integrity.h>
 #include <crypto/hash.h>
 #include "ima.h"
 
@@ -38,18 +39,29 @@ int ima_init_crypto(void)
 }
 
 /*
- * Calculate the MD5/SHA1 file digest
+ * With rules to measure or appraise files, ask the modules hashing them
+ * before IMA does for their digest too.
+ */
+void ima_want_digests(bool want)
+{
+	integrity_want_digest(want ? ima_shash_tfm : NULL);
+}
+
+/*
+ * Calculate the MD5/SHA1 file digest, unless another module hashed the
+ * file already
  */
 int ima_calc_file_hash(struct file *file, char *digest)
 {
-	loff_t i_size, offset = 0;
-	char *rbuf;
 	int rc, read = 0;
 	struct {
 		struct shash_desc shash;
 		char ctx[crypto_shash_descsize(ima_shash_tfm)];
 	} desc;
 
+	if (!integrity_shared_digest(file, ima_shash_tfm, (u8 *)digest))
+		return 0;
+
 	desc.shash.tfm = ima_shash_tfm;
 	desc.shash.flags = 0;
 
@@ -57,38 +69,15 @@ int ima_calc_file_hash(struct file *file, char *digest)
 	if (rc != 0)
 		return rc;
 
-	rbuf = kzalloc(PAGE_SIZE, GFP_KERNEL);
-	if (!rbuf) {
-		rc = -ENOMEM;
-		goto out;
-	}
 	if (!(file->f_mode & FMODE_READ)) {
 		file->f_mode |= FMODE_READ;
 		read = 1;
 	}
-	i_size = i_size_read(file_inode(file));
-	while (offset < i_size) {
-		int rbuf_len;
-
-		rbuf_len = kernel_read(file, offset, rbuf, PAGE_SIZE);
-		if (rbuf_len < 0) {
-			rc = rbuf_len;
-			break;
-		}
-		if (rbuf_len == 0)
-			break;
-		offset += rbuf_len;
-
-		rc = crypto_shash_update(&desc.shash, rbuf, rbuf_len);
-		if (rc)
-			break;
-	}
-	kfree(rbuf);
+	rc = integrity_hash_file(file, &desc.shash);
 	if (!rc)
 		rc = crypto_shash_final(&desc.shash, digest);
 	if (read)
 		file->f_mode &= ~FMODE_READ;
-out:
 	return rc;
 }
 
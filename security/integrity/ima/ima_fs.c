@@ -65,19 +65,8 @@ static const struct file_operations ima_measurements_count_ops = {
 /* returns pointer to hlist_node */
 static void *ima_measurements_start(struct seq_file *m, loff_t *pos)
 {
-	loff_t l = *pos;
-	struct ima_queue_entry *qe;
-
-	/* we need a lock since pos could point beyond last element */
-	rcu_read_lock();
-	list_for_each_entry_rcu(qe, &ima_measurements, later) {
-		if (!l--) {
-			rcu_read_unlock();
-			return qe;
-		}
-	}
-	rcu_read_unlock();
-	return NULL;
+	/* found from the index: each read() of the file starts here again */
+	return ima_measurement_at(*pos);
 }
 
 static void *ima_measurements_next(struct seq_file *m, void *v, loff_t *pos)
@@ -102,8 +91,7 @@ static void ima_measurements_stop(struct seq_file *m, void *v)
 
 static void ima_putc(struct seq_file *m, void *data, int datalen)
 {
-	while (datalen--)
-		seq_putc(m, *(char *)data++);
+	seq_write(m, data, datalen);
 }
 
 /* print format:
@@ -168,6 +156,104 @@ static const struct file_operations ima_measurements_ops = {
 	.release = seq_release,
 };
 
+/*
+ * Put an entry at @p in the format of binary_runtime_measurements, if it
+ * fits in @size bytes.  Returns its length, or 0 if it does not fit.
+ */
+static size_t ima_measurement_put(char *p, size_t size,
+				  struct ima_template_entry *e)
+{
+	u32 pcr = CONFIG_IMA_MEASURE_PCR_IDX;
+	u32 namelen = strlen(e->template_name);
+	u32 filelen = strlen(e->template.file_name);
+	size_t len;
+
+	len = sizeof pcr + IMA_DIGEST_SIZE + sizeof namelen + namelen +
+	      IMA_DIGEST_SIZE + sizeof filelen + filelen;
+	if (len > size)
+		return 0;
+
+	memcpy(p, &pcr, sizeof pcr);
+	p += sizeof pcr;
+	memcpy(p, e->digest, IMA_DIGEST_SIZE);
+	p += IMA_DIGEST_SIZE;
+	memcpy(p, &namelen, sizeof namelen);
+	p += sizeof namelen;
+	memcpy(p, e->template_name, namelen);
+	p += namelen;
+	memcpy(p, e->template.digest, IMA_DIGEST_SIZE);
+	p += IMA_DIGEST_SIZE;
+	memcpy(p, &filelen, sizeof filelen);
+	p += sizeof filelen;
+	memcpy(p, e->template.file_name, filelen);
+	return len;
+}
+
+/*
+ * binary_runtime_measurements_batch: the entries of
+ * binary_runtime_measurements, with the file position counting entries
+ * rather than bytes.  A read returns the whole entries from the position
+ * on that fit, formatted a page at a time, and moves the position past
+ * them; a reader that keeps the file open, or seeks back to where it
+ * stopped, reads only the measurements added since.
+ */
+static ssize_t ima_read_measurements_batch(struct file *file,
+					   char __user *buf,
+					   size_t count, loff_t *ppos)
+{
+	struct ima_queue_entry *qe;
+	struct list_head *next;
+	char *page;
+	size_t len, n, room;
+	ssize_t done = 0;
+	loff_t pos = *ppos;
+
+	if (pos < 0)
+		return -EINVAL;
+	qe = ima_measurement_at(pos);
+	if (!qe)
+		return 0;
+
+	page = (char *)__get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	while (qe && done < count) {
+		room = min_t(size_t, count - done, PAGE_SIZE);
+		for (len = 0; qe; pos++) {
+			n = ima_measurement_put(page + len, room - len,
+						qe->entry);
+			if (!n)
+				break;
+			len += n;
+
+			rcu_read_lock();
+			next = rcu_dereference(list_next_rcu(&qe->later));
+			rcu_read_unlock();
+			qe = next == &ima_measurements ? NULL :
+				list_entry(next, struct ima_queue_entry, later);
+		}
+		if (!len)
+			break;
+		if (copy_to_user(buf + done, page, len)) {
+			if (!done)
+				done = -EFAULT;
+			break;
+		}
+		done += len;
+		*ppos = pos;
+	}
+	free_page((unsigned long)page);
+
+	/* no room for even one entry */
+	return done ? done : -EINVAL;
+}
+
+static const struct file_operations ima_measurements_batch_ops = {
+	.read = ima_read_measurements_batch,
+	.llseek = generic_file_llseek,
+};
+
 static void ima_print_digest(struct seq_file *m, u8 *digest)
 {
 	int i;
@@ -278,6 +364,7 @@ out:
 
 static struct dentry *ima_dir;
 static struct dentry *binary_runtime_measurements;
+static struct dentry *binary_runtime_measurements_batch;
 static struct dentry *ascii_runtime_measurements;
 static struct dentry *runtime_measurements_count;
 static struct dentry *violations;
@@ -338,6 +425,13 @@ int __init ima_fs_init(void)
 	if (IS_ERR(binary_runtime_measurements))
 		goto out;
 
+	binary_runtime_measurements_batch =
+	    securityfs_create_file("binary_runtime_measurements_batch",
+				   S_IRUSR | S_IRGRP, ima_dir, NULL,
+				   &ima_measurements_batch_ops);
+	if (IS_ERR(binary_runtime_measurements_batch))
+		goto out;
+
 	ascii_runtime_measurements =
 	    securityfs_create_file("ascii_runtime_measurements",
 				   S_IRUSR | S_IRGRP, ima_dir, NULL,
@@ -370,6 +464,7 @@ out:
 	securityfs_remove(violations);
 	securityfs_remove(runtime_measurements_count);
 	securityfs_remove(ascii_runtime_measurements);
+	securityfs_remove(binary_runtime_measurements_batch);
 	securityfs_remove(binary_runtime_measurements);
 	securityfs_remove(ima_dir);
 	securityfs_remove(ima_policy);
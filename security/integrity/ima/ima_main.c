@@ -108,6 +108,14 @@ static void ima_check_last_writer(struct integrity_iint_cache *iint,
 	if (!(mode & FMODE_WRITE))
 		return;
 
+	/*
+	 * The version is that of the contents last measured: if it is
+	 * still the inode's, there is nothing to reset, and no need to
+	 * take i_mutex on every close.
+	 */
+	if (ACCESS_ONCE(iint->version) == inode->i_version)
+		return;
+
 	mutex_lock(&inode->i_mutex);
 	if (atomic_read(&inode->i_writecount) == 1 &&
 	    iint->version != inode->i_version) {
@@ -139,6 +147,27 @@ void ima_file_free(struct file *file)
 	ima_check_last_writer(iint, inode, file);
 }
 
+/*
+ * Has everything the action asks for already been done?  Read without
+ * i_mutex; the flags are only trusted once they have all the action's
+ * bits, as process_measurement() would have set them.
+ */
+static bool ima_settled(struct integrity_iint_cache *iint, int action,
+			unsigned long *flagsp)
+{
+	unsigned long flags = ACCESS_ONCE(iint->flags);
+
+	if ((flags & action) != action)
+		return false;
+	action &= IMA_DO_MASK;
+	if (action & ~((flags & IMA_DONE_MASK) >> 1))
+		return false;
+	/* pairs with the smp_wmb() in ima_appraise_measurement() */
+	smp_rmb();
+	*flagsp = flags;
+	return true;
+}
+
 static int process_measurement(struct file *file, const char *filename,
 			       int mask, int function)
 {
@@ -146,6 +175,7 @@ static int process_measurement(struct file *file, const char *filename,
 	struct integrity_iint_cache *iint;
 	char *pathbuf = NULL;
 	const char *pathname = NULL;
+	unsigned long flags;
 	int rc = -ENOMEM, action, must_appraise, _func;
 
 	if (!ima_initialized || !S_ISREG(inode->i_mode))
@@ -164,6 +194,15 @@ static int process_measurement(struct file *file, const char *filename,
 	/*  Is the appraise rule hook specific?  */
 	_func = (action & IMA_FILE_APPRAISE) ? FILE_CHECK : function;
 
+	/* Already measured and appraised: the cached status, without i_mutex */
+	iint = integrity_iint_find(inode);
+	if (iint && ima_settled(iint, action, &flags)) {
+		rc = must_appraise ? ima_get_cache_status(iint, _func) : 0;
+		if ((mask & MAY_WRITE) && (flags & IMA_DIGSIG))
+			rc = -EACCES;
+		goto out_settled;
+	}
+
 	mutex_lock(&inode->i_mutex);
 
 	iint = integrity_inode_get(inode);
@@ -205,6 +244,7 @@ out_digsig:
 		rc = -EACCES;
 out:
 	mutex_unlock(&inode->i_mutex);
+out_settled:
 	if ((rc && must_appraise) && (ima_appraise & IMA_APPRAISE_ENFORCE))
 		return -EACCES;
 	return 0;
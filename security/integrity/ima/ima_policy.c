@@ -17,6 +17,8 @@
 #include <linux/parser.h>
 #include <linux/slab.h>
 #include <linux/genhd.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 
 #include "ima.h"
 
@@ -105,6 +107,29 @@ static LIST_HEAD(ima_default_rules);
 static LIST_HEAD(ima_policy_rules);
 static struct list_head *ima_rules;
 
+/*
+ * The rules compiled for lookup, for each hook: those a file can match
+ * through the hook, in policy order, as NULL terminated arrays.  Files
+ * of a filesystem a rule names by fsmagic take the array of that
+ * fsmagic, found by hash; the others take the array of the rules that
+ * name none.  The policy does not change once loaded, so neither does
+ * its index; without one, the rules are walked as they are.
+ */
+#define IMA_HOOKS (POST_SETATTR + 1)
+
+struct ima_magic_slot {
+	unsigned long fsmagic;
+	struct ima_rule_entry **rules;	/* NULL for an empty slot */
+};
+
+struct ima_rule_index {
+	struct ima_rule_entry **any[IMA_HOOKS];
+	struct ima_magic_slot *magic[IMA_HOOKS];
+	unsigned int magic_bits;
+};
+
+static struct ima_rule_index *ima_rules_index;
+
 static DEFINE_MUTEX(ima_rules_mutex);
 
 static bool ima_use_tcb __initdata;
@@ -246,6 +271,50 @@ static int get_subaction(struct ima_rule_entry *rule, int func)
 	}
 }
 
+static struct ima_rule_entry **ima_index_rules(struct ima_rule_index *idx,
+					       enum ima_hooks func,
+					       unsigned long fsmagic)
+{
+	struct ima_magic_slot *table = idx->magic[func];
+	unsigned int mask = (1U << idx->magic_bits) - 1;
+	unsigned int i;
+
+	if (table)
+		for (i = hash_long(fsmagic, idx->magic_bits); table[i].rules;
+		     i = (i + 1) & mask)
+			if (table[i].fsmagic == fsmagic)
+				return table[i].rules;
+	return idx->any[func];
+}
+
+/*
+ * Apply a rule to the action being decided.  Returns true once every
+ * action of actmask is decided.
+ */
+static bool ima_apply_rule(struct ima_rule_entry *entry, struct inode *inode,
+			   enum ima_hooks func, int mask, int *action,
+			   int *actmask)
+{
+	if (!(entry->action & *actmask))
+		return false;
+
+	if (!ima_match_rules(entry, inode, func, mask))
+		return false;
+
+	*action |= entry->flags & IMA_ACTION_FLAGS;
+
+	*action |= entry->action & IMA_DO_MASK;
+	if (entry->action & IMA_APPRAISE)
+		*action |= get_subaction(entry, func);
+
+	if (entry->action & IMA_DO_MASK)
+		*actmask &= ~(entry->action | entry->action << 1);
+	else
+		*actmask &= ~(entry->action | entry->action >> 1);
+
+	return !*actmask;
+}
+
 /**
  * ima_match_policy - decision based on LSM and other conditions
  * @inode: pointer to an inode for which the policy decision is being made
@@ -257,38 +326,154 @@ static int get_subaction(struct ima_rule_entry *rule, int func)
  *
  * (There is no need for locking when walking the policy list,
  * as elements in the list are never deleted, nor does the list
- * change.)
+ * change.  The same goes for its index.)
  */
 int ima_match_policy(struct inode *inode, enum ima_hooks func, int mask,
 		     int flags)
 {
-	struct ima_rule_entry *entry;
+	struct ima_rule_index *idx = ACCESS_ONCE(ima_rules_index);
+	struct ima_rule_entry *entry, **rules;
 	int action = 0, actmask = flags | (flags << 1);
 
-	list_for_each_entry(entry, ima_rules, list) {
+	if (idx && func > 0 && func < IMA_HOOKS) {
+		smp_read_barrier_depends();
+		rules = ima_index_rules(idx, func, inode->i_sb->s_magic);
+		for (; *rules; rules++)
+			if (ima_apply_rule(*rules, inode, func, mask, &action,
+					   &actmask))
+				break;
+		return action;
+	}
 
-		if (!(entry->action & actmask))
-			continue;
+	list_for_each_entry(entry, ima_rules, list)
+		if (ima_apply_rule(entry, inode, func, mask, &action, &actmask))
+			break;
 
-		if (!ima_match_rules(entry, inode, func, mask))
-			continue;
+	return action;
+}
 
-		action |= entry->flags & IMA_ACTION_FLAGS;
+/* could the rule match a file through the hook, on a fs of the fsmagic? */
+static bool ima_rule_applies(struct ima_rule_entry *entry, enum ima_hooks func,
+			     const unsigned long *fsmagic)
+{
+	if ((entry->flags & IMA_FUNC) && entry->func != func)
+		return false;
+	if (!(entry->flags & IMA_FSMAGIC))
+		return true;
+	return fsmagic && entry->fsmagic == *fsmagic;
+}
 
-		action |= entry->action & IMA_DO_MASK;
-		if (entry->action & IMA_APPRAISE)
-			action |= get_subaction(entry, func);
+static struct ima_rule_entry **ima_compile_rules(struct list_head *rules,
+						 int nrules,
+						 enum ima_hooks func,
+						 const unsigned long *fsmagic)
+{
+	struct ima_rule_entry *entry, **array;
+	int n = 0;
+
+	array = kcalloc(nrules + 1, sizeof(*array), GFP_KERNEL);
+	if (!array)
+		return NULL;
+	list_for_each_entry(entry, rules, list)
+		if (ima_rule_applies(entry, func, fsmagic))
+			array[n++] = entry;
+	return array;
+}
 
-		if (entry->action & IMA_DO_MASK)
-			actmask &= ~(entry->action | entry->action << 1);
-		else
-			actmask &= ~(entry->action | entry->action >> 1);
+static void ima_free_index(struct ima_rule_index *idx)
+{
+	unsigned int func, i;
 
-		if (!actmask)
-			break;
+	for (func = 0; func < IMA_HOOKS; func++) {
+		kfree(idx->any[func]);
+		if (!idx->magic[func])
+			continue;
+		for (i = 0; i < (1U << idx->magic_bits); i++)
+			kfree(idx->magic[func][i].rules);
+		kfree(idx->magic[func]);
 	}
+	kfree(idx);
+}
 
-	return action;
+/*
+ * Compile the rules into an index, see ima_rule_index.  Returns NULL if
+ * it can not be allocated; the rules are then walked.
+ */
+static struct ima_rule_index *ima_compile_policy(struct list_head *rules)
+{
+	struct ima_rule_entry *entry, *other;
+	struct ima_rule_index *idx;
+	struct ima_magic_slot *slot;
+	unsigned int func, i, nmagic = 0, mask;
+	int nrules = 0;
+
+	idx = kzalloc(sizeof(*idx), GFP_KERNEL);
+	if (!idx)
+		return NULL;
+
+	/* each fsmagic named is counted at the first rule naming it */
+	list_for_each_entry(entry, rules, list) {
+		nrules++;
+		if (!(entry->flags & IMA_FSMAGIC))
+			continue;
+		list_for_each_entry(other, rules, list) {
+			if (other == entry) {
+				nmagic++;
+				break;
+			}
+			if ((other->flags & IMA_FSMAGIC) &&
+			    other->fsmagic == entry->fsmagic)
+				break;
+		}
+	}
+	idx->magic_bits = nmagic ? ilog2(roundup_pow_of_two(nmagic)) + 1 : 0;
+	mask = (1U << idx->magic_bits) - 1;
+
+	for (func = 1; func < IMA_HOOKS; func++) {
+		idx->any[func] = ima_compile_rules(rules, nrules, func, NULL);
+		if (!idx->any[func])
+			goto err;
+		if (!nmagic)
+			continue;
+
+		idx->magic[func] = kcalloc(mask + 1, sizeof(*slot), GFP_KERNEL);
+		if (!idx->magic[func])
+			goto err;
+		list_for_each_entry(entry, rules, list) {
+			if (!(entry->flags & IMA_FSMAGIC))
+				continue;
+			for (i = hash_long(entry->fsmagic, idx->magic_bits);
+			     (slot = &idx->magic[func][i])->rules;
+			     i = (i + 1) & mask)
+				if (slot->fsmagic == entry->fsmagic)
+					break;
+			if (slot->rules)
+				continue;
+			slot->rules = ima_compile_rules(rules, nrules, func,
+							&entry->fsmagic);
+			if (!slot->rules)
+				goto err;
+			slot->fsmagic = entry->fsmagic;
+		}
+	}
+	return idx;
+
+err:
+	ima_free_index(idx);
+	return NULL;
+}
+
+static void ima_set_rules(struct list_head *rules)
+{
+	struct ima_rule_index *idx = ima_compile_policy(rules);
+
+	if (!idx)
+		pr_warn("IMA: no memory to index the policy, rules are walked\n");
+	/* the index is complete, and the rules are, before either is used */
+	smp_wmb();
+	ACCESS_ONCE(ima_rules_index) = idx;
+	ima_rules = rules;
+	ima_want_digests(!list_empty(rules));
 }
 
 /**
@@ -318,7 +503,7 @@ void __init ima_init_policy(void)
 		}
 	}
 
-	ima_rules = &ima_default_rules;
+	ima_set_rules(&ima_default_rules);
 }
 
 /**
@@ -336,7 +521,8 @@ void ima_update_policy(void)
 	int audit_info = 0;
 
 	if (ima_rules == &ima_default_rules) {
-		ima_rules = &ima_policy_rules;
+		/* the index of the default rules is kept, lookups may use it */
+		ima_set_rules(&ima_policy_rules);
 		cause = "complete";
 		result = 0;
 	}
@@ -17,21 +17,55 @@
  *       in the pre-configured TPM PCR (if available).
  *       The measurement list is append-only. No entry is
  *       ever removed or changed during the boot-cycle.
+ *
+ *       Entries are packed into pages that are never freed,
+ *       each queue entry followed by its template entry, the
+ *       file name taking only its length.  The hash table of
+ *       the digests doubles as the list grows.
+ *
+ *       The PCR is extended by a worker, in list order, so that
+ *       the list is not held while the TPM works: a burst of
+ *       measurements is extended in one run, and each measuring
+ *       task waits for the run past its own entry, so that a file
+ *       is still measured into the PCR before it is used.
+ *
+ *       Every IMA_INDEX_STRIDE-th measurement is indexed, so that
+ *       the list can be read from any entry without walking it
+ *       from the start.
  */
 #include <linux/module.h>
 #include <linux/rculist.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/gfp.h>
+#include <linux/workqueue.h>
 #include "ima.h"
 
 #define AUDIT_CAUSE_LEN_MAX 32
 
+/* the table doubles past this many measurements per bucket */
+#define IMA_HTABLE_LOAD 2
+#define IMA_HASH_BITS_MAX 20
+
+/* indexed measurements: 1 in 64, 16M of them in 512 pages of pointers */
+#define IMA_INDEX_STRIDE 64
+#define IMA_INDEX_PER_PAGE (PAGE_SIZE / sizeof(struct ima_queue_entry *))
+#define IMA_INDEX_PAGES 512
+
 LIST_HEAD(ima_measurements);	/* list of all measurements */
 
-/* key: inode (before secure-hashing a file) */
+static struct hlist_head ima_htable_initial[IMA_MEASURE_HTABLE_SIZE];
+
+/*
+ * key: template digest.  Only looked up and changed under
+ * ima_extend_list_mutex, so it is moved to a larger table in place.
+ */
 struct ima_h_table ima_htable = {
 	.len = ATOMIC_LONG_INIT(0),
 	.violations = ATOMIC_LONG_INIT(0),
-	.queue[0 ... IMA_MEASURE_HTABLE_SIZE - 1] = HLIST_HEAD_INIT
+	.bits = IMA_HASH_BITS,
+	.queue = ima_htable_initial,
 };
 
 /* mutex protects atomicity of extending measurement list
@@ -40,28 +74,163 @@ struct ima_h_table ima_htable = {
  */
 static DEFINE_MUTEX(ima_extend_list_mutex);
 
+static void ima_extend_work_fn(struct work_struct *work);
+static DECLARE_WORK(ima_extend_work, ima_extend_work_fn);
+
+/* the last measurement the worker extended the PCR with */
+static struct list_head *ima_extended = &ima_measurements;
+
+/* what is left of the page entries are taken from */
+static char *ima_arena;
+static size_t ima_arena_left;
+
+/*
+ * Slot i points to measurement i * IMA_INDEX_STRIDE.  The slots are
+ * filled in order under ima_extend_list_mutex, and read without it up
+ * to ima_indexed; like the entries, the pages are never freed.
+ */
+static struct ima_queue_entry **ima_index[IMA_INDEX_PAGES];
+static unsigned long ima_indexed;
+
 /* lookup up the digest value in the hash table, and return the entry */
 static struct ima_queue_entry *ima_lookup_digest_entry(u8 *digest_value)
 {
-	struct ima_queue_entry *qe, *ret = NULL;
+	struct ima_queue_entry *qe;
 	unsigned int key;
-	int rc;
 
-	key = ima_hash_key(digest_value);
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(qe, &ima_htable.queue[key], hnext) {
-		rc = memcmp(qe->entry->digest, digest_value, IMA_DIGEST_SIZE);
-		if (rc == 0) {
-			ret = qe;
-			break;
+	key = ima_hash_key(digest_value, ima_htable.bits);
+	hlist_for_each_entry(qe, &ima_htable.queue[key], hnext)
+		if (!memcmp(qe->entry->digest, digest_value, IMA_DIGEST_SIZE))
+			return qe;
+	return NULL;
+}
+
+/*
+ * Move the entries to a table of twice the buckets.  A table that can
+ * not be had leaves the chains longer, nothing else.
+ *
+ * (Called with ima_extend_list_mutex held.)
+ */
+static void ima_htable_grow(void)
+{
+	unsigned int bits = ima_htable.bits + 1, i;
+	size_t size = sizeof(struct hlist_head) << bits;
+	struct hlist_head *queue, *old = ima_htable.queue;
+	struct ima_queue_entry *qe;
+	struct hlist_node *tmp;
+
+	if (bits > IMA_HASH_BITS_MAX)
+		return;
+	queue = size <= PAGE_SIZE << 1 ? kzalloc(size, GFP_KERNEL | __GFP_NOWARN)
+				       : vzalloc(size);
+	if (!queue)
+		return;
+
+	for (i = 0; i < (1U << ima_htable.bits); i++)
+		hlist_for_each_entry_safe(qe, tmp, &old[i], hnext) {
+			hlist_del(&qe->hnext);
+			hlist_add_head(&qe->hnext,
+				&queue[ima_hash_key(qe->entry->digest, bits)]);
 		}
+	ima_htable.queue = queue;
+	ima_htable.bits = bits;
+
+	if (old == ima_htable_initial)
+		return;
+	if (is_vmalloc_addr(old))
+		vfree(old);
+	else
+		kfree(old);
+}
+
+/*
+ * Index measurement N, if it is one of a stride, and all the ones before
+ * it could be.  A page that can not be had leaves the tail of the list
+ * to be walked, nothing else.
+ *
+ * (Called with ima_extend_list_mutex held.)
+ */
+static void ima_index_add(struct ima_queue_entry *qe, unsigned long n)
+{
+	unsigned long slot = n / IMA_INDEX_STRIDE;
+	unsigned long page = slot / IMA_INDEX_PER_PAGE;
+
+	if (n % IMA_INDEX_STRIDE || slot != ima_indexed ||
+	    page >= IMA_INDEX_PAGES)
+		return;
+	if (!ima_index[page]) {
+		ima_index[page] = (void *)get_zeroed_page(GFP_KERNEL);
+		if (!ima_index[page])
+			return;
 	}
+	ima_index[page][slot % IMA_INDEX_PER_PAGE] = qe;
+	smp_wmb();	/* the slot, then the count that covers it */
+	ACCESS_ONCE(ima_indexed) = slot + 1;
+}
+
+/**
+ * ima_measurement_at - find a measurement by its place in the list
+ * @n: the number of measurements listed before it
+ *
+ * Returns the queue entry, or NULL if there are no more than @n
+ * measurements.  Walks at most IMA_INDEX_STRIDE - 1 entries while the
+ * index keeps up; entries are never removed, so the one returned stays.
+ */
+struct ima_queue_entry *ima_measurement_at(unsigned long n)
+{
+	unsigned long indexed = ACCESS_ONCE(ima_indexed);
+	unsigned long slot, i = 0;
+	struct list_head *p;
+
+	rcu_read_lock();
+	if (indexed) {
+		slot = min(n / IMA_INDEX_STRIDE, indexed - 1);
+		smp_rmb();	/* the count, then the slots it covers */
+		p = &ima_index[slot / IMA_INDEX_PER_PAGE]
+			      [slot % IMA_INDEX_PER_PAGE]->later;
+		i = slot * IMA_INDEX_STRIDE;
+	} else {
+		p = rcu_dereference(list_next_rcu(&ima_measurements));
+	}
+	for (; p != &ima_measurements && i < n; i++)
+		p = rcu_dereference(list_next_rcu(p));
 	rcu_read_unlock();
-	return ret;
+
+	return p == &ima_measurements ? NULL :
+		list_entry(p, struct ima_queue_entry, later);
+}
+
+/*
+ * Room for an entry, from the current page.  The pages are never freed,
+ * no more than the entries.
+ *
+ * (Called with ima_extend_list_mutex held.)
+ */
+static void *ima_arena_alloc(size_t size)
+{
+	void *p;
+
+	size = ALIGN(size, sizeof(long));
+	if (size > ima_arena_left) {
+		if (size > PAGE_SIZE)
+			return NULL;
+		ima_arena = (char *)__get_free_page(GFP_KERNEL);
+		if (!ima_arena) {
+			ima_arena_left = 0;
+			return NULL;
+		}
+		ima_arena_left = PAGE_SIZE;
+	}
+	p = ima_arena;
+	ima_arena += size;
+	ima_arena_left -= size;
+	return p;
 }
 
 /* ima_add_template_entry helper function:
- * - Add template entry to measurement list and hash table.
+ * - Add a copy of the template entry to measurement list and hash table.
+ *   The copy keeps the file name only up to its end, which is all that
+ *   is read of it once it is in the list.
  *
  * (Called with ima_extend_list_mutex held.)
  */
@@ -69,20 +238,30 @@ static int ima_add_digest_entry(struct ima_template_entry *entry)
 {
 	struct ima_queue_entry *qe;
 	unsigned int key;
+	size_t len;
 
-	qe = kmalloc(sizeof(*qe), GFP_KERNEL);
+	len = offsetof(struct ima_template_entry, template.file_name) +
+	      strnlen(entry->template.file_name, IMA_EVENT_NAME_LEN_MAX) + 1;
+	qe = ima_arena_alloc(sizeof(*qe) + len);
 	if (qe == NULL) {
 		pr_err("IMA: OUT OF MEMORY ERROR creating queue entry.\n");
 		return -ENOMEM;
 	}
-	qe->entry = entry;
+	qe->entry = (struct ima_template_entry *)(qe + 1);
+	memcpy(qe->entry, entry, len);
+	qe->entry->template.file_name[len - 1 -
+		offsetof(struct ima_template_entry, template.file_name)] = '\0';
 
 	INIT_LIST_HEAD(&qe->later);
 	list_add_tail_rcu(&qe->later, &ima_measurements);
+	ima_index_add(qe, atomic_long_read(&ima_htable.len));
 
 	atomic_long_inc(&ima_htable.len);
-	key = ima_hash_key(entry->digest);
-	hlist_add_head_rcu(&qe->hnext, &ima_htable.queue[key]);
+	if (atomic_long_read(&ima_htable.len) >
+	    (IMA_HTABLE_LOAD << ima_htable.bits))
+		ima_htable_grow();
+	key = ima_hash_key(entry->digest, ima_htable.bits);
+	hlist_add_head(&qe->hnext, &ima_htable.queue[key]);
 	return 0;
 }
 
@@ -100,17 +279,59 @@ static int ima_pcr_extend(const u8 *hash)
 	return result;
 }
 
+/*
+ * Extend the PCR with the measurements added since the last run, in the
+ * order of the list.  Violations, listed with a zero digest, invalidate
+ * the PCR with ff...ff's.  The list only grows, so it is walked without
+ * ima_extend_list_mutex, which adding measurements takes meanwhile.
+ */
+static void ima_extend_work_fn(struct work_struct *work)
+{
+	const char *op = "add_template_measure";
+	char tpm_audit_cause[AUDIT_CAUSE_LEN_MAX];
+	struct ima_queue_entry *qe;
+	struct list_head *next;
+	u8 digest[IMA_DIGEST_SIZE];
+	int tpmresult;
+
+	for (;;) {
+		rcu_read_lock();
+		next = rcu_dereference(list_next_rcu(ima_extended));
+		rcu_read_unlock();
+		if (next == &ima_measurements)
+			break;
+		qe = list_entry(next, struct ima_queue_entry, later);
+
+		if (memchr_inv(qe->entry->digest, 0, IMA_DIGEST_SIZE))
+			memcpy(digest, qe->entry->digest, sizeof digest);
+		else
+			memset(digest, 0xff, sizeof digest);
+
+		tpmresult = ima_pcr_extend(digest);
+		if (tpmresult != 0) {
+			snprintf(tpm_audit_cause, AUDIT_CAUSE_LEN_MAX,
+				 "TPM_error(%d)", tpmresult);
+			integrity_audit_msg(AUDIT_INTEGRITY_PCR, NULL,
+					    qe->entry->template.file_name,
+					    op, tpm_audit_cause, 0, 0);
+		}
+		ima_extended = next;
+		cond_resched();
+	}
+}
+
 /* Add template entry to the measurement list and hash table,
- * and extend the pcr.
+ * and have the worker extend the pcr; return once it has.
+ *
+ * The list keeps a copy of the entry: on success, the entry is freed.
  */
 int ima_add_template_entry(struct ima_template_entry *entry, int violation,
 			   const char *op, struct inode *inode)
 {
 	u8 digest[IMA_DIGEST_SIZE];
 	const char *audit_cause = "hash_added";
-	char tpm_audit_cause[AUDIT_CAUSE_LEN_MAX];
 	int audit_info = 1;
-	int result = 0, tpmresult = 0;
+	int result = 0;
 
 	mutex_lock(&ima_extend_list_mutex);
 	if (!violation) {
@@ -129,20 +350,18 @@ int ima_add_template_entry(struct ima_template_entry *entry, int violation,
 		goto out;
 	}
 
-	if (violation)		/* invalidate pcr */
-		memset(digest, 0xff, sizeof digest);
-
-	tpmresult = ima_pcr_extend(digest);
-	if (tpmresult != 0) {
-		snprintf(tpm_audit_cause, AUDIT_CAUSE_LEN_MAX, "TPM_error(%d)",
-			 tpmresult);
-		audit_cause = tpm_audit_cause;
-		audit_info = 0;
-	}
+	/* violations are listed with a zero digest and invalidate the pcr */
+	if (ima_used_chip)
+		schedule_work(&ima_extend_work);
 out:
 	mutex_unlock(&ima_extend_list_mutex);
+	/* the run queued after the entry was listed extends it */
+	if (!result && ima_used_chip)
+		flush_work(&ima_extend_work);
 	integrity_audit_msg(AUDIT_INTEGRITY_PCR, inode,
 			    entry->template.file_name,
 			    op, audit_cause, result, audit_info);
+	if (!result)
+		kfree(entry);
 	return result;
 }
@@ -12,6 +12,8 @@
  */
 
 #include <linux/types.h>
+#include <linux/list_bl.h>
+#include <linux/rcupdate.h>
 #include <linux/integrity.h>
 #include <crypto/sha.h>
 #include <linux/key.h>
@@ -63,7 +65,8 @@ struct evm_ima_xattr_data {
 
 /* integrity data associated with an inode */
 struct integrity_iint_cache {
-	struct rb_node rb_node; /* rooted in integrity_iint_tree */
+	struct hlist_bl_node hnode; /* in its integrity_iint_hash bucket */
+	struct rcu_head rcu;
 	struct inode *inode;	/* back pointer to inode in question */
 	u64 version;		/* track inode changes */
 	unsigned long flags;
@@ -75,12 +78,15 @@ struct integrity_iint_cache {
 	enum integrity_status evm_status:4;
 };
 
-/* rbtree tree calls to lookup, insert, delete
+/* hash table calls to lookup, insert, delete
  * integrity data associated with an inode.
  */
 struct integrity_iint_cache *integrity_iint_insert(struct inode *inode);
 struct integrity_iint_cache *integrity_iint_find(struct inode *inode);
 
+struct shash_desc;
+int integrity_hash_file(struct file *file, struct shash_desc *desc);
+
 #define INTEGRITY_KEYRING_EVM		0
 #define INTEGRITY_KEYRING_MODULE	1
 #define INTEGRITY_KEYRING_IMA		2
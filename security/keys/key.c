@@ -295,6 +295,7 @@ struct key *key_alloc(struct key_type *type, const char *desc,
 	key->flags = 0;
 	key->expiry = 0;
 	key->payload.data = NULL;
+	key->changes = 0;
 	key->security = NULL;
 
 	if (!(flags & KEY_ALLOC_NOT_IN_QUOTA))
@@ -16,7 +16,10 @@
 #include <linux/security.h>
 #include <linux/seq_file.h>
 #include <linux/err.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <keys/keyring-type.h>
+#include <keys/user-type.h>
 #include <linux/uaccess.h>
 #include "internal.h"
 
@@ -92,6 +95,130 @@ EXPORT_SYMBOL(key_type_keyring);
  */
 static DECLARE_RWSEM(keyring_serialise_link_sem);
 
+/*
+ * Note that the keyring's links changed, for those that cache what they
+ * found in it.  Called with the keyring's semaphore write-locked.
+ */
+static inline void keyring_changed(struct key *keyring)
+{
+	smp_wmb();
+	ACCESS_ONCE(keyring->changes) = keyring->changes + 1;
+}
+
+/*
+ * Keyrings with this many links or more get an index of their keys by type
+ * and description, which searches that match on the description exactly
+ * look the key up in rather than going through the whole list.  A keyring
+ * holds at most one link to a key of a given type+description.
+ *
+ * The index is built by the first such search after the links change, and
+ * is good for as long as keyring->changes has not moved on since.
+ */
+#define KEYRING_INDEX_MIN	16
+
+struct keyring_index {
+	struct rcu_head	rcu;
+	unsigned	changes;	/* keyring->changes it was built at */
+	unsigned	mask;		/* number of slots - 1 */
+	unsigned	slot[0];	/* 1 + a key's place in the list, or 0 */
+};
+
+static inline unsigned keyring_index_hash(const struct key_type *type,
+					  const char *description)
+{
+	return jhash(description, strlen(description),
+		     (u32)(unsigned long)type);
+}
+
+/*
+ * Index the keys of the list.  Called with the RCU read lock held.
+ */
+static struct keyring_index *keyring_index_build(struct keyring_list *klist,
+						 unsigned changes)
+{
+	struct keyring_index *index;
+	struct key *key;
+	unsigned size, hash;
+	int nkeys, loop;
+
+	nkeys = klist->nkeys;
+	smp_rmb();
+
+	size = roundup_pow_of_two(nkeys * 2);
+	index = kzalloc(sizeof(*index) + size * sizeof(index->slot[0]),
+			GFP_ATOMIC | __GFP_NOWARN);
+	if (!index)
+		return NULL;
+	index->changes = changes;
+	index->mask = size - 1;
+
+	for (loop = 0; loop < nkeys; loop++) {
+		key = rcu_dereference(klist->keys[loop]);
+		if (!key->description)
+			continue;
+		hash = keyring_index_hash(key->type, key->description);
+		while (index->slot[hash & index->mask])
+			hash++;
+		index->slot[hash & index->mask] = loop + 1;
+	}
+	return index;
+}
+
+/*
+ * Narrow the part [*_kix, *_nkeys) of a keyring's list that a search has to
+ * go through down to the key of the type and description, or to nothing if
+ * there is none, when the match is on the description and the keyring has
+ * an index.  Called with the RCU read lock held.
+ */
+static void keyring_index_narrow(struct key *keyring,
+				 struct keyring_list *klist,
+				 key_match_func_t match,
+				 const struct key_type *type,
+				 const char *description,
+				 int *_kix, int *_nkeys)
+{
+	struct keyring_index *index, *old;
+	struct key *key;
+	unsigned changes, hash, slot;
+
+	if (match != keyring_match && match != user_match)
+		return;
+	if (*_nkeys < KEYRING_INDEX_MIN)
+		return;
+
+	/* a change from here on leaves what is built stale */
+	changes = ACCESS_ONCE(keyring->changes);
+	smp_rmb();
+
+	index = rcu_dereference(klist->index);
+	if (!index || index->changes != changes) {
+		old = index;
+		index = keyring_index_build(klist, changes);
+		if (!index)
+			return;
+		if (cmpxchg(&klist->index, old, index) != old) {
+			/* someone else rebuilt it; search the list */
+			kfree(index);
+			return;
+		}
+		if (old)
+			kfree_rcu(old, rcu);
+	}
+
+	*_nkeys = 0;
+	hash = keyring_index_hash(type, description);
+	while ((slot = index->slot[hash & index->mask])) {
+		key = rcu_dereference(klist->keys[slot - 1]);
+		if (key->type == type && key->description &&
+		    strcmp(key->description, description) == 0) {
+			*_kix = slot - 1;
+			*_nkeys = slot;
+			return;
+		}
+		hash++;
+	}
+}
+
 /*
  * Publish the name of a keyring so that it can be found by name (if it has
  * one).
@@ -172,6 +299,7 @@ static void keyring_destroy(struct key *keyring)
 	if (klist) {
 		for (loop = klist->nkeys - 1; loop >= 0; loop--)
 			key_put(rcu_access_pointer(klist->keys[loop]));
+		kfree(klist->index);
 		kfree(klist);
 	}
 }
@@ -400,7 +528,10 @@ descend:
 	/* iterate through the keys in this keyring first */
 	nkeys = keylist->nkeys;
 	smp_rmb();
-	for (kix = 0; kix < nkeys; kix++) {
+	kix = 0;
+	keyring_index_narrow(keyring, keylist, match, type, description,
+			     &kix, &nkeys);
+	for (; kix < nkeys; kix++) {
 		key = rcu_dereference(keylist->keys[kix]);
 		kflags = key->flags;
 
@@ -555,7 +686,11 @@ key_ref_t __keyring_search_one(key_ref_t keyring_ref,
 	if (klist) {
 		nkeys = klist->nkeys;
 		smp_rmb();
-		for (loop = 0; loop < nkeys ; loop++) {
+		loop = 0;
+		if (ktype->match)
+			keyring_index_narrow(keyring, klist, ktype->match,
+					     ktype, description, &loop, &nkeys);
+		for (; loop < nkeys ; loop++) {
 			key = rcu_dereference(klist->keys[loop]);
 			if (key->type == ktype &&
 			    (!key->type->match ||
@@ -740,6 +875,7 @@ static void keyring_unlink_rcu_disposal(struct rcu_head *rcu)
 
 	if (klist->delkey != USHRT_MAX)
 		key_put(rcu_access_pointer(klist->keys[klist->delkey]));
+	kfree(klist->index);
 	kfree(klist);
 }
 
@@ -838,6 +974,7 @@ int __key_link_begin(struct key *keyring, const struct key_type *type,
 			goto error_quota;
 
 		nklist->maxkeys = max;
+		nklist->index = NULL;
 		if (klist) {
 			memcpy(nklist->keys, klist->keys,
 			       sizeof(struct key *) * klist->nkeys);
@@ -949,6 +1086,7 @@ void __key_link(struct key *keyring, struct key *key,
 		smp_wmb();
 		klist->nkeys++;
 	}
+	keyring_changed(keyring);
 }
 
 /*
@@ -1070,6 +1208,7 @@ key_is_present:
 		goto nomem;
 	nklist->maxkeys = klist->maxkeys;
 	nklist->nkeys = klist->nkeys - 1;
+	nklist->index = NULL;
 
 	if (loop > 0)
 		memcpy(&nklist->keys[0],
@@ -1086,6 +1225,7 @@ key_is_present:
 			    keyring->datalen - KEYQUOTA_LINK_BYTES);
 
 	rcu_assign_pointer(keyring->payload.subscriptions, nklist);
+	keyring_changed(keyring);
 
 	up_write(&keyring->sem);
 
@@ -1118,6 +1258,7 @@ static void keyring_clear_rcu_disposal(struct rcu_head *rcu)
 	for (loop = klist->nkeys - 1; loop >= 0; loop--)
 		key_put(rcu_access_pointer(klist->keys[loop]));
 
+	kfree(klist->index);
 	kfree(klist);
 }
 
@@ -1147,6 +1288,7 @@ int keyring_clear(struct key *keyring)
 
 			rcu_assign_pointer(keyring->payload.subscriptions,
 					   NULL);
+			keyring_changed(keyring);
 		}
 
 		up_write(&keyring->sem);
@@ -1178,6 +1320,7 @@ static void keyring_revoke(struct key *keyring)
 
 	if (klist) {
 		rcu_assign_pointer(keyring->payload.subscriptions, NULL);
+		keyring_changed(keyring);
 		call_rcu(&klist->rcu, keyring_clear_rcu_disposal);
 	}
 }
@@ -1223,6 +1366,7 @@ void keyring_gc(struct key *keyring, time_t limit)
 	new->maxkeys = max;
 	new->nkeys = 0;
 	new->delkey = 0;
+	new->index = NULL;
 
 	/* install the live keys
 	 * - must take care as expired keys may be updated back to life
@@ -1249,6 +1393,7 @@ void keyring_gc(struct key *keyring, time_t limit)
 	} else {
 		rcu_assign_pointer(keyring->payload.subscriptions, new);
 	}
+	keyring_changed(keyring);
 
 	up_write(&keyring->sem);
 
@@ -736,6 +736,18 @@ int security_mmap_file(struct file *file, unsigned long prot,
 	return ima_file_mmap(file, prot);
 }
 
+unsigned long security_mmap_populate(struct file *file, unsigned long prot,
+				     unsigned long flags, unsigned long len)
+{
+	return security_ops->mmap_populate(file, prot, flags, len);
+}
+
+int security_file_mmapped(struct file *file, unsigned long addr,
+			  unsigned long len)
+{
+	return security_ops->file_mmapped(file, addr, len);
+}
+
 int security_mmap_addr(unsigned long addr)
 {
 	return security_ops->mmap_addr(addr);
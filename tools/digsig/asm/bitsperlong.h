@@ -0,0 +1 @@
+#define BITS_PER_LONG (__SIZEOF_LONG__ * 8)
@@ -0,0 +1,670 @@
+/*
+ * digsig-cachesim: replay the verdict cache events of a DigSig trace
+ * against models of the cache, to size it and pick its eviction policy
+ * from what a host actually runs.
+ *
+ *   digsig-cachesim [-p policy,...] [-n entries,...] [-g buckets]
+ *                   [-c ns] [-1] [trace]
+ *
+ * The trace is the text of the digsig tracepoints, as trace_pipe, or
+ * trace-cmd report or perf script, print it, read from the file or the
+ * standard input; it needs the digsig_cache_hit, digsig_cache_miss,
+ * digsig_cache_insert and digsig_cache_remove events, and the
+ * digsig_verify_end events for what a verification costs:
+ *
+ *   echo 1 > /sys/kernel/debug/tracing/events/digsig/enable
+ *   cat /sys/kernel/debug/tracing/trace_pipe > digsig.trace
+ *
+ * Each lookup of the trace is replayed against each policy at each
+ * capacity, with and without the table of each CPU in front, which a
+ * remove drops whole as it does in the kernel.  A lookup the model
+ * misses costs a verification; the file is cached again when the trace
+ * inserts it, or at once if the trace found it cached.  The policies:
+ *
+ *   rr     round-robin over the 8 ways of a bucket, as the cache was
+ *   clock  CLOCK with a referenced and a hot bit, as the cache is
+ *   2q     2Q within each bucket: a FIFO of 2 newcomers, a ghost list
+ *          of the last 4 of them evicted, and the rest in LRU order
+ *   lru    LRU within each bucket
+ *
+ * With -g, the tables start at that many buckets and double each time
+ * they evicted an eighth of their capacity, up to it, as the kernel
+ * grows its own from dsi_cache_buckets.  What a verification costs is
+ * the time of the file's own verifications in the trace, or, for a file
+ * the trace never verified, that of -c, if not the mean of the trace.
+ *
+ * A file may live in either of two buckets, and goes to the one with
+ * fewer entries, as in the kernel; with -1, in the one of the top bits
+ * of its hash only, as the cache was.
+ *
+ * Files are hashed by device and inode number, not by superblock id, so
+ * their buckets are not those they have in the kernel, only spread as
+ * well.  The verdicts the inodes still hold in their blob are looked up
+ * as though the table had to answer.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef unsigned long long u64;
+
+#define WAYS 8
+#define L1_SIZE 32
+#define MAX_CPUS 4096
+#define TWOQ_IN (WAYS / 4)
+#define TWOQ_GHOSTS (WAYS / 2)
+#define GOLDEN_RATIO_PRIME_64 0x9e37fffffffc0001ULL
+#define GOLDEN_RATIO_PRIME_32 0x9e370001U
+
+enum { EV_HIT, EV_MISS, EV_INSERT, EV_REMOVE };
+enum { POL_RR, POL_CLOCK, POL_2Q, POL_LRU, POLICIES };
+
+static const char *policy_names[POLICIES] = {
+	[POL_RR] = "rr",
+	[POL_CLOCK] = "clock",
+	[POL_2Q] = "2q",
+	[POL_LRU] = "lru",
+};
+
+struct file {
+	unsigned int dev;
+	unsigned long long ino;
+	u64 hash;
+	u64 cost_ns, verified;
+};
+
+struct event {
+	unsigned char type;
+	unsigned short cpu;
+	int file;
+};
+
+static struct file *files;
+static int nfiles;
+static int *file_index;		/* open addressing, -1 for free */
+static unsigned int file_index_size;
+
+static struct event *events;
+static size_t nevents, events_size;
+static int ncpus = 1;
+static u64 mean_cost_ns;
+static int one_choice;
+
+/* a bucket: -1 is a free way */
+struct line {
+	int file[WAYS];
+	unsigned char ref[WAYS], hot[WAYS], frequent[WAYS];
+	u64 used[WAYS];		/* last hit or insert, for LRU */
+	u64 born[WAYS];		/* insert, for the 2Q FIFO */
+	int ghost[TWOQ_GHOSTS];
+	int hand, ghost_next;
+};
+
+struct model {
+	int policy, l1;
+	unsigned int bits, max_bits;
+	unsigned long evictions;	/* since the table last grew */
+	struct line *line;
+	int *l1_file;		/* ncpus * L1_SIZE, -1 for empty */
+	u64 clock;
+	unsigned long lookups, hits, l1_hits, inserts, evicted, grown;
+	double spent_ns, saved_ns;
+};
+
+static void *xcalloc(size_t n, size_t size)
+{
+	void *p = calloc(n ? n : 1, size);
+
+	if (!p) {
+		perror("calloc");
+		exit(1);
+	}
+	return p;
+}
+
+static u64 file_hash(unsigned int dev, unsigned long long ino)
+{
+	return ((u64)dev ^ ino) * GOLDEN_RATIO_PRIME_64;
+}
+
+static void file_index_grow(void)
+{
+	unsigned int size = file_index_size ? file_index_size * 2 : 1024;
+	unsigned int i, j;
+	int *index = malloc(size * sizeof(*index));
+
+	if (!index) {
+		perror("malloc");
+		exit(1);
+	}
+	memset(index, 0xff, size * sizeof(*index));
+	for (i = 0; i < (unsigned int)nfiles; i++) {
+		j = files[i].hash >> 40;
+		while (index[j & (size - 1)] >= 0)
+			j++;
+		index[j & (size - 1)] = i;
+	}
+	free(file_index);
+	file_index = index;
+	file_index_size = size;
+	files = realloc(files, size / 2 * sizeof(*files));
+	if (!files) {
+		perror("realloc");
+		exit(1);
+	}
+}
+
+static int file_get(unsigned int dev, unsigned long long ino)
+{
+	u64 h = file_hash(dev, ino);
+	unsigned int j;
+	int i;
+
+	if ((unsigned int)nfiles * 2 >= file_index_size)
+		file_index_grow();
+	for (j = h >> 40;; j++) {
+		i = file_index[j & (file_index_size - 1)];
+		if (i < 0)
+			break;
+		if (files[i].dev == dev && files[i].ino == ino)
+			return i;
+	}
+	i = nfiles++;
+	memset(&files[i], 0, sizeof(files[i]));
+	files[i].dev = dev;
+	files[i].ino = ino;
+	files[i].hash = h;
+	file_index[j & (file_index_size - 1)] = i;
+	return i;
+}
+
+static void event_add(int type, int cpu, int file)
+{
+	if (nevents == events_size) {
+		events_size = events_size ? events_size * 2 : 65536;
+		events = realloc(events, events_size * sizeof(*events));
+		if (!events) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	events[nevents].type = type;
+	events[nevents].cpu = cpu;
+	events[nevents].file = file;
+	nevents++;
+}
+
+/* the CPU of a trace line: the first [n] on it */
+static int line_cpu(const char *s)
+{
+	const char *p;
+	char *end;
+	long cpu;
+
+	for (p = strchr(s, '['); p; p = strchr(p + 1, '[')) {
+		cpu = strtol(p + 1, &end, 10);
+		if (end > p + 1 && *end == ']' && cpu >= 0 && cpu < MAX_CPUS)
+			return cpu;
+	}
+	return 0;
+}
+
+static void parse_line(const char *s)
+{
+	static const struct {
+		const char *name;
+		int type;
+	} names[] = {
+		{ "digsig_cache_hit: ", EV_HIT },
+		{ "digsig_cache_miss: ", EV_MISS },
+		{ "digsig_cache_insert: ", EV_INSERT },
+		{ "digsig_cache_remove: ", EV_REMOVE },
+		{ "digsig_verify_end: ", -1 },
+	};
+	unsigned int major, minor, i;
+	unsigned long long ino, ns;
+	const char *p = NULL;
+	int type = 0, cpu, f;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		p = strstr(s, names[i].name);
+		if (p) {
+			type = names[i].type;
+			p += strlen(names[i].name);
+			break;
+		}
+	}
+	if (!p || sscanf(p, "dev %u:%u ino %llx", &major, &minor, &ino) != 3)
+		return;
+
+	f = file_get(major << 20 | minor, ino);
+	if (type < 0) {
+		p = strstr(p, " ns ");
+		if (p && sscanf(p, " ns %llu", &ns) == 1) {
+			files[f].cost_ns += ns;
+			files[f].verified++;
+		}
+		return;
+	}
+	cpu = line_cpu(s);
+	if (cpu >= ncpus)
+		ncpus = cpu + 1;
+	event_add(type, cpu, f);
+}
+
+/* what verifying the file costs: its mean in the trace, or everyone's */
+static double file_cost(int f)
+{
+	if (files[f].verified)
+		return (double)files[f].cost_ns / files[f].verified;
+	return mean_cost_ns;
+}
+
+static void model_alloc(struct model *m, unsigned int bits)
+{
+	size_t i, n = (size_t)1 << bits;
+
+	m->bits = bits;
+	m->line = xcalloc(n, sizeof(*m->line));
+	for (i = 0; i < n; i++) {
+		memset(m->line[i].file, 0xff, sizeof(m->line[i].file));
+		memset(m->line[i].ghost, 0xff, sizeof(m->line[i].ghost));
+	}
+}
+
+static struct line *model_line(struct model *m, int f)
+{
+	return &m->line[m->bits ? files[f].hash >> (64 - m->bits) : 0];
+}
+
+/* the other bucket of a file, as hash_line2() picks it */
+static struct line *model_line2(struct model *m, int f)
+{
+	unsigned int h = (unsigned int)files[f].hash * GOLDEN_RATIO_PRIME_32;
+
+	if (one_choice)
+		return model_line(m, f);
+	return &m->line[m->bits ? h >> (32 - m->bits) : 0];
+}
+
+static int line_find(struct line *l, int f)
+{
+	int i;
+
+	for (i = 0; i < WAYS; i++)
+		if (l->file[i] == f)
+			return i;
+	return -1;
+}
+
+/* the way of a file in either of its buckets, -1 if it is in neither */
+static int model_find(struct model *m, int f, struct line **l)
+{
+	int i;
+
+	*l = model_line(m, f);
+	i = line_find(*l, f);
+	if (i < 0) {
+		*l = model_line2(m, f);
+		i = line_find(*l, f);
+	}
+	return i;
+}
+
+static int line_used(struct line *l, int *referenced)
+{
+	int i, n = 0;
+
+	*referenced = 0;
+	for (i = 0; i < WAYS; i++) {
+		n += l->file[i] >= 0;
+		*referenced += l->ref[i] + l->hot[i];
+	}
+	return n;
+}
+
+/* the bucket of the two a file not cached goes to, as pair_choose() */
+static struct line *model_choose(struct model *m, int f)
+{
+	struct line *l1 = model_line(m, f), *l2 = model_line2(m, f);
+	int n1, n2, r1, r2;
+
+	if (l1 == l2)
+		return l1;
+	n1 = line_used(l1, &r1);
+	n2 = line_used(l2, &r2);
+	if (n1 != n2)
+		return n1 < n2 ? l1 : l2;
+	return n1 == WAYS && r2 < r1 ? l2 : l1;
+}
+
+static void line_hit(struct model *m, struct line *l, int i)
+{
+	if (!l->ref[i])
+		l->ref[i] = 1;
+	else
+		l->hot[i] = 1;
+	l->used[i] = ++m->clock;
+}
+
+static int next_hand(struct line *l)
+{
+	int i = l->hand;
+
+	l->hand = (l->hand + 1) % WAYS;
+	return i;
+}
+
+/* the way a full line gives up, as clock_evict() picks it for clock */
+static int line_victim(struct model *m, struct line *l)
+{
+	int i, newcomers = 0, fifo, victim = -1;
+
+	switch (m->policy) {
+	case POL_RR:
+		return next_hand(l);
+	case POL_CLOCK:
+		for (;;) {
+			i = next_hand(l);
+			if (l->hot[i]) {
+				l->hot[i] = 0;
+				continue;
+			}
+			if (l->ref[i]) {
+				l->ref[i] = 0;
+				continue;
+			}
+			return i;
+		}
+	case POL_2Q:
+		/* the oldest newcomer past their share, else the LRU one */
+		for (i = 0; i < WAYS; i++)
+			newcomers += !l->frequent[i];
+		fifo = newcomers >= TWOQ_IN;
+		for (i = 0; i < WAYS; i++) {
+			if (fifo == l->frequent[i])
+				continue;
+			if (victim < 0 ||
+			    (fifo ? l->born[i] < l->born[victim] :
+			     l->used[i] < l->used[victim]))
+				victim = i;
+		}
+		if (!l->frequent[victim]) {
+			l->ghost[l->ghost_next] = l->file[victim];
+			l->ghost_next = (l->ghost_next + 1) % TWOQ_GHOSTS;
+		}
+		return victim;
+	default:
+		for (i = 0; i < WAYS; i++)
+			if (victim < 0 || l->used[i] < l->used[victim])
+				victim = i;
+		return victim;
+	}
+}
+
+/* store a file not in the line; 1 if it evicted one */
+static int line_store(struct model *m, struct line *l, int f)
+{
+	int i, j, evicted = 0;
+
+	for (i = 0; i < WAYS && l->file[i] >= 0; i++)
+		;
+	if (i == WAYS) {
+		i = line_victim(m, l);
+		evicted = 1;
+	} else if (i == l->hand) {
+		next_hand(l);
+	}
+
+	l->file[i] = f;
+	l->ref[i] = l->hot[i] = l->frequent[i] = 0;
+	l->used[i] = l->born[i] = ++m->clock;
+	/* a newcomer evicted not long ago comes back as a frequent one */
+	for (j = 0; m->policy == POL_2Q && j < TWOQ_GHOSTS; j++)
+		if (l->ghost[j] == f) {
+			l->ghost[j] = -1;
+			l->frequent[i] = 1;
+		}
+	return evicted;
+}
+
+/* double the table, its entries inserted again one after the other */
+static void model_grow(struct model *m)
+{
+	struct line *old = m->line;
+	size_t i, n = (size_t)1 << m->bits;
+	int j;
+
+	model_alloc(m, m->bits + 1);
+	for (i = 0; i < n; i++)
+		for (j = 0; j < WAYS; j++)
+			if (old[i].file[j] >= 0)
+				line_store(m, model_choose(m, old[i].file[j]),
+					   old[i].file[j]);
+	free(old);
+	m->evictions = 0;
+	m->grown++;
+}
+
+static void model_insert(struct model *m, int cpu, int f)
+{
+	struct line *l;
+	int i = model_find(m, f, &l);
+
+	m->inserts++;
+	if (m->l1)
+		m->l1_file[cpu * L1_SIZE + (files[f].hash & (L1_SIZE - 1))] = f;
+	if (i >= 0 || !line_store(m, model_choose(m, f), f))
+		return;
+	m->evicted++;
+	if (m->bits < m->max_bits &&
+	    ++m->evictions == ((unsigned long)WAYS << m->bits) / 8)
+		model_grow(m);
+}
+
+static void model_lookup(struct model *m, struct event *e)
+{
+	int *slot = &m->l1_file[e->cpu * L1_SIZE +
+				(files[e->file].hash & (L1_SIZE - 1))];
+	struct line *l;
+	int i, hit = 0;
+
+	m->lookups++;
+	if (m->l1 && *slot == e->file) {
+		m->l1_hits++;
+		hit = 1;
+	} else {
+		i = model_find(m, e->file, &l);
+		if (i >= 0) {
+			line_hit(m, l, i);
+			if (m->l1)
+				*slot = e->file;
+			hit = 1;
+		}
+	}
+
+	if (hit) {
+		m->hits++;
+		m->saved_ns += file_cost(e->file);
+		return;
+	}
+	m->spent_ns += file_cost(e->file);
+	/* the trace found it: it is cached again once verified */
+	if (e->type == EV_HIT)
+		model_insert(m, e->cpu, e->file);
+}
+
+static void model_remove(struct model *m, int f)
+{
+	struct line *l;
+	int i = model_find(m, f, &l);
+
+	if (i >= 0) {
+		l->file[i] = -1;
+		l->ref[i] = l->hot[i] = 0;
+	}
+	/* every remove drops the tables of all CPUs */
+	if (m->l1)
+		memset(m->l1_file, 0xff, ncpus * L1_SIZE * sizeof(int));
+}
+
+static void simulate(int policy, unsigned long entries, int l1,
+		     unsigned long start_buckets)
+{
+	struct model m;
+	unsigned int bits = 0;
+	size_t i;
+
+	while (((unsigned long)WAYS << bits) < entries)
+		bits++;
+	memset(&m, 0, sizeof(m));
+	m.policy = policy;
+	m.l1 = l1;
+	m.max_bits = bits;
+	if (start_buckets) {
+		for (bits = 0; (1UL << bits) < start_buckets &&
+		     bits < m.max_bits; bits++)
+			;
+	}
+	model_alloc(&m, bits);
+	m.l1_file = xcalloc((size_t)ncpus * L1_SIZE, sizeof(int));
+	memset(m.l1_file, 0xff, (size_t)ncpus * L1_SIZE * sizeof(int));
+
+	for (i = 0; i < nevents; i++) {
+		switch (events[i].type) {
+		case EV_HIT:
+		case EV_MISS:
+			model_lookup(&m, &events[i]);
+			break;
+		case EV_INSERT:
+			model_insert(&m, events[i].cpu, events[i].file);
+			break;
+		case EV_REMOVE:
+			model_remove(&m, events[i].file);
+			break;
+		}
+	}
+
+	printf("%-6s %9lu %3s %10lu %7.2f %7.2f %9lu %6lu %12.1f %12.1f\n",
+	       policy_names[policy], (unsigned long)WAYS << m.max_bits,
+	       l1 ? "yes" : "no", m.lookups,
+	       m.lookups ? 100.0 * m.hits / m.lookups : 0.0,
+	       m.lookups ? 100.0 * m.l1_hits / m.lookups : 0.0,
+	       m.evicted, m.grown, m.spent_ns / 1e6, m.saved_ns / 1e6);
+	free(m.line);
+	free(m.l1_file);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: digsig-cachesim [-p policy,...] [-n entries,...] [-g buckets]\n"
+		"                       [-c ns] [-1] [trace]\n"
+		"policies: rr, clock, 2q, lru\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned long default_entries[] = {
+		1024, 4096, 16384, 32768, 65536,
+	};
+	unsigned long entries[32], start_buckets = 0, default_cost = 0;
+	unsigned long lookups = 0, hits = 0, verified = 0;
+	int policies[POLICIES], npolicies = 0, nentries = 0;
+	int opt, i, j, l1;
+	char line[4096], *tok;
+	u64 cost = 0;
+	FILE *in = stdin;
+	size_t k;
+
+	while ((opt = getopt(argc, argv, "p:n:g:c:1")) != -1) {
+		switch (opt) {
+		case 'p':
+			for (tok = strtok(optarg, ","); tok;
+			     tok = strtok(NULL, ",")) {
+				for (i = 0; i < POLICIES; i++)
+					if (!strcmp(tok, policy_names[i]))
+						break;
+				if (i == POLICIES || npolicies == POLICIES)
+					usage();
+				policies[npolicies++] = i;
+			}
+			break;
+		case 'n':
+			for (tok = strtok(optarg, ","); tok;
+			     tok = strtok(NULL, ",")) {
+				if (nentries == 32 || !strtoul(tok, NULL, 0))
+					usage();
+				entries[nentries++] = strtoul(tok, NULL, 0);
+			}
+			break;
+		case 'g':
+			start_buckets = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			default_cost = strtoul(optarg, NULL, 0);
+			break;
+		case '1':
+			one_choice = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind > 1)
+		usage();
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (!in) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	if (!npolicies)
+		for (; npolicies < POLICIES; npolicies++)
+			policies[npolicies] = npolicies;
+	if (!nentries)
+		for (; nentries < (int)(sizeof(default_entries) /
+					sizeof(default_entries[0])); nentries++)
+			entries[nentries] = default_entries[nentries];
+
+	file_index_grow();
+	while (fgets(line, sizeof(line), in))
+		parse_line(line);
+	if (in != stdin)
+		fclose(in);
+
+	for (i = 0; i < nfiles; i++) {
+		cost += files[i].cost_ns;
+		verified += files[i].verified;
+	}
+	mean_cost_ns = default_cost ? default_cost :
+		       verified ? cost / verified : 1000000;
+	for (k = 0; k < nevents; k++) {
+		if (events[k].type > EV_MISS)
+			continue;
+		lookups++;
+		hits += events[k].type == EV_HIT;
+	}
+	printf("# %lu lookups of %d files on %d CPUs, %.2f%% hits in the trace, "
+	       "%lu verifications, %.1f us each by default\n",
+	       lookups, nfiles, ncpus, lookups ? 100.0 * hits / lookups : 0.0,
+	       verified, mean_cost_ns / 1e3);
+	printf("# policy   entries  l1    lookups   hit%%    l1%%   evicted  grown "
+	       " verify (ms)   saved (ms)\n");
+	for (i = 0; i < npolicies; i++)
+		for (j = 0; j < nentries; j++)
+			for (l1 = 0; l1 < 2; l1++)
+				simulate(policies[i], entries[j], l1,
+					 start_buckets);
+	return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * digsig-check: find and decode the DigSig signatures of ELF files with
+ * the kernel's own parsers, and time the RSA operation of the kernel's
+ * MPI code on them.
+ *
+ *   digsig-check [-k key] [-n count] file...
+ *
+ * For each file, prints where its signature is, the hash and signature
+ * algorithms, and for RSA signatures the key ID and the signing time.
+ * With -k, the RSA signatures are raised to the key, n then e as two
+ * OpenPGP MPIs back to back, as the 'K' write of /sys/digsig/key takes
+ * them; the digest the signature is of is printed, and with -n the
+ * operation is repeated count times and timed.
+ *
+ * The file digest is not computed: the point is the parsers and the
+ * MPI code, which perf and valgrind then see as the kernel runs them.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <linux/kernel.h>
+
+#include "digsig_format.h"
+#include "gnupg/mpi/mpi.h"
+#include "gnupg/cipher/rsa-verify.h"
+
+/*
+ * room for the program headers, and the window the section table is read
+ * through, as in the verification context
+ */
+#define PHDR_ROOM (64 * sizeof(Elf64_Shdr))
+
+struct image {
+	const unsigned char *data;
+	size_t size;
+};
+
+static int image_read(void *src, loff_t pos, char *buf, unsigned long len)
+{
+	struct image *im = src;
+
+	if (pos < 0 || (size_t)pos >= im->size)
+		return 0;
+	if (len > im->size - pos)
+		len = im->size - pos;
+	memcpy(buf, im->data + pos, len);
+	return len;
+}
+
+static const char *hash_names[DIGSIG_HASH_ALGOS] = {
+	[HASH_SHA1] = "sha1",
+	[HASH_SHA256] = "sha256",
+	[HASH_SHA512] = "sha512",
+	[HASH_BLAKE2B] = "blake2b-512",
+};
+
+static MPI key[2];
+static MPI_MONT_CTX key_mont;
+static long repeat;
+
+static int read_key(const char *path)
+{
+	unsigned char buf[4096];
+	unsigned n, used;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf));
+	close(fd);
+	if (len <= 0)
+		return -1;
+
+	n = len;
+	key[0] = mpi_read_from_buffer(buf, &n, 0);
+	if (!key[0] || n >= len)
+		return -1;
+	used = n;
+	n = len - used;
+	key[1] = mpi_read_from_buffer(buf + used, &n, 0);
+	if (!key[1])
+		return -1;
+	key_mont = mpi_mont_alloc(key[0]);
+	return 0;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* print the digest an RSA signature is of, the end of its frame */
+static int rsa_check(struct digsig_sig_info *info)
+{
+	unsigned char frame[1024];
+	unsigned nbytes = (mpi_get_nbits(key[0]) + 7) / 8, n;
+	unsigned long long t;
+	mpi_limb_t *ws = NULL;
+	MPI sig, res;
+	long i;
+
+	if (info->packet_len <= DIGSIG_RSA_DATA_OFFSET || nbytes > sizeof(frame))
+		return -1;
+	n = info->packet_len - DIGSIG_RSA_DATA_OFFSET;
+	sig = mpi_read_from_buffer(info->packet + DIGSIG_RSA_DATA_OFFSET, &n, 0);
+	res = mpi_alloc(mpi_get_nlimbs(key[0]));
+	if (key_mont)
+		ws = malloc(MPI_MONT_WS_LIMBS(key_mont) * sizeof(*ws));
+	if (!sig || !res)
+		return -1;
+
+	t = now_ns();
+	for (i = 0; i < (repeat ? repeat : 1); i++)
+		rsa_public_mont(res, sig, key, key_mont, ws);
+	t = now_ns() - t;
+
+	if (mpi_get_buffer_fixed(res, frame, nbytes))
+		return -1;
+	printf("\tdigest ");
+	for (n = nbytes - gDigestLength[info->hashalgo]; n < nbytes; n++)
+		printf("%02x", frame[n]);
+	printf("\n");
+	if (repeat)
+		printf("\t%ld RSA operations, %llu ns each\n", repeat,
+		       t / repeat);
+
+	free(ws);
+	mpi_free(res);
+	mpi_free(sig);
+	return 0;
+}
+
+static int check(const char *path, struct image *im)
+{
+	struct elf64_hdr ehdr;
+	struct digsig_notes notes;
+	struct digsig_sig_info info;
+	static char phdr[PHDR_ROOM];
+	unsigned long offset, size;
+	const char *where;
+	char sig[DIGSIG_ELF_SIG_SIZE];
+	int arch32, segments, i;
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	if (image_read(im, 0, (char *)&ehdr, sizeof(ehdr)) <
+	    (int)sizeof(struct elf32_hdr) || digsig_elf_sanity_check(&ehdr)) {
+		printf("%s: not a valid ELF file\n", path);
+		return 1;
+	}
+	arch32 = ehdr.e_ident[EI_CLASS] == ELFCLASS32;
+
+	if (digsig_find_notes(image_read, im, &ehdr, arch32, phdr,
+			      sizeof(phdr), &notes)) {
+		where = "note";
+	} else if (digsig_scan_sections(image_read, im, &ehdr, arch32, phdr,
+					sizeof(phdr), &notes) > 0) {
+		where = "section";
+	} else {
+		printf("%s: not signed\n", path);
+		return 1;
+	}
+	offset = notes.sig_offset;
+	size = notes.sig_size;
+	segments = notes.segments;
+
+	if (image_read(im, offset, sig, size) != (int)size ||
+	    digsig_parse_signature(sig, size, &info)) {
+		printf("%s: bad signature\n", path);
+		return 1;
+	}
+
+	printf("%s: %s at %lu, %lu bytes%s\n", path, where, offset, size,
+	       segments ? ", of the segments" : "");
+	printf("\t%s %s", hash_names[info.hashalgo],
+	       info.signalgo == SIGN_RSA ? "rsa" : "ed25519");
+	if (info.signalgo == SIGN_RSA) {
+		printf(" key ");
+		for (i = 0; i < DIGSIG_KEYID_SIZE; i++)
+			printf("%02x", info.packet[DIGSIG_RSA_KEYID_OFFSET + i]);
+		printf(" time %u\n",
+		       (unsigned)info.packet[DIGSIG_RSA_TIMESTAMP_OFFSET] << 24 |
+		       info.packet[DIGSIG_RSA_TIMESTAMP_OFFSET + 1] << 16 |
+		       info.packet[DIGSIG_RSA_TIMESTAMP_OFFSET + 2] << 8 |
+		       info.packet[DIGSIG_RSA_TIMESTAMP_OFFSET + 3]);
+		if (key[0] && rsa_check(&info)) {
+			printf("%s: bad RSA signature\n", path);
+			return 1;
+		}
+	} else {
+		printf(" key ");
+		for (i = 0; i < ED25519_KEYID_SIZE; i++)
+			printf("%02x", info.packet[i]);
+		printf("\n");
+	}
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: digsig-check [-k key] [-n count] file...\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct image im;
+	struct stat st;
+	int opt, fd, rc = 0;
+
+	mpi_init_pool();
+	while ((opt = getopt(argc, argv, "k:n:")) != -1) {
+		switch (opt) {
+		case 'k':
+			if (read_key(optarg)) {
+				fprintf(stderr, "%s: bad key\n", optarg);
+				return 2;
+			}
+			break;
+		case 'n':
+			repeat = atol(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc)
+		usage();
+
+	for (; optind < argc; optind++) {
+		fd = open(argv[optind], O_RDONLY);
+		if (fd < 0 || fstat(fd, &st)) {
+			perror(argv[optind]);
+			rc = 1;
+			continue;
+		}
+		im.size = st.st_size;
+		im.data = mmap(NULL, im.size ? im.size : 1, PROT_READ,
+			       MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (im.data == MAP_FAILED) {
+			perror(argv[optind]);
+			rc = 1;
+			continue;
+		}
+		rc |= check(argv[optind], &im);
+		munmap((void *)im.data, im.size ? im.size : 1);
+	}
+	return rc;
+}
@@ -0,0 +1,77 @@
+/*
+ * digsig-fuzz: a libFuzzer target for DigSig's parsers.  The input is
+ * taken as a whole file: its ELF header is checked, its signature found
+ * from the notes or the section table, read a window at a time, and
+ * parsed, and the MPI of an RSA signature decoded, as the kernel does
+ * before verifying it.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#include <linux/kernel.h>
+
+#include "digsig_format.h"
+#include "gnupg/mpi/mpi.h"
+
+#define PHDR_ROOM (64 * sizeof(Elf64_Shdr))
+
+struct image {
+	const unsigned char *data;
+	size_t size;
+};
+
+static int image_read(void *src, loff_t pos, char *buf, unsigned long len)
+{
+	struct image *im = src;
+
+	if (pos < 0 || (size_t)pos >= im->size)
+		return 0;
+	if (len > im->size - pos)
+		len = im->size - pos;
+	memcpy(buf, im->data + pos, len);
+	return len;
+}
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+	struct image im = { data, size };
+	struct elf64_hdr ehdr;
+	struct digsig_notes notes;
+	struct digsig_sig_info info;
+	static char phdr[PHDR_ROOM];
+	char sig[DIGSIG_ELF_SIG_SIZE];
+	unsigned n;
+	int arch32;
+	MPI m;
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	if (image_read(&im, 0, (char *)&ehdr, sizeof(ehdr)) <
+	    (int)sizeof(struct elf32_hdr) || digsig_elf_sanity_check(&ehdr))
+		return 0;
+	arch32 = ehdr.e_ident[EI_CLASS] == ELFCLASS32;
+
+	if (!digsig_find_notes(image_read, &im, &ehdr, arch32, phdr,
+			       sizeof(phdr), &notes) &&
+	    digsig_scan_sections(image_read, &im, &ehdr, arch32, phdr,
+				 sizeof(phdr), &notes) <= 0)
+		return 0;
+
+	if (image_read(&im, notes.sig_offset, sig, notes.sig_size) !=
+	    (int)notes.sig_size ||
+	    digsig_parse_signature(sig, notes.sig_size, &info))
+		return 0;
+
+	if (info.signalgo == SIGN_RSA &&
+	    info.packet_len > DIGSIG_RSA_DATA_OFFSET) {
+		n = info.packet_len - DIGSIG_RSA_DATA_OFFSET;
+		m = mpi_read_from_buffer(info.packet + DIGSIG_RSA_DATA_OFFSET,
+					 &n, 0);
+		if (m)
+			mpi_free(m);
+	}
+	return 0;
+}
@@ -0,0 +1,1373 @@
+/*
+ * digsig-sign: sign ELF files for DigSig, on all CPUs, in the formats
+ * the kernel verifies, list files in a signed manifest, or revoke their
+ * signatures in a signed revocation database or their verdicts in a
+ * signed verdict bundle.
+ *
+ *   digsig-sign -k key.pem [-i keyid] [-a hash] [-c shift | -s]
+ *               [-t time] [-j jobs] [-P pubkey] file...
+ *   digsig-sign -k key.pem -m manifest [-i keyid] [-a hash] [-t time]
+ *               [-j jobs] file...
+ *   digsig-sign -k key.pem -r db [-i keyid] [-a hash] [-t time]
+ *               [-j jobs] file...
+ *   digsig-sign -k key.pem -b bundle -V alg:root [-i keyid] [-a hash]
+ *               [-t time] file...
+ *
+ * The key is a PEM private key, RSA or Ed25519, and -i the 16 hex digit
+ * key ID its signatures carry.  RSA signatures are in the bsign format
+ * of the hash given with -a: sha1, sha256 (the default), sha512 or
+ * blake2b; Ed25519 ones are of SHA-256 hashes.  The signing time is
+ * that of -t, of SOURCE_DATE_EPOCH, or the current one, so that a
+ * release build signs the same files the same way twice.
+ *
+ * Each file gets a signature section, and with -c a chunk hash section
+ * of 2^shift byte chunks, or with -s a segment signature section
+ * instead, signing only what its program headers say is loaded.  The
+ * sections are added at the end of the file, with a new section header
+ * table after them; those of an earlier signature are reused when they
+ * are of the same size, and left behind as SHT_NULL otherwise.  The
+ * file is then replaced by its signed copy, which breaks hard links.
+ *
+ * With -m, the files are left as they are, and the manifest lists
+ * their digests, of the file with its signature section zeroed if it
+ * has one, signed as a whole.
+ *
+ * With -r, the files are signed ELF files whose RSA signatures are
+ * revoked: the database lists the digests of the signatures, with the
+ * Bloom filter the kernel tests them against first, signed as a whole.
+ * It is loaded with the key, from /lib/digsig/revoked.db by default.
+ *
+ * With -b, the files are those of a read-only image, mounted through
+ * the dm-verity table whose hash algorithm and hex root -V gives, as
+ * veritysetup prints them, and found valid: the bundle lists their
+ * inode numbers with the root, signed as a whole, for
+ * /sys/kernel/security/digsig/bundle.  The files are left as they are.
+ *
+ * With -P, the public key is written as digsig-check -k takes it: n and
+ * e as two OpenPGP MPIs for RSA, the key ID and the 32 byte key for
+ * Ed25519, the parts /sys/digsig/key takes.
+ *
+ * The files are signed by -j threads, one per CPU by default, each
+ * with its own OpenSSL contexts.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/err.h>
+
+#include <linux/kernel.h>
+
+#include "digsig_format.h"
+
+/* room for the program headers, as in the verification context */
+#define PHDR_ROOM (64 * sizeof(Elf64_Shdr))
+
+/* the DigSig sections a file may have, retired when not reused */
+#define IS_DIGSIG_SECTION(type) ((type) == DIGSIG_ELF_SIG_SECTION ||	\
+				 (type) == DIGSIG_ELF_SEGSIG_SECTION ||	\
+				 (type) == DIGSIG_ELF_CHUNK_SECTION)
+
+/* the bsign packet: GPG v3 signature packet header, then the MPI */
+#define PGP_PACKET_HDR 3	/* old format tag 2, two byte length */
+#define PGP_SIG_CLASS 0x00	/* signature of a binary document */
+#define PGP_PUBKEY_RSA 1
+
+/* DER encoded DigestInfo prefixes, as in digsig_verify.c */
+static const u8 asn_sha1[] =
+	{ 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03,
+	  0x02, 0x1a, 0x05, 0x00, 0x04, 0x14 };
+static const u8 asn_sha256[] =
+	{ 0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+	  0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+static const u8 asn_sha512[] =
+	{ 0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+	  0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40 };
+static const u8 asn_blake2b[] =
+	{ 0x30, 0x53, 0x30, 0x0f, 0x06, 0x0b, 0x2b, 0x06, 0x01, 0x04, 0x01,
+	  0x8d, 0x3a, 0x0c, 0x02, 0x01, 0x10, 0x05, 0x00, 0x04, 0x40 };
+
+static const struct {
+	const char *name;
+	const EVP_MD *(*md)(void);
+	const u8 *asn;
+	size_t asn_len;
+} hash_algos[DIGSIG_HASH_ALGOS] = {
+	[HASH_SHA1] = { "sha1", EVP_sha1, asn_sha1, sizeof(asn_sha1) },
+	[HASH_SHA256] = { "sha256", EVP_sha256, asn_sha256,
+			  sizeof(asn_sha256) },
+	[HASH_SHA512] = { "sha512", EVP_sha512, asn_sha512,
+			  sizeof(asn_sha512) },
+	[HASH_BLAKE2B] = { "blake2b", EVP_blake2b512, asn_blake2b,
+			   sizeof(asn_blake2b) },
+};
+
+static EVP_PKEY *pkey;
+static int sign_algo;
+static int hash_algo = HASH_SHA256;
+static u8 keyid[DIGSIG_KEYID_SIZE];
+static u32 sign_time;
+static unsigned int chunk_shift;
+static int segments;
+static const char *manifest;
+static const char *revoke_db;
+static const char *bundle;
+static char bundle_alg[DIGSIG_BUNDLE_ALG_SIZE];
+static u8 bundle_root[DIGSIG_BUNDLE_MAX_DIGEST];
+static unsigned int bundle_root_size;
+
+static char **files;
+static int nfiles;
+static int next_file;
+static int failed;
+
+/*
+ * the manifest or revocation digests, one per file, and which were
+ * computed
+ */
+static u8 (*digests)[DIGSIG_MANIFEST_DIGEST_SIZE];
+static char *listed;
+
+/* a file being signed, as it will be written */
+struct image {
+	const char *path;
+	u8 *data;
+	size_t size;		/* of the file read */
+	size_t out_size;	/* of the file signed */
+	int arch32;
+	Elf64_Shdr *shdr;	/* the section headers, always ELF64 */
+	unsigned int shnum;
+	unsigned long sig_off, sig_size;
+	unsigned long ch_off, ch_size;
+	int append;		/* the sections and table are new */
+	unsigned long shoff;	/* where the table is written */
+};
+
+static void file_error(const char *path, const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", path, msg);
+	__sync_fetch_and_or(&failed, 1);
+}
+
+static int image_read(void *src, loff_t pos, char *buf, unsigned long len)
+{
+	struct image *im = src;
+
+	if (pos < 0 || (size_t)pos >= im->size)
+		return 0;
+	if (len > im->size - pos)
+		len = im->size - pos;
+	memcpy(buf, im->data + pos, len);
+	return len;
+}
+
+static int digest(int algo, const void *data, size_t len, u8 *md)
+{
+	unsigned int n;
+
+	return EVP_Digest(data, len, md, &n, hash_algos[algo].md(),
+			  NULL) ? 0 : -1;
+}
+
+/*
+ * The signature section of a digest, as the kernel checks it: for
+ * RSA, the bsign greeting, the digest, the packet length and the
+ * packet, whose MPI signs the greeting, the digest, the class and the
+ * time; for Ed25519, the greeting, the key ID and the signature of the
+ * greeting and the digest.
+ */
+static int sign_section(const u8 *md, u8 *sig, unsigned long sig_size)
+{
+	const char *greet = sign_algo == SIGN_ED25519 ?
+		DIGSIG_BSIGN_ED25519_STRING : digsig_bsign_greeting(hash_algo);
+	int mdlen = gDigestLength[hash_algo];
+	u8 msg[DIGSIG_BSIGN_GREET_SIZE + DIGSIG_MAX_DIGEST_LENGTH + 5];
+	u8 frame[DIGSIG_MAX_DIGEST_LENGTH + 32];
+	u8 m[DIGSIG_MAX_DIGEST_LENGTH], *pkt, *mpi;
+	EVP_PKEY_CTX *pctx;
+	EVP_MD_CTX *mctx;
+	size_t len, asn_len = hash_algos[hash_algo].asn_len;
+	unsigned int bits;
+	int rc = -1;
+
+	memset(sig, 0, sig_size);
+	memcpy(msg, greet, DIGSIG_BSIGN_GREET_SIZE);
+	memcpy(msg + DIGSIG_BSIGN_GREET_SIZE, md, mdlen);
+
+	if (sign_algo == SIGN_ED25519) {
+		memcpy(sig, greet, DIGSIG_BSIGN_GREET_SIZE);
+		memcpy(sig + DIGSIG_BSIGN_GREET_SIZE, keyid, ED25519_KEYID_SIZE);
+		len = ED25519_SIG_SIZE;
+		mctx = EVP_MD_CTX_new();
+		if (mctx && EVP_DigestSignInit(mctx, NULL, NULL, NULL, pkey) &&
+		    EVP_DigestSign(mctx, sig + DIGSIG_BSIGN_GREET_SIZE +
+				   ED25519_KEYID_SIZE, &len, msg,
+				   DIGSIG_BSIGN_GREET_SIZE + mdlen) &&
+		    len == ED25519_SIG_SIZE)
+			rc = 0;
+		EVP_MD_CTX_free(mctx);
+		return rc;
+	}
+
+	pkt = sig + DIGSIG_BSIGN_GREET_SIZE + mdlen + DIGSIG_BSIGN_LEN_OFFSET;
+	mpi = pkt + DIGSIG_RSA_DATA_OFFSET + 2;
+	len = EVP_PKEY_get_size(pkey);
+	if (mpi + len > sig + sig_size)
+		return -1;
+
+	memcpy(sig, greet, DIGSIG_BSIGN_GREET_SIZE);
+	memcpy(sig + DIGSIG_BSIGN_GREET_SIZE, md, mdlen);
+	pkt[0] = 0x89;
+	pkt[3] = 3;			/* version */
+	pkt[4] = 5;			/* length of the class and time */
+	pkt[DIGSIG_RSA_CLASS_OFFSET] = PGP_SIG_CLASS;
+	pkt[DIGSIG_RSA_TIMESTAMP_OFFSET] = sign_time >> 24;
+	pkt[DIGSIG_RSA_TIMESTAMP_OFFSET + 1] = sign_time >> 16;
+	pkt[DIGSIG_RSA_TIMESTAMP_OFFSET + 2] = sign_time >> 8;
+	pkt[DIGSIG_RSA_TIMESTAMP_OFFSET + 3] = sign_time;
+	memcpy(pkt + DIGSIG_RSA_KEYID_OFFSET, keyid, DIGSIG_KEYID_SIZE);
+	pkt[DIGSIG_RSA_DIGEST_ALGO_OFFSET - 1] = PGP_PUBKEY_RSA;
+	pkt[DIGSIG_RSA_DIGEST_ALGO_OFFSET] = digsig_pgp_hash_algo(hash_algo);
+
+	/* the message the kernel hashes: bsign's, then GPG's additions */
+	msg[DIGSIG_BSIGN_GREET_SIZE + mdlen] = PGP_SIG_CLASS;
+	memcpy(msg + DIGSIG_BSIGN_GREET_SIZE + mdlen + 1,
+	       pkt + DIGSIG_RSA_TIMESTAMP_OFFSET, 4);
+	if (digest(hash_algo, msg, DIGSIG_BSIGN_GREET_SIZE + mdlen + 5, m))
+		return -1;
+	pkt[DIGSIG_RSA_DIGEST_ALGO_OFFSET + 1] = m[0];
+	pkt[DIGSIG_RSA_DIGEST_ALGO_OFFSET + 2] = m[1];
+
+	/* the DigestInfo, padded by OpenSSL as PKCS#1 v1.5 type 1 */
+	memcpy(frame, hash_algos[hash_algo].asn, asn_len);
+	memcpy(frame + asn_len, m, mdlen);
+	pctx = EVP_PKEY_CTX_new(pkey, NULL);
+	if (!pctx || EVP_PKEY_sign_init(pctx) <= 0 ||
+	    EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING) <= 0 ||
+	    EVP_PKEY_sign(pctx, mpi, &len, frame, asn_len + mdlen) <= 0)
+		goto out;
+
+	/* the MPI: its length in bits, then its bytes, without leading 0s */
+	while (len > 1 && !mpi[0]) {
+		memmove(mpi, mpi + 1, --len);
+		mpi[len] = 0;
+	}
+	bits = (len - 1) * 8;
+	for (rc = mpi[0]; rc; rc >>= 1)
+		bits++;
+	mpi[-2] = bits >> 8;
+	mpi[-1] = bits;
+
+	len += mpi - pkt - PGP_PACKET_HDR;
+	pkt[1] = len >> 8;
+	pkt[2] = len;
+	len += PGP_PACKET_HDR;
+	pkt[-2] = len >> 8;
+	pkt[-1] = len;
+	rc = 0;
+out:
+	EVP_PKEY_CTX_free(pctx);
+	return rc;
+}
+
+/* Read the section headers of either class into an ELF64 table. */
+static int read_shdrs(struct image *im)
+{
+	Elf64_Ehdr *e64 = (Elf64_Ehdr *)im->data;
+	Elf32_Ehdr *e32 = (Elf32_Ehdr *)im->data;
+	unsigned long off, ent, entsize;
+	u64 count;
+	unsigned int i;
+
+	if (im->arch32) {
+		off = e32->e_shoff;
+		im->shnum = e32->e_shnum;
+		ent = sizeof(Elf32_Shdr);
+		entsize = e32->e_shentsize;
+	} else {
+		off = e64->e_shoff;
+		im->shnum = e64->e_shnum;
+		ent = sizeof(Elf64_Shdr);
+		entsize = e64->e_shentsize;
+	}
+	if ((im->shnum || off) && entsize != ent)
+		return -1;
+	/* extended section numbering: the count is in the first entry */
+	if (!im->shnum && off) {
+		if (off > im->size || ent > im->size - off)
+			return -1;
+		if (im->arch32) {
+			Elf32_Shdr s;
+
+			memcpy(&s, im->data + off, ent);
+			count = s.sh_size;
+		} else {
+			Elf64_Shdr s;
+
+			memcpy(&s, im->data + off, ent);
+			count = s.sh_size;
+		}
+		if (!count || count > UINT_MAX - 3)
+			return -1;
+		im->shnum = count;
+	}
+	if (off > im->size || im->shnum * ent > im->size - off)
+		return -1;
+
+	im->shdr = calloc(im->shnum + 3, sizeof(*im->shdr));
+	if (!im->shdr)
+		return -1;
+	for (i = 0; i < im->shnum; i++) {
+		if (im->arch32) {
+			Elf32_Shdr s;
+
+			memcpy(&s, im->data + off + i * ent, ent);
+			im->shdr[i].sh_name = s.sh_name;
+			im->shdr[i].sh_type = s.sh_type;
+			im->shdr[i].sh_flags = s.sh_flags;
+			im->shdr[i].sh_addr = s.sh_addr;
+			im->shdr[i].sh_offset = s.sh_offset;
+			im->shdr[i].sh_size = s.sh_size;
+			im->shdr[i].sh_link = s.sh_link;
+			im->shdr[i].sh_info = s.sh_info;
+			im->shdr[i].sh_addralign = s.sh_addralign;
+			im->shdr[i].sh_entsize = s.sh_entsize;
+		} else {
+			memcpy(&im->shdr[i], im->data + off + i * ent, ent);
+		}
+	}
+	im->shoff = off;
+	return 0;
+}
+
+/* Write the section headers back, in the class of the file. */
+static void write_shdrs(struct image *im)
+{
+	Elf64_Ehdr *e64 = (Elf64_Ehdr *)im->data;
+	Elf32_Ehdr *e32 = (Elf32_Ehdr *)im->data;
+	unsigned int i;
+
+	/* past SHN_LORESERVE entries, the count goes in the first one */
+	if (im->shnum)
+		im->shdr[0].sh_size = im->shnum >= SHN_LORESERVE ?
+				      im->shnum : 0;
+	for (i = 0; i < im->shnum; i++) {
+		if (im->arch32) {
+			Elf32_Shdr s;
+
+			s.sh_name = im->shdr[i].sh_name;
+			s.sh_type = im->shdr[i].sh_type;
+			s.sh_flags = im->shdr[i].sh_flags;
+			s.sh_addr = im->shdr[i].sh_addr;
+			s.sh_offset = im->shdr[i].sh_offset;
+			s.sh_size = im->shdr[i].sh_size;
+			s.sh_link = im->shdr[i].sh_link;
+			s.sh_info = im->shdr[i].sh_info;
+			s.sh_addralign = im->shdr[i].sh_addralign;
+			s.sh_entsize = im->shdr[i].sh_entsize;
+			memcpy(im->data + im->shoff + i * sizeof(s), &s,
+			       sizeof(s));
+		} else {
+			memcpy(im->data + im->shoff + i * sizeof(Elf64_Shdr),
+			       &im->shdr[i], sizeof(Elf64_Shdr));
+		}
+	}
+	if (im->arch32) {
+		e32->e_shoff = im->shoff;
+		e32->e_shnum = im->shnum >= SHN_LORESERVE ? 0 : im->shnum;
+		e32->e_shentsize = sizeof(Elf32_Shdr);
+	} else {
+		e64->e_shoff = im->shoff;
+		e64->e_shnum = im->shnum >= SHN_LORESERVE ? 0 : im->shnum;
+		e64->e_shentsize = sizeof(Elf64_Shdr);
+	}
+}
+
+static unsigned long chunk_section_size(size_t file_size)
+{
+	size_t n = (file_size + (1UL << chunk_shift) - 1) >> chunk_shift;
+
+	return sizeof(struct digsig_chunk_hdr) + n * DIGSIG_CHUNK_HASH_SIZE;
+}
+
+/*
+ * Find the last section of a type and size to sign in place: its
+ * index, or -1 if there is none.
+ */
+static int find_section(struct image *im, u32 type, unsigned long size)
+{
+	int i;
+
+	for (i = im->shnum - 1; i >= 0; i--) {
+		if (im->shdr[i].sh_type != type)
+			continue;
+		if (im->shdr[i].sh_size != size ||
+		    im->shdr[i].sh_offset > im->size ||
+		    size > im->size - im->shdr[i].sh_offset)
+			return -1;
+		return i;
+	}
+	return -1;
+}
+
+/*
+ * Lay out the signed file: the sections of an earlier signature if
+ * they fit, new ones at the end otherwise, and the other DigSig
+ * sections retired.
+ */
+static int layout(struct image *im)
+{
+	u32 type = segments ? DIGSIG_ELF_SEGSIG_SECTION : DIGSIG_ELF_SIG_SECTION;
+	size_t ent = im->arch32 ? sizeof(Elf32_Shdr) : sizeof(Elf64_Shdr);
+	unsigned long off, prev;
+	int sig = -1, ch = -1;
+	unsigned int i;
+	u8 *data;
+
+	im->sig_size = sign_algo == SIGN_ED25519 ? DIGSIG_ED25519_SIG_SIZE :
+		       DIGSIG_ELF_SIG_SIZE;
+	sig = find_section(im, type, im->sig_size);
+	if (sig >= 0 && chunk_shift) {
+		ch = find_section(im, DIGSIG_ELF_CHUNK_SECTION,
+				  chunk_section_size(im->size));
+		if (ch < 0)
+			sig = -1;
+	}
+	im->append = sig < 0;
+	for (i = 0; i < im->shnum; i++)
+		if (IS_DIGSIG_SECTION(im->shdr[i].sh_type) &&
+		    (im->append || (i != sig && i != ch)))
+			im->shdr[i].sh_type = SHT_NULL;
+
+	if (!im->append) {
+		im->out_size = im->size;
+		im->sig_off = im->shdr[sig].sh_offset;
+		if (ch >= 0) {
+			im->ch_off = im->shdr[ch].sh_offset;
+			im->ch_size = im->shdr[ch].sh_size;
+		}
+		return 0;
+	}
+
+	/* a table made from nothing starts with its null section */
+	if (!im->shnum)
+		im->shnum = 1;
+	im->sig_off = ALIGN(im->size, 8);
+	off = im->sig_off + im->sig_size;
+	im->shdr[im->shnum].sh_type = type;
+	im->shdr[im->shnum].sh_offset = im->sig_off;
+	im->shdr[im->shnum].sh_size = im->sig_size;
+	im->shdr[im->shnum].sh_addralign = 1;
+	im->shnum++;
+	if (chunk_shift) {
+		im->ch_off = ALIGN(off, 8);
+		im->shnum++;
+		/* the chunks are of the signed file, chunk section included */
+		im->ch_size = 0;
+		do {
+			prev = im->ch_size;
+			im->shoff = ALIGN(im->ch_off + prev, 8);
+			im->ch_size = chunk_section_size(im->shoff +
+							 im->shnum * ent);
+		} while (im->ch_size != prev);
+		if (im->ch_size > DIGSIG_CHUNK_MAX_SECTION)
+			return -1;
+		im->shdr[im->shnum - 1].sh_type = DIGSIG_ELF_CHUNK_SECTION;
+		im->shdr[im->shnum - 1].sh_offset = im->ch_off;
+		im->shdr[im->shnum - 1].sh_size = im->ch_size;
+		im->shdr[im->shnum - 1].sh_addralign = 8;
+	} else {
+		im->shoff = ALIGN(off, 8);
+	}
+	im->out_size = im->shoff + im->shnum * ent;
+
+	data = realloc(im->data, im->out_size);
+	if (!data)
+		return -1;
+	memset(data + im->size, 0, im->out_size - im->size);
+	im->data = data;
+	return 0;
+}
+
+/* The end of a range, rounded out as the kernel rounds it. */
+static u64 segment_end(struct image *im, u64 off, u64 len)
+{
+	u64 end = round_up(off + len, DIGSIG_SEGMENTS_ALIGN);
+
+	return end < im->out_size ? end : im->out_size;
+}
+
+/* Hash the file the way a segment signature is of it. */
+static int hash_segments(struct image *im, EVP_MD_CTX *mctx)
+{
+	struct { u64 start, end; } r[DIGSIG_SEGMENTS_MAX + 2], t;
+	Elf64_Ehdr *e64 = (Elf64_Ehdr *)im->data;
+	Elf32_Ehdr *e32 = (Elf32_Ehdr *)im->data;
+	unsigned long phoff, phnum, ent;
+	unsigned int n = 0, i, j;
+
+	if (im->arch32) {
+		phoff = e32->e_phoff;
+		phnum = e32->e_phnum;
+		ent = sizeof(Elf32_Phdr);
+		if (e32->e_phentsize != ent)
+			return -1;
+	} else {
+		phoff = e64->e_phoff;
+		phnum = e64->e_phnum;
+		ent = sizeof(Elf64_Phdr);
+		if (e64->e_phentsize != ent)
+			return -1;
+	}
+	if (!phoff || phnum > 65536 / sizeof(Elf64_Phdr) ||
+	    phoff > im->size || phnum * ent > im->size - phoff)
+		return -1;
+
+	r[n].start = 0;
+	r[n++].end = segment_end(im, 0, im->arch32 ? sizeof(*e32) :
+				 sizeof(*e64));
+	r[n].start = round_down(phoff, DIGSIG_SEGMENTS_ALIGN);
+	r[n++].end = segment_end(im, phoff, phnum * ent);
+	if (r[1].start <= r[0].end) {
+		r[0].end = r[1].end > r[0].end ? r[1].end : r[0].end;
+		n--;
+	}
+	for (i = 0; i < phnum; i++) {
+		u64 off, filesz;
+
+		if (im->arch32) {
+			Elf32_Phdr *ph = (Elf32_Phdr *)(im->data + phoff) + i;
+
+			off = ph->p_offset;
+			filesz = ph->p_filesz;
+		} else {
+			Elf64_Phdr *ph = (Elf64_Phdr *)(im->data + phoff) + i;
+
+			off = ph->p_offset;
+			filesz = ph->p_filesz;
+		}
+		if (!filesz)
+			continue;
+		if (off > im->out_size || filesz > im->out_size - off)
+			return -1;
+
+		/* insert in order of start, merged as the kernel merges */
+		r[n].start = round_down(off, DIGSIG_SEGMENTS_ALIGN);
+		r[n].end = segment_end(im, off, filesz);
+		for (j = n; j > 0 && r[j - 1].start > r[j].start; j--) {
+			t = r[j - 1];
+			r[j - 1] = r[j];
+			r[j] = t;
+		}
+		n++;
+		for (j = 0; j + 1 < n; ) {
+			if (r[j + 1].start <= r[j].end) {
+				if (r[j + 1].end > r[j].end)
+					r[j].end = r[j + 1].end;
+				memmove(&r[j + 1], &r[j + 2],
+					(n - j - 2) * sizeof(r[0]));
+				n--;
+			} else {
+				j++;
+			}
+		}
+		if (n > DIGSIG_SEGMENTS_MAX)
+			return -1;
+	}
+
+	for (i = 0; i < n; i++)
+		if (!EVP_DigestUpdate(mctx, im->data + r[i].start,
+				      r[i].end - r[i].start))
+			return -1;
+	return 0;
+}
+
+/* Fill the chunk hash section, the signature section still zeroed. */
+static int hash_chunks(struct image *im)
+{
+	struct digsig_chunk_hdr *hdr;
+	size_t n = (im->out_size + (1UL << chunk_shift) - 1) >> chunk_shift;
+	size_t i, len;
+	unsigned int hlen;
+	u8 *sect;
+
+	/* the section is hashed as zeroes, so it is filled in at the end */
+	sect = calloc(1, im->ch_size);
+	if (!sect)
+		return -1;
+	hdr = (struct digsig_chunk_hdr *)sect;
+	for (i = 0; i < n; i++) {
+		len = im->out_size - (i << chunk_shift);
+		if (len > 1UL << chunk_shift)
+			len = 1UL << chunk_shift;
+		if (!EVP_Digest(im->data + (i << chunk_shift), len,
+				sect + sizeof(*hdr) + i * DIGSIG_CHUNK_HASH_SIZE,
+				&hlen, EVP_sha256(), NULL)) {
+			free(sect);
+			return -1;
+		}
+	}
+	memcpy(hdr->magic, DIGSIG_CHUNK_MAGIC, sizeof(hdr->magic));
+	hdr->chunk_shift = htole32(chunk_shift);
+	hdr->nchunks = htole32(n);
+	hdr->file_size = htole64(im->out_size);
+	memcpy(im->data + im->ch_off, sect, im->ch_size);
+	free(sect);
+	return 0;
+}
+
+/* Sign the image in memory. */
+static int sign_image(struct image *im, EVP_MD_CTX *mctx)
+{
+	u8 md[DIGSIG_MAX_DIGEST_LENGTH];
+	unsigned int len;
+
+	/* what is signed is read with the new sections zeroed */
+	memset(im->data + im->sig_off, 0, im->sig_size);
+	if (im->ch_size)
+		memset(im->data + im->ch_off, 0, im->ch_size);
+	write_shdrs(im);
+
+	if (!EVP_DigestInit_ex(mctx, hash_algos[hash_algo].md(), NULL))
+		return -1;
+	if (im->ch_size) {
+		if (hash_chunks(im) ||
+		    !EVP_DigestUpdate(mctx, im->data + im->ch_off, im->ch_size))
+			return -1;
+	} else if (segments) {
+		if (hash_segments(im, mctx))
+			return -1;
+	} else if (!EVP_DigestUpdate(mctx, im->data, im->out_size)) {
+		return -1;
+	}
+	if (!EVP_DigestFinal_ex(mctx, md, &len))
+		return -1;
+
+	return sign_section(md, im->data + im->sig_off, im->sig_size);
+}
+
+/* Replace the file by its signed copy, with the same owner and mode. */
+static int write_image(struct image *im, struct stat *st)
+{
+	char *tmp;
+	size_t done;
+	ssize_t n;
+	int fd;
+
+	if (asprintf(&tmp, "%s.digsig-XXXXXX", im->path) < 0)
+		return -1;
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return -1;
+	}
+	for (done = 0; done < im->out_size; done += n) {
+		n = write(fd, im->data + done, im->out_size - done);
+		if (n <= 0)
+			break;
+	}
+	/* only root may give the file away, and the build need not be it */
+	if (done != im->out_size || fchmod(fd, st->st_mode & 07777) ||
+	    (fchown(fd, st->st_uid, st->st_gid) && !geteuid())) {
+		close(fd);
+		goto err;
+	}
+	if (close(fd) || rename(tmp, im->path))
+		goto err;
+	free(tmp);
+	return 0;
+err:
+	unlink(tmp);
+	free(tmp);
+	return -1;
+}
+
+static int load(struct image *im, struct stat *st)
+{
+	ssize_t n;
+	size_t done;
+	int fd;
+
+	fd = open(im->path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, st) || !S_ISREG(st->st_mode)) {
+		close(fd);
+		return -1;
+	}
+	im->size = st->st_size;
+	im->data = malloc(im->size ? im->size : 1);
+	for (done = 0; im->data && done < im->size; done += n) {
+		n = read(fd, im->data + done, im->size - done);
+		if (n <= 0)
+			break;
+	}
+	close(fd);
+	return im->data && done == im->size ? 0 : -1;
+}
+
+static int is_elf(struct image *im)
+{
+	unsigned char *id = im->data;
+
+	if (im->size < sizeof(Elf64_Ehdr) || memcmp(id, ELFMAG, SELFMAG) ||
+	    (id[EI_CLASS] != ELFCLASS32 && id[EI_CLASS] != ELFCLASS64))
+		return 0;
+	im->arch32 = id[EI_CLASS] == ELFCLASS32;
+	return 1;
+}
+
+/* the file has its signature in a DigSig note, which is read first */
+static int has_sig_note(struct image *im)
+{
+	struct digsig_notes notes;
+	static __thread char phdr[PHDR_ROOM];
+
+	return digsig_find_notes(image_read, im, (struct elf64_hdr *)im->data,
+				 im->arch32, phdr, sizeof(phdr), &notes);
+}
+
+static void sign_file(const char *path, EVP_MD_CTX *mctx)
+{
+	struct image im;
+	struct stat st;
+
+	memset(&im, 0, sizeof(im));
+	im.path = path;
+	if (load(&im, &st)) {
+		perror(path);
+		__sync_fetch_and_or(&failed, 1);
+		goto out;
+	}
+	if (!is_elf(&im) || im.data[EI_DATA] != ELFDATA2LSB) {
+		file_error(path, "not a little-endian ELF file");
+		goto out;
+	}
+	if (has_sig_note(&im)) {
+		file_error(path, "signed in a DigSig note, left as it is");
+		goto out;
+	}
+	if (read_shdrs(&im) || layout(&im)) {
+		file_error(path, "bad or too big section header table");
+		goto out;
+	}
+	if (sign_image(&im, mctx)) {
+		file_error(path, "cannot sign");
+		goto out;
+	}
+	if (write_image(&im, &st))
+		file_error(path, "cannot write the signed file");
+out:
+	free(im.shdr);
+	free(im.data);
+}
+
+/*
+ * The manifest digest of a file: SHA-256 of it as it is, or with its
+ * signature zeroed if it has one.
+ */
+static void list_file(int idx, const char *path)
+{
+	struct image im;
+	struct stat st;
+	struct digsig_notes notes;
+	static __thread char phdr[PHDR_ROOM];
+	unsigned long off = 0, size = 0;
+
+	memset(&im, 0, sizeof(im));
+	im.path = path;
+	if (load(&im, &st)) {
+		perror(path);
+		__sync_fetch_and_or(&failed, 1);
+		goto out;
+	}
+	if (is_elf(&im)) {
+		if (digsig_find_notes(image_read, &im,
+				      (struct elf64_hdr *)im.data, im.arch32,
+				      phdr, sizeof(phdr), &notes) ||
+		    digsig_scan_sections(image_read, &im,
+					 (struct elf64_hdr *)im.data,
+					 im.arch32, phdr, sizeof(phdr),
+					 &notes) > 0) {
+			off = notes.sig_offset;
+			size = notes.sig_size;
+		}
+		if (off <= im.size && size <= im.size - off)
+			memset(im.data + off, 0, size);
+	}
+	if (digest(HASH_SHA256, im.data, im.size, digests[idx]))
+		file_error(path, "cannot hash");
+	else
+		listed[idx] = 1;
+out:
+	free(im.shdr);
+	free(im.data);
+}
+
+/*
+ * The revocation digest of a file's RSA signature: SHA-256 of the
+ * magnitude of its MPI, without the bit count and the leading zeroes.
+ */
+static void revoke_file(int idx, const char *path)
+{
+	struct image im;
+	struct stat st;
+	struct digsig_notes notes;
+	struct digsig_sig_info info;
+	static __thread char phdr[PHDR_ROOM];
+	const unsigned char *raw;
+	unsigned int nbytes, len;
+
+	memset(&im, 0, sizeof(im));
+	im.path = path;
+	if (load(&im, &st)) {
+		perror(path);
+		__sync_fetch_and_or(&failed, 1);
+		goto out;
+	}
+	if (!is_elf(&im) ||
+	    (!digsig_find_notes(image_read, &im, (struct elf64_hdr *)im.data,
+				im.arch32, phdr, sizeof(phdr), &notes) &&
+	     digsig_scan_sections(image_read, &im, (struct elf64_hdr *)im.data,
+				  im.arch32, phdr, sizeof(phdr), &notes) <= 0) ||
+	    notes.sig_offset > im.size ||
+	    notes.sig_size > im.size - notes.sig_offset ||
+	    digsig_parse_signature((char *)im.data + notes.sig_offset,
+				   notes.sig_size, &info)) {
+		file_error(path, "not a signed ELF file");
+		goto out;
+	}
+	if (info.signalgo != SIGN_RSA ||
+	    info.packet_len < DIGSIG_RSA_DATA_OFFSET + 2) {
+		file_error(path, "not signed with RSA");
+		goto out;
+	}
+	raw = info.packet + DIGSIG_RSA_DATA_OFFSET;
+	len = info.packet_len - DIGSIG_RSA_DATA_OFFSET - 2;
+	nbytes = (((raw[0] << 8) | raw[1]) + 7) / 8;
+	if (nbytes > len) {
+		file_error(path, "bad signature MPI");
+		goto out;
+	}
+	for (raw += 2; nbytes && !*raw; raw++)
+		nbytes--;
+	if (digest(HASH_SHA256, raw, nbytes, digests[idx]))
+		file_error(path, "cannot hash");
+	else
+		listed[idx] = 1;
+out:
+	free(im.shdr);
+	free(im.data);
+}
+
+static void *worker(void *arg)
+{
+	EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+	int i;
+
+	if (!mctx)
+		return NULL;
+	while ((i = __sync_fetch_and_add(&next_file, 1)) < nfiles) {
+		if (manifest)
+			list_file(i, files[i]);
+		else if (revoke_db)
+			revoke_file(i, files[i]);
+		else
+			sign_file(files[i], mctx);
+	}
+	EVP_MD_CTX_free(mctx);
+	return NULL;
+}
+
+static int cmp_digest(const void *a, const void *b)
+{
+	return memcmp(a, b, DIGSIG_MANIFEST_DIGEST_SIZE);
+}
+
+/* Sort the digests listed, once each, and return their number. */
+static int sort_digests(void)
+{
+	int i, len, n = 0;
+
+	for (i = 0; i < nfiles; i++)
+		if (listed[i])
+			memmove(digests[n++], digests[i],
+				DIGSIG_MANIFEST_DIGEST_SIZE);
+	qsort(digests, n, DIGSIG_MANIFEST_DIGEST_SIZE, cmp_digest);
+	/* the same file given twice is listed once */
+	for (i = 1, len = 1; i < n; i++)
+		if (memcmp(digests[len - 1], digests[i],
+			   DIGSIG_MANIFEST_DIGEST_SIZE))
+			memcpy(digests[len++], digests[i],
+			       DIGSIG_MANIFEST_DIGEST_SIZE);
+	return n ? len : 0;
+}
+
+/* Write the manifest of the digests listed, sorted and signed. */
+static int write_manifest(void)
+{
+	struct digsig_manifest_hdr hdr;
+	unsigned long sig_size = sign_algo == SIGN_ED25519 ?
+		DIGSIG_ED25519_SIG_SIZE : DIGSIG_ELF_SIG_SIZE;
+	u8 md[DIGSIG_MAX_DIGEST_LENGTH], sig[DIGSIG_ELF_SIG_SIZE];
+	EVP_MD_CTX *mctx;
+	unsigned int len;
+	int n = sort_digests();
+	FILE *f;
+
+	if (n > DIGSIG_MANIFEST_MAX) {
+		fprintf(stderr, "%s: more than %u digests\n", manifest,
+			DIGSIG_MANIFEST_MAX);
+		return -1;
+	}
+
+	memcpy(hdr.magic, DIGSIG_MANIFEST_MAGIC, sizeof(hdr.magic));
+	hdr.count = htole32(n);
+	hdr.sig_size = htole32(sig_size);
+	mctx = EVP_MD_CTX_new();
+	if (!mctx || !EVP_DigestInit_ex(mctx, hash_algos[hash_algo].md(),
+					NULL) ||
+	    !EVP_DigestUpdate(mctx, &hdr, sizeof(hdr)) ||
+	    !EVP_DigestUpdate(mctx, digests,
+			      (size_t)n * DIGSIG_MANIFEST_DIGEST_SIZE) ||
+	    !EVP_DigestFinal_ex(mctx, md, &len) ||
+	    sign_section(md, sig, sig_size)) {
+		EVP_MD_CTX_free(mctx);
+		fprintf(stderr, "%s: cannot sign\n", manifest);
+		return -1;
+	}
+	EVP_MD_CTX_free(mctx);
+
+	f = fopen(manifest, "w");
+	if (!f || fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    (n && fwrite(digests, DIGSIG_MANIFEST_DIGEST_SIZE, n, f) !=
+	     (size_t)n) ||
+	    fwrite(sig, sig_size, 1, f) != 1 || fclose(f)) {
+		perror(manifest);
+		return -1;
+	}
+	return 0;
+}
+
+/* Set the bits of the digest in the filter, as the kernel tests them. */
+static void bloom_add(u8 *bloom, unsigned int shift, const u8 *d)
+{
+	u32 block = le32toh(*(u32 *)(d + 4)) &
+		((1U << (shift - DIGSIG_REVOKE_DB_BLOCK_SHIFT)) - 1);
+	u32 probe = le32toh(*(u32 *)(d + 8));
+	u32 bit;
+	int i;
+
+	block <<= DIGSIG_REVOKE_DB_BLOCK_SHIFT;
+	for (i = 0; i < DIGSIG_REVOKE_DB_PROBES; i++) {
+		bit = block + (probe & ((1U << DIGSIG_REVOKE_DB_BLOCK_SHIFT) - 1));
+		bloom[bit >> 3] |= 1U << (bit & 7);
+		probe >>= DIGSIG_REVOKE_DB_BLOCK_SHIFT;
+	}
+}
+
+/*
+ * Write the revocation database of the digests listed: the filter has
+ * 16 bits per digest, which with 3 probes in a block of 512 bits tells
+ * all but about one in 400 signatures that are not revoked.
+ */
+static int write_revoke_db(void)
+{
+	struct digsig_revoke_db_hdr hdr;
+	unsigned long sig_size = sign_algo == SIGN_ED25519 ?
+		DIGSIG_ED25519_SIG_SIZE : DIGSIG_ELF_SIG_SIZE;
+	u8 md[DIGSIG_MAX_DIGEST_LENGTH], sig[DIGSIG_ELF_SIG_SIZE], *bloom;
+	unsigned int shift = DIGSIG_REVOKE_DB_BLOCK_SHIFT, len;
+	size_t bloom_size;
+	EVP_MD_CTX *mctx;
+	int i, n = sort_digests();
+	FILE *f;
+
+	if (n > DIGSIG_REVOKE_DB_MAX) {
+		fprintf(stderr, "%s: more than %u digests\n", revoke_db,
+			DIGSIG_REVOKE_DB_MAX);
+		return -1;
+	}
+	while ((1UL << shift) < 16UL * n && shift < DIGSIG_REVOKE_DB_MAX_SHIFT)
+		shift++;
+	bloom_size = (1UL << shift) / 8;
+	bloom = calloc(bloom_size, 1);
+	if (!bloom)
+		return -1;
+	for (i = 0; i < n; i++)
+		bloom_add(bloom, shift, digests[i]);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, DIGSIG_REVOKE_DB_MAGIC, sizeof(hdr.magic));
+	hdr.count = htole32(n);
+	hdr.sig_size = htole32(sig_size);
+	hdr.bloom_shift = htole32(shift);
+	mctx = EVP_MD_CTX_new();
+	if (!mctx || !EVP_DigestInit_ex(mctx, hash_algos[hash_algo].md(),
+					NULL) ||
+	    !EVP_DigestUpdate(mctx, &hdr, sizeof(hdr)) ||
+	    !EVP_DigestUpdate(mctx, bloom, bloom_size) ||
+	    !EVP_DigestUpdate(mctx, digests,
+			      (size_t)n * DIGSIG_REVOKE_DB_DIGEST_SIZE) ||
+	    !EVP_DigestFinal_ex(mctx, md, &len) ||
+	    sign_section(md, sig, sig_size)) {
+		EVP_MD_CTX_free(mctx);
+		free(bloom);
+		fprintf(stderr, "%s: cannot sign\n", revoke_db);
+		return -1;
+	}
+	EVP_MD_CTX_free(mctx);
+
+	f = fopen(revoke_db, "w");
+	if (!f || fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(bloom, bloom_size, 1, f) != 1 ||
+	    (n && fwrite(digests, DIGSIG_REVOKE_DB_DIGEST_SIZE, n, f) !=
+	     (size_t)n) ||
+	    fwrite(sig, sig_size, 1, f) != 1 || fclose(f)) {
+		perror(revoke_db);
+		free(bloom);
+		return -1;
+	}
+	free(bloom);
+	return 0;
+}
+
+static int cmp_ino(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Write the verdict bundle of the files, all of one image, named by
+ * their inode numbers, sorted.
+ */
+static int write_bundle(void)
+{
+	struct digsig_bundle_hdr hdr;
+	unsigned long sig_size = sign_algo == SIGN_ED25519 ?
+		DIGSIG_ED25519_SIG_SIZE : DIGSIG_ELF_SIG_SIZE;
+	u8 md[DIGSIG_MAX_DIGEST_LENGTH], sig[DIGSIG_ELF_SIG_SIZE];
+	EVP_MD_CTX *mctx;
+	struct stat st;
+	dev_t dev = 0;
+	unsigned int len;
+	u32 *ino;
+	int i, rc = -1;
+	FILE *f;
+
+	if (nfiles > (int)DIGSIG_BUNDLE_MAX) {
+		fprintf(stderr, "%s: more than %u files\n", bundle,
+			DIGSIG_BUNDLE_MAX);
+		return -1;
+	}
+	ino = calloc(nfiles + 1, sizeof(*ino));
+	if (!ino)
+		return -1;
+	for (i = 0; i < nfiles; i++) {
+		if (stat(files[i], &st)) {
+			perror(files[i]);
+			goto out;
+		}
+		if (!S_ISREG(st.st_mode) || (i && st.st_dev != dev) ||
+		    st.st_ino > 0xffffffffUL) {
+			file_error(files[i], "not a file of the image");
+			goto out;
+		}
+		dev = st.st_dev;
+		ino[i] = st.st_ino;
+	}
+	qsort(ino, nfiles, sizeof(*ino), cmp_ino);
+	for (i = 0; i < nfiles; i++)
+		ino[i] = htole32(ino[i]);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, DIGSIG_BUNDLE_MAGIC, sizeof(hdr.magic));
+	strcpy(hdr.alg, bundle_alg);
+	hdr.digest_size = htole32(bundle_root_size);
+	hdr.count = htole32(nfiles);
+	hdr.sig_size = htole32(sig_size);
+	mctx = EVP_MD_CTX_new();
+	if (!mctx || !EVP_DigestInit_ex(mctx, hash_algos[hash_algo].md(),
+					NULL) ||
+	    !EVP_DigestUpdate(mctx, &hdr, sizeof(hdr)) ||
+	    !EVP_DigestUpdate(mctx, bundle_root, bundle_root_size) ||
+	    !EVP_DigestUpdate(mctx, ino, (size_t)nfiles * sizeof(*ino)) ||
+	    !EVP_DigestFinal_ex(mctx, md, &len) ||
+	    sign_section(md, sig, sig_size)) {
+		EVP_MD_CTX_free(mctx);
+		fprintf(stderr, "%s: cannot sign\n", bundle);
+		goto out;
+	}
+	EVP_MD_CTX_free(mctx);
+
+	f = fopen(bundle, "w");
+	if (!f || fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(bundle_root, bundle_root_size, 1, f) != 1 ||
+	    (nfiles && fwrite(ino, sizeof(*ino), nfiles, f) !=
+	     (size_t)nfiles) ||
+	    fwrite(sig, sig_size, 1, f) != 1 || fclose(f)) {
+		perror(bundle);
+		goto out;
+	}
+	rc = 0;
+out:
+	free(ino);
+	return rc;
+}
+
+/* an OpenPGP MPI: the number of bits, then the bytes */
+static int write_mpi(FILE *f, const BIGNUM *bn)
+{
+	unsigned char buf[1024];
+	int bits = BN_num_bits(bn), len = BN_num_bytes(bn);
+
+	if (len > (int)sizeof(buf) || BN_bn2bin(bn, buf) != len)
+		return -1;
+	return putc(bits >> 8, f) == EOF || putc(bits & 0xff, f) == EOF ||
+	       fwrite(buf, 1, len, f) != (size_t)len ? -1 : 0;
+}
+
+static int write_pubkey(const char *path)
+{
+	unsigned char pk[ED25519_KEY_SIZE];
+	size_t len = sizeof(pk);
+	BIGNUM *n = NULL, *e = NULL;
+	FILE *f;
+	int rc = -1;
+
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	if (sign_algo == SIGN_ED25519) {
+		if (EVP_PKEY_get_raw_public_key(pkey, pk, &len) &&
+		    len == sizeof(pk) &&
+		    fwrite(keyid, sizeof(keyid), 1, f) == 1 &&
+		    fwrite(pk, len, 1, f) == 1)
+			rc = 0;
+	} else if (EVP_PKEY_get_bn_param(pkey, "n", &n) &&
+		   EVP_PKEY_get_bn_param(pkey, "e", &e) &&
+		   !write_mpi(f, n) && !write_mpi(f, e)) {
+		rc = 0;
+	}
+	BN_free(n);
+	BN_free(e);
+	if (fclose(f))
+		rc = -1;
+	return rc;
+}
+
+static int read_pkey(const char *path)
+{
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -1;
+	pkey = PEM_read_PrivateKey(f, NULL, NULL, NULL);
+	fclose(f);
+	if (!pkey)
+		return -1;
+	switch (EVP_PKEY_get_id(pkey)) {
+	case EVP_PKEY_RSA:
+		sign_algo = SIGN_RSA;
+		return 0;
+	case EVP_PKEY_ED25519:
+		sign_algo = SIGN_ED25519;
+		return 0;
+	}
+	return -1;
+}
+
+static int parse_keyid(const char *s)
+{
+	unsigned int i, b;
+
+	if (strlen(s) != 2 * DIGSIG_KEYID_SIZE)
+		return -1;
+	for (i = 0; i < DIGSIG_KEYID_SIZE; i++) {
+		if (sscanf(s + 2 * i, "%2x", &b) != 1)
+			return -1;
+		keyid[i] = b;
+	}
+	return 0;
+}
+
+/* the "alg:hexroot" of a verity table */
+static int parse_root(const char *s)
+{
+	const char *colon = strchr(s, ':');
+	size_t n = colon ? (size_t)(colon - s) : 0, len;
+	unsigned int i, b;
+
+	if (!n || n >= sizeof(bundle_alg))
+		return -1;
+	memcpy(bundle_alg, s, n);
+	s = colon + 1;
+	len = strlen(s);
+	if (!len || len % 2 || len / 2 > sizeof(bundle_root))
+		return -1;
+	for (i = 0; i < len / 2; i++) {
+		if (sscanf(s + 2 * i, "%2x", &b) != 1)
+			return -1;
+		bundle_root[i] = b;
+	}
+	bundle_root_size = len / 2;
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: digsig-sign -k key.pem [-i keyid] [-a hash] [-c shift | -s]\n"
+		"                   [-t time] [-j jobs] [-P pubkey] file...\n"
+		"       digsig-sign -k key.pem -m manifest [-i keyid] [-a hash]\n"
+		"                   [-t time] [-j jobs] file...\n"
+		"       digsig-sign -k key.pem -r db [-i keyid] [-a hash]\n"
+		"                   [-t time] [-j jobs] file...\n"
+		"       digsig-sign -k key.pem -b bundle -V alg:root [-i keyid]\n"
+		"                   [-a hash] [-t time] file...\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *key = NULL, *pubkey = NULL, *epoch;
+	pthread_t *threads;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt, i;
+
+	sign_time = time(NULL);
+	epoch = getenv("SOURCE_DATE_EPOCH");
+	if (epoch)
+		sign_time = strtoul(epoch, NULL, 10);
+
+	while ((opt = getopt(argc, argv, "k:i:a:c:st:j:m:r:b:V:P:")) != -1) {
+		switch (opt) {
+		case 'k':
+			key = optarg;
+			break;
+		case 'i':
+			if (parse_keyid(optarg))
+				usage();
+			break;
+		case 'a':
+			for (i = 0; i < DIGSIG_HASH_ALGOS; i++)
+				if (!strcmp(optarg, hash_algos[i].name))
+					break;
+			if (i == DIGSIG_HASH_ALGOS)
+				usage();
+			hash_algo = i;
+			break;
+		case 'c':
+			chunk_shift = atoi(optarg);
+			if (chunk_shift < DIGSIG_CHUNK_MIN_SHIFT ||
+			    chunk_shift > DIGSIG_CHUNK_MAX_SHIFT)
+				usage();
+			break;
+		case 's':
+			segments = 1;
+			break;
+		case 't':
+			sign_time = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			jobs = atol(optarg);
+			break;
+		case 'm':
+			manifest = optarg;
+			break;
+		case 'r':
+			revoke_db = optarg;
+			break;
+		case 'b':
+			bundle = optarg;
+			break;
+		case 'V':
+			if (parse_root(optarg))
+				usage();
+			break;
+		case 'P':
+			pubkey = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	/* segment signatures are never checked through chunks */
+	if (!key || (chunk_shift && segments) ||
+	    ((manifest || revoke_db) && (chunk_shift || segments)) ||
+	    (manifest && revoke_db) ||
+	    (bundle && (manifest || revoke_db || chunk_shift || segments ||
+			!bundle_root_size)) ||
+	    (optind == argc && !pubkey))
+		usage();
+	if (jobs < 1)
+		jobs = 1;
+
+	if (read_pkey(key)) {
+		fprintf(stderr, "%s: not an RSA or Ed25519 private key\n", key);
+		return 2;
+	}
+	if (sign_algo == SIGN_ED25519 && hash_algo != HASH_SHA256) {
+		fprintf(stderr, "Ed25519 signatures are of SHA-256 hashes\n");
+		return 2;
+	}
+	if (pubkey && write_pubkey(pubkey)) {
+		fprintf(stderr, "%s: cannot write the public key\n", pubkey);
+		return 2;
+	}
+
+	files = argv + optind;
+	nfiles = argc - optind;
+	if (bundle) {
+		if (write_bundle())
+			return 1;
+		EVP_PKEY_free(pkey);
+		return failed;
+	}
+	if (manifest || revoke_db) {
+		digests = calloc(nfiles + 1, sizeof(*digests));
+		listed = calloc(nfiles + 1, 1);
+		if (!digests || !listed)
+			return 2;
+	}
+	if (jobs > nfiles)
+		jobs = nfiles ? nfiles : 1;
+	threads = calloc(jobs, sizeof(*threads));
+	if (!threads)
+		return 2;
+	for (i = 0; i < jobs; i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL))
+			break;
+	if (!i)
+		worker(NULL);
+	while (i--)
+		pthread_join(threads[i], NULL);
+
+	if (manifest && write_manifest())
+		return 1;
+	if (revoke_db && write_revoke_db())
+		return 1;
+	EVP_PKEY_free(pkey);
+	return failed;
+}
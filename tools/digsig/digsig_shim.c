@@ -0,0 +1,20 @@
+/*
+ * What the DigSig sources built into the tools need of the kernel
+ * around them.
+ */
+#include <stdarg.h>
+#include <linux/kernel.h>
+
+#include "digsig_common.h"
+
+int DigsigDebugLevel;
+
+void digsig_log(struct ratelimit_state *rs, const char *func,
+		const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
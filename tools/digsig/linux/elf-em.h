@@ -0,0 +1 @@
+#include "../../../include/uapi/linux/elf-em.h"
@@ -0,0 +1,2 @@
+#include <linux/types.h>
+#include "../../../include/uapi/linux/elf.h"
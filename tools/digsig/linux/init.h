@@ -0,0 +1 @@
+#define __init
@@ -0,0 +1 @@
+#define in_interrupt() 0
@@ -0,0 +1,10 @@
+#ifndef JUMP_LABEL_H
+#define JUMP_LABEL_H
+
+struct static_key {
+	int enabled;
+};
+
+#define static_key_false(key) ((key)->enabled)
+
+#endif /* JUMP_LABEL_H */
@@ -0,0 +1 @@
+#define asmlinkage
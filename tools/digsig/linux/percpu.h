@@ -0,0 +1,9 @@
+#ifndef PERCPU_H
+#define PERCPU_H
+
+/* the tools run on one CPU */
+#define DEFINE_PER_CPU(type, name) __typeof__(type) name
+#define get_cpu_var(var) (var)
+#define put_cpu_var(var) do { } while (0)
+
+#endif /* PERCPU_H */
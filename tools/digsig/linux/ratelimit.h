@@ -0,0 +1,12 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/* the tools print every message */
+struct ratelimit_state {
+	int dummy;
+};
+
+#define DEFINE_RATELIMIT_STATE(name, interval_init, burst_init)	\
+	struct ratelimit_state name = { 0 }
+
+#endif /* RATELIMIT_H */
@@ -0,0 +1,36 @@
+#ifndef LINUX_SLAB_H
+#define LINUX_SLAB_H
+#include <stdlib.h>
+#include <malloc.h>
+#include <linux/kernel.h>
+
+typedef int gfp_t;
+#define GFP_KERNEL 0
+#define GFP_ATOMIC 0
+
+#define kmalloc(size, gfp) malloc(size)
+#define kzalloc(size, gfp) calloc(1, size)
+#define krealloc(p, size, gfp) realloc(p, size)
+#define kfree(p) free(p)
+#define ksize(p) malloc_usable_size(p)
+
+/* a cache of objects of one size is malloc() */
+struct kmem_cache {
+	size_t size;
+};
+
+static inline struct kmem_cache *
+kmem_cache_create(const char *name, size_t size, size_t align,
+		  unsigned long flags, void (*ctor)(void *))
+{
+	struct kmem_cache *s = malloc(sizeof(*s));
+
+	if (s)
+		s->size = size;
+	return s;
+}
+
+#define kmem_cache_alloc(s, gfp) malloc((s)->size)
+#define kmem_cache_free(s, p) free(p)
+
+#endif /* LINUX_SLAB_H */
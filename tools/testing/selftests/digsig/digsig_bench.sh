@@ -0,0 +1,145 @@
+#!/bin/bash
+#
+# Exec storm benchmark of DigSig.
+#
+# Copies a corpus of ELF files to a scratch directory, signs the copies
+# with bsign, and runs them through exec_storm three times:
+#
+#   cold   after dropping the page cache and the inodes, so files are
+#          read from disk and verified
+#   warm   right after, with every verdict cached
+#   evict  after dropping only the inodes, so files are verified again
+#          from the page cache: the cost of the verdicts alone
+#
+# Executables are exec'd and shared libraries dlopen()ed, at JOBS
+# workers each going ROUNDS times through the corpus.
+#
+# The corpus is made of the files given on the command line, or by
+# default of a few small tools, the largest binaries of /usr/bin and
+# shared libraries from /usr/lib.  The environment tunes the run:
+#
+#   JOBS, ROUNDS     parallelism and repetitions (default: CPUs, 3)
+#   BSIGN, BSIGN_OPTS  signing tool and its options; SIGN=0 runs the
+#                    files as they are, which is how a kernel without
+#                    DigSig gives the baseline
+#   NLIBS, NLARGE    number of libraries and large binaries picked
+#   WORKDIR          scratch directory (default: a new one under /tmp)
+#
+# Needs root: DigSig must be loaded with its key, and dropping caches
+# needs /proc/sys/vm/drop_caches.
+
+JOBS=${JOBS:-$(getconf _NPROCESSORS_ONLN)}
+ROUNDS=${ROUNDS:-3}
+BSIGN=${BSIGN:-bsign}
+BSIGN_OPTS=${BSIGN_OPTS:-}
+SIGN=${SIGN:-1}
+NLIBS=${NLIBS:-64}
+NLARGE=${NLARGE:-8}
+STORM=${STORM:-$(dirname "$0")/exec_storm}
+
+SMALL_TOOLS="/bin/true /bin/false /bin/ls /bin/cat /bin/echo /bin/sh
+	/usr/bin/env /usr/bin/id /usr/bin/basename /usr/bin/dirname"
+
+skip()
+{
+	echo "digsig: $1 [SKIP]"
+	exit 0
+}
+
+is_elf()
+{
+	[ "$(head -c 4 "$1" 2>/dev/null | od -An -c | tr -d ' ')" = \
+		"177ELF" ]
+}
+
+default_corpus()
+{
+	local f
+
+	for f in $SMALL_TOOLS; do
+		[ -x "$f" ] && echo "$f"
+	done
+	find /usr/bin -maxdepth 1 -type f -perm -u+x -printf '%s %p\n' \
+		2>/dev/null | sort -rn | head -n "$NLARGE" | cut -d' ' -f2-
+	find /usr/lib /usr/lib64 /lib -name '*.so*' -type f 2>/dev/null |
+		head -n "$NLIBS"
+}
+
+drop_caches()
+{
+	sync
+	echo "$1" > /proc/sys/vm/drop_caches
+}
+
+run_phase()
+{
+	local label=$1 rc=0
+
+	if [ -n "$EXECS" ]; then
+		"$STORM" -l "$label" -j "$JOBS" -n "$ROUNDS" $EXECS || rc=1
+	fi
+	if [ -n "$LIBS" ]; then
+		"$STORM" -l "$label-so" -d -j "$JOBS" -n "$ROUNDS" $LIBS ||
+			rc=1
+	fi
+	if [ -r /sys/kernel/security/digsig/cache ]; then
+		sed "s/^/	/" /sys/kernel/security/digsig/cache
+	fi
+	return $rc
+}
+
+[ "$(id -u)" = 0 ] || skip "must be run as root"
+[ -x "$STORM" ] || skip "$STORM not built"
+if [ "$SIGN" = 1 ]; then
+	[ -e /sys/digsig/key ] || skip "DigSig is not running"
+	command -v "$BSIGN" > /dev/null || skip "$BSIGN not found"
+fi
+
+WORKDIR=${WORKDIR:-$(mktemp -d /tmp/digsig_bench.XXXXXX)}
+mkdir -p "$WORKDIR/bin" "$WORKDIR/lib" || exit 1
+trap 'rm -rf "$WORKDIR"' EXIT
+
+if [ $# -gt 0 ]; then
+	CORPUS="$*"
+else
+	CORPUS=$(default_corpus)
+fi
+
+EXECS=
+LIBS=
+n=0
+for f in $CORPUS; do
+	is_elf "$f" || continue
+	n=$((n + 1))
+	case "$f" in
+	*.so|*.so.*)
+		dst="$WORKDIR/lib/$n-$(basename "$f")"
+		LIBS="$LIBS $dst"
+		;;
+	*)
+		dst="$WORKDIR/bin/$n-$(basename "$f")"
+		EXECS="$EXECS $dst"
+		;;
+	esac
+	cp "$f" "$dst" || exit 1
+	if [ "$SIGN" = 1 ] && ! "$BSIGN" -s $BSIGN_OPTS "$dst" > /dev/null; then
+		echo "digsig: cannot sign $f"
+		exit 1
+	fi
+done
+[ $n -gt 0 ] || skip "empty corpus"
+
+echo "digsig: $n files, $JOBS workers, $ROUNDS rounds"
+
+rc=0
+drop_caches 3
+run_phase cold || rc=1
+run_phase warm || rc=1
+drop_caches 2
+run_phase evict || rc=1
+
+if [ $rc != 0 ]; then
+	echo "digsig: nothing could be run [FAIL]"
+	exit 1
+fi
+echo "digsig: [PASS]"
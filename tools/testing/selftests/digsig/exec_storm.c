@@ -0,0 +1,246 @@
+/*
+ * exec_storm: fork and exec a list of files from several workers at once,
+ * and report the latency percentiles of the execs.
+ *
+ * Each worker takes the files in turn, starting at its own offset, and
+ * runs each of them once per round, with stdin, stdout and stderr on
+ * /dev/null.  Executables are run with ARGS (by default --version);
+ * with -d, files are instead dlopen()ed by a forked child, which is how
+ * shared libraries are mapped.  A run that does not finish within the
+ * timeout is killed and counted as failed; the exit status is only
+ * non-zero when nothing could be run at all.
+ *
+ * The latency of an exec is the time from fork() to the child being
+ * reaped, as seen by the worker, so on a DigSig kernel it includes the
+ * verification of the executable and of every library it maps.
+ *
+ *	exec_storm [-j workers] [-n rounds] [-t timeout] [-l label] [-d]
+ *		   [-a args] file...
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_ARGS 16
+
+static char **files;
+static int nfiles;
+static int rounds = 1;
+static int timeout = 10;
+static int use_dlopen;
+static char *exec_args[MAX_ARGS + 2];
+static char default_args[] = "--version";
+
+struct worker {
+	pthread_t thread;
+	int id;
+	unsigned long long *lat;	/* nanoseconds, one per exec */
+	int nlat;
+	int failed;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void child(const char *file)
+{
+	int fd = open("/dev/null", O_RDWR);
+
+	if (fd >= 0) {
+		dup2(fd, 0);
+		dup2(fd, 1);
+		dup2(fd, 2);
+		if (fd > 2)
+			close(fd);
+	}
+	/* pending alarms survive execve() */
+	alarm(timeout);
+
+	if (use_dlopen)
+		_exit(dlopen(file, RTLD_NOW | RTLD_LOCAL) ? 0 : 126);
+
+	exec_args[0] = (char *)file;
+	execv(file, exec_args);
+	_exit(127);
+}
+
+/* Run a file once; returns its latency, or 0 if it could not run. */
+static unsigned long long run_one(const char *file)
+{
+	unsigned long long start = now_ns();
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return 0;
+	if (!pid)
+		child(file);
+
+	while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return 0;
+
+	/* a program refusing --version still ran, only kills count */
+	if (WIFSIGNALED(status) || (WIFEXITED(status) &&
+				    WEXITSTATUS(status) >= 126))
+		return 0;
+	return now_ns() - start;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long long lat;
+	int r, i;
+
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nfiles; i++) {
+			lat = run_one(files[(i + w->id) % nfiles]);
+			if (lat)
+				w->lat[w->nlat++] = lat;
+			else
+				w->failed++;
+		}
+	return NULL;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(unsigned long long *v, int n, double p)
+{
+	int i = (int)(p / 100.0 * (n - 1) + 0.5);
+
+	return v[i] / 1000.0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-j workers] [-n rounds] [-t timeout] "
+		"[-l label] [-d] [-a args] file...\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long *all, start, elapsed;
+	const char *label = "exec";
+	char *args = default_args, *tok;
+	struct worker *w;
+	int nworkers = 1, total = 0, failed = 0, nargs = 1;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "j:n:t:l:da:")) != -1) {
+		switch (opt) {
+		case 'j':
+			nworkers = atoi(optarg);
+			break;
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'd':
+			use_dlopen = 1;
+			break;
+		case 'a':
+			args = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind == argc || nworkers <= 0 || rounds <= 0 || timeout <= 0)
+		usage(argv[0]);
+	files = argv + optind;
+	nfiles = argc - optind;
+
+	for (tok = strtok(args, " "); tok && nargs <= MAX_ARGS;
+	     tok = strtok(NULL, " "))
+		exec_args[nargs++] = tok;
+	exec_args[nargs] = NULL;
+
+	w = calloc(nworkers, sizeof(*w));
+	if (!w) {
+		perror("calloc");
+		return 1;
+	}
+	for (i = 0; i < nworkers; i++) {
+		w[i].id = i;
+		w[i].lat = calloc((size_t)rounds * nfiles, sizeof(*w[i].lat));
+		if (!w[i].lat) {
+			perror("calloc");
+			return 1;
+		}
+	}
+
+	start = now_ns();
+	for (i = 0; i < nworkers; i++)
+		if (pthread_create(&w[i].thread, NULL, worker_fn, &w[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(w[i].thread, NULL);
+		total += w[i].nlat;
+		failed += w[i].failed;
+	}
+	elapsed = now_ns() - start;
+
+	all = malloc(((size_t)total + 1) * sizeof(*all));
+	if (!all) {
+		perror("malloc");
+		return 1;
+	}
+	for (total = 0, i = 0; i < nworkers; i++) {
+		memcpy(all + total, w[i].lat, w[i].nlat * sizeof(*all));
+		total += w[i].nlat;
+	}
+	if (!total) {
+		fprintf(stderr, "%s: no file could be run\n", label);
+		return 1;
+	}
+	qsort(all, total, sizeof(*all), cmp_ull);
+
+	printf("%-8s workers %d execs %d failed %d %.0f/s  usec: "
+	       "min %.0f p50 %.0f p90 %.0f p99 %.0f p99.9 %.0f max %.0f\n",
+	       label, nworkers, total, failed,
+	       total * 1e9 / elapsed, all[0] / 1000.0,
+	       percentile(all, total, 50), percentile(all, total, 90),
+	       percentile(all, total, 99), percentile(all, total, 99.9),
+	       all[total - 1] / 1000.0);
+	return 0;
+}